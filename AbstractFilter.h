@@ -55,6 +55,20 @@ public:
 		return std::vector<PageOrderOption>();
 	}
 
+	/**
+	 * \brief Whether this stage computes something from all pages at once.
+	 *
+	 * Batch processing treats every stage as a parallel map over the
+	 * pages.  A stage for which this returns true additionally reduces
+	 * its per-page results into an aggregate (through its Settings),
+	 * which later processing consumes.  Such a stage is a barrier: the
+	 * batch engine must run every page through it before letting any
+	 * page continue, or the aggregate would be consumed half-built.
+	 * Stages for which this returns false may be fused with the
+	 * following stage, running each page through both back-to-back.
+	 */
+	virtual bool aggregatesAcrossPages() const { return false; }
+
 	virtual void performRelinking(AbstractRelinker const& relinker) = 0;
 
 	virtual void preUpdateUI(FilterUiInterface* ui, PageId const& page_id) = 0;
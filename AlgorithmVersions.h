@@ -0,0 +1,67 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ALGORITHM_VERSIONS_H_
+#define ALGORITHM_VERSIONS_H_
+
+/**
+ * \brief The central registry of algorithm version tags.
+ *
+ * Everything we cache across runs - analysis results in the analysis
+ * cache, the out/cache/ checkpoint files whose validity is decided by
+ * OutputImageParams - encodes not just the inputs of some algorithm
+ * but its behavior at the time the artifact was written.  Change the
+ * algorithm and the artifact silently goes stale.
+ *
+ * Each result-affecting component therefore has a version tag here,
+ * compiled into the binary and recorded alongside its cached
+ * artifacts; a mismatch on load invalidates exactly the artifacts of
+ * the component that changed and nothing else.
+ *
+ * Bump a component's tag in the same commit that changes its results.
+ * Pure refactorings and speedups that keep output bit-identical don't
+ * count; anything that moves a detected angle, box or pixel does.
+ */
+namespace algo_versions
+{
+
+/** Skew angle detection (deskew filter). */
+int const SKEW_DETECTION = 1;
+
+/** Single/two-page layout detection and split line search (page_split filter). */
+int const PAGE_LAYOUT_DETECTION = 1;
+
+/** Content box detection (select_content filter). */
+int const CONTENT_BOX_DETECTION = 1;
+
+/**
+ * The output rendering pipeline up to and including binarization:
+ * illumination normalization, color mixing, picture detection,
+ * thresholding (OutputGenerator).
+ */
+int const OUTPUT_RENDERING = 1;
+
+/** Text line tracing and distortion model building (dewarping/). */
+int const DEWARPING = 1;
+
+/** Speckle detection and removal (Despeckle). */
+int const DESPECKLE = 1;
+
+} // namespace algo_versions
+
+#endif
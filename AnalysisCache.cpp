@@ -0,0 +1,272 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AnalysisCache.h"
+#include "ImageId.h"
+#include "CommandLine.h"
+#include "AtomicFileOverwriter.h"
+#include <QMutexLocker>
+#include <QCryptographicHash>
+#include <QDomElement>
+#include <QFile>
+#include <QIODevice>
+#include <QTextStream>
+
+namespace
+{
+
+/**
+ * Hashes the image content rather than its metadata, so a file
+ * that was moved, copied or re-timestamped still hits the cache.
+ * FNV-1a over the first and last 64KB is plenty to tell scans apart
+ * without reading hundreds of megabytes per page.
+ */
+QString contentHashOf(QString const& file_path)
+{
+	int const sample_bytes = 64 * 1024;
+
+	QFile file(file_path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QString();
+	}
+
+	quint64 hash = Q_UINT64_C(0xcbf29ce484222325);
+
+	QByteArray sample(file.read(sample_bytes));
+	for (int pass = 0; pass < 2; ++pass) {
+		char const* p = sample.constData();
+		char const* const end = p + sample.size();
+		for (; p != end; ++p) {
+			hash = (hash ^ (quint64)(unsigned char)*p)
+				* Q_UINT64_C(0x100000001b3);
+		}
+
+		if (file.size() <= sample_bytes) {
+			break;
+		}
+		if (pass == 0) {
+			file.seek(qMax(file.size() - sample_bytes, qint64(sample_bytes)));
+			sample = file.read(sample_bytes);
+		}
+	}
+
+	hash ^= quint64(file.size());
+
+	return QString::number(hash, 16);
+}
+
+QString contextFingerprint(QString const& context)
+{
+	QByteArray const digest(
+		QCryptographicHash::hash(
+			context.toUtf8(), QCryptographicHash::Md5
+		).toHex()
+	);
+	return QString::fromAscii(digest.constData(), digest.size());
+}
+
+} // anonymous namespace
+
+
+AnalysisCache&
+AnalysisCache::instance()
+{
+	// Lives until the process exits, saving any unsaved
+	// entries on the way out.
+	static AnalysisCache object;
+
+	return object;
+}
+
+AnalysisCache::AnalysisCache()
+:	m_loaded(false),
+	m_dirty(false)
+{
+}
+
+AnalysisCache::~AnalysisCache()
+{
+	saveIfDirty();
+}
+
+bool
+AnalysisCache::lookup(
+	ImageId const& image_id, QString const& stage, int const version,
+	QString const& context, QDomDocument& value_owner, QDomElement& value)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (!ensureLoadedLocked()) {
+		return false;
+	}
+
+	QString const key(keyForLocked(image_id, stage, version, context));
+	if (key.isEmpty()) {
+		return false;
+	}
+
+	Map::const_iterator const it(m_entries.find(key));
+	if (it == m_entries.end()) {
+		return false;
+	}
+
+	if (!value_owner.setContent(it->second)) {
+		return false;
+	}
+	value = value_owner.documentElement();
+
+	return !value.isNull();
+}
+
+void
+AnalysisCache::store(
+	ImageId const& image_id, QString const& stage, int const version,
+	QString const& context, QDomElement const& value)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (!ensureLoadedLocked()) {
+		return;
+	}
+
+	QString const key(keyForLocked(image_id, stage, version, context));
+	if (key.isEmpty()) {
+		return;
+	}
+
+	QDomDocument doc;
+	doc.appendChild(doc.importNode(value, true));
+
+	m_entries[key] = doc.toString();
+	m_dirty = true;
+}
+
+void
+AnalysisCache::saveIfDirty()
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (!m_dirty) {
+		return;
+	}
+
+	QDomDocument doc;
+	QDomElement root(doc.createElement("analysis-cache"));
+	doc.appendChild(root);
+
+	Map::const_iterator it(m_entries.begin());
+	Map::const_iterator const end(m_entries.end());
+	for (; it != end; ++it) {
+		QDomDocument value_doc;
+		if (!value_doc.setContent(it->second)) {
+			continue;
+		}
+
+		QDomElement entry(doc.createElement("entry"));
+		entry.setAttribute("key", it->first);
+		entry.appendChild(doc.importNode(value_doc.documentElement(), true));
+		root.appendChild(entry);
+	}
+
+	AtomicFileOverwriter overwriter;
+	QIODevice* const iodev = overwriter.startWriting(m_filePath);
+	if (!iodev) {
+		return;
+	}
+
+	QTextStream strm(iodev);
+	doc.save(strm, 2);
+	strm.flush();
+	if (overwriter.commit()) {
+		m_dirty = false;
+	}
+}
+
+bool
+AnalysisCache::ensureLoadedLocked()
+{
+	if (m_loaded) {
+		return !m_filePath.isEmpty();
+	}
+	m_loaded = true;
+
+	m_filePath = CommandLine::get().getAnalysisCacheFile();
+	if (m_filePath.isEmpty()) {
+		return false;
+	}
+
+	QFile file(m_filePath);
+	if (!file.open(QIODevice::ReadOnly)) {
+		// Starting from an empty cache is fine.
+		return true;
+	}
+
+	QDomDocument doc;
+	if (!doc.setContent(&file)) {
+		return true;
+	}
+
+	QDomElement entry(
+		doc.documentElement().firstChildElement("entry")
+	);
+	for (; !entry.isNull(); entry = entry.nextSiblingElement("entry")) {
+		QString const key(entry.attribute("key"));
+		QDomElement const value(entry.firstChildElement());
+		if (key.isEmpty() || value.isNull()) {
+			continue;
+		}
+
+		QDomDocument value_doc;
+		value_doc.appendChild(value_doc.importNode(value, true));
+		m_entries[key] = value_doc.toString();
+	}
+
+	return true;
+}
+
+QString
+AnalysisCache::keyForLocked(
+	ImageId const& image_id, QString const& stage, int const version,
+	QString const& context)
+{
+	QString content_hash;
+	HashCache::const_iterator const it(
+		m_contentHashes.find(image_id.filePath())
+	);
+	if (it != m_contentHashes.end()) {
+		content_hash = it->second;
+	} else {
+		content_hash = contentHashOf(image_id.filePath());
+		m_contentHashes[image_id.filePath()] = content_hash;
+	}
+	if (content_hash.isEmpty()) {
+		return QString();
+	}
+
+	QString key(content_hash);
+	key += QChar(':');
+	key += QString::number(image_id.zeroBasedPage());
+	key += QChar(':');
+	key += stage;
+	key += QLatin1String(":v");
+	key += QString::number(version);
+	key += QChar(':');
+	key += contextFingerprint(context);
+
+	return key;
+}
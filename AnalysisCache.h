@@ -0,0 +1,102 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANALYSIS_CACHE_H_
+#define ANALYSIS_CACHE_H_
+
+#include "NonCopyable.h"
+#include <QString>
+#include <QMutex>
+#include <QDomDocument>
+#include <map>
+
+class ImageId;
+class QDomElement;
+
+/**
+ * \brief A sidecar cache of per-page analysis results.
+ *
+ * Automatic analysis - skew detection, content box detection, page
+ * layout estimation - is redone from scratch whenever a project is
+ * recreated over the same scans or processed on a fresh machine.
+ * This cache stores those results in a sidecar XML file, keyed by a
+ * content hash of the source image plus a fingerprint of the inputs
+ * the analysis depends on and an algorithm version, so a matching
+ * entry is valid regardless of file paths, timestamps or which
+ * machine produced it.
+ *
+ * The cache is only active when --analysis-cache=<file> is given on
+ * the command line; otherwise lookups miss and stores are dropped.
+ * All methods are thread-safe.
+ */
+class AnalysisCache
+{
+	DECLARE_NON_COPYABLE(AnalysisCache)
+public:
+	static AnalysisCache& instance();
+
+	/**
+	 * \brief Looks up a previously stored analysis result.
+	 *
+	 * On a hit, \p value is set to an element owned by
+	 * \p value_owner and true is returned.  \p context is a
+	 * serialized form of whatever the analysis depends on
+	 * besides the image content - typically the stage's
+	 * Dependencies XML.
+	 */
+	bool lookup(
+		ImageId const& image_id, QString const& stage, int version,
+		QString const& context, QDomDocument& value_owner, QDomElement& value);
+
+	/**
+	 * \brief Stores an analysis result, replacing any previous one.
+	 */
+	void store(
+		ImageId const& image_id, QString const& stage, int version,
+		QString const& context, QDomElement const& value);
+
+	/**
+	 * \brief Writes the cache file if anything was stored since
+	 *        the last save.
+	 */
+	void saveIfDirty();
+private:
+	AnalysisCache();
+
+	~AnalysisCache();
+
+	/** Must be called with the mutex held. */
+	bool ensureLoadedLocked();
+
+	/** Must be called with the mutex held. */
+	QString keyForLocked(
+		ImageId const& image_id, QString const& stage, int version,
+		QString const& context);
+
+	typedef std::map<QString, QString> Map;
+	typedef std::map<QString, QString> HashCache;
+
+	QMutex m_mutex;
+	QString m_filePath;
+	Map m_entries; /**< key => serialized value element */
+	HashCache m_contentHashes; /**< source file path => content hash */
+	bool m_loaded;
+	bool m_dirty;
+};
+
+#endif
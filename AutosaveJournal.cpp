@@ -0,0 +1,260 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AutosaveJournal.h"
+#include "ImageId.h"
+#include <QByteArray>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+
+static quint32 const JOURNAL_MAGIC = 0x53544A4C; // "STJL"
+static quint16 const JOURNAL_VERSION = 1;
+
+namespace
+{
+
+struct JournalState
+{
+	QMutex mutex;
+	QFile file;
+	QDataStream stream;
+	bool open;
+
+	JournalState() : open(false) {}
+};
+
+JournalState&
+journalState()
+{
+	static JournalState state;
+	return state;
+}
+
+void
+closeLocked(JournalState& state)
+{
+	state.stream.setDevice(0);
+	state.file.close();
+	state.open = false;
+}
+
+/**
+ * Fetches the identity under which a base file is recorded in the
+ * journal header.  Size plus modification time is cheap and catches
+ * every way the base can legitimately change.
+ */
+bool
+baseIdentity(QString const& base_file, qint64& size, quint32& mtime)
+{
+	QFileInfo const info(base_file);
+	if (!info.exists()) {
+		return false;
+	}
+	size = info.size();
+	mtime = info.lastModified().toTime_t();
+	return true;
+}
+
+/**
+ * Returns true if the journal at \p path exists and is bound to
+ * a base file of the given identity.
+ */
+bool
+headerMatches(QString const& path, qint64 const size, quint32 const mtime)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	QDataStream stream(&file);
+	quint32 magic = 0;
+	quint16 version = 0;
+	qint64 base_size = 0;
+	quint32 base_mtime = 0;
+	stream >> magic >> version >> base_size >> base_mtime;
+
+	return stream.status() == QDataStream::Ok
+		&& magic == JOURNAL_MAGIC && version == JOURNAL_VERSION
+		&& base_size == size && base_mtime == mtime;
+}
+
+} // anonymous namespace
+
+
+/*============================= AutosaveJournal ===========================*/
+
+QString
+AutosaveJournal::journalPathFor(QString const& project_file)
+{
+	return project_file + ".journal";
+}
+
+void
+AutosaveJournal::open(
+	QString const& project_file, QString const& base_file,
+	bool const append_if_matching)
+{
+	JournalState& state = journalState();
+	QMutexLocker const locker(&state.mutex);
+
+	closeLocked(state);
+
+	if (project_file.isEmpty()) {
+		return;
+	}
+
+	qint64 base_size = 0;
+	quint32 base_mtime = 0;
+	if (!baseIdentity(base_file, base_size, base_mtime)) {
+		return;
+	}
+
+	QString const path(journalPathFor(project_file));
+	state.file.setFileName(path);
+
+	if (append_if_matching && headerMatches(path, base_size, base_mtime)) {
+		if (state.file.open(QIODevice::WriteOnly|QIODevice::Append)) {
+			state.stream.setDevice(&state.file);
+			state.open = true;
+		}
+		return;
+	}
+
+	if (!state.file.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+		return;
+	}
+	state.stream.setDevice(&state.file);
+	state.stream << JOURNAL_MAGIC << JOURNAL_VERSION << base_size << base_mtime;
+	state.open = state.file.flush()
+		&& state.stream.status() == QDataStream::Ok;
+	if (!state.open) {
+		closeLocked(state);
+	}
+}
+
+void
+AutosaveJournal::close()
+{
+	JournalState& state = journalState();
+	QMutexLocker const locker(&state.mutex);
+	closeLocked(state);
+}
+
+void
+AutosaveJournal::appendZones(
+	PageId const& page_id, ZoneKind const kind, QString const& zones_xml)
+{
+	JournalState& state = journalState();
+	QMutexLocker const locker(&state.mutex);
+
+	if (!state.open) {
+		return;
+	}
+
+	QByteArray const compressed(qCompress(zones_xml.toUtf8()));
+
+	state.stream << (quint8)kind
+		<< page_id.imageId().filePath()
+		<< (qint32)page_id.imageId().page()
+		<< page_id.subPageAsString()
+		<< qChecksum(compressed.constData(), compressed.size())
+		<< compressed;
+
+	if (state.stream.status() != QDataStream::Ok || !state.file.flush()) {
+		// A half-written record at the end is harmless - the reader
+		// ignores it - but there is no point in appending after it.
+		closeLocked(state);
+	}
+}
+
+
+/*========================== AutosaveJournalReader ========================*/
+
+AutosaveJournalReader::AutosaveJournalReader(
+	QString const& project_file, QString const& base_file)
+:	m_file(AutosaveJournal::journalPathFor(project_file)),
+	m_valid(false)
+{
+	qint64 base_size = 0;
+	quint32 base_mtime = 0;
+	if (!baseIdentity(base_file, base_size, base_mtime)) {
+		return;
+	}
+
+	if (!m_file.open(QIODevice::ReadOnly)) {
+		return;
+	}
+	m_stream.setDevice(&m_file);
+
+	quint32 magic = 0;
+	quint16 version = 0;
+	qint64 journal_base_size = 0;
+	quint32 journal_base_mtime = 0;
+	m_stream >> magic >> version >> journal_base_size >> journal_base_mtime;
+
+	m_valid = m_stream.status() == QDataStream::Ok
+		&& magic == JOURNAL_MAGIC && version == JOURNAL_VERSION
+		&& journal_base_size == base_size && journal_base_mtime == base_mtime;
+}
+
+bool
+AutosaveJournalReader::next(Record& record)
+{
+	if (!m_valid || m_stream.atEnd()) {
+		return false;
+	}
+
+	quint8 kind = 0;
+	QString file_path;
+	qint32 page = 0;
+	QString sub_page_str;
+	quint16 checksum = 0;
+	QByteArray compressed;
+	m_stream >> kind >> file_path >> page >> sub_page_str
+		>> checksum >> compressed;
+
+	if (m_stream.status() != QDataStream::Ok) {
+		// Typically a record cut short by a crash.
+		m_valid = false;
+		return false;
+	}
+	if (checksum != qChecksum(compressed.constData(), compressed.size())) {
+		m_valid = false;
+		return false;
+	}
+
+	bool sub_page_ok = false;
+	PageId::SubPage const sub_page(
+		PageId::subPageFromString(sub_page_str, &sub_page_ok)
+	);
+	if (!sub_page_ok || kind > AutosaveJournal::FILL_ZONES) {
+		m_valid = false;
+		return false;
+	}
+
+	QByteArray const xml(qUncompress(compressed));
+
+	record.pageId = PageId(ImageId(file_path, page), sub_page);
+	record.zoneKind = AutosaveJournal::ZoneKind(kind);
+	record.zonesXml = QString::fromUtf8(xml.constData(), xml.size());
+
+	return true;
+}
@@ -0,0 +1,123 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AUTOSAVE_JOURNAL_H_
+#define AUTOSAVE_JOURNAL_H_
+
+#include "PageId.h"
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+
+/**
+ * \brief An append-only journal of zone edits, replayable over the last save.
+ *
+ * The periodic autosave bounds the damage of a crash to a minute of
+ * work, but a minute is still enough to lose a just-finished manual
+ * zone - historically our most painful kind of loss, as zones are the
+ * most labor-intensive thing to recreate.  The journal closes that
+ * window: every committed zone edit is appended and flushed to
+ * \<project\>.journal immediately, as a small self-contained record.
+ *
+ * The file starts with a magic number, a format version and the size
+ * and modification time of the base file - the project save or
+ * autosave snapshot the journal extends.  Each record carries the page
+ * identity in clear, followed by a checksummed, qCompress()ed XML
+ * serialization of the full zone set after the edit, so records are
+ * idempotent and the last one per page and zone kind wins.  A record
+ * truncated by a crash is simply ignored.
+ *
+ * On project open, a journal whose header matches the file actually
+ * loaded is replayed on top of it and then extended further; one
+ * bound to some other state of the project is ignored.  An explicit
+ * save or a completed autosave snapshot starts the journal over,
+ * bound to the file just written.
+ */
+class AutosaveJournal
+{
+public:
+	enum ZoneKind { PICTURE_ZONES, FILL_ZONES };
+
+	static QString journalPathFor(QString const& project_file);
+
+	/**
+	 * \brief Starts journalling for a project, superseding any
+	 *        previous journal.
+	 *
+	 * The journal is bound to the current on-disk state of
+	 * \p base_file.  With \p append_if_matching set, an existing
+	 * journal already bound to that state is kept and extended -
+	 * the project-open case, where its records were just replayed
+	 * and still represent unsaved work.  Otherwise the journal is
+	 * truncated.  On any error journalling is silently disabled:
+	 * the periodic autosave remains as the safety net.
+	 */
+	static void open(
+		QString const& project_file, QString const& base_file,
+		bool append_if_matching);
+
+	/**
+	 * \brief Stops journalling.  The journal file is left alone.
+	 */
+	static void close();
+
+	/**
+	 * \brief Appends the new zone set of a page, durably.
+	 *
+	 * \p zones_xml is the serialized \<zones\> element.  Does
+	 * nothing if no journal is open.  Thread-safe.
+	 */
+	static void appendZones(
+		PageId const& page_id, ZoneKind kind, QString const& zones_xml);
+};
+
+
+/**
+ * \brief Reads an autosave journal back, record by record.
+ *
+ * Reading stops silently at the first damaged or truncated record,
+ * keeping everything before it.
+ */
+class AutosaveJournalReader
+{
+public:
+	struct Record
+	{
+		PageId pageId;
+		AutosaveJournal::ZoneKind zoneKind;
+		QString zonesXml;
+	};
+
+	/**
+	 * Opens the journal of \p project_file, provided its header
+	 * matches the current on-disk state of \p base_file.  Otherwise
+	 * next() just returns false.
+	 */
+	AutosaveJournalReader(QString const& project_file, QString const& base_file);
+
+	/**
+	 * \brief Fetches the next record, returning false when there are no more.
+	 */
+	bool next(Record& record);
+private:
+	QFile m_file;
+	QDataStream m_stream;
+	bool m_valid;
+};
+
+#endif
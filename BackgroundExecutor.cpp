@@ -18,47 +18,97 @@
 
 #include "BackgroundExecutor.h"
 #include "OutOfMemoryHandler.h"
+#include "SpscRing.h"
+#include "WorkerTopology.h"
 #include <QCoreApplication>
 #include <QObject>
 #include <QThread>
 #include <QEvent>
+#include <vector>
 #include <new>
+#include <stddef.h>
 #include <assert.h>
 
 class BackgroundExecutor::Dispatcher : public QObject
 {
 public:
 	Dispatcher(Impl& owner);
+
+	~Dispatcher();
+
+	/**
+	 * The producer side of the handoff.  To be called from the
+	 * thread that owns the executor, and no other.
+	 */
+	void enqueueTask(TaskPtr const& task);
 protected:
 	virtual void customEvent(QEvent* event);
 private:
+	static unsigned const RING_CAPACITY = 256;
+
 	Impl& m_rOwner;
+
+	/**
+	 * Tasks are handed to the worker through a lock-free ring rather
+	 * than as per-task events: posting through the event loop costs
+	 * around a millisecond of queuing jitter per task, which starts
+	 * to matter once tasks shrink.  The ring holds a reference to
+	 * each queued command.
+	 */
+	SpscRing<AbstractCommand0<TaskResultPtr>*> m_ring;
+
+	/**
+	 * Nonzero while a wakeup event is in flight or being handled.
+	 * Lets us post through the event loop only on empty-to-nonempty
+	 * transitions instead of once per task.
+	 */
+	QAtomicInt m_wakeupPosted;
 };
 
 
-class BackgroundExecutor::Impl : public QThread
+class BackgroundExecutor::Impl : public QObject
 {
 public:
-	Impl(BackgroundExecutor& owner);
-	
+	Impl(BackgroundExecutor& owner, int num_threads);
+
 	~Impl();
-	
+
+	int numThreads() const { return static_cast<int>(m_workers.size()); }
+
 	void enqueueTask(TaskPtr const& task);
 protected:
-	virtual void run();
-	
 	virtual void customEvent(QEvent* event);
 private:
+	class Worker : public QThread
+	{
+	public:
+		Worker(Impl& owner, int index)
+		:	m_dispatcher(owner), m_index(index) {
+			m_dispatcher.moveToThread(this);
+		}
+
+		Dispatcher& dispatcher() { return m_dispatcher; }
+	protected:
+		virtual void run() {
+			WorkerTopology::instance().pinCurrentThread(m_index);
+			exec();
+		}
+	private:
+		Dispatcher m_dispatcher;
+		int m_index;
+	};
+
 	BackgroundExecutor& m_rOwner;
-	Dispatcher m_dispatcher;
-	bool m_threadStarted;
+	std::vector<Worker*> m_workers;
+	size_t m_nextWorker;
+	bool m_threadsStarted;
 };
 
 
 /*============================ BackgroundExecutor ==========================*/
 
-BackgroundExecutor::BackgroundExecutor()
-:	m_ptrImpl(new Impl(*this))
+BackgroundExecutor::BackgroundExecutor(int num_threads)
+:	m_ptrImpl(new Impl(*this, num_threads))
 {
 }
 
@@ -80,66 +130,130 @@ BackgroundExecutor::enqueueTask(TaskPtr const& task)
 	}
 }
 
+int
+BackgroundExecutor::numThreads() const
+{
+	return m_ptrImpl.get() ? m_ptrImpl->numThreads() : 0;
+}
+
 
 /*===================== BackgroundExecutor::Dispatcher =====================*/
 
 BackgroundExecutor::Dispatcher::Dispatcher(Impl& owner)
-:	m_rOwner(owner)
+:	m_rOwner(owner),
+	m_ring(RING_CAPACITY)
 {
 }
 
+BackgroundExecutor::Dispatcher::~Dispatcher()
+{
+	// By now the worker thread is gone.  Drop the references held
+	// by whatever tasks were still queued.
+	AbstractCommand0<TaskResultPtr>* cmd;
+	while (m_ring.pop(cmd)) {
+		intrusive_unref(*cmd);
+	}
+}
+
+void
+BackgroundExecutor::Dispatcher::enqueueTask(TaskPtr const& task)
+{
+	AbstractCommand0<TaskResultPtr>* const cmd = task.get();
+	intrusive_ref(*cmd); // The reference the ring is going to hold.
+
+	while (!m_ring.push(cmd)) {
+		// Hundreds of tasks stacked up on a single worker.  Backing
+		// off until it drains a slot is simpler than an unbounded
+		// ring, and at this depth the handoff cost is irrelevant
+		// anyway.
+		QThread::yieldCurrentThread();
+	}
+
+	// A single wakeup covers any number of queued tasks: whoever
+	// handles it keeps draining the ring.  Only post another one
+	// when none is in flight.
+	if (m_wakeupPosted.testAndSetOrdered(0, 1)) {
+		QCoreApplication::postEvent(this, new QEvent(QEvent::User));
+	}
+}
+
 void
 BackgroundExecutor::Dispatcher::customEvent(QEvent* event)
 {
-	try {
-		TaskEvent* evt = dynamic_cast<TaskEvent*>(event);
-		assert(evt);
-
-		TaskPtr const& task = evt->payload();
-		assert(task);
-
-		TaskResultPtr const result((*task)());
-		if (result) {
-			QCoreApplication::postEvent(
-				&m_rOwner, new ResultEvent(result)
-			);
+	// Clearing the flag before the final empty check of the drain
+	// loop below means a producer that pushes after we stopped
+	// draining will succeed in posting a fresh wakeup.
+	m_wakeupPosted.fetchAndStoreOrdered(0);
+
+	AbstractCommand0<TaskResultPtr>* cmd;
+	while (m_ring.pop(cmd)) {
+		// Adoption transfers the ring's reference to us without
+		// touching the counter.
+		TaskPtr const task(cmd, TaskPtr::ADOPT);
+
+		try {
+			TaskResultPtr const result((*task)());
+			if (result) {
+				QCoreApplication::postEvent(
+					&m_rOwner, new ResultEvent(result)
+				);
+			}
+		} catch (std::bad_alloc const&) {
+			OutOfMemoryHandler::instance().handleOutOfMemorySituation();
 		}
-	} catch (std::bad_alloc const&) {
-		OutOfMemoryHandler::instance().handleOutOfMemorySituation();
 	}
 }
 
 
 /*======================= BackgroundExecutor::Impl =========================*/
 
-BackgroundExecutor::Impl::Impl(BackgroundExecutor& owner)
+BackgroundExecutor::Impl::Impl(BackgroundExecutor& owner, int num_threads)
 :	m_rOwner(owner),
-	m_dispatcher(*this),
-	m_threadStarted(false)
+	m_nextWorker(0),
+	m_threadsStarted(false)
 {
-	m_dispatcher.moveToThread(this);
+	if (num_threads < 1) {
+		num_threads = QThread::idealThreadCount();
+		if (num_threads < 1) {
+			num_threads = 1;
+		}
+	}
+
+	m_workers.reserve(num_threads);
+	for (int i = 0; i < num_threads; ++i) {
+		m_workers.push_back(new Worker(*this, i));
+	}
 }
 
 BackgroundExecutor::Impl::~Impl()
 {
-	exit();
-	wait();
+	size_t const num_workers = m_workers.size();
+	for (size_t i = 0; i < num_workers; ++i) {
+		m_workers[i]->exit();
+	}
+	for (size_t i = 0; i < num_workers; ++i) {
+		m_workers[i]->wait();
+		delete m_workers[i];
+	}
 }
 
 void
 BackgroundExecutor::Impl::enqueueTask(TaskPtr const& task)
 {
-	QCoreApplication::postEvent(&m_dispatcher, new TaskEvent(task));
-	if (!m_threadStarted) {
-		start();
-		m_threadStarted = true;
-	}
-}
+	// Round-robin dispatch.  Each worker drains its own ring, so
+	// consecutive tasks land on different threads and may run
+	// concurrently.
+	Worker* worker = m_workers[m_nextWorker];
+	m_nextWorker = (m_nextWorker + 1) % m_workers.size();
 
-void
-BackgroundExecutor::Impl::run()
-{
-	exec();
+	worker->dispatcher().enqueueTask(task);
+	if (!m_threadsStarted) {
+		size_t const num_workers = m_workers.size();
+		for (size_t i = 0; i < num_workers; ++i) {
+			m_workers[i]->start();
+		}
+		m_threadsStarted = true;
+	}
 }
 
 void
@@ -147,9 +261,9 @@ BackgroundExecutor::Impl::customEvent(QEvent* event)
 {
 	ResultEvent* evt = dynamic_cast<ResultEvent*>(event);
 	assert(evt);
-	
+
 	TaskResultPtr const& result = evt->payload();
 	assert(result);
-	
+
 	(*result)();
 }
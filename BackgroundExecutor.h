@@ -31,8 +31,15 @@ class BackgroundExecutor
 public:
 	typedef IntrusivePtr<AbstractCommand0<void> > TaskResultPtr;
 	typedef IntrusivePtr<AbstractCommand0<TaskResultPtr> > TaskPtr;
-	
-	BackgroundExecutor();
+
+	/**
+	 * \brief Construct an executor backed by a pool of worker threads.
+	 *
+	 * \param num_threads The number of worker threads to use.  Zero
+	 *        (the default) means one thread per CPU core, as reported
+	 *        by QThread::idealThreadCount().
+	 */
+	BackgroundExecutor(int num_threads = 0);
 	
 	/**
 	 * \brief Waits for background tasks to finish, then destroys the object.
@@ -40,27 +47,37 @@ public:
 	~BackgroundExecutor();
 	
 	/**
-	 * \brief Waits for pending jobs to finish and stop the background thread.
+	 * \brief Waits for pending jobs to finish and stop the worker threads.
 	 *
 	 * The destructor also performs these tasks, so this method is only
 	 * useful to prematuraly stop task processing.  After shutdown, any
 	 * attempts to enqueue a task will be silently ignored.
 	 */
 	void shutdown();
-	
+
 	/**
 	 * \brief Enqueue a task for execution in a background thread.
 	 *
 	 * A task is a functor to be executed in a background thread.
 	 * That functor may optionally return another one, that is
 	 * to be executed in the thread where this BackgroundExecutor
-	 * object was constructed.
+	 * object was constructed.  Tasks are distributed across the
+	 * worker pool, so tasks enqueued one after another may execute
+	 * concurrently.
+	 *
+	 * To be called from the thread this object was constructed in.
+	 * The per-worker handoff is a single-producer ring, and that
+	 * thread is the producer.
 	 */
 	void enqueueTask(TaskPtr const& task);
+
+	/**
+	 * \brief The number of worker threads backing this executor.
+	 */
+	int numThreads() const;
 private:
 	class Impl;
 	class Dispatcher;
-	typedef PayloadEvent<TaskPtr> TaskEvent;
 	typedef PayloadEvent<TaskResultPtr> ResultEvent;
 	
 	std::auto_ptr<Impl> m_ptrImpl;
@@ -0,0 +1,85 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+
+    BatchJournal - Per-page completion journal for resumable batch runs.
+    Copyright (C) 2011 Petr Kovar <pejuko@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BatchJournal.h"
+#include "CrashContext.h"
+#include <QMutexLocker>
+#include <QTextStream>
+
+BatchJournal::BatchJournal(QString const& journal_path)
+:	m_file(journal_path)
+{
+	if (m_file.open(QIODevice::ReadWrite)) {
+		QTextStream strm(&m_file);
+		strm.setCodec("UTF-8");
+		while (!strm.atEnd()) {
+			QString const line(strm.readLine().trimmed());
+			if (!line.isEmpty()) {
+				m_completed.insert(line);
+			}
+		}
+		// Leave the file positioned at the end for appending.
+	}
+}
+
+BatchJournal::~BatchJournal()
+{
+}
+
+bool
+BatchJournal::isComplete(QString const& key) const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	return m_completed.find(key) != m_completed.end();
+}
+
+void
+BatchJournal::markComplete(QString const& key)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (!m_completed.insert(key).second) {
+		return;
+	}
+
+	if (m_file.isOpen()) {
+		QTextStream strm(&m_file);
+		strm.setCodec("UTF-8");
+		strm << key << '\n';
+		strm.flush();
+		m_file.flush();
+	}
+
+	// Mirror our position into the crash context, so a crash dump
+	// can name the page the run died on.
+	CrashContext::noteJournalPosition(key, m_completed.size());
+}
+
+void
+BatchJournal::clear()
+{
+	QMutexLocker const locker(&m_mutex);
+
+	m_completed.clear();
+	if (m_file.isOpen()) {
+		m_file.resize(0);
+	}
+}
@@ -0,0 +1,72 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+
+    BatchJournal - Per-page completion journal for resumable batch runs.
+    Copyright (C) 2011 Petr Kovar <pejuko@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BATCHJOURNAL_H_
+#define BATCHJOURNAL_H_
+
+#include "NonCopyable.h"
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <set>
+
+/**
+ * \brief Records which pages of a batch run have produced valid output.
+ *
+ * One line is appended and flushed per completed page, so if the run
+ * dies (power loss, OOM), a restarted run with --resume can skip the
+ * pages that already finished.  Pages are keyed by their output file
+ * path, which is deterministic for a given project.
+ */
+class BatchJournal
+{
+	DECLARE_NON_COPYABLE(BatchJournal)
+public:
+	/**
+	 * Opens the journal file for appending, reading in any
+	 * entries left by a previous run.
+	 */
+	BatchJournal(QString const& journal_path);
+
+	~BatchJournal();
+
+	/**
+	 * \brief Whether a previous run recorded this page as complete.
+	 */
+	bool isComplete(QString const& key) const;
+
+	/**
+	 * \brief Record a page as complete, flushing to disk immediately.
+	 *
+	 * May be called from multiple worker threads.
+	 */
+	void markComplete(QString const& key);
+
+	/**
+	 * \brief Forget all recorded completions and truncate the file.
+	 */
+	void clear();
+private:
+	mutable QMutex m_mutex;
+	QFile m_file;
+	std::set<QString> m_completed;
+};
+
+#endif
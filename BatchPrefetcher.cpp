@@ -0,0 +1,76 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BatchPrefetcher.h"
+#include "ImageLoader.h"
+#include <QThread>
+
+class BatchPrefetcher::PrefetchThread : public QThread
+{
+public:
+	PrefetchThread(ImageId const& image_id) : m_imageId(image_id) {}
+
+	ImageId const& imageId() const { return m_imageId; }
+
+	QImage const& image() const { return m_image; }
+protected:
+	virtual void run() { m_image = ImageLoader::load(m_imageId); }
+private:
+	ImageId m_imageId;
+	QImage m_image;
+};
+
+
+BatchPrefetcher::BatchPrefetcher()
+{
+}
+
+BatchPrefetcher::~BatchPrefetcher()
+{
+	if (m_ptrThread.get()) {
+		m_ptrThread->wait();
+	}
+}
+
+void
+BatchPrefetcher::prefetch(ImageId const& image_id)
+{
+	if (m_ptrThread.get()) {
+		if (m_ptrThread->imageId() == image_id) {
+			return;
+		}
+		m_ptrThread->wait();
+	}
+
+	m_ptrThread.reset(new PrefetchThread(image_id));
+	m_ptrThread->start(QThread::LowPriority);
+}
+
+QImage
+BatchPrefetcher::retrieve(ImageId const& image_id)
+{
+	if (!m_ptrThread.get() || !(m_ptrThread->imageId() == image_id)) {
+		return QImage();
+	}
+
+	m_ptrThread->wait();
+	QImage const image(m_ptrThread->image());
+	m_ptrThread.reset();
+
+	return image;
+}
@@ -0,0 +1,66 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BATCHPREFETCHER_H_
+#define BATCHPREFETCHER_H_
+
+#include "NonCopyable.h"
+#include "ImageId.h"
+#include <QImage>
+#include <memory>
+
+/**
+ * \brief Decodes the image of an upcoming batch page ahead of time.
+ *
+ * While the current page is being processed, the image of the next
+ * page in the batch queue is decoded on a helper thread, so that
+ * LoadFileTask finds it ready instead of blocking on disk I/O.
+ */
+class BatchPrefetcher
+{
+	DECLARE_NON_COPYABLE(BatchPrefetcher)
+public:
+	BatchPrefetcher();
+
+	/**
+	 * \brief Waits for an in-flight prefetch, then destroys the object.
+	 */
+	~BatchPrefetcher();
+
+	/**
+	 * \brief Start decoding the given image in the background.
+	 *
+	 * Requesting the image that's already being prefetched is a no-op.
+	 * Requesting a different one discards the previous prefetch.
+	 */
+	void prefetch(ImageId const& image_id);
+
+	/**
+	 * \brief Retrieve a prefetched image.
+	 *
+	 * If the requested image is still being decoded, waits for it.
+	 * Returns a null QImage if this image was never prefetched.
+	 */
+	QImage retrieve(ImageId const& image_id);
+private:
+	class PrefetchThread;
+
+	std::auto_ptr<PrefetchThread> m_ptrThread;
+};
+
+#endif
@@ -26,6 +26,7 @@
 #include <QMap>
 #include <QRegExp>
 #include <QStringList>
+#include <QThread>
 
 #include "Dpi.h"
 #include "ImageId.h"
@@ -166,6 +167,10 @@ CommandLine::setup()
 	m_deskewAngle = fetchDeskewAngle();
 	m_startFilterIdx = fetchStartFilterIdx();
 	m_endFilterIdx = fetchEndFilterIdx();
+	m_jobs = fetchJobs();
+	fetchShard();
+	m_tileMemoryLimit = fetchTileMemoryLimit();
+	m_batchMemoryLimit = fetchBatchMemoryLimit();
 }
 
 
@@ -232,6 +237,28 @@ CommandLine::printHelp()
 	std::cout << "\t--depth-perception=<1.0...3.0>\t\t-- default: 2.0" << "\n";
 	std::cout << "\t--start-filter=<1...6>\t\t\t-- default: 4" << "\n";
 	std::cout << "\t--end-filter=<1...6>\t\t\t-- default: 6" << "\n";
+	std::cout << "\t--jobs=<0...>\t\t\t\t-- number of pages to process in parallel;\n\t\t\t\t\t\t   0 means one per CPU core; default: 1" << "\n";
+	std::cout << "\t--batch-memory=<MB>\t\t\t-- hold back parallel jobs when the\n\t\t\t\t\t\t   estimated memory use of pages in\n\t\t\t\t\t\t   flight would exceed this budget;\n\t\t\t\t\t\t   0 (default) disables" << "\n";
+	std::cout << "\t--resume\t\t\t\t-- skip pages recorded as complete\n\t\t\t\t\t\t   by an interrupted batch run" << "\n";
+	std::cout << "\t--verify\t\t\t\t-- check that all images referenced\n\t\t\t\t\t\t   by the project exist, match their\n\t\t\t\t\t\t   recorded dimensions / DPI and that\n\t\t\t\t\t\t   cached output files are intact,\n\t\t\t\t\t\t   then exit; nothing is processed" << "\n";
+	std::cout << "\t--shard=<i/n>\t\t\t\t-- process only every n-th page starting\n\t\t\t\t\t\t   at page i; run one shard per machine\n\t\t\t\t\t\t   against a shared project and output dir" << "\n";
+	std::cout << "\t--tile-memory=<MB>\t\t\t-- process memory-hungry output filters\n\t\t\t\t\t\t   in horizontal bands, capping their\n\t\t\t\t\t\t   temporary buffers at roughly this\n\t\t\t\t\t\t   many megabytes; 0 (default) disables" << "\n";
+	std::cout << "\t--analysis-cache=<file>\t\t\t-- reuse automatic analysis results\n\t\t\t\t\t\t   (skew, content box, page layout)\n\t\t\t\t\t\t   across sessions and machines via a\n\t\t\t\t\t\t   sidecar file keyed by image content" << "\n";
+	std::cout << "\t--huge-pages\t\t\t\t-- back large image buffers with 2MB\n\t\t\t\t\t\t   huge pages to reduce TLB pressure;\n\t\t\t\t\t\t   Linux only" << "\n";
+	std::cout << "\t--tiff-strip-height=<rows>\t\t-- rows per strip in output TIFF\n\t\t\t\t\t\t   files; strips are compressed in\n\t\t\t\t\t\t   parallel, so smaller strips spread\n\t\t\t\t\t\t   better over cores; default: 128" << "\n";
+	std::cout << "\t--output-format=<tiff|png>\t\t-- format of the output files;\n\t\t\t\t\t\t   also affects their extension;\n\t\t\t\t\t\t   default: tiff" << "\n";
+	std::cout << "\t--export-pdf=<file>\t\t\t-- additionally assemble the finished\n\t\t\t\t\t\t   pages into a PDF; pages are encoded\n\t\t\t\t\t\t   (G4 or JPEG) as they are produced,\n\t\t\t\t\t\t   avoiding a re-read of the output dir" << "\n";
+	std::cout << "\t--worker-affinity=<spec>\t\t-- pin worker threads to CPUs;\n\t\t\t\t\t\t   \"compact\" fills one NUMA node\n\t\t\t\t\t\t   before the next, \"spread\"\n\t\t\t\t\t\t   round-robins across nodes, or\n\t\t\t\t\t\t   give a CPU list like 0,2,4-7;\n\t\t\t\t\t\t   default: none (no pinning)" << "\n";
+	std::cout << "\t--shm-export=<key>\t\t\t-- additionally publish each finished\n\t\t\t\t\t\t   page as raw pixels into a shared\n\t\t\t\t\t\t   memory segment under <key>, for a\n\t\t\t\t\t\t   companion tool to pick up without\n\t\t\t\t\t\t   an encode/decode/disk round trip" << "\n";
+	std::cout << "\t--watch-folder=<dir>\t\t\t-- stay resident and continuously\n\t\t\t\t\t\t   process images appearing in <dir>\n\t\t\t\t\t\t   with the options given here; a file\n\t\t\t\t\t\t   is picked up once its size and mtime\n\t\t\t\t\t\t   stop changing" << "\n";
+	std::cout << "\t--watch-poll-interval=<seconds>\t\t-- how often --watch-folder checks\n\t\t\t\t\t\t   the folder; default: 5" << "\n";
+	std::cout << "\t--trace=<file>\t\t\t\t-- record a timeline of the run (one\n\t\t\t\t\t\t   span per page, stage and I/O\n\t\t\t\t\t\t   operation, one lane per thread) in\n\t\t\t\t\t\t   Chrome trace format; open the file\n\t\t\t\t\t\t   in chrome://tracing" << "\n";
+	std::cout << "\t--benchmark[=<N>]\t\t\t-- process everything N times (default\n\t\t\t\t\t\t   3) and report pages/minute, stage\n\t\t\t\t\t\t   latencies (mean/p95), peak RSS and\n\t\t\t\t\t\t   disk I/O per run; drop the OS caches\n\t\t\t\t\t\t   beforehand for a truly cold first run" << "\n";
+	std::cout << "\t--deterministic\t\t\t\t-- guarantee outputs bit-identical to\n\t\t\t\t\t\t   a serial run: image math runs\n\t\t\t\t\t\t   single-threaded while pages still\n\t\t\t\t\t\t   process in parallel (-j); costs a\n\t\t\t\t\t\t   few percent on a loaded machine" << "\n";
+	std::cout << "\t--golden-record=<manifest>\t\t-- after processing, record a hash of\n\t\t\t\t\t\t   each output file and the per-stage\n\t\t\t\t\t\t   timings into <manifest>, to be kept\n\t\t\t\t\t\t   under version control with the corpus" << "\n";
+	std::cout << "\t--golden-check=<manifest>\t\t-- after processing, fail (exit 1) if\n\t\t\t\t\t\t   any output file differs from the\n\t\t\t\t\t\t   recorded hash or a stage exceeds its\n\t\t\t\t\t\t   recorded time by more than the\n\t\t\t\t\t\t   tolerance" << "\n";
+	std::cout << "\t--golden-tolerance=<percent>\t\t-- allowed slowdown per stage for\n\t\t\t\t\t\t   --golden-check; default: 25" << "\n";
+	std::cout << "\t--detect-duplicates[=<distance>]\t-- flag consecutive near-duplicate\n\t\t\t\t\t\t   images (double-feeds) in the GUI\n\t\t\t\t\t\t   thumbnail list, comparing 64x64\n\t\t\t\t\t\t   binarized signatures; distances up\n\t\t\t\t\t\t   to <distance> (of 4096 bits) match;\n\t\t\t\t\t\t   default: 256" << "\n";
 	std::cout << "\t--output-project=, -o=<project_name>" << "\n";
 	std::cout << "\n";
 }
@@ -458,6 +485,68 @@ CommandLine::fetchEndFilterIdx()
 	return m_options.value("end-filter").toInt() - 1;
 }
 
+int
+CommandLine::fetchJobs()
+{
+	if (!hasJobs())
+		return 1;
+
+	int jobs = m_options.value("jobs").toInt();
+	if (jobs < 1) {
+		// --jobs=0 means one job per CPU core.
+		jobs = QThread::idealThreadCount();
+	}
+
+	return (jobs < 1) ? 1 : jobs;
+}
+
+size_t
+CommandLine::fetchTileMemoryLimit()
+{
+	if (!hasTileMemoryLimit())
+		return 0;
+
+	// The option is specified in megabytes.
+	return size_t(m_options.value("tile-memory").toUInt()) * 1024 * 1024;
+}
+
+size_t
+CommandLine::fetchBatchMemoryLimit()
+{
+	if (!hasBatchMemoryLimit())
+		return 0;
+
+	// The option is specified in megabytes.
+	return size_t(m_options.value("batch-memory").toUInt()) * 1024 * 1024;
+}
+
+void
+CommandLine::fetchShard()
+{
+	m_shardIndex = 0;
+	m_shardCount = 1;
+
+	if (!hasShard())
+		return;
+
+	// --shard=i/n: this machine takes pages i-1, i-1+n, i-1+2n, ...
+	QRegExp rx("^([0-9]+)/([0-9]+)$");
+	if (!rx.exactMatch(m_options.value("shard"))) {
+		std::cout << "Error: --shard must be in the form i/n, e.g. --shard=2/4" << "\n";
+		exit(1);
+	}
+
+	int const idx = rx.cap(1).toInt();
+	int const count = rx.cap(2).toInt();
+	if (count < 1 || idx < 1 || idx > count) {
+		std::cout << "Error: --shard index must be in the range 1..n" << "\n";
+		exit(1);
+	}
+
+	m_shardIndex = idx - 1;
+	m_shardCount = count;
+}
+
 output::DewarpingMode
 CommandLine::fetchDewarpingMode()
 {
@@ -24,6 +24,7 @@
 #include <QMap>
 #include <QRectF>
 #include <QStringList>
+#include <stddef.h>
 
 #include "Dpi.h"
 #include "filters/page_split/LayoutType.h"
@@ -69,6 +70,26 @@ public:
 	bool hasLayout() const { return contains("layout"); }
 	bool hasLayoutDirection() const { return contains("layout-direction"); }
 	bool hasStartFilterIdx() const { return contains("start-filter"); }
+	bool hasJobs() const { return contains("jobs"); }
+	bool hasResume() const { return contains("resume"); }
+	bool hasVerify() const { return contains("verify"); }
+	bool hasShard() const { return contains("shard"); }
+	bool hasTileMemoryLimit() const { return contains("tile-memory"); }
+	bool hasBatchMemoryLimit() const { return contains("batch-memory"); }
+	bool hasAnalysisCacheFile() const { return contains("analysis-cache"); }
+	bool hasTiffStripHeight() const { return contains("tiff-strip-height"); }
+	bool hasOutputFormat() const { return contains("output-format"); }
+	bool hasExportPdf() const { return contains("export-pdf"); }
+	bool hasShmExport() const { return contains("shm-export"); }
+	bool hasWorkerAffinity() const { return contains("worker-affinity"); }
+	bool hasWatchFolder() const { return contains("watch-folder"); }
+	bool hasTraceFile() const { return contains("trace"); }
+	bool hasBenchmark() const { return contains("benchmark"); }
+	bool hasGoldenRecord() const { return contains("golden-record"); }
+	bool hasGoldenCheck() const { return contains("golden-check"); }
+	bool hasHugePages() const { return contains("huge-pages"); }
+	bool hasDeterministic() const { return contains("deterministic"); }
+	bool hasDetectDuplicates() const { return contains("detect-duplicates"); }
 	bool hasEndFilterIdx() const { return contains("end-filter"); }
 	bool hasOrientation() const { return contains("orientation"); }
 	bool hasDeskewAngle() const { return contains("rotate"); }
@@ -96,6 +117,40 @@ public:
 	double getDeskewAngle() const { return m_deskewAngle; }
 	int getStartFilterIdx() const { return m_startFilterIdx; }
 	int getEndFilterIdx() const { return m_endFilterIdx; }
+	int getJobs() const { return m_jobs; }
+	int getShardIndex() const { return m_shardIndex; }
+	int getShardCount() const { return m_shardCount; }
+	size_t getTileMemoryLimit() const { return hasTileMemoryLimit() ? m_tileMemoryLimit : 0; }
+	size_t getBatchMemoryLimit() const { return hasBatchMemoryLimit() ? m_batchMemoryLimit : 0; }
+	QString getAnalysisCacheFile() const { return m_options.value("analysis-cache"); }
+	int getTiffStripHeight() const { return m_options.value("tiff-strip-height").toInt(); }
+	QString getOutputFormat() const { return m_options.value("output-format"); }
+	QString getExportPdfFile() const { return m_options.value("export-pdf"); }
+	QString getShmExportKey() const { return m_options.value("shm-export"); }
+	QString getWorkerAffinity() const { return m_options.value("worker-affinity"); }
+	QString getWatchFolder() const { return m_options.value("watch-folder"); }
+	int getWatchPollInterval() const {
+		int const secs = m_options.value("watch-poll-interval").toInt();
+		// Unset or malformed values parse as zero.
+		return secs < 1 ? 5 : secs;
+	}
+	QString getTraceFile() const { return m_options.value("trace"); }
+	int getBenchmarkRuns() const {
+		int const runs = m_options.value("benchmark").toInt();
+		// --benchmark without a value parses as zero.
+		return runs < 1 ? 3 : runs;
+	}
+	int getDuplicateMaxDistance() const {
+		int const distance = m_options.value("detect-duplicates").toInt();
+		// --detect-duplicates without a value parses as zero.
+		return distance < 1 ? 256 : distance;
+	}
+	QString getGoldenRecordFile() const { return m_options.value("golden-record"); }
+	QString getGoldenCheckFile() const { return m_options.value("golden-check"); }
+	double getGoldenTolerance() const {
+		double const tolerance = m_options.value("golden-tolerance").toDouble();
+		return tolerance <= 0.0 ? 25.0 : tolerance;
+	}
 	output::DewarpingMode getDewarpingMode() const { return m_dewarpingMode; }
 	output::DespeckleLevel getDespeckleLevel() const { return m_despeckleLevel; }
 	output::DepthPerception getDepthPerception() const { return m_depthPerception; }
@@ -137,6 +192,11 @@ private:
 	double m_deskewAngle;
 	int m_startFilterIdx;
 	int m_endFilterIdx;
+	int m_jobs;
+	int m_shardIndex;
+	int m_shardCount;
+	size_t m_tileMemoryLimit;
+	size_t m_batchMemoryLimit;
 	output::DewarpingMode m_dewarpingMode;
 	output::DespeckleLevel m_despeckleLevel;
 	output::DepthPerception m_depthPerception;
@@ -158,6 +218,10 @@ private:
 	double fetchDeskewAngle();
 	int fetchStartFilterIdx();
 	int fetchEndFilterIdx();
+	int fetchJobs();
+	void fetchShard();
+	size_t fetchTileMemoryLimit();
+	size_t fetchBatchMemoryLimit();
 	output::DewarpingMode fetchDewarpingMode();
 	output::DespeckleLevel fetchDespeckleLevel();
 	output::DepthPerception fetchDepthPerception();
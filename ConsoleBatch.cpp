@@ -19,9 +19,21 @@
 */
 
 #include <vector>
+#include <map>
 #include <iostream>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <assert.h>
 
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QTime>
+#include <QTextStream>
+
 #include "Utils.h"
 #include "ProjectPages.h"
 #include "PageSelectionAccessor.h"
@@ -31,6 +43,8 @@
 #include "OutputFileNameGenerator.h"
 #include "ImageInfo.h"
 #include "ImageFileInfo.h"
+#include "ImageMetadata.h"
+#include "ImageMetadataLoader.h"
 #include "PageInfo.h"
 #include "PageSequence.h"
 #include "ImageId.h"
@@ -40,6 +54,7 @@
 #include "ProjectReader.h"
 #include "OrthogonalRotation.h"
 #include "SelectedPage.h"
+#include "zones/ZoneGeometrySidecar.h"
 
 #include "filters/fix_orientation/Settings.h"
 #include "filters/fix_orientation/Filter.h"
@@ -72,6 +87,19 @@
 
 #include "ConsoleBatch.h"
 #include "CommandLine.h"
+#include "BatchJournal.h"
+#include "WorkerTopology.h"
+#include "AnalysisCache.h"
+#include "ImageLoader.h"
+#include "PdfExporter.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ProcessStats.h"
+#include "ProcessingTimes.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 
 ConsoleBatch::ConsoleBatch(std::vector<ImageFileInfo> const& images, QString const& output_directory, Qt::LayoutDirection const layout)
 :   batch(true), debug(true),
@@ -81,6 +109,15 @@ ConsoleBatch::ConsoleBatch(std::vector<ImageFileInfo> const& images, QString con
 	PageSelectionAccessor const accessor((IntrusivePtr<PageSelectionProvider>())); // Won't really be used anyway.
 	m_ptrStages = IntrusivePtr<StageSequence>(new StageSequence(m_ptrPages, accessor));
 
+	// Same-named files from different directories need distinctive
+	// labels in output file names.  Register them all in one batch.
+	std::vector<QString> file_paths;
+	file_paths.reserve(images.size());
+	for (size_t i = 0; i < images.size(); ++i) {
+		file_paths.push_back(images[i].fileInfo().absoluteFilePath());
+	}
+	m_ptrDisambiguator->registerFiles(file_paths);
+
 	//m_ptrThumbnailCache = IntrusivePtr<ThumbnailPixmapCache>(new ThumbnailPixmapCache(output_dir+"/cache/thumbs", QSize(200,200), 40, 5));
 	m_ptrThumbnailCache = Utils::createThumbnailCache(output_directory);
 	m_outFileNameGen = OutputFileNameGenerator(m_ptrDisambiguator, output_directory, m_ptrPages->layoutDirection());
@@ -101,6 +138,9 @@ ConsoleBatch::ConsoleBatch(QString const project_file)
 
 	file.close();
 
+	// Zone geometry may live in a binary sidecar next to the project file.
+	ZoneGeometrySidecarReader::loadFor(project_file);
+
 	m_ptrReader.reset(new ProjectReader(doc));
 	m_ptrPages = m_ptrReader->pages();
 
@@ -122,7 +162,7 @@ ConsoleBatch::ConsoleBatch(QString const project_file)
 }
 
 
-BackgroundTaskPtr
+IntrusivePtr<LoadFileTask>
 ConsoleBatch::createCompositeTask(
 		PageInfo const& page,
 		int const last_filter_idx)
@@ -176,7 +216,7 @@ ConsoleBatch::createCompositeTask(
 	}
 	assert(fix_orientation_task);
 	
-	return BackgroundTaskPtr(
+	return IntrusivePtr<LoadFileTask>(
 		new LoadFileTask(
 			BackgroundTask::BATCH,
 			page, m_ptrThumbnailCache, m_ptrPages, fix_orientation_task
@@ -185,6 +225,155 @@ ConsoleBatch::createCompositeTask(
 }
 
 
+/**
+ * Accumulates per-page wall-clock timings across stages, for the
+ * throughput summary printed at the end of a batch run.  Thread-safe,
+ * as pages within a stage may complete on several threads at once.
+ *
+ * The point of the summary is telling three pathological pages apart
+ * from a uniform slowdown without re-running under a profiler.
+ */
+class PageTimingCollector
+{
+public:
+	PageTimingCollector();
+
+	void setStage(QString const& stage);
+
+	/**
+	 * \brief Records that \p page just spent \p seconds in the
+	 *        current stage.
+	 *
+	 * With --verbose, also prints the timing right away.  The
+	 * record also goes to ProcessingTimes, so it gets persisted
+	 * with the project.
+	 */
+	void add(PageId const& page_id, QString const& page, double seconds);
+
+	QString summary() const;
+private:
+	struct PageStats
+	{
+		double totalSeconds;
+		double dominantSeconds;
+		QString dominantStage;
+
+		PageStats() : totalSeconds(0.0), dominantSeconds(0.0) {}
+	};
+
+	mutable QMutex m_mutex;
+	QTime m_wallTimer;
+	QString m_stage;
+	std::map<QString, PageStats> m_pages;
+	bool m_verbose;
+};
+
+PageTimingCollector::PageTimingCollector()
+:	m_verbose(CommandLine::get().isVerbose())
+{
+	m_wallTimer.start();
+}
+
+void
+PageTimingCollector::setStage(QString const& stage)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_stage = stage;
+}
+
+void
+PageTimingCollector::add(
+	PageId const& page_id, QString const& page, double const seconds)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	ProcessingTimes::instance().setTime(page_id, m_stage, seconds);
+
+	PageStats& stats = m_pages[page];
+	stats.totalSeconds += seconds;
+	if (seconds > stats.dominantSeconds) {
+		stats.dominantSeconds = seconds;
+		stats.dominantStage = m_stage;
+	}
+
+	if (m_verbose) {
+		// Printed under the mutex, so lines from parallel
+		// jobs don't interleave.
+		std::cout << "\t" << m_stage.toAscii().constData()
+			<< ": " << page.toAscii().constData() << " in "
+			<< QString::number(seconds, 'f', 2).toAscii().constData()
+			<< "s\n";
+	}
+}
+
+namespace
+{
+
+/**
+ * Orders task indices by estimated cost, highest first.
+ */
+class LongerJobFirst
+{
+public:
+	LongerJobFirst(std::vector<double> const& costs) : m_rCosts(costs) {}
+
+	bool operator()(size_t const lhs, size_t const rhs) const {
+		return m_rCosts[lhs] > m_rCosts[rhs];
+	}
+private:
+	std::vector<double> const& m_rCosts;
+};
+
+} // anonymous namespace
+
+QString
+PageTimingCollector::summary() const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	QString text;
+	QTextStream strm(&text);
+	strm.setRealNumberNotation(QTextStream::FixedNotation);
+	strm.setRealNumberPrecision(1);
+
+	double const wall_seconds = m_wallTimer.elapsed() / 1000.0;
+	int const num_pages = m_pages.size();
+	strm << "Processed " << num_pages << " page(s) in "
+		<< wall_seconds << "s";
+	if (wall_seconds > 0.0) {
+		strm << " = " << num_pages * 60.0 / wall_seconds
+			<< " pages/min";
+	}
+	strm << "\n";
+
+	std::vector<std::pair<double, QString> > slowest;
+	slowest.reserve(m_pages.size());
+	for (std::map<QString, PageStats>::const_iterator it(m_pages.begin());
+			it != m_pages.end(); ++it) {
+		slowest.push_back(std::make_pair(it->second.totalSeconds, it->first));
+	}
+	std::sort(
+		slowest.begin(), slowest.end(),
+		std::greater<std::pair<double, QString> >()
+	);
+
+	int const num_listed = std::min<int>(slowest.size(), 10);
+	if (num_listed > 1) {
+		strm << "Slowest pages:\n";
+		strm.setRealNumberPrecision(2);
+		for (int i = 0; i < num_listed; ++i) {
+			PageStats const& stats = m_pages.find(slowest[i].second)->second;
+			strm << "\t" << slowest[i].second << ": "
+				<< slowest[i].first << "s, mostly "
+				<< stats.dominantStage << " ("
+				<< stats.dominantSeconds << "s)\n";
+		}
+	}
+
+	return text;
+}
+
+
 // process the image vector **images** and save output to **output_dir**
 void
 ConsoleBatch::process()
@@ -207,22 +396,745 @@ ConsoleBatch::process()
 		endFilterIdx = ef;
 	}
 
-	for (int j=startFilterIdx; j<=endFilterIdx; j++) {
-		if (cli.isVerbose())
-			std::cout << "Filter: " << (j+1) << "\n";
+	int const jobs = cli.getJobs();
+	bool const resume = cli.hasResume();
+
+	// With --shard=i/n, each machine takes an interleaved slice of the
+	// page sequence.  Filter setup still covers all pages, so settings
+	// and output file naming stay deterministic across shards.  Stages
+	// that aggregate over other pages (e.g. matching output size with
+	// other pages) only see this shard's results; sharded runs should
+	// pin such parameters explicitly on the command line or in a shared
+	// project file.
+	int const shard_index = cli.getShardIndex();
+	int const shard_count = cli.getShardCount();
+
+	// The I/O counters are process-wide, so the total volume for
+	// the summary is a delta across the whole run.
+	PageTimingCollector timings;
+	qint64 const read_before = processDiskReadBytes();
+	qint64 const written_before = processDiskWriteBytes();
+
+	for (int j=startFilterIdx; j<=endFilterIdx; ) {
+		// Stages that don't aggregate across pages are fused with
+		// their successors: each page runs the whole group in one go,
+		// so its image is decoded and transformed once per group
+		// rather than once per stage.  A stage that does aggregate
+		// (see AbstractFilter::aggregatesAcrossPages()) ends its
+		// group - every page must pass through it before any page
+		// may consume the aggregate further down the chain.
+		int group_end = j;
+		while (group_end < endFilterIdx
+				&& !m_ptrStages->filters()[group_end]->aggregatesAcrossPages()) {
+			++group_end;
+		}
+
+		QString stage_name = m_ptrStages->filters()[j]->getName();
+		for (int k=j+1; k<=group_end; k++) {
+			stage_name += " + " + m_ptrStages->filters()[k]->getName();
+		}
+
+		if (cli.isVerbose()) {
+			if (group_end > j)
+				std::cout << "Filters: " << (j+1) << "-" << (group_end+1) << "\n";
+			else
+				std::cout << "Filter: " << (j+1) << "\n";
+		}
+
+		MemoryTracker::instance().beginStage(stage_name);
+		timings.setStage(stage_name);
 
 		PageSequence page_sequence = m_ptrPages->toPageSequence(PAGE_VIEW);
-		setupFilter(j, page_sequence.selectAll());
+		for (int k=j; k<=group_end; k++) {
+			setupFilter(k, page_sequence.selectAll());
+		}
+
+		// The journal only tracks the output stage - that's where
+		// almost all of the time goes, and output files are the
+		// only on-disk artifacts we can validate a resume against.
+		bool const journaled_stage = (group_end == m_ptrStages->outputFilterIdx());
+		if (journaled_stage && !m_ptrJournal.get()) {
+			// Each shard keeps its own journal, as the output
+			// directory may be shared between machines.
+			QString journal_name("batch-journal.txt");
+			if (shard_count > 1) {
+				journal_name = QString("batch-journal-%1-of-%2.txt")
+					.arg(shard_index + 1).arg(shard_count);
+			}
+			m_ptrJournal.reset(
+				new BatchJournal(
+					QDir(m_outFileNameGen.outDir()).filePath(journal_name)
+				)
+			);
+			if (!resume) {
+				m_ptrJournal->clear();
+			}
+		}
+
+		// Tasks are created sequentially, as filter setup isn't
+		// thread-safe, but pages within a stage are independent
+		// of each other and may be processed concurrently.
+		std::vector<IntrusivePtr<LoadFileTask> > tasks;
+		std::vector<QString> journal_keys;
+		tasks.reserve(page_sequence.numPages());
 		for (unsigned i=0; i<page_sequence.numPages(); i++) {
+			if ((int)(i % shard_count) != shard_index) {
+				continue;
+			}
+
 			PageInfo page = page_sequence.pageAt(i);
+
+			QString journal_key;
+			if (journaled_stage) {
+				journal_key = m_outFileNameGen.filePathFor(page.id());
+				if (resume && m_ptrJournal->isComplete(journal_key)
+						&& QFile::exists(journal_key)) {
+					if (cli.isVerbose())
+						std::cout << "\tSkipping (complete): " << page.imageId().filePath().toAscii().constData() << "\n";
+					continue;
+				}
+			}
+
 			if (cli.isVerbose())
 				std::cout << "\tProcessing: " << page.imageId().filePath().toAscii().constData() << "\n";
-			BackgroundTaskPtr bgTask = createCompositeTask(page, j);
-			(*bgTask)();
+			tasks.push_back(createCompositeTask(page, group_end));
+			journal_keys.push_back(journal_key);
+		}
+
+		// With parallel jobs, running the longest pages first
+		// minimizes the makespan: a long page started last would
+		// leave the other workers idle at the end of the stage.
+		// Pages with no history sort first in their original order,
+		// as nothing is known about them yet.
+		if (jobs > 1 && tasks.size() > 1) {
+			QString const& stage = stage_name;
+			std::vector<double> costs(tasks.size());
+			std::vector<size_t> order(tasks.size());
+			for (size_t i = 0; i < tasks.size(); ++i) {
+				double const seconds = ProcessingTimes::instance()
+					.timeFor(tasks[i]->pageId(), stage);
+				costs[i] = seconds < 0
+					? std::numeric_limits<double>::max() : seconds;
+				order[i] = i;
+			}
+			std::stable_sort(order.begin(), order.end(), LongerJobFirst(costs));
+
+			std::vector<IntrusivePtr<LoadFileTask> > sorted_tasks;
+			std::vector<QString> sorted_keys;
+			sorted_tasks.reserve(tasks.size());
+			sorted_keys.reserve(tasks.size());
+			for (size_t i = 0; i < order.size(); ++i) {
+				sorted_tasks.push_back(tasks[order[i]]);
+				sorted_keys.push_back(journal_keys[order[i]]);
+			}
+			tasks.swap(sorted_tasks);
+			journal_keys.swap(sorted_keys);
+		}
+
+		BatchJournal* const journal = journaled_stage ? m_ptrJournal.get() : 0;
+		if (jobs <= 1 || tasks.size() <= 1) {
+			processTasksPipelined(tasks, journal_keys, journal, timings);
+		} else {
+			processTasksParallel(tasks, journal_keys, journal, timings, jobs);
+		}
+
+		// Persist analysis results as we go, so an interrupted
+		// run doesn't lose a stage's worth of work.
+		AnalysisCache::instance().saveIfDirty();
+
+		MemoryTracker::instance().endStage();
+
+		j = group_end + 1;
+	}
+
+	std::cout << timings.summary().toAscii().constData();
+
+	qint64 const read_after = processDiskReadBytes();
+	qint64 const written_after = processDiskWriteBytes();
+	if (read_after >= 0 && written_after >= 0) {
+		std::cout << "Disk I/O: "
+			<< QString::number(
+				(read_after - read_before) / (1024.0 * 1024.0), 'f', 1
+			).toAscii().constData()
+			<< " MB read, "
+			<< QString::number(
+				(written_after - written_before) / (1024.0 * 1024.0), 'f', 1
+			).toAscii().constData()
+			<< " MB written\n";
+	}
+
+	if (cli.isVerbose()) {
+		QString const memory(MemoryTracker::instance().report());
+		if (!memory.isEmpty()) {
+			std::cout << "Memory watermarks:\n"
+				<< memory.toAscii().constData();
+		}
+	}
+
+	if (cli.hasExportPdf() && endFilterIdx >= m_ptrStages->outputFilterIdx()) {
+		exportPdf(cli.getExportPdfFile(), shard_index, shard_count);
+	}
+}
+
+namespace
+{
+
+/**
+ * All the checks to run against one image file.  Multi-page files
+ * carry one entry per project page, so their headers are read once.
+ */
+struct ImageFileCheck
+{
+	QString filePath;
+	std::vector<int> zeroBasedPages;
+	std::vector<ImageMetadata> storedMetadata;
+};
+
+class MetadataCollector
+{
+public:
+	MetadataCollector(std::vector<ImageMetadata>& out) : m_rOut(out) {}
+
+	void operator()(ImageMetadata const& metadata) {
+		m_rOut.push_back(metadata);
+	}
+private:
+	std::vector<ImageMetadata>& m_rOut;
+};
+
+/**
+ * Collects problem descriptions from verifier threads.
+ */
+class VerifyReport
+{
+public:
+	void addProblem(QString const& msg) {
+		QMutexLocker const locker(&m_mutex);
+		m_problems.push_back(msg);
+	}
+
+	std::vector<QString> const& problems() const { return m_problems; }
+private:
+	QMutex m_mutex;
+	std::vector<QString> m_problems;
+};
+
+/**
+ * Stats image files and reads their headers through
+ * ImageMetadataLoader.  Purely I/O bound, so several of these may
+ * run in parallel even on few cores.
+ */
+class ImageFileVerifier : public QThread
+{
+public:
+	ImageFileVerifier(std::vector<ImageFileCheck> const& files,
+		size_t& next_idx, QMutex& idx_mutex, VerifyReport& report)
+	:	m_rFiles(files), m_rNextIdx(next_idx),
+		m_rIdxMutex(idx_mutex), m_rReport(report) {}
+protected:
+	virtual void run() {
+		for (;;) {
+			size_t idx;
+			{
+				QMutexLocker const locker(&m_rIdxMutex);
+				if (m_rNextIdx >= m_rFiles.size()) {
+					break;
+				}
+				idx = m_rNextIdx++;
+			}
+			verifyFile(m_rFiles[idx]);
+		}
+	}
+private:
+	void verifyFile(ImageFileCheck const& file);
+
+	std::vector<ImageFileCheck> const& m_rFiles;
+	size_t& m_rNextIdx;
+	QMutex& m_rIdxMutex;
+	VerifyReport& m_rReport;
+};
+
+void
+ImageFileVerifier::verifyFile(ImageFileCheck const& file)
+{
+	if (!QFile::exists(file.filePath)) {
+		m_rReport.addProblem(file.filePath + ": file is missing");
+		return;
+	}
+
+	std::vector<ImageMetadata> actual;
+	ImageMetadataLoader::Status const st = ImageMetadataLoader::load(
+		file.filePath, MetadataCollector(actual)
+	);
+	if (st != ImageMetadataLoader::LOADED) {
+		m_rReport.addProblem(file.filePath + ": unable to read image headers");
+		return;
+	}
+
+	for (size_t i = 0; i < file.zeroBasedPages.size(); ++i) {
+		int const page = file.zeroBasedPages[i];
+		if ((size_t)page >= actual.size()) {
+			m_rReport.addProblem(
+				QString("%1: page %2 is gone (file now has %3)")
+				.arg(file.filePath).arg(page + 1).arg((unsigned)actual.size())
+			);
+			continue;
+		}
+
+		ImageMetadata const& stored = file.storedMetadata[i];
+		if (actual[page].size() != stored.size()) {
+			m_rReport.addProblem(
+				QString("%1: dimensions changed from %2x%3 to %4x%5")
+				.arg(file.filePath)
+				.arg(stored.size().width()).arg(stored.size().height())
+				.arg(actual[page].size().width()).arg(actual[page].size().height())
+			);
+		} else if (actual[page].dpi() != stored.dpi()) {
+			m_rReport.addProblem(
+				QString("%1: DPI changed from %2x%3 to %4x%5")
+				.arg(file.filePath)
+				.arg(stored.dpi().horizontal()).arg(stored.dpi().vertical())
+				.arg(actual[page].dpi().horizontal()).arg(actual[page].dpi().vertical())
+			);
+		}
+	}
+}
+
+/**
+ * One cached output result to check against the output directory.
+ */
+struct OutputCheck
+{
+	QString filePath;
+	output::OutputFileParams storedFileParams;
+};
+
+class OutputFileVerifier : public QThread
+{
+public:
+	OutputFileVerifier(std::vector<OutputCheck> const& checks,
+		size_t& next_idx, QMutex& idx_mutex, VerifyReport& report)
+	:	m_rChecks(checks), m_rNextIdx(next_idx),
+		m_rIdxMutex(idx_mutex), m_rReport(report) {}
+protected:
+	virtual void run() {
+		for (;;) {
+			size_t idx;
+			{
+				QMutexLocker const locker(&m_rIdxMutex);
+				if (m_rNextIdx >= m_rChecks.size()) {
+					break;
+				}
+				idx = m_rNextIdx++;
+			}
+
+			OutputCheck const& check = m_rChecks[idx];
+			QFileInfo const file_info(check.filePath);
+			if (!file_info.exists()) {
+				m_rReport.addProblem(check.filePath + ": cached output is missing");
+			} else if (!check.storedFileParams.matches(output::OutputFileParams(file_info))) {
+				m_rReport.addProblem(
+					check.filePath + ": cached output does not match the project record"
+				);
+			}
+		}
+	}
+private:
+	std::vector<OutputCheck> const& m_rChecks;
+	size_t& m_rNextIdx;
+	QMutex& m_rIdxMutex;
+	VerifyReport& m_rReport;
+};
+
+template<typename T>
+void runVerifiers(std::vector<T*>& threads)
+{
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i]->start();
+	}
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i]->wait();
+		delete threads[i];
+	}
+}
+
+} // anonymous namespace
+
+int
+ConsoleBatch::verify()
+{
+	CommandLine const& cli = CommandLine::get();
+	VerifyReport report;
+
+	// Group pages by file, so a multi-page TIFF has its headers
+	// read once no matter how many pages it contributes.
+	std::map<QString, ImageFileCheck> files_by_path;
+	PageSequence const images(m_ptrPages->toPageSequence(IMAGE_VIEW));
+	for (unsigned i = 0; i < images.numPages(); i++) {
+		PageInfo const page(images.pageAt(i));
+		ImageId const& image_id = page.imageId();
+
+		ImageFileCheck& check = files_by_path[image_id.filePath()];
+		check.filePath = image_id.filePath();
+		check.zeroBasedPages.push_back(image_id.zeroBasedPage());
+		check.storedMetadata.push_back(page.metadata());
+	}
+
+	std::vector<ImageFileCheck> files;
+	files.reserve(files_by_path.size());
+	for (std::map<QString, ImageFileCheck>::const_iterator it(files_by_path.begin());
+			it != files_by_path.end(); ++it) {
+		files.push_back(it->second);
+	}
+
+	// Checking is stats and header reads, never decoding, so the
+	// thread count is about overlapping I/O latency, not cores.
+	int const num_threads = std::max<int>(cli.getJobs(), 4);
+
+	{
+		size_t next_idx = 0;
+		QMutex idx_mutex;
+		std::vector<ImageFileVerifier*> threads;
+		for (int i = 0; i < num_threads; i++) {
+			threads.push_back(
+				new ImageFileVerifier(files, next_idx, idx_mutex, report)
+			);
+		}
+		runVerifiers(threads);
+	}
+
+	// Pages that were never processed aren't broken - they simply
+	// haven't been run yet.  Only recorded results are checked.
+	std::vector<OutputCheck> output_checks;
+	unsigned num_unprocessed = 0;
+	IntrusivePtr<output::Settings> const output_settings(
+		m_ptrStages->outputFilter()->getSettings()
+	);
+	PageSequence const pages(m_ptrPages->toPageSequence(PAGE_VIEW));
+	for (unsigned i = 0; i < pages.numPages(); i++) {
+		PageId const page_id(pages.pageAt(i).id());
+		std::auto_ptr<output::OutputParams> const stored(
+			output_settings->getOutputParams(page_id)
+		);
+		if (!stored.get()) {
+			++num_unprocessed;
+			continue;
+		}
+
+		OutputCheck check;
+		check.filePath = m_outFileNameGen.filePathFor(page_id);
+		check.storedFileParams = stored->outputFileParams();
+		output_checks.push_back(check);
+	}
+
+	{
+		size_t next_idx = 0;
+		QMutex idx_mutex;
+		std::vector<OutputFileVerifier*> threads;
+		for (int i = 0; i < num_threads; i++) {
+			threads.push_back(
+				new OutputFileVerifier(output_checks, next_idx, idx_mutex, report)
+			);
+		}
+		runVerifiers(threads);
+	}
+
+	std::vector<QString> const& problems = report.problems();
+	for (size_t i = 0; i < problems.size(); ++i) {
+		std::cerr << problems[i].toAscii().constData() << "\n";
+	}
+	std::cout << images.numPages() << " image(s), "
+		<< output_checks.size() << " cached output(s) checked, "
+		<< num_unprocessed << " page(s) not yet processed, "
+		<< problems.size() << " problem(s) found" << "\n";
+
+	return problems.size();
+}
+
+void
+ConsoleBatch::exportPdf(QString const& file_path, int shard_index, int shard_count)
+{
+	CommandLine const& cli = CommandLine::get();
+	PdfExporter& exporter = PdfExporter::instance();
+
+	std::vector<PageId> page_order;
+	PageSequence const page_sequence(m_ptrPages->toPageSequence(PAGE_VIEW));
+	for (unsigned i = 0; i < page_sequence.numPages(); i++) {
+		if ((int)(i % shard_count) != shard_index) {
+			continue;
+		}
+
+		PageId const page_id(page_sequence.pageAt(i).id());
+		if (!exporter.hasPage(page_id)) {
+			// Pages skipped on --resume were never re-rendered, so
+			// their contents have to come from the output files.
+			// The re-read is limited to these pages.
+			exporter.addPage(
+				page_id, ImageLoader::load(m_outFileNameGen.filePathFor(page_id), 0)
+			);
+		}
+		page_order.push_back(page_id);
+	}
+
+	if (cli.isVerbose())
+		std::cout << "Writing PDF: " << file_path.toAscii().constData() << "\n";
+
+	if (!exporter.writePdf(file_path, page_order)) {
+		std::cerr << "Failed to write " << file_path.toAscii().constData() << "\n";
+	}
+}
+
+namespace
+{
+
+/**
+ * A rough upper bound on pipeline memory per source pixel: the
+ * decoded image (up to 4 bytes), its grayscale version, a handful
+ * of full-page binary and grayscale temporaries, plus the float
+ * grids the output stage builds at output resolution.
+ */
+size_t const PIPELINE_BYTES_PER_PIXEL = 16;
+
+/**
+ * The page identification attached to trace spans: the source file
+ * name, without the directory part that's common to the whole run.
+ */
+QString pageName(LoadFileTask const& task)
+{
+	return QFileInfo(task.imageId().filePath()).fileName();
+}
+
+size_t estimatePeakBytes(LoadFileTask const& task)
+{
+	QSize const size(task.imageMetadata().size());
+	if (size.isEmpty()) {
+		// Unknown dimensions - assume a modest A4 300dpi page.
+		return size_t(2480) * 3508 * PIPELINE_BYTES_PER_PIXEL;
+	}
+
+	return size_t(size.width()) * size.height() * PIPELINE_BYTES_PER_PIXEL;
+}
+
+/**
+ * Hands out tasks in order, holding back admission while the
+ * estimated memory use of tasks in flight would exceed the budget.
+ * A task is always admitted when nothing else is in flight, so
+ * pages bigger than the whole budget still get processed - alone.
+ */
+class TaskDispenser
+{
+public:
+	TaskDispenser(std::vector<IntrusivePtr<LoadFileTask> > const& tasks,
+		size_t memory_budget)
+	:	m_rTasks(tasks), m_memoryBudget(memory_budget),
+		m_nextIdx(0), m_inFlightBytes(0), m_numInFlight(0) {}
+
+	/**
+	 * Blocks until the next task may start.  Returns its index,
+	 * or -1 if the queue is exhausted.
+	 */
+	int takeTask(size_t& cost);
+
+	void taskDone(size_t cost);
+private:
+	QMutex m_mutex;
+	QWaitCondition m_cond;
+	std::vector<IntrusivePtr<LoadFileTask> > const& m_rTasks;
+	size_t m_memoryBudget; /**< Zero means unlimited. */
+	size_t m_nextIdx;
+	size_t m_inFlightBytes;
+	int m_numInFlight;
+};
+
+int
+TaskDispenser::takeTask(size_t& cost)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	for (;;) {
+		if (m_nextIdx >= m_rTasks.size()) {
+			return -1;
+		}
+
+		cost = estimatePeakBytes(*m_rTasks[m_nextIdx]);
+		if (m_memoryBudget == 0 || m_numInFlight == 0
+				|| m_inFlightBytes + cost <= m_memoryBudget) {
+			break;
+		}
+
+		m_cond.wait(&m_mutex);
+	}
+
+	m_inFlightBytes += cost;
+	++m_numInFlight;
+
+	return m_nextIdx++;
+}
+
+void
+TaskDispenser::taskDone(size_t const cost)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_inFlightBytes -= cost;
+	--m_numInFlight;
+	m_cond.wakeAll();
+}
+
+class PageTaskRunner : public QThread
+{
+public:
+	PageTaskRunner(std::vector<IntrusivePtr<LoadFileTask> > const& tasks,
+		std::vector<QString> const& journal_keys, BatchJournal* journal,
+		TaskDispenser& dispenser, PageTimingCollector& timings,
+		int thread_idx)
+	:	m_rTasks(tasks), m_rJournalKeys(journal_keys),
+		m_pJournal(journal), m_rDispenser(dispenser),
+		m_rTimings(timings), m_threadIdx(thread_idx) {}
+protected:
+	virtual void run() {
+		// Pinning before any work means every buffer this worker
+		// first-touches is allocated on its own NUMA node.
+		WorkerTopology::instance().pinCurrentThread(m_threadIdx);
+
+		for (;;) {
+			size_t cost = 0;
+			int const idx = m_rDispenser.takeTask(cost);
+			if (idx < 0) {
+				break;
+			}
+			QTime timer;
+			timer.start();
+			{
+				ProfileScope const page_scope(
+					"page", pageName(*m_rTasks[idx])
+				);
+				(*m_rTasks[idx])();
+			}
+			m_rTimings.add(
+				m_rTasks[idx]->pageId(), pageName(*m_rTasks[idx]),
+				timer.elapsed() / 1000.0
+			);
+			if (m_pJournal) {
+				m_pJournal->markComplete(m_rJournalKeys[idx]);
+			}
+			m_rDispenser.taskDone(cost);
+		}
+	}
+private:
+	std::vector<IntrusivePtr<LoadFileTask> > const& m_rTasks;
+	std::vector<QString> const& m_rJournalKeys;
+	BatchJournal* m_pJournal;
+	TaskDispenser& m_rDispenser;
+	PageTimingCollector& m_rTimings;
+	int m_threadIdx;
+};
+
+class ImagePreloader : public QThread
+{
+public:
+	ImagePreloader(ImageId const& image_id) : m_imageId(image_id) {}
+
+	QImage const& image() const { return m_image; }
+protected:
+	virtual void run() {
+		ProfileScope const profile_scope(
+			"io/preload-image", QFileInfo(m_imageId.filePath()).fileName()
+		);
+		m_image = ImageLoader::load(m_imageId);
+	}
+private:
+	ImageId m_imageId;
+	QImage m_image;
+};
+
+} // anonymous namespace
+
+void
+ConsoleBatch::processTasksPipelined(
+	std::vector<IntrusivePtr<LoadFileTask> > const& tasks,
+	std::vector<QString> const& journal_keys, BatchJournal* journal,
+	PageTimingCollector& timings)
+{
+	// Decode the next page's image on a helper thread while the
+	// current page runs through the filter chain, overlapping
+	// input I/O with compute.
+	std::auto_ptr<ImagePreloader> preloader;
+
+	for (unsigned i=0; i<tasks.size(); i++) {
+		if (preloader.get()) {
+			preloader->wait();
+			tasks[i]->setPreloadedImage(preloader->image());
+			preloader.reset();
+		}
+		if (i + 1 < tasks.size()) {
+			preloader.reset(new ImagePreloader(tasks[i+1]->imageId()));
+			preloader->start();
 		}
+		QTime timer;
+		timer.start();
+		{
+			ProfileScope const page_scope("page", pageName(*tasks[i]));
+			(*tasks[i])();
+		}
+		timings.add(
+			tasks[i]->pageId(), pageName(*tasks[i]),
+			timer.elapsed() / 1000.0
+		);
+		if (journal) {
+			journal->markComplete(journal_keys[i]);
+		}
+	}
+
+	if (preloader.get()) {
+		preloader->wait();
 	}
 }
 
+void
+ConsoleBatch::processTasksParallel(
+	std::vector<IntrusivePtr<LoadFileTask> > const& tasks,
+	std::vector<QString> const& journal_keys, BatchJournal* journal,
+	PageTimingCollector& timings, int const jobs)
+{
+	TaskDispenser dispenser(tasks, CommandLine::get().getBatchMemoryLimit());
+
+	int const num_threads = std::min<int>(jobs, tasks.size());
+	std::vector<PageTaskRunner*> threads;
+	threads.reserve(num_threads);
+	for (int i=0; i<num_threads; i++) {
+		threads.push_back(new PageTaskRunner(tasks, journal_keys, journal, dispenser, timings, i));
+	}
+	for (int i=0; i<num_threads; i++) {
+		threads[i]->start();
+	}
+	for (int i=0; i<num_threads; i++) {
+		threads[i]->wait();
+		delete threads[i];
+	}
+}
+
+int
+ConsoleBatch::numPages() const
+{
+	return m_ptrPages->toPageSequence(PAGE_VIEW).numPages();
+}
+
+std::vector<QString>
+ConsoleBatch::outputFilePaths() const
+{
+	std::vector<QString> paths;
+
+	PageSequence const page_sequence(m_ptrPages->toPageSequence(PAGE_VIEW));
+	paths.reserve(page_sequence.numPages());
+	for (unsigned i = 0; i < page_sequence.numPages(); i++) {
+		paths.push_back(
+			m_outFileNameGen.filePathFor(page_sequence.pageAt(i).id())
+		);
+	}
+
+	return paths;
+}
+
 void
 ConsoleBatch::saveProject(QString const project_file)
 {
@@ -39,6 +39,10 @@
 #include "PageSelectionAccessor.h"
 #include "ProjectReader.h"
 
+class BatchJournal;
+class LoadFileTask;
+class PageTimingCollector;
+
 
 class ConsoleBatch
 {
@@ -51,8 +55,31 @@ public:
 	ConsoleBatch(QString const project_file);
 
 	void process();
+
+	/**
+	 * \brief Checks the project against the file system without processing.
+	 *
+	 * Verifies that every referenced image exists and still has the
+	 * dimensions and DPI recorded in the project, and that pages with
+	 * cached output results still have matching output files on disk.
+	 * Only stats and image headers are read - no pixel data is decoded.
+	 *
+	 * \return The number of problems found, zero for a clean project.
+	 */
+	int verify();
+
 	void saveProject(QString const project_file);
 
+	/**
+	 * \brief The number of pages the project describes.
+	 */
+	int numPages() const;
+
+	/**
+	 * \brief The output file path of every page, in page order.
+	 */
+	std::vector<QString> outputFilePaths() const;
+
 private:
 	bool batch;
 	bool debug;
@@ -62,6 +89,9 @@ private:
 	OutputFileNameGenerator m_outFileNameGen;
 	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
 	std::auto_ptr<ProjectReader> m_ptrReader;
+	std::auto_ptr<BatchJournal> m_ptrJournal;
+
+	void exportPdf(QString const& file_path, int shard_index, int shard_count);
 
 	void setupFilter(int idx, std::set<PageId> allPages);
 	void setupFixOrientation(std::set<PageId> allPages);
@@ -71,10 +101,20 @@ private:
 	void setupPageLayout(std::set<PageId> allPages);
 	void setupOutput(std::set<PageId> allPages);
 
-	BackgroundTaskPtr createCompositeTask(
+	IntrusivePtr<LoadFileTask> createCompositeTask(
 		PageInfo const& page,
 		int const last_filter_idx
 	);
+
+	static void processTasksPipelined(
+		std::vector<IntrusivePtr<LoadFileTask> > const& tasks,
+		std::vector<QString> const& journal_keys, BatchJournal* journal,
+		PageTimingCollector& timings);
+
+	static void processTasksParallel(
+		std::vector<IntrusivePtr<LoadFileTask> > const& tasks,
+		std::vector<QString> const& journal_keys, BatchJournal* journal,
+		PageTimingCollector& timings, int jobs);
 };
 
 #endif
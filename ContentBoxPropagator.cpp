@@ -25,6 +25,7 @@
 #include "filters/page_layout/Filter.h"
 #include "filter_dc/ContentBoxCollector.h"
 #include <QRectF>
+#include <vector>
 
 class ContentBoxPropagator::Collector : public ContentBoxCollector
 {
@@ -64,20 +65,33 @@ ContentBoxPropagator::propagate(ProjectPages const& pages)
 {
 	PageSequence const sequence(pages.toPageSequence(PAGE_VIEW));
 	size_t const num_pages = sequence.numPages();
-	
+
+	// Collect the updates for all the pages first, then hand them
+	// over in one go.  Updating the settings page by page would
+	// lock their mutex and recalculate the aggregate page size
+	// for every single page.
+	std::vector<page_layout::Filter::ContentBoxUpdate> updates;
+	updates.reserve(num_pages);
+
 	for (size_t i = 0; i < num_pages; ++i) {
 		PageInfo const& page_info = sequence.pageAt(i);
 		Collector collector;
 		m_ptrTask->process(page_info, &collector);
 		if (collector.collected()) {
-			m_ptrPageLayoutFilter->setContentBox(
-				page_info.id(), collector.xform(),
-				collector.contentRect()
+			updates.push_back(
+				page_layout::Filter::ContentBoxUpdate(
+					page_info.id(), collector.xform(),
+					collector.contentRect()
+				)
 			);
 		} else {
-			m_ptrPageLayoutFilter->invalidateContentBox(page_info.id());
+			updates.push_back(
+				page_layout::Filter::ContentBoxUpdate(page_info.id())
+			);
 		}
 	}
+
+	m_ptrPageLayoutFilter->updateContentBoxes(updates);
 }
 
 
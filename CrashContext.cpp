@@ -0,0 +1,155 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CrashContext.h"
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QString>
+#include <new>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace
+{
+
+size_t const EMERGENCY_RESERVE_BYTES = 4*1024*1024;
+
+int const MAX_KEY_BYTES = 1024;
+
+char* s_emergencyReserve = 0;
+
+int s_metadataFd = -1;
+
+// Updated from worker threads without a lock: a torn read at crash
+// time costs us at worst a garbled file name in the metadata, while
+// a mutex here could deadlock the crash handler.
+volatile int s_numCompleted = 0;
+
+char s_lastKey[MAX_KEY_BYTES];
+
+void writeStr(int fd, char const* str)
+{
+#ifdef _WIN32
+	_write(fd, str, (unsigned)strlen(str));
+#else
+	ssize_t retval = write(fd, str, strlen(str));
+	(void)retval;
+#endif
+}
+
+} // anonymous namespace
+
+namespace CrashContext
+{
+
+void
+reserve()
+{
+	if (!s_emergencyReserve) {
+		s_emergencyReserve = new(std::nothrow) char[EMERGENCY_RESERVE_BYTES];
+		if (s_emergencyReserve) {
+			// Touch the pages so the reserve is backed by real
+			// memory rather than an overcommitted promise.
+			for (size_t i = 0; i < EMERGENCY_RESERVE_BYTES; i += 4096) {
+				s_emergencyReserve[i] = 0;
+			}
+		}
+	}
+
+	if (s_metadataFd == -1) {
+		QString const path(
+			QDir::temp().absoluteFilePath("scantailor-crash-meta.txt")
+		);
+#ifdef _WIN32
+		s_metadataFd = _wopen(
+			(wchar_t const*)path.utf16(),
+			_O_WRONLY|_O_CREAT|_O_TRUNC|_O_BINARY,
+			_S_IREAD|_S_IWRITE
+		);
+#else
+		QByteArray const path_bytes(QFile::encodeName(path));
+		s_metadataFd = open(path_bytes.constData(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+#endif
+	}
+}
+
+void
+noteJournalPosition(QString const& last_key, int num_completed)
+{
+	QByteArray const utf8(last_key.toUtf8());
+	int const len = qMin(utf8.size(), MAX_KEY_BYTES - 1);
+	memcpy(s_lastKey, utf8.constData(), len);
+	s_lastKey[len] = '\0';
+	s_numCompleted = num_completed;
+}
+
+void
+releaseEmergencyReserve()
+{
+	delete[] s_emergencyReserve;
+	s_emergencyReserve = 0;
+}
+
+void
+writeMetadataFile(wchar_t const* dump_id)
+{
+	if (s_metadataFd == -1) {
+		return;
+	}
+
+	char buf[64];
+
+	writeStr(s_metadataFd, "dump-id: ");
+	if (dump_id) {
+		// Narrowing by hand: dump ids are ASCII and the crash
+		// path can't afford a converter that allocates.
+		char id_buf[64];
+		int i = 0;
+		for (; i < (int)sizeof(id_buf) - 1 && dump_id[i]; ++i) {
+			id_buf[i] = dump_id[i] < 0x80 ? (char)dump_id[i] : '?';
+		}
+		id_buf[i] = '\0';
+		writeStr(s_metadataFd, id_buf);
+	}
+	writeStr(s_metadataFd, "\n");
+
+	sprintf(buf, "journal-pages-completed: %d\n", (int)s_numCompleted);
+	writeStr(s_metadataFd, buf);
+
+	writeStr(s_metadataFd, "journal-last-key: ");
+	writeStr(s_metadataFd, s_lastKey);
+	writeStr(s_metadataFd, "\n");
+
+#ifdef _WIN32
+	_commit(s_metadataFd);
+#else
+	fsync(s_metadataFd);
+#endif
+}
+
+} // namespace CrashContext
@@ -0,0 +1,82 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CRASH_CONTEXT_H_
+#define CRASH_CONTEXT_H_
+
+class QString;
+
+/**
+ * \brief Resources set aside at startup so that crash capture never allocates.
+ *
+ * Our typical crash is OOM-adjacent, which is exactly when anything the
+ * crash path tries to allocate - heap for the dump writer, a file
+ * handle for metadata - is likely to fail.  In the same spirit as
+ * OutOfMemoryHandler's emergency buffer, everything the crash path
+ * needs is acquired in reserve(), long before trouble:
+ *
+ * - a block of emergency heap, released by the Breakpad filter
+ *   callback so the dump writer has memory to work with;
+ * - a pre-opened file descriptor for the crash metadata sidecar,
+ *   written next to the minidump with plain write() calls.
+ *
+ * The metadata records the batch journal position - how many pages had
+ * completed and which output file was recorded last - so a dead batch
+ * run can be pinned to the page that killed it.
+ *
+ * Everything here but reserve() must stay safe to call from a crash
+ * handler: fixed static storage, no locks, no allocation, no Qt.
+ */
+namespace CrashContext
+{
+
+/**
+ * \brief Preallocates the crash-path resources.
+ *
+ * To be called once at startup, from the main thread, before the
+ * Breakpad handler is installed.
+ */
+void reserve();
+
+/**
+ * \brief Records the current batch journal position.
+ *
+ * Called by BatchJournal every time a page completes.  May be called
+ * from any thread; only copies into fixed storage.
+ */
+void noteJournalPosition(QString const& last_key, int num_completed);
+
+/**
+ * \brief Hands the emergency heap block back to the allocator.
+ *
+ * Breakpad filter callback.  Safe to call in a crashed process.
+ */
+void releaseEmergencyReserve();
+
+/**
+ * \brief Writes the metadata sidecar through the pre-opened descriptor.
+ *
+ * Breakpad post-dump callback.  \p dump_id, if non-null, names the
+ * minidump this metadata belongs to.  Safe to call in a crashed
+ * process.
+ */
+void writeMetadataFile(wchar_t const* dump_id);
+
+} // namespace CrashContext
+
+#endif
@@ -17,6 +17,7 @@
 */
 
 #include "DebugImageView.h"
+#include "DebugImages.h"
 #include "AbstractCommand.h"
 #include "BackgroundExecutor.h"
 #include "ImageViewBase.h"
@@ -52,7 +53,7 @@ public:
 			: m_ptrOwner(owner), m_filePath(file_path) {}
 
 	virtual BackgroundExecutor::TaskResultPtr operator()() {
-		QImage image(m_filePath);
+		QImage const image(DebugImages::load(m_filePath));
 		return BackgroundExecutor::TaskResultPtr(new ImageLoadResult(m_ptrOwner, image));
 	}
 private:
@@ -17,9 +17,9 @@
 */
 
 #include "DebugImages.h"
+#include "ImageDumpFile.h"
 #include "imageproc/BinaryImage.h"
 #include <QImage>
-#include <QImageWriter>
 #include <QTemporaryFile>
 #include <QDir>
 
@@ -28,7 +28,7 @@ DebugImages::add(
 	QImage const& image, QString const& label,
 	boost::function<QWidget* (QImage const&)> const& image_view_factory)
 {
-	QTemporaryFile file(QDir::tempPath()+"/scantailor-dbg-XXXXXX.png");
+	QTemporaryFile file(QDir::tempPath()+"/scantailor-dbg-XXXXXX.dump");
 	if (!file.open()) {
 		return;
 	}
@@ -36,9 +36,10 @@ DebugImages::add(
 	AutoRemovingFile arem_file(file.fileName());
 	file.setAutoRemove(false);
 
-	QImageWriter writer(&file, "png");
-	writer.setCompression(2); // Trade space for speed.
-	if (!writer.write(image)) {
+	// PNG coding every intermediate image is what used to dominate
+	// the cost of running a stage in debug mode, hence the fast
+	// dump format.
+	if (!ImageDumpFile::write(image, file)) {
 		return;
 	}
 
@@ -72,3 +73,15 @@ DebugImages::retrieveNext(QString* label, boost::function<QWidget* (QImage const
 
 	return file;
 }
+
+QImage
+DebugImages::load(QString const& file_path)
+{
+	QImage const image(ImageDumpFile::read(file_path));
+	if (!image.isNull()) {
+		return image;
+	}
+
+	// Not our dump - let the image plugins have a go at it.
+	return QImage(file_path);
+}
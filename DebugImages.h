@@ -36,6 +36,11 @@ namespace imageproc
 
 /**
  * \brief A sequence of image + label pairs.
+ *
+ * Images are not kept in memory.  Each one is spilled to a temporary
+ * file in a trivial run-length format as it's added, and read back
+ * only when its tab in TabbedDebugImages actually gets opened, so
+ * collecting debug images costs little until they are inspected.
  */
 class DebugImages
 {
@@ -59,6 +64,15 @@ public:
 	 */
 	AutoRemovingFile retrieveNext(QString* label = 0,
 		boost::function<QWidget* (QImage const&)>* image_view_factory = 0);
+
+	/**
+	 * \brief Reads back a snapshot file written by add().
+	 *
+	 * Files that aren't in our own dump format are handed over to
+	 * the regular image loading machinery.  Returns a null image
+	 * on failure.
+	 */
+	static QImage load(QString const& file_path);
 private:
 	struct Item : public RefCountable
 	{
@@ -24,12 +24,15 @@
 #include "imageproc/BinaryImage.h"
 #include "imageproc/ConnectivityMap.h"
 #include "imageproc/Connectivity.h"
+#include "imageproc/ParallelFor.h"
 #ifndef Q_MOC_RUN
 #include <boost/foreach.hpp>
 #endif
 #include <QtGlobal>
 #include <QImage>
 #include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
 #include <vector>
 #include <map>
 #include <limits>
@@ -70,64 +73,57 @@ namespace
 static int const VERTICAL_SCALE = 2;
 static int const VERTICAL_SCALE_SQ = VERTICAL_SCALE * VERTICAL_SCALE;
 
-struct Settings
-{
-	/**
-	 * When multiplied by the number of pixels in a connected component,
-	 * gives the minimum size (in terms of the number of pixels) of a connected
-	 * component we may attach it to.
-	 */
-	double minRelativeParentWeight;
-
-	/**
-	 * When multiplied by the number of pixels in a connected component,
-	 * gives the maximum squared distance to another connected component
-	 * we may attach it to.
-	 */
-	uint32_t pixelsToSqDist;
-
-	/**
-	 * Defines the minimum width or height in pixels that will guarantee
-	 * the object won't be removed.
-	 */
-	int bigObjectThreshold;
+/**
+ * Per-level despeckling thresholds.  The level never changes
+ * mid-page, so the scoring code below is parameterized on it,
+ * letting the compiler bake these into the instructions instead
+ * of loading them from a settings object in every iteration.
+ *
+ * PIXELS_TO_SQDIST, when multiplied by the number of pixels in
+ * a connected component, gives the maximum squared distance to
+ * another connected component we may attach it to.
+ *
+ * MIN_RELATIVE_PARENT_WEIGHT_X1000, divided by 1000, multiplied
+ * by the dpi factor and then by the number of pixels in a connected
+ * component, gives the minimum size (in terms of the number of
+ * pixels) of a connected component we may attach it to.
+ *
+ * BIG_OBJECT_THRESHOLD, scaled by the dpi factor, defines the
+ * minimum width or height in pixels that will guarantee the
+ * object won't be removed.  It's expressed at 300 dpi.
+ */
+template<Despeckle::Level L> struct LevelTraits;
 
-	static Settings get(Despeckle::Level level, Dpi const& dpi);
+template<> struct LevelTraits<Despeckle::CAUTIOUS>
+{
+	static uint32_t const PIXELS_TO_SQDIST = 100; // 10.0^2
+	static uint32_t const MIN_RELATIVE_PARENT_WEIGHT_X1000 = 125;
+	static int const BIG_OBJECT_THRESHOLD = 7;
 };
 
-Settings
-Settings::get(Despeckle::Level const level, Dpi const& dpi)
+template<> struct LevelTraits<Despeckle::NORMAL>
 {
-	Settings settings;
-
-	int const min_dpi = std::min(dpi.horizontal(), dpi.vertical());
-	double const dpi_factor = min_dpi / 300.0;
-
-	// To silence compiler's warnings.
-	settings.minRelativeParentWeight = 0;
-	settings.pixelsToSqDist = 0;
-	settings.bigObjectThreshold = 0;
+	static uint32_t const PIXELS_TO_SQDIST = 42; // 6.5^2, truncated
+	static uint32_t const MIN_RELATIVE_PARENT_WEIGHT_X1000 = 175;
+	static int const BIG_OBJECT_THRESHOLD = 12;
+};
 
-	switch (level) {
-		case Despeckle::CAUTIOUS:
-			settings.minRelativeParentWeight = 0.125 * dpi_factor;
-			settings.pixelsToSqDist = 10.0*10.0;
-			settings.bigObjectThreshold = qRound(7 * dpi_factor);
-			break;
-		case Despeckle::NORMAL:
-			settings.minRelativeParentWeight = 0.175 * dpi_factor;
-			settings.pixelsToSqDist = 6.5*6.5;
-			settings.bigObjectThreshold = qRound(12 * dpi_factor);
-			break;
-		case Despeckle::AGGRESSIVE:
-			settings.minRelativeParentWeight = 0.225 * dpi_factor;
-			settings.pixelsToSqDist = 3.5*3.5;
-			settings.bigObjectThreshold = qRound(17 * dpi_factor);
-			break;
-	}
+template<> struct LevelTraits<Despeckle::AGGRESSIVE>
+{
+	static uint32_t const PIXELS_TO_SQDIST = 12; // 3.5^2, truncated
+	static uint32_t const MIN_RELATIVE_PARENT_WEIGHT_X1000 = 225;
+	static int const BIG_OBJECT_THRESHOLD = 17;
+};
 
-	return settings;
-}
+uint32_t const LevelTraits<Despeckle::CAUTIOUS>::PIXELS_TO_SQDIST;
+uint32_t const LevelTraits<Despeckle::CAUTIOUS>::MIN_RELATIVE_PARENT_WEIGHT_X1000;
+int const LevelTraits<Despeckle::CAUTIOUS>::BIG_OBJECT_THRESHOLD;
+uint32_t const LevelTraits<Despeckle::NORMAL>::PIXELS_TO_SQDIST;
+uint32_t const LevelTraits<Despeckle::NORMAL>::MIN_RELATIVE_PARENT_WEIGHT_X1000;
+int const LevelTraits<Despeckle::NORMAL>::BIG_OBJECT_THRESHOLD;
+uint32_t const LevelTraits<Despeckle::AGGRESSIVE>::PIXELS_TO_SQDIST;
+uint32_t const LevelTraits<Despeckle::AGGRESSIVE>::MIN_RELATIVE_PARENT_WEIGHT_X1000;
+int const LevelTraits<Despeckle::AGGRESSIVE>::BIG_OBJECT_THRESHOLD;
 
 
 struct Component
@@ -316,20 +312,22 @@ void updateDistance(
  * \brief Tag the source component with ANCHORED_TO_SMALL, ANCHORED_TO_BIG
  *        or none of the above.
  */
+template<Despeckle::Level L>
 void tagSourceComponent(
-	Component& source, Component const& target, uint32_t sqdist, Settings const& settings)
+	Component& source, Component const& target, uint32_t sqdist,
+	double const min_relative_parent_weight)
 {
 	if (source.anchoredToBig()) {
 		// No point in setting ANCHORED_TO_SMALL.
 		return;
 	}
-	
-	if (sqdist > source.num_pixels * settings.pixelsToSqDist) {
+
+	if (sqdist > source.num_pixels * LevelTraits<L>::PIXELS_TO_SQDIST) {
 		// Too far.
 		return;
 	}
-	
-	if (target.num_pixels >= settings.minRelativeParentWeight * source.num_pixels) {
+
+	if (target.num_pixels >= min_relative_parent_weight * source.num_pixels) {
 		source.setAnchoredToBig();
 	} else {
 		source.setAnchoredToSmall();
@@ -341,11 +339,13 @@ void tagSourceComponent(
  * Attaching a component to another one will preserve the component
  * being attached, provided that the one it's attached to is also preserved.
  */
+template<Despeckle::Level L>
 bool canBeAttachedTo(
-	Component const& comp, Component const& target, uint32_t sqdist, Settings const& settings)
+	Component const& comp, Component const& target, uint32_t sqdist,
+	double const min_relative_parent_weight)
 {
-	if (sqdist <= comp.num_pixels * settings.pixelsToSqDist) {
-		if (target.num_pixels >= comp.num_pixels * settings.minRelativeParentWeight) {
+	if (sqdist <= comp.num_pixels * LevelTraits<L>::PIXELS_TO_SQDIST) {
+		if (target.num_pixels >= comp.num_pixels * min_relative_parent_weight) {
 			return true;
 		}
 	}
@@ -650,29 +650,55 @@ void voronoiSpecial(ConnectivityMap& cmap, std::vector<Distance>& dist, Distance
 }
 
 /**
- * Calculate the minimum distance between components from neighboring
- * Voronoi segments.
+ * \brief Collects minimum distances between neighboring Voronoi
+ *        segments over a band of rows.
+ *
+ * Each invocation works on a private connection map and merges it
+ * into the shared one under a mutex.
  */
-void voronoiDistances(
-	ConnectivityMap const& cmap,
-	std::vector<Distance> const& distance_matrix,
-	std::map<Connection, uint32_t>& conns)
+class DistanceCollector
 {
-	int const width = cmap.size().width();
-	int const height = cmap.size().height();
-	
-	int const offsets[] = { -cmap.stride(), -1, 1, cmap.stride() };
-	
-	uint32_t const* const cmap_data = cmap.data();
-	Distance const* const distance_data = &distance_matrix[0] + width + 3;
-	for (int y = 0, offset = 0; y < height; ++y, offset += 2) {
+public:
+	DistanceCollector(
+		ConnectivityMap const& cmap,
+		std::vector<Distance> const& distance_matrix,
+		std::map<Connection, uint32_t>& conns, QMutex& mutex)
+	:	m_rCmap(cmap),
+		m_rDistanceMatrix(distance_matrix),
+		m_rConns(conns),
+		m_rMutex(mutex)
+	{
+	}
+
+	void operator()(int begin_row, int end_row) const;
+private:
+	ConnectivityMap const& m_rCmap;
+	std::vector<Distance> const& m_rDistanceMatrix;
+	std::map<Connection, uint32_t>& m_rConns;
+	QMutex& m_rMutex;
+};
+
+void
+DistanceCollector::operator()(int const begin_row, int const end_row) const
+{
+	int const width = m_rCmap.size().width();
+	int const stride = m_rCmap.stride();
+
+	int const offsets[] = { -stride, -1, 1, stride };
+
+	std::map<Connection, uint32_t> conns;
+
+	uint32_t const* const cmap_data = m_rCmap.data();
+	Distance const* const distance_data = &m_rDistanceMatrix[0] + width + 3;
+	for (int y = begin_row; y < end_row; ++y) {
+		int offset = y * stride;
 		for (int x = 0; x < width; ++x, ++offset) {
 			uint32_t const label = cmap_data[offset];
 			assert(label != 0);
-			
+
 			int const x1 = x + distance_data[offset].vec.x;
 			int const y1 = y + distance_data[offset].vec.y;
-			
+
 			for (int i = 0; i < 4; ++i) {
 				int const nbh_offset = offset + offsets[i];
 				uint32_t const nbh_label = cmap_data[nbh_offset];
@@ -681,38 +707,230 @@ void voronoiDistances(
 					// padding lines.
 					continue;
 				}
-				
+
 				int const x2 = x + distance_data[nbh_offset].vec.x;
 				int const y2 = y + distance_data[nbh_offset].vec.y;
 				int const dx = x1 - x2;
 				int const dy = y1 - y2;
 				uint32_t const sqdist = dx * dx + dy * dy;
-				
+
 				updateDistance(conns, label, nbh_label, sqdist);
 			}
 		}
 	}
-}
 
-} // anonymous namespace
+	typedef std::map<Connection, uint32_t> Connections;
 
+	QMutexLocker const locker(&m_rMutex);
+	BOOST_FOREACH(Connections::value_type const& pair, conns) {
+		updateDistance(
+			m_rConns, pair.first.lesser_label,
+			pair.first.greater_label, pair.second
+		);
+	}
+}
 
-BinaryImage
-Despeckle::despeckle(
-	BinaryImage const& src, Dpi const& dpi, Level const level,
-	TaskStatus const& status, DebugImages* const dbg)
+/**
+ * Calculate the minimum distance between components from neighboring
+ * Voronoi segments.
+ */
+void voronoiDistances(
+	ConnectivityMap const& cmap,
+	std::vector<Distance> const& distance_matrix,
+	std::map<Connection, uint32_t>& conns)
 {
-	BinaryImage dst(src);
-	despeckleInPlace(dst, dpi, level, status, dbg);
-	return dst;
+	QMutex mutex;
+	DistanceCollector const collector(cmap, distance_matrix, conns, mutex);
+	parallelForRanges(0, cmap.size().height(), collector);
 }
 
-void
-Despeckle::despeckleInPlace(
-	BinaryImage& image, Dpi const& dpi, Level const level,
-	TaskStatus const& status, DebugImages* const dbg)
+/**
+ * \brief Accumulates per-component pixel counts and bounding boxes
+ *        over a band of rows.
+ *
+ * Each invocation works on private accumulators and merges them
+ * into the shared ones under a mutex.
+ */
+class StatsAccumulator
+{
+public:
+	StatsAccumulator(
+		ConnectivityMap const& cmap,
+		std::vector<uint32_t>& num_pixels,
+		std::vector<BoundingBox>& bounding_boxes, QMutex& mutex)
+	:	m_rCmap(cmap),
+		m_rNumPixels(num_pixels),
+		m_rBoundingBoxes(bounding_boxes),
+		m_rMutex(mutex)
+	{
+	}
+
+	void operator()(int const begin_row, int const end_row) const {
+		size_t const num_labels = m_rNumPixels.size();
+		std::vector<uint32_t> num_pixels(num_labels, 0);
+		std::vector<BoundingBox> bounding_boxes(num_labels);
+
+		int const width = m_rCmap.size().width();
+		int const stride = m_rCmap.stride();
+		uint32_t const* cmap_line = m_rCmap.data() + begin_row * stride;
+		for (int y = begin_row; y < end_row; ++y) {
+			for (int x = 0; x < width; ++x) {
+				uint32_t const label = cmap_line[x];
+				++num_pixels[label];
+				bounding_boxes[label].extend(x, y);
+			}
+			cmap_line += stride;
+		}
+
+		QMutexLocker const locker(&m_rMutex);
+		for (size_t label = 0; label < num_labels; ++label) {
+			if (num_pixels[label] == 0) {
+				continue;
+			}
+			m_rNumPixels[label] += num_pixels[label];
+			BoundingBox const& bbox = bounding_boxes[label];
+			m_rBoundingBoxes[label].extend(bbox.left, bbox.top);
+			m_rBoundingBoxes[label].extend(bbox.right, bbox.bottom);
+		}
+	}
+private:
+	ConnectivityMap const& m_rCmap;
+	std::vector<uint32_t>& m_rNumPixels;
+	std::vector<BoundingBox>& m_rBoundingBoxes;
+	QMutex& m_rMutex;
+};
+
+/**
+ * \brief Prepares the distance matrix for the second Voronoi pass
+ *        over a band of rows.
+ *
+ * Rows are written by exactly one invocation each, so no locking
+ * is involved.
+ */
+class DistanceResetter
+{
+public:
+	DistanceResetter(
+		uint32_t const* cmap_data, Distance* distance_data,
+		int width, int stride,
+		std::vector<Component> const& components,
+		std::vector<uint32_t> const& remapping_table)
+	:	m_pCmapData(cmap_data),
+		m_pDistanceData(distance_data),
+		m_width(width),
+		m_stride(stride),
+		m_rComponents(components),
+		m_rRemappingTable(remapping_table)
+	{
+	}
+
+	void operator()(int const begin_row, int const end_row) const {
+		Distance const zero_distance(Distance::zero());
+		Distance const special_distance(Distance::special());
+		for (int y = begin_row; y < end_row; ++y) {
+			int offset = y * m_stride;
+			for (int x = 0; x < m_width; ++x, ++offset) {
+				uint32_t const label = m_pCmapData[offset];
+				assert(label != 0);
+
+				Component const& comp = m_rComponents[m_rRemappingTable[label]];
+				if (!comp.anchoredToSmallButNotBig()) {
+					if (m_pDistanceData[offset] == zero_distance) {
+						// Prevent this region from growing
+						// and from being taken over by another
+						// by another region.
+						m_pDistanceData[offset] = special_distance;
+					} else {
+						// Allow this region to be taken over by others.
+						// Note: x + 1 here is equivalent to x
+						// in voronoi() or voronoiSpecial().
+						m_pDistanceData[offset].reset(x + 1);
+					}
+				}
+			}
+		}
+	}
+private:
+	uint32_t const* m_pCmapData;
+	Distance* m_pDistanceData;
+	int m_width;
+	int m_stride;
+	std::vector<Component> const& m_rComponents;
+	std::vector<uint32_t> const& m_rRemappingTable;
+};
+
+/**
+ * \brief Erases rejected components from a band of image rows.
+ *
+ * Rows are written by exactly one invocation each, so no locking
+ * is involved.
+ */
+class ComponentEraser
+{
+public:
+	ComponentEraser(
+		uint32_t* image_data, int image_stride,
+		ConnectivityMap const& cmap,
+		std::vector<Component> const& components,
+		std::vector<uint32_t> const& remapping_table)
+	:	m_pImageData(image_data),
+		m_imageStride(image_stride),
+		m_rCmap(cmap),
+		m_rComponents(components),
+		m_rRemappingTable(remapping_table)
+	{
+	}
+
+	void operator()(int const begin_row, int const end_row) const {
+		uint32_t const msb = uint32_t(1) << 31;
+		int const width = m_rCmap.size().width();
+		int const cmap_stride = m_rCmap.stride();
+		uint32_t* image_line = m_pImageData + begin_row * m_imageStride;
+		uint32_t const* cmap_line = m_rCmap.data() + begin_row * cmap_stride;
+		for (int y = begin_row; y < end_row; ++y) {
+			for (int x = 0; x < width; ++x) {
+				if (!m_rComponents[m_rRemappingTable[cmap_line[x]]].anchoredToBig()) {
+					image_line[x >> 5] &= ~(msb >> (x & 31));
+				}
+			}
+			image_line += m_imageStride;
+			cmap_line += cmap_stride;
+		}
+	}
+private:
+	uint32_t* m_pImageData;
+	int m_imageStride;
+	ConnectivityMap const& m_rCmap;
+	std::vector<Component> const& m_rComponents;
+	std::vector<uint32_t> const& m_rRemappingTable;
+};
+
+/**
+ * The level-independent part of despeckling: the connectivity map
+ * (with labels spread over white space by the Voronoi transform),
+ * the distance matrix, per-component statistics and the distances
+ * between neighboring components.  All of it is keyed by original
+ * component labels - unification of big components depends on the
+ * level and happens later, through a remapping table.
+ */
+class AnalysisImpl : public Despeckle::Analysis
+{
+public:
+	AnalysisImpl() : valid(false) {}
+
+	bool valid;
+	ConnectivityMap cmap;
+	std::vector<Distance> distanceMatrix;
+	std::vector<uint32_t> numPixels; /**< Indexed by label. */
+	std::vector<BoundingBox> boundingBoxes; /**< Indexed by label. */
+	std::map<Connection, uint32_t> conns; /**< conn -> sqdist */
+};
+
+void buildAnalysis(
+	BinaryImage const& image, TaskStatus const& status,
+	DebugImages* const dbg, AnalysisImpl& analysis)
 {
-	Settings const settings(Settings::get(level, dpi));
+	analysis.valid = true;
 
 	ConnectivityMap cmap(image, CONN8);
 	if (cmap.maxLabel() == 0) {
@@ -721,44 +939,84 @@ Despeckle::despeckleInPlace(
 	}
 
 	status.throwIfCancelled();
-	
-	std::vector<Component> components(cmap.maxLabel() + 1);
-	std::vector<BoundingBox> bounding_boxes(cmap.maxLabel() + 1);
 
-	int const width = image.width();
-	int const height = image.height();
+	analysis.numPixels.assign(cmap.maxLabel() + 1, 0);
+	analysis.boundingBoxes.assign(cmap.maxLabel() + 1, BoundingBox());
 
-	uint32_t* const cmap_data = cmap.data();
-	
 	// Count the number of pixels and a bounding rect of each component.
-	uint32_t* cmap_line = cmap_data;
-	int const cmap_stride = cmap.stride();
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			uint32_t const label = cmap_line[x];
-			++components[label].num_pixels;
-			bounding_boxes[label].extend(x, y);
-		}
-		cmap_line += cmap_stride;
+	QMutex stats_mutex;
+	StatsAccumulator const accumulator(
+		cmap, analysis.numPixels, analysis.boundingBoxes, stats_mutex
+	);
+	parallelForRanges(0, image.height(), accumulator);
+
+	status.throwIfCancelled();
+
+	// Build a Voronoi diagram.
+	voronoi(cmap, analysis.distanceMatrix);
+	if (dbg) {
+		dbg->add(cmap.visualized(), "voronoi");
 	}
-	
+
+	status.throwIfCancelled();
+
+	// Now build a bidirectional map of distances between neighboring
+	// connected components.
+	voronoiDistances(cmap, analysis.distanceMatrix, analysis.conns);
+
+	analysis.cmap.swap(cmap);
+}
+
+/**
+ * \brief The level-dependent part of despeckling.
+ *
+ * Instantiated separately for each despeckle level, so that the
+ * level thresholds are compile-time constants in the scoring loops
+ * below rather than values loaded from a settings object for every
+ * component.  The dpi-dependent thresholds can't be baked in, so
+ * they are computed once per page from the compile-time bases.
+ */
+template<Despeckle::Level L>
+void despeckleLevelDependent(
+	BinaryImage& image, AnalysisImpl const& a, double const dpi_factor,
+	TaskStatus const& status, DebugImages* const dbg)
+{
+	double const min_relative_parent_weight =
+		LevelTraits<L>::MIN_RELATIVE_PARENT_WEIGHT_X1000 / 1000.0 * dpi_factor;
+	int const big_object_threshold =
+		qRound(LevelTraits<L>::BIG_OBJECT_THRESHOLD * dpi_factor);
+
+	ConnectivityMap const& cmap = a.cmap;
+	if (cmap.maxLabel() == 0) {
+		// Completely white image?
+		return;
+	}
+
 	status.throwIfCancelled();
 
-	// Unify big components into one.
-	std::vector<uint32_t> remapping_table(components.size());
+	int const width = image.width();
+	int const height = image.height();
+
+	uint32_t const max_orig_label = cmap.maxLabel();
+
+	// Unify big components into one.  The cached analysis keeps
+	// original labels, as this unification depends on the level,
+	// so we work through a remapping table instead of remapping
+	// the map itself.
+	std::vector<Component> components(max_orig_label + 1);
+	std::vector<uint32_t> remapping_table(max_orig_label + 1);
 	uint32_t unified_big_component = 0;
 	uint32_t next_avail_component = 1;
-	for (uint32_t label = 1; label <= cmap.maxLabel(); ++label) {
-		if (bounding_boxes[label].width() < settings.bigObjectThreshold &&
-				bounding_boxes[label].height() < settings.bigObjectThreshold) {
-			components[next_avail_component] = components[label];
+	for (uint32_t label = 1; label <= max_orig_label; ++label) {
+		if (a.boundingBoxes[label].width() < big_object_threshold &&
+				a.boundingBoxes[label].height() < big_object_threshold) {
+			components[next_avail_component].num_pixels = a.numPixels[label];
 			remapping_table[label] = next_avail_component;
 			++next_avail_component;
 		} else {
 			if (unified_big_component == 0) {
 				unified_big_component = next_avail_component;
 				++next_avail_component;
-				components[unified_big_component] = components[label];
 				// Set num_pixels to a large value so that canBeAttachedTo()
 				// always allows attaching to any such component.
 				components[unified_big_component].num_pixels = width * height;
@@ -767,45 +1025,25 @@ Despeckle::despeckleInPlace(
 		}
 	}
 	components.resize(next_avail_component);
-	std::vector<BoundingBox>().swap(bounding_boxes); // We don't need them any more.
-	
+
 	status.throwIfCancelled();
 
 	uint32_t const max_label = next_avail_component - 1;
-	
-	// Remapping individual pixels.
-	cmap_line = cmap_data;
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			cmap_line[x] = remapping_table[cmap_line[x]];
-		}
-		cmap_line += cmap_stride;
-	}
-	if (dbg) {
-		dbg->add(cmap.visualized(), "big_components_unified");
-	}
-
-	status.throwIfCancelled();
-	
-	// Build a Voronoi diagram.
-	std::vector<Distance> distance_matrix;
-	voronoi(cmap, distance_matrix);
-	if (dbg) {
-		dbg->add(cmap.visualized(), "voronoi");
-	}
-	
-	status.throwIfCancelled();
 
-	Distance* const distance_data = &distance_matrix[0] + width + 3;
-	
-	// Now build a bidirectional map of distances between neighboring
-	// connected components.
-	
+	// Bring the cached connections into the remapped label space.
+	// Connections between components that unify into one disappear,
+	// connections merging together keep the minimum distance.
 	typedef std::map<Connection, uint32_t> Connections; // conn -> sqdist
 	Connections conns;
-	
-	voronoiDistances(cmap, distance_matrix, conns);
-	
+
+	BOOST_FOREACH(Connections::value_type const& pair, a.conns) {
+		uint32_t const label1 = remapping_table[pair.first.lesser_label];
+		uint32_t const label2 = remapping_table[pair.first.greater_label];
+		if (label1 != label2) {
+			updateDistance(conns, label1, label2, pair.second);
+		}
+	}
+
 	status.throwIfCancelled();
 
 	// Tag connected components with ANCHORED_TO_BIG or ANCHORED_TO_SMALL.
@@ -814,78 +1052,77 @@ Despeckle::despeckleInPlace(
 		uint32_t const sqdist = pair.second;
 		Component& comp1 = components[conn.lesser_label];
 		Component& comp2 = components[conn.greater_label];
-		tagSourceComponent(comp1, comp2, sqdist, settings);
-		tagSourceComponent(comp2, comp1, sqdist, settings);
+		tagSourceComponent<L>(comp1, comp2, sqdist, min_relative_parent_weight);
+		tagSourceComponent<L>(comp2, comp1, sqdist, min_relative_parent_weight);
 	}
-	
+
 	// Prevent it from growing when we compute the Voronoi diagram
 	// the second time.
 	components[unified_big_component].setAnchoredToBig();
-	
+
 	bool have_anchored_to_small_but_not_big = false;
 	BOOST_FOREACH(Component const& comp, components) {
 		have_anchored_to_small_but_not_big = comp.anchoredToSmallButNotBig();
 	}
-	
+
 	if (have_anchored_to_small_but_not_big) {
-		
+
 		status.throwIfCancelled();
-		
+
 		// Give such components a second chance.  Maybe they do have
 		// big neighbors, but Voronoi regions from a smaller ones
 		// block the path to the bigger ones.
-		
-		Distance const zero_distance(Distance::zero());
-		Distance const special_distance(Distance::special());
-		for (int y = 0, offset = 0; y < height; ++y, offset += 2) {
-			for (int x = 0; x < width; ++x, ++offset) {
-				uint32_t const label = cmap_data[offset];
-				assert(label != 0);
-				
-				Component const& comp = components[label];
-				if (!comp.anchoredToSmallButNotBig()) {
-					if (distance_data[offset] == zero_distance) {
-						// Prevent this region from growing
-						// and from being taken over by another
-						// by another region.
-						distance_data[offset] = special_distance;
-					} else {
-						// Allow this region to be taken over by others.
-						// Note: x + 1 here is equivalent to x
-						// in voronoi() or voronoiSpecial().
-						distance_data[offset].reset(x + 1);
-					}
-				}
-			}
-		}
-		
+
+		// This pass mutates the connectivity map and the distance
+		// matrix, so it operates on copies, keeping the cached
+		// analysis pristine.
+		ConnectivityMap mutable_cmap(cmap);
+		std::vector<Distance> distance_matrix(a.distanceMatrix);
+		uint32_t* const cmap_data = mutable_cmap.data();
+		Distance* const distance_data = &distance_matrix[0] + width + 3;
+
+		DistanceResetter const resetter(
+			cmap_data, distance_data, width, mutable_cmap.stride(),
+			components, remapping_table
+		);
+		parallelForRanges(0, height, resetter);
+
 		status.throwIfCancelled();
 
+		Distance const special_distance(Distance::special());
+
 		// Calculate the Voronoi diagram again, but this time
 		// treat pixels with a special distance in such a way
 		// to prevent them from spreading but also preventing
 		// them from being overwritten.
-		voronoiSpecial(cmap, distance_matrix, special_distance);
+		voronoiSpecial(mutable_cmap, distance_matrix, special_distance);
 		if (dbg) {
-			dbg->add(cmap.visualized(), "voronoi_special");
+			dbg->add(mutable_cmap.visualized(), "voronoi_special");
 		}
-		
+
 		status.throwIfCancelled();
 
-		// We've got new connections.  Add them to the map.
-		voronoiDistances(cmap, distance_matrix, conns);
+		// We've got new connections.  They are in the original
+		// label space, so they go through the remapping table
+		// on their way to the map.
+		Connections new_conns;
+		voronoiDistances(mutable_cmap, distance_matrix, new_conns);
+		BOOST_FOREACH(Connections::value_type const& pair, new_conns) {
+			uint32_t const label1 = remapping_table[pair.first.lesser_label];
+			uint32_t const label2 = remapping_table[pair.first.greater_label];
+			if (label1 != label2) {
+				updateDistance(conns, label1, label2, pair.second);
+			}
+		}
 	}
-	
+
 	status.throwIfCancelled();
 
-	// Clear the distance matrix.
-	std::vector<Distance>().swap(distance_matrix);
-	
 	// Remove tags from components.
 	BOOST_FOREACH(Component& comp, components) {
 		comp.clearTags();
 	}
-	
+
 	// Build a directional connection map and only include
 	// good connections, that is those with a small enough
 	// distance.
@@ -898,10 +1135,10 @@ Despeckle::despeckleInPlace(
 		uint32_t const sqdist = it->second;
 		Component const& comp1 = components[label1];
 		Component const& comp2 = components[label2];
-		if (canBeAttachedTo(comp1, comp2, sqdist, settings)) {
+		if (canBeAttachedTo<L>(comp1, comp2, sqdist, min_relative_parent_weight)) {
 			target_source.push_back(TargetSourceConn(label2, label1));
 		}
-		if (canBeAttachedTo(comp2, comp1, sqdist, settings)) {
+		if (canBeAttachedTo<L>(comp2, comp1, sqdist, min_relative_parent_weight)) {
 			target_source.push_back(TargetSourceConn(label1, label2));
 		}
 		conns.erase(it);
@@ -955,17 +1192,62 @@ Despeckle::despeckleInPlace(
 	status.throwIfCancelled();
 
 	// Remove unmarked components from the binary image.
-	uint32_t const msb = uint32_t(1) << 31;
-	uint32_t* image_line = image.data();
-	int const image_stride = image.wordsPerLine();
-	cmap_line = cmap_data;
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			if (!components[cmap_line[x]].anchoredToBig()) {
-				image_line[x >> 5] &= ~(msb >> (x & 31));
-			}
-		}
-		image_line += image_stride;
-		cmap_line += cmap_stride;
+	// Calling data() here rather than in the workers makes sure
+	// any copy-on-write happens on this thread.
+	ComponentEraser const eraser(
+		image.data(), image.wordsPerLine(),
+		cmap, components, remapping_table
+	);
+	parallelForRanges(0, height, eraser);
+}
+
+} // anonymous namespace
+
+
+IntrusivePtr<Despeckle::Analysis>
+Despeckle::createAnalysis()
+{
+	return IntrusivePtr<Analysis>(new AnalysisImpl);
+}
+
+BinaryImage
+Despeckle::despeckle(
+	BinaryImage const& src, Dpi const& dpi, Level const level,
+	TaskStatus const& status, DebugImages* const dbg,
+	Analysis* const analysis)
+{
+	BinaryImage dst(src);
+	despeckleInPlace(dst, dpi, level, status, dbg, analysis);
+	return dst;
+}
+
+void
+Despeckle::despeckleInPlace(
+	BinaryImage& image, Dpi const& dpi, Level const level,
+	TaskStatus const& status, DebugImages* const dbg,
+	Analysis* const analysis)
+{
+	AnalysisImpl local_analysis;
+	AnalysisImpl* const a = analysis
+		? static_cast<AnalysisImpl*>(analysis) : &local_analysis;
+	if (!a->valid) {
+		buildAnalysis(image, status, dbg, *a);
+	}
+
+	int const min_dpi = std::min(dpi.horizontal(), dpi.vertical());
+	double const dpi_factor = min_dpi / 300.0;
+
+	// The level is fixed for the whole page, so pick the right
+	// instantiation once rather than branching per component.
+	switch (level) {
+		case CAUTIOUS:
+			despeckleLevelDependent<CAUTIOUS>(image, *a, dpi_factor, status, dbg);
+			break;
+		case NORMAL:
+			despeckleLevelDependent<NORMAL>(image, *a, dpi_factor, status, dbg);
+			break;
+		case AGGRESSIVE:
+			despeckleLevelDependent<AGGRESSIVE>(image, *a, dpi_factor, status, dbg);
+			break;
 	}
 }
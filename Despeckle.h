@@ -19,6 +19,9 @@
 #ifndef DESPECKLE_H_
 #define DESPECKLE_H_
 
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+
 class Dpi;
 class TaskStatus;
 class DebugImages;
@@ -33,6 +36,30 @@ class Despeckle
 public:
 	enum Level { CAUTIOUS, NORMAL, AGGRESSIVE };
 
+	/**
+	 * \brief Level-independent intermediate results of despeckle().
+	 *
+	 * Speckle candidate detection (connected component analysis,
+	 * the Voronoi diagram and inter-component distances) doesn't
+	 * depend on the despeckling level - only the final scoring does.
+	 * Passing the same Analysis object to several despeckle() calls
+	 * over the same image makes all but the first one skip the
+	 * expensive part.
+	 *
+	 * An Analysis is bound to the image it was filled from and is
+	 * not thread-safe.
+	 */
+	class Analysis : public RefCountable
+	{
+	protected:
+		Analysis() {}
+	};
+
+	/**
+	 * \brief Creates an empty Analysis, to be filled by despeckle().
+	 */
+	static IntrusivePtr<Analysis> createAnalysis();
+
 	/**
 	 * \brief Removes small speckles from a binary image.
 	 *
@@ -41,18 +68,23 @@ public:
 	 * \param level Despeckling aggressiveness.
 	 * \param dbg An optional sink for debugging images.
 	 * \param status For asynchronous task cancellation.
+	 * \param analysis An optional cache of level-independent results.
+	 *        An empty one gets filled, a filled one must have been
+	 *        filled from the same \p src.
 	 * \return The despeckled image.
 	 */
 	static imageproc::BinaryImage despeckle(
 		imageproc::BinaryImage const& src, Dpi const& dpi, Level level,
-		TaskStatus const& status, DebugImages* dbg = 0);
+		TaskStatus const& status, DebugImages* dbg = 0,
+		Analysis* analysis = 0);
 
 	/**
 	 * \brief A slightly faster, in-place version of despeckle().
 	 */
 	static void despeckleInPlace(
 		imageproc::BinaryImage& image, Dpi const& dpi,
-		Level level, TaskStatus const& status, DebugImages* dbg = 0);
+		Level level, TaskStatus const& status, DebugImages* dbg = 0,
+		Analysis* analysis = 0);
 };
 
 #endif
@@ -35,12 +35,15 @@
 #include "imageproc/GrayRasterOp.h"
 #include "imageproc/RasterOpGeneric.h"
 #include "imageproc/SeedFill.h"
+#include "imageproc/ParallelFor.h"
 #include <QImage>
 #include <QColor>
 #include <QSize>
 #include <QPolygonF>
 #include <QTransform>
 #include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
 #include <Qt>
 #ifndef Q_MOC_RUN
 #include <boost/lambda/lambda.hpp>
@@ -48,6 +51,7 @@
 #include <boost/lambda/control_structures.hpp>
 #endif
 #include <vector>
+#include <deque>
 #include <algorithm>
 #include <stdint.h>
 #include <assert.h>
@@ -62,6 +66,177 @@ struct AbsoluteDifference
 	}
 };
 
+namespace
+{
+
+/**
+ * FNV-1a over the image bytes.  At 300x300 pixels this costs a tiny
+ * fraction of the morphological work whose result it keys.
+ */
+uint64_t hashGrayImage(GrayImage const& image)
+{
+	uint64_t hash = UINT64_C(14695981039346656037);
+	hash = (hash ^ uint64_t(image.width())) * UINT64_C(1099511628211);
+	hash = (hash ^ uint64_t(image.height())) * UINT64_C(1099511628211);
+
+	uint8_t const* line = image.data();
+	int const stride = image.stride();
+	int const width = image.width();
+	int const height = image.height();
+	for (int y = 0; y < height; ++y, line += stride) {
+		for (int x = 0; x < width; ++x) {
+			hash = (hash ^ line[x]) * UINT64_C(1099511628211);
+		}
+	}
+	return hash;
+}
+
+/**
+ * \brief Checkpoints of the morphological prelude, keyed by a content
+ *        hash of the downscaled image.
+ *
+ * The seed fills, the morphological open and the polynomial surface
+ * fit at the start of background estimation dominate its cost, and an
+ * interactive render canceled by the next slider tick used to throw
+ * all of that away.  The inputs to the prelude - the page image and
+ * its transformation - rarely change between such re-renders, so a
+ * restarted estimation finds the prelude's result here and resumes
+ * from the masking phase instead of recomputing.
+ *
+ * A handful of entries suffices: re-renders of the current page hit
+ * the same key, and anything older than a few pages back is unlikely
+ * to be revisited while still unchanged.
+ */
+class PreludeCheckpoints
+{
+public:
+	static PreludeCheckpoints& instance() {
+		static PreludeCheckpoints obj;
+		return obj;
+	}
+
+	bool lookup(uint64_t const key, GrayImage& out) {
+		QMutexLocker const locker(&m_mutex);
+		for (std::deque<Entry>::const_iterator it(m_entries.begin());
+				it != m_entries.end(); ++it) {
+			if (it->key == key) {
+				out = it->image;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void store(uint64_t const key, GrayImage const& image) {
+		QMutexLocker const locker(&m_mutex);
+		if (m_entries.size() >= MAX_ENTRIES) {
+			m_entries.pop_front();
+		}
+		Entry entry;
+		entry.key = key;
+		entry.image = image;
+		m_entries.push_back(entry);
+	}
+private:
+	struct Entry
+	{
+		uint64_t key;
+		GrayImage image;
+	};
+
+	enum { MAX_ENTRIES = 4 };
+
+	QMutex m_mutex;
+	std::deque<Entry> m_entries;
+};
+
+/**
+ * \brief Smooths image columns with polynomials and masks pixels that
+ *        became significantly lighter, one 64-column tile at a time.
+ *
+ * Walking a column directly costs a stride-wide step per pixel, which
+ * thrashes the cache on wide pages.  Instead, each tile is gathered
+ * into a column-major buffer with cache-blocked passes, fitted and
+ * compared at unit stride there, and only the mask is written back.
+ * A tile spans whole mask words, so tiles are independent of each
+ * other and are processed in parallel.
+ */
+class MaskByColumnPolynomials
+{
+public:
+	enum { TILE_WIDTH = 64 };
+
+	MaskByColumnPolynomials(
+		uint8_t const* bg_data, int bg_stride,
+		uint32_t* mask_data, int mask_stride,
+		int width, int height, TaskStatus const& status)
+	:	m_pBgData(bg_data), m_bgStride(bg_stride),
+		m_pMaskData(mask_data), m_maskStride(mask_stride),
+		m_width(width), m_height(height), m_rStatus(status) {}
+
+	void operator()(int const begin_tile, int const end_tile) const {
+		int const height = m_height;
+		uint32_t const msb = uint32_t(1) << 31;
+		std::vector<uint8_t> tile(TILE_WIDTH * height);
+		std::vector<uint8_t> smoothed(TILE_WIDTH * height);
+
+		for (int t = begin_tile; t < end_tile; ++t) {
+			if (m_rStatus.isCancelled()) {
+				// Bail out quietly - the exception is thrown by
+				// the thread that launched us, once all the
+				// workers are done.
+				return;
+			}
+
+			int const x0 = t * TILE_WIDTH;
+			int const tile_w = std::min<int>(TILE_WIDTH, m_width - x0);
+
+			// Gather the tile into a column-major buffer.  Rows are
+			// processed in bands, so that the 64 cache lines a band
+			// writes to stay hot until the band is done with them.
+			for (int y0 = 0; y0 < height; y0 += TILE_WIDTH) {
+				int const band_h = std::min<int>(TILE_WIDTH, height - y0);
+				uint8_t const* bg_line = m_pBgData + y0 * m_bgStride + x0;
+				for (int y = y0; y < y0 + band_h; ++y, bg_line += m_bgStride) {
+					for (int c = 0; c < tile_w; ++c) {
+						tile[c * height + y] = bg_line[c];
+					}
+				}
+			}
+
+			// Fit and evaluate every column at unit stride.
+			int const degree = 2;
+			for (int c = 0; c < tile_w; ++c) {
+				PolynomialLine pl(degree, &tile[c * height], height, 1);
+				pl.output(&smoothed[c * height], height, 1);
+			}
+
+			// Write the mask row by row, banded like the gather.
+			for (int y0 = 0; y0 < height; y0 += TILE_WIDTH) {
+				int const band_h = std::min<int>(TILE_WIDTH, height - y0);
+				uint32_t* mask_line = m_pMaskData + y0 * m_maskStride + (x0 >> 5);
+				for (int y = y0; y < y0 + band_h; ++y, mask_line += m_maskStride) {
+					for (int c = 0; c < tile_w; ++c) {
+						if (tile[c * height + y] + 30 < smoothed[c * height + y]) {
+							mask_line[c >> 5] &= ~(msb >> (c & 31));
+						}
+					}
+				}
+			}
+		}
+	}
+private:
+	uint8_t const* m_pBgData;
+	int m_bgStride;
+	uint32_t* m_pMaskData;
+	int m_maskStride;
+	int m_width;
+	int m_height;
+	TaskStatus const& m_rStatus;
+};
+
+} // anonymous namespace
+
 /**
  * The same as seedFillGrayInPlace() with a seed of two black lines
  * at top and bottom, except here colors may only spread vertically.
@@ -95,7 +270,8 @@ static void seedFillTopBottomInPlace(GrayImage& image)
 	}
 }
 
-static void morphologicalPreprocessingInPlace(GrayImage& image, DebugImages* dbg)
+static void morphologicalPreprocessingInPlace(
+	GrayImage& image, TaskStatus const& status, DebugImages* dbg)
 {
 	using namespace boost::lambda;
 
@@ -109,6 +285,8 @@ static void morphologicalPreprocessingInPlace(GrayImage& image, DebugImages* dbg
 	GrayImage method1(createFramedImage(image.size()));
 	seedFillGrayInPlace(method1, image, CONN8);
 
+	status.throwIfCancelled();
+
 	// This will get rid of the remnants of letters.  Note that since we know we
 	// are working with at most 300x300 px images, we can just hardcode the size.
 	method1 = openGray(method1, QSize(1, 20), 0x00);
@@ -116,11 +294,15 @@ static void morphologicalPreprocessingInPlace(GrayImage& image, DebugImages* dbg
 		dbg->add(method1, "preproc_method1");
 	}
 
+	status.throwIfCancelled();
+
 	seedFillTopBottomInPlace(image);
 	if (dbg) {
 		dbg->add(image, "preproc_method2");
 	}
 
+	status.throwIfCancelled();
+
 	// Now let's estimate, which of the methods is better for this case.
 
 	// Take the difference between two methods.
@@ -137,6 +319,9 @@ static void morphologicalPreprocessingInPlace(GrayImage& image, DebugImages* dbg
 	// If it fits well into our data set, we consider the difference
 	// to be caused by a shadow rather than a picture, and use method1.
 	GrayImage approximated(PolynomialSurface(3, 3, diff).render(diff.size()));
+
+	status.throwIfCancelled();
+
 	if (dbg) {
 		dbg->add(approximated, "approx_diff");
 	}
@@ -192,7 +377,17 @@ imageproc::PolynomialSurface estimateBackground(
 	
 	status.throwIfCancelled();
 
-	morphologicalPreprocessingInPlace(background, dbg);
+	// With debugging on, the prelude always runs, so its
+	// intermediate images make it into the debug view.
+	if (dbg) {
+		morphologicalPreprocessingInPlace(background, status, dbg);
+	} else {
+		uint64_t const checkpoint_key = hashGrayImage(background);
+		if (!PreludeCheckpoints::instance().lookup(checkpoint_key, background)) {
+			morphologicalPreprocessingInPlace(background, status, dbg);
+			PreludeCheckpoints::instance().store(checkpoint_key, background);
+		}
+	}
 
 	status.throwIfCancelled();
 	
@@ -227,26 +422,16 @@ imageproc::PolynomialSurface estimateBackground(
 	
 	status.throwIfCancelled();
 	
-	// Smooth every horizontal line with a polynomial,
-	// then mask pixels that became significantly lighter.
-	for (int x = 0; x < width; ++x) {
-		uint32_t const mask = ~(msb >> (x & 31));
-		
-		int const degree = 2;
-		PolynomialLine pl(degree, bg_data + x, height, bg_stride);
-		pl.output(&line[0], height, 1);
-		
-		uint8_t const* p_bg = bg_data + x;
-		uint32_t* p_mask = mask_data + (x >> 5);
-		for (int y = 0; y < height; ++y) {
-			if (*p_bg + 30 < line[y]) {
-				*p_mask &= mask;
-			}
-			p_bg += bg_stride;
-			p_mask += mask_stride;
-		}
-	}
-	
+	// Smooth every column with a polynomial, then mask pixels
+	// that became significantly lighter.
+	int const num_tiles = (width + MaskByColumnPolynomials::TILE_WIDTH - 1)
+			/ MaskByColumnPolynomials::TILE_WIDTH;
+	parallelForRanges(
+		0, num_tiles, MaskByColumnPolynomials(
+			bg_data, bg_stride, mask_data, mask_stride, width, height, status
+		)
+	);
+
 	status.throwIfCancelled();
 	
 	// Smooth every vertical line with a polynomial,
@@ -254,6 +439,10 @@ imageproc::PolynomialSurface estimateBackground(
 	uint8_t const* bg_line = bg_data;
 	uint32_t* mask_line = mask_data;
 	for (int y = 0; y < height; ++y) {
+		if ((y & 63) == 0) {
+			status.throwIfCancelled();
+		}
+
 		int const degree = 4;
 		PolynomialLine pl(degree, bg_line, width, 1);
 		pl.output(&line[0], width, 1);
@@ -24,6 +24,7 @@
 #include <QDomDocument>
 #include <QDomElement>
 #include <QMutex>
+#include <map>
 #ifndef Q_MOC_RUN
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -51,6 +52,8 @@ public:
 
 	int registerFile(QString const& file_path);
 
+	void registerFiles(std::vector<QString> const& file_paths);
+
 	void performRelinking(AbstractRelinker const& relinker);
 private:
 	class ItemsByFilePathTag;
@@ -145,6 +148,12 @@ FileNameDisambiguator::registerFile(QString const& file_path)
 	return m_ptrImpl->registerFile(file_path);
 }
 
+void
+FileNameDisambiguator::registerFiles(std::vector<QString> const& file_paths)
+{
+	m_ptrImpl->registerFiles(file_paths);
+}
+
 void
 FileNameDisambiguator::performRelinking(AbstractRelinker const& relinker)
 {
@@ -262,6 +271,54 @@ FileNameDisambiguator::Impl::registerFile(QString const& file_path)
 	return label;
 }
 
+void
+FileNameDisambiguator::Impl::registerFiles(std::vector<QString> const& file_paths)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	// Group the new files by name, so that the current highest label
+	// of each name is looked up once per group rather than once per
+	// file.  Registering n files this way is O(n log n) overall.
+	typedef std::map<QString, std::vector<QString> > GroupsByName;
+	GroupsByName groups_by_name;
+
+	std::set<QString> seen;
+	BOOST_FOREACH(QString const& file_path, file_paths) {
+		if (!seen.insert(file_path).second) {
+			continue; // A duplicate within this very batch.
+		}
+		if (m_itemsByFilePath.find(file_path) != m_itemsByFilePath.end()) {
+			continue; // Already registered.
+		}
+		groups_by_name[QFileInfo(file_path).fileName()].push_back(file_path);
+	}
+
+	BOOST_FOREACH(GroupsByName::value_type const& group, groups_by_name) {
+		QString const& file_name = group.first;
+		int next_label = 0;
+
+		ItemsByFileNameLabel::iterator const fn_it(
+			m_itemsByFileNameLabel.upper_bound(boost::make_tuple(file_name))
+		);
+		// If the item preceding fn_it has the same file name,
+		// the new files belong to the same disambiguation group.
+		if (fn_it != m_itemsByFileNameLabel.begin()) {
+			ItemsByFileNameLabel::iterator prev(fn_it);
+			--prev;
+			if (prev->fileName == file_name) {
+				next_label = prev->label + 1;
+			}
+		}
+
+		BOOST_FOREACH(QString const& file_path, group.second) {
+			m_itemsByFileNameLabel.insert(
+				fn_it, Item(file_path, file_name, next_label)
+			);
+			++next_label;
+		}
+	}
+}
+
 void
 FileNameDisambiguator::Impl::performRelinking(AbstractRelinker const& relinker)
 {
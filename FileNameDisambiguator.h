@@ -24,6 +24,7 @@
 #include <boost/function.hpp>
 #include <memory>
 #include <set>
+#include <vector>
 
 class AbstractRelinker;
 class QString;
@@ -81,6 +82,16 @@ public:
 
 	int registerFile(QString const& file_path);
 
+	/**
+	 * \brief Registers a batch of files in one go.
+	 *
+	 * Equivalent to calling registerFile() on every path, but takes
+	 * the lock once and resolves the current label for each distinct
+	 * file name once per group rather than once per file.  Paths that
+	 * are already registered keep their existing labels.
+	 */
+	void registerFiles(std::vector<QString> const& file_paths);
+
 	void performRelinking(AbstractRelinker const& relinker);
 private:
 	class Impl;
@@ -17,9 +17,11 @@
 */
 
 #include "FilterData.h"
+#include "FilterDataCache.h"
 #include "Dpm.h"
 #include "Dpi.h"
 #include "imageproc/Grayscale.h"
+#include "imageproc/ReduceThreshold.h"
 
 using namespace imageproc;
 
@@ -29,12 +31,77 @@ FilterData::FilterData(QImage const& image)
 	m_xform(image.rect(), Dpm(image)),
 	m_bwThreshold(BinaryThreshold::otsuThreshold(m_grayImage))
 {
+	m_ptrSharedAnalysis.reset(new SharedAnalysis(m_grayImage, m_bwThreshold));
+}
+
+FilterData::FilterData(ImageId const& image_id, QImage const& image)
+:	m_origImage(image),
+	m_xform(image.rect(), Dpm(image)),
+	m_bwThreshold(0)
+{
+	int bw_threshold = 0;
+	m_grayImage = FilterDataCache::instance().get(
+		image_id, m_origImage, bw_threshold
+	);
+	m_bwThreshold = BinaryThreshold(bw_threshold);
+	m_ptrSharedAnalysis.reset(new SharedAnalysis(m_grayImage, m_bwThreshold));
 }
 
 FilterData::FilterData(FilterData const& other, ImageTransformation const& xform)
 :	m_origImage(other.m_origImage),
 	m_grayImage(other.m_grayImage),
 	m_xform(xform),
-	m_bwThreshold(other.m_bwThreshold)
+	m_bwThreshold(other.m_bwThreshold),
+	m_ptrSharedAnalysis(other.m_ptrSharedAnalysis)
+{
+}
+
+BinaryImage const&
+FilterData::fullSizeBinary() const
+{
+	return m_ptrSharedAnalysis->fullSizeBinary();
+}
+
+BinaryImage const&
+FilterData::reducedBinary(int const levels) const
 {
+	return m_ptrSharedAnalysis->reducedBinary(levels);
+}
+
+
+/*====================== FilterData::SharedAnalysis ======================*/
+
+FilterData::SharedAnalysis::SharedAnalysis(
+	GrayImage const& gray_image, BinaryThreshold const threshold)
+:	m_grayImage(gray_image),
+	m_bwThreshold(threshold)
+{
+}
+
+BinaryImage const&
+FilterData::SharedAnalysis::fullSizeBinary()
+{
+	if (m_fullSizeBinary.isNull() && !m_grayImage.isNull()) {
+		m_fullSizeBinary = BinaryImage(m_grayImage, m_bwThreshold);
+	}
+	return m_fullSizeBinary;
+}
+
+BinaryImage const&
+FilterData::SharedAnalysis::reducedBinary(int const levels)
+{
+	if (levels <= 0) {
+		return fullSizeBinary();
+	}
+
+	if ((int)m_reductions.size() < levels) {
+		BinaryImage const& base = m_reductions.empty()
+			? fullSizeBinary() : m_reductions.back();
+		std::vector<int> const thresholds(levels - m_reductions.size(), 2);
+		std::vector<BinaryImage> const new_levels(reducePyramid(base, thresholds));
+		m_reductions.insert(
+			m_reductions.end(), new_levels.begin(), new_levels.end()
+		);
+	}
+	return m_reductions[levels - 1];
 }
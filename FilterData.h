@@ -20,30 +20,87 @@
 #define FILTERDATA_H_
 
 #include "imageproc/BinaryThreshold.h"
+#include "imageproc/BinaryImage.h"
 #include "imageproc/GrayImage.h"
 #include "ImageTransformation.h"
+#include "IntrusivePtr.h"
+#include "RefCountable.h"
 #include <QImage>
+#include <vector>
+
+class ImageId;
 
 class FilterData
 {
 	// Member-wise copying is OK.
 public:
 	FilterData(QImage const& image);
-	
+
+	/**
+	 * \brief Same as the above, but shares the grayscale version and
+	 *        the binarization threshold through FilterDataCache, so
+	 *        they don't get recomputed on every stage re-run.
+	 */
+	FilterData(ImageId const& image_id, QImage const& image);
+
 	FilterData(FilterData const& other, ImageTransformation const& xform);
-		
+
 	imageproc::BinaryThreshold bwThreshold() const { return m_bwThreshold; }
-	
+
 	ImageTransformation const& xform() const { return m_xform; }
 
 	QImage const& origImage() const {return m_origImage;}
 
 	imageproc::GrayImage const& grayImage() const {return m_grayImage;}
+
+	/**
+	 * \brief The full-size image binarized at bwThreshold().
+	 *
+	 * Built on first access and shared between all the FilterData
+	 * objects derived from each other through the copying constructor,
+	 * so that consecutive stages processing the same image don't each
+	 * binarize it from scratch.
+	 *
+	 * \note The shared analysis is not thread-safe.  That's fine, as
+	 *       the stages of a single page are processed sequentially
+	 *       on the same worker thread.
+	 */
+	imageproc::BinaryImage const& fullSizeBinary() const;
+
+	/**
+	 * \brief The full-size binary reduced 2x \p levels times.
+	 *
+	 * Reductions are done with ReduceThreshold and cached, again
+	 * shared between the stages.  Passing zero levels gives
+	 * fullSizeBinary().
+	 */
+	imageproc::BinaryImage const& reducedBinary(int levels) const;
 private:
+	/**
+	 * \brief Lazily built analysis artifacts shared between stages.
+	 */
+	class SharedAnalysis : public RefCountable
+	{
+	public:
+		SharedAnalysis(
+			imageproc::GrayImage const& gray_image,
+			imageproc::BinaryThreshold threshold);
+
+		imageproc::BinaryImage const& fullSizeBinary();
+
+		imageproc::BinaryImage const& reducedBinary(int levels);
+	private:
+		imageproc::GrayImage m_grayImage;
+		imageproc::BinaryThreshold m_bwThreshold;
+		imageproc::BinaryImage m_fullSizeBinary;
+		std::vector<imageproc::BinaryImage> m_reductions;
+	};
+
 	QImage m_origImage;
 	imageproc::GrayImage m_grayImage;
 	ImageTransformation m_xform;
 	imageproc::BinaryThreshold m_bwThreshold;
+	IntrusivePtr<SharedAnalysis> m_ptrSharedAnalysis;
 };
 
 #endif
@@ -0,0 +1,125 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FilterDataCache.h"
+#include "imageproc/Grayscale.h"
+#include "imageproc/BinaryThreshold.h"
+#include <QImage>
+#include <QMutexLocker>
+
+using namespace imageproc;
+
+FilterDataCache::FilterDataCache()
+:	m_cachedBytes(0),
+	m_memoryBudget(DEFAULT_MEMORY_BUDGET)
+{
+}
+
+FilterDataCache&
+FilterDataCache::instance()
+{
+	// Just like with OutOfMemoryHandler, the first call happens
+	// early on, from a single thread.
+	static FilterDataCache object;
+
+	return object;
+}
+
+GrayImage
+FilterDataCache::get(
+	ImageId const& image_id, QImage const& image, int& bw_threshold)
+{
+	{
+		QMutexLocker const locker(&m_mutex);
+
+		Map::iterator const it(m_map.find(image_id));
+		if (it != m_map.end()) {
+			Entry& entry = it->second;
+			if (entry.grayImage.size() == image.size()) {
+				// Mark as recently used.
+				m_lru.erase(entry.lruIt);
+				entry.lruIt = m_lru.insert(m_lru.begin(), image_id);
+
+				bw_threshold = entry.bwThreshold;
+				return entry.grayImage;
+			}
+
+			// The file was replaced with another one.
+			m_cachedBytes -= imageBytes(entry.grayImage);
+			m_lru.erase(entry.lruIt);
+			m_map.erase(it);
+		}
+	}
+
+	// Computing outside of the lock, so parallel jobs
+	// don't serialize on each other's conversions.
+	GrayImage const gray(image);
+	int const threshold = BinaryThreshold::otsuThreshold(gray);
+
+	QMutexLocker const locker(&m_mutex);
+
+	Entry& entry = m_map[image_id];
+	if (entry.grayImage.isNull()) {
+		entry.lruIt = m_lru.insert(m_lru.begin(), image_id);
+		m_cachedBytes += imageBytes(gray);
+	}
+	entry.grayImage = gray;
+	entry.bwThreshold = threshold;
+	enforceBudget();
+
+	bw_threshold = threshold;
+	return gray;
+}
+
+void
+FilterDataCache::remove(ImageId const& image_id)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	Map::iterator const it(m_map.find(image_id));
+	if (it != m_map.end()) {
+		m_cachedBytes -= imageBytes(it->second.grayImage);
+		m_lru.erase(it->second.lruIt);
+		m_map.erase(it);
+	}
+}
+
+void
+FilterDataCache::setMemoryBudget(size_t const bytes)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_memoryBudget = bytes;
+	enforceBudget();
+}
+
+void
+FilterDataCache::enforceBudget()
+{
+	while (m_cachedBytes > m_memoryBudget && !m_lru.empty()) {
+		Map::iterator const it(m_map.find(m_lru.back()));
+		m_cachedBytes -= imageBytes(it->second.grayImage);
+		m_map.erase(it);
+		m_lru.pop_back();
+	}
+}
+
+size_t
+FilterDataCache::imageBytes(GrayImage const& image)
+{
+	return size_t(image.stride()) * image.height();
+}
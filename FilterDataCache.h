@@ -0,0 +1,96 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FILTER_DATA_CACHE_H_
+#define FILTER_DATA_CACHE_H_
+
+#include "NonCopyable.h"
+#include "ImageId.h"
+#include "imageproc/GrayImage.h"
+#include <QMutex>
+#include <list>
+#include <map>
+#include <stddef.h>
+
+class QImage;
+
+/**
+ * \brief A process-wide cache of per-image derived data.
+ *
+ * Every time a stage's Task chain re-runs on a page, FilterData used
+ * to redo the grayscale conversion and the Otsu threshold of the same
+ * unchanged image.  This cache shares those immutable results across
+ * stages and re-runs, keyed by ImageId.  It's size-bounded, evicting
+ * the least recently used entries, and safe to use from multiple
+ * batch processing threads.
+ */
+class FilterDataCache
+{
+	DECLARE_NON_COPYABLE(FilterDataCache)
+public:
+	static FilterDataCache& instance();
+
+	/**
+	 * \brief Returns the grayscale version of \p image and its
+	 *        binarization threshold, consulting the cache first.
+	 *
+	 * A cached entry is considered stale if the image dimensions
+	 * have changed, which is the same heuristic LoadFileTask uses
+	 * to detect a replaced file.
+	 */
+	imageproc::GrayImage get(
+		ImageId const& image_id, QImage const& image, int& bw_threshold);
+
+	/**
+	 * \brief Drops the entry for a particular image, if present.
+	 */
+	void remove(ImageId const& image_id);
+
+	/**
+	 * \brief Sets the total budget for cached images, in bytes.
+	 */
+	void setMemoryBudget(size_t bytes);
+private:
+	struct Entry
+	{
+		imageproc::GrayImage grayImage;
+		int bwThreshold;
+		std::list<ImageId>::iterator lruIt;
+
+		Entry() : bwThreshold(0) {}
+	};
+
+	typedef std::map<ImageId, Entry> Map;
+
+	enum { DEFAULT_MEMORY_BUDGET = 256 * 1024 * 1024 };
+
+	FilterDataCache();
+
+	/** Must be called with the mutex held. */
+	void enforceBudget();
+
+	static size_t imageBytes(imageproc::GrayImage const& image);
+
+	QMutex m_mutex;
+	Map m_map;
+	std::list<ImageId> m_lru; /**< Most recently used first. */
+	size_t m_cachedBytes;
+	size_t m_memoryBudget;
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include "PageId.h"
 #include "PageInfo.h"
 #include <QWidget>
+#include <set>
 
 class FilterOptionsWidget : public QWidget
 {
@@ -41,7 +42,13 @@ signals:
 	void invalidateThumbnail(PageInfo const& page_info);
 	
 	void invalidateAllThumbnails();
-	
+
+	/**
+	 * Same as invalidateAllThumbnails(), but only rebuilds the
+	 * thumbnails of the specified pages.
+	 */
+	void invalidateThumbnails(std::set<PageId> const& pages);
+
 	/**
 	 * After we've got rid of "Widest Page" / "Tallest Page" links,
 	 * there is no one using this signal.  It's a candidate for removal.
@@ -22,6 +22,7 @@
 #include "PageId.h"
 #include "AbstractCommand.h"
 #include "IntrusivePtr.h"
+#include <set>
 
 class DebugImages;
 class FilterOptionsWidget;
@@ -45,9 +46,17 @@ public:
 		DebugImages* debug_images = 0) = 0;
 	
 	virtual void invalidateThumbnail(PageId const& page_id) = 0;
-	
+
 	virtual void invalidateAllThumbnails() = 0;
 
+	/**
+	 * Same as invalidateAllThumbnails(), but only rebuilds the
+	 * thumbnails of the specified pages.  Use it when the set of
+	 * affected pages is known - on large projects rebuilding
+	 * every thumbnail freezes the UI for seconds.
+	 */
+	virtual void invalidateThumbnails(std::set<PageId> const& pages) = 0;
+
 	/**
 	 * Returns a callable object that when called will open a relinking dialog.
 	 */
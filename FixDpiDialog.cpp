@@ -36,6 +36,8 @@
 #include <boost/lambda/bind.hpp>
 #endif
 #include <vector>
+#include <map>
+#include <utility>
 #include <algorithm>
 #include <assert.h>
 
@@ -66,28 +68,28 @@ static int const AGGREGATE_NOT_OK_METADATA_ROLE = Qt::UserRole + 1;
 class FixDpiDialog::DpiCounts
 {
 public:
-	void add(ImageMetadata const& metadata);
-	
+	struct MetadataComparator
+	{
+		bool operator()(ImageMetadata const& lhs, ImageMetadata const& rhs) const;
+	};
+
+	void add(ImageMetadata const& metadata, int count = 1);
+
 	void remove(ImageMetadata const& metadata);
-	
+
 	/**
 	 * Checks if all ImageMetadata objects return true for ImageMetadata::isDpiOK().
 	 */
 	bool allDpisOK() const;
-	
+
 	/**
 	 * If all ImageMetadata objects are equal, one of them will be returned.
 	 * Otherwise, a default-constructed ImageMetadata() object will be returned.
 	 */
 	ImageMetadata aggregate(Scope scope) const;
 private:
-	struct MetadataComparator
-	{
-		bool operator()(ImageMetadata const& lhs, ImageMetadata const& rhs) const;
-	};
-	
 	typedef std::map<ImageMetadata, int, MetadataComparator> Map;
-	
+
 	Map m_counts;
 };
 
@@ -135,9 +137,13 @@ public:
 	};
 	
 	SizeGroup(QSize const& size) : m_size(size) {}
-	
-	void append(Item const& item, ImageMetadata const& metadata);
-	
+
+	/**
+	 * Appends an item without touching the DPI counts - those are
+	 * accumulated from metadata clusters afterwards.
+	 */
+	void appendItem(Item const& item) { m_items.push_back(item); }
+
 	QSize const& size() const { return m_size; }
 	
 	std::vector<Item> const& items() const { return m_items; }
@@ -205,6 +211,10 @@ private:
 	
 	std::vector<ImageFileInfo> m_files;
 	std::vector<SizeGroup> m_sizes;
+
+	/** Maps (width, height) to an index into m_sizes. */
+	std::map<std::pair<int, int>, size_t> m_sizeGroupIndexes;
+
 	DpiCounts m_dpiCounts;
 };
 
@@ -490,9 +500,9 @@ FixDpiDialog::decorateDpiInputField(QLineEdit* field, ImageMetadata::DpiStatus d
 /*====================== FixDpiDialog::DpiCounts ======================*/
 
 void
-FixDpiDialog::DpiCounts::add(ImageMetadata const& metadata)
+FixDpiDialog::DpiCounts::add(ImageMetadata const& metadata, int const count)
 {
-	++m_counts[metadata];
+	m_counts[metadata] += count;
 }
 
 void
@@ -543,16 +553,6 @@ FixDpiDialog::DpiCounts::aggregate(Scope const scope) const
 
 
 
-/*====================== FixDpiDialog::SizeGroup ======================*/
-
-void
-FixDpiDialog::SizeGroup::append(Item const& item, ImageMetadata const& metadata)
-{
-	m_items.push_back(item);
-	m_dpiCounts.add(metadata);
-}
-
-
 /*====================== FixDpiDialog::TreeModel ======================*/
 
 FixDpiDialog::TreeModel::Tag FixDpiDialog::TreeModel::m_allPagesNodeId;
@@ -561,17 +561,30 @@ FixDpiDialog::TreeModel::Tag FixDpiDialog::TreeModel::m_sizeGroupNodeId;
 FixDpiDialog::TreeModel::TreeModel(std::vector<ImageFileInfo> const& files)
 :	m_files(files)
 {
+	// A project has tens of thousands of pages but rarely more than
+	// a handful of distinct (size, dpi) combinations.  Cluster the
+	// identical metadata first and update the aggregate counts once
+	// per cluster rather than once per image.
+	typedef std::map<ImageMetadata, int, DpiCounts::MetadataComparator> ClusterMap;
+	ClusterMap clusters;
+
 	int const num_files = m_files.size();
 	for (int i = 0; i < num_files; ++i) {
 		ImageFileInfo const& file = m_files[i];
 		int const num_images = file.imageInfo().size();
 		for (int j = 0; j < num_images; ++j) {
 			ImageMetadata const& metadata = file.imageInfo()[j];
-			SizeGroup& group = sizeGroupFor(metadata.size());
-			group.append(SizeGroup::Item(i, j), metadata);
-			m_dpiCounts.add(metadata);
+			sizeGroupFor(metadata.size()).appendItem(SizeGroup::Item(i, j));
+			++clusters[metadata];
 		}
 	}
+
+	BOOST_FOREACH(ClusterMap::value_type const& cluster, clusters) {
+		m_dpiCounts.add(cluster.first, cluster.second);
+		sizeGroupFor(cluster.first.size()).dpiCounts().add(
+			cluster.first, cluster.second
+		);
+	}
 }
 
 bool
@@ -840,20 +853,18 @@ FixDpiDialog::TreeModel::emitItemChanged(QModelIndex const& idx)
 FixDpiDialog::SizeGroup&
 FixDpiDialog::TreeModel::sizeGroupFor(QSize const size)
 {
-	using namespace boost::lambda;
-	
-	std::vector<SizeGroup>::iterator const it(
-		std::find_if(
-			m_sizes.begin(), m_sizes.end(),
-			bind(&SizeGroup::size, _1) == size
-		)
+	std::pair<int, int> const key(size.width(), size.height());
+
+	std::map<std::pair<int, int>, size_t>::const_iterator const it(
+		m_sizeGroupIndexes.find(key)
 	);
-	if (it != m_sizes.end()) {
-		return *it;
-	} else {
-		m_sizes.push_back(SizeGroup(size));
-		return m_sizes.back();
+	if (it != m_sizeGroupIndexes.end()) {
+		return m_sizes[it->second];
 	}
+
+	m_sizeGroupIndexes[key] = m_sizes.size();
+	m_sizes.push_back(SizeGroup(size));
+	return m_sizes.back();
 }
 
 QString
@@ -0,0 +1,74 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ForegroundExecutor.h"
+#include <QTime>
+
+namespace
+{
+
+/**
+ * How long increments may run before yielding to the event loop.
+ * At 5ms the scheduling overhead is negligible while repaints still
+ * happen well within a frame.
+ */
+int const SLICE_MSEC = 5;
+
+} // anonymous namespace
+
+ForegroundExecutor&
+ForegroundExecutor::instance()
+{
+	static ForegroundExecutor obj;
+	return obj;
+}
+
+ForegroundExecutor::ForegroundExecutor()
+:	m_timerId(0)
+{
+}
+
+void
+ForegroundExecutor::enqueue(JobPtr const& job)
+{
+	m_jobs.push_back(job);
+	if (m_timerId == 0) {
+		// A zero interval timer fires whenever the event queue
+		// runs dry, which is exactly when we may take a slice.
+		m_timerId = startTimer(0);
+	}
+}
+
+void
+ForegroundExecutor::timerEvent(QTimerEvent* event)
+{
+	QTime slice;
+	slice.start();
+
+	while (!m_jobs.empty()) {
+		if (!(*m_jobs.front())()) {
+			m_jobs.pop_front();
+		}
+		if (slice.elapsed() >= SLICE_MSEC) {
+			return; // The timer will fire again.
+		}
+	}
+
+	killTimer(m_timerId);
+	m_timerId = 0;
+}
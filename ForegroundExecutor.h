@@ -0,0 +1,74 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FOREGROUNDEXECUTOR_H_
+#define FOREGROUNDEXECUTOR_H_
+
+#include "NonCopyable.h"
+#include "AbstractCommand.h"
+#include "IntrusivePtr.h"
+#include <QObject>
+#include <deque>
+
+/**
+ * \brief Runs long jobs on the GUI thread in short, cooperative slices.
+ *
+ * Some work is tied to the GUI thread - it touches widgets, graphics
+ * scenes or other single-threaded state - yet takes long enough on big
+ * projects to freeze painting and input when run in one go.  This
+ * executor is the counterpart of BackgroundExecutor for such jobs:
+ * a job is written as a resumable increment, and the executor drives
+ * it from the event loop, running increments for a few milliseconds
+ * at a time and then yielding, so event processing never stalls for
+ * longer than one slice.
+ *
+ * Jobs run in submission order, one at a time.  A job is a command
+ * returning \c true while it has more work left; returning \c false
+ * retires it.  Jobs must tolerate arbitrary event processing between
+ * increments - anything they reference may be touched by other event
+ * handlers in the meantime, so they should capture what they need up
+ * front or re-validate it per increment.
+ *
+ * All methods must be called from the GUI thread.
+ */
+class ForegroundExecutor : public QObject
+{
+	DECLARE_NON_COPYABLE(ForegroundExecutor)
+public:
+	/** A resumable job.  Returns true while more work remains. */
+	typedef IntrusivePtr<AbstractCommand0<bool> > JobPtr;
+
+	static ForegroundExecutor& instance();
+
+	/**
+	 * \brief Queues a job for sliced execution.
+	 *
+	 * The first increment runs once control returns to the event
+	 * loop, never from within this call.
+	 */
+	void enqueue(JobPtr const& job);
+protected:
+	virtual void timerEvent(QTimerEvent* event);
+private:
+	ForegroundExecutor();
+
+	std::deque<JobPtr> m_jobs;
+	int m_timerId; /**< Zero when no jobs are pending. */
+};
+
+#endif
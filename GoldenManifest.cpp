@@ -0,0 +1,204 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GoldenManifest.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <iostream>
+
+namespace
+{
+
+char const MANIFEST_HEADER[] = "# ScanTailor golden manifest, format 1";
+
+} // anonymous namespace
+
+
+GoldenManifest::GoldenManifest()
+{
+}
+
+void
+GoldenManifest::addStage(QString const& path, double const seconds)
+{
+	m_stageSeconds[path] = seconds;
+}
+
+void
+GoldenManifest::addFile(QString const& file_path)
+{
+	m_fileHashes[QFileInfo(file_path).fileName()] = hashFile(file_path);
+}
+
+QString
+GoldenManifest::hashFile(QString const& file_path)
+{
+	QFile file(file_path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return "unreadable";
+	}
+
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	for (;;) {
+		QByteArray const chunk(file.read(1024 * 1024));
+		if (chunk.isEmpty()) {
+			break;
+		}
+		hash.addData(chunk);
+	}
+
+	return QString::fromAscii(hash.result().toHex());
+}
+
+bool
+GoldenManifest::load(QString const& manifest_path)
+{
+	QFile file(manifest_path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	m_stageSeconds.clear();
+	m_fileHashes.clear();
+
+	QTextStream strm(&file);
+	for (;;) {
+		QString const line(strm.readLine());
+		if (line.isNull()) {
+			break;
+		}
+		if (line.isEmpty() || line.startsWith(QChar('#'))) {
+			continue;
+		}
+
+		// The name comes last, as file names may contain spaces.
+		int const first_sep = line.indexOf(QChar(' '));
+		int const second_sep = line.indexOf(QChar(' '), first_sep + 1);
+		if (first_sep < 0 || second_sep < 0) {
+			return false;
+		}
+
+		QString const kind(line.left(first_sep));
+		QString const value(line.mid(first_sep + 1, second_sep - first_sep - 1));
+		QString const name(line.mid(second_sep + 1));
+
+		if (kind == "stage") {
+			m_stageSeconds[name] = value.toDouble();
+		} else if (kind == "file") {
+			m_fileHashes[name] = value;
+		} else {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+GoldenManifest::save(QString const& manifest_path) const
+{
+	QFile file(manifest_path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		return false;
+	}
+
+	QTextStream strm(&file);
+	strm << MANIFEST_HEADER << "\n";
+
+	std::map<QString, double>::const_iterator s_it(m_stageSeconds.begin());
+	std::map<QString, double>::const_iterator const s_end(m_stageSeconds.end());
+	for (; s_it != s_end; ++s_it) {
+		strm << "stage " << QString::number(s_it->second, 'f', 3)
+			<< " " << s_it->first << "\n";
+	}
+
+	std::map<QString, QString>::const_iterator f_it(m_fileHashes.begin());
+	std::map<QString, QString>::const_iterator const f_end(m_fileHashes.end());
+	for (; f_it != f_end; ++f_it) {
+		strm << "file " << f_it->second << " " << f_it->first << "\n";
+	}
+
+	strm.flush();
+
+	return file.error() == QFile::NoError;
+}
+
+int
+GoldenManifest::check(
+	GoldenManifest const& current, double const tolerance_percent) const
+{
+	int problems = 0;
+
+	// Output files: bit-exact, both ways.
+	std::map<QString, QString>::const_iterator f_it(m_fileHashes.begin());
+	std::map<QString, QString>::const_iterator const f_end(m_fileHashes.end());
+	for (; f_it != f_end; ++f_it) {
+		std::map<QString, QString>::const_iterator const c_it(
+			current.m_fileHashes.find(f_it->first)
+		);
+		if (c_it == current.m_fileHashes.end()) {
+			std::cout << f_it->first.toAscii().constData()
+				<< ": missing from this run\n";
+			++problems;
+		} else if (c_it->second != f_it->second) {
+			std::cout << f_it->first.toAscii().constData()
+				<< ": output differs from golden ("
+				<< c_it->second.toAscii().constData() << " vs "
+				<< f_it->second.toAscii().constData() << ")\n";
+			++problems;
+		}
+	}
+	f_it = current.m_fileHashes.begin();
+	for (; f_it != current.m_fileHashes.end(); ++f_it) {
+		if (m_fileHashes.find(f_it->first) == m_fileHashes.end()) {
+			std::cout << f_it->first.toAscii().constData()
+				<< ": not present in the golden manifest\n";
+			++problems;
+		}
+	}
+
+	// Stage budgets: recorded time plus tolerance.
+	std::map<QString, double>::const_iterator s_it(m_stageSeconds.begin());
+	std::map<QString, double>::const_iterator const s_end(m_stageSeconds.end());
+	for (; s_it != s_end; ++s_it) {
+		std::map<QString, double>::const_iterator const c_it(
+			current.m_stageSeconds.find(s_it->first)
+		);
+		if (c_it == current.m_stageSeconds.end()) {
+			continue;
+		}
+
+		double const budget
+			= s_it->second * (1.0 + tolerance_percent / 100.0);
+		if (c_it->second > budget) {
+			std::cout << s_it->first.toAscii().constData()
+				<< ": over time budget ("
+				<< QString::number(c_it->second, 'f', 3).toAscii().constData()
+				<< "s vs "
+				<< QString::number(s_it->second, 'f', 3).toAscii().constData()
+				<< "s recorded, +"
+				<< QString::number(tolerance_percent, 'f', 0).toAscii().constData()
+				<< "% allowed)\n";
+			++problems;
+		}
+	}
+
+	return problems;
+}
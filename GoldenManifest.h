@@ -0,0 +1,82 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GOLDEN_MANIFEST_H_
+#define GOLDEN_MANIFEST_H_
+
+#include <QString>
+#include <map>
+#include <vector>
+
+/**
+ * \brief Recorded output hashes and stage timings of a reference batch run.
+ *
+ * Backs the --golden-record / --golden-check command line options:
+ * a reference run over a representative corpus records a hash per
+ * output file and the total wall time per profiler bucket; later
+ * runs over the same corpus are checked against it.  An output hash
+ * mismatch or a stage exceeding its recorded time by more than the
+ * tolerance fails the check, which makes optimization work safe -
+ * a rewrite can't silently change output bits or slow a stage down.
+ *
+ * The manifest is a small text file meant to be kept under version
+ * control next to the corpus.  Files are keyed by name, not path,
+ * so the output directory may differ between record and check.
+ */
+class GoldenManifest
+{
+	// Member-wise copying is OK.
+public:
+	GoldenManifest();
+
+	void addStage(QString const& path, double seconds);
+
+	/**
+	 * \brief Hashes \p file_path and records it under its file name.
+	 *
+	 * Unreadable files are recorded with a distinctive value, so
+	 * they still compare unequal to any real hash.
+	 */
+	void addFile(QString const& file_path);
+
+	bool load(QString const& manifest_path);
+
+	bool save(QString const& manifest_path) const;
+
+	/**
+	 * \brief Compares a fresh run against this (golden) manifest.
+	 *
+	 * Problems - hash mismatches, missing outputs, stages over
+	 * budget - are printed to stdout.  A stage is over budget when
+	 * its time exceeds the recorded one by more than
+	 * \p tolerance_percent.  Stages absent from either side are
+	 * ignored: timings may legitimately gain or lose buckets as
+	 * instrumentation evolves, unlike output files, where both
+	 * missing and extra entries are reported.
+	 *
+	 * \return The number of problems found, zero for a clean check.
+	 */
+	int check(GoldenManifest const& current, double tolerance_percent) const;
+private:
+	static QString hashFile(QString const& file_path);
+
+	std::map<QString, double> m_stageSeconds;
+	std::map<QString, QString> m_fileHashes;
+};
+
+#endif
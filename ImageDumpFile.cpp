@@ -0,0 +1,185 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImageDumpFile.h"
+#include "PackBits.h"
+#include <QImage>
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QRgb>
+#include <stdint.h>
+#include <string.h>
+
+namespace
+{
+
+char const MAGIC[8] = { 'S', 'T', 'D', 'U', 'M', 'P', '1', '\n' };
+
+int tightBytesPerLine(QImage::Format const format, int const width)
+{
+	switch (format) {
+		case QImage::Format_Mono:
+		case QImage::Format_MonoLSB:
+			return (width + 7) / 8;
+		case QImage::Format_Indexed8:
+			return width;
+		default:
+			return width * 4;
+	}
+}
+
+} // anonymous namespace
+
+bool
+ImageDumpFile::write(QImage const& image, QIODevice& device)
+{
+	QImage src(image);
+	switch (src.format()) {
+		case QImage::Format_Mono:
+		case QImage::Format_MonoLSB:
+		case QImage::Format_Indexed8:
+		case QImage::Format_RGB32:
+		case QImage::Format_ARGB32:
+			break;
+		default:
+			src = image.convertToFormat(QImage::Format_ARGB32);
+			if (src.isNull()) {
+				return false;
+			}
+	}
+
+	// Note that we only touch the pixels through a const reference,
+	// so that the QImage we share data with doesn't get detached.
+	QImage const& csrc = src;
+
+	int const width = csrc.width();
+	int const height = csrc.height();
+	int const bytes_per_line = tightBytesPerLine(csrc.format(), width);
+
+	QByteArray coded;
+	for (int y = 0; y < height; ++y) {
+		packBitsEncode(csrc.scanLine(y), bytes_per_line, coded);
+	}
+
+	QDataStream strm(&device);
+	strm.writeRawData(MAGIC, sizeof(MAGIC));
+	strm << quint32(csrc.format()) << quint32(width) << quint32(height);
+
+	QVector<QRgb> const table(csrc.colorTable());
+	strm << quint32(table.size());
+	for (int i = 0; i < table.size(); ++i) {
+		strm << quint32(table[i]);
+	}
+
+	strm << quint32(coded.size());
+	strm.writeRawData(coded.constData(), coded.size());
+
+	return strm.status() == QDataStream::Ok;
+}
+
+bool
+ImageDumpFile::write(QImage const& image, QString const& file_path)
+{
+	QFile file(file_path);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+
+	return write(image, file) && file.flush();
+}
+
+QImage
+ImageDumpFile::read(QString const& file_path)
+{
+	QFile file(file_path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QImage();
+	}
+
+	char magic[sizeof(MAGIC)];
+	if (file.read(magic, sizeof(magic)) != qint64(sizeof(magic))
+			|| memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+		return QImage();
+	}
+
+	QDataStream strm(&file);
+	quint32 format = 0, width = 0, height = 0, color_count = 0;
+	strm >> format >> width >> height >> color_count;
+
+	switch (format) {
+		case QImage::Format_Mono:
+		case QImage::Format_MonoLSB:
+		case QImage::Format_Indexed8:
+		case QImage::Format_RGB32:
+		case QImage::Format_ARGB32:
+			break;
+		default:
+			return QImage();
+	}
+	if (width == 0 || height == 0 || color_count > 256) {
+		return QImage();
+	}
+
+	QVector<QRgb> table(color_count);
+	for (quint32 i = 0; i < color_count; ++i) {
+		quint32 color = 0;
+		strm >> color;
+		table[i] = color;
+	}
+
+	quint32 coded_size = 0;
+	strm >> coded_size;
+	if (strm.status() != QDataStream::Ok) {
+		return QImage();
+	}
+
+	QImage image(width, height, QImage::Format(format));
+	if (image.isNull()) {
+		return QImage();
+	}
+	if (!table.isEmpty()) {
+		image.setColorTable(table);
+	}
+
+	int const bytes_per_line = tightBytesPerLine(image.format(), width);
+	qint64 const raw_size = qint64(bytes_per_line) * height;
+	if (raw_size != qint64(int(raw_size))) {
+		return QImage();
+	}
+
+	QByteArray const coded(file.read(coded_size));
+	QByteArray unpacked;
+	unpacked.resize(int(raw_size));
+	if (coded.size() != int(coded_size) || !packBitsDecode(
+			(uint8_t const*)coded.constData(), coded.size(),
+			(uint8_t*)unpacked.data(), unpacked.size())) {
+		return QImage();
+	}
+
+	for (quint32 y = 0; y < height; ++y) {
+		memcpy(
+			image.scanLine(y),
+			unpacked.constData() + qint64(y) * bytes_per_line,
+			bytes_per_line
+		);
+	}
+
+	return image;
+}
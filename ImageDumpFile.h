@@ -0,0 +1,68 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGE_DUMP_FILE_H_
+#define IMAGE_DUMP_FILE_H_
+
+class QImage;
+class QIODevice;
+class QString;
+
+/**
+ * \brief Fast lossless image dumps for our own transient files.
+ *
+ * Debug snapshots and the automask / speckles sidecars are written
+ * once per page processing run and re-read whenever the user comes
+ * back to inspect or re-edit, so both directions have to be cheap.
+ * Rather than going through an image plugin, rows are tightly packed
+ * and PackBits run-length coded: close to memcpy() speed either way,
+ * while the flat areas that dominate masks and intermediates still
+ * collapse by an order of magnitude.
+ *
+ * This is a private format for files scantailor both writes and
+ * reads back itself - never for files the user is meant to keep.
+ */
+class ImageDumpFile
+{
+public:
+	/**
+	 * \brief Writes \p image to a device in the dump format.
+	 *
+	 * 1 bit, 8 bit indexed and 32 bit images are written as is,
+	 * anything else as 32 bit ARGB.  Returns false on failure.
+	 * The image is only accessed through const methods, so the
+	 * caller's copy never detaches.
+	 */
+	static bool write(QImage const& image, QIODevice& device);
+
+	/**
+	 * \brief Convenience overload writing to a file.
+	 */
+	static bool write(QImage const& image, QString const& file_path);
+
+	/**
+	 * \brief Reads back a dump, returning a null image on failure.
+	 *
+	 * A missing file, a file in some other format and a corrupt
+	 * dump all just produce a null image, leaving the caller to
+	 * fall back or regenerate.
+	 */
+	static QImage read(QString const& file_path);
+};
+
+#endif
@@ -18,11 +18,74 @@
 
 #include "ImageLoader.h"
 #include "TiffReader.h"
+#include "JpegReader.h"
 #include "ImageId.h"
 #include <QImage>
 #include <QString>
+#include <QSize>
 #include <QIODevice>
 #include <QFile>
+#include <QBuffer>
+#include <QByteArray>
+#include <limits.h>
+
+namespace
+{
+
+/**
+ * \brief Memory-maps a file and exposes the mapping through a QBuffer.
+ *
+ * The decoders then read straight from the page cache without an
+ * intermediate copy, and multiple processes working on the same
+ * project share a single cached copy of each image file.  When
+ * mapping fails (exotic filesystems, files over 2GB), device()
+ * returns the file itself and reads go through it directly.
+ */
+class MappedFile
+{
+public:
+	MappedFile(QFile& file);
+
+	~MappedFile();
+
+	QIODevice& device() { return *m_pDevice; }
+private:
+	QFile& m_rFile;
+	uchar* m_pMapped;
+	QBuffer m_buffer;
+	QIODevice* m_pDevice;
+};
+
+MappedFile::MappedFile(QFile& file)
+:	m_rFile(file),
+	m_pMapped(0),
+	m_pDevice(&file)
+{
+	qint64 const size = file.size();
+	if (size > 0 && size <= INT_MAX) {
+		m_pMapped = file.map(0, size);
+	}
+	if (m_pMapped) {
+		m_buffer.setData(
+			QByteArray::fromRawData((char const*)m_pMapped, int(size))
+		);
+		m_buffer.open(QIODevice::ReadOnly);
+		m_pDevice = &m_buffer;
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_pMapped) {
+		// The buffer references the mapped memory, so take
+		// it down before the mapping goes away.
+		m_buffer.close();
+		m_buffer.setData(QByteArray());
+		m_rFile.unmap(m_pMapped);
+	}
+}
+
+} // anonymous namespace
 
 QImage
 ImageLoader::load(ImageId const& image_id)
@@ -37,7 +100,16 @@ ImageLoader::load(QString const& file_path, int const page_num)
 	if (!file.open(QIODevice::ReadOnly)) {
 		return QImage();
 	}
-	return load(file, page_num);
+
+	// TIFFs bypass the wrapper: TiffReader does its own buffered I/O,
+	// and its zero-copy path for uncompressed files requires the QFile
+	// itself, which a buffer over the mapping would hide from it.
+	if (TiffReader::canRead(file)) {
+		return TiffReader::readImage(file, page_num);
+	}
+
+	MappedFile mapped(file);
+	return load(mapped.device(), page_num);
 }
 
 QImage
@@ -56,3 +128,31 @@ ImageLoader::load(QIODevice& io_dev, int const page_num)
 	image.load(&io_dev, 0);
 	return image;
 }
+
+QImage
+ImageLoader::loadDownscaled(ImageId const& image_id, QSize const& bounding_size)
+{
+	QFile file(image_id.filePath());
+	if (!file.open(QIODevice::ReadOnly)) {
+		return QImage();
+	}
+
+	// Same as in load() above: give TiffReader the QFile itself.
+	if (TiffReader::canRead(file)) {
+		return TiffReader::readImage(file, image_id.zeroBasedPage());
+	}
+
+	MappedFile mapped(file);
+	QIODevice& io_dev = mapped.device();
+
+	if (image_id.zeroBasedPage() == 0 && JpegReader::canRead(io_dev)) {
+		QImage image(JpegReader::readImage(io_dev, bounding_size));
+		if (!image.isNull()) {
+			return image;
+		}
+		// Fall back to decoding at full size.
+		io_dev.seek(0);
+	}
+
+	return load(io_dev, image_id.zeroBasedPage());
+}
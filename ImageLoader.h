@@ -22,6 +22,7 @@
 class ImageId;
 class QImage;
 class QString;
+class QSize;
 class QIODevice;
 
 class ImageLoader
@@ -30,8 +31,19 @@ public:
 	static QImage load(QString const& file_path, int page_num = 0);
 
 	static QImage load(ImageId const& image_id);
-	
+
 	static QImage load(QIODevice& io_dev, int page_num);
+
+	/**
+	 * \brief Loads an image that is only needed at a bounded size.
+	 *
+	 * When the format supports it (currently JPEG), the image is
+	 * downscaled already during decoding, which is much cheaper
+	 * than decoding at full size and scaling down afterwards.
+	 * The result is still large enough to be scaled down to fit
+	 * \p bounding_size, but may well be the full size image.
+	 */
+	static QImage loadDownscaled(ImageId const& image_id, QSize const& bounding_size);
 };
 
 #endif
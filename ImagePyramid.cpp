@@ -0,0 +1,153 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImagePyramid.h"
+#include "imageproc/Scale.h"
+#include "imageproc/GrayImage.h"
+#include <QMutexLocker>
+#include <QSize>
+#include <list>
+#include <map>
+
+using namespace imageproc;
+
+namespace
+{
+
+/** Don't build levels smaller than this in either dimension. */
+int const MIN_LEVEL_SIZE = 32;
+
+/** How many recently used pyramids to keep alive. */
+size_t const MAX_CACHED_PYRAMIDS = 8;
+
+/**
+ * Recently used pyramids, keyed by QImage::cacheKey() of their
+ * full resolution image.  The pyramids themselves are refcounted,
+ * so one evicted here while a view still uses it simply lives on
+ * with that view.
+ */
+class PyramidRegistry
+{
+public:
+	PyramidRegistry() {}
+
+	IntrusivePtr<ImagePyramid> lookup(qint64 key);
+
+	void insert(qint64 key, IntrusivePtr<ImagePyramid> const& pyramid);
+private:
+	typedef std::map<qint64, IntrusivePtr<ImagePyramid> > Map;
+
+	QMutex m_mutex;
+	Map m_map;
+	std::list<qint64> m_lru; /**< Most recently used first. */
+};
+
+
+PyramidRegistry pyramid_registry;
+
+
+IntrusivePtr<ImagePyramid>
+PyramidRegistry::lookup(qint64 const key)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	Map::const_iterator const it(m_map.find(key));
+	if (it == m_map.end()) {
+		return IntrusivePtr<ImagePyramid>();
+	}
+
+	m_lru.remove(key);
+	m_lru.push_front(key);
+
+	return it->second;
+}
+
+void
+PyramidRegistry::insert(qint64 const key, IntrusivePtr<ImagePyramid> const& pyramid)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (m_map.insert(Map::value_type(key, pyramid)).second) {
+		m_lru.push_front(key);
+	}
+
+	while (m_lru.size() > MAX_CACHED_PYRAMIDS) {
+		m_map.erase(m_lru.back());
+		m_lru.pop_back();
+	}
+}
+
+} // anonymous namespace
+
+
+IntrusivePtr<ImagePyramid>
+ImagePyramid::forImage(QImage const& image)
+{
+	qint64 const key = image.cacheKey();
+
+	IntrusivePtr<ImagePyramid> pyramid(pyramid_registry.lookup(key));
+	if (!pyramid.get()) {
+		pyramid.reset(new ImagePyramid(image));
+		pyramid_registry.insert(key, pyramid);
+	}
+
+	return pyramid;
+}
+
+ImagePyramid::ImagePyramid(QImage const& image)
+{
+	m_levels.push_back(image);
+}
+
+QImage
+ImagePyramid::levelFor(QSize const& target_size)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	size_t level = 0;
+	for (;;) {
+		QImage const& current = m_levels[level];
+
+		QSize const half(
+			qMax(current.width() / 2, 1), qMax(current.height() / 2, 1)
+		);
+		if (half.width() < target_size.width()
+				|| half.height() < target_size.height()
+				|| half.width() < MIN_LEVEL_SIZE
+				|| half.height() < MIN_LEVEL_SIZE) {
+			return current;
+		}
+
+		if (level + 1 == m_levels.size()) {
+			QImage next;
+			if (current.isGrayscale() && current.depth() <= 8) {
+				next = scaleToGray(GrayImage(current), half);
+			} else {
+				next = current.scaled(
+					half, Qt::IgnoreAspectRatio,
+					Qt::SmoothTransformation
+				);
+			}
+			if (next.isNull()) {
+				return current;
+			}
+			m_levels.push_back(next);
+		}
+		++level;
+	}
+}
@@ -0,0 +1,76 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGE_PYRAMID_H_
+#define IMAGE_PYRAMID_H_
+
+#include "NonCopyable.h"
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+#include <QImage>
+#include <QMutex>
+#include <vector>
+
+/**
+ * \brief A lazily built factor-of-2 mip pyramid over an image.
+ *
+ * Interactive views need downscaled versions of the same full
+ * resolution image over and over - on construction, on zoom changes,
+ * on tab switches.  Deriving each of those from the full image is
+ * what makes big pages feel sluggish.  A pyramid halves the image
+ * level by level (scaleToGray() for grayscale, smooth scaling
+ * otherwise), so any requested size is produced from the smallest
+ * level that still covers it.
+ *
+ * Pyramids are shared: forImage() returns the same pyramid for the
+ * same underlying image data, with a small LRU of recent pyramids
+ * kept alive to cover tab switches.  Levels above the original cost
+ * about a third of it in total, and only materialize as far down as
+ * they are actually requested.
+ *
+ * All methods are thread-safe.
+ */
+class ImagePyramid : public RefCountable
+{
+	DECLARE_NON_COPYABLE(ImagePyramid)
+public:
+	/**
+	 * \brief Returns the shared pyramid for this image.
+	 *
+	 * Images are identified by their underlying data, so all
+	 * implicitly shared copies of the same QImage get the same
+	 * pyramid.  Never returns null for a non-null image.
+	 */
+	static IntrusivePtr<ImagePyramid> forImage(QImage const& image);
+
+	/**
+	 * \brief Returns the smallest level covering \p target_size.
+	 *
+	 * The returned image is at most 2x the target in either
+	 * dimension, leaving at most one cheap final rescale to the
+	 * caller.  Missing levels are built on demand.
+	 */
+	QImage levelFor(QSize const& target_size);
+private:
+	explicit ImagePyramid(QImage const& image);
+
+	QMutex m_mutex;
+	std::vector<QImage> m_levels; /**< [0] is the original. */
+};
+
+#endif
@@ -20,8 +20,10 @@
 #include "ImageViewBase.h.moc"
 #include "NonCopyable.h"
 #include "ImagePresentation.h"
+#include "ImagePyramid.h"
 #include "OpenGLSupport.h"
 #include "PixmapRenderer.h"
+#include "ViewPixmapCache.h"
 #include "BackgroundExecutor.h"
 #include "Dpm.h"
 #include "Dpi.h"
@@ -37,6 +39,7 @@
 #include <QPainterPath>
 #include <QBrush>
 #include <QLineF>
+#include <QRect>
 #include <QPolygonF>
 #include <QPalette>
 #include <QMouseEvent>
@@ -68,7 +71,7 @@ public:
 	HqTransformTask(
 		ImageViewBase* image_view,
 		QImage const& image, QTransform const& xform,
-		QSize const& target_size);
+		QRect const& tile_rect);
 	
 	void cancel() { m_ptrResult->cancel(); }
 	
@@ -98,7 +101,7 @@ private:
 	IntrusivePtr<Result> m_ptrResult;
 	QImage m_image;
 	QTransform m_xform;
-	QSize m_targetSize;
+	QRect m_tileRect;
 };
 
 
@@ -159,6 +162,7 @@ ImageViewBase::ImageViewBase(
 	m_transformChangeWatchersActive(0),
 	m_ignoreScrollEvents(0),
 	m_ignoreResizeEvents(0),
+	m_hqPendingTiles(0),
 	m_hqTransformEnabled(true)
 {
 #ifdef ENABLE_OPENGL
@@ -182,12 +186,17 @@ ImageViewBase::ImageViewBase(
 	setFrameShape(QFrame::NoFrame);
 	viewport()->setFocusPolicy(Qt::WheelFocus);
 
-	if (downscaled_version.isNull()) {
-		m_pixmap = QPixmap::fromImage(createDownscaledImage(image));
-	} else if (downscaled_version.pixmap().isNull()) {
-		m_pixmap = QPixmap::fromImage(downscaled_version.image());
-	} else {
+	if (!downscaled_version.isNull() && !downscaled_version.pixmap().isNull()) {
 		m_pixmap = downscaled_version.pixmap();
+	} else if (!ViewPixmapCache::instance().lookup(image.cacheKey(), m_pixmap)) {
+		if (downscaled_version.isNull()) {
+			m_pixmap = QPixmap::fromImage(createDownscaledImage(image));
+		} else {
+			m_pixmap = QPixmap::fromImage(downscaled_version.image());
+		}
+		// Revisiting this page will reuse the pixmap, and with it
+		// the texture the OpenGL paint engine caches for it.
+		ViewPixmapCache::instance().store(image.cacheKey(), m_pixmap);
 	}
 	
 	m_pixmapToImage.scale(
@@ -228,10 +237,7 @@ ImageViewBase::hqTransformSetEnabled(bool const enabled)
 	if (!enabled && m_hqTransformEnabled) {
 		// Turning off.
 		m_hqTransformEnabled = false;
-		if (m_ptrHqTransformTask.get()) {
-			m_ptrHqTransformTask->cancel();
-			m_ptrHqTransformTask.reset();
-		}
+		cancelHqTransformTasks();
 		if (!m_hqPixmap.isNull()) {
 			m_hqPixmap = QPixmap();
 			update();
@@ -265,10 +271,19 @@ ImageViewBase::createDownscaledImage(QImage const& image)
 		return image;
 	}
 	
+	// Sample from the shared pyramid rather than the full image.
+	// Views over the same image get the same pyramid, so most of
+	// the scaling work is done only once.
+	IntrusivePtr<ImagePyramid> const pyramid(ImagePyramid::forImage(image));
+	QImage const level(pyramid->levelFor(QSize(d_w, d_h)));
+	if (level.width() == d_w && level.height() == d_h) {
+		return level;
+	}
+
 	QTransform xform;
-	xform.scale((double)d_w / o_w, (double)d_h / o_h);
+	xform.scale((double)d_w / level.width(), (double)d_h / level.height());
 	return transform(
-		image, xform, QRect(0, 0, d_w, d_h),
+		level, xform, QRect(0, 0, d_w, d_h),
 		OutsidePixels::assumeColor(Qt::white)
 	);
 }
@@ -442,10 +457,73 @@ ImageViewBase::ensureStatusTip(QString const& status_tip)
 	}
 }
 
+bool
+ImageViewBase::BackdropState::matches(BackdropState const& other) const
+{
+	return virtualToWidget == other.virtualToWidget
+		&& virtualImageCropArea == other.virtualImageCropArea
+		&& pixmapCacheKey == other.pixmapCacheKey
+		&& hqPixmapCacheKey == other.hqPixmapCacheKey
+		&& hqPixmapPos == other.hqPixmapPos
+		&& viewportSize == other.viewportSize
+		&& hqPendingTiles == other.hqPendingTiles
+		&& hqValid == other.hqValid;
+}
+
 void
 ImageViewBase::paintEvent(QPaintEvent* event)
 {
+	bool const hq_valid = validateHqPixmap();
+	if (!hq_valid) {
+		scheduleHqVersionRebuild();
+	}
+
+	// The image layers only change on transform, content or high
+	// quality rebuild progress, while interaction overlays redraw
+	// on every mouse move.  The layers are therefore composed into
+	// a retained buffer, re-rendered only when one of its inputs
+	// changed, and overlay-only repaints just blit it.
+	BackdropState state;
+	state.virtualToWidget = m_virtualToWidget;
+	state.virtualImageCropArea = m_virtualImageCropArea;
+	state.pixmapCacheKey = m_pixmap.cacheKey();
+	state.hqPixmapCacheKey = hq_valid ? m_hqPixmap.cacheKey() : 0;
+	state.hqPixmapPos = m_hqPixmapPos;
+	state.viewportSize = viewport()->size();
+	state.hqPendingTiles = m_hqPendingTiles;
+	state.hqValid = hq_valid;
+
+	if (m_backdrop.isNull() || !state.matches(m_backdropState)) {
+		renderBackdrop(state);
+		m_backdropState = state;
+	}
+
 	QPainter painter(viewport());
+	painter.drawPixmap(0, 0, m_backdrop);
+
+	painter.setRenderHints(QPainter::Antialiasing, true);
+	painter.setWorldTransform(m_virtualToWidget);
+
+	m_interactionState.resetProximity();
+	if (!m_interactionState.captured()) {
+		m_rootInteractionHandler.proximityUpdate(
+			QPointF(0.5, 0.5) + mapFromGlobal(QCursor::pos()), m_interactionState
+		);
+		updateStatusTipAndCursor();
+	}
+
+	m_rootInteractionHandler.paint(painter, m_interactionState);
+	maybeQueueRedraw();
+}
+
+void
+ImageViewBase::renderBackdrop(BackdropState const& state)
+{
+	if (m_backdrop.size() != state.viewportSize) {
+		m_backdrop = QPixmap(state.viewportSize);
+	}
+
+	QPainter painter(&m_backdrop);
 	painter.save();
 
 	// On X11 (except with OpenGL), SmoothPixmapTransform is too slow, so don't enable it.
@@ -463,25 +541,29 @@ ImageViewBase::paintEvent(QPaintEvent* event)
 		painter.setRenderHint(QPainter::SmoothPixmapTransform, pixel_width < 0.5);
 	}
 
-	if (validateHqPixmap()) {
-		// HQ pixmap maps one to one to screen pixels, so antialiasing is not necessary.
-		painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
-		painter.drawPixmap(m_hqPixmapPos, m_hqPixmap);
-	} else {
-		scheduleHqVersionRebuild();
-
+	if (!state.hqValid || m_hqPendingTiles > 0) {
+		// The high quality version is either stale or still being
+		// assembled tile by tile, so the downscaled version goes
+		// underneath.
 		painter.setWorldTransform(
 			m_pixmapToImage * m_imageToVirtual * m_virtualToWidget
 		);
 		PixmapRenderer::drawPixmap(painter, m_pixmap);
 	}
 
+	if (state.hqValid) {
+		// HQ pixmap maps one to one to screen pixels, so antialiasing is not necessary.
+		painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+		painter.setWorldTransform(QTransform());
+		painter.drawPixmap(m_hqPixmapPos, m_hqPixmap);
+	}
+
 	painter.setRenderHints(QPainter::Antialiasing, true);
 	painter.setWorldMatrixEnabled(false);
 
 	// Cover parts of the image that should not be visible with background.
 	// Note that because of Qt::WA_OpaquePaintEvent attribute, we need
-	// to paint the whole widget, which we do here.
+	// to paint the whole widget, which the backdrop blit does.
 
 	QPolygonF const image_area(
 		PolygonUtils::round(
@@ -502,7 +584,7 @@ ImageViewBase::paintEvent(QPaintEvent* event)
 	intersected_path.addPolygon(intersected_area);
 
 	QPainterPath containing_path;
-	containing_path.addRect(viewport()->rect());
+	containing_path.addRect(m_backdrop.rect());
 
 	QBrush const brush(palette().color(QPalette::Window));
 	QPen pen(brush, 1.0);
@@ -517,19 +599,6 @@ ImageViewBase::paintEvent(QPaintEvent* event)
 	painter.drawPath(containing_path.subtracted(intersected_path));
 
 	painter.restore();
-
-	painter.setWorldTransform(m_virtualToWidget);
-
-	m_interactionState.resetProximity();
-	if (!m_interactionState.captured()) {
-		m_rootInteractionHandler.proximityUpdate(
-			QPointF(0.5, 0.5) + mapFromGlobal(QCursor::pos()), m_interactionState
-		);
-		updateStatusTipAndCursor();
-	}
-
-	m_rootInteractionHandler.paint(painter, m_interactionState);
-	maybeQueueRedraw();
 }
 
 void
@@ -1025,10 +1094,7 @@ ImageViewBase::scheduleHqVersionRebuild()
 	QTransform const xform(m_imageToVirtual * m_virtualToWidget);
 
 	if (!m_timer.isActive() || m_potentialHqXform != xform) {
-		if (m_ptrHqTransformTask.get()) {
-			m_ptrHqTransformTask->cancel();
-			m_ptrHqTransformTask.reset();
-		}
+		cancelHqTransformTasks();
 		m_potentialHqXform = xform;
 	}
 	m_timer.start();
@@ -1042,38 +1108,76 @@ ImageViewBase::initiateBuildingHqVersion()
 	}
 
 	m_hqPixmap = QPixmap();
-
-	if (m_ptrHqTransformTask.get()) {
-		m_ptrHqTransformTask->cancel();
-		m_ptrHqTransformTask.reset();
-	}
+	cancelHqTransformTasks();
 
 	QTransform const xform(m_imageToVirtual * m_virtualToWidget);
-	IntrusivePtr<HqTransformTask> const task(
-		new HqTransformTask(this, m_image, xform, viewport()->size())
+	QRect const target_rect(
+		xform.map(
+			QRectF(m_image.rect())
+		).boundingRect().toRect().intersected(
+			QRect(QPoint(0, 0), viewport()->size())
+		)
 	);
-	
-	backgroundExecutor().enqueueTask(task);
-	
-	m_ptrHqTransformTask = task;
+
+	if (!target_rect.isEmpty()) {
+		m_hqPixmap = QPixmap(target_rect.size());
+		m_hqPixmap.fill(Qt::transparent);
+	}
+	m_hqPixmapPos = target_rect.topLeft();
+
+	// The visible area is rendered in independent tiles, each
+	// transformed by its own background task.  The tasks are spread
+	// across the worker pool, and every finished tile goes on
+	// screen without waiting for the rest.  This also makes
+	// cancellation on pan / zoom effective at tile granularity.
+	int const tile_size = 512;
+	for (int ty = target_rect.top(); ty <= target_rect.bottom(); ty += tile_size) {
+		for (int tx = target_rect.left(); tx <= target_rect.right(); tx += tile_size) {
+			QRect const tile_rect(
+				QRect(tx, ty, tile_size, tile_size).intersected(target_rect)
+			);
+			IntrusivePtr<HqTransformTask> const task(
+				new HqTransformTask(this, m_image, xform, tile_rect)
+			);
+			backgroundExecutor().enqueueTask(task);
+			m_hqTransformTasks.push_back(task);
+		}
+	}
+	m_hqPendingTiles = static_cast<int>(m_hqTransformTasks.size());
+
 	m_hqXform = xform;
 	m_hqSourceId = m_image.cacheKey();
 }
 
+void
+ImageViewBase::cancelHqTransformTasks()
+{
+	for (unsigned i = 0; i < m_hqTransformTasks.size(); ++i) {
+		m_hqTransformTasks[i]->cancel();
+	}
+	m_hqTransformTasks.clear();
+	m_hqPendingTiles = 0;
+}
+
 /**
  * Gets called from HqTransformationTask::Result.
  */
 void
-ImageViewBase::hqVersionBuilt(
-	QPoint const& origin, QImage const& image)
+ImageViewBase::hqTileBuilt(
+	QPoint const& origin, QImage const& tile)
 {
-	if (!m_hqTransformEnabled) {
+	if (!m_hqTransformEnabled || m_hqPixmap.isNull()) {
 		return;
 	}
-	
-	m_hqPixmap = QPixmap::fromImage(image);
-	m_hqPixmapPos = origin;
-	m_ptrHqTransformTask.reset();
+
+	{
+		QPainter painter(&m_hqPixmap);
+		painter.drawImage(origin - m_hqPixmapPos, tile);
+	}
+
+	if (m_hqPendingTiles > 0 && --m_hqPendingTiles == 0) {
+		m_hqTransformTasks.clear();
+	}
 	update();
 }
 
@@ -1118,11 +1222,11 @@ ImageViewBase::backgroundExecutor()
 ImageViewBase::HqTransformTask::HqTransformTask(
 	ImageViewBase* image_view,
 	QImage const& image, QTransform const& xform,
-	QSize const& target_size)
+	QRect const& tile_rect)
 :	m_ptrResult(new Result(image_view)),
 	m_image(image),
 	m_xform(xform),
-	m_targetSize(target_size)
+	m_tileRect(tile_rect)
 {
 }
 
@@ -1133,25 +1237,17 @@ ImageViewBase::HqTransformTask::operator()()
 		return IntrusivePtr<AbstractCommand0<void> >();
 	}
 	
-	QRect const target_rect(
-		m_xform.map(
-			QRectF(m_image.rect())
-		).boundingRect().toRect().intersected(
-			QRect(QPoint(0, 0), m_targetSize)
-		)
-	);
-	
-	QImage hq_image(
+	QImage hq_tile(
 		transform(
-			m_image, m_xform, target_rect,
+			m_image, m_xform, m_tileRect,
 			OutsidePixels::assumeWeakColor(Qt::white), QSizeF(0.0, 0.0)
 		)
 	);
 #if defined(Q_WS_X11)
 	// ARGB32_Premultiplied is an optimal format for X11 + XRender.
-	hq_image = hq_image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+	hq_tile = hq_tile.convertToFormat(QImage::Format_ARGB32_Premultiplied);
 #endif
-	m_ptrResult->setData(target_rect.topLeft(), hq_image);
+	m_ptrResult->setData(m_tileRect.topLeft(), hq_tile);
 	
 	return m_ptrResult;
 }
@@ -1177,7 +1273,7 @@ void
 ImageViewBase::HqTransformTask::Result::operator()()
 {
 	if (m_ptrImageView && !isCancelled()) {
-		m_ptrImageView->hqVersionBuilt(m_origin, m_hqImage);
+		m_ptrImageView->hqTileBuilt(m_origin, m_hqImage);
 	}
 }
 
@@ -36,6 +36,7 @@
 #include <QSizeF>
 #include <QRectF>
 #include <Qt>
+#include <vector>
 
 class QPainter;
 class BackgroundExecutor;
@@ -267,6 +268,32 @@ private:
 	class TempFocalPointAdjuster;
 	class TransformChangeWatcher;
 
+	/**
+	 * \brief Identifies the inputs the retained backdrop was rendered from.
+	 *
+	 * Rather than tracking every mutation that could affect the image
+	 * layers, the backdrop is validated against such a snapshot on
+	 * each paint.
+	 */
+	struct BackdropState
+	{
+		// Member-wise copying is OK.
+
+		QTransform virtualToWidget;
+		QPolygonF virtualImageCropArea;
+		qint64 pixmapCacheKey;
+		qint64 hqPixmapCacheKey;
+		QPoint hqPixmapPos;
+		QSize viewportSize;
+		int hqPendingTiles;
+		bool hqValid;
+
+		BackdropState() : pixmapCacheKey(0), hqPixmapCacheKey(0),
+			hqPendingTiles(0), hqValid(false) {}
+
+		bool matches(BackdropState const& other) const;
+	};
+
 	QRectF dynamicViewportRect() const;
 
 	void transformChanged();
@@ -287,7 +314,11 @@ private:
 
 	void scheduleHqVersionRebuild();
 
-	void hqVersionBuilt(QPoint const& origin, QImage const& image);
+	void cancelHqTransformTasks();
+
+	void hqTileBuilt(QPoint const& origin, QImage const& tile);
+
+	void renderBackdrop(BackdropState const& state);
 
 	void updateStatusTipAndCursor();
 
@@ -321,6 +352,8 @@ private:
 	
 	/**
 	 * The high quality, pre-transformed version of m_pixmap.
+	 * It's assembled tile by tile, with tiles not yet rendered
+	 * being transparent.
 	 */
 	QPixmap m_hqPixmap;
 	
@@ -348,9 +381,27 @@ private:
 	qint64 m_hqSourceId;
 	
 	/**
-	 * The pending (if any) high quality transformation task.
+	 * The pending (if any) high quality transformation tasks,
+	 * one per tile of the visible area.
+	 */
+	std::vector<IntrusivePtr<HqTransformTask> > m_hqTransformTasks;
+
+	/**
+	 * The number of tiles of m_hqPixmap that are still being rendered.
 	 */
-	IntrusivePtr<HqTransformTask> m_ptrHqTransformTask;
+	int m_hqPendingTiles;
+
+	/**
+	 * The composed image layers - the downscaled and/or high quality
+	 * pixmap plus the background fill - retained at viewport size.
+	 * Interaction overlays paint on top of it, so overlay-only
+	 * repaints (zone outlines, drag handles) don't re-transform
+	 * the image.
+	 */
+	QPixmap m_backdrop;
+
+	/** What m_backdrop was rendered from. */
+	BackdropState m_backdropState;
 
 	/**
 	 * Transformation from m_pixmap coordinates to m_image coordinates.
@@ -0,0 +1,347 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "JpegReader.h"
+#include "NonCopyable.h"
+#include "Dpi.h"
+#include "Dpm.h"
+#include <QIODevice>
+#include <QImage>
+#include <QSize>
+#include <QVector>
+#include <vector>
+#include <algorithm>
+#include <setjmp.h>
+#include <string.h>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+namespace
+{
+
+/*======================== JpegDecompressionHandle =======================*/
+
+class JpegDecompressHandle
+{
+	DECLARE_NON_COPYABLE(JpegDecompressHandle)
+public:
+	JpegDecompressHandle(jpeg_error_mgr* err_mgr, jpeg_source_mgr* src_mgr);
+
+	~JpegDecompressHandle();
+
+	jpeg_decompress_struct* ptr() { return &m_info; }
+
+	jpeg_decompress_struct* operator->() { return &m_info; }
+private:
+	jpeg_decompress_struct m_info;
+};
+
+JpegDecompressHandle::JpegDecompressHandle(
+	jpeg_error_mgr* err_mgr, jpeg_source_mgr* src_mgr)
+{
+	m_info.err = err_mgr;
+	jpeg_create_decompress(&m_info);
+	m_info.src = src_mgr;
+}
+
+JpegDecompressHandle::~JpegDecompressHandle()
+{
+	jpeg_destroy_decompress(&m_info);
+}
+
+
+/*============================ JpegSourceManager =========================*/
+
+class JpegSourceManager : public jpeg_source_mgr
+{
+	DECLARE_NON_COPYABLE(JpegSourceManager)
+public:
+	JpegSourceManager(QIODevice& io_device);
+private:
+	static void initSource(j_decompress_ptr cinfo);
+
+	static boolean fillInputBuffer(j_decompress_ptr cinfo);
+
+	boolean fillInputBufferImpl();
+
+	static void skipInputData(j_decompress_ptr cinfo, long num_bytes);
+
+	void skipInputDataImpl(long num_bytes);
+
+	static void termSource(j_decompress_ptr cinfo);
+
+	static JpegSourceManager* object(j_decompress_ptr cinfo);
+
+	QIODevice& m_rDevice;
+	JOCTET m_buf[4096];
+};
+
+JpegSourceManager::JpegSourceManager(QIODevice& io_device)
+:	m_rDevice(io_device)
+{
+	init_source = &JpegSourceManager::initSource;
+	fill_input_buffer = &JpegSourceManager::fillInputBuffer;
+	skip_input_data = &JpegSourceManager::skipInputData;
+	resync_to_restart = &jpeg_resync_to_restart;
+	term_source = &JpegSourceManager::termSource;
+	bytes_in_buffer = 0;
+	next_input_byte = m_buf;
+}
+
+void
+JpegSourceManager::initSource(j_decompress_ptr cinfo)
+{
+	// No-op.
+}
+
+boolean
+JpegSourceManager::fillInputBuffer(j_decompress_ptr cinfo)
+{
+	return object(cinfo)->fillInputBufferImpl();
+}
+
+boolean
+JpegSourceManager::fillInputBufferImpl()
+{
+	qint64 const bytes_read = m_rDevice.read((char*)m_buf, sizeof(m_buf));
+	if (bytes_read > 0) {
+		bytes_in_buffer = bytes_read;
+	} else {
+		// Insert a fake EOI marker.
+		m_buf[0] = 0xFF;
+		m_buf[1] = JPEG_EOI;
+		bytes_in_buffer = 2;
+	}
+	next_input_byte = m_buf;
+	return 1;
+}
+
+void
+JpegSourceManager::skipInputData(j_decompress_ptr cinfo, long num_bytes)
+{
+	object(cinfo)->skipInputDataImpl(num_bytes);
+}
+
+void
+JpegSourceManager::skipInputDataImpl(long num_bytes)
+{
+	if (num_bytes <= 0) {
+		return;
+	}
+
+	while (num_bytes > (long)bytes_in_buffer) {
+		num_bytes -= (long)bytes_in_buffer;
+		fillInputBufferImpl();
+	}
+	next_input_byte += num_bytes;
+	bytes_in_buffer -= num_bytes;
+}
+
+void
+JpegSourceManager::termSource(j_decompress_ptr cinfo)
+{
+	// No-op.
+}
+
+JpegSourceManager*
+JpegSourceManager::object(j_decompress_ptr cinfo)
+{
+	return static_cast<JpegSourceManager*>(cinfo->src);
+}
+
+
+/*============================= JpegErrorManager ===========================*/
+
+class JpegErrorManager : public jpeg_error_mgr
+{
+	DECLARE_NON_COPYABLE(JpegErrorManager)
+public:
+	JpegErrorManager();
+
+	jmp_buf& jmpBuf() { return m_jmpBuf; }
+private:
+	static void errorExit(j_common_ptr cinfo);
+
+	static JpegErrorManager* object(j_common_ptr cinfo);
+
+	jmp_buf m_jmpBuf;
+};
+
+JpegErrorManager::JpegErrorManager()
+{
+	jpeg_std_error(this);
+	error_exit = &JpegErrorManager::errorExit;
+}
+
+void
+JpegErrorManager::errorExit(j_common_ptr cinfo)
+{
+	longjmp(object(cinfo)->jmpBuf(), 1);
+}
+
+JpegErrorManager*
+JpegErrorManager::object(j_common_ptr cinfo)
+{
+	return static_cast<JpegErrorManager*>(cinfo->err);
+}
+
+/**
+ * The largest scale denominator from {1, 2, 4, 8} such that the image
+ * scaled down by it still covers \p bounding_size.  Every libjpeg
+ * supports these denominators, with downscaling done cheaply as part
+ * of the inverse DCT.
+ */
+unsigned
+scaleDenominatorFor(QSize const& full_size, QSize const& bounding_size)
+{
+	double const max_reduction = std::max(
+		double(full_size.width()) / bounding_size.width(),
+		double(full_size.height()) / bounding_size.height()
+	);
+
+	unsigned denom = 1;
+	while (denom * 2 <= 8 && denom * 2 <= max_reduction) {
+		denom *= 2;
+	}
+	return denom;
+}
+
+} // anonymous namespace
+
+
+/*================================ JpegReader ==============================*/
+
+bool
+JpegReader::canRead(QIODevice& device)
+{
+	if (!device.isReadable()) {
+		return false;
+	}
+
+	static unsigned char const jpeg_signature[] = { 0xff, 0xd8, 0xff };
+	static int const sig_size = sizeof(jpeg_signature);
+
+	unsigned char signature[sig_size];
+	if (device.peek((char*)signature, sig_size) != sig_size) {
+		return false;
+	}
+	return memcmp(jpeg_signature, signature, sig_size) == 0;
+}
+
+QImage
+JpegReader::readImage(QIODevice& device, QSize const& bounding_size)
+{
+	if (!canRead(device)) {
+		return QImage();
+	}
+
+	// Declared before setjmp(), so that returning from longjmp()
+	// releases the pixel data and the row buffer.
+	QImage image;
+	std::vector<JSAMPLE> row_buf;
+
+	JpegErrorManager err_mgr;
+	if (setjmp(err_mgr.jmpBuf())) {
+		// Returning from longjmp().
+		return QImage();
+	}
+
+	JpegSourceManager src_mgr(device);
+	JpegDecompressHandle cinfo(&err_mgr, &src_mgr);
+
+	if (jpeg_read_header(cinfo.ptr(), 1) != JPEG_HEADER_OK) {
+		return QImage();
+	}
+
+	QSize const full_size(cinfo->image_width, cinfo->image_height);
+	if (bounding_size.isValid() && !bounding_size.isEmpty()) {
+		cinfo->scale_num = 1;
+		cinfo->scale_denom = scaleDenominatorFor(full_size, bounding_size);
+	}
+
+	if (!jpeg_start_decompress(cinfo.ptr())) {
+		// libjpeg doesn't support all compression types.
+		return QImage();
+	}
+
+	int const width = cinfo->output_width;
+	int const height = cinfo->output_height;
+
+	if (cinfo->out_color_space == JCS_GRAYSCALE && cinfo->output_components == 1) {
+		image = QImage(width, height, QImage::Format_Indexed8);
+		if (image.isNull()) {
+			return QImage();
+		}
+
+		QVector<QRgb> palette(256);
+		for (int i = 0; i < 256; ++i) {
+			palette[i] = qRgb(i, i, i);
+		}
+		image.setColorTable(palette);
+
+		for (int y = 0; y < height; ++y) {
+			JSAMPROW row = (JSAMPROW)image.scanLine(y);
+			jpeg_read_scanlines(cinfo.ptr(), &row, 1);
+		}
+	} else if (cinfo->out_color_space == JCS_RGB && cinfo->output_components == 3) {
+		image = QImage(width, height, QImage::Format_RGB32);
+		if (image.isNull()) {
+			return QImage();
+		}
+
+		row_buf.resize(width * 3);
+		for (int y = 0; y < height; ++y) {
+			JSAMPROW row = &row_buf[0];
+			jpeg_read_scanlines(cinfo.ptr(), &row, 1);
+
+			JSAMPLE const* src = &row_buf[0];
+			uint32_t* dst = (uint32_t*)image.scanLine(y);
+			for (int x = 0; x < width; ++x, src += 3) {
+				dst[x] = qRgb(src[0], src[1], src[2]);
+			}
+		}
+	} else {
+		// An exotic color space, such as CMYK.  Let the caller
+		// fall back to another decoding path.
+		return QImage();
+	}
+
+	jpeg_finish_decompress(cinfo.ptr());
+
+	Dpm dpm;
+	if (cinfo->density_unit == 1) {
+		// Dots per inch.
+		dpm = Dpm(Dpi(cinfo->X_density, cinfo->Y_density));
+	} else if (cinfo->density_unit == 2) {
+		// Dots per centimeter.
+		dpm = Dpm(cinfo->X_density * 100, cinfo->Y_density * 100);
+	}
+	if (!dpm.isNull()) {
+		// Scaled decoding reduces the resolution accordingly.
+		image.setDotsPerMeterX(qRound(
+			double(dpm.horizontal()) * width / full_size.width()
+		));
+		image.setDotsPerMeterY(qRound(
+			double(dpm.vertical()) * height / full_size.height()
+		));
+	}
+
+	return image;
+}
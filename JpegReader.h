@@ -0,0 +1,47 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JPEGREADER_H_
+#define JPEGREADER_H_
+
+class QIODevice;
+class QImage;
+class QSize;
+
+class JpegReader
+{
+public:
+	static bool canRead(QIODevice& device);
+
+	/**
+	 * \brief Reads a JPEG image, possibly downscaled already during decoding.
+	 *
+	 * \param device The device to read from.  This device must be
+	 *        opened for reading.
+	 * \param bounding_size If valid and non-empty, permits decoding
+	 *        the image at 1/2, 1/4 or 1/8 of its full size, as long
+	 *        as the result is still large enough to be scaled down
+	 *        to fit \p bounding_size.  Such DCT-scaled decoding is
+	 *        many times cheaper than decoding at full size.
+	 * \return The resulting image, or a null image in case of failure
+	 *         or an unsupported color space.
+	 */
+	static QImage readImage(QIODevice& device, QSize const& bounding_size);
+};
+
+#endif
@@ -31,6 +31,7 @@
 #include "Dpm.h"
 #include "FilterData.h"
 #include "ImageLoader.h"
+#include "Profiler.h"
 #include <QCoreApplication>
 #include <QFile>
 #include <QDir>
@@ -65,6 +66,7 @@ LoadFileTask::LoadFileTask(
 	IntrusivePtr<fix_orientation::Task> const& next_task)
 :	BackgroundTask(type),
 	m_ptrThumbnailCache(thumbnail_cache),
+	m_pageId(page.id()),
 	m_imageId(page.imageId()),
 	m_imageMetadata(page.metadata()),
 	m_ptrPages(pages),
@@ -80,8 +82,13 @@ LoadFileTask::~LoadFileTask()
 FilterResultPtr
 LoadFileTask::operator()()
 {
-	QImage image(ImageLoader::load(m_imageId));
-	
+	QImage image(m_preloadedImage);
+	m_preloadedImage = QImage(); // Save memory.
+	if (image.isNull()) {
+		ProfileScope const profile_scope("io/load-image");
+		image = ImageLoader::load(m_imageId);
+	}
+
 	try {
 		throwIfCancelled();
 		
@@ -91,7 +98,7 @@ LoadFileTask::operator()()
 			updateImageSizeIfChanged(image);
 			overrideDpi(image);
 			m_ptrThumbnailCache->ensureThumbnailExists(m_imageId, image);
-			return m_ptrNextTask->process(*this, FilterData(image));
+			return m_ptrNextTask->process(*this, FilterData(m_imageId, image));
 		}
 	} catch (CancelledException const&) {
 		return FilterResultPtr();
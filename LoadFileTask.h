@@ -25,11 +25,12 @@
 #include "IntrusivePtr.h"
 #include "ImageId.h"
 #include "ImageMetadata.h"
+#include "PageId.h"
+#include <QImage>
 
 class ThumbnailPixmapCache;
 class PageInfo;
 class ProjectPages;
-class QImage;
 
 namespace fix_orientation
 {
@@ -46,8 +47,23 @@ public:
 		IntrusivePtr<fix_orientation::Task> const& next_task);
 	
 	virtual ~LoadFileTask();
-	
+
 	virtual FilterResultPtr operator()();
+
+	ImageId const& imageId() const { return m_imageId; }
+
+	PageId const& pageId() const { return m_pageId; }
+
+	ImageMetadata const& imageMetadata() const { return m_imageMetadata; }
+
+	/**
+	 * \brief Provide an already decoded image, skipping the load step.
+	 *
+	 * Used to pipeline batch processing: the image for the next page
+	 * may be decoded on another thread while the current page is being
+	 * processed.  Must be called before operator()().
+	 */
+	void setPreloadedImage(QImage const& image) { m_preloadedImage = image; }
 private:
 	class ErrorResult;
 	
@@ -56,6 +72,8 @@ private:
 	void overrideDpi(QImage& image) const;
 	
 	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
+	QImage m_preloadedImage;
+	PageId m_pageId;
 	ImageId m_imageId;
 	ImageMetadata m_imageMetadata;
 	IntrusivePtr<ProjectPages> const m_ptrPages;
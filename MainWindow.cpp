@@ -20,6 +20,7 @@
 #include "MainWindow.h.moc"
 #include "NewOpenProjectPanel.h"
 #include "RecentProjects.h"
+#include "ProjectSessions.h"
 #include "WorkerThread.h"
 #include "ProjectPages.h"
 #include "PageSequence.h"
@@ -27,15 +28,22 @@
 #include "PageSelectionProvider.h"
 #include "StageSequence.h"
 #include "ThumbnailSequence.h"
+#include "NearDuplicateDetector.h"
+#include "CommandLine.h"
 #include "PageOrderOption.h"
 #include "PageOrderProvider.h"
 #include "ProcessingTaskQueue.h"
+#include "BatchPrefetcher.h"
+#include "ForegroundExecutor.h"
 #include "FileNameDisambiguator.h"
 #include "OutputFileNameGenerator.h"
 #include "ImageInfo.h"
 #include "PageInfo.h"
 #include "ImageId.h"
 #include "Utils.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ProcessingTimes.h"
 #include "FilterOptionsWidget.h"
 #include "ErrorWidget.h"
 #include "AutoRemovingFile.h"
@@ -51,6 +59,9 @@
 #include "PageOrientationPropagator.h"
 #include "ProjectCreationContext.h"
 #include "ProjectOpeningContext.h"
+#include "ProjectAutosaver.h"
+#include "AutosaveJournal.h"
+#include "zones/ZoneGeometrySidecar.h"
 #include "SkinnedButton.h"
 #include "SystemLoadWidget.h"
 #include "ProcessingIndicationWidget.h"
@@ -109,6 +120,7 @@
 #include <QScrollBar>
 #include <QPushButton>
 #include <QCheckBox>
+#include <QLabel>
 #include <QFileInfo>
 #include <QFile>
 #include <QDir>
@@ -125,6 +137,8 @@
 #include <QSortFilterProxyModel>
 #include <QFileSystemModel>
 #include <QFileInfo>
+#include <QDateTime>
+#include <QTimer>
 #include <QResource>
 #include <Qt>
 #include <QDebug>
@@ -160,6 +174,7 @@ MainWindow::MainWindow()
 	m_ptrStages(new StageSequence(m_ptrPages, newPageSelectionAccessor())),
 	m_ptrWorkerThread(new WorkerThread),
 	m_ptrInteractiveQueue(new ProcessingTaskQueue(ProcessingTaskQueue::RANDOM_ORDER)),
+	m_ptrSpeculativeQueue(new ProcessingTaskQueue(ProcessingTaskQueue::RANDOM_ORDER)),
 	m_ptrOutOfMemoryDialog(new OutOfMemoryDialog),
 	m_curFilter(0),
 	m_ignoreSelectionChanges(0),
@@ -181,7 +196,18 @@ MainWindow::MainWindow()
 
 	createBatchProcessingWidget();
 	m_ptrProcessingIndicationWidget.reset(new ProcessingIndicationWidget);
-	
+
+	m_ptrAutosaver.reset(new ProjectAutosaver);
+	QTimer* autosave_timer = new QTimer(this);
+	autosave_timer->setInterval(60 * 1000);
+	connect(autosave_timer, SIGNAL(timeout()), SLOT(autosaveProject()));
+	autosave_timer->start();
+
+	m_pBatchProgressTimer = new QTimer(this);
+	m_pBatchProgressTimer->setSingleShot(true);
+	m_pBatchProgressTimer->setInterval(33); // At most ~30 updates per second.
+	connect(m_pBatchProgressTimer, SIGNAL(timeout()), SLOT(batchProgressTimeout()));
+
 	filterList->setStages(m_ptrStages);
 	filterList->selectRow(0);
 	
@@ -316,6 +342,7 @@ MainWindow::MainWindow()
 
 MainWindow::~MainWindow()
 {
+	cancelSpeculation();
 	m_ptrInteractiveQueue->cancelAndClear();
 	if (m_ptrBatchQueue.get()) {
 		m_ptrBatchQueue->cancelAndClear();
@@ -352,15 +379,34 @@ MainWindow::switchToNewProject(
 	ProjectReader const* project_reader)
 {
 	stopBatchProcessing(CLEAR_MAIN_AREA);
+	cancelSpeculation();
 	m_ptrInteractiveQueue->cancelAndClear();
 
+	// Remember where we were in the project being left, so that
+	// reopening it later restores the same working position.
+	if (isProjectLoaded() && !m_projectFile.isEmpty()) {
+		ProjectSessions sessions;
+		sessions.read();
+		ProjectSessions::Session session;
+		session.path = m_projectFile;
+		session.filterIdx = m_curFilter;
+		session.thumbScrollPos = thumbView->verticalScrollBar()->value();
+		sessions.update(session);
+		sessions.write();
+	}
+
 	Utils::maybeCreateCacheDir(out_dir);
-	
+
 	m_ptrPages = pages;
 	m_projectFile = project_file_path;
 
 	if (project_reader) {
 		m_selectedPage = project_reader->selectedPage();
+	} else {
+		// A fresh project has no processing history; drop whatever
+		// the previously open project may have left behind.  When a
+		// project is loaded, the reader replaces the history itself.
+		ProcessingTimes::instance().clear();
 	}
 
 	IntrusivePtr<FileNameDisambiguator> disambiguator;
@@ -378,17 +424,55 @@ MainWindow::switchToNewProject(
 
 	// Recreate the stages and load their state.
 	m_ptrStages.reset(new StageSequence(pages, newPageSelectionAccessor()));
+	AutosaveJournal::close();
 	if (project_reader) {
 		project_reader->readFilterSettings(m_ptrStages->filters());
+
+		// Zone edits journalled after the loaded file was written
+		// represent work no save has captured yet.  Replay them on
+		// top of the loaded settings, then keep extending the same
+		// journal - its records stay relevant until the next save.
+		{
+			AutosaveJournalReader journal(
+				m_projectFile, m_loadedProjectBase
+			);
+			AutosaveJournalReader::Record record;
+			while (journal.next(record)) {
+				QDomDocument doc;
+				if (doc.setContent(record.zonesXml)) {
+					m_ptrStages->outputFilter()->loadJournalledZones(
+						record.pageId, record.zoneKind,
+						doc.documentElement()
+					);
+				}
+			}
+		}
+		AutosaveJournal::open(m_projectFile, m_loadedProjectBase, true);
 	}
-	
+
+	// If we've worked on this project before, drop the user back
+	// at the filter tab and thumbnail position they left.
+	ProjectSessions::Session session;
+	bool session_found = false;
+	if (project_reader && !project_file_path.isEmpty()) {
+		ProjectSessions sessions;
+		sessions.read();
+		session_found = sessions.find(project_file_path, session);
+	}
+
 	// Connect the filter list model to the view and select
 	// the first item.
 	{
 		ScopedIncDec<int> guard(m_ignoreSelectionChanges);
 		filterList->setStages(m_ptrStages);
-		filterList->selectRow(0);
-		m_curFilter = 0;
+
+		int filter_idx = 0;
+		if (session_found && session.filterIdx > 0
+				&& session.filterIdx < m_ptrStages->count()) {
+			filter_idx = session.filterIdx;
+		}
+		filterList->selectRow(filter_idx);
+		m_curFilter = filter_idx;
 		
 		// Setting a data model also implicitly sets a new
 		// selection model, so we have to reconnect to it.
@@ -428,11 +512,48 @@ MainWindow::switchToNewProject(
 	}
 	resetThumbSequence(currentPageOrderProvider());
 
+	if (session_found) {
+		// Overrides the scrolling done by resetThumbSequence() when
+		// it selected the page loaded from the project file.  Both
+		// usually agree, but this one is pixel-exact.
+		thumbView->verticalScrollBar()->setValue(session.thumbScrollPos);
+	}
+
+	if (CommandLine::get().hasDetectDuplicates()) {
+		// Opt-in double-feed detection: scan the project for
+		// consecutive near-duplicate images and flag them in the
+		// thumbnail list.  The scan runs in GUI-thread slices,
+		// one image at a time.
+		if (m_ptrDuplicateDetector.get()) {
+			// Still scanning the previous project.
+			m_ptrDuplicateDetector->cancel();
+			m_ptrDuplicateDetector.reset(0);
+		}
+		m_ptrThumbSequence->setDuplicateSuspects(std::set<PageId>());
+		if (m_ptrThumbnailCache.get()) {
+			m_ptrDuplicateDetector.reset(
+				new NearDuplicateDetector(
+					m_ptrThumbnailCache,
+					pages->toPageSequence(IMAGE_VIEW),
+					m_ptrThumbSequence.get(),
+					CommandLine::get().getDuplicateMaxDistance()
+				)
+			);
+			ForegroundExecutor::instance().enqueue(
+				ForegroundExecutor::JobPtr(m_ptrDuplicateDetector)
+			);
+		}
+	}
+
 	removeFilterOptionsWidget();
 	updateProjectActions();
 	updateWindowTitle();
 	updateMainArea();
 
+	// Loading filter settings bumps the dirty generation, but
+	// the project we've just switched to isn't really dirty.
+	m_ptrAutosaver->markClean();
+
 	if (!QDir(out_dir).exists()) {
 		showRelinkingDialog();
 	}
@@ -503,8 +624,12 @@ MainWindow::createBatchProcessingWidget()
 	LowerPanel* lower_panel = new LowerPanel(m_ptrBatchProcessingWidget.get());
 	m_checkBeepWhenFinished = bind(&QCheckBox::isChecked, lower_panel->ui.beepWhenFinished);
 
+	m_pBatchEstimateLabel = new QLabel(m_ptrBatchProcessingWidget.get());
+	m_pBatchEstimateLabel->setAlignment(Qt::AlignHCenter);
+
 	int row = 0; // Row 0 is reserved.
 	layout->addWidget(stop_btn, ++row, 1, Qt::AlignCenter);
+	layout->addWidget(m_pBatchEstimateLabel, ++row, 0, 1, 3, Qt::AlignHCenter);
 	layout->addWidget(lower_panel, ++row, 0, 1, 3, Qt::AlignHCenter|Qt::AlignTop);
 	layout->setColumnStretch(0, 1);
 	layout->setColumnStretch(2, 1);
@@ -730,6 +855,10 @@ MainWindow::setOptionsWidget(FilterOptionsWidget* widget, Ownership const owners
 			m_ptrOptionsWidget, SIGNAL(invalidateAllThumbnails()),
 			this, SLOT(invalidateAllThumbnails())
 		);
+		disconnect(
+			m_ptrOptionsWidget, SIGNAL(invalidateThumbnails(std::set<PageId> const&)),
+			this, SLOT(invalidateThumbnails(std::set<PageId> const&))
+		);
 		disconnect(
 			m_ptrOptionsWidget, SIGNAL(goToPage(PageId const&)),
 			this, SLOT(goToPage(PageId const&))
@@ -759,6 +888,10 @@ MainWindow::setOptionsWidget(FilterOptionsWidget* widget, Ownership const owners
 		widget, SIGNAL(invalidateAllThumbnails()),
 		this, SLOT(invalidateAllThumbnails())
 	);
+	connect(
+		widget, SIGNAL(invalidateThumbnails(std::set<PageId> const&)),
+		this, SLOT(invalidateThumbnails(std::set<PageId> const&))
+	);
 	connect(
 		widget, SIGNAL(goToPage(PageId const&)),
 		this, SLOT(goToPage(PageId const&))
@@ -827,6 +960,12 @@ MainWindow::invalidateAllThumbnails()
 	m_ptrThumbSequence->invalidateAllThumbnails();
 }
 
+void
+MainWindow::invalidateThumbnails(std::set<PageId> const& pages)
+{
+	m_ptrThumbSequence->invalidateThumbnails(pages);
+}
+
 IntrusivePtr<AbstractCommand0<void> >
 MainWindow::relinkingDialogRequester()
 {
@@ -1090,6 +1229,7 @@ MainWindow::filterSelectionChanged(QItemSelection const& selected)
 		return;
 	}
 	
+	cancelSpeculation();
 	m_ptrInteractiveQueue->cancelAndClear();
 	if (m_ptrBatchQueue.get()) {
 		// Should not happen, but just in case.
@@ -1162,6 +1302,7 @@ MainWindow::startBatchProcessing()
 		return;
 	}
 
+	cancelSpeculation();
 	m_ptrInteractiveQueue->cancelAndClear();
 	
 	m_ptrBatchQueue.reset(
@@ -1178,15 +1319,29 @@ MainWindow::startBatchProcessing()
 		);
 	}
 
+	m_ptrBatchPrefetcher.reset(new BatchPrefetcher);
+
+	// Page times are recorded and predicted under the name of the
+	// filter this batch run targets.  The task chain also covers the
+	// preceding stages, but their results are usually up to date, so
+	// the target stage dominates.
+	m_batchStageName = m_ptrStages->filterAt(m_curFilter)->getName();
+	m_pBatchEstimateLabel->setText(batchEstimateText());
+
+	// Make the profile and memory watermarks dumped when this
+	// batch finishes cover just this batch.
+	Profiler::instance().reset();
+	MemoryTracker::instance().reset();
+
 	focusButton->setChecked(true);
-	
+
 	removeFilterOptionsWidget();
 	filterList->setBatchProcessingInProgress(true);
 	filterList->setEnabled(false);
 
 	BackgroundTaskPtr const task(m_ptrBatchQueue->takeForProcessing());
 	if (task) {
-		m_ptrWorkerThread->performTask(task);
+		performBatchTask(task);
 	} else {
 		stopBatchProcessing();
 	}
@@ -1200,6 +1355,29 @@ MainWindow::startBatchProcessing()
 	updateMainArea();
 }
 
+void
+MainWindow::performBatchTask(BackgroundTaskPtr const& task)
+{
+	if (m_ptrBatchPrefetcher.get()) {
+		if (LoadFileTask* load_task = dynamic_cast<LoadFileTask*>(task.get())) {
+			QImage const image(m_ptrBatchPrefetcher->retrieve(load_task->imageId()));
+			if (!image.isNull()) {
+				load_task->setPreloadedImage(image);
+			}
+		}
+
+		// Start decoding the image of the page that will be
+		// taken for processing next.
+		PageInfo const next_page(m_ptrBatchQueue->nextReadyPage());
+		if (!next_page.isNull()) {
+			m_ptrBatchPrefetcher->prefetch(next_page.imageId());
+		}
+	}
+
+	m_batchTaskTimer.start();
+	m_ptrWorkerThread->performTask(task);
+}
+
 void
 MainWindow::stopBatchProcessing(MainAreaAction main_area)
 {
@@ -1207,6 +1385,8 @@ MainWindow::stopBatchProcessing(MainAreaAction main_area)
 		return;
 	}
 	
+	m_pBatchProgressTimer->stop();
+
 	PageInfo const page(m_ptrBatchQueue->selectedPage());
 	if (!page.isNull()) {
 		m_ptrThumbSequence->setSelection(page.id());
@@ -1214,7 +1394,22 @@ MainWindow::stopBatchProcessing(MainAreaAction main_area)
 
 	m_ptrBatchQueue->cancelAndClear();
 	m_ptrBatchQueue.reset();
-	
+	m_ptrBatchPrefetcher.reset();
+
+	QString const profile(Profiler::instance().report());
+	if (!profile.isEmpty()) {
+		// Answers "why was this book slow" without attaching
+		// an external profiler.
+		qDebug().nospace() << "Batch processing profile:\n"
+			<< qPrintable(profile);
+	}
+
+	QString const memory(MemoryTracker::instance().report());
+	if (!memory.isEmpty()) {
+		qDebug().nospace() << "Batch processing memory watermarks:\n"
+			<< qPrintable(memory);
+	}
+
 	filterList->setBatchProcessingInProgress(false);
 	filterList->setEnabled(true);
 
@@ -1231,10 +1426,49 @@ MainWindow::stopBatchProcessing(MainAreaAction main_area)
 void
 MainWindow::filterResult(BackgroundTaskPtr const& task, FilterResultPtr const& result)
 {
+	std::set<BackgroundTask*>::iterator const spec_it(
+		m_speculativeTasks.find(task.get())
+	);
+	if (spec_it != m_speculativeTasks.end()) {
+		// A speculative page finished.  Its value is in the side
+		// effects - warmed caches and checkpoint files - so the
+		// result itself is discarded rather than shown.  Only the
+		// thumbnail is refreshed, as the page may well have been
+		// processed for the first time.
+		m_speculativeTasks.erase(spec_it);
+		m_ptrSpeculativeQueue->processingFinished(task);
+
+		if (!task->isCancelled()) {
+			if (LoadFileTask const* load_task =
+					dynamic_cast<LoadFileTask const*>(task.get())) {
+				m_ptrThumbSequence->invalidateThumbnail(load_task->pageId());
+			}
+			if (!isBatchProcessingInProgress()) {
+				BackgroundTaskPtr const next(
+					m_ptrSpeculativeQueue->takeForProcessing()
+				);
+				if (next) {
+					m_ptrWorkerThread->performTask(next);
+				}
+			}
+		}
+		return;
+	}
+
 	// Cancelled or not, we must mark it as finished.
 	m_ptrInteractiveQueue->processingFinished(task);
 	if (m_ptrBatchQueue.get()) {
 		m_ptrBatchQueue->processingFinished(task);
+
+		if (!task->isCancelled()) {
+			if (LoadFileTask const* load_task =
+					dynamic_cast<LoadFileTask const*>(task.get())) {
+				ProcessingTimes::instance().setTime(
+					load_task->pageId(), m_batchStageName,
+					m_batchTaskTimer.elapsed() / 1000.0
+				);
+			}
+		}
 	}
 
 	if (task->isCancelled()) {
@@ -1278,14 +1512,83 @@ MainWindow::filterResult(BackgroundTaskPtr const& task, FilterResultPtr const& r
 
 		BackgroundTaskPtr const task(m_ptrBatchQueue->takeForProcessing());
 		if (task) {
-			m_ptrWorkerThread->performTask(task);
+			performBatchTask(task);
 		}
 
-		PageInfo const page(m_ptrBatchQueue->selectedPage());
-		if (!page.isNull()) {
-			m_ptrThumbSequence->setSelection(page.id());
+		// Following the page being processed with the selection involves
+		// scrolling the thumbnail view.  Fast pages complete much faster
+		// than that's worth doing, so the results are coalesced and the
+		// selection catches up at a fixed rate.  The final position is
+		// never missed - a started timer always fires, and
+		// stopBatchProcessing() sets the selection itself.
+		if (!m_pBatchProgressTimer->isActive()) {
+			m_pBatchProgressTimer->start();
+		}
+	} else {
+		// The worker has nothing real to do now.  Put it to work
+		// on the pages the user is likely to visit next.
+		scheduleSpeculativePages();
+	}
+}
+
+void
+MainWindow::batchProgressTimeout()
+{
+	if (!isBatchProcessingInProgress()) {
+		return;
+	}
+
+	PageInfo const page(m_ptrBatchQueue->selectedPage());
+	if (!page.isNull()) {
+		m_ptrThumbSequence->setSelection(page.id());
+	}
+
+	m_pBatchEstimateLabel->setText(batchEstimateText());
+}
+
+/**
+ * Predicts the remaining time of the current batch run from the
+ * per-page history.  Pages without a record are assumed to take the
+ * average of those with one.  Returns an empty string when there is
+ * no history to predict from.
+ */
+QString
+MainWindow::batchEstimateText() const
+{
+	std::vector<PageId> const remaining(m_ptrBatchQueue->remainingPages());
+	if (remaining.empty()) {
+		return QString();
+	}
+
+	double known_seconds = 0;
+	size_t num_known = 0;
+	for (size_t i = 0; i < remaining.size(); ++i) {
+		double const seconds = ProcessingTimes::instance().timeFor(
+			remaining[i], m_batchStageName
+		);
+		if (seconds >= 0) {
+			known_seconds += seconds;
+			++num_known;
 		}
 	}
+	if (num_known == 0) {
+		return QString();
+	}
+
+	double const total_seconds = known_seconds
+		+ (known_seconds / num_known) * (remaining.size() - num_known);
+
+	int const minutes = int(total_seconds) / 60;
+	int const seconds = int(total_seconds) % 60;
+	QString time_text;
+	if (minutes > 0) {
+		time_text = tr("%1m %2s").arg(minutes).arg(seconds);
+	} else {
+		time_text = tr("%1s").arg(seconds);
+	}
+
+	return tr("About %1 remaining (%2 pages)")
+		.arg(time_text).arg((unsigned)remaining.size());
 }
 
 void
@@ -1450,7 +1753,26 @@ MainWindow::openProject()
 void
 MainWindow::openProject(QString const& project_file)
 {
-	QFile file(project_file);
+	QString file_to_load(project_file);
+
+	QString const autosave_path(ProjectAutosaver::autosavePathFor(project_file));
+	if (QFile::exists(autosave_path) && QFileInfo(autosave_path).lastModified()
+			> QFileInfo(project_file).lastModified()) {
+		QMessageBox::StandardButton const res = QMessageBox::question(
+			this, tr("Recover Project"),
+			tr(
+				"An automatically saved version of this project exists "
+				"that is newer than the project file itself.\n"
+				"Open the automatically saved version?"
+			),
+			QMessageBox::Yes|QMessageBox::No, QMessageBox::Yes
+		);
+		if (res == QMessageBox::Yes) {
+			file_to_load = autosave_path;
+		}
+	}
+
+	QFile file(file_to_load);
 	if (!file.open(QIODevice::ReadOnly)) {
 		QMessageBox::warning(
 			this, tr("Error"),
@@ -1469,7 +1791,14 @@ MainWindow::openProject(QString const& project_file)
 	}
 	
 	file.close();
-	
+
+	// Zone geometry may live in a binary sidecar next to the project
+	// file.  Load it now - zones materialize lazily, possibly long
+	// after this point and on other threads.
+	ZoneGeometrySidecarReader::loadFor(file_to_load);
+
+	m_loadedProjectBase = file_to_load;
+
 	ProjectOpeningContext* context = new ProjectOpeningContext(this, project_file, doc);
 	connect(context, SIGNAL(done(ProjectOpeningContext*)), SLOT(projectOpened(ProjectOpeningContext*)));
 	context->proceed();
@@ -1661,7 +1990,8 @@ void
 MainWindow::loadPageInteractive(PageInfo const& page)
 {
 	assert(!isBatchProcessingInProgress());
-	
+
+	cancelSpeculation();
 	m_ptrInteractiveQueue->cancelAndClear();
 	
 	if (isOutputFilter() && !checkReadyForOutput(&page.id())) {
@@ -1700,6 +2030,61 @@ MainWindow::loadPageInteractive(PageInfo const& page)
 	m_ptrWorkerThread->performTask(m_ptrInteractiveQueue->takeForProcessing());
 }
 
+void
+MainWindow::scheduleSpeculativePages()
+{
+	// How far ahead of the user to work.  Far enough to cover a
+	// quick "next, next" advance, small enough that a jump elsewhere
+	// doesn't leave much wasted work to cancel.
+	int const MAX_SPECULATIVE_PAGES = 3;
+
+	if (isBatchProcessingInProgress() || !isProjectLoaded()) {
+		return;
+	}
+	if (!m_speculativeTasks.empty()) {
+		// Already speculating.
+		return;
+	}
+	if (isOutputFilter() && !checkReadyForOutput()) {
+		return;
+	}
+
+	PageInfo page(m_ptrThumbSequence->selectionLeader());
+	if (page.isNull()) {
+		return;
+	}
+
+	for (int i = 0; i < MAX_SPECULATIVE_PAGES; ++i) {
+		page = m_ptrThumbSequence->nextPage(page.id());
+		if (page.isNull()) {
+			break;
+		}
+		BackgroundTaskPtr const task(
+			createCompositeTask(page, m_curFilter, /*batch=*/false, /*debug=*/false)
+		);
+		m_speculativeTasks.insert(task.get());
+		m_ptrSpeculativeQueue->addProcessingTask(page, task);
+	}
+
+	// One speculative task in flight at a time: the single worker
+	// stays responsive to cancellation, and each completion pulls
+	// the next page from filterResult().
+	BackgroundTaskPtr const task(m_ptrSpeculativeQueue->takeForProcessing());
+	if (task) {
+		m_ptrWorkerThread->performTask(task);
+	}
+}
+
+void
+MainWindow::cancelSpeculation()
+{
+	// Cancellation is how real work preempts speculation: an
+	// in-flight speculative task aborts at its next cancellation
+	// checkpoint, well before the real task reaches the worker.
+	m_ptrSpeculativeQueue->cancelAndClear();
+	m_speculativeTasks.clear();
+}
+
 void
 MainWindow::updateWindowTitle()
 {
@@ -1812,10 +2197,25 @@ MainWindow::saveProjectWithFeedback(QString const& project_file)
 		);
 		return false;
 	}
-	
+
+	m_ptrAutosaver->noteExplicitSave(project_file);
+
 	return true;
 }
 
+void
+MainWindow::autosaveProject()
+{
+	if (!isProjectLoaded() || m_projectFile.isEmpty()) {
+		return;
+	}
+
+	m_ptrAutosaver->maybeAutosave(
+		m_projectFile, m_ptrPages, m_selectedPage,
+		m_outFileNameGen, m_ptrStages->filters()
+	);
+}
+
 /**
  * Note: showInsertFileDialog(BEFORE, ImageId()) is legal and means inserting at the end.
  */
@@ -1935,6 +2335,7 @@ MainWindow::showInsertFileDialog(BeforeOrAfter before_or_after, ImageId const& e
 	}
 
 	// Actually insert the new pages.
+	std::vector<ImageInfo> new_images;
 	BOOST_FOREACH(ImageFileInfo const& file, new_files) {
 		int image_num = -1; // Zero-based image number in a multi-page TIFF.
 
@@ -1944,9 +2345,22 @@ MainWindow::showInsertFileDialog(BeforeOrAfter before_or_after, ImageId const& e
 			int const num_sub_pages = ProjectPages::adviseNumberOfLogicalPages(
 				metadata, OrthogonalRotation()
 			);
-			ImageInfo const image_info(
-				ImageId(file.fileInfo(), image_num), metadata, num_sub_pages, false, false
+			new_images.push_back(
+				ImageInfo(
+					ImageId(file.fileInfo(), image_num),
+					metadata, num_sub_pages, false, false
+				)
 			);
+		}
+	}
+
+	if (before_or_after == BEFORE && existing.isNull()) {
+		// Appending to the end of the project.  A single batch
+		// gives us one pages-modified notification instead of
+		// one per image.
+		appendImages(new_images);
+	} else {
+		BOOST_FOREACH(ImageInfo const& image_info, new_images) {
 			insertImage(image_info, before_or_after, existing);
 		}
 	}
@@ -1998,9 +2412,23 @@ MainWindow::insertImage(ImageInfo const& new_image,
 	}
 }
 
+void
+MainWindow::appendImages(std::vector<ImageInfo> const& images)
+{
+	std::vector<PageInfo> const pages(
+		m_ptrPages->appendImages(images, getCurrentView())
+	);
+
+	BOOST_FOREACH(PageInfo const& page_info, pages) {
+		m_outFileNameGen.disambiguator()->registerFile(page_info.imageId().filePath());
+		m_ptrThumbSequence->insert(page_info, BEFORE, ImageId());
+	}
+}
+
 void
 MainWindow::removeFromProject(std::set<PageId> const& pages)
 {
+	cancelSpeculation();
 	m_ptrInteractiveQueue->cancelAndRemove(pages);
 	if (m_ptrBatchQueue.get()) {
 		m_ptrBatchQueue->cancelAndRemove(pages);
@@ -2019,6 +2447,32 @@ MainWindow::removeFromProject(std::set<PageId> const& pages)
 void
 MainWindow::eraseOutputFiles(std::set<PageId> const& pages)
 {
+	/**
+	 * Removes one file per increment.  On a slow disk or network
+	 * share, deleting the output of hundreds of removed pages in
+	 * one go would freeze the GUI for the duration; as a sliced
+	 * job the deletions proceed between repaints instead.  The
+	 * paths are captured up front - the pages are already gone
+	 * from the project by the time we get here.
+	 */
+	class SlicedFileRemover : public AbstractCommand0<bool>
+	{
+	public:
+		SlicedFileRemover(std::vector<QString> const& paths)
+		:	m_paths(paths), m_nextIdx(0) {}
+
+		virtual bool operator()() {
+			if (m_nextIdx < m_paths.size()) {
+				QFile::remove(m_paths[m_nextIdx++]);
+			}
+			return m_nextIdx < m_paths.size();
+		}
+	private:
+		std::vector<QString> m_paths;
+		size_t m_nextIdx;
+	};
+
+	std::vector<QString> paths;
 	std::vector<PageId::SubPage> erase_variations;
 	erase_variations.reserve(3);
 
@@ -2039,11 +2493,17 @@ MainWindow::eraseOutputFiles(std::set<PageId> const& pages)
 				erase_variations.push_back(PageId::RIGHT_PAGE);
 				break;
 		}
-		
+
 		BOOST_FOREACH(PageId::SubPage subpage, erase_variations) {
-			QFile::remove(m_outFileNameGen.filePathFor(PageId(page_id.imageId(), subpage))); 
+			paths.push_back(m_outFileNameGen.filePathFor(PageId(page_id.imageId(), subpage)));
 		}
 	}
+
+	if (!paths.empty()) {
+		ForegroundExecutor::instance().enqueue(
+			ForegroundExecutor::JobPtr(new SlicedFileRemover(paths))
+		);
+	}
 }
 
 BackgroundTaskPtr
@@ -2151,9 +2611,14 @@ void
 MainWindow::updateDisambiguationRecords(PageSequence const& pages)
 {
 	int const count = pages.numPages();
+
+	std::vector<QString> file_paths;
+	file_paths.reserve(count);
 	for (int i = 0; i < count; ++i) {
-		m_outFileNameGen.disambiguator()->registerFile(pages.pageAt(i).imageId().filePath());
+		file_paths.push_back(pages.pageAt(i).imageId().filePath());
 	}
+
+	m_outFileNameGen.disambiguator()->registerFiles(file_paths);
 }
 
 PageSelectionAccessor
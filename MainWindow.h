@@ -41,6 +41,7 @@
 #include <QPointer>
 #include <QObjectCleanupHandler>
 #include <QSizeF>
+#include <QTime>
 #include <memory>
 #include <vector>
 #include <set>
@@ -48,6 +49,7 @@
 class AbstractFilter;
 class AbstractRelinker;
 class ThumbnailPixmapCache;
+class NearDuplicateDetector;
 class ProjectPages;
 class PageSequence;
 class StageSequence;
@@ -57,7 +59,9 @@ class FilterOptionsWidget;
 class ProcessingIndicationWidget;
 class ImageInfo;
 class PageInfo;
+class QLabel;
 class QStackedLayout;
+class QTimer;
 class WorkerThread;
 class ProjectReader;
 class DebugImages;
@@ -65,9 +69,11 @@ class ContentBoxPropagator;
 class PageOrientationPropagator;
 class ProjectCreationContext;
 class ProjectOpeningContext;
+class ProjectAutosaver;
 class CompositeCacheDrivenTask;
 class TabbedDebugImages;
 class ProcessingTaskQueue;
+class BatchPrefetcher;
 class FixDpiDialog;
 class OutOfMemoryDialog;
 class QLineF;
@@ -139,6 +145,8 @@ private slots:
 	
 	void invalidateAllThumbnails();
 
+	void invalidateThumbnails(std::set<PageId> const& pages);
+
 	void showRelinkingDialog();
 	
 	void filterResult(
@@ -167,6 +175,10 @@ private slots:
 
 	void openSettingsDialog();
 
+	void autosaveProject();
+
+	void batchProgressTimeout();
+
 	void showAboutDialog();
 
 	void handleOutOfMemorySituation();
@@ -254,18 +266,37 @@ private:
 	void insertImage(ImageInfo const& new_image,
 		BeforeOrAfter before_or_after, ImageId existing);
 
+	void appendImages(std::vector<ImageInfo> const& images);
+
 	void removeFromProject(std::set<PageId> const& pages);
 
 	void eraseOutputFiles(std::set<PageId> const& pages);
 	
 	BackgroundTaskPtr createCompositeTask(
 		PageInfo const& page, int last_filter_idx, bool batch, bool debug);
-	
+
+	void performBatchTask(BackgroundTaskPtr const& task);
+
+	/**
+	 * \brief Queues the pages following the current one for
+	 *        speculative processing on the idle worker.
+	 */
+	void scheduleSpeculativePages();
+
+	/**
+	 * \brief Cancels queued and in-flight speculative work.
+	 *
+	 * To be called whenever real work is about to claim the worker.
+	 */
+	void cancelSpeculation();
+
 	IntrusivePtr<CompositeCacheDrivenTask>
 	createCompositeCacheDrivenTask(int last_filter_idx);
 	
 	void createBatchProcessingWidget();
 
+	QString batchEstimateText() const;
+
 	void updateDisambiguationRecords(PageSequence const& pages);
 
 	void performRelinking(IntrusivePtr<AbstractRelinker> const& relinker);
@@ -276,14 +307,67 @@ private:
 	IntrusivePtr<ProjectPages> m_ptrPages;
 	IntrusivePtr<StageSequence> m_ptrStages;
 	QString m_projectFile;
+
+	/**
+	 * The file the currently open project was actually loaded from -
+	 * either the project file itself or its autosave.  The autosave
+	 * journal is replayed over (and bound to) this file.
+	 */
+	QString m_loadedProjectBase;
+
 	OutputFileNameGenerator m_outFileNameGen;
 	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
 	std::auto_ptr<ThumbnailSequence> m_ptrThumbSequence;
+
+	/** The double-feed scan of the current project, if any. */
+	IntrusivePtr<NearDuplicateDetector> m_ptrDuplicateDetector;
 	std::auto_ptr<WorkerThread> m_ptrWorkerThread;
 	std::auto_ptr<ProcessingTaskQueue> m_ptrBatchQueue;
+	std::auto_ptr<BatchPrefetcher> m_ptrBatchPrefetcher;
 	std::auto_ptr<ProcessingTaskQueue> m_ptrInteractiveQueue;
+
+	/**
+	 * Holds the speculative tasks for the pages following the current
+	 * one.  They run on the interactive worker whenever it has nothing
+	 * real to do, parking their results in the output caches, so
+	 * advancing to the next page mostly finds everything ready.
+	 */
+	std::auto_ptr<ProcessingTaskQueue> m_ptrSpeculativeQueue;
+
+	/**
+	 * Identifies the tasks of m_ptrSpeculativeQueue among the results
+	 * arriving in filterResult().  Their results are discarded rather
+	 * than shown.
+	 */
+	std::set<BackgroundTask*> m_speculativeTasks;
+
 	QStackedLayout* m_pImageFrameLayout;
 	QStackedLayout* m_pOptionsFrameLayout;
+
+	/**
+	 * Coalesces the per-page UI updates during batch processing.
+	 * With fast pages, task results arrive much faster than the
+	 * thumbnail view can meaningfully follow them.
+	 */
+	QTimer* m_pBatchProgressTimer;
+
+	/**
+	 * Shows the predicted remaining time of the current batch run,
+	 * based on the per-page processing time history.
+	 */
+	QLabel* m_pBatchEstimateLabel;
+
+	/**
+	 * Times the batch task currently being processed.  Only one of
+	 * them is in flight at a time, so a single timer suffices.
+	 */
+	QTime m_batchTaskTimer;
+
+	/**
+	 * The name of the filter the current batch run was started on.
+	 * Page times are recorded and predicted under this stage name.
+	 */
+	QString m_batchStageName;
 	QPointer<FilterOptionsWidget> m_ptrOptionsWidget;
 	QPointer<FixDpiDialog> m_ptrFixDpiDialog;
 	std::auto_ptr<TabbedDebugImages> m_ptrTabbedDebugImages;
@@ -296,6 +380,7 @@ private:
 	QObjectCleanupHandler m_optionsWidgetCleanup;
 	QObjectCleanupHandler m_imageWidgetCleanup;
 	std::auto_ptr<OutOfMemoryDialog> m_ptrOutOfMemoryDialog;
+	std::auto_ptr<ProjectAutosaver> m_ptrAutosaver;
 	int m_curFilter;
 	int m_ignoreSelectionChanges;
 	int m_ignorePageOrderingChanges;
@@ -0,0 +1,147 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "NearDuplicateDetector.h"
+#include "ThumbnailPixmapCache.h"
+#include "ThumbnailSequence.h"
+#include "PageSequence.h"
+#include "PageInfo.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/BinaryThreshold.h"
+#include "imageproc/Scale.h"
+#include "imageproc/BitOps.h"
+#include <QPixmap>
+#include <QImage>
+#include <QSize>
+
+using namespace imageproc;
+
+NearDuplicateDetector::NearDuplicateDetector(
+	IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
+	PageSequence const& pages, ThumbnailSequence* thumb_sequence,
+	int const max_distance)
+:	m_ptrThumbnailCache(thumbnail_cache),
+	m_ptrThumbSequence(thumb_sequence),
+	m_nextIdx(0),
+	m_maxDistance(max_distance),
+	m_cancelled(false)
+{
+	// Group the pages of each image together.  Double-feeds produce
+	// duplicate images, so signatures are per image, and a suspect
+	// image gets all of its pages flagged.
+	size_t const num_pages = pages.numPages();
+	for (size_t i = 0; i < num_pages; ++i) {
+		PageInfo const& page_info = pages.pageAt(i);
+		if (m_images.empty() || m_images.back().imageId != page_info.imageId()) {
+			m_images.push_back(ImageEntry());
+			m_images.back().imageId = page_info.imageId();
+		}
+		m_images.back().pages.push_back(page_info.id());
+	}
+}
+
+bool
+NearDuplicateDetector::operator()()
+{
+	if (m_cancelled || !m_ptrThumbSequence) {
+		// Cancelled, or the thumbnail list this job was
+		// flagging is gone.
+		return false;
+	}
+	if (m_nextIdx >= m_images.size()) {
+		return false;
+	}
+
+	size_t const idx = m_nextIdx++;
+	ImageEntry const& entry = m_images[idx];
+
+	QPixmap pixmap;
+	Signature signature; // Degenerate unless computed below.
+	if (m_ptrThumbnailCache->loadNow(entry.imageId, pixmap)
+			== ThumbnailPixmapCache::LOADED) {
+		signature = computeSignature(pixmap.toImage());
+	}
+
+	if (idx > 0 && !signature.degenerate && !m_prevSignature.degenerate
+			&& hammingDistance(m_prevSignature, signature) <= m_maxDistance) {
+		ImageEntry const& prev_entry = m_images[idx - 1];
+		m_suspects.insert(prev_entry.pages.begin(), prev_entry.pages.end());
+		m_suspects.insert(entry.pages.begin(), entry.pages.end());
+		m_ptrThumbSequence->setDuplicateSuspects(m_suspects);
+	}
+	m_prevSignature = signature;
+
+	return m_nextIdx < m_images.size();
+}
+
+NearDuplicateDetector::Signature
+NearDuplicateDetector::computeSignature(QImage const& image)
+{
+	Signature sig;
+	if (image.isNull()) {
+		return sig;
+	}
+
+	GrayImage const gray(
+		scaleToGray(
+			GrayImage(image), QSize(SIGNATURE_SIZE, SIGNATURE_SIZE)
+		)
+	);
+	if (gray.isNull()) {
+		return sig;
+	}
+
+	QImage const gray_image(gray.toQImage());
+	BinaryImage const binarized(
+		gray_image, BinaryThreshold::otsuThreshold(gray_image)
+	);
+
+	int const words_per_row = SIGNATURE_SIZE / 32;
+	uint32_t const* line = binarized.data();
+	int const wpl = binarized.wordsPerLine();
+	int black_bits = 0;
+	int out = 0;
+	for (int y = 0; y < SIGNATURE_SIZE; ++y, line += wpl) {
+		for (int w = 0; w < words_per_row; ++w) {
+			sig.words[out] = line[w];
+			black_bits += countNonZeroBits(sig.words[out]);
+			++out;
+		}
+	}
+
+	// An almost uniformly white or black signature would match any
+	// other such page.  Blank sheet backs are common in scanned books
+	// and aren't double-feeds, so those signatures never match.
+	int const total_bits = SIGNATURE_SIZE * SIGNATURE_SIZE;
+	int const margin = total_bits / 100;
+	sig.degenerate = black_bits < margin || black_bits > total_bits - margin;
+
+	return sig;
+}
+
+int
+NearDuplicateDetector::hammingDistance(
+	Signature const& lhs, Signature const& rhs)
+{
+	int distance = 0;
+	for (int i = 0; i < SIGNATURE_WORDS; ++i) {
+		distance += countNonZeroBits(lhs.words[i] ^ rhs.words[i]);
+	}
+	return distance;
+}
@@ -0,0 +1,116 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NEARDUPLICATEDETECTOR_H_
+#define NEARDUPLICATEDETECTOR_H_
+
+#include "AbstractCommand.h"
+#include "IntrusivePtr.h"
+#include "PageId.h"
+#include <QPointer>
+#include <vector>
+#include <set>
+#include <stdint.h>
+#include <stddef.h>
+
+class ThumbnailPixmapCache;
+class ThumbnailSequence;
+class PageSequence;
+class QImage;
+
+/**
+ * \brief Flags consecutive near-duplicate images, as left by double-feeds.
+ *
+ * Sheet-fed scanners occasionally pull two sheets at once, producing
+ * a pair of nearly identical consecutive images that's typically only
+ * noticed much later.  This detector computes a small perceptual
+ * signature per image - its thumbnail scaled to 64x64 grayscale and
+ * binarized - and compares the signatures of neighboring images by
+ * Hamming distance.  Images closer than a given threshold get their
+ * pages flagged as suspects in the thumbnail list.
+ *
+ * The detector is a ForegroundExecutor job: it processes one image
+ * per increment, so scanning a project never blocks the GUI, and
+ * flags suspects as it finds them.  A signature comparison is a few
+ * dozen word operations; the cost is reading the thumbnails.
+ */
+class NearDuplicateDetector : public AbstractCommand0<bool>
+{
+public:
+	/**
+	 * \param thumbnail_cache The source of per-image thumbnails.
+	 * \param pages The pages to scan, in sequence order.
+	 * \param thumb_sequence Where suspects are flagged.  The job
+	 *        retires silently if it goes away.
+	 * \param max_distance Hamming distances up to this value (out of
+	 *        4096 signature bits) count as near-duplicates.
+	 */
+	NearDuplicateDetector(
+		IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
+		PageSequence const& pages, ThumbnailSequence* thumb_sequence,
+		int max_distance);
+
+	virtual bool operator()();
+
+	/**
+	 * \brief Makes the job retire at its next increment.
+	 *
+	 * To be called when the project the job was scanning is replaced.
+	 * Must be called from the GUI thread, like everything else here.
+	 */
+	void cancel() { m_cancelled = true; }
+private:
+	enum {
+		SIGNATURE_SIZE = 64, /**< Signature images are 64x64. */
+		SIGNATURE_WORDS = SIGNATURE_SIZE * SIGNATURE_SIZE / 32
+	};
+
+	struct ImageEntry
+	{
+		ImageId imageId;
+		std::vector<PageId> pages;
+	};
+
+	struct Signature
+	{
+		// Member-wise copying is OK.
+
+		uint32_t words[SIGNATURE_WORDS];
+
+		/** Set for mostly blank images, which compare equal to
+		    any other blank image without being double-feeds. */
+		bool degenerate;
+
+		Signature() : degenerate(true) {}
+	};
+
+	static Signature computeSignature(QImage const& image);
+
+	static int hammingDistance(Signature const& lhs, Signature const& rhs);
+
+	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
+	std::vector<ImageEntry> m_images;
+	QPointer<ThumbnailSequence> m_ptrThumbSequence;
+	std::set<PageId> m_suspects;
+	Signature m_prevSignature;
+	size_t m_nextIdx;
+	int m_maxDistance;
+	bool m_cancelled;
+};
+
+#endif
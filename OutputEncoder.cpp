@@ -0,0 +1,109 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "OutputEncoder.h"
+#include "TiffWriter.h"
+#include "CommandLine.h"
+#include "Profiler.h"
+#include <QImage>
+#include <QImageWriter>
+#include <QString>
+#include <QFile>
+#include <QDebug>
+
+namespace
+{
+
+class TiffEncoder : public OutputEncoder
+{
+public:
+	virtual QString fileExtension() const {
+		return QString::fromAscii(".tif");
+	}
+
+	virtual bool write(QString const& file_path, QImage const& image) const {
+		return TiffWriter::writeImage(file_path, image);
+	}
+};
+
+
+class PngEncoder : public OutputEncoder
+{
+public:
+	virtual QString fileExtension() const {
+		return QString::fromAscii(".png");
+	}
+
+	virtual bool write(QString const& file_path, QImage const& image) const {
+		if (image.isNull()) {
+			return false;
+		}
+
+		ProfileScope const profile_scope("io/write-png");
+
+		QImageWriter writer(file_path, "png");
+		if (!writer.write(image)) {
+			QFile::remove(file_path);
+			return false;
+		}
+
+		return true;
+	}
+};
+
+
+TiffEncoder const tiffEncoder;
+PngEncoder const pngEncoder;
+
+} // anonymous namespace
+
+
+OutputEncoder const*
+OutputEncoder::forName(QString const& name)
+{
+	QString const lc(name.toLower());
+	if (lc == "tiff" || lc == "tif") {
+		return &tiffEncoder;
+	} else if (lc == "png") {
+		return &pngEncoder;
+	}
+
+	return 0;
+}
+
+OutputEncoder const&
+OutputEncoder::selected()
+{
+	static OutputEncoder const* selected = 0;
+
+	if (!selected) {
+		CommandLine const& cli = CommandLine::get();
+		if (cli.hasOutputFormat()) {
+			selected = forName(cli.getOutputFormat());
+			if (!selected) {
+				qDebug() << "Unknown output format"
+					<< cli.getOutputFormat() << "- using tiff";
+			}
+		}
+		if (!selected) {
+			selected = &tiffEncoder;
+		}
+	}
+
+	return *selected;
+}
@@ -0,0 +1,72 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_ENCODER_H_
+#define OUTPUT_ENCODER_H_
+
+class QImage;
+class QString;
+
+/**
+ * \brief The format the final output files are encoded in.
+ *
+ * Historically output was always TIFF.  Pipelines that feed the
+ * output files to other tools (OCR in particular) often want a
+ * different format and used to pay a transcode pass for it, so the
+ * encoder is now a narrow interface with one implementation per
+ * format, selected for the whole run by --output-format.
+ *
+ * The selection also determines the extension output file names get,
+ * so switching formats on an existing project makes all pages
+ * reprocess rather than leaving files half in one format and half
+ * in another.
+ */
+class OutputEncoder
+{
+public:
+	virtual ~OutputEncoder() {}
+
+	/**
+	 * \brief The extension for output file names, e.g. ".tif".
+	 */
+	virtual QString fileExtension() const = 0;
+
+	/**
+	 * \brief Encodes an image to a file.
+	 *
+	 * Returns false on failure, removing any partially written file.
+	 */
+	virtual bool write(QString const& file_path, QImage const& image) const = 0;
+
+	/**
+	 * \brief Returns the encoder registered under a name, or null.
+	 *
+	 * Names are matched case-insensitively.
+	 */
+	static OutputEncoder const* forName(QString const& name);
+
+	/**
+	 * \brief The encoder selected by --output-format, TIFF by default.
+	 *
+	 * Like with OutOfMemoryHandler, we rely on this being first
+	 * called early on, from a single thread.
+	 */
+	static OutputEncoder const& selected();
+};
+
+#endif
@@ -17,6 +17,7 @@
 */
 
 #include "OutputFileNameGenerator.h"
+#include "OutputEncoder.h"
 #include "PageId.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
@@ -69,7 +70,7 @@ OutputFileNameGenerator::fileNameFor(PageId const& page) const
 		name += QLatin1Char(ltr == (sub_page == PageId::LEFT_PAGE) ? '1' : '2');
 		name += QLatin1Char(sub_page == PageId::LEFT_PAGE ? 'L' : 'R');
 	}
-	name += QString::fromAscii(".tif");
+	name += OutputEncoder::selected().fileExtension();
 	
 	return name;
 }
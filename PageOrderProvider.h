@@ -20,6 +20,7 @@
 #define PAGE_ORDER_PROVIDER_H_
 
 #include "RefCountable.h"
+#include <vector>
 
 class PageId;
 
@@ -37,6 +38,30 @@ public:
 	virtual bool precedes(
 		PageId const& lhs_page, bool lhs_incomplete,
 		PageId const& rhs_page, bool rhs_incomplete) const = 0;
+
+	/**
+	 * \brief Announces an upcoming batch of precedes() calls
+	 *        over the given pages.
+	 *
+	 * Gives the provider a chance to extract the sort key of every
+	 * page from the shared filter settings once, rather than taking
+	 * their lock inside each comparison of a sort.  Providers are
+	 * only ever used from the GUI thread, so no synchronization of
+	 * the extracted keys is necessary.  The default implementation
+	 * does nothing.
+	 */
+	virtual void precomputeKeys(std::vector<PageId> const&) const {}
+
+	/**
+	 * \brief Announces the end of the batch started by precomputeKeys().
+	 *
+	 * Providers are expected to drop the extracted keys here.  Keeping
+	 * them longer would be unsafe: precedes() is also called outside
+	 * of full sorts, when a single page is repositioned after an edit,
+	 * and must see that page's up-to-date key rather than a stale one.
+	 * The default implementation does nothing.
+	 */
+	virtual void releaseKeys() const {}
 };
 
 #endif
@@ -25,6 +25,9 @@
 #include "PageInfo.h"
 #include "filters/page_split/Filter.h"
 #include "filter_dc/PageOrientationCollector.h"
+#include "ImageId.h"
+#include <vector>
+#include <utility>
 
 class PageOrientationPropagator::Collector : public PageOrientationCollector
 {
@@ -56,13 +59,21 @@ PageOrientationPropagator::propagate(ProjectPages const& pages)
 {
 	PageSequence const sequence(pages.toPageSequence(PAGE_VIEW));
 	size_t const num_pages = sequence.numPages();
-	
+
+	// Gather the orientations of all the pages and apply them as
+	// a single batch, so that ProjectPages notifies its clients
+	// once rather than once per affected page.
+	std::vector<std::pair<ImageId, OrthogonalRotation> > orientations;
+	orientations.reserve(num_pages);
+
 	for (size_t i = 0; i < num_pages; ++i) {
 		PageInfo const& page_info = sequence.pageAt(i);
 		Collector collector;
 		m_ptrTask->process(page_info, &collector);
-		m_ptrPageSplitFilter->pageOrientationUpdate(
-			page_info.imageId(), collector.orientation()
+		orientations.push_back(
+			std::make_pair(page_info.imageId(), collector.orientation())
 		);
 	}
+
+	m_ptrPageSplitFilter->updatePageOrientations(orientations);
 }
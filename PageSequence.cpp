@@ -22,7 +22,10 @@
 void
 PageSequence::append(PageInfo const& page_info)
 {
-	m_pages.push_back(page_info);	
+	m_pageNoById.insert(
+		std::make_pair(page_info.id(), m_pages.size())
+	);
+	m_pages.push_back(page_info);
 }
 
 PageInfo const&
@@ -31,6 +34,16 @@ PageSequence::pageAt(size_t const idx) const
 	return m_pages.at(idx); // may throw
 }
 
+int
+PageSequence::pageNo(PageId const& page) const
+{
+	std::map<PageId, size_t>::const_iterator const it(m_pageNoById.find(page));
+	if (it == m_pageNoById.end()) {
+		return -1;
+	}
+	return (int)it->second;
+}
+
 std::set<PageId>
 PageSequence::selectAll() const
 {
@@ -47,12 +60,14 @@ std::set<PageId>
 PageSequence::selectPagePlusFollowers(PageId const& page) const
 {
 	std::set<PageId> selection;
-	
-	std::vector<PageInfo>::const_iterator it(m_pages.begin());
-	std::vector<PageInfo>::const_iterator const end(m_pages.end());
-	for (; it != end && it->id() != page; ++it) {
-		// Continue until we have a match.
+
+	int const page_no = pageNo(page);
+	if (page_no == -1) {
+		return selection;
 	}
+
+	std::vector<PageInfo>::const_iterator it(m_pages.begin() + page_no);
+	std::vector<PageInfo>::const_iterator const end(m_pages.end());
 	for (; it != end; ++it) {
 		selection.insert(it->id());
 	}
@@ -64,17 +79,12 @@ std::set<PageId>
 PageSequence::selectEveryOther(PageId const& base) const
 {
 	std::set<PageId> selection;
-	
-	std::vector<PageInfo>::const_iterator it(m_pages.begin());
-	std::vector<PageInfo>::const_iterator const end(m_pages.end());
-	for (; it != end && it->id() != base; ++it) {
-		// Continue until we have a match.
-	}
-	if (it == end) {
+
+	int const base_idx = pageNo(base);
+	if (base_idx == -1) {
 		return selection;
 	}
 
-	int const base_idx = it - m_pages.begin();
 	int idx = 0;
 	BOOST_FOREACH(PageInfo const& page_info, m_pages) {
 		if (((idx - base_idx) & 1) == 0) {
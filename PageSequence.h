@@ -20,6 +20,7 @@
 #define PAGE_SEQUENCE_H_
 
 #include "PageInfo.h"
+#include <map>
 #include <vector>
 #include <set>
 #include <stddef.h>
@@ -29,11 +30,19 @@ class PageSequence
 	// Member-wise copying is OK.
 public:
 	void append(PageInfo const& page_info);
-	
+
 	size_t numPages() const { return m_pages.size(); }
-	
+
 	PageInfo const& pageAt(size_t idx) const;
 
+	/**
+	 * \brief Returns the position of a page in the sequence, or -1.
+	 *
+	 * Backed by an index, so navigating or selecting by PageId
+	 * doesn't degrade to a linear scan on huge projects.
+	 */
+	int pageNo(PageId const& page) const;
+
 	std::set<PageId> selectAll() const;
 
 	std::set<PageId> selectPagePlusFollowers(PageId const& page) const;
@@ -41,6 +50,7 @@ public:
 	std::set<PageId> selectEveryOther(PageId const& base) const;
 private:
 	std::vector<PageInfo> m_pages;
+	std::map<PageId, size_t> m_pageNoById;
 };
 
 #endif
@@ -0,0 +1,627 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PdfExporter.h"
+#include "AtomicFileOverwriter.h"
+#include "Dpm.h"
+#include "imageproc/BinaryImage.h"
+#include <QImage>
+#include <QIODevice>
+#include <QBuffer>
+#include <QString>
+#include <QMutexLocker>
+#include <vector>
+#include <algorithm>
+#include <tiff.h>
+#include <tiffio.h>
+#include <setjmp.h>
+#include <string.h>
+#include <stdint.h>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+namespace
+{
+
+int const JPEG_QUALITY = 90;
+
+double const FALLBACK_DPI = 300.0;
+
+
+class TiffHandle
+{
+public:
+	TiffHandle(TIFF* handle) : m_pHandle(handle) {}
+
+	~TiffHandle() { if (m_pHandle) TIFFClose(m_pHandle); }
+
+	TIFF* handle() const { return m_pHandle; }
+private:
+	TIFF* m_pHandle;
+};
+
+
+static tsize_t deviceRead(thandle_t context, tdata_t data, tsize_t size)
+{
+	QIODevice* dev = (QIODevice*)context;
+	return (tsize_t)dev->read(static_cast<char*>(data), size);
+}
+
+static tsize_t deviceWrite(thandle_t context, tdata_t data, tsize_t size)
+{
+	QIODevice* dev = (QIODevice*)context;
+	return (tsize_t)dev->write(static_cast<char*>(data), size);
+}
+
+static toff_t deviceSeek(thandle_t context, toff_t offset, int whence)
+{
+	QIODevice* dev = (QIODevice*)context;
+
+	switch (whence) {
+		case SEEK_SET:
+			dev->seek(offset);
+			break;
+		case SEEK_CUR:
+			dev->seek(dev->pos() + offset);
+			break;
+		case SEEK_END:
+			dev->seek(dev->size() + offset);
+			break;
+	}
+
+	return dev->pos();
+}
+
+static int deviceClose(thandle_t context)
+{
+	// The buffer is owned by the caller.
+	return 0;
+}
+
+static toff_t deviceSize(thandle_t context)
+{
+	QIODevice* dev = (QIODevice*)context;
+	return dev->size();
+}
+
+static int deviceMap(thandle_t, tdata_t*, toff_t*)
+{
+	// Not implemented.
+	return 0;
+}
+
+static void deviceUnmap(thandle_t, tdata_t, toff_t)
+{
+	// Not implemented.
+}
+
+
+/*========================= JpegCompressHandle ==========================*/
+
+class JpegCompressHandle
+{
+	DECLARE_NON_COPYABLE(JpegCompressHandle)
+public:
+	JpegCompressHandle(jpeg_error_mgr* err_mgr, jpeg_destination_mgr* dest_mgr);
+
+	~JpegCompressHandle();
+
+	jpeg_compress_struct* ptr() { return &m_info; }
+
+	jpeg_compress_struct* operator->() { return &m_info; }
+private:
+	jpeg_compress_struct m_info;
+};
+
+JpegCompressHandle::JpegCompressHandle(
+	jpeg_error_mgr* err_mgr, jpeg_destination_mgr* dest_mgr)
+{
+	m_info.err = err_mgr;
+	jpeg_create_compress(&m_info);
+	m_info.dest = dest_mgr;
+}
+
+JpegCompressHandle::~JpegCompressHandle()
+{
+	jpeg_destroy_compress(&m_info);
+}
+
+
+/*======================= JpegDestinationManager ========================*/
+
+class JpegDestinationManager : public jpeg_destination_mgr
+{
+	DECLARE_NON_COPYABLE(JpegDestinationManager)
+public:
+	JpegDestinationManager(QByteArray& out);
+private:
+	static void initDestination(j_compress_ptr cinfo);
+
+	static boolean emptyOutputBuffer(j_compress_ptr cinfo);
+
+	static void termDestination(j_compress_ptr cinfo);
+
+	static JpegDestinationManager* object(j_compress_ptr cinfo);
+
+	QByteArray& m_rOut;
+	JOCTET m_buf[4096];
+};
+
+JpegDestinationManager::JpegDestinationManager(QByteArray& out)
+:	m_rOut(out)
+{
+	init_destination = &JpegDestinationManager::initDestination;
+	empty_output_buffer = &JpegDestinationManager::emptyOutputBuffer;
+	term_destination = &JpegDestinationManager::termDestination;
+	next_output_byte = m_buf;
+	free_in_buffer = sizeof(m_buf);
+}
+
+void
+JpegDestinationManager::initDestination(j_compress_ptr cinfo)
+{
+	// No-op.  The buffer was set up in the constructor.
+}
+
+boolean
+JpegDestinationManager::emptyOutputBuffer(j_compress_ptr cinfo)
+{
+	JpegDestinationManager* const obj = object(cinfo);
+	obj->m_rOut.append((char const*)obj->m_buf, sizeof(obj->m_buf));
+	obj->next_output_byte = obj->m_buf;
+	obj->free_in_buffer = sizeof(obj->m_buf);
+	return 1;
+}
+
+void
+JpegDestinationManager::termDestination(j_compress_ptr cinfo)
+{
+	JpegDestinationManager* const obj = object(cinfo);
+	obj->m_rOut.append(
+		(char const*)obj->m_buf, sizeof(obj->m_buf) - obj->free_in_buffer
+	);
+}
+
+JpegDestinationManager*
+JpegDestinationManager::object(j_compress_ptr cinfo)
+{
+	return static_cast<JpegDestinationManager*>(cinfo->dest);
+}
+
+
+/*========================== JpegErrorManager ===========================*/
+
+class JpegErrorManager : public jpeg_error_mgr
+{
+	DECLARE_NON_COPYABLE(JpegErrorManager)
+public:
+	JpegErrorManager();
+
+	jmp_buf& jmpBuf() { return m_jmpBuf; }
+private:
+	static void errorExit(j_common_ptr cinfo);
+
+	static JpegErrorManager* object(j_common_ptr cinfo);
+
+	jmp_buf m_jmpBuf;
+};
+
+JpegErrorManager::JpegErrorManager()
+{
+	jpeg_std_error(this);
+	error_exit = &JpegErrorManager::errorExit;
+}
+
+void
+JpegErrorManager::errorExit(j_common_ptr cinfo)
+{
+	longjmp(object(cinfo)->jmpBuf(), 1);
+}
+
+JpegErrorManager*
+JpegErrorManager::object(j_common_ptr cinfo)
+{
+	return static_cast<JpegErrorManager*>(cinfo->err);
+}
+
+
+/*============================== PdfOut =================================*/
+
+/**
+ * Writes to a device, tracking the byte offset for the xref table.
+ */
+class PdfOut
+{
+	DECLARE_NON_COPYABLE(PdfOut)
+public:
+	PdfOut(QIODevice& device) : m_rDevice(device), m_pos(0), m_ok(true) {}
+
+	void write(QByteArray const& bytes) {
+		if (m_rDevice.write(bytes) != bytes.size()) {
+			m_ok = false;
+		} else {
+			m_pos += bytes.size();
+		}
+	}
+
+	void write(char const* str) { write(QByteArray(str)); }
+
+	qint64 pos() const { return m_pos; }
+
+	bool ok() const { return m_ok; }
+private:
+	QIODevice& m_rDevice;
+	qint64 m_pos;
+	bool m_ok;
+};
+
+QByteArray xrefEntry(qint64 const offset)
+{
+	QByteArray entry(QByteArray::number(offset));
+	while (entry.size() < 10) {
+		entry.prepend('0');
+	}
+	entry += " 00000 n \n";
+	return entry;
+}
+
+} // anonymous namespace
+
+
+/*============================= PdfExporter =============================*/
+
+PdfExporter&
+PdfExporter::instance()
+{
+	static PdfExporter exporter;
+	return exporter;
+}
+
+void
+PdfExporter::addPage(PageId const& page_id, QImage const& image)
+{
+	if (image.isNull()) {
+		return;
+	}
+
+	EncodedPage page;
+	page.widthPx = image.width();
+	page.heightPx = image.height();
+
+	double x_dpi = FALLBACK_DPI;
+	double y_dpi = FALLBACK_DPI;
+	Dpm const dpm(image);
+	if (!dpm.isNull()) {
+		x_dpi = dpm.horizontal() * 0.0254;
+		y_dpi = dpm.vertical() * 0.0254;
+	}
+	page.widthPt = page.widthPx * 72.0 / x_dpi;
+	page.heightPt = page.heightPx * 72.0 / y_dpi;
+
+	bool ok = false;
+	switch (image.format()) {
+		case QImage::Format_Mono:
+		case QImage::Format_MonoLSB:
+			page.codec = EncodedPage::CCITT_G4;
+			ok = encodeG4(image, page.data);
+			break;
+		case QImage::Format_Indexed8:
+			if (image.allGray()) {
+				page.codec = EncodedPage::JPEG_GRAYSCALE;
+				ok = encodeJpeg(image, true, page.data);
+				break;
+			}
+			// An unusual palette - fall through to the RGB case.
+		default: {
+			QImage rgb(image);
+			if (rgb.format() != QImage::Format_RGB32
+					&& rgb.format() != QImage::Format_ARGB32) {
+				rgb = image.convertToFormat(QImage::Format_RGB32);
+			}
+			page.codec = EncodedPage::JPEG_RGB;
+			ok = encodeJpeg(rgb, false, page.data);
+			break;
+		}
+	}
+	if (!ok) {
+		return;
+	}
+
+	QMutexLocker const locker(&m_mutex);
+	m_pages[page_id] = page;
+}
+
+bool
+PdfExporter::hasPage(PageId const& page_id) const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_pages.find(page_id) != m_pages.end();
+}
+
+bool
+PdfExporter::encodeG4(QImage const& image, QByteArray& data)
+{
+	// Normalization gives us 1 = black with the leftmost pixel
+	// in the most significant bit, which is what the fax codec
+	// expects with PHOTOMETRIC_MINISWHITE.
+	imageproc::BinaryImage const binary(image);
+	if (binary.isNull()) {
+		return false;
+	}
+	QImage const mono(binary.toQImage());
+
+	int const width = mono.width();
+	int const height = mono.height();
+
+	QBuffer buffer;
+	buffer.open(QIODevice::ReadWrite);
+	TiffHandle tif(
+		TIFFClientOpen(
+			"mem", "wBm", &buffer, &deviceRead, &deviceWrite,
+			&deviceSeek, &deviceClose, &deviceSize,
+			&deviceMap, &deviceUnmap
+		)
+	);
+	if (!tif.handle()) {
+		return false;
+	}
+
+	TIFFSetField(tif.handle(), TIFFTAG_IMAGEWIDTH, uint32(width));
+	TIFFSetField(tif.handle(), TIFFTAG_IMAGELENGTH, uint32(height));
+	TIFFSetField(tif.handle(), TIFFTAG_ROWSPERSTRIP, uint32(height));
+	TIFFSetField(tif.handle(), TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+	TIFFSetField(tif.handle(), TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, uint16(1));
+	TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16(1));
+	TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_CCITTFAX4);
+	TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISWHITE);
+
+	// TIFFWriteScanline() can actually modify the data you pass it.
+	int const row_bytes = (width + 7) / 8;
+	std::vector<uint8_t> tmp_line(row_bytes, 0);
+	for (int y = 0; y < height; ++y) {
+		memcpy(&tmp_line[0], mono.scanLine(y), row_bytes);
+		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
+			return false;
+		}
+	}
+	if (TIFFFlushData(tif.handle()) != 1) {
+		return false;
+	}
+
+#if TIFFLIB_VERSION >= 20111221
+	uint64* offsets = 0;
+	uint64* byte_counts = 0;
+#else
+	uint32* offsets = 0;
+	uint32* byte_counts = 0;
+#endif
+	if (!TIFFGetField(tif.handle(), TIFFTAG_STRIPOFFSETS, &offsets)
+			|| !TIFFGetField(tif.handle(), TIFFTAG_STRIPBYTECOUNTS, &byte_counts)
+			|| !offsets || !byte_counts) {
+		return false;
+	}
+
+	// The raw strip data is a plain G4 stream, which is exactly
+	// what CCITTFaxDecode with /K -1 consumes.
+	data = QByteArray(
+		buffer.data().constData() + (int)offsets[0], (int)byte_counts[0]
+	);
+
+	return true;
+}
+
+bool
+PdfExporter::encodeJpeg(QImage const& image, bool const grayscale, QByteArray& data)
+{
+	int const width = image.width();
+	int const height = image.height();
+
+	// For grayscale images, a palette index -> luminance mapping.
+	std::vector<JSAMPLE> gray_lut;
+	if (grayscale) {
+		int const num_colors = image.numColors();
+		gray_lut.resize(256, 0);
+		for (int i = 0; i < num_colors; ++i) {
+			gray_lut[i] = (JSAMPLE)qGray(image.color(i));
+		}
+	}
+
+	// Declared before setjmp(), so that returning from longjmp()
+	// releases the row buffer.
+	std::vector<JSAMPLE> row_buf(grayscale ? width : width * 3);
+
+	JpegErrorManager err_mgr;
+	if (setjmp(err_mgr.jmpBuf())) {
+		// Returning from longjmp().
+		data.clear();
+		return false;
+	}
+
+	JpegDestinationManager dest_mgr(data);
+	JpegCompressHandle cinfo(&err_mgr, &dest_mgr);
+
+	cinfo->image_width = width;
+	cinfo->image_height = height;
+	cinfo->input_components = grayscale ? 1 : 3;
+	cinfo->in_color_space = grayscale ? JCS_GRAYSCALE : JCS_RGB;
+	jpeg_set_defaults(cinfo.ptr());
+	jpeg_set_quality(cinfo.ptr(), JPEG_QUALITY, 1);
+	jpeg_start_compress(cinfo.ptr(), 1);
+
+	for (int y = 0; y < height; ++y) {
+		if (grayscale) {
+			uint8_t const* src = (uint8_t const*)image.scanLine(y);
+			for (int x = 0; x < width; ++x) {
+				row_buf[x] = gray_lut[src[x]];
+			}
+		} else {
+			uint32_t const* src = (uint32_t const*)image.scanLine(y);
+			JSAMPLE* dst = &row_buf[0];
+			for (int x = 0; x < width; ++x, dst += 3) {
+				uint32_t const pixel = src[x];
+				dst[0] = (JSAMPLE)qRed(pixel);
+				dst[1] = (JSAMPLE)qGreen(pixel);
+				dst[2] = (JSAMPLE)qBlue(pixel);
+			}
+		}
+		JSAMPROW row = &row_buf[0];
+		jpeg_write_scanlines(cinfo.ptr(), &row, 1);
+	}
+
+	jpeg_finish_compress(cinfo.ptr());
+
+	return true;
+}
+
+bool
+PdfExporter::writePdf(QString const& file_path, std::vector<PageId> const& page_order)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	std::vector<EncodedPage const*> pages;
+	pages.reserve(page_order.size());
+	for (size_t i = 0; i < page_order.size(); ++i) {
+		std::map<PageId, EncodedPage>::const_iterator const it(
+			m_pages.find(page_order[i])
+		);
+		if (it != m_pages.end()) {
+			pages.push_back(&it->second);
+		}
+	}
+	if (pages.empty()) {
+		return false;
+	}
+
+	AtomicFileOverwriter overwriter;
+	QIODevice* const device = overwriter.startWriting(file_path);
+	if (!device) {
+		return false;
+	}
+
+	int const num_pages = pages.size();
+
+	// Object 1 is the catalog, object 2 the page tree, then each
+	// page gets three objects: the page, its content stream and
+	// its image.
+	int const num_objs = 2 + num_pages * 3;
+	std::vector<qint64> obj_offsets(num_objs + 1, 0);
+
+	PdfOut out(*device);
+	out.write("%PDF-1.4\n%\xe2\xe3\xcf\xd3\n");
+
+	obj_offsets[1] = out.pos();
+	out.write("1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+
+	QByteArray kids;
+	for (int i = 0; i < num_pages; ++i) {
+		if (i > 0) {
+			kids += ' ';
+		}
+		kids += QByteArray::number(3 + i * 3) + " 0 R";
+	}
+	obj_offsets[2] = out.pos();
+	out.write(
+		"2 0 obj\n<< /Type /Pages /Kids [" + kids + "] /Count "
+		+ QByteArray::number(num_pages) + " >>\nendobj\n"
+	);
+
+	for (int i = 0; i < num_pages; ++i) {
+		EncodedPage const& page = *pages[i];
+		int const page_obj = 3 + i * 3;
+		int const content_obj = page_obj + 1;
+		int const image_obj = page_obj + 2;
+
+		QByteArray const width_pt(QByteArray::number(page.widthPt, 'f', 2));
+		QByteArray const height_pt(QByteArray::number(page.heightPt, 'f', 2));
+
+		obj_offsets[page_obj] = out.pos();
+		out.write(
+			QByteArray::number(page_obj)
+			+ " 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 "
+			+ width_pt + " " + height_pt
+			+ "] /Resources << /XObject << /Im0 "
+			+ QByteArray::number(image_obj)
+			+ " 0 R >> /ProcSet [/PDF /ImageB /ImageC] >> /Contents "
+			+ QByteArray::number(content_obj) + " 0 R >>\nendobj\n"
+		);
+
+		QByteArray const content(
+			"q\n" + width_pt + " 0 0 " + height_pt + " 0 0 cm\n/Im0 Do\nQ\n"
+		);
+		obj_offsets[content_obj] = out.pos();
+		out.write(
+			QByteArray::number(content_obj) + " 0 obj\n<< /Length "
+			+ QByteArray::number(content.size()) + " >>\nstream\n"
+			+ content + "endstream\nendobj\n"
+		);
+
+		QByteArray dict(
+			"<< /Type /XObject /Subtype /Image /Width "
+			+ QByteArray::number(page.widthPx) + " /Height "
+			+ QByteArray::number(page.heightPx)
+		);
+		switch (page.codec) {
+			case EncodedPage::CCITT_G4:
+				// With BlackIs1 at its default of false, decoded
+				// 0 bits are black, matching /DeviceGray.
+				dict += " /ColorSpace /DeviceGray /BitsPerComponent 1"
+					" /Filter /CCITTFaxDecode /DecodeParms << /K -1 /Columns "
+					+ QByteArray::number(page.widthPx) + " /Rows "
+					+ QByteArray::number(page.heightPx) + " >>";
+				break;
+			case EncodedPage::JPEG_GRAYSCALE:
+				dict += " /ColorSpace /DeviceGray /BitsPerComponent 8"
+					" /Filter /DCTDecode";
+				break;
+			case EncodedPage::JPEG_RGB:
+				dict += " /ColorSpace /DeviceRGB /BitsPerComponent 8"
+					" /Filter /DCTDecode";
+				break;
+		}
+		dict += " /Length " + QByteArray::number(page.data.size()) + " >>";
+
+		obj_offsets[image_obj] = out.pos();
+		out.write(QByteArray::number(image_obj) + " 0 obj\n" + dict + "\nstream\n");
+		out.write(page.data);
+		out.write("\nendstream\nendobj\n");
+	}
+
+	qint64 const xref_pos = out.pos();
+	out.write(
+		"xref\n0 " + QByteArray::number(num_objs + 1)
+		+ "\n0000000000 65535 f \n"
+	);
+	for (int i = 1; i <= num_objs; ++i) {
+		out.write(xrefEntry(obj_offsets[i]));
+	}
+	out.write(
+		"trailer\n<< /Size " + QByteArray::number(num_objs + 1)
+		+ " /Root 1 0 R >>\nstartxref\n"
+		+ QByteArray::number(xref_pos) + "\n%%EOF\n"
+	);
+
+	if (!out.ok()) {
+		overwriter.abort();
+		return false;
+	}
+
+	return overwriter.commit();
+}
@@ -0,0 +1,92 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PDFEXPORTER_H_
+#define PDFEXPORTER_H_
+
+#include "NonCopyable.h"
+#include "PageId.h"
+#include <QByteArray>
+#include <QMutex>
+#include <map>
+#include <vector>
+
+class QImage;
+class QIODevice;
+class QString;
+
+/**
+ * \brief Accumulates finished output pages and assembles them into a PDF.
+ *
+ * Feeding output TIFFs into a separate PDF assembly step re-reads
+ * everything that was just written.  This exporter instead takes each
+ * finished page while it is still in memory, encodes it right away on
+ * whatever thread produced it (CCITT G4 for bitonal pages, JPEG for
+ * grayscale and color ones), and keeps only the compressed data until
+ * the container is written at the end of the batch.
+ */
+class PdfExporter
+{
+	DECLARE_NON_COPYABLE(PdfExporter)
+public:
+	static PdfExporter& instance();
+
+	/**
+	 * \brief Encodes \p image and stores it as the contents of the page.
+	 *
+	 * May be called from multiple threads at the same time.  Adding
+	 * the same page again replaces its previous contents.
+	 */
+	void addPage(PageId const& page_id, QImage const& image);
+
+	bool hasPage(PageId const& page_id) const;
+
+	/**
+	 * \brief Writes the accumulated pages to \p file_path, in \p page_order.
+	 *
+	 * Pages from \p page_order that were never added are skipped.
+	 * \return True on success, false on failure.
+	 */
+	bool writePdf(QString const& file_path, std::vector<PageId> const& page_order);
+private:
+	struct EncodedPage
+	{
+		enum Codec { CCITT_G4, JPEG_GRAYSCALE, JPEG_RGB };
+
+		Codec codec;
+		int widthPx;
+		int heightPx;
+		double widthPt;
+		double heightPt;
+		QByteArray data;
+
+		EncodedPage()
+		: codec(CCITT_G4), widthPx(0), heightPx(0), widthPt(0), heightPt(0) {}
+	};
+
+	PdfExporter() {}
+
+	static bool encodeG4(QImage const& image, QByteArray& data);
+
+	static bool encodeJpeg(QImage const& image, bool grayscale, QByteArray& data);
+
+	mutable QMutex m_mutex;
+	std::map<PageId, EncodedPage> m_pages;
+};
+
+#endif
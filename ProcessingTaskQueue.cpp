@@ -17,13 +17,11 @@
 */
 
 #include "ProcessingTaskQueue.h"
-#include <boost/foreach.hpp>
 
 ProcessingTaskQueue::Entry::Entry(
 	PageInfo const& page_info, BackgroundTaskPtr const& tsk)
 :	pageInfo(page_info),
-	task(tsk),
-	takenForProcessing(false)
+	task(tsk)
 {
 }
 
@@ -36,35 +34,44 @@ void
 ProcessingTaskQueue::addProcessingTask(
 	PageInfo const& page_info, BackgroundTaskPtr const& task)
 {
-	m_queue.push_back(Entry(page_info, task));
+	m_readyQueue.push_back(Entry(page_info, task));
 }
 
 BackgroundTaskPtr
 ProcessingTaskQueue::takeForProcessing()
 {
-	BOOST_FOREACH(Entry& ent, m_queue) {
-		if (!ent.takenForProcessing) {
-			ent.takenForProcessing = true;
-			
-			if (m_order == RANDOM_ORDER) {
-				// In this mode we select the most recently submitted for processing page.
-				// This means question marks on selected pages, but at least this avoids
-				// jumps caused by dynamic ordering.
-				m_selectedPage = ent.pageInfo;
-			}
+	if (m_readyQueue.empty()) {
+		return BackgroundTaskPtr();
+	}
 
-			return ent.task;
-		}
+	m_inFlight.splice(m_inFlight.end(), m_readyQueue, m_readyQueue.begin());
+	Entry const& ent = m_inFlight.back();
+
+	if (m_order == RANDOM_ORDER) {
+		// In this mode we select the most recently submitted for processing page.
+		// This means question marks on selected pages, but at least this avoids
+		// jumps caused by dynamic ordering.
+		m_selectedPage = ent.pageInfo;
 	}
 
-	return BackgroundTaskPtr();
+	return ent.task;
+}
+
+PageInfo
+ProcessingTaskQueue::nextReadyPage() const
+{
+	if (m_readyQueue.empty()) {
+		return PageInfo();
+	}
+
+	return m_readyQueue.front().pageInfo;
 }
 
 void
 ProcessingTaskQueue::processingFinished(BackgroundTaskPtr const& task)
 {
-	std::list<Entry>::iterator it(m_queue.begin());
-	std::list<Entry>::iterator const end(m_queue.end());
+	std::list<Entry>::iterator it(m_inFlight.begin());
+	std::list<Entry>::iterator const end(m_inFlight.end());
 
 	for (;; ++it) {
 		if (it == end) {
@@ -72,27 +79,25 @@ ProcessingTaskQueue::processingFinished(BackgroundTaskPtr const& task)
 			return;
 		}
 
-		if (!it->takenForProcessing) {
-			// There is no point in looking further.
-			return;
-		}
-
 		if (it->task == task) {
 			break;
 		}
 	}
 
 	// If we reached this point, it means we've found our entry and
-	// have <it> pointing to it. 
+	// have <it> pointing to it.
 
 	if (m_order == SEQUENTIAL_ORDER) {
 		// In this mode we select the page that was just processed,
 		// rather than the one currently being processed.  This way
-		// we can avoid question marks on selected pages.
+		// we can avoid question marks on selected pages.  With
+		// multiple tasks in flight completions may arrive out of
+		// order, but that only affects which page gets selected,
+		// not execution.
 		m_selectedPage = it->pageInfo;
 	}
 
-	m_queue.erase(it);
+	m_inFlight.erase(it);
 }
 
 PageInfo
@@ -104,23 +109,49 @@ ProcessingTaskQueue::selectedPage() const
 bool
 ProcessingTaskQueue::allProcessed() const
 {
-	return m_queue.empty();
+	return m_readyQueue.empty() && m_inFlight.empty();
+}
+
+std::vector<PageId>
+ProcessingTaskQueue::remainingPages() const
+{
+	std::vector<PageId> pages;
+	pages.reserve(m_readyQueue.size() + m_inFlight.size());
+
+	std::list<Entry>::const_iterator it(m_inFlight.begin());
+	for (; it != m_inFlight.end(); ++it) {
+		pages.push_back(it->pageInfo.id());
+	}
+	for (it = m_readyQueue.begin(); it != m_readyQueue.end(); ++it) {
+		pages.push_back(it->pageInfo.id());
+	}
+
+	return pages;
 }
 
 void
 ProcessingTaskQueue::cancelAndRemove(std::set<PageId> const& pages)
 {
-	std::list<Entry>::iterator it(m_queue.begin());
-	std::list<Entry>::iterator const end(m_queue.end());
-	while (it != end) {
+	std::list<Entry>::iterator it(m_inFlight.begin());
+	while (it != m_inFlight.end()) {
 		if (pages.find(it->pageInfo.id()) != pages.end()) {
-			if (it->takenForProcessing) {
-				it->task->cancel();
+			it->task->cancel();
+			if (m_selectedPage.id() == it->pageInfo.id()) {
+				m_selectedPage = PageInfo();
 			}
+			m_inFlight.erase(it++);
+		} else {
+			++it;
+		}
+	}
+
+	it = m_readyQueue.begin();
+	while (it != m_readyQueue.end()) {
+		if (pages.find(it->pageInfo.id()) != pages.end()) {
 			if (m_selectedPage.id() == it->pageInfo.id()) {
 				m_selectedPage = PageInfo();
 			}
-			m_queue.erase(it++);
+			m_readyQueue.erase(it++);
 		} else {
 			++it;
 		}
@@ -130,12 +161,10 @@ ProcessingTaskQueue::cancelAndRemove(std::set<PageId> const& pages)
 void
 ProcessingTaskQueue::cancelAndClear()
 {
-	while (!m_queue.empty()) {
-		Entry& ent = m_queue.front();
-		if (ent.takenForProcessing) {
-			ent.task->cancel();
-		}
-		m_queue.pop_front();
+	while (!m_inFlight.empty()) {
+		m_inFlight.front().task->cancel();
+		m_inFlight.pop_front();
 	}
+	m_readyQueue.clear();
 	m_selectedPage = PageInfo();
 }
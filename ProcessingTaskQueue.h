@@ -25,13 +25,15 @@
 #include "PageId.h"
 #include <list>
 #include <set>
+#include <vector>
 
 class ProcessingTaskQueue
 {
 	DECLARE_NON_COPYABLE(ProcessingTaskQueue)
 public:
 	/**
-	 * Order only affects the result of selectedPage().
+	 * Order only affects the result of selectedPage(), never the order
+	 * in which tasks are handed out for execution.
 	 * For single-task queues and for custom-sorted sequences,
 	 * use RANDOM_ORDER, otherwise use SEQUENTIAL_ORDER.
 	 */
@@ -42,12 +44,25 @@ public:
 	void addProcessingTask(PageInfo const& page_info, BackgroundTaskPtr const& task);
 
 	/**
-	 * The first task among those that haven't been already taken for processing
-	 * is marked as taken and returned.  A null task will be returned if there
-	 * are no such tasks.
+	 * The front task among those that haven't been already taken for
+	 * processing is marked as taken and returned.  A null task will be
+	 * returned if there are no such tasks.
+	 *
+	 * Any number of tasks may be in flight simultaneously.  They are
+	 * allowed to finish in an arbitrary order - the submission order
+	 * only affects which page selectedPage() reports.
 	 */
 	BackgroundTaskPtr takeForProcessing();
 
+	/**
+	 * \brief Page info of the entry the next takeForProcessing()
+	 *        call would hand out.
+	 *
+	 * Returns a null PageInfo if the ready queue is empty.  Useful
+	 * for warming caches ahead of the queue.
+	 */
+	PageInfo nextReadyPage() const;
+
 	void processingFinished(BackgroundTaskPtr const& task);
 
 	/**
@@ -61,6 +76,12 @@ public:
 
 	bool allProcessed() const;
 
+	/**
+	 * \brief Ids of the pages not yet finished - both those still
+	 *        queued and those currently being processed.
+	 */
+	std::vector<PageId> remainingPages() const;
+
 	void cancelAndRemove(std::set<PageId> const& pages);
 
 	void cancelAndClear();
@@ -69,12 +90,22 @@ private:
 	{
 		PageInfo pageInfo;
 		BackgroundTaskPtr task;
-		bool takenForProcessing;
 
 		Entry(PageInfo const& page_info, BackgroundTaskPtr const& task);
 	};
 
-	std::list<Entry> m_queue;
+	/**
+	 * Tasks not yet handed out, in submission order.  takeForProcessing()
+	 * pops from the front, so it's O(1) regardless of the queue length.
+	 */
+	std::list<Entry> m_readyQueue;
+
+	/**
+	 * Tasks currently being executed.  This list is bounded by the
+	 * number of workers, so linear searches in it are cheap.
+	 */
+	std::list<Entry> m_inFlight;
+
 	PageInfo m_selectedPage;
 	Order m_order;
 };
@@ -0,0 +1,189 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ProcessingTimes.h"
+#include "ProjectWriter.h"
+#include "ProjectReader.h"
+#include <QMutexLocker>
+#include <QDomDocument>
+#include <QDomElement>
+
+ProcessingTimes::ProcessingTimes()
+{
+}
+
+ProcessingTimes::~ProcessingTimes()
+{
+}
+
+ProcessingTimes&
+ProcessingTimes::instance()
+{
+	// Never destroyed, which prevents destruction order problems.
+	static ProcessingTimes* object = new ProcessingTimes;
+	return *object;
+}
+
+void
+ProcessingTimes::setTime(
+	PageId const& page_id, QString const& stage, double const seconds)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_pages[page_id][stage] = seconds;
+}
+
+double
+ProcessingTimes::timeFor(PageId const& page_id, QString const& stage) const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	PageMap::const_iterator const it(m_pages.find(page_id));
+	if (it == m_pages.end()) {
+		return -1;
+	}
+
+	StageTimes::const_iterator const sit(it->second.find(stage));
+	if (sit == it->second.end()) {
+		return -1;
+	}
+
+	return sit->second;
+}
+
+double
+ProcessingTimes::totalTimeFor(PageId const& page_id) const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	PageMap::const_iterator const it(m_pages.find(page_id));
+	if (it == m_pages.end() || it->second.empty()) {
+		return -1;
+	}
+
+	double total = 0;
+	StageTimes::const_iterator sit(it->second.begin());
+	for (; sit != it->second.end(); ++sit) {
+		total += sit->second;
+	}
+
+	return total;
+}
+
+bool
+ProcessingTimes::isEmpty() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_pages.empty();
+}
+
+void
+ProcessingTimes::clear()
+{
+	QMutexLocker const locker(&m_mutex);
+	m_pages.clear();
+}
+
+class ProcessingTimes::PageEnumerator
+{
+public:
+	PageEnumerator(
+		PageMap const& pages, QDomDocument& doc, QDomElement& parent)
+	:	m_rPages(pages), m_rDoc(doc), m_rParent(parent) {}
+
+	void operator()(PageId const& page_id, int const numeric_id) {
+		PageMap::const_iterator const it(m_rPages.find(page_id));
+		if (it == m_rPages.end() || it->second.empty()) {
+			return;
+		}
+
+		QDomElement page_el(m_rDoc.createElement("page"));
+		page_el.setAttribute("id", numeric_id);
+
+		StageTimes::const_iterator sit(it->second.begin());
+		for (; sit != it->second.end(); ++sit) {
+			QDomElement stage_el(m_rDoc.createElement("stage"));
+			stage_el.setAttribute("name", sit->first);
+			stage_el.setAttribute(
+				"seconds", QString::number(sit->second, 'f', 3)
+			);
+			page_el.appendChild(stage_el);
+		}
+
+		m_rParent.appendChild(page_el);
+	}
+private:
+	PageMap const& m_rPages;
+	QDomDocument& m_rDoc;
+	QDomElement& m_rParent;
+};
+
+QDomElement
+ProcessingTimes::toXml(
+	QDomDocument& doc, QString const& name, ProjectWriter const& writer) const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	QDomElement el(doc.createElement(name));
+	writer.enumPages(PageEnumerator(m_pages, doc, el));
+
+	return el;
+}
+
+void
+ProcessingTimes::load(QDomElement const& el, ProjectReader const& reader)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	m_pages.clear();
+
+	QDomNode node(el.firstChild());
+	for (; !node.isNull(); node = node.nextSibling()) {
+		if (!node.isElement() || node.nodeName() != "page") {
+			continue;
+		}
+		QDomElement const page_el(node.toElement());
+
+		bool ok = true;
+		int const numeric_id = page_el.attribute("id").toInt(&ok);
+		if (!ok) {
+			continue;
+		}
+		PageId const page_id(reader.pageId(numeric_id));
+		if (page_id.isNull()) {
+			continue;
+		}
+
+		QDomNode stage_node(page_el.firstChild());
+		for (; !stage_node.isNull(); stage_node = stage_node.nextSibling()) {
+			if (!stage_node.isElement()
+					|| stage_node.nodeName() != "stage") {
+				continue;
+			}
+			QDomElement const stage_el(stage_node.toElement());
+
+			QString const stage(stage_el.attribute("name"));
+			double const seconds =
+				stage_el.attribute("seconds").toDouble(&ok);
+			if (stage.isEmpty() || !ok || seconds < 0) {
+				continue;
+			}
+
+			m_pages[page_id][stage] = seconds;
+		}
+	}
+}
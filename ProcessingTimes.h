@@ -0,0 +1,98 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROCESSING_TIMES_H_
+#define PROCESSING_TIMES_H_
+
+#include "NonCopyable.h"
+#include "PageId.h"
+#include <QString>
+#include <QMutex>
+#include <map>
+
+class ProjectWriter;
+class ProjectReader;
+class QDomDocument;
+class QDomElement;
+
+/**
+ * \brief Per-page, per-stage wall-clock times of the last processing run.
+ *
+ * Persisted in the project file, so a later session can predict how
+ * long reprocessing will take.  Page-count based progress is wildly
+ * wrong when page sizes vary; history per page is not.  The batch
+ * scheduler also uses it to run the longest jobs first, which
+ * minimizes makespan on parallel runs.
+ *
+ * The history is advisory: entries go stale when settings change and
+ * missing entries are normal (new pages, old projects).  Consumers
+ * must always cope with timeFor() returning -1.
+ *
+ * All methods are thread-safe.
+ */
+class ProcessingTimes
+{
+	DECLARE_NON_COPYABLE(ProcessingTimes)
+public:
+	static ProcessingTimes& instance();
+
+	/**
+	 * \brief Records the wall-clock time of a page's last run
+	 *        through a stage, replacing any previous record.
+	 */
+	void setTime(PageId const& page_id, QString const& stage, double seconds);
+
+	/**
+	 * \brief Seconds the page's last run through \p stage took,
+	 *        or -1 if there is no record.
+	 */
+	double timeFor(PageId const& page_id, QString const& stage) const;
+
+	/**
+	 * \brief The sum of the page's recorded stage times,
+	 *        or -1 if there are no records at all.
+	 */
+	double totalTimeFor(PageId const& page_id) const;
+
+	bool isEmpty() const;
+
+	/**
+	 * \brief Drops all records.  To be called when switching projects.
+	 */
+	void clear();
+
+	QDomElement toXml(
+		QDomDocument& doc, QString const& name,
+		ProjectWriter const& writer) const;
+
+	void load(QDomElement const& el, ProjectReader const& reader);
+private:
+	ProcessingTimes();
+
+	~ProcessingTimes();
+
+	class PageEnumerator;
+
+	typedef std::map<QString, double> StageTimes;
+	typedef std::map<PageId, StageTimes> PageMap;
+
+	mutable QMutex m_mutex;
+	PageMap m_pages;
+};
+
+#endif
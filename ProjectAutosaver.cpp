@@ -0,0 +1,192 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ProjectAutosaver.h"
+#include "AutosaveJournal.h"
+#include "ProjectDirtyTracker.h"
+#include "ProjectWriter.h"
+#include "ProjectPages.h"
+#include "OutputFileNameGenerator.h"
+#include "zones/ZoneGeometrySidecar.h"
+#include <QFile>
+#include <QThread>
+#include <memory>
+
+/**
+ * Owns a ProjectWriter snapshot and writes it out in run().  The write
+ * goes to a temporary file that replaces the sidecar only on success,
+ * so a crash mid-write can't destroy the previous autosave.
+ */
+class ProjectAutosaver::WriterThread : public QThread
+{
+public:
+	WriterThread(
+		std::auto_ptr<ProjectWriter> writer,
+		std::vector<FilterPtr> const& filters,
+		QString const& target_path, QObject* parent)
+	:	QThread(parent),
+		m_ptrWriter(writer),
+		m_filters(filters),
+		m_targetPath(target_path),
+		m_succeeded(false)
+	{
+	}
+
+	bool succeeded() const { return m_succeeded; }
+protected:
+	virtual void run() {
+		QString const tmp_path(m_targetPath + ".tmp");
+		if (m_ptrWriter->write(tmp_path, m_filters)) {
+			QString const tmp_sidecar(
+				ZoneGeometrySidecarWriter::sidecarPathFor(tmp_path)
+			);
+			QString const sidecar(
+				ZoneGeometrySidecarWriter::sidecarPathFor(m_targetPath)
+			);
+			QFile::remove(m_targetPath);
+			QFile::remove(sidecar);
+			m_succeeded = QFile::rename(tmp_path, m_targetPath);
+			if (QFile::exists(tmp_sidecar)) {
+				QFile::rename(tmp_sidecar, sidecar);
+			}
+		} else {
+			// A failed write cleans up its own sidecar.
+			QFile::remove(tmp_path);
+		}
+	}
+private:
+	std::auto_ptr<ProjectWriter> m_ptrWriter;
+	std::vector<FilterPtr> m_filters;
+	QString m_targetPath;
+	bool m_succeeded;
+};
+
+
+ProjectAutosaver::ProjectAutosaver(QObject* parent)
+:	QObject(parent),
+	m_pWriter(0),
+	m_cleanGeneration(ProjectDirtyTracker::generation())
+{
+}
+
+ProjectAutosaver::~ProjectAutosaver()
+{
+	if (m_pWriter) {
+		m_pWriter->wait();
+	}
+}
+
+QString
+ProjectAutosaver::autosavePathFor(QString const& project_file)
+{
+	return project_file + ".autosave";
+}
+
+void
+ProjectAutosaver::removeAutosave(QString const& project_file)
+{
+	QString const autosave_path(autosavePathFor(project_file));
+	QFile::remove(autosave_path);
+	QFile::remove(ZoneGeometrySidecarWriter::sidecarPathFor(autosave_path));
+}
+
+void
+ProjectAutosaver::markClean()
+{
+	m_cleanGeneration = ProjectDirtyTracker::generation();
+}
+
+void
+ProjectAutosaver::noteExplicitSave(QString const& project_file)
+{
+	markClean();
+	removeAutosave(project_file);
+
+	// The explicit save captured every journalled edit;
+	// start the journal over on top of the file just written.
+	AutosaveJournal::open(project_file, project_file, false);
+
+	if (m_pWriter) {
+		// A snapshot is being written right now and would re-create
+		// the sidecar we just removed.  Remove it again when it's done.
+		m_pendingRemove = project_file;
+	}
+}
+
+void
+ProjectAutosaver::maybeAutosave(
+	QString const& project_file,
+	IntrusivePtr<ProjectPages> const& pages,
+	SelectedPage const& selected_page,
+	OutputFileNameGenerator const& out_file_name_gen,
+	std::vector<FilterPtr> const& filters)
+{
+	if (project_file.isEmpty()) {
+		return;
+	}
+	if (m_pWriter) {
+		// The previous snapshot is still being written.
+		return;
+	}
+
+	int const generation = ProjectDirtyTracker::generation();
+	if (generation == m_cleanGeneration) {
+		return;
+	}
+	m_pendingRemove = QString();
+	m_projectFile = project_file;
+
+	std::auto_ptr<ProjectWriter> writer(
+		new ProjectWriter(pages, selected_page, out_file_name_gen)
+	);
+	m_pWriter = new WriterThread(
+		writer, filters, autosavePathFor(project_file), this
+	);
+	connect(m_pWriter, SIGNAL(finished()), SLOT(writerFinished()));
+
+	// Assume success.  On failure writerFinished() rolls this back,
+	// so the next tick retries.
+	m_cleanGeneration = generation;
+
+	m_pWriter->start(QThread::LowPriority);
+}
+
+void
+ProjectAutosaver::writerFinished()
+{
+	WriterThread* const writer = m_pWriter;
+	m_pWriter = 0;
+
+	if (!m_pendingRemove.isEmpty()) {
+		// An explicit save happened while this snapshot was being
+		// written, making it obsolete.
+		removeAutosave(m_pendingRemove);
+		m_pendingRemove = QString();
+	} else if (!writer->succeeded()) {
+		// Force a retry on the next tick.
+		m_cleanGeneration = ProjectDirtyTracker::generation() - 1;
+	} else {
+		// The snapshot captured every journalled edit; start the
+		// journal over on top of it.
+		AutosaveJournal::open(
+			m_projectFile, autosavePathFor(m_projectFile), false
+		);
+	}
+
+	writer->deleteLater();
+}
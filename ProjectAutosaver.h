@@ -0,0 +1,98 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROJECTAUTOSAVER_H_
+#define PROJECTAUTOSAVER_H_
+
+#include "IntrusivePtr.h"
+#include "SelectedPage.h"
+#include <QObject>
+#include <QString>
+#include <vector>
+
+class AbstractFilter;
+class ProjectPages;
+class OutputFileNameGenerator;
+
+/**
+ * \brief Periodically snapshots the project to a sidecar file.
+ *
+ * Writing happens on a low priority background thread, so the GUI
+ * doesn't stall no matter how big the project is.  A snapshot is only
+ * taken when ProjectDirtyTracker says something changed since the last
+ * one.  The sidecar lives next to the project file and is removed by a
+ * successful explicit save; if the application dies with unsaved
+ * changes, opening the project offers to recover from the sidecar.
+ */
+class ProjectAutosaver : public QObject
+{
+	Q_OBJECT
+public:
+	typedef IntrusivePtr<AbstractFilter> FilterPtr;
+
+	ProjectAutosaver(QObject* parent = 0);
+
+	~ProjectAutosaver();
+
+	static QString autosavePathFor(QString const& project_file);
+
+	/**
+	 * \brief Declares the current settings state to be saved.
+	 *
+	 * To be called after opening a project.
+	 */
+	void markClean();
+
+	/**
+	 * \brief Records a successful explicit save, which supersedes
+	 *        any autosaved state.
+	 *
+	 * Removes the sidecar file - once any snapshot still being
+	 * written has finished.
+	 */
+	void noteExplicitSave(QString const& project_file);
+
+	/**
+	 * \brief Writes a snapshot of the project, if anything changed.
+	 *
+	 * Does nothing if a previous snapshot is still being written.
+	 * The snapshot of the page sequence is taken on the calling
+	 * thread; serializing the filter settings and writing the file
+	 * happen in the background.
+	 */
+	void maybeAutosave(
+		QString const& project_file,
+		IntrusivePtr<ProjectPages> const& pages,
+		SelectedPage const& selected_page,
+		OutputFileNameGenerator const& out_file_name_gen,
+		std::vector<FilterPtr> const& filters);
+private slots:
+	void writerFinished();
+private:
+	class WriterThread;
+
+	/** Removes the autosave file along with its zone geometry sidecar. */
+	static void removeAutosave(QString const& project_file);
+
+	WriterThread* m_pWriter; /**< Zero when no write is in flight. */
+	QString m_projectFile; /**< Project of the last snapshot taken. */
+	QString m_pendingRemove;
+	int m_cleanGeneration;
+};
+
+#endif
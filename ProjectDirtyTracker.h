@@ -0,0 +1,44 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROJECTDIRTYTRACKER_H_
+#define PROJECTDIRTYTRACKER_H_
+
+/**
+ * \brief Tracks whether any filter settings changed since some reference point.
+ *
+ * Filter Settings objects bump the generation counter from their mutating
+ * methods, possibly from worker threads.  Interested parties (the autosave
+ * machinery, the save-on-close prompt) remember the generation at their
+ * last save and compare it to the current one, so asking "is there
+ * anything to save?" costs nothing regardless of project size.
+ */
+class ProjectDirtyTracker
+{
+public:
+	/**
+	 * \brief Records that some piece of project state was modified.
+	 *
+	 * Thread-safe and cheap enough to call from every settings setter.
+	 */
+	static void noteModified();
+
+	static int generation();
+};
+
+#endif
@@ -22,6 +22,7 @@
 #include "ImageMetadata.h"
 #include "ImageMetadataLoader.h"
 #include "SmartFilenameOrdering.h"
+#include "imageproc/ParallelFor.h"
 #include <QAbstractListModel>
 #include <QSortFilterProxyModel>
 #include <QModelIndex>
@@ -85,8 +86,8 @@ class ProjectFilesDialog::FileList : private QAbstractListModel
 {
 	DECLARE_NON_COPYABLE(FileList)
 public:
-	enum LoadStatus { LOAD_OK, LOAD_FAILED, NO_MORE_FILES };
-	
+	enum { LOAD_BATCH_SIZE = 32 };
+
 	FileList();
 	
 	virtual ~FileList();
@@ -117,8 +118,15 @@ public:
 	void remove(QItemSelection const& selection);
 	
 	void prepareForLoadingFiles();
-	
-	LoadStatus loadNextFile();
+
+	/**
+	 * \brief Loads metadata for up to \p max_files pending files.
+	 *
+	 * Returns the number of files processed, which is zero when
+	 * nothing is left to load.  \p any_failed is set to true if
+	 * any of them failed to load.
+	 */
+	int loadNextFiles(int max_files, bool& any_failed);
 private:
 	virtual int rowCount(QModelIndex const& parent) const;
 	
@@ -614,16 +622,17 @@ ProjectFilesDialog::timerEvent(QTimerEvent* event)
 		return;
 	}
 	
-	switch (m_ptrInProjectFiles->loadNextFile()) {
-		case FileList::NO_MORE_FILES:
-			finishLoadingMetadata();
-			break;
-		case FileList::LOAD_FAILED:
+	bool any_failed = false;
+	int const num_loaded = m_ptrInProjectFiles->loadNextFiles(
+		FileList::LOAD_BATCH_SIZE, any_failed
+	);
+	if (num_loaded == 0) {
+		finishLoadingMetadata();
+	} else {
+		if (any_failed) {
 			m_metadataLoadFailed = true;
-			// Fall through.
-		case FileList::LOAD_OK:
-			progressBar->setValue(progressBar->value() + 1);
-			break;
+		}
+		progressBar->setValue(progressBar->value() + num_loaded);
 	}
 }
 
@@ -778,43 +787,98 @@ ProjectFilesDialog::FileList::prepareForLoadingFiles()
 	m_itemsToLoad.swap(item_indexes);
 }
 
-ProjectFilesDialog::FileList::LoadStatus
-ProjectFilesDialog::FileList::loadNextFile()
+namespace
 {
-	using namespace boost::lambda;
-	
-	if (m_itemsToLoad.empty()) {
-		return NO_MORE_FILES;
+
+/**
+ * \brief Loads metadata for a batch of files from multiple threads.
+ *
+ * Parsing image headers is dominated by I/O latency, especially on
+ * network storage, so doing a batch of files concurrently overlaps
+ * those latencies.
+ */
+class MetadataLoadBatch
+{
+public:
+	struct Result
+	{
+		std::vector<ImageMetadata> perPageMetadata;
+		bool loadedOk;
+
+		Result() : loadedOk(false) {}
+	};
+
+	MetadataLoadBatch(
+		std::vector<QString> const& file_paths,
+		std::vector<Result>& results)
+	:	m_rFilePaths(file_paths),
+		m_rResults(results)
+	{
 	}
-	
-	int const item_idx = m_itemsToLoad.front();
-	Item& item = m_items[item_idx];
-	std::vector<ImageMetadata> per_page_metadata;
-	QString const file_path(item.fileInfo().absoluteFilePath());
-	void (std::vector<ImageMetadata>::*push_back) (const ImageMetadata&) =
-		&std::vector<ImageMetadata>::push_back;
-	ImageMetadataLoader::Status const st = ImageMetadataLoader::load(
-		file_path, boost::lambda::bind(
-			push_back, var(per_page_metadata), _1
-		)
-	);
-	
-	LoadStatus status;
-	
-	if (st == ImageMetadataLoader::LOADED) {
-		status = LOAD_OK;
-		item.perPageMetadata().swap(per_page_metadata);
-		item.setStatus(Item::STATUS_LOAD_OK);
-	} else {
-		status = LOAD_FAILED;
-		item.setStatus(Item::STATUS_LOAD_FAILED);
+
+	void operator()(int const begin, int const end) const {
+		for (int i = begin; i < end; ++i) {
+			Result& result = m_rResults[i];
+			void (std::vector<ImageMetadata>::*push_back) (const ImageMetadata&) =
+				&std::vector<ImageMetadata>::push_back;
+			ImageMetadataLoader::Status const st = ImageMetadataLoader::load(
+				m_rFilePaths[i], boost::lambda::bind(
+					push_back, boost::lambda::var(result.perPageMetadata),
+					boost::lambda::_1
+				)
+			);
+			result.loadedOk = (st == ImageMetadataLoader::LOADED);
+		}
 	}
-	QModelIndex const idx(index(item_idx, 0));
-	emit dataChanged(idx, idx);
-	
-	m_itemsToLoad.pop_front();
-	
-	return status;
+private:
+	std::vector<QString> const& m_rFilePaths;
+	std::vector<Result>& m_rResults;
+};
+
+} // anonymous namespace
+
+int
+ProjectFilesDialog::FileList::loadNextFiles(int const max_files, bool& any_failed)
+{
+	int const num_files = std::min<int>(max_files, m_itemsToLoad.size());
+	if (num_files == 0) {
+		return 0;
+	}
+
+	std::vector<QString> file_paths;
+	file_paths.reserve(num_files);
+	for (int i = 0; i < num_files; ++i) {
+		file_paths.push_back(
+			m_items[m_itemsToLoad[i]].fileInfo().absoluteFilePath()
+		);
+	}
+
+	std::vector<MetadataLoadBatch::Result> results(num_files);
+	MetadataLoadBatch const batch(file_paths, results);
+	imageproc::parallelForRanges(0, num_files, batch);
+
+	int min_item_idx = m_itemsToLoad[0];
+	int max_item_idx = min_item_idx;
+	for (int i = 0; i < num_files; ++i) {
+		int const item_idx = m_itemsToLoad[i];
+		Item& item = m_items[item_idx];
+		if (results[i].loadedOk) {
+			item.perPageMetadata().swap(results[i].perPageMetadata);
+			item.setStatus(Item::STATUS_LOAD_OK);
+		} else {
+			any_failed = true;
+			item.setStatus(Item::STATUS_LOAD_FAILED);
+		}
+		min_item_idx = std::min(min_item_idx, item_idx);
+		max_item_idx = std::max(max_item_idx, item_idx);
+	}
+
+	// A single batched update instead of one per file.
+	emit dataChanged(index(min_item_idx, 0), index(max_item_idx, 0));
+
+	m_itemsToLoad.erase(m_itemsToLoad.begin(), m_itemsToLoad.begin() + num_files);
+
+	return num_files;
 }
 
 
@@ -247,6 +247,29 @@ ProjectPages::autoSetLayoutTypeFor(
 	}
 }
 
+void
+ProjectPages::autoSetLayoutTypesFor(
+	std::vector<std::pair<ImageId, OrthogonalRotation> > const& rotations)
+{
+	bool was_modified = false;
+
+	{
+		QMutexLocker locker(&m_mutex);
+
+		typedef std::pair<ImageId, OrthogonalRotation> RotationForImage;
+		BOOST_FOREACH(RotationForImage const& rotation_for_image, rotations) {
+			autoSetLayoutTypeForImpl(
+				rotation_for_image.first,
+				rotation_for_image.second, &was_modified
+			);
+		}
+	}
+
+	if (was_modified) {
+		emit modified();
+	}
+}
+
 void
 ProjectPages::updateImageMetadata(
 	ImageId const& image_id, ImageMetadata const& metadata)
@@ -303,6 +326,29 @@ ProjectPages::insertImage(
 	}
 }
 
+std::vector<PageInfo>
+ProjectPages::appendImages(
+	std::vector<ImageInfo> const& new_images, PageView const view)
+{
+	std::vector<PageInfo> logical_pages;
+	bool was_modified = false;
+
+	{
+		QMutexLocker locker(&m_mutex);
+
+		m_images.reserve(m_images.size() + new_images.size());
+		BOOST_FOREACH(ImageInfo const& image, new_images) {
+			appendImageImpl(image, view, logical_pages, was_modified);
+		}
+	}
+
+	if (was_modified) {
+		emit modified();
+	}
+
+	return logical_pages;
+}
+
 void
 ProjectPages::removePages(std::set<PageId> const& pages)
 {
@@ -579,6 +625,50 @@ ProjectPages::insertImageImpl(
 	return logical_pages;
 }
 
+void
+ProjectPages::appendImageImpl(
+	ImageInfo const& new_image, PageView const view,
+	std::vector<PageInfo>& logical_pages, bool& modified)
+{
+	ImageDesc image_desc(new_image);
+
+	// Enforce the same rules as insertImageImpl().
+	if (image_desc.numLogicalPages == 2) {
+		image_desc.leftHalfRemoved = false;
+		image_desc.rightHalfRemoved = false;
+	} else if (image_desc.numLogicalPages != 1) {
+		return;
+	} else if (image_desc.leftHalfRemoved && image_desc.rightHalfRemoved) {
+		image_desc.leftHalfRemoved = false;
+		image_desc.rightHalfRemoved = false;
+	}
+
+	m_images.push_back(image_desc);
+	modified = true;
+
+	PageInfo page_info_templ(
+		PageId(new_image.id(), PageId::SINGLE_PAGE),
+		image_desc.metadata, image_desc.numLogicalPages,
+		image_desc.leftHalfRemoved, image_desc.rightHalfRemoved
+	);
+
+	if (view == IMAGE_VIEW || (image_desc.numLogicalPages == 1 &&
+			image_desc.leftHalfRemoved == image_desc.rightHalfRemoved)) {
+		logical_pages.push_back(page_info_templ);
+	} else {
+		if (image_desc.numLogicalPages == 2 ||
+				(image_desc.numLogicalPages == 1 && image_desc.rightHalfRemoved)) {
+			page_info_templ.setId(PageId(new_image.id(), m_subPagesInOrder[0]));
+			logical_pages.push_back(page_info_templ);
+		}
+		if (image_desc.numLogicalPages == 2 ||
+				(image_desc.numLogicalPages == 1 && image_desc.leftHalfRemoved)) {
+			page_info_templ.setId(PageId(new_image.id(), m_subPagesInOrder[1]));
+			logical_pages.push_back(page_info_templ);
+		}
+	}
+}
+
 void
 ProjectPages::removePagesImpl(std::set<PageId> const& to_remove, bool& modified)
 {
@@ -34,6 +34,7 @@
 #include <Qt>
 #include <set>
 #include <vector>
+#include <utility>
 #include <stddef.h>
 
 class ImageFileInfo;
@@ -80,7 +81,16 @@ public:
 	
 	void autoSetLayoutTypeFor(
 		ImageId const& image_id, OrthogonalRotation rotation);
-	
+
+	/**
+	 * \brief A batch version of autoSetLayoutTypeFor().
+	 *
+	 * The modified() signal is emitted at most once for the
+	 * whole batch.
+	 */
+	void autoSetLayoutTypesFor(
+		std::vector<std::pair<ImageId, OrthogonalRotation> > const& rotations);
+
 	void updateImageMetadata(
 		ImageId const& image_id, ImageMetadata const& metadata);
 	
@@ -108,6 +118,22 @@ public:
 	std::vector<PageInfo> insertImage(ImageInfo const& new_image,
 		BeforeOrAfter before_or_after, ImageId const& existing, PageView view);
 
+	/**
+	 * \brief Appends a batch of images to the end of the project.
+	 *
+	 * Equivalent to calling insertImage(image, BEFORE, ImageId(), view)
+	 * for every image, except the lock is taken once and the modified()
+	 * signal is emitted at most once for the whole batch.
+	 *
+	 * \param new_images The images to append, in order.
+	 * \param view This one only affects what is returned.
+	 * \return Logical page descriptors of all the appended images,
+	 *         in order.  Images rejected by the same rules
+	 *         insertImage() enforces contribute nothing.
+	 */
+	std::vector<PageInfo> appendImages(
+		std::vector<ImageInfo> const& new_images, PageView view);
+
 	void removePages(std::set<PageId> const& pages);
 
 	/**
@@ -167,6 +193,10 @@ private:
 		ImageInfo const& new_image, BeforeOrAfter before_or_after,
 		ImageId const& existing, PageView view, bool& modified);
 
+	void appendImageImpl(
+		ImageInfo const& new_image, PageView view,
+		std::vector<PageInfo>& logical_pages, bool& modified);
+
 	void removePagesImpl(std::set<PageId> const& pages, bool& modified);
 
 	PageInfo unremovePageImpl(PageId const& page_id, bool& modified);
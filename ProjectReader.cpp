@@ -19,6 +19,7 @@
 #include "ProjectReader.h"
 #include "ProjectPages.h"
 #include "FileNameDisambiguator.h"
+#include "ProcessingTimes.h"
 #include "AbstractFilter.h"
 #include "XmlUnmarshaller.h"
 #include "Dpi.h"
@@ -76,6 +77,13 @@ ProjectReader::ProjectReader(QDomDocument const& doc)
 			disambig_el, boost::bind(&ProjectReader::expandFilePath, this, _1)
 		)
 	);
+
+	// Processing time history of the previous session.  Loading
+	// replaces whatever an earlier project left behind, so a project
+	// without the element starts with no history.
+	ProcessingTimes::instance().load(
+		project_el.namedItem("processing-times").toElement(), *this
+	);
 }
 
 ProjectReader::~ProjectReader()
@@ -0,0 +1,91 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2009  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ProjectSessions.h"
+#ifndef Q_MOC_RUN
+#include <boost/foreach.hpp>
+#endif
+#include <QSettings>
+
+void
+ProjectSessions::read()
+{
+	QSettings settings;
+	std::list<Session> new_list;
+
+	int const size = settings.beginReadArray("project/sessions");
+	for (int i = 0; i < size; ++i) {
+		settings.setArrayIndex(i);
+		Session session;
+		session.path = settings.value("path").toString();
+		session.filterIdx = settings.value("filter").toInt();
+		session.thumbScrollPos = settings.value("thumbScrollPos").toInt();
+		new_list.push_back(session);
+	}
+	settings.endArray();
+
+	m_sessions.swap(new_list);
+}
+
+void
+ProjectSessions::write(int const max_items) const
+{
+	QSettings settings;
+	settings.beginWriteArray("project/sessions");
+	int idx = 0;
+	BOOST_FOREACH(Session const& session, m_sessions) {
+		if (idx >= max_items) {
+			break;
+		}
+		settings.setArrayIndex(idx);
+		settings.setValue("path", session.path);
+		settings.setValue("filter", session.filterIdx);
+		settings.setValue("thumbScrollPos", session.thumbScrollPos);
+		++idx;
+	}
+	settings.endArray();
+}
+
+bool
+ProjectSessions::find(QString const& path, Session& session) const
+{
+	BOOST_FOREACH(Session const& candidate, m_sessions) {
+		if (candidate.path == path) {
+			session = candidate;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+ProjectSessions::update(Session const& session)
+{
+	std::list<Session>::iterator it(m_sessions.begin());
+	std::list<Session>::iterator const end(m_sessions.end());
+	for (; it != end; ++it) {
+		if (it->path == session.path) {
+			break;
+		}
+	}
+	if (it != end) {
+		m_sessions.erase(it);
+	}
+	m_sessions.push_front(session);
+}
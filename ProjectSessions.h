@@ -0,0 +1,75 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2007-2009  Joseph Artsimovich <joseph_a@mail.ru>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROJECT_SESSIONS_H_
+#define PROJECT_SESSIONS_H_
+
+#include <QString>
+#include <list>
+
+/**
+ * \brief Per-project UI state that outlives the application.
+ *
+ * The project file itself records the processing state, including the
+ * selected page, but not where in the UI the user was working.  This
+ * class keeps a small list of recently worked-on projects in QSettings,
+ * remembering for each one the filter tab and the thumbnail list scroll
+ * position, so that reopening a project puts the user right back where
+ * they left off.
+ */
+class ProjectSessions
+{
+public:
+	/**
+	 * \brief The default value for the max_items parameter of write().
+	 */
+	enum { DEFAULT_MAX_ITEMS = 20 };
+
+	struct Session
+	{
+		QString path; /**< Absolute path of the project file. */
+		int filterIdx; /**< The selected row in the filter list. */
+		int thumbScrollPos; /**< Thumbnail view vertical scrollbar value. */
+
+		Session() : filterIdx(0), thumbScrollPos(0) {}
+	};
+
+	/**
+	 * \brief Reads the list of sessions from QSettings.
+	 *
+	 * The current list will be overwritten.
+	 */
+	void read();
+
+	/**
+	 * \brief Returns the session recorded for a project file, if any.
+	 */
+	bool find(QString const& path, Session& session) const;
+
+	/**
+	 * \brief Records a session, replacing a previous one for the
+	 *        same project file and moving it to the top of the list.
+	 */
+	void update(Session const& session);
+
+	void write(int max_items = DEFAULT_MAX_ITEMS) const;
+private:
+	std::list<Session> m_sessions;
+};
+
+#endif
@@ -25,10 +25,12 @@
 #include "ImageMetadata.h"
 #include "AbstractFilter.h"
 #include "FileNameDisambiguator.h"
+#include "ProcessingTimes.h"
+#include "zones/ZoneGeometrySidecar.h"
 #include "compat/boost_multi_index_foreach_fix.h"
 #include <QtXml>
+#include <QXmlStreamWriter>
 #include <QFile>
-#include <QTextStream>
 #include <QFileInfo>
 #ifndef Q_MOC_RUN
 #include <boost/bind.hpp>
@@ -83,123 +85,157 @@ ProjectWriter::~ProjectWriter()
 bool
 ProjectWriter::write(QString const& file_path, std::vector<FilterPtr> const& filters) const
 {
-	QDomDocument doc;
-	QDomElement root_el(doc.createElement("project"));
-	doc.appendChild(root_el);
-	root_el.setAttribute("outputDirectory", m_outFileNameGen.outDir());
-	root_el.setAttribute(
+	QFile file(file_path);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+
+	// Zone vertices go to a binary sidecar file.  Splines serialized
+	// while this writer is installed only store a record number in
+	// the XML.  If the sidecar can't be written, splines fall back
+	// to inline points and no sidecar file is left behind.
+	ZoneGeometrySidecarWriter sidecar(
+		ZoneGeometrySidecarWriter::sidecarPathFor(file_path)
+	);
+
+	// Building the whole project as a QDomDocument and then serializing
+	// it means keeping every DOM node of a potentially huge project in
+	// memory at once.  Instead we stream elements out as we enumerate
+	// them.  Filters still produce DOM subtrees, but only one filter's
+	// subtree is alive at any given time.
+	QXmlStreamWriter writer(&file);
+	writer.setAutoFormatting(true);
+	writer.setAutoFormattingIndent(2);
+	writer.writeStartDocument();
+
+	writer.writeStartElement("project");
+	writer.writeAttribute("outputDirectory", m_outFileNameGen.outDir());
+	writer.writeAttribute(
 		"layoutDirection",
 		m_layoutDirection == Qt::LeftToRight ? "LTR" : "RTL"
 	);
-	
-	root_el.appendChild(processDirectories(doc));
-	root_el.appendChild(processFiles(doc));
-	root_el.appendChild(processImages(doc));
-	root_el.appendChild(processPages(doc));
-	root_el.appendChild(
-		m_outFileNameGen.disambiguator()->toXml(
-			doc, "file-name-disambiguation",
-			boost::bind(&ProjectWriter::packFilePath, this, _1)
-		)
-	);
-	
-	QDomElement filters_el(doc.createElement("filters"));
-	root_el.appendChild(filters_el);
+
+	writeDirectories(writer);
+	writeFiles(writer);
+	writeImages(writer);
+	writePages(writer);
+
+	{
+		QDomDocument doc;
+		writeDomElement(
+			writer, m_outFileNameGen.disambiguator()->toXml(
+				doc, "file-name-disambiguation",
+				boost::bind(&ProjectWriter::packFilePath, this, _1)
+			)
+		);
+	}
+
+	if (!ProcessingTimes::instance().isEmpty()) {
+		QDomDocument doc;
+		writeDomElement(
+			writer, ProcessingTimes::instance().toXml(
+				doc, "processing-times", *this
+			)
+		);
+	}
+
+	writer.writeStartElement("filters");
 	std::vector<FilterPtr>::const_iterator it(filters.begin());
 	std::vector<FilterPtr>::const_iterator const end(filters.end());
 	for (; it != end; ++it) {
-		filters_el.appendChild((*it)->saveSettings(*this, doc));
+		QDomDocument doc;
+		writeDomElement(writer, (*it)->saveSettings(*this, doc));
 	}
-	
-	QFile file(file_path);
-	if (file.open(QIODevice::WriteOnly)) {
-		QTextStream strm(&file);
-		doc.save(strm, 2);
-		return true;
-	}
-	
-	return false;
+	writer.writeEndElement(); // filters
+
+	writer.writeEndElement(); // project
+	writer.writeEndDocument();
+
+	// A sidecar error after records were already referenced from the
+	// XML means those splines lost their geometry - report failure so
+	// the caller doesn't take this file for a good copy.
+	return file.error() == QFile::NoError && !sidecar.error();
 }
 
-QDomElement
-ProjectWriter::processDirectories(QDomDocument& doc) const
+void
+ProjectWriter::writeDirectories(QXmlStreamWriter& writer) const
 {
-	QDomElement dirs_el(doc.createElement("directories"));
-	
+	writer.writeStartElement("directories");
+
 	BOOST_FOREACH(Directory const& dir, m_dirs.get<Sequenced>()) {
-		QDomElement dir_el(doc.createElement("directory"));
-		dir_el.setAttribute("id", dir.numericId);
-		dir_el.setAttribute("path", dir.path);
-		dirs_el.appendChild(dir_el);
+		writer.writeStartElement("directory");
+		writer.writeAttribute("id", QString::number(dir.numericId));
+		writer.writeAttribute("path", dir.path);
+		writer.writeEndElement();
 	}
-	
-	return dirs_el;
+
+	writer.writeEndElement();
 }
 
-QDomElement
-ProjectWriter::processFiles(QDomDocument& doc) const
+void
+ProjectWriter::writeFiles(QXmlStreamWriter& writer) const
 {
-	QDomElement files_el(doc.createElement("files"));
-	
+	writer.writeStartElement("files");
+
 	BOOST_FOREACH(File const& file, m_files.get<Sequenced>()) {
 		QFileInfo const file_info(file.path);
 		QString const& dir_path = file_info.absolutePath();
-		QDomElement file_el(doc.createElement("file"));
-		file_el.setAttribute("id", file.numericId);
-		file_el.setAttribute("dirId", dirId(dir_path));
-		file_el.setAttribute("name", file_info.fileName());
-		files_el.appendChild(file_el);
+		writer.writeStartElement("file");
+		writer.writeAttribute("id", QString::number(file.numericId));
+		writer.writeAttribute("dirId", QString::number(dirId(dir_path)));
+		writer.writeAttribute("name", file_info.fileName());
+		writer.writeEndElement();
 	}
-	
-	return files_el;
+
+	writer.writeEndElement();
 }
 
-QDomElement
-ProjectWriter::processImages(QDomDocument& doc) const
+void
+ProjectWriter::writeImages(QXmlStreamWriter& writer) const
 {
-	QDomElement images_el(doc.createElement("images"));
-	
+	writer.writeStartElement("images");
+
 	BOOST_FOREACH(Image const& image, m_images.get<Sequenced>()) {
-		QDomElement image_el(doc.createElement("image"));
-		image_el.setAttribute("id", image.numericId);
-		image_el.setAttribute("subPages", image.numSubPages);
-		image_el.setAttribute("fileId", fileId(image.id.filePath()));
-		image_el.setAttribute("fileImage", image.id.page());
+		writer.writeStartElement("image");
+		writer.writeAttribute("id", QString::number(image.numericId));
+		writer.writeAttribute("subPages", QString::number(image.numSubPages));
+		writer.writeAttribute("fileId", QString::number(fileId(image.id.filePath())));
+		writer.writeAttribute("fileImage", QString::number(image.id.page()));
 		if (image.leftHalfRemoved != image.rightHalfRemoved) {
 			// Both are not supposed to be removed.
-			image_el.setAttribute("removed", image.leftHalfRemoved ? "L" : "R");
+			writer.writeAttribute("removed", image.leftHalfRemoved ? "L" : "R");
 		}
-		writeImageMetadata(doc, image_el, image.id);
-		images_el.appendChild(image_el);
+		writeImageMetadata(writer, image.id);
+		writer.writeEndElement();
 	}
-	
-	return images_el;
+
+	writer.writeEndElement();
 }
 
 void
 ProjectWriter::writeImageMetadata(
-	QDomDocument& doc, QDomElement& image_el, ImageId const& image_id) const
+	QXmlStreamWriter& writer, ImageId const& image_id) const
 {
 	MetadataByImage::const_iterator it(m_metadataByImage.find(image_id));
 	assert(it != m_metadataByImage.end());
 	ImageMetadata const& metadata = it->second;
-	
-	QDomElement size_el(doc.createElement("size"));
-	size_el.setAttribute("width", metadata.size().width());
-	size_el.setAttribute("height", metadata.size().height());
-	image_el.appendChild(size_el);
-	
-	QDomElement dpi_el(doc.createElement("dpi"));
-	dpi_el.setAttribute("horizontal", metadata.dpi().horizontal());
-	dpi_el.setAttribute("vertical", metadata.dpi().vertical());
-	image_el.appendChild(dpi_el);
+
+	writer.writeStartElement("size");
+	writer.writeAttribute("width", QString::number(metadata.size().width()));
+	writer.writeAttribute("height", QString::number(metadata.size().height()));
+	writer.writeEndElement();
+
+	writer.writeStartElement("dpi");
+	writer.writeAttribute("horizontal", QString::number(metadata.dpi().horizontal()));
+	writer.writeAttribute("vertical", QString::number(metadata.dpi().vertical()));
+	writer.writeEndElement();
 }
 
-QDomElement
-ProjectWriter::processPages(QDomDocument& doc) const
+void
+ProjectWriter::writePages(QXmlStreamWriter& writer) const
 {
-	QDomElement pages_el(doc.createElement("pages"));
-	
+	writer.writeStartElement("pages");
+
 	PageId const sel_opt_1(m_selectedPage.get(IMAGE_VIEW));
 	PageId const sel_opt_2(m_selectedPage.get(PAGE_VIEW));
 
@@ -207,17 +243,43 @@ ProjectWriter::processPages(QDomDocument& doc) const
 	for (size_t i = 0; i < num_pages; ++i) {
 		PageInfo const& page = m_pageSequence.pageAt(i);
 		PageId const& page_id = page.id();
-		QDomElement page_el(doc.createElement("page"));
-		page_el.setAttribute("id", pageId(page_id));
-		page_el.setAttribute("imageId", imageId(page_id.imageId()));
-		page_el.setAttribute("subPage", page_id.subPageAsString());
+		writer.writeStartElement("page");
+		writer.writeAttribute("id", QString::number(pageId(page_id)));
+		writer.writeAttribute("imageId", QString::number(imageId(page_id.imageId())));
+		writer.writeAttribute("subPage", page_id.subPageAsString());
 		if (page_id == sel_opt_1 || page_id == sel_opt_2) {
-			page_el.setAttribute("selected", "selected");
+			writer.writeAttribute("selected", "selected");
+		}
+		writer.writeEndElement();
+	}
+
+	writer.writeEndElement();
+}
+
+void
+ProjectWriter::writeDomElement(QXmlStreamWriter& writer, QDomElement const& el)
+{
+	writer.writeStartElement(el.tagName());
+
+	QDomNamedNodeMap const attrs(el.attributes());
+	int const num_attrs = attrs.count();
+	for (int i = 0; i < num_attrs; ++i) {
+		QDomAttr const attr(attrs.item(i).toAttr());
+		writer.writeAttribute(attr.name(), attr.value());
+	}
+
+	for (QDomNode child = el.firstChild();
+			!child.isNull(); child = child.nextSibling()) {
+		if (child.isElement()) {
+			writeDomElement(writer, child.toElement());
+		} else if (child.isCDATASection()) {
+			writer.writeCDATA(child.toCDATASection().data());
+		} else if (child.isText()) {
+			writer.writeCharacters(child.toText().data());
 		}
-		pages_el.appendChild(page_el);
 	}
-	
-	return pages_el;
+
+	writer.writeEndElement();
 }
 
 int
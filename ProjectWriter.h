@@ -42,6 +42,7 @@ class ProjectPages;
 class PageInfo;
 class QDomDocument;
 class QDomElement;
+class QXmlStreamWriter;
 
 class ProjectWriter
 {
@@ -152,17 +153,18 @@ private:
 		>
 	> Pages;
 	
-	QDomElement processDirectories(QDomDocument& doc) const;
-	
-	QDomElement processFiles(QDomDocument& doc) const;
-	
-	QDomElement processImages(QDomDocument& doc) const;
-	
-	QDomElement processPages(QDomDocument& doc) const;
-	
+	void writeDirectories(QXmlStreamWriter& writer) const;
+
+	void writeFiles(QXmlStreamWriter& writer) const;
+
+	void writeImages(QXmlStreamWriter& writer) const;
+
+	void writePages(QXmlStreamWriter& writer) const;
+
 	void writeImageMetadata(
-		QDomDocument& doc, QDomElement& image_el,
-		ImageId const& image_id) const;
+		QXmlStreamWriter& writer, ImageId const& image_id) const;
+
+	static void writeDomElement(QXmlStreamWriter& writer, QDomElement const& el);
 	
 	int dirId(QString const& dir_path) const;
 	
@@ -23,6 +23,8 @@
 #include <QDir>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QSet>
+#include <QStringList>
 #include <QWaitCondition>
 #include <QCoreApplication>
 #include <QColor>
@@ -57,13 +59,13 @@ private:
 };
 
 
-class RelinkingModel::StatusUpdateThread : private QThread
+class RelinkingModel::StatusUpdatePool
 {
 public:
-	StatusUpdateThread(RelinkingModel* owner);
+	StatusUpdatePool(RelinkingModel* owner);
 
-	/** This will signal the thread to stop and wait for it to happen. */
-	virtual ~StatusUpdateThread();
+	/** This will signal the workers to stop and wait for that to happen. */
+	~StatusUpdatePool();
 
 	/**
 	 * Requests are served from last to first.
@@ -72,6 +74,16 @@ public:
 	 */
 	void requestStatusUpdate(QString const& path, int row);
 private:
+	class Worker : public QThread
+	{
+	public:
+		Worker(StatusUpdatePool* pool) : m_pPool(pool) {}
+	protected:
+		virtual void run() { m_pPool->workerLoop(); }
+	private:
+		StatusUpdatePool* const m_pPool;
+	};
+
 	struct Task
 	{
 		QString path;
@@ -80,6 +92,20 @@ private:
 		Task(QString const& p, int r) : path(p), row(r) {}
 	};
 
+	/**
+	 * Information about a directory, gathered by a single listing.
+	 * Answering existence queries from here means one round trip per
+	 * directory rather than one per file, which is what makes the
+	 * difference on network shares.
+	 */
+	struct DirInfo
+	{
+		bool exists;
+		QSet<QString> entries; /**< Empty when !exists. */
+
+		DirInfo() : exists(false) {}
+	};
+
 	class OrderedByPathTag;
 	class OrderedByPriorityTag;
 
@@ -99,15 +125,33 @@ private:
 	typedef TaskList::index<OrderedByPathTag>::type TasksByPath;
 	typedef TaskList::index<OrderedByPriorityTag>::type TasksByPriority;
 
-	virtual void run();
+	/** Existence checks are I/O rather than CPU bound, so the pool
+	    size is not tied to the number of cores. */
+	enum { NUM_WORKERS = 8 };
+
+	/** How many responses to accumulate before posting them to the
+	    GUI thread.  The queue is also flushed when it runs dry. */
+	enum { RESPONSE_BATCH_SIZE = 32 };
+
+	void workerLoop();
+
+	/** To be called with the mutex held.  Unlocks while hitting the disk. */
+	Status statusOf(QString const& path);
+
+	/** To be called with the mutex held. */
+	void flushResponses();
 
 	RelinkingModel* m_pOwner;
 	TaskList m_tasks;
 	TasksByPath& m_rTasksByPath;
 	TasksByPriority& m_rTasksByPriority;
-	QString m_pathBeingProcessed;
+	std::vector<Worker*> m_workers;
+	std::set<QString> m_pathsInProgress;
+	std::map<QString, DirInfo> m_dirCache;
+	std::vector<StatusUpdateResponse> m_pendingResponses;
 	QMutex m_mutex;
 	QWaitCondition m_cond;
+	bool m_started;
 	bool m_exiting;
 };
 
@@ -118,7 +162,7 @@ RelinkingModel::RelinkingModel()
 :	m_fileIcon(":/icons/file-16.png")
 ,	m_folderIcon(":/icons/folder-16.png")
 ,	m_ptrRelinker(new Relinker)
-,	m_ptrStatusUpdateThread(new StatusUpdateThread(this))
+,	m_ptrStatusUpdatePool(new StatusUpdatePool(this))
 ,	m_haveUncommittedChanges(true)
 {
 }
@@ -338,46 +382,85 @@ RelinkingModel::requestStatusUpdate(QModelIndex const& index)
 	Item& item = m_items[index.row()];
 	item.uncommittedStatus = StatusUpdatePending;
 
-	m_ptrStatusUpdateThread->requestStatusUpdate(item.uncommittedPath, index.row());
+	m_ptrStatusUpdatePool->requestStatusUpdate(item.uncommittedPath, index.row());
 }
 
 void
 RelinkingModel::customEvent(QEvent* event)
 {
-	typedef PayloadEvent<StatusUpdateResponse> ResponseEvent;
+	typedef PayloadEvent<std::vector<StatusUpdateResponse> > ResponseEvent;
 	ResponseEvent* evt = dynamic_cast<ResponseEvent*>(event);
 	assert(evt);
 
-	StatusUpdateResponse const& response = evt->payload();
-	if (response.row() < 0 || response.row() >= int(m_items.size())) {
-		return;
-	}
+	// Responses arrive in batches.  Apply them all, then repaint the
+	// affected rows with a single dataChanged() covering their span.
+	int first_modified_row = -1;
+	int last_modified_row = -1;
 
-	Item& item = m_items[response.row()];
-	if (item.uncommittedPath == response.path()) {
-		item.uncommittedStatus = response.status();
-	}
-	if (item.committedPath == response.path()) {
-		item.committedStatus = response.status();
+	BOOST_FOREACH(StatusUpdateResponse const& response, evt->payload()) {
+		if (response.row() < 0 || response.row() >= int(m_items.size())) {
+			continue;
+		}
+
+		Item& item = m_items[response.row()];
+		bool modified = false;
+		if (item.uncommittedPath == response.path()) {
+			item.uncommittedStatus = response.status();
+			modified = true;
+		}
+		if (item.committedPath == response.path()) {
+			item.committedStatus = response.status();
+			modified = true;
+		}
+
+		if (modified) {
+			if (first_modified_row == -1 || response.row() < first_modified_row) {
+				first_modified_row = response.row();
+			}
+			if (response.row() > last_modified_row) {
+				last_modified_row = response.row();
+			}
+		}
 	}
 
-	emit dataChanged(index(response.row()), index(response.row()));
+	if (first_modified_row != -1) {
+		emit dataChanged(index(first_modified_row), index(last_modified_row));
+	}
 }
 
 
-/*========================== StatusUpdateThread =========================*/
+/*=========================== StatusUpdatePool ==========================*/
+
+namespace
+{
+
+class MutexUnlocker
+{
+public:
+	MutexUnlocker(QMutex* mutex) : m_pMutex(mutex) { mutex->unlock(); }
+
+	~MutexUnlocker() { m_pMutex->lock(); }
+private:
+	QMutex* const m_pMutex;
+};
+
+} // anonymous namespace
 
-RelinkingModel::StatusUpdateThread::StatusUpdateThread(RelinkingModel* owner)
-:	QThread(owner)
-,	m_pOwner(owner)
+RelinkingModel::StatusUpdatePool::StatusUpdatePool(RelinkingModel* owner)
+:	m_pOwner(owner)
 ,	m_tasks()
 ,	m_rTasksByPath(m_tasks.get<OrderedByPathTag>())
 ,	m_rTasksByPriority(m_tasks.get<OrderedByPriorityTag>())
+,	m_started(false)
 ,	m_exiting(false)
 {
+	m_workers.reserve(NUM_WORKERS);
+	for (int i = 0; i < NUM_WORKERS; ++i) {
+		m_workers.push_back(new Worker(this));
+	}
 }
 
-RelinkingModel::StatusUpdateThread::~StatusUpdateThread()
+RelinkingModel::StatusUpdatePool::~StatusUpdatePool()
 {
 	{
 		QMutexLocker locker(&m_mutex);
@@ -385,18 +468,23 @@ RelinkingModel::StatusUpdateThread::~StatusUpdateThread()
 	}
 
 	m_cond.wakeAll();
-	wait();
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		// Waiting for a thread that was never started returns
+		// immediately.
+		m_workers[i]->wait();
+		delete m_workers[i];
+	}
 }
 
 void
-RelinkingModel::StatusUpdateThread::requestStatusUpdate(QString const& path, int row)
+RelinkingModel::StatusUpdatePool::requestStatusUpdate(QString const& path, int row)
 {
 	QMutexLocker const locker(&m_mutex);
 	if (m_exiting) {
 		return;
 	}
 
-	if (path == m_pathBeingProcessed) {
+	if (m_pathsInProgress.find(path) != m_pathsInProgress.end()) {
 		// This task is currently in progress.
 		return;
 	}
@@ -410,33 +498,26 @@ RelinkingModel::StatusUpdateThread::requestStatusUpdate(QString const& path, int
 		m_rTasksByPriority.end(), m_tasks.project<OrderedByPriorityTag>(ins.first)
 	);
 
-	if (!isRunning()) {
-		start();
+	if (!m_started) {
+		m_started = true;
+		for (size_t i = 0; i < m_workers.size(); ++i) {
+			m_workers[i]->start();
+		}
 	}
 
 	m_cond.wakeOne();
 }
 
 void
-RelinkingModel::StatusUpdateThread::run()
+RelinkingModel::StatusUpdatePool::workerLoop()
 try {
 	QMutexLocker const locker(&m_mutex);
 
-	class MutexUnlocker
-	{
-	public:
-		MutexUnlocker(QMutex* mutex) : m_pMutex(mutex) { mutex->unlock(); }
-
-		~MutexUnlocker() { m_pMutex->lock(); }
-	private:
-		QMutex* const m_pMutex;
-	};
-
 	for (;;) {
 		if (m_exiting) {
 			break;
 		}
-		
+
 		if (m_tasks.empty()) {
 			m_cond.wait(&m_mutex);
 		}
@@ -444,23 +525,90 @@ try {
 		if (m_tasks.empty()) {
 			continue;
 		}
-		
+
 		Task const task(m_rTasksByPriority.front());
-		m_pathBeingProcessed = task.path;
 		m_rTasksByPriority.pop_front();
+		m_pathsInProgress.insert(task.path);
+
+		Status const status = statusOf(task.path);
+
+		m_pathsInProgress.erase(task.path);
+		m_pendingResponses.push_back(
+			StatusUpdateResponse(task.path, task.row, status)
+		);
 
+		// Flush when the batch is full or when the queue runs dry.
+		// Workers that are still busy will flush their own response
+		// the same way, so nothing gets stranded.
+		if (int(m_pendingResponses.size()) >= RESPONSE_BATCH_SIZE
+				|| m_tasks.empty()) {
+			flushResponses();
+		}
+	}
+} catch (std::bad_alloc const&) {
+	OutOfMemoryHandler::instance().handleOutOfMemorySituation();
+}
+
+RelinkingModel::Status
+RelinkingModel::StatusUpdatePool::statusOf(QString const& path)
+{
+	int const slash = path.lastIndexOf(QChar('/'));
+	if (slash <= 0 || path[slash - 1] == QChar(':')) {
+		// A root or a relative path - no parent directory to consult.
+		MutexUnlocker const unlocker(&m_mutex);
+		return QFile::exists(path) ? Exists : Missing;
+	}
+
+	QString const dir(path.left(slash));
+	QString name(path.mid(slash + 1));
+#if defined(Q_OS_WIN)
+	// The file system compares names case-insensitively there.
+	name = name.toLower();
+#endif
+
+	std::map<QString, DirInfo>::iterator it(m_dirCache.find(dir));
+	if (it == m_dirCache.end()) {
+		DirInfo info;
 		{
 			MutexUnlocker const unlocker(&m_mutex);
 
-			bool const exists = QFile::exists(task.path);
-			StatusUpdateResponse const response(task.path, task.row, exists ? Exists : Missing);
-			QCoreApplication::postEvent(m_pOwner, new PayloadEvent<StatusUpdateResponse>(response));
+			QDir const d(dir);
+			info.exists = d.exists();
+			if (info.exists) {
+				QStringList const entries(
+					d.entryList(QDir::AllEntries|QDir::Hidden|QDir::System)
+				);
+				for (int i = 0; i < entries.size(); ++i) {
+#if defined(Q_OS_WIN)
+					info.entries.insert(entries[i].toLower());
+#else
+					info.entries.insert(entries[i]);
+#endif
+				}
+			}
 		}
 
-		m_pathBeingProcessed.clear();
+		// Another worker may have cached this directory while we
+		// weren't holding the mutex.  Keeping its version is fine.
+		it = m_dirCache.insert(std::make_pair(dir, info)).first;
 	}
-} catch (std::bad_alloc const&) {
-	OutOfMemoryHandler::instance().handleOutOfMemorySituation();
+
+	DirInfo const& info = it->second;
+	return info.exists && info.entries.contains(name) ? Exists : Missing;
+}
+
+void
+RelinkingModel::StatusUpdatePool::flushResponses()
+{
+	if (m_pendingResponses.empty()) {
+		return;
+	}
+
+	std::vector<StatusUpdateResponse> batch;
+	batch.swap(m_pendingResponses);
+	QCoreApplication::postEvent(
+		m_pOwner, new PayloadEvent<std::vector<StatusUpdateResponse> >(batch)
+	);
 }
 
 
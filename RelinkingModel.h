@@ -88,7 +88,7 @@ public:
 protected:
 	virtual void customEvent(QEvent* event);
 private:
-	class StatusUpdateThread;
+	class StatusUpdatePool;
 	class StatusUpdateResponse;
 
 	/** Stands for File System Object (file or directory). */
@@ -124,7 +124,7 @@ private:
 	std::vector<Item> m_items;
 	std::set<QString> m_origPathSet;
 	IntrusivePtr<Relinker> const m_ptrRelinker;
-	std::auto_ptr<StatusUpdateThread> m_ptrStatusUpdateThread;
+	std::auto_ptr<StatusUpdatePool> m_ptrStatusUpdatePool;
 	bool m_haveUncommittedChanges;
 };
 
@@ -19,6 +19,7 @@
 #include "SettingsDialog.h"
 #include "SettingsDialog.h.moc"
 #include "OpenGLSupport.h"
+#include "imageproc/AcceleratedOps.h"
 #include "config.h"
 #include <QSettings>
 #include <QVariant>
@@ -46,6 +47,17 @@ SettingsDialog::SettingsDialog(QWidget* parent)
 	}
 #endif
 
+	if (imageproc::AcceleratedOps* const accel = imageproc::acceleratedOps()) {
+		ui.useGpuAcceleration->setToolTip(accel->name());
+		ui.useGpuAcceleration->setChecked(
+			settings.value("settings/gpu_acceleration", true).toBool()
+		);
+	} else {
+		ui.useGpuAcceleration->setChecked(false);
+		ui.useGpuAcceleration->setEnabled(false);
+		ui.useGpuAcceleration->setToolTip(tr("This build has no GPU compute backend."));
+	}
+
 	connect(ui.buttonBox, SIGNAL(accepted()), SLOT(commitChanges()));
 }
 
@@ -60,4 +72,13 @@ SettingsDialog::commitChanges()
 #ifdef ENABLE_OPENGL
 	settings.setValue("settings/use_3d_acceleration", ui.use3DAcceleration->isChecked());
 #endif
+	if (imageproc::acceleratedOps()) {
+		bool const use_gpu = ui.useGpuAcceleration->isChecked();
+		settings.setValue("settings/gpu_acceleration", use_gpu);
+		if (!use_gpu) {
+			// Takes effect immediately; re-enabling requires
+			// a restart, as the backend object is gone.
+			imageproc::setAcceleratedOps(0);
+		}
+	}
 }
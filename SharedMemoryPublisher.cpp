@@ -0,0 +1,116 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SharedMemoryPublisher.h"
+#include <QImage>
+#include <QByteArray>
+#include <QMutexLocker>
+#include <QDebug>
+#include <string.h>
+
+SharedMemoryPublisher&
+SharedMemoryPublisher::instance()
+{
+	static SharedMemoryPublisher obj;
+	return obj;
+}
+
+void
+SharedMemoryPublisher::publish(QString const& name, QImage const& image)
+{
+	if (m_key.isEmpty() || image.isNull()) {
+		return;
+	}
+
+	QByteArray const name_utf8(name.toUtf8());
+	size_t const data_offset = sizeof(Header) + name_utf8.size();
+	size_t const data_size = image.bytesPerLine() * (size_t)image.height();
+	size_t const total_size = data_offset + data_size;
+
+	QMutexLocker const locker(&m_mutex);
+
+	if (!ensureSegment(total_size)) {
+		return;
+	}
+	if (!m_segment.lock()) {
+		return;
+	}
+
+	Header* header = (Header*)m_segment.data();
+	header->magic = MAGIC;
+	header->version = VERSION;
+	header->segmentSize = m_segment.size();
+	header->width = image.width();
+	header->height = image.height();
+	header->format = image.format();
+	header->bytesPerLine = image.bytesPerLine();
+	header->dotsPerMeterX = image.dotsPerMeterX();
+	header->dotsPerMeterY = image.dotsPerMeterY();
+	header->nameBytes = name_utf8.size();
+	header->dataOffset = data_offset;
+
+	char* const base = (char*)m_segment.data();
+	memcpy(base + sizeof(Header), name_utf8.constData(), name_utf8.size());
+	memcpy(base + data_offset, image.bits(), data_size);
+
+	// The sequence bump is what makes the frame visible, so it goes last.
+	header->sequence = ++m_sequence;
+
+	m_segment.unlock();
+}
+
+bool
+SharedMemoryPublisher::ensureSegment(size_t size)
+{
+	if (m_segment.isAttached() && (size_t)m_segment.size() >= size) {
+		return true;
+	}
+
+	if (m_segment.isAttached()) {
+		m_segment.detach();
+	}
+
+	// Round up so that a run of similarly sized pages doesn't keep
+	// recreating the segment for every few extra scanlines.
+	size_t const rounded_size = (size + 0xfffff) & ~(size_t)0xfffff;
+
+	m_segment.setKey(m_key);
+	if (m_segment.create(rounded_size)) {
+		return true;
+	}
+
+	if (m_segment.error() == QSharedMemory::AlreadyExists) {
+		// A stale segment from a crashed run.  On Unix, attaching and
+		// detaching the last handle destroys it, letting us recreate
+		// it at the size we need.
+		if (m_segment.attach()) {
+			if ((size_t)m_segment.size() >= size) {
+				return true;
+			}
+			m_segment.detach();
+		}
+		if (m_segment.create(rounded_size)) {
+			return true;
+		}
+	}
+
+	qDebug() << "Shared memory publishing disabled:" << m_segment.errorString();
+	m_key.clear();
+
+	return false;
+}
@@ -0,0 +1,106 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHAREDMEMORYPUBLISHER_H_
+#define SHAREDMEMORYPUBLISHER_H_
+
+#include "NonCopyable.h"
+#include <QMutex>
+#include <QSharedMemory>
+#include <QString>
+#include <stdint.h>
+
+class QImage;
+
+/**
+ * \brief Publishes finished output images into named shared memory.
+ *
+ * Companion tools (an OCR previewer, for instance) that want the pages
+ * as they come off the output stage otherwise have to watch the output
+ * directory and decode the files we just encoded.  This publisher hands
+ * them the raw pixels instead: each finished page is copied into a
+ * QSharedMemory segment, skipping the encode/decode/disk round trip.
+ *
+ * The protocol is deliberately minimal and single-consumer.  The
+ * segment starts with a Header followed immediately by the pixel data.
+ * The publisher increments Header::sequence after writing a frame; the
+ * consumer, polling under QSharedMemory::lock(), copies out any frame
+ * whose sequence it hasn't seen yet.  There is no acknowledgement:
+ * a frame the consumer is too slow to pick up is simply overwritten,
+ * which is the right behavior for a preview.
+ *
+ * QSharedMemory segments can't be resized, so when a page doesn't fit
+ * the current segment it is torn down and recreated larger under the
+ * same key.  The consumer notices the detach (its attach handle goes
+ * stale on the platforms we care about, and Header::segmentSize stops
+ * matching on the rest) and re-attaches.
+ */
+class SharedMemoryPublisher
+{
+	DECLARE_NON_COPYABLE(SharedMemoryPublisher)
+public:
+	struct Header
+	{
+		uint32_t magic; /**< Always MAGIC. */
+		uint32_t version; /**< Always VERSION. */
+		uint32_t segmentSize; /**< Total size of the segment, bytes. */
+		uint32_t sequence; /**< Incremented after each published frame. */
+		uint32_t width;
+		uint32_t height;
+		uint32_t format; /**< QImage::Format of the pixel data. */
+		uint32_t bytesPerLine;
+		uint32_t dotsPerMeterX;
+		uint32_t dotsPerMeterY;
+		uint32_t nameBytes; /**< Length of the UTF-8 page name that follows. */
+		uint32_t dataOffset; /**< Offset of the pixel data from segment start. */
+	};
+
+	static uint32_t const MAGIC = 0x53544d53; // "STMS"
+	static uint32_t const VERSION = 1;
+
+	static SharedMemoryPublisher& instance();
+
+	bool isEnabled() const { return !m_key.isEmpty(); }
+
+	/**
+	 * \brief Makes publish() start publishing under the given key.
+	 *
+	 * Called once at startup, before any worker threads exist.
+	 */
+	void setKey(QString const& key) { m_key = key; }
+
+	/**
+	 * \brief Publishes \p image under \p name, which identifies the page.
+	 *
+	 * Does nothing unless a key was set.  May be called from multiple
+	 * threads at the same time.  Never fails loudly: shared memory
+	 * trouble only costs us the preview, not the batch.
+	 */
+	void publish(QString const& name, QImage const& image);
+private:
+	SharedMemoryPublisher() : m_sequence(0) {}
+
+	bool ensureSegment(size_t size);
+
+	QString m_key;
+	QMutex m_mutex;
+	QSharedMemory m_segment;
+	uint32_t m_sequence;
+};
+
+#endif
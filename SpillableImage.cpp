@@ -0,0 +1,328 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SpillableImage.h"
+#include "RefCountable.h"
+#include "AutoRemovingFile.h"
+#include <boost/intrusive/list.hpp>
+#include <QImage>
+#include <QVector>
+#include <QRgb>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QDir>
+#include <QMutex>
+#include <QMutexLocker>
+#include <new>
+#include <string.h>
+
+class SpillableImage::Impl :
+	public RefCountable,
+	public boost::intrusive::list_base_hook<
+		boost::intrusive::link_mode<boost::intrusive::auto_unlink>
+	>
+{
+public:
+	Impl(QImage const& image);
+
+	virtual ~Impl();
+
+	QSize size() const { return m_size; }
+
+	/**
+	 * Returns the image, faulting it back in if it was spilled.
+	 * Also moves this image to the recently used end of the queue.
+	 */
+	QImage image();
+
+	/**
+	 * Writes the pixels out and drops them from memory.
+	 * Must be called with the registry mutex held.
+	 */
+	bool spill();
+private:
+	QImage m_image; /**< Null while spilled. */
+	AutoRemovingFile m_file;
+	QSize m_size;
+	QImage::Format m_format;
+	QVector<QRgb> m_colorTable;
+	int m_bytesPerLine;
+	size_t m_numBytes;
+	bool m_onDisk; /**< The file holds a valid copy of the pixels. */
+
+	/** Reads the pixels back in. */
+	void unspill();
+};
+
+
+namespace
+{
+
+/**
+ * Tracks all resident SpillableImage pixel data, most recently
+ * used first.  All members are protected by \ref mutex.
+ */
+class Registry
+{
+public:
+	static Registry& instance();
+
+	QMutex mutex;
+
+	size_t residentBytes;
+
+	size_t memoryBudget;
+
+	/**
+	 * Spills least recently used images until residentBytes fits
+	 * the budget.  \p protect is never spilled.  Must be called
+	 * with the mutex held.
+	 */
+	void enforceBudget(SpillableImage::Impl* protect);
+
+	typedef boost::intrusive::list<
+		SpillableImage::Impl,
+		boost::intrusive::constant_time_size<false>
+	> LruList;
+
+	LruList lru;
+private:
+	enum { DEFAULT_MEMORY_BUDGET = 512 * 1024 * 1024 };
+
+	Registry() : residentBytes(0), memoryBudget(DEFAULT_MEMORY_BUDGET) {}
+};
+
+
+Registry&
+Registry::instance()
+{
+	// Just like with OutOfMemoryHandler, we rely on this being
+	// first called early on, from a single thread.
+	static Registry object;
+
+	return object;
+}
+
+void
+Registry::enforceBudget(SpillableImage::Impl* const protect)
+{
+	if (memoryBudget == 0) {
+		// Spilling disabled.
+		return;
+	}
+
+	while (residentBytes > memoryBudget && !lru.empty()) {
+		SpillableImage::Impl& impl = lru.back();
+		if (&impl == protect) {
+			// The image being accessed right now has to stay
+			// resident, and everything older is already spilled.
+			break;
+		}
+		if (!impl.spill()) {
+			// Most likely we failed to create a temporary file.
+			// Retrying with the others would fail the same way.
+			break;
+		}
+	}
+}
+
+} // anonymous namespace
+
+
+/*======================== SpillableImage::Impl =========================*/
+
+SpillableImage::Impl::Impl(QImage const& image)
+:	m_image(image),
+	m_size(image.size()),
+	m_format(image.format()),
+	m_colorTable(image.colorTable()),
+	m_bytesPerLine(image.bytesPerLine()),
+	m_numBytes(size_t(image.bytesPerLine()) * image.height()),
+	m_onDisk(false)
+{
+	if (m_numBytes == 0) {
+		return;
+	}
+
+	Registry& registry = Registry::instance();
+	QMutexLocker const locker(&registry.mutex);
+	registry.lru.push_front(*this);
+	registry.residentBytes += m_numBytes;
+	registry.enforceBudget(this);
+}
+
+SpillableImage::Impl::~Impl()
+{
+	Registry& registry = Registry::instance();
+	QMutexLocker const locker(&registry.mutex);
+	if (!m_image.isNull()) {
+		registry.residentBytes -= m_numBytes;
+	}
+	if (is_linked()) {
+		unlink();
+	}
+}
+
+QImage
+SpillableImage::Impl::image()
+{
+	Registry& registry = Registry::instance();
+	QMutexLocker const locker(&registry.mutex);
+
+	if (m_image.isNull() && m_numBytes != 0) {
+		unspill();
+		registry.residentBytes += m_numBytes;
+	}
+
+	// Move to the recently used end.
+	if (is_linked()) {
+		unlink();
+	}
+	if (m_numBytes != 0) {
+		registry.lru.push_front(*this);
+	}
+
+	registry.enforceBudget(this);
+
+	return m_image;
+}
+
+bool
+SpillableImage::Impl::spill()
+{
+	if (!m_onDisk) {
+		QTemporaryFile file(QDir::tempPath()+"/scantailor-spill-XXXXXX");
+		if (!file.open()) {
+			return false;
+		}
+
+		qint64 const written = file.write(
+			(char const*)m_image.bits(), m_numBytes
+		);
+		if (written != qint64(m_numBytes)) {
+			return false;
+		}
+
+		m_file.reset(file.fileName());
+		file.setAutoRemove(false);
+		m_onDisk = true;
+	}
+
+	// The file stays behind, so if nobody writes to this image,
+	// the next spill won't have to write it out again.
+	m_image = QImage();
+	Registry::instance().residentBytes -= m_numBytes;
+	if (is_linked()) {
+		unlink();
+	}
+
+	return true;
+}
+
+void
+SpillableImage::Impl::unspill()
+{
+	QImage image(m_size, m_format);
+	image.setColorTable(m_colorTable);
+	if (image.isNull()) {
+		throw std::bad_alloc();
+	}
+
+	QFile file(m_file.get());
+	if (!file.open(QIODevice::ReadOnly)) {
+		throw std::bad_alloc();
+	}
+
+	int const height = m_size.height();
+	int const bpl = qMin(m_bytesPerLine, int(image.bytesPerLine()));
+
+	// A memory mapped view lets the kernel fault pages in as we
+	// touch them, without buffering the whole file twice.
+	uchar const* mapped = file.map(0, m_numBytes);
+	if (mapped) {
+		for (int y = 0; y < height; ++y) {
+			memcpy(image.scanLine(y), mapped + y * m_bytesPerLine, bpl);
+		}
+	} else {
+		for (int y = 0; y < height; ++y) {
+			file.seek(qint64(y) * m_bytesPerLine);
+			file.read((char*)image.scanLine(y), bpl);
+		}
+	}
+
+	m_image = image;
+}
+
+
+/*=========================== SpillableImage ============================*/
+
+SpillableImage::SpillableImage()
+{
+}
+
+SpillableImage::SpillableImage(QImage const& image)
+:	m_ptrImpl(new Impl(image))
+{
+}
+
+SpillableImage::SpillableImage(SpillableImage const& other)
+:	m_ptrImpl(other.m_ptrImpl)
+{
+}
+
+SpillableImage&
+SpillableImage::operator=(SpillableImage const& other)
+{
+	m_ptrImpl = other.m_ptrImpl;
+	return *this;
+}
+
+SpillableImage::~SpillableImage()
+{
+}
+
+bool
+SpillableImage::isNull() const
+{
+	return !m_ptrImpl.get() || m_ptrImpl->size().isEmpty();
+}
+
+QSize
+SpillableImage::size() const
+{
+	return m_ptrImpl.get() ? m_ptrImpl->size() : QSize();
+}
+
+QImage
+SpillableImage::toQImage() const
+{
+	if (!m_ptrImpl.get()) {
+		return QImage();
+	}
+
+	return m_ptrImpl->image();
+}
+
+void
+SpillableImage::setMemoryBudget(size_t const bytes)
+{
+	Registry& registry = Registry::instance();
+	QMutexLocker const locker(&registry.mutex);
+	registry.memoryBudget = bytes;
+	registry.enforceBudget(0);
+}
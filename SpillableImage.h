@@ -0,0 +1,87 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPILLABLE_IMAGE_H_
+#define SPILLABLE_IMAGE_H_
+
+#include "IntrusivePtr.h"
+#include <QSize>
+#include <stddef.h>
+
+class QImage;
+
+/**
+ * \brief An image that may be transparently spilled to a temporary file.
+ *
+ * All SpillableImage instances on all threads share a memory budget.
+ * When the total size of resident images exceeds it, the least
+ * recently used ones have their pixel data written to a temporary
+ * file and dropped from memory.  Accessing a spilled image through
+ * toQImage() faults it back in.
+ *
+ * This is meant for full-page intermediates that have to be kept
+ * around for interactive re-processing (despeckle previews and the
+ * like), but are only occasionally looked at.  Unlike the reactive
+ * OutOfMemoryHandler, which kicks in after an allocation has already
+ * failed, spilling happens proactively, trading some disk traffic for
+ * not dying on long sessions with many open pages.
+ */
+class SpillableImage
+{
+public:
+	/** \internal Public only so the registry in the .cpp can see it. */
+	class Impl;
+
+	SpillableImage();
+
+	explicit SpillableImage(QImage const& image);
+
+	/**
+	 * \brief Copies share their pixel data, like QImage copies do.
+	 */
+	SpillableImage(SpillableImage const& other);
+
+	SpillableImage& operator=(SpillableImage const& other);
+
+	~SpillableImage();
+
+	bool isNull() const;
+
+	QSize size() const;
+
+	/**
+	 * \brief Returns the image, faulting it back from disk if necessary.
+	 *
+	 * The returned image shares its data with this object, so
+	 * modifying it detaches it the usual way.  Faulting back marks
+	 * the image as recently used.
+	 */
+	QImage toQImage() const;
+
+	/**
+	 * \brief Sets the shared budget for resident images, in bytes.
+	 *
+	 * Zero disables spilling altogether.  Images already spilled
+	 * stay on disk until accessed.
+	 */
+	static void setMemoryBudget(size_t bytes);
+private:
+	IntrusivePtr<Impl> m_ptrImpl;
+};
+
+#endif
@@ -70,6 +70,14 @@ ThumbnailBase::ThumbnailBase(
 	m_extendedClipArea(false)
 {
 	setImageXform(m_imageXform);
+
+	// Our paint() is expensive - it pushes the cached pixmap through
+	// the full ImageTransformation with smooth scaling.  Have the
+	// graphics view cache the rendered result in device coordinates,
+	// so that scrolling merely blits the cached pixmaps.  A zoom-less
+	// scroll doesn't invalidate such a cache, while update() - which
+	// subclasses call whenever their appearance changes - does.
+	setCacheMode(QGraphicsItem::DeviceCoordinateCache);
 }
 
 ThumbnailBase::~ThumbnailBase()
@@ -0,0 +1,408 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThumbnailPackFile.h"
+#include "ImageId.h"
+#include "PackBits.h"
+#include "imageproc/Grayscale.h"
+#include <QCryptographicHash>
+#include <QMutexLocker>
+#include <QImage>
+#include <QtEndian>
+#include <string.h>
+
+namespace
+{
+
+char const MAGIC[8] = { 'S', 'T', 'P', 'A', 'C', 'K', '1', '\n' };
+
+size_t const KEY_BYTES = 16; /**< An MD5 digest. */
+
+/** key + width + height + format + padding + data size. */
+size_t const RECORD_HEADER_BYTES = KEY_BYTES + 2 + 2 + 1 + 3 + 4;
+
+qint64 alignUp(qint64 const offset)
+{
+	return (offset + 3) & ~qint64(3);
+}
+
+/**
+ * Checks if an 8-bit grayscale image only uses pure black and
+ * pure white.  Such images are typically thumbnails of bitonal
+ * pages that were never antialiased.
+ */
+bool isBilevelGray(QImage const& image)
+{
+	QVector<QRgb> const table(image.colorTable());
+	bool extreme[256];
+	for (int i = 0; i < 256; ++i) {
+		int const gray = i < table.size() ? qGray(table[i]) : i;
+		extreme[i] = (gray == 0 || gray == 255);
+	}
+
+	int const width = image.width();
+	int const height = image.height();
+	for (int y = 0; y < height; ++y) {
+		uchar const* line = image.scanLine(y);
+		for (int x = 0; x < width; ++x) {
+			if (!extreme[line[x]]) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Packs an image known to only contain black and white pixels
+ * into rows of 8 pixels per byte, MSB first, 1 meaning black.
+ */
+QByteArray packBilevel(QImage const& image)
+{
+	int const width = image.width();
+	int const height = image.height();
+	int const bytes_per_line = (width + 7) / 8;
+
+	QByteArray packed(bytes_per_line * height, 0);
+	uchar* dst = (uchar*)packed.data();
+
+	QImage mono(image);
+	if (image.format() == QImage::Format_MonoLSB) {
+		mono = image.convertToFormat(QImage::Format_Mono);
+		if (mono.isNull()) {
+			return QByteArray();
+		}
+	}
+
+	if (mono.format() == QImage::Format_Mono) {
+		// Already bit-packed - just normalize the polarity and
+		// clear the padding bits in the last byte of each row.
+		QVector<QRgb> const table(mono.colorTable());
+		bool const black_is_1 = table.size() < 2
+			|| qGray(table[1]) < qGray(table[0]);
+		uchar const last_mask = width % 8 == 0
+			? 0xff : uchar(0xff << (8 - width % 8));
+		for (int y = 0; y < height; ++y, dst += bytes_per_line) {
+			uchar const* src = mono.scanLine(y);
+			if (black_is_1) {
+				memcpy(dst, src, bytes_per_line);
+			} else {
+				for (int i = 0; i < bytes_per_line; ++i) {
+					dst[i] = ~src[i];
+				}
+			}
+			dst[bytes_per_line - 1] &= last_mask;
+		}
+	} else {
+		QVector<QRgb> const table(mono.colorTable());
+		for (int y = 0; y < height; ++y, dst += bytes_per_line) {
+			uchar const* src = mono.scanLine(y);
+			for (int x = 0; x < width; ++x) {
+				int const v = src[x];
+				int const gray = v < table.size() ? qGray(table[v]) : v;
+				if (gray == 0) {
+					dst[x >> 3] |= uchar(0x80 >> (x & 7));
+				}
+			}
+		}
+	}
+
+	return packed;
+}
+
+} // anonymous namespace
+
+
+ThumbnailPackFile::ThumbnailPackFile(QString const& file_path)
+:	m_file(file_path),
+	m_opened(false),
+	m_openFailed(false)
+{
+}
+
+ThumbnailPackFile::~ThumbnailPackFile()
+{
+}
+
+bool
+ThumbnailPackFile::contains(ImageId const& image_id)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (!ensureOpenLocked()) {
+		return false;
+	}
+
+	return m_index.find(keyFor(image_id)) != m_index.end();
+}
+
+QImage
+ThumbnailPackFile::load(ImageId const& image_id)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (!ensureOpenLocked()) {
+		return QImage();
+	}
+
+	Index::const_iterator const it(m_index.find(keyFor(image_id)));
+	if (it == m_index.end()) {
+		return QImage();
+	}
+	Record const& record = it->second;
+
+	QImage image;
+	int bytes_per_line = 0;
+	if (record.format == FMT_GRAY8) {
+		image = QImage(record.width, record.height, QImage::Format_Indexed8);
+		image.setColorTable(imageproc::createGrayscalePalette());
+		bytes_per_line = record.width;
+	} else if (record.format == FMT_MONO_RLE) {
+		image = QImage(record.width, record.height, QImage::Format_Mono);
+		image.setColor(0, qRgb(255, 255, 255));
+		image.setColor(1, qRgb(0, 0, 0));
+		bytes_per_line = (record.width + 7) / 8;
+	} else {
+		image = QImage(record.width, record.height, QImage::Format_RGB32);
+		bytes_per_line = record.width * 4;
+	}
+	if (image.isNull()) {
+		return QImage();
+	}
+
+	// Non-coded records are stored with rows tightly packed.
+	if (record.format != FMT_MONO_RLE
+			&& qint64(bytes_per_line) * record.height != qint64(record.dataBytes)) {
+		return QImage();
+	}
+
+	uchar* const mapped = m_file.map(record.dataOffset, record.dataBytes);
+	uchar const* src = mapped;
+	QByteArray fallback;
+	if (!src) {
+		// Memory mapping can fail on exotic filesystems.
+		if (!m_file.seek(record.dataOffset)) {
+			return QImage();
+		}
+		fallback = m_file.read(record.dataBytes);
+		if (fallback.size() != int(record.dataBytes)) {
+			return QImage();
+		}
+		src = (uchar const*)fallback.constData();
+	}
+
+	QByteArray unpacked;
+	if (record.format == FMT_MONO_RLE) {
+		unpacked.resize(bytes_per_line * record.height);
+		bool const ok = packBitsDecode(
+			src, int(record.dataBytes),
+			(uchar*)unpacked.data(), unpacked.size()
+		);
+		src = (uchar const*)unpacked.constData();
+		if (!ok) {
+			if (mapped) {
+				m_file.unmap(mapped);
+			}
+			return QImage();
+		}
+	}
+
+	for (int y = 0; y < record.height; ++y) {
+		memcpy(image.scanLine(y), src + qint64(y) * bytes_per_line, bytes_per_line);
+	}
+
+	if (mapped) {
+		m_file.unmap(mapped);
+	}
+
+	return image;
+}
+
+bool
+ThumbnailPackFile::store(ImageId const& image_id, QImage const& image)
+{
+	if (image.isNull()) {
+		return false;
+	}
+
+	bool const bilevel =
+		image.format() == QImage::Format_Mono
+		|| image.format() == QImage::Format_MonoLSB
+		|| (image.format() == QImage::Format_Indexed8
+			&& image.isGrayscale() && isBilevelGray(image));
+
+	QImage src(image);
+	QByteArray coded;
+	quint8 format = FMT_RGB32;
+	int bytes_per_line = image.width() * 4;
+	if (bilevel) {
+		QByteArray const packed(packBilevel(image));
+		if (packed.isEmpty()) {
+			return false;
+		}
+		packBitsEncode(
+			(uchar const*)packed.constData(), packed.size(), coded
+		);
+		format = FMT_MONO_RLE;
+	} else if (image.format() == QImage::Format_Indexed8 && image.isGrayscale()) {
+		format = FMT_GRAY8;
+		bytes_per_line = image.width();
+	} else if (image.format() != QImage::Format_RGB32) {
+		src = image.convertToFormat(QImage::Format_RGB32);
+		if (src.isNull()) {
+			return false;
+		}
+	}
+	quint32 const data_bytes = format == FMT_MONO_RLE
+		? quint32(coded.size())
+		: quint32(bytes_per_line) * src.height();
+
+	QMutexLocker const locker(&m_mutex);
+
+	if (!ensureOpenLocked()) {
+		return false;
+	}
+
+	qint64 const record_offset = alignUp(m_file.size());
+	if (!m_file.seek(record_offset)) {
+		return false;
+	}
+
+	char header[RECORD_HEADER_BYTES];
+	memset(header, 0, sizeof(header));
+	QByteArray const key(keyFor(image_id));
+	memcpy(header, key.constData(), KEY_BYTES);
+	qToLittleEndian<quint16>(quint16(src.width()), (uchar*)header + 16);
+	qToLittleEndian<quint16>(quint16(src.height()), (uchar*)header + 18);
+	header[20] = char(format);
+	qToLittleEndian<quint32>(data_bytes, (uchar*)header + 24);
+
+	bool ok = m_file.write(header, sizeof(header)) == qint64(sizeof(header));
+	if (format == FMT_MONO_RLE) {
+		ok = ok && m_file.write(coded) == qint64(coded.size());
+	} else {
+		for (int y = 0; ok && y < src.height(); ++y) {
+			ok = m_file.write(
+				(char const*)src.scanLine(y), bytes_per_line
+			) == bytes_per_line;
+		}
+	}
+
+	if (!ok) {
+		// Drop the partial record, so it doesn't confuse the
+		// next index rebuild.
+		m_file.resize(record_offset);
+		return false;
+	}
+	m_file.flush();
+
+	Record record;
+	record.dataOffset = record_offset + RECORD_HEADER_BYTES;
+	record.dataBytes = data_bytes;
+	record.width = quint16(src.width());
+	record.height = quint16(src.height());
+	record.format = format;
+	m_index[key] = record;
+
+	return true;
+}
+
+bool
+ThumbnailPackFile::ensureOpenLocked()
+{
+	if (m_opened) {
+		return true;
+	}
+	if (m_openFailed) {
+		return false;
+	}
+
+	if (!m_file.open(QIODevice::ReadWrite)) {
+		// Like with per-thumbnail files, we intentionally don't
+		// create missing parent directories.
+		m_openFailed = true;
+		return false;
+	}
+
+	qint64 const file_size = m_file.size();
+	if (file_size == 0) {
+		if (m_file.write(MAGIC, sizeof(MAGIC)) != qint64(sizeof(MAGIC))) {
+			m_file.close();
+			m_openFailed = true;
+			return false;
+		}
+		m_opened = true;
+		return true;
+	}
+
+	char magic[sizeof(MAGIC)];
+	if (m_file.read(magic, sizeof(magic)) != qint64(sizeof(magic))
+			|| memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+		// Not our file - don't touch it.
+		m_file.close();
+		m_openFailed = true;
+		return false;
+	}
+
+	// A single sequential scan over the one file rebuilds the
+	// whole index.  Later records win, as replacements append.
+	qint64 offset = sizeof(MAGIC);
+	for (;;) {
+		offset = alignUp(offset);
+		if (offset + qint64(RECORD_HEADER_BYTES) > file_size) {
+			break;
+		}
+
+		char header[RECORD_HEADER_BYTES];
+		if (!m_file.seek(offset)
+				|| m_file.read(header, sizeof(header)) != qint64(sizeof(header))) {
+			break;
+		}
+
+		Record record;
+		record.width = qFromLittleEndian<quint16>((uchar const*)header + 16);
+		record.height = qFromLittleEndian<quint16>((uchar const*)header + 18);
+		record.format = quint8(header[20]);
+		record.dataBytes = qFromLittleEndian<quint32>((uchar const*)header + 24);
+		record.dataOffset = offset + RECORD_HEADER_BYTES;
+
+		if (record.dataOffset + qint64(record.dataBytes) > file_size) {
+			// A truncated record from an interrupted write.
+			// Cut it off, so appends don't build on garbage.
+			m_file.resize(offset);
+			break;
+		}
+
+		m_index[QByteArray(header, KEY_BYTES)] = record;
+		offset = record.dataOffset + record.dataBytes;
+	}
+
+	m_opened = true;
+	return true;
+}
+
+QByteArray
+ThumbnailPackFile::keyFor(ImageId const& image_id)
+{
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	hash.addData(image_id.filePath().toUtf8());
+	hash.addData(":", 1);
+	hash.addData(QByteArray::number(image_id.zeroBasedPage()));
+	return hash.result();
+}
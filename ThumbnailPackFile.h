@@ -0,0 +1,123 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THUMBNAILPACKFILE_H_
+#define THUMBNAILPACKFILE_H_
+
+#include "RefCountable.h"
+#include <QByteArray>
+#include <QString>
+#include <QFile>
+#include <QMutex>
+#include <map>
+
+class ImageId;
+class QImage;
+
+/**
+ * \brief A single packed file holding all of a project's thumbnails.
+ *
+ * Storing each thumbnail as its own PNG makes opening a large project
+ * stat and decode thousands of small files.  This class keeps all
+ * thumbnails in one append-only file: records carry an MD5 key derived
+ * from the ImageId plus raw pixel data, the index is rebuilt from a
+ * single sequential scan on open, and record reads go through
+ * memory mapping, so a cached lookup is a memcpy instead of an open +
+ * PNG decode.
+ *
+ * Replacing a thumbnail appends a new record and repoints the index;
+ * the old record becomes dead weight.  That's fine for a cache - the
+ * file may be deleted at any time and will be rebuilt as needed.
+ *
+ * Each record carries a format byte, so the pixel encoding is chosen
+ * per thumbnail.  Black-and-white thumbnails, which dominate typical
+ * scanned-book projects, get a compact path: one bit per pixel plus
+ * run-length coding, rather than a byte per pixel.
+ *
+ * All methods are thread-safe.
+ */
+class ThumbnailPackFile : public RefCountable
+{
+public:
+	explicit ThumbnailPackFile(QString const& file_path);
+
+	virtual ~ThumbnailPackFile();
+
+	/**
+	 * \brief Checks if a thumbnail for this image is present.
+	 */
+	bool contains(ImageId const& image_id);
+
+	/**
+	 * \brief Retrieves a thumbnail, or a null image if not present.
+	 */
+	QImage load(ImageId const& image_id);
+
+	/**
+	 * \brief Stores a thumbnail, replacing any previous one.
+	 *
+	 * Images containing only black and white pixels are stored
+	 * as run-length coded 1 bit per pixel data.  Other images in
+	 * formats besides 8-bit grayscale are stored as 32-bit RGB.
+	 * Returns false on I/O failure.
+	 */
+	bool store(ImageId const& image_id, QImage const& image);
+private:
+	enum Format {
+		FMT_GRAY8 = 0,
+		FMT_RGB32 = 1,
+
+		/**
+		 * Rows packed to 8 pixels per byte, MSB first, 1 meaning
+		 * black, then PackBits-coded as one continuous byte stream.
+		 * Record::dataBytes is the size of the coded stream.
+		 */
+		FMT_MONO_RLE = 2
+	};
+
+	struct Record
+	{
+		qint64 dataOffset;
+		quint32 dataBytes;
+		quint16 width;
+		quint16 height;
+		quint8 format;
+
+		Record() : dataOffset(0), dataBytes(0),
+			width(0), height(0), format(0) {}
+	};
+
+	typedef std::map<QByteArray, Record> Index;
+
+	/**
+	 * Opens the file and scans it to build the index.
+	 * Returns false if the file can't be opened for writing.
+	 * Must be called with the mutex held.
+	 */
+	bool ensureOpenLocked();
+
+	static QByteArray keyFor(ImageId const& image_id);
+
+	QMutex m_mutex;
+	QFile m_file;
+	Index m_index;
+	bool m_opened;
+	bool m_openFailed;
+};
+
+#endif
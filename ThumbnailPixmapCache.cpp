@@ -17,6 +17,8 @@
 */
 
 #include "ThumbnailPixmapCache.h"
+#include "ThumbnailPackFile.h"
+#include "IntrusivePtr.h"
 #include "ImageId.h"
 #include "ImageLoader.h"
 #include "AtomicFileOverwriter.h"
@@ -38,6 +40,8 @@
 #include <QPixmap>
 #include <QEvent>
 #include <QSize>
+#include <QTime>
+#include <QTextStream>
 #include <QDebug>
 #ifndef Q_MOC_RUN
 #include <boost/multi_index_container.hpp>
@@ -118,7 +122,11 @@ public:
 	~Impl();
 
 	void setThumbDir(QString const& thumb_dir);
-	
+
+	Stats stats() const;
+
+	QString statsReport() const;
+
 	Status request(
 		ImageId const& image_id, QPixmap& pixmap, bool load_now = false,
 		boost::weak_ptr<CompletionHandler> const* completion_handler = 0);
@@ -163,6 +171,7 @@ private:
 	
 	static QImage loadSaveThumbnail(
 		ImageId const& image_id, QString const& thumb_dir,
+		IntrusivePtr<ThumbnailPackFile> const& pack_file,
 		QSize const& max_thumb_size);
 	
 	static QString getThumbFilePath(
@@ -180,8 +189,17 @@ private:
 	void processLoadResult(LoadResultEvent* result);
 	
 	void removeExcessLocked();
-	
+
 	void removeItemLocked(RemoveQueue::iterator const& it);
+
+	/**
+	 * Accounts for one disk load taking \p milliseconds.
+	 */
+	void recordLoadLocked(int milliseconds);
+
+	Stats statsLocked() const;
+
+	QString statsReportLocked() const;
 	
 	void cachePixmapUnlocked(ImageId const& image_id, QPixmap const& pixmap);
 	
@@ -217,6 +235,7 @@ private:
 	RemoveQueue::iterator m_endOfLoadedItems;
 	
 	QString m_thumbDir;
+	IntrusivePtr<ThumbnailPackFile> m_ptrPackFile;
 	QSize m_maxThumbSize;
 	int m_maxCachedPixmaps;
 	
@@ -233,7 +252,14 @@ private:
 	 * \see ThumbnailLoadResult::REQUEST_EXPIRED
 	 */
 	int m_totalLoadAttempts;
-	
+
+	/**
+	 * Behavior counters.  The per-request fields (queueDepth,
+	 * cachedPixmaps) are filled in on snapshot, from
+	 * m_numQueuedItems and m_numLoadedItems.
+	 */
+	Stats m_stats;
+
 	bool m_threadStarted;
 	bool m_shuttingDown;
 };
@@ -261,6 +287,23 @@ private:
 };
 
 
+/*====================== ThumbnailPixmapCache::Stats ========================*/
+
+ThumbnailPixmapCache::Stats::Stats()
+:	memoryHits(0),
+	loads(0),
+	evictions(0),
+	expiredRequests(0),
+	queueDepth(0),
+	cachedPixmaps(0),
+	maxCachedPixmaps(0)
+{
+	for (int i = 0; i < NUM_LATENCY_BUCKETS; ++i) {
+		loadLatencyBuckets[i] = 0;
+	}
+}
+
+
 /*========================== ThumbnailPixmapCache ===========================*/
 
 ThumbnailPixmapCache::ThumbnailPixmapCache(
@@ -285,6 +328,18 @@ ThumbnailPixmapCache::setThumbDir(QString const& thumb_dir)
 	m_ptrImpl->setThumbDir(RelinkablePath::normalize(thumb_dir));
 }
 
+ThumbnailPixmapCache::Stats
+ThumbnailPixmapCache::stats() const
+{
+	return m_ptrImpl->stats();
+}
+
+QString
+ThumbnailPixmapCache::statsReport() const
+{
+	return m_ptrImpl->statsReport();
+}
+
 ThumbnailPixmapCache::Status
 ThumbnailPixmapCache::loadFromCache(ImageId const& image_id, QPixmap& pixmap)
 {
@@ -332,6 +387,7 @@ ThumbnailPixmapCache::Impl::Impl(
 	m_removeQueue(m_items.get<RemoveQueueTag>()),
 	m_endOfLoadedItems(m_removeQueue.end()),
 	m_thumbDir(thumb_dir),
+	m_ptrPackFile(new ThumbnailPackFile(thumb_dir + QLatin1String("/thumbnails.pack"))),
 	m_maxThumbSize(max_thumb_size),
 	m_maxCachedPixmaps(max_cached_pixmaps),
 	m_expirationThreshold(expiration_threshold),
@@ -354,6 +410,12 @@ ThumbnailPixmapCache::Impl::~Impl()
 {
 	{
 		QMutexLocker const locker(&m_mutex);
+
+		if (m_stats.loads > 0 || m_stats.memoryHits > 0) {
+			// The session summary for tuning max_cached_pixmaps.
+			qDebug().nospace() << "Thumbnail cache statistics:\n"
+				<< qPrintable(statsReportLocked());
+		}
 		
 		if (!m_threadStarted) {
 			return;
@@ -376,6 +438,9 @@ ThumbnailPixmapCache::Impl::setThumbDir(QString const& thumb_dir)
 	}
 
 	m_thumbDir = thumb_dir;
+	m_ptrPackFile.reset(
+		new ThumbnailPackFile(thumb_dir + QLatin1String("/thumbnails.pack"))
+	);
 
 	BOOST_FOREACH(Item const& item, m_loadQueue) {
 		// This trick will make all queued tasks to expire.
@@ -386,6 +451,64 @@ ThumbnailPixmapCache::Impl::setThumbDir(QString const& thumb_dir)
 	}
 }
 
+ThumbnailPixmapCache::Stats
+ThumbnailPixmapCache::Impl::stats() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return statsLocked();
+}
+
+QString
+ThumbnailPixmapCache::Impl::statsReport() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return statsReportLocked();
+}
+
+ThumbnailPixmapCache::Stats
+ThumbnailPixmapCache::Impl::statsLocked() const
+{
+	Stats stats(m_stats);
+	stats.queueDepth = m_numQueuedItems;
+	stats.cachedPixmaps = m_numLoadedItems;
+	stats.maxCachedPixmaps = m_maxCachedPixmaps;
+	return stats;
+}
+
+QString
+ThumbnailPixmapCache::Impl::statsReportLocked() const
+{
+	Stats const stats(statsLocked());
+
+	QString text;
+	QTextStream strm(&text, QIODevice::WriteOnly);
+
+	strm << "memory hits=" << stats.memoryHits
+		<< " disk loads=" << stats.loads
+		<< " evictions=" << stats.evictions
+		<< " expired=" << stats.expiredRequests
+		<< " queued=" << stats.queueDepth
+		<< " cached=" << stats.cachedPixmaps
+		<< "/" << stats.maxCachedPixmaps << "\n";
+
+	strm << "load latency:";
+	for (int i = 0; i < Stats::NUM_LATENCY_BUCKETS; ++i) {
+		if (stats.loadLatencyBuckets[i] == 0) {
+			continue;
+		}
+		strm << " ";
+		if (i == Stats::NUM_LATENCY_BUCKETS - 1) {
+			strm << ">=" << (1 << (i - 1)) << "ms";
+		} else {
+			strm << "<" << (1 << i) << "ms";
+		}
+		strm << ": " << stats.loadLatencyBuckets[i];
+	}
+	strm << "\n";
+
+	return text;
+}
+
 ThumbnailPixmapCache::Status
 ThumbnailPixmapCache::Impl::request(
 	ImageId const& image_id, QPixmap& pixmap, bool const load_now,
@@ -403,7 +526,8 @@ ThumbnailPixmapCache::Impl::request(
 	if (k_it != m_itemsByKey.end()) {
 		if (k_it->status == Item::LOADED) {
 			pixmap = k_it->pixmap;
-			
+			++m_stats.memoryHits;
+
 			// Move it after all other candidates for removal.
 			RemoveQueue::iterator const rq_it(
 				m_items.project<RemoveQueueTag>(k_it)
@@ -419,17 +543,25 @@ ThumbnailPixmapCache::Impl::request(
 	
 	if (load_now) {
 		QString const thumb_dir(m_thumbDir);
+		IntrusivePtr<ThumbnailPackFile> const pack_file(m_ptrPackFile);
 		QSize const max_thumb_size(m_maxThumbSize);
-		
+
 		locker.unlock();
-		
+
+		QTime timer;
+		timer.start();
 		pixmap = QPixmap::fromImage(
-			loadSaveThumbnail(image_id, thumb_dir, max_thumb_size)
+			loadSaveThumbnail(image_id, thumb_dir, pack_file, max_thumb_size)
 		);
+
+		locker.relock();
+		recordLoadLocked(timer.elapsed());
+		locker.unlock();
+
 		if (pixmap.isNull()) {
 			return LOAD_FAILED;
 		}
-		
+
 		cachePixmapUnlocked(image_id, pixmap);
 		return LOADED;
 	}
@@ -504,16 +636,21 @@ ThumbnailPixmapCache::Impl::ensureThumbnailExists(
 	
 	QMutexLocker locker(&m_mutex);
 	QString const thumb_dir(m_thumbDir);
+	IntrusivePtr<ThumbnailPackFile> const pack_file(m_ptrPackFile);
 	QSize const max_thumb_size(m_maxThumbSize);
 	locker.unlock();
-	
+
 	QString const thumb_file_path(getThumbFilePath(image_id, thumb_dir));
-	if (QFile::exists(thumb_file_path)) {
+	if (pack_file->contains(image_id) || QFile::exists(thumb_file_path)) {
 		return;
 	}
-	
+
 	QImage const thumbnail(makeThumbnail(image, max_thumb_size));
-	
+
+	if (pack_file->store(image_id, thumbnail)) {
+		return;
+	}
+
 	AtomicFileOverwriter overwriter;
 	QIODevice* iodev = overwriter.startWriting(thumb_file_path);
 	if (iodev && thumbnail.save(iodev, "PNG")) {
@@ -535,22 +672,25 @@ ThumbnailPixmapCache::Impl::recreateThumbnail(
 	
 	QMutexLocker locker(&m_mutex);
 	QString const thumb_dir(m_thumbDir);
+	IntrusivePtr<ThumbnailPackFile> const pack_file(m_ptrPackFile);
 	QSize const max_thumb_size(m_maxThumbSize);
 	locker.unlock();
-	
-	QString const thumb_file_path(getThumbFilePath(image_id, thumb_dir));
+
 	QImage const thumbnail(makeThumbnail(image, max_thumb_size));
-	bool thumb_written = false;
-	
+
 	// Note that we may be called from multiple threads at the same time.
-	AtomicFileOverwriter overwriter;
-	QIODevice* iodev = overwriter.startWriting(thumb_file_path);
-	if (iodev && thumbnail.save(iodev, "PNG")) {
-		thumb_written = overwriter.commit();
-	} else {
-		overwriter.abort();
+	bool thumb_written = pack_file->store(image_id, thumbnail);
+	if (!thumb_written) {
+		QString const thumb_file_path(getThumbFilePath(image_id, thumb_dir));
+		AtomicFileOverwriter overwriter;
+		QIODevice* iodev = overwriter.startWriting(thumb_file_path);
+		if (iodev && thumbnail.save(iodev, "PNG")) {
+			thumb_written = overwriter.commit();
+		} else {
+			overwriter.abort();
+		}
 	}
-	
+
 	if (!thumb_written) {
 		return;
 	}
@@ -598,13 +738,26 @@ ThumbnailPixmapCache::Impl::backgroundProcessing()
 {
 	// This method is called from a background thread.
 	assert(QCoreApplication::instance()->thread() != QThread::currentThread());
-	
+
+	// Taking several items per mutex acquisition keeps the GUI
+	// thread from being starved of the lock during fast scrolling,
+	// while each loaded thumbnail is still delivered as soon as
+	// it's ready.
+	int const max_batch_size = 8;
+
+	std::vector<LoadQueue::iterator> batch;
+	std::vector<ImageId> batch_ids;
+	batch.reserve(max_batch_size);
+	batch_ids.reserve(max_batch_size);
+
 	for (;;) {
 		try {
+			batch.clear();
+			batch_ids.clear();
+
 			// We are going to initialize these while holding the mutex.
-			LoadQueue::iterator lq_it;
-			ImageId image_id;
 			QString thumb_dir;
+			IntrusivePtr<ThumbnailPackFile> pack_file;
 			QSize max_thumb_size;
 
 			{
@@ -614,10 +767,44 @@ ThumbnailPixmapCache::Impl::backgroundProcessing()
 					break;
 				}
 
-				lq_it = m_loadQueue.begin();
-				image_id = lq_it->imageId;
+				// New requests go to the front of the load queue,
+				// so the front holds what's visible right now and
+				// the tail holds what was scrolled past.  Expire
+				// the stale ones in bulk, in this single mutex
+				// hold, rather than paying a lock round-trip per
+				// abandoned request.  The reasoning behind request
+				// expiration is described in
+				// ThumbnailLoadResult::REQUEST_EXPIRED documentation.
+				while (!m_loadQueue.empty()
+						&& m_loadQueue.begin()->status == Item::QUEUED) {
+					LoadQueue::iterator const lq_it(m_loadQueue.begin());
+
+					// By marking the item as IN_PROGRESS, we
+					// prevent it from being processed again before
+					// the GUI thread receives our LoadResultEvent.
+					queuedToInProgress(lq_it);
+
+					if (m_totalLoadAttempts - lq_it->precedingLoadAttempts
+							> m_expirationThreshold) {
+						++m_stats.expiredRequests;
+						postLoadResult(
+							lq_it, QImage(),
+							ThumbnailLoadResult::REQUEST_EXPIRED
+						);
+						continue;
+					}
+
+					// Expired requests don't count as load attempts.
+					++m_totalLoadAttempts;
+
+					batch.push_back(lq_it);
+					batch_ids.push_back(lq_it->imageId);
+					if ((int)batch.size() == max_batch_size) {
+						break;
+					}
+				}
 
-				if (lq_it->status != Item::QUEUED) {
+				if (batch.empty()) {
 					// All QUEUED items precede any other items
 					// in the load queue, so it means there are no
 					// QUEUED items at all.
@@ -625,42 +812,31 @@ ThumbnailPixmapCache::Impl::backgroundProcessing()
 					break;
 				}
 
-				// By marking the item as IN_PROGRESS, we prevent it
-				// from being processed again before the GUI thread
-				// receives our LoadResultEvent.
-				queuedToInProgress(lq_it);
-
-				if (m_totalLoadAttempts - lq_it->precedingLoadAttempts
-						> m_expirationThreshold) {
-
-					// Expire this request.  The reasoning behind
-					// request expiration is described in
-					// ThumbnailLoadResult::REQUEST_EXPIRED
-					// documentation.
-
-					postLoadResult(
-						lq_it, QImage(),
-						ThumbnailLoadResult::REQUEST_EXPIRED
-					);
-					continue;
-				}
-
-				// Expired requests don't count as load attempts.
-				++m_totalLoadAttempts;
-
 				// Copy those while holding the mutex.
 				thumb_dir = m_thumbDir;
+				pack_file = m_ptrPackFile;
 				max_thumb_size = m_maxThumbSize;
 			} // mutex scope
 
-			QImage const image(
-				loadSaveThumbnail(image_id, thumb_dir, max_thumb_size)
-			);
+			for (size_t i = 0; i < batch.size(); ++i) {
+				QTime timer;
+				timer.start();
+				QImage const image(
+					loadSaveThumbnail(
+						batch_ids[i], thumb_dir, pack_file, max_thumb_size
+					)
+				);
+
+				{
+					QMutexLocker const locker(&m_mutex);
+					recordLoadLocked(timer.elapsed());
+				}
 
-			ThumbnailLoadResult::Status const status = image.isNull()
-				? ThumbnailLoadResult::LOAD_FAILED
-				: ThumbnailLoadResult::LOADED;
-			postLoadResult(lq_it, image, status);
+				ThumbnailLoadResult::Status const status = image.isNull()
+					? ThumbnailLoadResult::LOAD_FAILED
+					: ThumbnailLoadResult::LOADED;
+				postLoadResult(batch[i], image, status);
+			}
 		} catch (std::bad_alloc const&) {
 			OutOfMemoryHandler::instance().handleOutOfMemorySituation();
 		}
@@ -670,23 +846,35 @@ ThumbnailPixmapCache::Impl::backgroundProcessing()
 QImage
 ThumbnailPixmapCache::Impl::loadSaveThumbnail(
 	ImageId const& image_id, QString const& thumb_dir,
+	IntrusivePtr<ThumbnailPackFile> const& pack_file,
 	QSize const& max_thumb_size)
 {
+	QImage image(pack_file->load(image_id));
+	if (!image.isNull()) {
+		return image;
+	}
+
+	// Fall back to an individual PNG left by older versions,
+	// migrating it into the pack file along the way.
 	QString const thumb_file_path(getThumbFilePath(image_id, thumb_dir));
-	
-	QImage image(ImageLoader::load(thumb_file_path, 0));
+	image = ImageLoader::load(thumb_file_path, 0);
 	if (!image.isNull()) {
+		pack_file->store(image_id, image);
 		return image;
 	}
-	
-	image = ImageLoader::load(image_id);
+
+	// We only need the image at thumbnail size, which for JPEGs
+	// avoids decoding them at full resolution.
+	image = ImageLoader::loadDownscaled(image_id, max_thumb_size);
 	if (image.isNull()) {
 		return QImage();
 	}
-	
+
 	QImage const thumbnail(makeThumbnail(image, max_thumb_size));
-	thumbnail.save(thumb_file_path, "PNG");
-	
+	if (!pack_file->store(image_id, thumbnail)) {
+		thumbnail.save(thumb_file_path, "PNG");
+	}
+
 	return thumbnail;
 }
 
@@ -851,6 +1039,7 @@ ThumbnailPixmapCache::Impl::removeExcessLocked()
 		assert(m_numLoadedItems > 0);
 		assert(!m_removeQueue.empty());
 		assert(m_removeQueue.front().status == Item::LOADED);
+		++m_stats.evictions;
 		removeItemLocked(m_removeQueue.begin());
 	}
 }
@@ -878,6 +1067,20 @@ ThumbnailPixmapCache::Impl::removeItemLocked(
 	m_removeQueue.erase(it);
 }
 
+void
+ThumbnailPixmapCache::Impl::recordLoadLocked(int const milliseconds)
+{
+	++m_stats.loads;
+
+	// Bucket i counts loads below 2^i milliseconds.
+	int bucket = 0;
+	while (bucket < Stats::NUM_LATENCY_BUCKETS - 1
+			&& milliseconds >= (1 << bucket)) {
+		++bucket;
+	}
+	++m_stats.loadLatencyBuckets[bucket];
+}
+
 void
 ThumbnailPixmapCache::Impl::cachePixmapUnlocked(
 	ImageId const& image_id, QPixmap const& pixmap)
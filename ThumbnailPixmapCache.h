@@ -39,6 +39,51 @@ class ThumbnailPixmapCache : public RefCountable
 	DECLARE_NON_COPYABLE(ThumbnailPixmapCache)
 public:
 	enum Status { LOADED, LOAD_FAILED, QUEUED };
+
+	/**
+	 * \brief A snapshot of the cache's behavior counters.
+	 *
+	 * The number to watch is loads relative to memoryHits: scrolling
+	 * back and forth through a section that fits in memory produces
+	 * hits, while a too small max_cached_pixmaps turns the same
+	 * scrolling into repeated disk loads (thumbnail thrash).  A high
+	 * eviction count with a high load count means the limit should
+	 * be raised for this deployment.
+	 */
+	struct Stats
+	{
+		/** Requests served instantly from a cached pixmap. */
+		int memoryHits;
+
+		/** Thumbnails actually loaded from disk. */
+		int loads;
+
+		/** Pixmaps dropped to stay under max_cached_pixmaps. */
+		int evictions;
+
+		/** Requests scrolled past before their load started. */
+		int expiredRequests;
+
+		/** Load requests currently waiting for the background thread. */
+		int queueDepth;
+
+		/** Pixmaps currently cached in memory. */
+		int cachedPixmaps;
+
+		/** The configured cache capacity, for context. */
+		int maxCachedPixmaps;
+
+		enum { NUM_LATENCY_BUCKETS = 10 };
+
+		/**
+		 * Disk load times: bucket i counts loads that took less
+		 * than 2^i milliseconds (and at least 2^(i-1), for i > 0);
+		 * the last bucket has no upper limit.
+		 */
+		int loadLatencyBuckets[NUM_LATENCY_BUCKETS];
+
+		Stats();
+	};
 	
 	typedef AbstractCommand1<
 		void, ThumbnailLoadResult const&
@@ -72,6 +117,20 @@ public:
 	
 	void setThumbDir(QString const& thumb_dir);
 
+	/**
+	 * \brief Returns the current behavior counters.
+	 *
+	 * May be called from any thread.  The same numbers are logged
+	 * through qDebug() when the cache is destroyed, so a session's
+	 * hit rate can be read off the terminal without instrumentation.
+	 */
+	Stats stats() const;
+
+	/**
+	 * \brief The counters formatted for logs, one line per aspect.
+	 */
+	QString statsReport() const;
+
 	/**
 	 * \brief Take the pixmap from cache, if it's there.
 	 *
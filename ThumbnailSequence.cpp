@@ -32,6 +32,7 @@
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/random_access_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/function.hpp>
 #include <boost/lambda/lambda.hpp>
@@ -44,12 +45,14 @@
 #include <QGraphicsSimpleTextItem>
 #include <QGraphicsPixmapItem>
 #include <QGraphicsView>
+#include <QPixmapCache>
 #include <QStyle>
 #include <QStyleOptionGraphicsItem>
 #include <QGraphicsSceneMouseEvent>
 #include <QGraphicsSceneContextMenuEvent>
 #include <QPalette>
 #include <QFont>
+#include <QFontMetrics>
 #include <QApplication>
 #include <QVariant>
 #include <QFileInfo>
@@ -69,6 +72,9 @@
 #include <Qt>
 #include <QDebug>
 #include <algorithm>
+#include <iterator>
+#include <vector>
+#include <math.h>
 #include <stddef.h>
 #include <assert.h>
 
@@ -79,20 +85,31 @@ using namespace ::boost::lambda;
 class ThumbnailSequence::Item
 {
 public:
-	Item(PageInfo const& page_info, CompositeItem* comp_item);
-	
+	Item(PageInfo const& page_info);
+
 	PageId const& pageId() const { return pageInfo.id(); }
-	
+
 	bool isSelected() const { return m_isSelected; }
-	
+
 	bool isSelectionLeader() const { return m_isSelectionLeader; }
-	
+
 	void setSelected(bool selected) const;
-	
+
 	void setSelectionLeader(bool selection_leader) const;
-	
+
 	PageInfo pageInfo;
+
+	/**
+	 * Only the items near the area of the scene being viewed have
+	 * composite items.  For the rest, this is null.
+	 */
 	mutable CompositeItem* composite;
+
+	/**
+	 * Whether the page is represented by IncompleteThumbnail.
+	 * For items that never had a composite item built, this is
+	 * an assumption rather than a known fact.
+	 */
 	mutable bool incompleteThumbnail;
 private:
 	mutable bool m_isSelected;
@@ -105,19 +122,36 @@ class ThumbnailSequence::GraphicsScene : public QGraphicsScene
 public:
 	typedef boost::function<void (QGraphicsSceneContextMenuEvent*)> ContextMenuEventCallback;
 
+	typedef boost::function<void (QRectF const&)> SceneExposedCallback;
+
 	void setContextMenuEventCallback(ContextMenuEventCallback callback) {
 		m_contextMenuEventCallback = callback;
 	}
+
+	void setSceneExposedCallback(SceneExposedCallback callback) {
+		m_sceneExposedCallback = callback;
+	}
 protected:
 	virtual void contextMenuEvent(QGraphicsSceneContextMenuEvent* event) {
 		QGraphicsScene::contextMenuEvent(event);
-		
+
 		if (!event->isAccepted() && m_contextMenuEventCallback) {
 			m_contextMenuEventCallback(event);
 		}
 	}
+
+	virtual void drawBackground(QPainter* painter, QRectF const& rect) {
+		QGraphicsScene::drawBackground(painter, rect);
+
+		// This is how we learn which part of the scene is being
+		// viewed, without involving the views themselves.
+		if (m_sceneExposedCallback) {
+			m_sceneExposedCallback(rect);
+		}
+	}
 private:
 	ContextMenuEventCallback m_contextMenuEventCallback;
+	SceneExposedCallback m_sceneExposedCallback;
 };
 
 
@@ -145,7 +179,11 @@ public:
 	void invalidateThumbnail(PageInfo const& page_info);
 	
 	void invalidateAllThumbnails();
-	
+
+	void invalidateThumbnails(std::set<PageId> const& pages);
+
+	void setDuplicateSuspects(std::set<PageId> const& pages);
+
 	bool setSelection(PageId const& page_id);
 
 	PageInfo selectionLeader() const;
@@ -185,7 +223,7 @@ private:
 				tag<ItemsByIdTag>,
 				const_mem_fun<Item, PageId const&, &Item::pageId>
 			>,
-			sequenced<tag<ItemsInOrderTag> >,
+			random_access<tag<ItemsInOrderTag> >,
 			sequenced<tag<SelectedThenUnselectedTag> >
 		>
 	> Container;
@@ -196,6 +234,40 @@ private:
 	
 	void invalidateThumbnailImpl(ItemsById::iterator id_it);
 
+	void sortAndLayoutItems();
+
+	void sceneAreaExposed(QRectF const& rect);
+
+	/**
+	 * Builds composite items for the items within (and near) the
+	 * exposed area of the scene, and destroys the ones that have
+	 * drifted far away from it.  Does nothing for the items that
+	 * already are in the state they are supposed to be in.
+	 */
+	void materializeExposedItems();
+
+	void materializeItem(Item const& item, size_t index);
+
+	void dematerializeItem(Item const& item);
+
+	/**
+	 * Moves the existing composite items to the positions dictated
+	 * by the current order of their items.
+	 */
+	void remeshMaterializedItems();
+
+	size_t itemIndex(Item const& item) const;
+
+	double slotStride() const;
+
+	QPointF itemPos(size_t index) const;
+
+	QRectF itemSceneRect(size_t index) const;
+
+	QRectF itemSceneRect(Item const& item) const;
+
+	void updateSceneRect();
+
 	void sceneContextMenuEvent(QGraphicsSceneContextMenuEvent* evt);
 
 	void selectItemNoModifiers(ItemsById::iterator const& it);
@@ -216,22 +288,21 @@ private:
 
 	/**
 	 * Calculates the insertion position for an item with the given PageId
-	 * based on m_ptrOrderProvider.
+	 * based on m_ptrOrderProvider.  The search is binary, relying on
+	 * [begin, end) being sorted according to m_ptrOrderProvider.
 	 *
 	 * \param begin Beginning of the interval to consider.
 	 * \param end End of the interval to consider.
 	 * \param page_id The item to find insertion position for.
 	 * \param page_incomplete Whether the page is represented by IncompleteThumbnail.
-	 * \param hint The place to start the search.  Must be within [begin, end].
-	 * \param dist_from_hint If provided, the distance from \p hint
-	 *        to the calculated insertion position will be written there.
-	 *        For example, \p dist_from_hint == -2 would indicate that the
-	 *        insertion position is two elements to the left of \p hint.
+	 * \param hint The preferred position.  Must be within [begin, end].
+	 *        To preserve stable ordering, it's returned as long as
+	 *        it's an acceptable position.
 	 */
 	ItemsInOrder::iterator itemInsertPosition(
 		ItemsInOrder::iterator begin, ItemsInOrder::iterator end,
 		PageId const& page_id, bool page_incomplete,
-		ItemsInOrder::iterator hint, int* dist_from_hint = 0);
+		ItemsInOrder::iterator hint);
 	
 	std::auto_ptr<QGraphicsItem> getThumbnail(PageInfo const& page_info);
 	
@@ -260,6 +331,23 @@ private:
 	IntrusivePtr<PageOrderProvider const> m_ptrOrderProvider;
 	GraphicsScene m_graphicsScene;
 	QRectF m_sceneRect;
+
+	/**
+	 * Every item occupies a slot of the same height, so the position
+	 * of an item follows from its index alone.  This is what makes
+	 * laying out a sequence of tens of thousands of pages a matter
+	 * of simple arithmetics.
+	 */
+	double m_slotHeight;
+
+	/** The exposed area of the scene, as of the most recent redraw. */
+	QRectF m_exposedRect;
+
+	/** The items that currently have composite items, in no particular order. */
+	std::vector<Item const*> m_materializedItems;
+
+	/** Pages flagged as near-duplicate suspects. */
+	std::set<PageId> m_duplicateSuspects;
 };
 
 
@@ -398,6 +486,18 @@ ThumbnailSequence::invalidateAllThumbnails()
 	m_ptrImpl->invalidateAllThumbnails();
 }
 
+void
+ThumbnailSequence::invalidateThumbnails(std::set<PageId> const& pages)
+{
+	m_ptrImpl->invalidateThumbnails(pages);
+}
+
+void
+ThumbnailSequence::setDuplicateSuspects(std::set<PageId> const& pages)
+{
+	m_ptrImpl->setDuplicateSuspects(pages);
+}
+
 bool
 ThumbnailSequence::setSelection(PageId const& page_id)
 {
@@ -468,12 +568,9 @@ ThumbnailSequence::selectedRanges() const
 
 void
 ThumbnailSequence::emitNewSelectionLeader(
-	PageInfo const& page_info, CompositeItem const* composite,
+	PageInfo const& page_info, QRectF const& thumb_rect,
 	SelectionFlags const flags)
 {
-	QRectF const thumb_rect(
-		composite->mapToScene(composite->boundingRect()).boundingRect()
-	);
 	emit newSelectionLeader(page_info, thumb_rect, flags);
 }
 
@@ -490,9 +587,23 @@ ThumbnailSequence::Impl::Impl(
 	m_selectedThenUnselected(m_items.get<SelectedThenUnselectedTag>()),
 	m_pSelectionLeader(0)
 {
+	// The slot has to be able to accommodate the tallest possible
+	// thumbnail plus its label, which may feature a sub-page icon
+	// taller than the text.
+	int const thumb_label_spacing = 1;
+	double const label_height = std::max<double>(
+		QApplication::fontMetrics().height(),
+		QPixmap(":/icons/left_page_thumb.png").height()
+	);
+	m_slotHeight = m_maxLogicalThumbSize.height()
+		+ thumb_label_spacing + label_height;
+
 	m_graphicsScene.setContextMenuEventCallback(
 		boost::lambda::bind(&Impl::sceneContextMenuEvent, this, boost::lambda::_1)
 	);
+	m_graphicsScene.setSceneExposedCallback(
+		boost::lambda::bind(&Impl::sceneAreaExposed, this, boost::lambda::_1)
+	);
 }
 
 ThumbnailSequence::Impl::~Impl()
@@ -510,6 +621,16 @@ void
 ThumbnailSequence::Impl::attachView(QGraphicsView* const view)
 {
 	view->setScene(&m_graphicsScene);
+
+	// Thumbnails cache their rendered appearance in device coordinates
+	// (see the ThumbnailBase constructor), with the pixmaps ending up
+	// in the global QPixmapCache.  The default limit is too small to
+	// hold a screenful of thumbnails, which would lead to cache
+	// thrashing while scrolling.
+	int const min_limit_kb = 64 * 1024;
+	if (QPixmapCache::cacheLimit() < min_limit_kb) {
+		QPixmapCache::setCacheLimit(min_limit_kb);
+	}
 }
 
 void
@@ -541,11 +662,11 @@ ThumbnailSequence::Impl::reset(
 
 	for (size_t i = 0; i < num_pages; ++i) {
 		PageInfo const& page_info(pages.pageAt(i));
-		
-		std::auto_ptr<CompositeItem> composite(getCompositeItem(0, page_info));
-		m_itemsInOrder.push_back(Item(page_info, composite.release()));
+
+		// Note that we don't build a composite item here.  That's
+		// done lazily, when the item makes it into view.
+		m_itemsInOrder.push_back(Item(page_info));
 		Item const* item = &m_itemsInOrder.back();
-		item->composite->setItem(item);
 
 		if (selected.find(page_info.id()) != selected.end()) {
 			item->setSelected(true);
@@ -568,7 +689,8 @@ ThumbnailSequence::Impl::reset(
 	if (m_pSelectionLeader) {
 		m_pSelectionLeader->setSelectionLeader(true);
 		m_rOwner.emitNewSelectionLeader(
-			selection_leader, m_pSelectionLeader->composite, DEFAULT_SELECTION_FLAGS
+			selection_leader, itemSceneRect(*m_pSelectionLeader),
+			DEFAULT_SELECTION_FLAGS
 		);
 	}
 }
@@ -613,22 +735,17 @@ ThumbnailSequence::Impl::invalidateThumbnail(PageInfo const& page_info)
 void
 ThumbnailSequence::Impl::invalidateThumbnailImpl(ItemsById::iterator const id_it)
 {
-	std::auto_ptr<CompositeItem> composite(
-		getCompositeItem(&*id_it, id_it->pageInfo)
-	);
-	CompositeItem* const new_composite = composite.get();
-	CompositeItem* const old_composite = id_it->composite;
-	QSizeF const old_size(old_composite->boundingRect().size());
-	QSizeF const new_size(new_composite->boundingRect().size());
-	QPointF const old_pos(new_composite->pos());
-	
-	new_composite->updateAppearence(id_it->isSelected(), id_it->isSelectionLeader());
-	
-	m_graphicsScene.addItem(composite.release());
-	id_it->composite = new_composite;
-	id_it->incompleteThumbnail = new_composite->incompleteThumbnail();
-	delete old_composite;
-	
+	size_t const old_index = itemIndex(*id_it);
+
+	// Rebuild the composite item (or build one for the first time)
+	// to pick up the new thumbnail and the new incompleteness status.
+	// If the item turns out to be far from the viewed area, the next
+	// materializeExposedItems() call will drop it again.
+	if (id_it->composite) {
+		dematerializeItem(*id_it);
+	}
+	materializeItem(*id_it, old_index);
+
 	ItemsInOrder::iterator after_old(m_items.project<ItemsInOrderTag>(id_it));
 	// Notice after_old++ below.
 
@@ -636,73 +753,47 @@ ThumbnailSequence::Impl::invalidateThumbnailImpl(ItemsById::iterator const id_it
 	// we are going to pass to itemInsertPosition().
 	m_itemsInOrder.relocate(m_itemsInOrder.begin(), after_old++);
 
-	int dist = 0;
 	ItemsInOrder::iterator const after_new(
 		itemInsertPosition(
 			++m_itemsInOrder.begin(), m_itemsInOrder.end(),
 			id_it->pageInfo.id(), id_it->incompleteThumbnail,
-			after_old, &dist
+			after_old
 		)
 	);
 
 	// Move our item to its intended position.
 	m_itemsInOrder.relocate(after_new, m_itemsInOrder.begin());
 
-
-	// Now let's reposition the items on the scene.
-	
-	ItemsInOrder::iterator ord_it, ord_end;
-
-	// The range of [ord_it, ord_end) is supposed to contain all items
-	// between the old and new positions of our item, with the new
-	// position in range.
-
-	if (dist <= 0) { // New position is before or equals to the old one.
-		ord_it = after_new;
-		--ord_it; // Include new item position in the range.
-		ord_end = after_old;
-	} else { // New position is after the old one.
-		ord_it = after_old;
-		ord_end = after_new;
-	}
-	
-	double offset = 0;
-
-	if (ord_it != m_itemsInOrder.begin()) {
-		ItemsInOrder::iterator prev(ord_it);
-		--prev;
-		offset = prev->composite->pos().y() + prev->composite->boundingRect().height() + SPACING;
+	// Only the items between the old and the new position shifted,
+	// each by exactly one slot, so that's the only range we have to
+	// reposition composite items in.  The scene rect doesn't change,
+	// as the number of items didn't.
+	size_t const new_index = itemIndex(*id_it);
+	size_t const range_first = std::min(old_index, new_index);
+	size_t const range_last = std::max(old_index, new_index);
+
+	BOOST_FOREACH(Item const* item, m_materializedItems) {
+		size_t const index = itemIndex(*item);
+		if (index >= range_first && index <= range_last) {
+			item->composite->setPos(itemPos(index));
+		}
 	}
 
-	// Reposition items between the old and the new position of our item,
-	// including the item itself.
-	for (; ord_it != ord_end; ++ord_it) {
-		ord_it->composite->setPos(0.0, offset);
-		offset += ord_it->composite->boundingRect().height() + SPACING;
+	if (range_first != range_last) {
+		// A single update covering the whole shifted range beats
+		// a pile of per-item ones.
+		m_graphicsScene.update(
+			itemSceneRect(range_first) | itemSceneRect(range_last)
+		);
 	}
 
-	// Reposition the items following both the new and the old position
-	// of the item, if the item size has changed.
-	if (old_size != new_size) {
-		for (; ord_it != m_itemsInOrder.end(); ++ord_it) {
-			ord_it->composite->setPos(0.0, offset);
-			offset += ord_it->composite->boundingRect().height() + SPACING;
-		}
-	}
-	
-	// Update scene rect.
-	m_sceneRect.setTop(m_sceneRect.bottom());
-	m_itemsInOrder.front().composite->updateSceneRect(m_sceneRect);
-	m_sceneRect.setBottom(m_sceneRect.top());
-	m_itemsInOrder.back().composite->updateSceneRect(m_sceneRect);
-	id_it->composite->updateSceneRect(m_sceneRect);
-	commitSceneRect();
+	materializeExposedItems();
 
 	// Possibly emit the newSelectionLeader() signal.
 	if (m_pSelectionLeader == &*id_it) {
-		if (old_size != new_size || old_pos != id_it->composite->pos()) {
+		if (old_index != new_index) {
 			m_rOwner.emitNewSelectionLeader(
-				id_it->pageInfo, id_it->composite, REDUNDANT_SELECTION
+				id_it->pageInfo, itemSceneRect(*id_it), REDUNDANT_SELECTION
 			);
 		}
 	}
@@ -711,19 +802,69 @@ ThumbnailSequence::Impl::invalidateThumbnailImpl(ItemsById::iterator const id_it
 void
 ThumbnailSequence::Impl::invalidateAllThumbnails()
 {
-	// Recreate thumbnails now, whether a thumbnail is incomplete
-	// is taken into account when sorting.
-	ItemsInOrder::iterator ord_it(m_itemsInOrder.begin());
-	ItemsInOrder::iterator const ord_end(m_itemsInOrder.end());
-	for (; ord_it != ord_end; ++ord_it) {
-		CompositeItem* const old_composite = ord_it->composite;
-		ord_it->composite = getCompositeItem(&*ord_it, ord_it->pageInfo).release();
-		ord_it->incompleteThumbnail = ord_it->composite->incompleteThumbnail();
-		delete old_composite;
+	// Drop all the composite items we have.  The ones in view will
+	// be recreated with fresh thumbnails by the sortAndLayoutItems()
+	// call below, and the rest lazily, when they make it into view.
+	while (!m_materializedItems.empty()) {
+		dematerializeItem(*m_materializedItems.back());
+	}
+
+	sortAndLayoutItems();
+}
+
+void
+ThumbnailSequence::Impl::invalidateThumbnails(std::set<PageId> const& pages)
+{
+	// Drop the composite items of the affected pages only.
+	// The rest keep theirs.
+	std::set<PageId>::const_iterator const pages_end(pages.end());
+
+	size_t i = 0;
+	while (i < m_materializedItems.size()) {
+		Item const& item = *m_materializedItems[i];
+		if (pages.find(item.pageInfo.id()) != pages_end) {
+			dematerializeItem(item); // Backfills position i.
+		} else {
+			++i;
+		}
+	}
+
+	sortAndLayoutItems();
+}
+
+void
+ThumbnailSequence::Impl::setDuplicateSuspects(std::set<PageId> const& pages)
+{
+	// Only the pages entering or leaving the set need their
+	// thumbnails (and therefore labels) rebuilt.
+	std::set<PageId> affected;
+	std::set_symmetric_difference(
+		m_duplicateSuspects.begin(), m_duplicateSuspects.end(),
+		pages.begin(), pages.end(),
+		std::inserter(affected, affected.end())
+	);
+
+	m_duplicateSuspects = pages;
+
+	if (!affected.empty()) {
+		invalidateThumbnails(affected);
 	}
+}
 
+void
+ThumbnailSequence::Impl::sortAndLayoutItems()
+{
 	// Sort pages in m_itemsInOrder using m_ptrOrderProvider.
 	if (m_ptrOrderProvider.get()) {
+		// Let the provider fetch every sort key from the filter
+		// settings once, rather than inside each comparison below.
+		std::vector<PageId> pages;
+		pages.reserve(m_itemsInOrder.size());
+		BOOST_FOREACH(Item const& item, m_itemsInOrder) {
+			pages.push_back(item.pageId());
+		}
+		m_ptrOrderProvider->precomputeKeys(pages);
+
 		m_itemsInOrder.sort(
 			boost::lambda::bind(
 				&PageOrderProvider::precedes, m_ptrOrderProvider.get(),
@@ -731,22 +872,19 @@ ThumbnailSequence::Impl::invalidateAllThumbnails()
 				boost::lambda::bind(&Item::pageId, boost::lambda::_2), bind(&Item::incompleteThumbnail, boost::lambda::_2)
 			)
 		);
-	}
-	
-	m_sceneRect = QRectF(0.0, 0.0, 0.0, 0.0);
-	double offset = 0;
 
-	for (ord_it = m_itemsInOrder.begin(); ord_it != ord_end; ++ord_it) {
-		CompositeItem* composite = ord_it->composite;
-		composite->setPos(0.0, offset);
-		composite->updateSceneRect(m_sceneRect);
-		composite->updateAppearence(ord_it->isSelected(), ord_it->isSelectionLeader());
-
-		offset += composite->boundingRect().height() + SPACING;
-		m_graphicsScene.addItem(composite);
+		// Single-page repositioning through itemInsertPosition() must
+		// not see keys cached above - they go stale the moment the
+		// user edits a page.
+		m_ptrOrderProvider->releaseKeys();
 	}
-	
+
+	remeshMaterializedItems();
+	updateSceneRect();
 	commitSceneRect();
+
+	// Bring in whatever ended up under the viewed area.
+	materializeExposedItems();
 }
 
 bool
@@ -790,7 +928,7 @@ ThumbnailSequence::Impl::setSelection(PageId const& page_id)
 		flags |= REDUNDANT_SELECTION;
 	}
 	
-	m_rOwner.emitNewSelectionLeader(id_it->pageInfo, id_it->composite, flags);
+	m_rOwner.emitNewSelectionLeader(id_it->pageInfo, itemSceneRect(*id_it), flags);
 
 	return true;
 }
@@ -907,72 +1045,43 @@ ThumbnailSequence::Impl::insert(
 		m_itemsInOrder.begin(), m_itemsInOrder.end(), page_info.id(),
 		/*page_incomplete=*/true, ord_it
 	);
-	
-	double offset = 0.0;
-	if (!m_items.empty()) {
-		if (ord_it != m_itemsInOrder.end()) {
-			offset = ord_it->composite->pos().y();
-		} else {
-			ItemsInOrder::iterator it(ord_it);
-			--it;
-			offset = it->composite->y()
-				+ it->composite->boundingRect().height() + SPACING;
-		}
-	}
-	std::auto_ptr<CompositeItem> composite(
-		getCompositeItem(0, page_info)
-	);
-	composite->setPos(0.0, offset);
-	composite->updateSceneRect(m_sceneRect);
-	
-	QPointF const pos_delta(0.0, composite->boundingRect().height() + SPACING);
-	
-	Item const item(page_info, composite.get());
-	std::pair<ItemsInOrder::iterator, bool> const ins(
-		m_itemsInOrder.insert(ord_it, item)
-	);
-	composite->setItem(&*ins.first);
-	m_graphicsScene.addItem(composite.release());
-	
-	ItemsInOrder::iterator const ord_end(m_itemsInOrder.end());
-	for (; ord_it != ord_end; ++ord_it) {
-		ord_it->composite->setPos(ord_it->composite->pos() + pos_delta);
-		ord_it->composite->updateSceneRect(m_sceneRect);
-	}
-	
+
+	m_itemsInOrder.insert(ord_it, Item(page_info));
+
+	// The items following the new one just shifted by one slot.
+	remeshMaterializedItems();
+	updateSceneRect();
 	commitSceneRect();
+	materializeExposedItems();
 }
 
 void
 ThumbnailSequence::Impl::removePages(std::set<PageId> const& to_remove)
 {
-	m_sceneRect = QRectF(0, 0, 0, 0);
-
 	std::set<PageId>::const_iterator const to_remove_end(to_remove.end());
-	QPointF pos_delta(0, 0);
 
 	ItemsInOrder::iterator ord_it(m_itemsInOrder.begin());
-	ItemsInOrder::iterator const ord_end(m_itemsInOrder.end());
-	while (ord_it != ord_end) {
+	while (ord_it != m_itemsInOrder.end()) {
 		if (to_remove.find(ord_it->pageInfo.id()) == to_remove_end) {
 			// Keeping this page.
-			if (pos_delta != QPointF(0, 0)) {
-				ord_it->composite->setPos(ord_it->composite->pos() + pos_delta);
-			}
-			ord_it->composite->updateSceneRect(m_sceneRect);
 			++ord_it;
 		} else {
 			// Removing this page.
 			if (m_pSelectionLeader == &*ord_it) {
 				m_pSelectionLeader = 0;
 			}
-			pos_delta.ry() -= ord_it->composite->boundingRect().height() + SPACING;
-			delete ord_it->composite;
+			if (ord_it->composite) {
+				dematerializeItem(*ord_it);
+			}
 			m_itemsInOrder.erase(ord_it++);
 		}
 	}
 
+	// The remaining items shift up to fill the vacated slots.
+	remeshMaterializedItems();
+	updateSceneRect();
 	commitSceneRect();
+	materializeExposedItems();
 }
 
 bool
@@ -1012,10 +1121,8 @@ ThumbnailSequence::Impl::selectionLeaderSceneRect() const
 	if (!m_pSelectionLeader) {
 		return QRectF();
 	}
-	
-	return m_pSelectionLeader->composite->mapToScene(
-		m_pSelectionLeader->composite->boundingRect()
-	).boundingRect();
+
+	return itemSceneRect(*m_pSelectionLeader);
 }
 
 std::set<PageId>
@@ -1066,11 +1173,8 @@ ThumbnailSequence::Impl::contextMenuRequested(
 void
 ThumbnailSequence::Impl::sceneContextMenuEvent(QGraphicsSceneContextMenuEvent* evt)
 {
-	if (!m_itemsInOrder.empty()) {
-		CompositeItem* composite = m_itemsInOrder.back().composite;
-		QRectF const last_thumb_rect(
-			composite->mapToScene(composite->boundingRect()).boundingRect()
-		);
+	if (!m_items.empty()) {
+		QRectF const last_thumb_rect(itemSceneRect(m_items.size() - 1));
 		if (evt->scenePos().y() <= last_thumb_rect.bottom()) {
 			return;
 		}
@@ -1109,7 +1213,7 @@ ThumbnailSequence::Impl::selectItemWithControl(ItemsById::iterator const& id_it)
 		
 		m_rOwner.emitNewSelectionLeader(
 			m_pSelectionLeader->pageInfo,
-			m_pSelectionLeader->composite, flags
+			itemSceneRect(*m_pSelectionLeader), flags
 		);
 		return;
 	}
@@ -1119,7 +1223,7 @@ ThumbnailSequence::Impl::selectItemWithControl(ItemsById::iterator const& id_it)
 		flags |= REDUNDANT_SELECTION;
 		m_rOwner.emitNewSelectionLeader(
 			m_pSelectionLeader->pageInfo,
-			m_pSelectionLeader->composite, flags
+			itemSceneRect(*m_pSelectionLeader), flags
 		);
 		return;
 	}
@@ -1160,9 +1264,9 @@ ThumbnailSequence::Impl::selectItemWithControl(ItemsById::iterator const& id_it)
 
 	m_pSelectionLeader->setSelectionLeader(true);
 	// No need to moveToSelected() as it was and remains selected.
-	
+
 	m_rOwner.emitNewSelectionLeader(
-		m_pSelectionLeader->pageInfo, m_pSelectionLeader->composite, flags
+		m_pSelectionLeader->pageInfo, itemSceneRect(*m_pSelectionLeader), flags
 	);
 }
 
@@ -1188,31 +1292,13 @@ ThumbnailSequence::Impl::selectItemWithShift(ItemsById::iterator const& id_it)
 		return;
 	}
 	
-	// The problem is that we don't know which endpoint precedes the other.
-	// Let's find out.
-	ItemsInOrder::iterator ord_it1(endpoint1);
-	ItemsInOrder::iterator ord_it2(endpoint1);
-	for (;;) {
-		if (ord_it1 != m_itemsInOrder.begin()) {
-			--ord_it1;
-			if (ord_it1 == endpoint2) {
-				// endpoint2 was found before endpoint1.
-				std::swap(endpoint1, endpoint2);
-				break;
-			}
-			
-		}
-		if (ord_it2 != m_itemsInOrder.end()) {
-			++ord_it2;
-			if (ord_it2 != m_itemsInOrder.end()) {
-				if (ord_it2 == endpoint2) {
-					// endpoint2 was found after endpoint1.
-					break;
-				}
-			}
-		}
+	// Make sure endpoint1 precedes endpoint2.  With a random access
+	// index, finding out which one goes first is a matter of
+	// comparing positions.
+	if (endpoint2 < endpoint1) {
+		std::swap(endpoint1, endpoint2);
 	}
-	
+
 	++endpoint2; // Make the interval inclusive.
 	for (; endpoint1 != endpoint2; ++endpoint1) {
 		endpoint1->setSelected(true);
@@ -1224,8 +1310,8 @@ ThumbnailSequence::Impl::selectItemWithShift(ItemsById::iterator const& id_it)
 	m_pSelectionLeader->setSelectionLeader(false);
 	m_pSelectionLeader = &*id_it;
 	m_pSelectionLeader->setSelectionLeader(true);
-	
-	m_rOwner.emitNewSelectionLeader(id_it->pageInfo, id_it->composite, flags);
+
+	m_rOwner.emitNewSelectionLeader(id_it->pageInfo, itemSceneRect(*id_it), flags);
 }
 
 void
@@ -1241,24 +1327,23 @@ ThumbnailSequence::Impl::selectItemNoModifiers(ItemsById::iterator const& id_it)
 	m_pSelectionLeader = &*id_it;
 	m_pSelectionLeader->setSelectionLeader(true);
 	moveToSelected(m_pSelectionLeader);
-	
-	m_rOwner.emitNewSelectionLeader(id_it->pageInfo, id_it->composite, flags);
+
+	m_rOwner.emitNewSelectionLeader(id_it->pageInfo, itemSceneRect(*id_it), flags);
 }
 
 void
 ThumbnailSequence::Impl::clear()
 {
 	m_pSelectionLeader = 0;
-	
-	ItemsInOrder::iterator it(m_itemsInOrder.begin());
-	ItemsInOrder::iterator const end(m_itemsInOrder.end());
-	while (it != end) {
-		delete it->composite;
-		m_itemsInOrder.erase(it++);
+
+	while (!m_materializedItems.empty()) {
+		dematerializeItem(*m_materializedItems.back());
 	}
-	
+
+	m_items.clear();
+
 	assert(m_graphicsScene.items().empty());
-	
+
 	m_sceneRect = QRectF(0.0, 0.0, 0.0, 0.0);
 	commitSceneRect();
 }
@@ -1280,57 +1365,59 @@ ThumbnailSequence::Impl::ItemsInOrder::iterator
 ThumbnailSequence::Impl::itemInsertPosition(
 	ItemsInOrder::iterator const begin, ItemsInOrder::iterator const end,
 	PageId const& page_id, bool const page_incomplete,
-	ItemsInOrder::iterator const hint, int* dist_from_hint)
+	ItemsInOrder::iterator const hint)
 {
-	// Note that to preserve stable ordering, this function *must* return hint,
-	// as long as it's an acceptable position.
-
 	if (!m_ptrOrderProvider.get()) {
-		if (dist_from_hint) {
-			*dist_from_hint = 0;
-		}
 		return hint;
 	}
 
-	ItemsInOrder::iterator ins_pos(hint);
-	int dist = 0;
-
-	// While the element immediately preceding ins_pos is supposed to
-	// follow the page we are inserting, move ins_pos one element back.
-	while (ins_pos != begin) {
-		ItemsInOrder::iterator prev(ins_pos);
+	if (hint != begin) {
+		ItemsInOrder::iterator prev(hint);
 		--prev;
-		bool const precedes = m_ptrOrderProvider->precedes(
-			page_id, page_incomplete, prev->pageId(), prev->incompleteThumbnail
-		);
-		if (precedes) {
-			ins_pos = prev;
-			--dist;
-		} else {
-			break;
+		if (m_ptrOrderProvider->precedes(
+				page_id, page_incomplete,
+				prev->pageId(), prev->incompleteThumbnail)) {
+			// The element immediately preceding the hint is supposed
+			// to follow the page.  Binary search in [begin, prev)
+			// for the first element that follows the page.
+			ItemsInOrder::iterator lo(begin), hi(prev);
+			while (lo != hi) {
+				ItemsInOrder::iterator const mid(lo + (hi - lo) / 2);
+				if (m_ptrOrderProvider->precedes(
+						page_id, page_incomplete,
+						mid->pageId(), mid->incompleteThumbnail)) {
+					hi = mid;
+				} else {
+					lo = mid + 1;
+				}
+			}
+			return lo;
 		}
 	}
 
-	// While the element pointed to by ins_pos is supposed to precede
-	// the page we are inserting, advance ins_pos.
-	while (ins_pos != end) {
-		bool const precedes = m_ptrOrderProvider->precedes(
-			ins_pos->pageId(), ins_pos->incompleteThumbnail,
-			page_id, page_incomplete
-		);
-		if (precedes) {
-			++ins_pos;
-			++dist;
-		} else {
-			break;
+	if (hint != end && m_ptrOrderProvider->precedes(
+			hint->pageId(), hint->incompleteThumbnail,
+			page_id, page_incomplete)) {
+		// The element at the hint is supposed to precede the page.
+		// Binary search in (hint, end) for the first element that
+		// doesn't.
+		ItemsInOrder::iterator lo(hint + 1), hi(end);
+		while (lo != hi) {
+			ItemsInOrder::iterator const mid(lo + (hi - lo) / 2);
+			if (m_ptrOrderProvider->precedes(
+					mid->pageId(), mid->incompleteThumbnail,
+					page_id, page_incomplete)) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
 		}
+		return lo;
 	}
 
-	if (dist_from_hint) {
-		*dist_from_hint = dist;
-	}
-
-	return ins_pos;
+	// Neither neighbour objects, and we must return an acceptable
+	// hint to preserve stable ordering.
+	return hint;
 }
 
 std::auto_ptr<QGraphicsItem>
@@ -1362,6 +1449,9 @@ ThumbnailSequence::Impl::getLabelGroup(PageInfo const& page_info)
 			"%1 (page %2)"
 		).arg(file_name).arg(page_id.imageId().page());
 	}
+	if (m_duplicateSuspects.find(page_id) != m_duplicateSuspects.end()) {
+		text = ThumbnailSequence::tr("%1 [duplicate?]").arg(text);
+	}
 	
 	std::auto_ptr<QGraphicsSimpleTextItem> normal_text_item(new QGraphicsSimpleTextItem);
 	normal_text_item->setText(text);
@@ -1429,13 +1519,176 @@ ThumbnailSequence::Impl::commitSceneRect()
 	}
 }
 
+void
+ThumbnailSequence::Impl::sceneAreaExposed(QRectF const& rect)
+{
+	m_exposedRect = rect;
+	materializeExposedItems();
+}
+
+void
+ThumbnailSequence::Impl::materializeExposedItems()
+{
+	if (m_items.empty() || m_exposedRect.isNull()) {
+		return;
+	}
+
+	double const stride = slotStride();
+	double const exposed_height = std::max(m_exposedRect.height(), stride);
+
+	// Items within one screenful of the exposed area get composite
+	// items, while the ones that have drifted more than three
+	// screenfuls away lose theirs.  The difference between the two
+	// thresholds prevents thrashing at the boundary when scrolling.
+	double const drop_top = m_exposedRect.top() - 3.0 * exposed_height;
+	double const drop_bottom = m_exposedRect.bottom() + 3.0 * exposed_height;
+
+	bool changed = false;
+
+	size_t i = 0;
+	while (i < m_materializedItems.size()) {
+		Item const& item = *m_materializedItems[i];
+		double const top = item.composite->pos().y();
+		if (top + m_slotHeight < drop_top || top > drop_bottom) {
+			dematerializeItem(item); // Backfills position i.
+			changed = true;
+		} else {
+			++i;
+		}
+	}
+
+	int const last_index = int(m_items.size()) - 1;
+	int const first = qBound(
+		0, int(floor((m_exposedRect.top() - exposed_height) / stride)),
+		last_index
+	);
+	int const last = qBound(
+		0, int(floor((m_exposedRect.bottom() + exposed_height) / stride)),
+		last_index
+	);
+
+	ItemsInOrder::iterator ord_it(m_itemsInOrder.begin() + first);
+	for (int idx = first; idx <= last; ++idx, ++ord_it) {
+		if (!ord_it->composite) {
+			materializeItem(*ord_it, idx);
+			changed = true;
+		}
+	}
+
+	// Composite items added from within a redraw don't make it into
+	// the current frame, so schedule another one.  This terminates,
+	// as the next time around there will be nothing left to do.
+	if (changed) {
+		m_graphicsScene.update();
+	}
+}
+
+void
+ThumbnailSequence::Impl::materializeItem(Item const& item, size_t const index)
+{
+	assert(!item.composite);
+
+	std::auto_ptr<CompositeItem> composite(
+		getCompositeItem(&item, item.pageInfo)
+	);
+	item.composite = composite.release();
+	item.incompleteThumbnail = item.composite->incompleteThumbnail();
+	item.composite->setPos(itemPos(index));
+	item.composite->updateAppearence(item.isSelected(), item.isSelectionLeader());
+	m_graphicsScene.addItem(item.composite);
+	m_materializedItems.push_back(&item);
+}
+
+void
+ThumbnailSequence::Impl::dematerializeItem(Item const& item)
+{
+	assert(item.composite);
+
+	std::vector<Item const*>::iterator const it(
+		std::find(m_materializedItems.begin(), m_materializedItems.end(), &item)
+	);
+	assert(it != m_materializedItems.end());
+	*it = m_materializedItems.back();
+	m_materializedItems.pop_back();
+
+	// Deleting a graphics item removes it from the scene.
+	delete item.composite;
+	item.composite = 0;
+}
+
+void
+ThumbnailSequence::Impl::remeshMaterializedItems()
+{
+	BOOST_FOREACH(Item const* item, m_materializedItems) {
+		item->composite->setPos(itemPos(itemIndex(*item)));
+		item->composite->updateAppearence(
+			item->isSelected(), item->isSelectionLeader()
+		);
+	}
+}
+
+size_t
+ThumbnailSequence::Impl::itemIndex(Item const& item) const
+{
+	// Both iterator_to() and the subtraction are constant time
+	// operations for a random access index.
+	return m_itemsInOrder.iterator_to(item) - m_itemsInOrder.begin();
+}
+
+double
+ThumbnailSequence::Impl::slotStride() const
+{
+	return m_slotHeight + SPACING;
+}
+
+QPointF
+ThumbnailSequence::Impl::itemPos(size_t const index) const
+{
+	return QPointF(0.0, index * slotStride());
+}
+
+QRectF
+ThumbnailSequence::Impl::itemSceneRect(size_t const index) const
+{
+	return QRectF(
+		-0.5 * m_maxLogicalThumbSize.width(), index * slotStride(),
+		m_maxLogicalThumbSize.width(), m_slotHeight
+	);
+}
+
+QRectF
+ThumbnailSequence::Impl::itemSceneRect(Item const& item) const
+{
+	if (item.composite) {
+		return item.composite->mapToScene(
+			item.composite->boundingRect()
+		).boundingRect();
+	}
+
+	return itemSceneRect(itemIndex(item));
+}
+
+void
+ThumbnailSequence::Impl::updateSceneRect()
+{
+	if (m_items.empty()) {
+		m_sceneRect = QRectF(0.0, 0.0, 0.0, 0.0);
+	} else {
+		m_sceneRect = QRectF(
+			-0.5 * m_maxLogicalThumbSize.width(), 0.0,
+			m_maxLogicalThumbSize.width(),
+			m_items.size() * slotStride() - SPACING
+		);
+	}
+}
+
 
 /*==================== ThumbnailSequence::Item ======================*/
 
-ThumbnailSequence::Item::Item(PageInfo const& page_info, CompositeItem* comp_item)
+ThumbnailSequence::Item::Item(PageInfo const& page_info)
 :	pageInfo(page_info),
-	composite(comp_item),
-	incompleteThumbnail(comp_item->incompleteThumbnail()),
+	composite(0),
+	incompleteThumbnail(true),
 	m_isSelected(false),
 	m_isSelectionLeader(false)
 {
@@ -1448,7 +1701,13 @@ ThumbnailSequence::Item::setSelected(bool selected) const
 	bool const was_selection_leader = m_isSelectionLeader;
 	m_isSelected = selected;
 	m_isSelectionLeader = m_isSelectionLeader && selected;
-	
+
+	// A composite item, if we currently have one, picks the state
+	// up from here.  Otherwise it will, when it gets built.
+	if (!composite) {
+		return;
+	}
+
 	if (was_selected != m_isSelected || was_selection_leader != m_isSelectionLeader) {
 		composite->updateAppearence(m_isSelected, m_isSelectionLeader);
 	}
@@ -1464,7 +1723,11 @@ ThumbnailSequence::Item::setSelectionLeader(bool selection_leader) const
 	bool const was_selection_leader = m_isSelectionLeader;
 	m_isSelected = m_isSelected || selection_leader;
 	m_isSelectionLeader = selection_leader;
-	
+
+	if (!composite) {
+		return;
+	}
+
 	if (was_selected != m_isSelected || was_selection_leader != m_isSelectionLeader) {
 		composite->updateAppearence(m_isSelected, m_isSelectionLeader);
 	}
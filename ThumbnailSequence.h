@@ -103,7 +103,7 @@ public:
 	/**
 	 * \brief Updates appearance and possibly position of a thumbnail.
 	 *
-	 * If thumbnail's size or position have changed and this thumbnail
+	 * If thumbnail's position has changed and this thumbnail
 	 * is a selection leader, newSelectionLeader() signal will be emitted
 	 * with REDUNDANT_SELECTION flag set.
 	 *
@@ -128,6 +128,26 @@ public:
 	 * was specified by the most recent reset() call.
 	 */
 	void invalidateAllThumbnails();
+
+	/**
+	 * \brief Marks the given pages as near-duplicate suspects.
+	 *
+	 * Replaces the previously set suspects.  A suspect page gets a
+	 * warning marker in its thumbnail label.  The thumbnails of
+	 * pages entering or leaving the set are rebuilt.
+	 */
+	void setDuplicateSuspects(std::set<PageId> const& pages);
+
+	/**
+	 * \brief Same as invalidateAllThumbnails(), but only rebuilds
+	 *        the thumbnails of the specified pages.
+	 *
+	 * Re-sorting and repositioning still covers the whole sequence,
+	 * but those are cheap compared to rebuilding thumbnails, which
+	 * is what makes this one preferable when the affected pages are
+	 * known.
+	 */
+	void invalidateThumbnails(std::set<PageId> const& pages);
 	
 	/**
 	 * \brief Makes the item a selection leader, and unselects other items.
@@ -232,7 +252,7 @@ private:
 	class CompositeItem;
 	
 	void emitNewSelectionLeader(
-		PageInfo const& page_info, CompositeItem const* composite,
+		PageInfo const& page_info, QRectF const& thumb_rect,
 		SelectionFlags flags);
 	
 	std::auto_ptr<Impl> m_ptrImpl;
@@ -21,6 +21,7 @@
 #include "NonCopyable.h"
 #include "Dpi.h"
 #include "Dpm.h"
+#include "imageproc/ParallelFor.h"
 #include <QtGlobal>
 #include <QSysInfo>
 #include <QIODevice>
@@ -28,12 +29,29 @@
 #include <QColor>
 #include <QSize>
 #include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QVector>
+#include <QThreadStorage>
 #include <algorithm>
+#include <vector>
+#include <list>
 #include <tiff.h>
 #include <tiffio.h>
 #include <new>
+#include <string.h>
 #include <assert.h>
 
+#if defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 class TiffReader::TiffHeader
 {
 public:
@@ -96,6 +114,31 @@ private:
 };
 
 
+/**
+ * \brief Returns a per-thread buffer of at least \p size bytes.
+ *
+ * The buffer grows to the largest size requested on the calling
+ * thread and is then reused, so decoding a batch of similarly sized
+ * pages doesn't go to the heap for every one of them.  The returned
+ * pointer stays valid until the next call from the same thread.
+ */
+static uint8* threadLocalStripBuffer(size_t const size)
+{
+	static QThreadStorage<std::vector<uint8>*> storage;
+
+	std::vector<uint8>* buf = storage.localData();
+	if (!buf) {
+		buf = new std::vector<uint8>;
+		storage.setLocalData(buf);
+	}
+	if (buf->size() < size) {
+		buf->resize(size);
+	}
+
+	return size == 0 ? 0 : &(*buf)[0];
+}
+
+
 struct TiffReader::TiffInfo
 {
 	int width;
@@ -215,6 +258,370 @@ static void deviceUnmap(thandle_t, tdata_t, toff_t)
 }
 
 
+/**
+ * \brief A per-handle view over a QIODevice shared by multiple TIFF handles.
+ *
+ * libtiff handles are not thread-safe, so threads decoding strips in
+ * parallel each open their own handle.  Those handles however share a
+ * single QIODevice, which is not thread-safe either.  Each handle
+ * therefore goes through one of these views, which tracks the handle's
+ * own file offset and serializes actual device access with a mutex.
+ */
+struct SharedDeviceView
+{
+	QIODevice* dev;
+	QMutex* mutex;
+	qint64 pos;
+
+	SharedDeviceView(QIODevice* dev, QMutex* mutex)
+	: dev(dev), mutex(mutex), pos(0) {}
+};
+
+static tsize_t sharedViewRead(thandle_t context, tdata_t data, tsize_t size)
+{
+	SharedDeviceView* view = (SharedDeviceView*)context;
+	QMutexLocker const locker(view->mutex);
+	if (!view->dev->seek(view->pos)) {
+		return 0;
+	}
+	tsize_t const bytes_read = (tsize_t)view->dev->read(
+		static_cast<char*>(data), size
+	);
+	if (bytes_read > 0) {
+		view->pos += bytes_read;
+	}
+	return bytes_read;
+}
+
+static toff_t sharedViewSeek(thandle_t context, toff_t offset, int whence)
+{
+	SharedDeviceView* view = (SharedDeviceView*)context;
+
+	switch (whence) {
+		case SEEK_SET:
+			view->pos = offset;
+			break;
+		case SEEK_CUR:
+			view->pos += offset;
+			break;
+		case SEEK_END: {
+			QMutexLocker const locker(view->mutex);
+			view->pos = view->dev->size() + offset;
+			break;
+		}
+	}
+
+	return view->pos;
+}
+
+static int sharedViewClose(thandle_t)
+{
+	// The device is shared with other handles and outlives them all.
+	return 0;
+}
+
+static toff_t sharedViewSize(thandle_t context)
+{
+	SharedDeviceView* view = (SharedDeviceView*)context;
+	QMutexLocker const locker(view->mutex);
+	return view->dev->size();
+}
+
+
+static void unpackTiffScanline(
+	uint8 const* src, uint8* dst, int const width, int const bits_per_sample)
+{
+	unsigned const dst_mask = (1 << bits_per_sample) - 1;
+
+	unsigned accum = 0;
+	int bits_in_accum = 0;
+
+	for (int i = width; i > 0; --i, ++dst) {
+		while (bits_in_accum < bits_per_sample) {
+			accum <<= 8;
+			accum |= *src;
+			bits_in_accum += 8;
+			++src;
+		}
+		bits_in_accum -= bits_per_sample;
+		*dst = static_cast<uint8>((accum >> bits_in_accum) & dst_mask);
+	}
+}
+
+static bool buildIndexedColorTable(
+	TIFF* tif, uint16 const photometric, int const bits_per_sample,
+	bool const swap_palette_endianness, QVector<QRgb>& table)
+{
+	int const num_colors = 1 << bits_per_sample;
+	table.resize(num_colors);
+
+	if (photometric == PHOTOMETRIC_PALETTE) {
+		uint16* pr = 0;
+		uint16* pg = 0;
+		uint16* pb = 0;
+		TIFFGetField(tif, TIFFTAG_COLORMAP, &pr, &pg, &pb);
+		if (!pr || !pg || !pb) {
+			return false;
+		}
+		if (swap_palette_endianness) {
+			TIFFSwabArrayOfShort(pr, num_colors);
+			TIFFSwabArrayOfShort(pg, num_colors);
+			TIFFSwabArrayOfShort(pb, num_colors);
+		}
+		double const f = 255.0/65535.0;
+		for (int i = 0; i < num_colors; ++i) {
+			uint32 const r = (uint32)(pr[i] * f + 0.5);
+			uint32 const g = (uint32)(pg[i] * f + 0.5);
+			uint32 const b = (uint32)(pb[i] * f + 0.5);
+			uint32 const a = 0xFF000000;
+			table[i] = a | (r << 16) | (g << 8) | b;
+		}
+	} else if (photometric == PHOTOMETRIC_MINISBLACK) {
+		double const f = 255.0 / (num_colors - 1);
+		for (int i = 0; i < num_colors; ++i) {
+			int const gray = (int)(i * f + 0.5);
+			table[i] = qRgb(gray, gray, gray);
+		}
+	} else if (photometric == PHOTOMETRIC_MINISWHITE) {
+		double const f = 255.0 / (num_colors - 1);
+		int c = num_colors - 1;
+		for (int i = 0; i < num_colors; ++i, --c) {
+			int const gray = (int)(c * f + 0.5);
+			table[i] = qRgb(gray, gray, gray);
+		}
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+
+#if defined(Q_OS_UNIX)
+
+/**
+ * \brief Keeps file mappings alive for as long as QImages wrap them.
+ *
+ * QImage in Qt4 provides no way to get notified when an image over
+ * an external buffer is destroyed.  Instead, a shallow copy of each
+ * wrapping image is kept here; once it reports isDetached(), no one
+ * else shares the pixel data any more and the mapping can be torn
+ * down.  Stale mappings are collected whenever a new one is added,
+ * which is cheap: clean pages of a file mapping are reclaimable by
+ * the OS at any time anyway.
+ */
+class MappedImageRegistry
+{
+public:
+	MappedImageRegistry() {}
+
+	void add(void* base, size_t length, QImage const& image);
+private:
+	struct Entry
+	{
+		void* base;
+		size_t length;
+		QImage image;
+
+		Entry(void* base, size_t length, QImage const& image)
+		: base(base), length(length), image(image) {}
+	};
+
+	/** Must be called with the mutex held. */
+	void collectGarbageLocked();
+
+	QMutex m_mutex;
+	std::list<Entry> m_entries;
+};
+
+
+static MappedImageRegistry mapped_image_registry;
+
+
+void
+MappedImageRegistry::add(void* base, size_t length, QImage const& image)
+{
+	QMutexLocker const locker(&m_mutex);
+	collectGarbageLocked();
+	m_entries.push_back(Entry(base, length, image));
+}
+
+void
+MappedImageRegistry::collectGarbageLocked()
+{
+	std::list<Entry>::iterator it(m_entries.begin());
+	while (it != m_entries.end()) {
+		if (it->image.isDetached()) {
+			void* const base = it->base;
+			size_t const length = it->length;
+			it = m_entries.erase(it); // Destroys the QImage first.
+			munmap(base, length);
+		} else {
+			++it;
+		}
+	}
+}
+
+#endif // Q_OS_UNIX
+
+
+namespace
+{
+
+/**
+ * \brief Remembers directory offsets of recently used multi-page TIFFs.
+ *
+ * TIFFSetDirectory() walks the directory chain from the beginning of
+ * the file, which makes loading a multi-page file page by page
+ * quadratic in the number of pages.  With the offsets of already
+ * visited directories remembered, a sequential pass over such a file
+ * jumps straight to each page instead.
+ */
+class TiffDirectoryIndexCache
+{
+public:
+	/**
+	 * \brief Retrieves remembered directory offsets for this file.
+	 *
+	 * Leaves \p offsets empty if the file is not in the cache or
+	 * has changed since its offsets were remembered.
+	 */
+	void lookup(
+		QString const& file_path, qint64 const file_size,
+		uint const mtime, QVector<quint64>& offsets)
+	{
+		QMutexLocker const locker(&m_mutex);
+
+		std::list<Entry>::iterator it(m_entries.begin());
+		std::list<Entry>::iterator const end(m_entries.end());
+		for (; it != end; ++it) {
+			if (it->filePath != file_path) {
+				continue;
+			}
+			if (it->fileSize != file_size || it->mtime != mtime) {
+				m_entries.erase(it);
+				return;
+			}
+			m_entries.splice(m_entries.begin(), m_entries, it);
+			offsets = it->dirOffsets;
+			return;
+		}
+	}
+
+	void store(
+		QString const& file_path, qint64 const file_size,
+		uint const mtime, QVector<quint64> const& offsets)
+	{
+		QMutexLocker const locker(&m_mutex);
+
+		std::list<Entry>::iterator it(m_entries.begin());
+		std::list<Entry>::iterator const end(m_entries.end());
+		for (; it != end; ++it) {
+			if (it->filePath == file_path) {
+				break;
+			}
+		}
+		if (it == end) {
+			m_entries.push_front(Entry());
+			it = m_entries.begin();
+			it->filePath = file_path;
+		} else {
+			m_entries.splice(m_entries.begin(), m_entries, it);
+		}
+		it->fileSize = file_size;
+		it->mtime = mtime;
+		it->dirOffsets = offsets;
+
+		while (m_entries.size() > size_t(MAX_ENTRIES)) {
+			m_entries.pop_back();
+		}
+	}
+private:
+	struct Entry
+	{
+		QString filePath;
+		qint64 fileSize;
+		uint mtime;
+		QVector<quint64> dirOffsets;
+
+		Entry() : fileSize(0), mtime(0) {}
+	};
+
+	enum { MAX_ENTRIES = 4 };
+
+	QMutex m_mutex;
+	std::list<Entry> m_entries; /**< Most recently used first. */
+};
+
+TiffDirectoryIndexCache tiff_directory_index_cache;
+
+/**
+ * Positions \p tif at \p page_num, extending \p offsets with the
+ * offsets of the directories visited along the way.
+ */
+bool seekToPageIndexed(TIFF* tif, int const page_num, QVector<quint64>& offsets)
+{
+	// The first directory is current right after opening.
+	if (offsets.isEmpty()) {
+		offsets.append(TIFFCurrentDirOffset(tif));
+	}
+
+	if (page_num < offsets.size()) {
+		return TIFFSetSubDirectory(tif, (toff_t)offsets[page_num]);
+	}
+
+	if (!TIFFSetSubDirectory(tif, (toff_t)offsets.last())) {
+		return false;
+	}
+	while (offsets.size() <= page_num) {
+		if (!TIFFReadDirectory(tif)) {
+			return false;
+		}
+		offsets.append(TIFFCurrentDirOffset(tif));
+	}
+	return true;
+}
+
+/**
+ * Like TIFFSetDirectory(), but goes through TiffDirectoryIndexCache
+ * when the device is a file, so that page-by-page access to a
+ * multi-page file doesn't re-walk the directory chain every time.
+ */
+bool seekToPage(QIODevice& device, TIFF* tif, int const page_num)
+{
+	if (page_num == 0) {
+		// The first directory is current right after opening.
+		return true;
+	}
+
+	QFile const* file = qobject_cast<QFile const*>(&device);
+	if (!file || file->fileName().isEmpty()) {
+		return TIFFSetDirectory(tif, page_num);
+	}
+
+	QFileInfo const file_info(file->fileName());
+	qint64 const file_size = file_info.size();
+	uint const mtime = file_info.lastModified().toTime_t();
+
+	QVector<quint64> offsets;
+	tiff_directory_index_cache.lookup(
+		file->fileName(), file_size, mtime, offsets
+	);
+
+	bool const ok = seekToPageIndexed(tif, page_num, offsets);
+
+	// Offsets gathered on the way are valid even if we failed
+	// to reach the requested page.
+	tiff_directory_index_cache.store(
+		file->fileName(), file_size, mtime, offsets
+	);
+
+	return ok;
+}
+
+} // anonymous namespace
+
+
 bool
 TiffReader::canRead(QIODevice& device)
 {
@@ -258,10 +665,23 @@ TiffReader::readMetadata(
 		return ImageMetadataLoader::GENERIC_ERROR;
 	}
 	
+	QVector<quint64> dir_offsets;
 	do {
+		dir_offsets.append(TIFFCurrentDirOffset(tif.handle()));
 		out(currentPageMetadata(tif));
 	} while (TIFFReadDirectory(tif.handle()));
-	
+
+	// We've just walked the whole directory chain, so remember it
+	// for the page loads that typically follow.
+	QFile const* file = qobject_cast<QFile const*>(&device);
+	if (file && !file->fileName().isEmpty()) {
+		QFileInfo const file_info(file->fileName());
+		tiff_directory_index_cache.store(
+			file->fileName(), file_info.size(),
+			file_info.lastModified().toTime_t(), dir_offsets
+		);
+	}
+
 	return ImageMetadataLoader::LOADED;
 }
 
@@ -304,7 +724,7 @@ TiffReader::readImage(QIODevice& device, int const page_num)
 		return QImage();
 	}
 	
-	if (!TIFFSetDirectory(tif.handle(), page_num)) {
+	if (!seekToPage(device, tif.handle(), page_num)) {
 		return QImage();
 	}
 	
@@ -315,8 +735,22 @@ TiffReader::readImage(QIODevice& device, int const page_num)
 	QImage image;
 	
 	if (info.mapsToBinaryOrIndexed8()) {
+		QVector<QRgb> color_table;
+		if (!buildIndexedColorTable(
+				tif.handle(), info.photometric, info.bits_per_sample,
+				info.host_big_endian != info.file_big_endian, color_table)) {
+			return QImage();
+		}
+
+		image = mapUncompressedImage(device, tif, info, color_table, metadata);
+		if (!image.isNull()) {
+			// The dpi is already set, and the image must not be
+			// modified once it's registered for unmapping.
+			return image;
+		}
+
 		// Common case optimization.
-		image = extractBinaryOrIndexed8Image(tif, info);
+		image = extractBinaryOrIndexed8Image(device, tif, info, color_table);
 	} else {
 		// General case.
 		image = QImage(
@@ -427,9 +861,136 @@ TiffReader::getDpi(float xres, float yres, unsigned res_unit)
 	return Dpi();
 }
 
+/**
+ * \brief Wraps uncompressed pixel data of a memory-mapped file, if possible.
+ *
+ * When an image is stored uncompressed, row-contiguous and in a layout
+ * QImage can represent directly, there is no point copying it through
+ * libtiff.  Mapping the file and wrapping the pixel data in place makes
+ * loading nearly instant, with pages read in lazily on actual access.
+ * The mapping is copy-on-write, so a stray write into the image dirties
+ * anonymous pages rather than crashing or altering the file.
+ *
+ * \return The wrapping image, or a null image if the layout doesn't
+ *         permit zero-copy access.
+ */
+QImage
+TiffReader::mapUncompressedImage(
+	QIODevice& device, TiffHandle const& tif, TiffInfo const& info,
+	QVector<QRgb> const& color_table, ImageMetadata const& metadata)
+{
+#if defined(Q_OS_UNIX)
+	if (info.bits_per_sample != 1 && info.bits_per_sample != 8) {
+		return QImage();
+	}
+
+	QFile* const file = qobject_cast<QFile*>(&device);
+	if (!file || file->fileName().isEmpty()) {
+		return QImage();
+	}
+
+	uint16 compression = COMPRESSION_NONE;
+	TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_COMPRESSION, &compression);
+	if (compression != COMPRESSION_NONE) {
+		return QImage();
+	}
+
+	uint16 orientation = ORIENTATION_TOPLEFT;
+	TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_ORIENTATION, &orientation);
+	if (orientation != ORIENTATION_TOPLEFT) {
+		return QImage();
+	}
+
+	if (info.bits_per_sample == 1) {
+		// QImage::Format_Mono expects the most significant bit first.
+		uint16 fill_order = FILLORDER_MSB2LSB;
+		TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_FILLORDER, &fill_order);
+		if (fill_order != FILLORDER_MSB2LSB) {
+			return QImage();
+		}
+	}
+
+	if (TIFFIsTiled(tif.handle())) {
+		return QImage();
+	}
+
+	tsize_t const scanline_size = TIFFScanlineSize(tif.handle());
+	if (scanline_size <= 0) {
+		return QImage();
+	}
+
+	uint32 rows_per_strip = 0;
+	TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+	if (rows_per_strip == 0 || rows_per_strip > (uint32)info.height) {
+		rows_per_strip = info.height;
+	}
+
+#if TIFFLIB_VERSION >= 20111221
+	uint64* offsets = 0;
+#else
+	uint32* offsets = 0;
+#endif
+	if (!TIFFGetField(tif.handle(), TIFFTAG_STRIPOFFSETS, &offsets) || !offsets) {
+		return QImage();
+	}
+
+	int const num_strips = (int)(
+		((uint32)info.height + rows_per_strip - 1) / rows_per_strip
+	);
+	qint64 const strip_stride = (qint64)rows_per_strip * scanline_size;
+	qint64 const data_offset = (qint64)offsets[0];
+	for (int i = 1; i < num_strips; ++i) {
+		if ((qint64)offsets[i] != data_offset + i * strip_stride) {
+			// Strips are not contiguous in the file.
+			return QImage();
+		}
+	}
+
+	qint64 const data_end = data_offset + (qint64)info.height * scanline_size;
+	if (data_end > file->size()) {
+		return QImage();
+	}
+
+	QByteArray const file_path(QFile::encodeName(file->fileName()));
+	int const fd = open(file_path.constData(), O_RDONLY);
+	if (fd == -1) {
+		return QImage();
+	}
+	size_t const map_length = (size_t)data_end;
+	void* const base = mmap(0, map_length, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd); // The mapping keeps its own reference.
+	if (base == MAP_FAILED) {
+		return QImage();
+	}
+
+	QImage image(
+		(uchar*)base + data_offset, info.width, info.height, scanline_size,
+		info.bits_per_sample == 1 ? QImage::Format_Mono : QImage::Format_Indexed8
+	);
+	if (image.isNull()) {
+		munmap(base, map_length);
+		return QImage();
+	}
+
+	image.setColorTable(color_table);
+	if (!metadata.dpi().isNull()) {
+		Dpm const dpm(metadata.dpi());
+		image.setDotsPerMeterX(dpm.horizontal());
+		image.setDotsPerMeterY(dpm.vertical());
+	}
+
+	mapped_image_registry.add(base, map_length, image);
+
+	return image;
+#else
+	return QImage();
+#endif
+}
+
 QImage
 TiffReader::extractBinaryOrIndexed8Image(
-	TiffHandle const& tif, TiffInfo const& info)
+	QIODevice& device, TiffHandle const& tif, TiffInfo const& info,
+	QVector<QRgb> const& color_table)
 {
 	QImage::Format format = QImage::Format_Indexed8;
 	if (info.bits_per_sample == 1) {
@@ -437,65 +998,165 @@ TiffReader::extractBinaryOrIndexed8Image(
 		// always use Format_Mono, and not Format_MonoLSB.
 		format = QImage::Format_Mono;
 	}
-	
+
 	QImage image(info.width, info.height, format);
 	if (image.isNull()) {
 		throw std::bad_alloc();
 	}
-	
-	int const num_colors = 1 << info.bits_per_sample;
-	image.setNumColors(num_colors);
-	
-	if (info.photometric == PHOTOMETRIC_PALETTE) {
-		uint16* pr = 0;
-		uint16* pg = 0;
-		uint16* pb = 0;
-		TIFFGetField(tif.handle(), TIFFTAG_COLORMAP, &pr, &pg, &pb);
-		if (!pr || !pg || !pb) {
-			return QImage();
-		}
-		if (info.host_big_endian != info.file_big_endian) {
-			TIFFSwabArrayOfShort(pr, num_colors);
-			TIFFSwabArrayOfShort(pg, num_colors);
-			TIFFSwabArrayOfShort(pb, num_colors);
-		}
-		double const f = 255.0/65535.0;
-		for (int i = 0; i < num_colors; ++i) {
-			uint32 const r = (uint32)(pr[i] * f + 0.5);
-			uint32 const g = (uint32)(pg[i] * f + 0.5);
-			uint32 const b = (uint32)(pb[i] * f + 0.5);
-			uint32 const a = 0xFF000000;
-			image.setColor(i, a | (r << 16) | (g << 8) | b);
-		}
-	} else if (info.photometric == PHOTOMETRIC_MINISBLACK) {
-		double const f = 255.0 / (num_colors - 1);
-		for (int i = 0; i < num_colors; ++i) {
-			int const gray = (int)(i * f + 0.5);
-			image.setColor(i, qRgb(gray, gray, gray));
-		}
-	} else if (info.photometric == PHOTOMETRIC_MINISWHITE) {
-		double const f = 255.0 / (num_colors - 1);
-		int c = num_colors - 1;
-		for (int i = 0; i < num_colors; ++i, --c) {
-			int const gray = (int)(c * f + 0.5);
-			image.setColor(i, qRgb(gray, gray, gray));
-		}
-	} else {
-		return QImage();
-	}
-	
+
+	image.setColorTable(color_table);
+
 	if (info.bits_per_sample == 1 || info.bits_per_sample == 8) {
-		readLines(tif, image);
+		readLines(device, tif, info, image);
 	} else {
-		readAndUnpackLines(tif, info, image);
+		readAndUnpackLines(device, tif, info, image);
 	}
-	
+
 	return image;
 }
 
+/**
+ * \brief Decodes ranges of TIFF strips, possibly from a worker thread.
+ *
+ * Strips are compressed independently of each other, so they can be
+ * decoded in parallel.  Each invocation opens its own TIFF handle over
+ * the shared device, as libtiff handles are not thread-safe.
+ */
+class TiffReader::StripDecoder
+{
+public:
+	StripDecoder(
+		QIODevice& device, QMutex& io_mutex, quint64 dir_offset,
+		TiffInfo const& info, uint32 rows_per_strip, QImage& image)
+	:	m_rDevice(device),
+		m_rIoMutex(io_mutex),
+		m_rInfo(info),
+		m_pImageData((uint8*)image.bits()),
+		m_imageStride(image.bytesPerLine()),
+		m_width(image.width()),
+		m_height(image.height()),
+		m_rowsPerStrip(rows_per_strip),
+		m_dirOffset(dir_offset),
+		m_failed(0)
+	{
+	}
+
+	void operator()(int begin_strip, int end_strip) const;
+
+	bool failed() const { return m_failed != 0; }
+private:
+	QIODevice& m_rDevice;
+	QMutex& m_rIoMutex;
+	TiffInfo const& m_rInfo;
+	uint8* m_pImageData;
+	int m_imageStride;
+	int m_width;
+	int m_height;
+	uint32 m_rowsPerStrip;
+	quint64 m_dirOffset;
+	mutable QAtomicInt m_failed;
+};
+
+void
+TiffReader::StripDecoder::operator()(int const begin_strip, int const end_strip) const
+{
+	SharedDeviceView view(&m_rDevice, &m_rIoMutex);
+	TiffHandle tif(
+		TIFFClientOpen(
+			"file", "rBm", &view, &sharedViewRead, &deviceWrite,
+			&sharedViewSeek, &sharedViewClose, &sharedViewSize,
+			&deviceMap, &deviceUnmap
+		)
+	);
+	// Jumping by offset avoids re-walking the directory chain,
+	// which matters for the latter pages of a multi-page file.
+	if (!tif.handle() || !TIFFSetSubDirectory(tif.handle(), (toff_t)m_dirOffset)) {
+		m_failed.fetchAndStoreOrdered(1);
+		return;
+	}
+
+	try {
+		tsize_t const scanline_size = TIFFScanlineSize(tif.handle());
+		uint8* const buf = threadLocalStripBuffer(TIFFStripSize(tif.handle()));
+
+		for (int strip = begin_strip; strip < end_strip; ++strip) {
+			int const first_row = strip * (int)m_rowsPerStrip;
+			int const num_rows = std::min<int>(
+				m_height - first_row, (int)m_rowsPerStrip
+			);
+			tsize_t const expected = scanline_size * num_rows;
+			if (TIFFReadEncodedStrip(tif.handle(), strip, buf, expected) != expected) {
+				m_failed.fetchAndStoreOrdered(1);
+				return;
+			}
+
+			uint8 const* src = buf;
+			uint8* dst = m_pImageData + (size_t)first_row * m_imageStride;
+			for (int i = num_rows; i > 0; --i, src += scanline_size, dst += m_imageStride) {
+				if (m_rInfo.bits_per_sample == 1 || m_rInfo.bits_per_sample == 8) {
+					memcpy(dst, src, scanline_size);
+				} else {
+					unpackTiffScanline(src, dst, m_width, m_rInfo.bits_per_sample);
+				}
+			}
+		}
+	} catch (std::bad_alloc const&) {
+		m_failed.fetchAndStoreOrdered(1);
+	}
+}
+
+bool
+TiffReader::readStripsInParallel(
+	QIODevice& device, TiffHandle const& tif,
+	TiffInfo const& info, QImage& image)
+{
+	if (imageproc::maxParallelWorkers() <= 1) {
+		return false;
+	}
+	if (TIFFIsTiled(tif.handle())) {
+		return false;
+	}
+
+	uint32 rows_per_strip = 0;
+	TIFFGetFieldDefaulted(tif.handle(), TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+	if (rows_per_strip == 0 || rows_per_strip >= (uint32)image.height()) {
+		// A single strip offers no parallelism.
+		return false;
+	}
+
+	int const num_strips = (int)(
+		((uint32)image.height() + rows_per_strip - 1) / rows_per_strip
+	);
+	if (TIFFNumberOfStrips(tif.handle()) != (tstrip_t)num_strips) {
+		return false;
+	}
+
+	if (info.bits_per_sample == 1 || info.bits_per_sample == 8) {
+		// Strip rows are copied to image rows as-is in this case.
+		if (TIFFScanlineSize(tif.handle()) > (tsize_t)image.bytesPerLine()) {
+			return false;
+		}
+	}
+
+	QMutex io_mutex;
+	StripDecoder const decoder(
+		device, io_mutex, TIFFCurrentDirOffset(tif.handle()),
+		info, rows_per_strip, image
+	);
+	imageproc::parallelForRanges(0, num_strips, decoder);
+
+	return !decoder.failed();
+}
+
 void
-TiffReader::readLines(TiffHandle const& tif, QImage& image)
+TiffReader::readLines(
+	QIODevice& device, TiffHandle const& tif,
+	TiffInfo const& info, QImage& image)
 {
+	if (readStripsInParallel(device, tif, info, image)) {
+		return;
+	}
+
 	int const height = image.height();
 	for (int y = 0; y < height; ++y) {
 		TIFFReadScanline(tif.handle(), image.scanLine(y), y);
@@ -504,33 +1165,20 @@ TiffReader::readLines(TiffHandle const& tif, QImage& image)
 
 void
 TiffReader::readAndUnpackLines(
-	TiffHandle const& tif, TiffInfo const& info, QImage& image)
+	QIODevice& device, TiffHandle const& tif,
+	TiffInfo const& info, QImage& image)
 {
-	TiffBuffer<uint8> buf(TIFFScanlineSize(tif.handle()));
-	
+	if (readStripsInParallel(device, tif, info, image)) {
+		return;
+	}
+
+	uint8* const buf = threadLocalStripBuffer(TIFFScanlineSize(tif.handle()));
+
 	int const width = image.width();
 	int const height = image.height();
-	int const bits_per_sample = info.bits_per_sample;
-	unsigned const dst_mask = (1 << bits_per_sample) - 1;
-	
+
 	for (int y = 0; y < height; ++y) {
-		TIFFReadScanline(tif.handle(), buf.data(), y);
-		
-		unsigned accum = 0;
-		int bits_in_accum = 0;
-		
-		uint8 const* src = buf.data();
-		uint8* dst = (uint8*)image.scanLine(y);
-		
-		for (int i = width; i > 0; --i, ++dst) {
-			while (bits_in_accum < bits_per_sample) {
-				accum <<= 8;
-				accum |= *src;
-				bits_in_accum += 8;
-				++src;
-			}
-			bits_in_accum -= bits_per_sample;
-			*dst = static_cast<uint8>((accum >> bits_in_accum) & dst_mask);
-		}
+		TIFFReadScanline(tif.handle(), buf, y);
+		unpackTiffScanline(buf, (uint8*)image.scanLine(y), width, info.bits_per_sample);
 	}
 }
@@ -21,6 +21,8 @@
 
 #include "ImageMetadataLoader.h"
 #include "VirtualFunction.h"
+#include <QVector>
+#include <QColor>
 
 class QIODevice;
 class QImage;
@@ -51,22 +53,35 @@ private:
 	class TiffHandle;
 	struct TiffInfo;
 	template<typename T> class TiffBuffer;
-	
+	class StripDecoder;
+
 	static TiffHeader readHeader(QIODevice& device);
-	
+
 	static bool checkHeader(TiffHeader const& header);
-	
+
 	static ImageMetadata currentPageMetadata(TiffHandle const& tif);
-	
+
 	static Dpi getDpi(float xres, float yres, unsigned res_unit);
-	
+
+	static QImage mapUncompressedImage(
+		QIODevice& device, TiffHandle const& tif, TiffInfo const& info,
+		QVector<QRgb> const& color_table, ImageMetadata const& metadata);
+
 	static QImage extractBinaryOrIndexed8Image(
-		TiffHandle const& tif, TiffInfo const& info);
-	
-	static void readLines(TiffHandle const& tif, QImage& image);
-	
+		QIODevice& device, TiffHandle const& tif, TiffInfo const& info,
+		QVector<QRgb> const& color_table);
+
+	static bool readStripsInParallel(
+		QIODevice& device, TiffHandle const& tif,
+		TiffInfo const& info, QImage& image);
+
+	static void readLines(
+		QIODevice& device, TiffHandle const& tif,
+		TiffInfo const& info, QImage& image);
+
 	static void readAndUnpackLines(
-		TiffHandle const& tif, TiffInfo const& info, QImage& image);
+		QIODevice& device, TiffHandle const& tif,
+		TiffInfo const& info, QImage& image);
 };
 
 #endif
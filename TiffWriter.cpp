@@ -18,15 +18,23 @@
 
 #include "TiffWriter.h"
 #include "Dpm.h"
+#include "CommandLine.h"
+#include "Profiler.h"
 #include "imageproc/Constants.h"
+#include "imageproc/ParallelFor.h"
 #include <QtGlobal>
 #include <QFile>
 #include <QIODevice>
+#include <QBuffer>
+#include <QByteArray>
 #include <QImage>
 #include <QColor>
 #include <QVector>
 #include <QSize>
 #include <QDebug>
+#include <QAtomicInt>
+#include <QThreadStorage>
+#include <algorithm>
 #include <vector>
 #include <tiff.h>
 #include <tiffio.h>
@@ -142,13 +150,160 @@ static void deviceUnmap(thandle_t, tdata_t, toff_t)
 	// Not implemented.
 }
 
+/**
+ * \brief Returns a per-thread scanline buffer of at least \p size bytes.
+ *
+ * The buffer grows to the largest size requested on the calling
+ * thread and is then reused, so writing a batch of similarly sized
+ * pages doesn't go to the heap for every one of them.  The returned
+ * pointer stays valid until the next call from the same thread.
+ */
+static uint8_t* threadLocalLineBuffer(size_t const size)
+{
+	static QThreadStorage<std::vector<uint8_t>*> storage;
+
+	std::vector<uint8_t>* buf = storage.localData();
+	if (!buf) {
+		buf = new std::vector<uint8_t>;
+		storage.setLocalData(buf);
+	}
+	if (buf->size() < size) {
+		buf->resize(size, 0);
+	}
+
+	return size == 0 ? 0 : &(*buf)[0];
+}
+
+
+/**
+ * \brief Compresses ranges of strips into memory from worker threads.
+ *
+ * Strips are compressed independently of each other, so each one can
+ * be produced by a private single-strip TIFF handle writing to a
+ * memory buffer with the same tags the real file uses.  The resulting
+ * raw strip data is byte-identical to what compressing into the real
+ * file would produce, and is later streamed out in strip order with
+ * TIFFWriteRawStrip().
+ */
+class TiffWriter::StripCompressor
+{
+public:
+	StripCompressor(
+		QImage const& image, RowFormat row_format, int strip_height,
+		uint16 compression, uint16 bits_per_sample,
+		uint16 samples_per_pixel, uint16 photometric,
+		std::vector<QByteArray>& compressed_strips)
+	:	m_rImage(image),
+		m_rCompressedStrips(compressed_strips),
+		m_rowFormat(row_format),
+		m_stripHeight(strip_height),
+		m_compression(compression),
+		m_bitsPerSample(bits_per_sample),
+		m_samplesPerPixel(samples_per_pixel),
+		m_photometric(photometric),
+		m_failed(0)
+	{
+	}
+
+	void operator()(int begin_strip, int end_strip) const;
+
+	bool failed() const { return m_failed != 0; }
+private:
+	QImage const& m_rImage;
+	std::vector<QByteArray>& m_rCompressedStrips;
+	RowFormat m_rowFormat;
+	int m_stripHeight;
+	uint16 m_compression;
+	uint16 m_bitsPerSample;
+	uint16 m_samplesPerPixel;
+	uint16 m_photometric;
+	mutable QAtomicInt m_failed;
+};
+
+void
+TiffWriter::StripCompressor::operator()(int const begin_strip, int const end_strip) const
+{
+	int const width = m_rImage.width();
+	int const height = m_rImage.height();
+	uint8_t* const tmp_line = threadLocalLineBuffer(rowBytes(m_rImage, m_rowFormat));
+
+	for (int strip = begin_strip; strip < end_strip; ++strip) {
+		int const first_row = strip * m_stripHeight;
+		int const num_rows = std::min(height - first_row, m_stripHeight);
+
+		QBuffer buffer;
+		buffer.open(QIODevice::ReadWrite);
+		TiffHandle tif(
+			TIFFClientOpen(
+				"mem", "wBm", &buffer, &deviceRead, &deviceWrite,
+				&deviceSeek, &deviceClose, &deviceSize,
+				&deviceMap, &deviceUnmap
+			)
+		);
+		if (!tif.handle()) {
+			m_failed.fetchAndStoreOrdered(1);
+			return;
+		}
+
+		TIFFSetField(tif.handle(), TIFFTAG_IMAGEWIDTH, uint32(width));
+		TIFFSetField(tif.handle(), TIFFTAG_IMAGELENGTH, uint32(num_rows));
+		TIFFSetField(tif.handle(), TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+		TIFFSetField(tif.handle(), TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+		TIFFSetField(tif.handle(), TIFFTAG_SAMPLESPERPIXEL, m_samplesPerPixel);
+		TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, m_compression);
+		TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, m_bitsPerSample);
+		TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, m_photometric);
+		TIFFSetField(tif.handle(), TIFFTAG_ROWSPERSTRIP, uint32(num_rows));
+
+		bool ok = true;
+		for (int i = 0; i < num_rows; ++i) {
+			convertRow(m_rImage, first_row + i, m_rowFormat, tmp_line);
+			if (TIFFWriteScanline(tif.handle(), tmp_line, i) == -1) {
+				ok = false;
+				break;
+			}
+		}
+		if (ok && TIFFFlushData(tif.handle()) != 1) {
+			ok = false;
+		}
+
+		if (ok) {
+#if TIFFLIB_VERSION >= 20111221
+			uint64* offsets = 0;
+			uint64* byte_counts = 0;
+#else
+			uint32* offsets = 0;
+			uint32* byte_counts = 0;
+#endif
+			if (!TIFFGetField(tif.handle(), TIFFTAG_STRIPOFFSETS, &offsets)
+					|| !TIFFGetField(tif.handle(), TIFFTAG_STRIPBYTECOUNTS, &byte_counts)
+					|| !offsets || !byte_counts) {
+				ok = false;
+			} else {
+				m_rCompressedStrips[strip] = QByteArray(
+					buffer.data().constData() + (int)offsets[0],
+					(int)byte_counts[0]
+				);
+			}
+		}
+
+		if (!ok) {
+			m_failed.fetchAndStoreOrdered(1);
+			return;
+		}
+	}
+}
+
+
 bool
 TiffWriter::writeImage(QString const& file_path, QImage const& image)
 {
 	if (image.isNull()) {
 		return false;
 	}
-	
+
+	ProfileScope const profile_scope("io/write-tiff");
+
 	QFile file(file_path);
 	if (!file.open(QFile::WriteOnly)) {
 		return false;
@@ -308,15 +463,17 @@ TiffWriter::writeBitonalOrIndexed8Image(
 		TIFFSetField(tif.handle(), TIFFTAG_COLORMAP, &pr[0], &pg[0], &pb[0]);
 	}
 	
-	if (image.format() == QImage::Format_Indexed8) {
-		return write8bitLines(tif, image);
-	} else {
-		if (image.format() == QImage::Format_MonoLSB) {
-			return writeBinaryLinesReversed(tif, image);
-		} else {
-			return writeBinaryLinesAsIs(tif, image);
-		}
+	RowFormat row_format = ROW_INDEXED8;
+	if (image.format() == QImage::Format_MonoLSB) {
+		row_format = ROW_BINARY_REVERSED;
+	} else if (image.format() == QImage::Format_Mono) {
+		row_format = ROW_BINARY_AS_IS;
 	}
+
+	return writeLines(
+		tif, image, row_format, compression,
+		bits_per_sample, uint16(1), photometric
+	);
 }
 
 bool
@@ -329,31 +486,11 @@ TiffWriter::writeRGB32Image(
 	TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_LZW);
 	TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16(8));
 	TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-	
-	int const width = image.width();
-	int const height = image.height();
-	
-	std::vector<uint8_t> tmp_line(width * 3);
-	
-	// Libtiff expects "RR GG BB" sequences regardless of CPU byte order.
-	
-	for (int y = 0; y < height; ++y) {
-		uint32_t const* p_src = (uint32_t const*)image.scanLine(y);
-		uint8_t* p_dst = &tmp_line[0];
-		for (int x = 0; x < width; ++x) {
-			uint32_t const ARGB = *p_src;
-			p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
-			p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
-			p_dst[2] = static_cast<uint8_t>(ARGB);
-			++p_src;
-			p_dst += 3;
-		}
-		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
-			return false;
-		}
-	}
-	
-	return true;
+
+	return writeLines(
+		tif, image, ROW_RGB24, COMPRESSION_LZW,
+		uint16(8), uint16(3), PHOTOMETRIC_RGB
+	);
 }
 
 bool
@@ -366,100 +503,146 @@ TiffWriter::writeARGB32Image(
 	TIFFSetField(tif.handle(), TIFFTAG_COMPRESSION, COMPRESSION_LZW);
 	TIFFSetField(tif.handle(), TIFFTAG_BITSPERSAMPLE, uint16(8));
 	TIFFSetField(tif.handle(), TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-	
-	int const width = image.width();
-	int const height = image.height();
-	
-	std::vector<uint8_t> tmp_line(width * 4);
-	
-	// Libtiff expects "RR GG BB AA" sequences regardless of CPU byte order.
-	
-	for (int y = 0; y < height; ++y) {
-		uint32_t const* p_src = (uint32_t const*)image.scanLine(y);
-		uint8_t* p_dst = &tmp_line[0];
-		for (int x = 0; x < width; ++x) {
-			uint32_t const ARGB = *p_src;
-			p_dst[0] = static_cast<uint8_t>(ARGB >> 16);
-			p_dst[1] = static_cast<uint8_t>(ARGB >> 8);
-			p_dst[2] = static_cast<uint8_t>(ARGB);
-			p_dst[3] = static_cast<uint8_t>(ARGB >> 24);
-			++p_src;
-			p_dst += 4;
-		}
-		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
-			return false;
+
+	return writeLines(
+		tif, image, ROW_RGBA32, COMPRESSION_LZW,
+		uint16(8), uint16(4), PHOTOMETRIC_RGB
+	);
+}
+
+int
+TiffWriter::stripHeight()
+{
+	int const DEFAULT_STRIP_HEIGHT = 128;
+
+	CommandLine const& cli = CommandLine::get();
+	if (cli.hasTiffStripHeight()) {
+		int const rows = cli.getTiffStripHeight();
+		if (rows > 0) {
+			return rows;
 		}
 	}
-	
-	return true;
+
+	return DEFAULT_STRIP_HEIGHT;
 }
 
-bool
-TiffWriter::write8bitLines(
-	TiffHandle const& tif, QImage const& image)
+int
+TiffWriter::rowBytes(QImage const& image, RowFormat const row_format)
 {
 	int const width = image.width();
-	int const height = image.height();
-	
-	// TIFFWriteScanline() can actually modify the data you pass it,
-	// so we have to use a temporary buffer even when no coversion
-	// is required.
-	std::vector<uint8_t> tmp_line(width, 0);
-	
-	for (int y = 0; y < height; ++y) {
-		uint8_t const* src_line = image.scanLine(y);
-		memcpy(&tmp_line[0], src_line, tmp_line.size());
-		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
-			return false;
-		}
+
+	switch (row_format) {
+		case ROW_INDEXED8:
+			return width;
+		case ROW_BINARY_AS_IS:
+		case ROW_BINARY_REVERSED:
+			return (width + 7) / 8;
+		case ROW_RGB24:
+			return width * 3;
+		case ROW_RGBA32:
+			return width * 4;
 	}
-	
-	return true;
+
+	assert(!"Unreachable");
+	return 0;
 }
 
-bool
-TiffWriter::writeBinaryLinesAsIs(
-	TiffHandle const& tif, QImage const& image)
+void
+TiffWriter::convertRow(
+	QImage const& image, int const y, RowFormat const row_format, uint8_t* dst)
 {
 	int const width = image.width();
-	int const height = image.height();
-	
-	// TIFFWriteScanline() can actually modify the data you pass it,
-	// so we have to use a temporary buffer even when no coversion
-	// is required.
-	int const bpl = (width + 7) / 8;
-	std::vector<uint8_t> tmp_line(bpl, 0);
-	
-	for (int y = 0; y < height; ++y) {
-		uint8_t const* src_line = image.scanLine(y);
-		memcpy(&tmp_line[0], src_line, bpl);
-		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
-			return false;
+	uint8_t const* const src_line = image.scanLine(y);
+
+	switch (row_format) {
+		case ROW_INDEXED8:
+			memcpy(dst, src_line, width);
+			break;
+		case ROW_BINARY_AS_IS:
+			memcpy(dst, src_line, (width + 7) / 8);
+			break;
+		case ROW_BINARY_REVERSED: {
+			int const bpl = (width + 7) / 8;
+			for (int i = 0; i < bpl; ++i) {
+				dst[i] = m_reverseBitsLUT[src_line[i]];
+			}
+			break;
+		}
+		case ROW_RGB24: {
+			// Libtiff expects "RR GG BB" sequences regardless of CPU byte order.
+			uint32_t const* p_src = (uint32_t const*)src_line;
+			for (int x = 0; x < width; ++x) {
+				uint32_t const ARGB = *p_src;
+				dst[0] = static_cast<uint8_t>(ARGB >> 16);
+				dst[1] = static_cast<uint8_t>(ARGB >> 8);
+				dst[2] = static_cast<uint8_t>(ARGB);
+				++p_src;
+				dst += 3;
+			}
+			break;
+		}
+		case ROW_RGBA32: {
+			// Libtiff expects "RR GG BB AA" sequences regardless of CPU byte order.
+			uint32_t const* p_src = (uint32_t const*)src_line;
+			for (int x = 0; x < width; ++x) {
+				uint32_t const ARGB = *p_src;
+				dst[0] = static_cast<uint8_t>(ARGB >> 16);
+				dst[1] = static_cast<uint8_t>(ARGB >> 8);
+				dst[2] = static_cast<uint8_t>(ARGB);
+				dst[3] = static_cast<uint8_t>(ARGB >> 24);
+				++p_src;
+				dst += 4;
+			}
+			break;
 		}
 	}
-	
-	return true;
 }
 
 bool
-TiffWriter::writeBinaryLinesReversed(
-	TiffHandle const& tif, QImage const& image)
+TiffWriter::writeLines(
+	TiffHandle const& tif, QImage const& image, RowFormat const row_format,
+	uint16_t const compression, uint16_t const bits_per_sample,
+	uint16_t const samples_per_pixel, uint16_t const photometric)
 {
-	int const width = image.width();
 	int const height = image.height();
-	
-	int const bpl = (width + 7) / 8;
-	std::vector<uint8_t> tmp_line(bpl, 0);
-	
-	for (int y = 0; y < height; ++y) {
-		uint8_t const* src_line = image.scanLine(y);
-		for (int i = 0; i < bpl; ++i) {
-			tmp_line[i] = m_reverseBitsLUT[src_line[i]];
+	int const strip_height = stripHeight();
+	TIFFSetField(tif.handle(), TIFFTAG_ROWSPERSTRIP, uint32(strip_height));
+
+	int const num_strips = (height + strip_height - 1) / strip_height;
+	if (num_strips > 1 && imageproc::maxParallelWorkers() > 1) {
+		std::vector<QByteArray> compressed_strips(num_strips);
+		StripCompressor const compressor(
+			image, row_format, strip_height, compression,
+			bits_per_sample, samples_per_pixel, photometric,
+			compressed_strips
+		);
+		imageproc::parallelForRanges(0, num_strips, compressor);
+
+		if (!compressor.failed()) {
+			for (int strip = 0; strip < num_strips; ++strip) {
+				QByteArray const& raw = compressed_strips[strip];
+				if (TIFFWriteRawStrip(tif.handle(), strip,
+						(tdata_t)raw.data(), raw.size()) == -1) {
+					return false;
+				}
+			}
+			return true;
 		}
-		if (TIFFWriteScanline(tif.handle(), &tmp_line[0], y) == -1) {
+		// Nothing has been written to the file yet at this
+		// point, so we can safely fall back to the scanline loop.
+	}
+
+	// TIFFWriteScanline() can actually modify the data you pass it,
+	// so we have to use a temporary buffer even when no coversion
+	// is required.
+	uint8_t* const tmp_line = threadLocalLineBuffer(rowBytes(image, row_format));
+
+	for (int y = 0; y < height; ++y) {
+		convertRow(image, y, row_format, tmp_line);
+		if (TIFFWriteScanline(tif.handle(), tmp_line, y) == -1) {
 			return false;
 		}
 	}
-	
+
 	return true;
 }
@@ -50,27 +50,40 @@ public:
 	static bool writeImage(QIODevice& device, QImage const& image);
 private:
 	class TiffHandle;
-	
+	class StripCompressor;
+
+	enum RowFormat {
+		ROW_INDEXED8,
+		ROW_BINARY_AS_IS,
+		ROW_BINARY_REVERSED,
+		ROW_RGB24,
+		ROW_RGBA32
+	};
+
+	/** The number of rows per strip, possibly overridden from the command line. */
+	static int stripHeight();
+
+	static int rowBytes(QImage const& image, RowFormat row_format);
+
+	static void convertRow(
+		QImage const& image, int y, RowFormat row_format, uint8_t* dst);
+
 	static void setDpm(TiffHandle const& tif, Dpm const& dpm);
-	
+
 	static bool writeBitonalOrIndexed8Image(
 		TiffHandle const& tif, QImage const& image);
-	
+
 	static bool writeRGB32Image(
 		TiffHandle const& tif, QImage const& image);
-	
+
 	static bool writeARGB32Image(
 		TiffHandle const& tif, QImage const& image);
-	
-	static bool write8bitLines(
-		TiffHandle const& tif, QImage const& image);
-	
-	static bool writeBinaryLinesAsIs(
-		TiffHandle const& tif, QImage const& image);
-	
-	static bool writeBinaryLinesReversed(
-		TiffHandle const& tif, QImage const& image);
-	
+
+	static bool writeLines(
+		TiffHandle const& tif, QImage const& image, RowFormat row_format,
+		uint16_t compression, uint16_t bits_per_sample,
+		uint16_t samples_per_pixel, uint16_t photometric);
+
 	static uint8_t const m_reverseBitsLUT[256];
 };
 
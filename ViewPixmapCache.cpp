@@ -0,0 +1,95 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ViewPixmapCache.h"
+
+ViewPixmapCache::ViewPixmapCache()
+:	m_cachedBytes(0),
+	m_memoryBudget(DEFAULT_MEMORY_BUDGET)
+{
+}
+
+ViewPixmapCache&
+ViewPixmapCache::instance()
+{
+	// Always called from the GUI thread, so no synchronization
+	// is necessary.
+	static ViewPixmapCache object;
+
+	return object;
+}
+
+bool
+ViewPixmapCache::lookup(qint64 const source_key, QPixmap& pixmap)
+{
+	Map::iterator const it(m_map.find(source_key));
+	if (it == m_map.end()) {
+		return false;
+	}
+
+	Entry& entry = it->second;
+
+	// Mark as recently used.
+	m_lru.erase(entry.lruIt);
+	entry.lruIt = m_lru.insert(m_lru.begin(), source_key);
+
+	pixmap = entry.pixmap;
+	return true;
+}
+
+void
+ViewPixmapCache::store(qint64 const source_key, QPixmap const& pixmap)
+{
+	if (pixmap.isNull()) {
+		return;
+	}
+
+	Entry& entry = m_map[source_key];
+	if (entry.pixmap.isNull()) {
+		entry.lruIt = m_lru.insert(m_lru.begin(), source_key);
+	} else {
+		m_cachedBytes -= pixmapBytes(entry.pixmap);
+	}
+	entry.pixmap = pixmap;
+	m_cachedBytes += pixmapBytes(pixmap);
+	enforceBudget();
+}
+
+void
+ViewPixmapCache::setMemoryBudget(size_t const bytes)
+{
+	m_memoryBudget = bytes;
+	enforceBudget();
+}
+
+void
+ViewPixmapCache::enforceBudget()
+{
+	while (m_cachedBytes > m_memoryBudget && !m_lru.empty()) {
+		Map::iterator const it(m_map.find(m_lru.back()));
+		m_cachedBytes -= pixmapBytes(it->second.pixmap);
+		m_map.erase(it);
+		m_lru.pop_back();
+	}
+}
+
+size_t
+ViewPixmapCache::pixmapBytes(QPixmap const& pixmap)
+{
+	return size_t(pixmap.width()) * pixmap.height() * (pixmap.depth() / 8);
+}
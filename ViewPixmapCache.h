@@ -0,0 +1,94 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VIEW_PIXMAP_CACHE_H_
+#define VIEW_PIXMAP_CACHE_H_
+
+#include "NonCopyable.h"
+#include <QPixmap>
+#include <QtGlobal>
+#include <list>
+#include <map>
+#include <stddef.h>
+
+/**
+ * \brief A cache of downscaled pixmaps built for image views.
+ *
+ * Every time an image view is created, for example when navigating
+ * between pages, the downscaled version of the image used to be
+ * converted to a QPixmap from scratch.  With a QGLWidget viewport
+ * that conversion is what triggers the texture upload, so going back
+ * and forth between pages kept re-uploading the same data.
+ *
+ * This cache keeps the pixmaps of recently viewed images alive,
+ * keyed by QImage::cacheKey() of the source image.  Keeping a QPixmap
+ * alive also keeps its texture resident in Qt's OpenGL paint engine,
+ * so revisiting a page skips both the downscaling and the upload.
+ * A cache key uniquely identifies the contents of an image for the
+ * lifetime of the process, so entries can never go stale.
+ *
+ * QPixmap may only be used from the GUI thread, and so may this class.
+ */
+class ViewPixmapCache
+{
+	DECLARE_NON_COPYABLE(ViewPixmapCache)
+public:
+	static ViewPixmapCache& instance();
+
+	/**
+	 * \brief Fetches the pixmap built for the image identified
+	 *        by \p source_key.
+	 *
+	 * \return true and sets \p pixmap on a cache hit.
+	 */
+	bool lookup(qint64 source_key, QPixmap& pixmap);
+
+	/**
+	 * \brief Remembers the pixmap built for the image identified
+	 *        by \p source_key.
+	 */
+	void store(qint64 source_key, QPixmap const& pixmap);
+
+	/**
+	 * \brief Sets the total budget for cached pixmaps, in bytes.
+	 */
+	void setMemoryBudget(size_t bytes);
+private:
+	struct Entry
+	{
+		QPixmap pixmap;
+		std::list<qint64>::iterator lruIt;
+	};
+
+	typedef std::map<qint64, Entry> Map;
+
+	enum { DEFAULT_MEMORY_BUDGET = 128 * 1024 * 1024 };
+
+	ViewPixmapCache();
+
+	void enforceBudget();
+
+	static size_t pixmapBytes(QPixmap const& pixmap);
+
+	Map m_map;
+	std::list<qint64> m_lru; /**< Most recently used first. */
+	size_t m_cachedBytes;
+	size_t m_memoryBudget;
+};
+
+#endif
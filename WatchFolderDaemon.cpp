@@ -0,0 +1,140 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "WatchFolderDaemon.h"
+#include "WatchFolderDaemon.h.moc"
+#include "CommandLine.h"
+#include "ConsoleBatch.h"
+#include "ImageFileInfo.h"
+#include "ImageMetadata.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+WatchFolderDaemon::WatchFolderDaemon(
+	QString const& watch_dir, QString const& output_dir,
+	int const poll_interval_secs, QObject* parent)
+:	QObject(parent),
+	m_watchDir(watch_dir),
+	m_outputDir(output_dir),
+	m_pollIntervalSecs(poll_interval_secs < 1 ? 1 : poll_interval_secs)
+{
+	connect(&m_timer, SIGNAL(timeout()), this, SLOT(poll()));
+}
+
+void
+WatchFolderDaemon::start()
+{
+	std::cout << "Watching " << m_watchDir.toAscii().constData()
+		<< " (poll interval: " << m_pollIntervalSecs << "s)\n";
+
+	// The first poll seeds m_pending with whatever is already in the
+	// folder; those files settle and get processed one interval later.
+	poll();
+	m_timer.start(m_pollIntervalSecs * 1000);
+}
+
+void
+WatchFolderDaemon::poll()
+{
+	QStringList name_filters;
+	name_filters << "*.tif" << "*.tiff" << "*.png" << "*.jpg" << "*.jpeg";
+
+	QDir const dir(m_watchDir);
+	QStringList const entries(
+		dir.entryList(name_filters, QDir::Files|QDir::Readable, QDir::Name)
+	);
+
+	std::set<QString> settled;
+
+	for (int i = 0; i < entries.size(); ++i) {
+		QString const path(dir.absoluteFilePath(entries[i]));
+		if (m_processed.find(path) != m_processed.end()) {
+			continue;
+		}
+
+		QFileInfo const info(path);
+		PendingFile& pending = m_pending[path];
+
+		if (m_failed.find(path) != m_failed.end()) {
+			if (pending.size != info.size()
+					|| pending.mtime != info.lastModified()) {
+				// Replaced or rewritten - give it another chance.
+				m_failed.erase(path);
+				pending.size = info.size();
+				pending.mtime = info.lastModified();
+			}
+			continue;
+		}
+
+		if (pending.size == info.size() && pending.mtime == info.lastModified()) {
+			// Unchanged for a full interval - the scanner is done with it.
+			settled.insert(path);
+		} else {
+			pending.size = info.size();
+			pending.mtime = info.lastModified();
+		}
+	}
+
+	if (!settled.empty()) {
+		processFiles(settled);
+	}
+}
+
+void
+WatchFolderDaemon::processFiles(std::set<QString> const& file_paths)
+{
+	std::vector<ImageFileInfo> images;
+	images.reserve(file_paths.size());
+
+	for (std::set<QString>::const_iterator it(file_paths.begin());
+			it != file_paths.end(); ++it) {
+		ImageMetadata metadata;
+		metadata.setDpi(CommandLine::get().getInputDpi());
+		std::vector<ImageMetadata> metadata_vec;
+		metadata_vec.push_back(metadata);
+		images.push_back(ImageFileInfo(QFileInfo(*it), metadata_vec));
+
+		std::cout << "Processing: " << it->toAscii().constData() << "\n";
+	}
+
+	try {
+		ConsoleBatch cbatch(
+			images, m_outputDir, CommandLine::get().getLayoutDirection()
+		);
+		cbatch.process();
+
+		for (std::set<QString>::const_iterator it(file_paths.begin());
+				it != file_paths.end(); ++it) {
+			m_processed.insert(*it);
+			m_pending.erase(*it);
+		}
+	} catch (std::exception const& e) {
+		// A bad file must not kill the daemon.  The group is set
+		// aside until its files change on disk; a fixed or replaced
+		// file gets another chance then.
+		std::cerr << "Error processing batch: " << e.what() << std::endl;
+		for (std::set<QString>::const_iterator it(file_paths.begin());
+				it != file_paths.end(); ++it) {
+			m_failed.insert(*it);
+		}
+	}
+}
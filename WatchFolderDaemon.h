@@ -0,0 +1,96 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WATCH_FOLDER_DAEMON_H_
+#define WATCH_FOLDER_DAEMON_H_
+
+#include "NonCopyable.h"
+#include <QObject>
+#include <QDateTime>
+#include <QString>
+#include <QTimer>
+#include <map>
+#include <set>
+
+/**
+ * \brief Processes images continuously as they appear in a hot folder.
+ *
+ * Scanners that drop files into a folder all day are poorly served by
+ * periodic batch runs: a page scanned right after a run waits a full
+ * cycle before it is even looked at.  In watch mode (--watch-folder)
+ * scantailor-cli stays resident, polls the folder, and runs the
+ * configured pipeline over each new image as soon as it has settled,
+ * so outputs appear at scanning pace.
+ *
+ * A file counts as settled when its size and modification time
+ * survive one full poll interval unchanged - scanners and network
+ * shares write large TIFFs in visible increments, and processing a
+ * half-written file would be worse than waiting a few seconds.
+ *
+ * Processing reuses the ordinary batch machinery with the pipeline
+ * options from the command line; each settled group of files runs as
+ * its own batch against the common output directory.  Files that
+ * produced output are remembered (and their outputs exist on disk),
+ * so a restarted daemon doesn't redo them.
+ */
+class WatchFolderDaemon : public QObject
+{
+	Q_OBJECT
+	DECLARE_NON_COPYABLE(WatchFolderDaemon)
+public:
+	WatchFolderDaemon(
+		QString const& watch_dir, QString const& output_dir,
+		int poll_interval_secs, QObject* parent = 0);
+
+	/**
+	 * \brief Starts polling.  Runs until the process is terminated.
+	 */
+	void start();
+private slots:
+	void poll();
+private:
+	struct PendingFile
+	{
+		qint64 size;
+		QDateTime mtime;
+
+		PendingFile() : size(-1) {}
+	};
+
+	void processFiles(std::set<QString> const& file_paths);
+
+	QString m_watchDir;
+	QString m_outputDir;
+	int m_pollIntervalSecs;
+	QTimer m_timer;
+
+	/** Files seen but not yet settled, with their last observed state. */
+	std::map<QString, PendingFile> m_pending;
+
+	/** Files already handed to the pipeline. */
+	std::set<QString> m_processed;
+
+	/**
+	 * Files whose batch failed.  They are left alone until their
+	 * size or mtime changes, so one bad file can't put the daemon
+	 * into a retry loop.
+	 */
+	std::set<QString> m_failed;
+};
+
+#endif
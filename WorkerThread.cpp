@@ -71,9 +71,18 @@ public:
 	~Impl();
 	
 	void performTask(BackgroundTaskPtr const& task);
+
+	/**
+	 * The generation of the latest interactive submission.  Queued
+	 * interactive tasks from older generations are dropped before
+	 * dispatch.
+	 */
+	int latestInteractiveGeneration() const {
+		return (int)m_interactiveGeneration;
+	}
 protected:
 	virtual void run();
-	
+
 	virtual void customEvent(QEvent* event);
 protected:
 	void resetPriority();
@@ -82,6 +91,20 @@ private:
 
 	WorkerThread& m_rOwner;
 	Dispatcher m_dispatcher;
+
+	/**
+	 * Bumped on every interactive submission.  Dragging a slider in
+	 * the output stage submits a re-render per tick; only the render
+	 * matching the latest tick is worth doing.
+	 */
+	QAtomicInt m_interactiveGeneration;
+
+	/**
+	 * The last interactive task submitted, so the next submission can
+	 * cancel it.  Only ever touched from the submitting thread.
+	 */
+	BackgroundTaskPtr m_ptrLastInteractiveTask;
+
 	bool m_threadStarted;
 };
 
@@ -89,11 +112,18 @@ private:
 class WorkerThread::PerformTaskEvent : public QEvent
 {
 public:
-	PerformTaskEvent(BackgroundTaskPtr const& task);
-	
+	PerformTaskEvent(BackgroundTaskPtr const& task, int generation);
+
 	BackgroundTaskPtr const& task() const { return m_ptrTask; }
+
+	/**
+	 * The interactive generation this task was submitted in, or
+	 * zero for tasks not subject to latest-wins coalescing.
+	 */
+	int generation() const { return m_generation; }
 private:
 	BackgroundTaskPtr m_ptrTask;
+	int m_generation;
 };
 
 
@@ -220,7 +250,15 @@ WorkerThread::Dispatcher::customEvent(QEvent* event)
 	PerformTaskEvent* evt = dynamic_cast<PerformTaskEvent*>(event);
 	assert(evt);
 	BackgroundTaskPtr const& task = evt->task();
-	
+
+	if (evt->generation() != 0
+			&& evt->generation() != m_rOwner.latestInteractiveGeneration()) {
+		// Superseded while sitting in the queue.  Under fast slider
+		// dragging several stale re-renders can pile up here; they
+		// are dropped wholesale without even starting.
+		return;
+	}
+
 	if (updateThreadPriority(*task) == ThreadRestartRequired) {
 		m_ptrQueuedTask = task;
 		m_rOwner.exit(Impl::ExitForRestart);
@@ -269,7 +307,29 @@ WorkerThread::Impl::~Impl()
 void
 WorkerThread::Impl::performTask(BackgroundTaskPtr const& task)
 {
-	QCoreApplication::postEvent(&m_dispatcher, new PerformTaskEvent(task));
+	int generation = 0;
+	if (task->type() == BackgroundTask::INTERACTIVE) {
+		// Latest wins among interactive tasks.  A new submission
+		// supersedes the previous one: if it's still queued, its
+		// generation check will drop it before dispatch, and if
+		// it's already running, cancelling makes it abort at the
+		// next cancellation point rather than render to completion.
+		if (m_ptrLastInteractiveTask.get()
+				&& m_ptrLastInteractiveTask.get() != task.get()) {
+			m_ptrLastInteractiveTask->cancel();
+		}
+		m_ptrLastInteractiveTask = task;
+		generation = m_interactiveGeneration.fetchAndAddOrdered(1) + 1;
+	}
+
+	// Interactive tasks jump ahead of any batch tasks already
+	// sitting in the worker's event queue, so a page the user is
+	// looking at doesn't wait behind queued batch work.
+	int const priority = (task->type() == BackgroundTask::INTERACTIVE)
+		? Qt::HighEventPriority : Qt::LowEventPriority;
+	QCoreApplication::postEvent(
+		&m_dispatcher, new PerformTaskEvent(task, generation), priority
+	);
 	if (!m_threadStarted) {
 		start();
 		m_threadStarted = true;
@@ -303,9 +363,10 @@ WorkerThread::Impl::customEvent(QEvent* event)
 /*====================== WorkerThread::PerformTaskEvent ====================*/
 
 WorkerThread::PerformTaskEvent::PerformTaskEvent(
-	BackgroundTaskPtr const& task)
+	BackgroundTaskPtr const& task, int const generation)
 :	QEvent(User),
-	m_ptrTask(task)
+	m_ptrTask(task),
+	m_generation(generation)
 {
 }
 
@@ -0,0 +1,188 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "WorkerTopology.h"
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QThread>
+#include <QDebug>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#include <pthread.h>
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace
+{
+
+/**
+ * Parses a kernel-style CPU list like "0,2,4-7".
+ * Returns an empty vector on any parse error.
+ */
+std::vector<int> parseCpuList(QString const& str)
+{
+	std::vector<int> cpus;
+
+	QStringList const parts(str.split(',', QString::SkipEmptyParts));
+	for (int i = 0; i < parts.size(); ++i) {
+		QString const part(parts[i].trimmed());
+		int const dash = part.indexOf('-');
+		bool ok1 = false, ok2 = false;
+		if (dash == -1) {
+			int const cpu = part.toInt(&ok1);
+			if (!ok1 || cpu < 0) {
+				return std::vector<int>();
+			}
+			cpus.push_back(cpu);
+		} else {
+			int const from = part.left(dash).toInt(&ok1);
+			int const to = part.mid(dash + 1).toInt(&ok2);
+			if (!ok1 || !ok2 || from < 0 || to < from) {
+				return std::vector<int>();
+			}
+			for (int cpu = from; cpu <= to; ++cpu) {
+				cpus.push_back(cpu);
+			}
+		}
+	}
+
+	return cpus;
+}
+
+/**
+ * The CPUs of each NUMA node, one list per node.  Nodes we can't
+ * discover collapse into a single list of all CPUs.
+ */
+std::vector<std::vector<int> > discoverNodes()
+{
+	std::vector<std::vector<int> > nodes;
+
+#ifdef Q_OS_LINUX
+	QDir const node_dir("/sys/devices/system/node");
+	QStringList const entries(
+		node_dir.entryList(QStringList("node*"), QDir::Dirs, QDir::Name)
+	);
+	for (int i = 0; i < entries.size(); ++i) {
+		QFile file(node_dir.absoluteFilePath(entries[i]) + "/cpulist");
+		if (!file.open(QIODevice::ReadOnly)) {
+			continue;
+		}
+		std::vector<int> const cpus(
+			parseCpuList(QString::fromAscii(file.readAll()).trimmed())
+		);
+		if (!cpus.empty()) {
+			nodes.push_back(cpus);
+		}
+	}
+#endif
+
+	if (nodes.empty()) {
+		int num_cpus = QThread::idealThreadCount();
+		if (num_cpus < 1) {
+			num_cpus = 1;
+		}
+		std::vector<int> all;
+		all.reserve(num_cpus);
+		for (int cpu = 0; cpu < num_cpus; ++cpu) {
+			all.push_back(cpu);
+		}
+		nodes.push_back(all);
+	}
+
+	return nodes;
+}
+
+} // anonymous namespace
+
+WorkerTopology&
+WorkerTopology::instance()
+{
+	static WorkerTopology obj;
+	return obj;
+}
+
+void
+WorkerTopology::configure(QString const& spec)
+{
+	m_workerCpus.clear();
+
+	QString const trimmed(spec.trimmed());
+	if (trimmed.isEmpty() || trimmed == "none") {
+		return;
+	}
+
+	if (trimmed == "compact") {
+		// Fill each node before moving to the next, in node order.
+		std::vector<std::vector<int> > const nodes(discoverNodes());
+		for (size_t n = 0; n < nodes.size(); ++n) {
+			m_workerCpus.insert(
+				m_workerCpus.end(), nodes[n].begin(), nodes[n].end()
+			);
+		}
+	} else if (trimmed == "spread") {
+		// Round-robin across nodes: consecutive workers land on
+		// different sockets, spreading memory bandwidth demand.
+		std::vector<std::vector<int> > const nodes(discoverNodes());
+		size_t max_len = 0;
+		for (size_t n = 0; n < nodes.size(); ++n) {
+			max_len = std::max(max_len, nodes[n].size());
+		}
+		for (size_t i = 0; i < max_len; ++i) {
+			for (size_t n = 0; n < nodes.size(); ++n) {
+				if (i < nodes[n].size()) {
+					m_workerCpus.push_back(nodes[n][i]);
+				}
+			}
+		}
+	} else {
+		m_workerCpus = parseCpuList(trimmed);
+		if (m_workerCpus.empty()) {
+			qDebug() << "Unparsable worker affinity spec:" << spec;
+		}
+	}
+}
+
+void
+WorkerTopology::pinCurrentThread(int worker_index) const
+{
+	if (m_workerCpus.empty() || worker_index < 0) {
+		return;
+	}
+
+	int const cpu = m_workerCpus[worker_index % m_workerCpus.size()];
+
+#ifdef Q_OS_LINUX
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+		qDebug() << "Failed to pin worker" << worker_index << "to CPU" << cpu;
+	}
+#elif defined(_WIN32)
+	if (SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) == 0) {
+		qDebug() << "Failed to pin worker" << worker_index << "to CPU" << cpu;
+	}
+#else
+	(void)cpu; // No pinning support on this platform.
+#endif
+}
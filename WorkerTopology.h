@@ -0,0 +1,78 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WORKER_TOPOLOGY_H_
+#define WORKER_TOPOLOGY_H_
+
+#include "NonCopyable.h"
+#include <QString>
+#include <vector>
+
+/**
+ * \brief Decides which CPU each worker thread runs on.
+ *
+ * ThreadPriority says how urgent a worker is; this says where it
+ * lives.  On multi-socket machines an unpinned worker migrates
+ * between NUMA nodes and ends up streaming its images across the
+ * interconnect, at roughly half the bandwidth of node-local memory.
+ * Pinning a worker fixes both halves of the problem at once: the
+ * thread stays put, and since Linux and Windows allocate pages on
+ * the node that first touches them, the buffers a pinned worker
+ * allocates and fills are node-local automatically.
+ *
+ * The policy comes from --worker-affinity, falling back to the
+ * "settings/worker_affinity" key:
+ *
+ * - "none" (the default): leave scheduling to the OS;
+ * - "compact": worker N on CPU N, filling one node before the next;
+ * - "spread": workers round-robin across NUMA nodes;
+ * - an explicit CPU list, e.g. "0,2,4-7": worker N on the N-th
+ *   listed CPU, wrapping around.
+ *
+ * Pinning is per worker index, so retrying a page on the same worker
+ * keeps its caches and its node-local pages warm.
+ */
+class WorkerTopology
+{
+	DECLARE_NON_COPYABLE(WorkerTopology)
+public:
+	static WorkerTopology& instance();
+
+	/**
+	 * \brief Parses and installs an affinity policy.
+	 *
+	 * To be called once at startup, before any workers exist.
+	 * An unparsable spec is treated as "none".
+	 */
+	void configure(QString const& spec);
+
+	/**
+	 * \brief Pins the calling thread according to the policy.
+	 *
+	 * Workers call this first thing, with their stable index.
+	 * Does nothing under the "none" policy or when the platform
+	 * doesn't support pinning.
+	 */
+	void pinCurrentThread(int worker_index) const;
+private:
+	WorkerTopology() {}
+
+	std::vector<int> m_workerCpus; /**< Empty means no pinning. */
+};
+
+#endif
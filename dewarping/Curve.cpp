@@ -91,6 +91,33 @@ Curve::matches(Curve const& other) const
 	return true;
 }
 
+bool
+Curve::operator==(Curve const& other) const
+{
+	return m_polyline == other.m_polyline
+		&& splineEquals(m_xspline, other.m_xspline);
+}
+
+bool
+Curve::splineEquals(XSpline const& spline1, XSpline const& spline2)
+{
+	int const num_control_points = spline1.numControlPoints();
+	if (num_control_points != spline2.numControlPoints()) {
+		return false;
+	}
+
+	for (int i = 0; i < num_control_points; ++i) {
+		if (spline1.controlPointPosition(i) != spline2.controlPointPosition(i)) {
+			return false;
+		}
+		if (spline1.controlPointTension(i) != spline2.controlPointTension(i)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 std::vector<QPointF>
 Curve::deserializePolyline(QDomElement const& el)
 {
@@ -45,8 +45,16 @@ public:
 
 	bool isValid() const;
 
+	/**
+	 * \brief Approximate comparison, tolerating point drift of up to 0.01.
+	 */
 	bool matches(Curve const& other) const;
 
+	/**
+	 * \brief Exact field-by-field comparison, unlike matches().
+	 */
+	bool operator==(Curve const& other) const;
+
 	XSpline const& xspline() const { return m_xspline; }
 
 	std::vector<QPointF> const& polyline() const { return m_polyline; }
@@ -69,6 +77,8 @@ private:
 		std::vector<QPointF> const& polyline1,
 		std::vector<QPointF> const& polyline2);
 
+	static bool splineEquals(XSpline const& spline1, XSpline const& spline2);
+
 	XSpline m_xspline;
 	std::vector<QPointF> m_polyline;
 };
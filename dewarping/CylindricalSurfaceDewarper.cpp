@@ -105,7 +105,7 @@ CylindricalSurfaceDewarper::CylindricalSurfaceDewarper(
 CylindricalSurfaceDewarper::Generatrix
 CylindricalSurfaceDewarper::mapGeneratrix(double crv_x, State& state) const
 {
-	double const pln_x = m_arcLengthMapper.arcLenToX(crv_x, state.m_arcLengthHint);
+	double const pln_x = m_arcLengthMapper.arcLenToX(crv_x);
 	
 	Vec2d const pln_top_pt(pln_x, 0);
 	Vec2d const pln_bottom_pt(pln_x, 1);
@@ -141,9 +141,14 @@ QPointF
 CylindricalSurfaceDewarper::mapToDewarpedSpace(QPointF const& img_pt) const
 {
 	State state;
+	return mapToDewarpedSpace(img_pt, state);
+}
 
+QPointF
+CylindricalSurfaceDewarper::mapToDewarpedSpace(QPointF const& img_pt, State& state) const
+{
 	double const pln_x = m_img2pln(img_pt)[0];
-	double const crv_x = m_arcLengthMapper.xToArcLen(pln_x, state.m_arcLengthHint);
+	double const crv_x = m_arcLengthMapper.xToArcLen(pln_x);
 
 	Vec2d const pln_top_pt(pln_x, 0);
 	Vec2d const pln_bottom_pt(pln_x, 1);
@@ -178,14 +183,48 @@ CylindricalSurfaceDewarper::mapToDewarpedSpace(QPointF const& img_pt) const
 	return QPointF(crv_x, crv_y);
 }
 
+std::vector<QPointF>
+CylindricalSurfaceDewarper::mapToDewarpedSpace(std::vector<QPointF> const& img_pts) const
+{
+	std::vector<QPointF> crv_pts;
+	crv_pts.reserve(img_pts.size());
+
+	State state;
+	BOOST_FOREACH(QPointF const& img_pt, img_pts) {
+		crv_pts.push_back(mapToDewarpedSpace(img_pt, state));
+	}
+
+	return crv_pts;
+}
+
 QPointF
 CylindricalSurfaceDewarper::mapToWarpedSpace(QPointF const& crv_pt) const
 {
 	State state;
+	return mapToWarpedSpace(crv_pt, state);
+}
+
+QPointF
+CylindricalSurfaceDewarper::mapToWarpedSpace(QPointF const& crv_pt, State& state) const
+{
 	Generatrix const gtx(mapGeneratrix(crv_pt.x(), state));
 	return gtx.imgLine.pointAt(gtx.pln2img(crv_pt.y()));
 }
 
+std::vector<QPointF>
+CylindricalSurfaceDewarper::mapToWarpedSpace(std::vector<QPointF> const& crv_pts) const
+{
+	std::vector<QPointF> img_pts;
+	img_pts.reserve(crv_pts.size());
+
+	State state;
+	BOOST_FOREACH(QPointF const& crv_pt, crv_pts) {
+		img_pts.push_back(mapToWarpedSpace(crv_pt, state));
+	}
+
+	return img_pts;
+}
+
 HomographicTransform<2, double>
 CylindricalSurfaceDewarper::calcPlnToImgHomography(
 	std::vector<QPointF> const& img_directrix1,
@@ -326,7 +365,6 @@ CylindricalSurfaceDewarper::initArcLengthMapper(
 	std::vector<QPointF> const& img_directrix1,
 	std::vector<QPointF> const& img_directrix2)
 {
-	double prev_elevation = 0;
 	CoupledPolylinesIterator it(img_directrix1, img_directrix2, m_pln2img, m_img2pln);
 	QPointF img_curve1_pt;
 	QPointF img_curve2_pt;
@@ -343,24 +381,51 @@ CylindricalSurfaceDewarper::initArcLengthMapper(
 		QLineF const img_generatrix(img_curve1_pt, img_curve2_pt);
 		Vec2d const img_line1_pt(m_pln2img(Vec2d(pln_x, 0)));
 		Vec2d const img_line2_pt(m_pln2img(Vec2d(pln_x, 1)));
-		
+
 		ToLineProjector const projector(img_generatrix);
 		double const y1 = projector.projectionScalar(img_line1_pt);
 		double const y2 = projector.projectionScalar(img_line2_pt);
 
-		double elevation = m_depthPerception * (1.0 - (y2 - y1));
-		elevation = qBound(-0.5, elevation, 0.5);
-
-		m_arcLengthMapper.addSample(pln_x, elevation);
-		prev_elevation = elevation;
+		m_flatnessSamples.push_back(std::make_pair(pln_x, 1.0 - (y2 - y1)));
 		prev_pln_x = pln_x;
 	}
 
+	buildArcLengthMapper();
+}
+
+void
+CylindricalSurfaceDewarper::buildArcLengthMapper()
+{
+	m_arcLengthMapper = ArcLengthMapper();
+
+	typedef std::pair<double, double> Sample;
+	BOOST_FOREACH(Sample const& sample, m_flatnessSamples) {
+		double const elevation = qBound(
+			-0.5, m_depthPerception * sample.second, 0.5
+		);
+		m_arcLengthMapper.addSample(sample.first, elevation);
+	}
+
 	// Needs to go before normalizeRange().
 	m_directrixArcLength = m_arcLengthMapper.totalArcLength();
 
 	// Scale arc lengths to the range of [0, 1].
 	m_arcLengthMapper.normalizeRange(1);
+
+	// Enables the hint-free lookups used by mapGeneratrix()
+	// and mapToDewarpedSpace().
+	m_arcLengthMapper.buildInverseLut();
+}
+
+void
+CylindricalSurfaceDewarper::setDepthPerception(double depth_perception)
+{
+	if (depth_perception == m_depthPerception) {
+		return;
+	}
+
+	m_depthPerception = depth_perception;
+	buildArcLengthMapper();
 }
 
 
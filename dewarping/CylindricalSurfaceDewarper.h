@@ -42,7 +42,6 @@ public:
 	private:
 		PolylineIntersector::Hint m_intersectionHint1;
 		PolylineIntersector::Hint m_intersectionHint2;
-		ArcLengthMapper::Hint m_arcLengthHint;
 	};
 
 	struct Generatrix
@@ -71,6 +70,16 @@ public:
 	 */
 	double directrixArcLength() const { return m_directrixArcLength; }
 
+	/**
+	 * \brief Re-parameterizes the model for a different depth perception.
+	 *
+	 * Depth perception only affects the arc length parametrization,
+	 * which is rebuilt here from cached per-sample surface flatness
+	 * values.  This is much cheaper than constructing a new dewarper,
+	 * as the directrix geometry doesn't have to be recomputed.
+	 */
+	void setDepthPerception(double depth_perception);
+
 	Generatrix mapGeneratrix(double crv_x, State& state) const;
 
 	/**
@@ -81,6 +90,26 @@ public:
 	 */
 	QPointF mapToDewarpedSpace(QPointF const& img_pt) const;
 
+	/**
+	 * \brief Same as above, but with an externally provided state.
+	 *
+	 * The hints in \p state make mapping a point close to the
+	 * previously mapped one much cheaper, so when transforming
+	 * a polyline or some other spatially coherent sequence of
+	 * points, share a single State object across the calls.
+	 */
+	QPointF mapToDewarpedSpace(QPointF const& img_pt, State& state) const;
+
+	/**
+	 * \brief Transforms a sequence of points from warped image
+	 *        coordinates to dewarped normalized coordinates.
+	 *
+	 * Equivalent to mapping each point individually, except the
+	 * intersection and arc length hints are carried over from one
+	 * point to the next.
+	 */
+	std::vector<QPointF> mapToDewarpedSpace(std::vector<QPointF> const& img_pts) const;
+
 	/**
 	 * Transforms a point from dewarped normalized coordinates
 	 * to warped image coordinates.  See comments in the beginning
@@ -88,6 +117,21 @@ public:
 	 * systems we owork with.
 	 */
 	QPointF mapToWarpedSpace(QPointF const& crv_pt) const;
+
+	/**
+	 * \brief Same as above, but with an externally provided state.
+	 *
+	 * \see mapToDewarpedSpace(QPointF const&, State&)
+	 */
+	QPointF mapToWarpedSpace(QPointF const& crv_pt, State& state) const;
+
+	/**
+	 * \brief Transforms a sequence of points from dewarped normalized
+	 *        coordinates to warped image coordinates.
+	 *
+	 * \see mapToDewarpedSpace(std::vector<QPointF> const&)
+	 */
+	std::vector<QPointF> mapToWarpedSpace(std::vector<QPointF> const& crv_pts) const;
 private:
 	class CoupledPolylinesIterator;
 	
@@ -111,11 +155,22 @@ private:
 		std::vector<QPointF> const& img_directrix1,
 		std::vector<QPointF> const& img_directrix2);
 
+	void buildArcLengthMapper();
+
 	HomographicTransform<2, double> m_pln2img;
 	HomographicTransform<2, double> m_img2pln;
 	double m_depthPerception;
 	double m_plnStraightLineY;
 	double m_directrixArcLength;
+
+	/**
+	 * Per-sample (pln_x, flatness) pairs collected by initArcLengthMapper(),
+	 * where flatness is the depth-independent part of the elevation formula.
+	 * Kept around so that setDepthPerception() can rebuild m_arcLengthMapper
+	 * without re-walking the directrixes.
+	 */
+	std::vector<std::pair<double, double> > m_flatnessSamples;
+
 	ArcLengthMapper m_arcLengthMapper;
 	PolylineIntersector m_imgDirectrix1Intersector;
 	PolylineIntersector m_imgDirectrix2Intersector;
@@ -21,6 +21,7 @@
 #include "VecNT.h"
 #include "SidesOfLine.h"
 #include "imageproc/BinaryImage.h"
+#include "imageproc/BitOps.h"
 #include "imageproc/Constants.h"
 #include <QImage>
 #include <QPoint>
@@ -423,38 +424,76 @@ QImage visualizeSegments(QImage const& background, std::vector<Segment> const& s
 }
 
 // For every column in the image, store the top-most and bottom-most black pixel.
+// The image is scanned row by row rather than column by column, keeping
+// memory accesses sequential.  A per-word mask tracks the columns that
+// haven't got their value yet, so each 32-pixel word is tested with a
+// single AND and fully resolved words are skipped.
 void calculateVertRanges(imageproc::BinaryImage const& image, std::vector<VertRange>& ranges)
 {
 	int const width = image.width();
 	int const height = image.height();
-	uint32_t const* image_data = image.data();
+	uint32_t const* const image_data = image.data();
 	int const image_stride = image.wordsPerLine();
+	int const num_words = (width + 31) >> 5;
 	uint32_t const msb = uint32_t(1) << 31;
 
-	ranges.reserve(width);
+	ranges.assign(width, VertRange());
 
-	for (int x = 0; x < width; ++x) {
-		ranges.push_back(VertRange());
-		VertRange& range = ranges.back();
-		
-		uint32_t const mask = msb >> (x & 31);
-		uint32_t const* p_word = image_data + (x >> 5);
+	// A set bit indicates a column of interest.  Padding bits
+	// of the last word are kept zero.
+	std::vector<uint32_t> valid_mask(num_words, ~uint32_t(0));
+	if (width & 31) {
+		valid_mask.back() = ~uint32_t(0) << (32 - (width & 31));
+	}
 
-		int top_y = 0;
-		for (; top_y < height; ++top_y, p_word += image_stride) {
-			if (*p_word & mask) {
-				range.top = top_y;
-				break;
+	// Columns that are still missing their top coordinate.
+	std::vector<uint32_t> missing(valid_mask);
+	int words_remaining = num_words;
+
+	uint32_t const* line = image_data;
+	for (int y = 0; y < height && words_remaining > 0; ++y, line += image_stride) {
+		for (int wi = 0; wi < num_words; ++wi) {
+			uint32_t hits = line[wi] & missing[wi];
+			if (!hits) {
+				continue;
+			}
+			missing[wi] &= ~hits;
+			if (!missing[wi]) {
+				--words_remaining;
 			}
+			do {
+				int const bit = countMostSignificantZeroes(hits);
+				ranges[(wi << 5) + bit].top = y;
+				hits &= ~(msb >> bit);
+			} while (hits);
 		}
+	}
 
-		int bottom_y = height - 1;
-		p_word = image_data + bottom_y * image_stride + (x >> 5);
-		for (; bottom_y >= top_y; --bottom_y, p_word -= image_stride) {
-			if (*p_word & mask) {
-				range.bottom = bottom_y;
-				break;
+	// Exactly the columns that got a top have a bottom.
+	words_remaining = 0;
+	for (int wi = 0; wi < num_words; ++wi) {
+		missing[wi] ^= valid_mask[wi];
+		if (missing[wi]) {
+			++words_remaining;
+		}
+	}
+
+	line = image_data + (height - 1) * image_stride;
+	for (int y = height - 1; y >= 0 && words_remaining > 0; --y, line -= image_stride) {
+		for (int wi = 0; wi < num_words; ++wi) {
+			uint32_t hits = line[wi] & missing[wi];
+			if (!hits) {
+				continue;
+			}
+			missing[wi] &= ~hits;
+			if (!missing[wi]) {
+				--words_remaining;
 			}
+			do {
+				int const bit = countMostSignificantZeroes(hits);
+				ranges[(wi << 5) + bit].bottom = y;
+				hits &= ~(msb >> bit);
+			} while (hits);
 		}
 	}
 }
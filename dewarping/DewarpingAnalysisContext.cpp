@@ -0,0 +1,117 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DewarpingAnalysisContext.h"
+#include "imageproc/Scale.h"
+#include "imageproc/Sobel.h"
+#include <QSize>
+#ifndef Q_MOC_RUN
+#include <boost/lambda/lambda.hpp>
+#endif
+#include <math.h>
+
+using namespace imageproc;
+
+namespace dewarping
+{
+
+DewarpingAnalysisContext::DewarpingAnalysisContext(
+	GrayImage const& image, Dpi const& dpi,
+	std::pair<QLineF, QLineF> const& vert_bounds)
+:	m_image(image),
+	m_dpi(dpi),
+	m_vertBounds(vert_bounds),
+	m_unitDownVec(calcUnitDownVec(vert_bounds))
+{
+}
+
+GrayImage const&
+DewarpingAnalysisContext::coarseImage() const
+{
+	if (m_coarseImage.isNull()) {
+		m_coarseImage = scaleToGray(
+			m_image, QSize(
+				m_image.width() / PYRAMID_SCALE,
+				m_image.height() / PYRAMID_SCALE
+			)
+		);
+	}
+	return m_coarseImage;
+}
+
+Grid<float> const&
+DewarpingAnalysisContext::directionalDerivative() const
+{
+	if (m_directionalDerivative.isNull()) {
+		calcDirectionalDerivative(
+			m_image, m_unitDownVec, m_directionalDerivative
+		);
+	}
+	return m_directionalDerivative;
+}
+
+Grid<float> const&
+DewarpingAnalysisContext::coarseDirectionalDerivative() const
+{
+	if (m_coarseDirectionalDerivative.isNull()) {
+		calcDirectionalDerivative(
+			coarseImage(), m_unitDownVec, m_coarseDirectionalDerivative
+		);
+	}
+	return m_coarseDirectionalDerivative;
+}
+
+Vec2f
+DewarpingAnalysisContext::calcUnitDownVec(std::pair<QLineF, QLineF> const& bounds)
+{
+	Vec2f v1(bounds.first.p2() - bounds.first.p1());
+	v1 /= sqrt(v1.squaredNorm());
+
+	Vec2f v2(bounds.second.p2() - bounds.second.p1());
+	v2 /= sqrt(v2.squaredNorm());
+
+	Vec2f v3(v1 + v2);
+	v3 /= sqrt(v3.squaredNorm());
+
+	if (v3[1] < 0) {
+		v3 = -v3;
+	}
+
+	return v3;
+}
+
+void
+DewarpingAnalysisContext::calcDirectionalDerivative(
+	GrayImage const& image, Vec2f const& direction, Grid<float>& out)
+{
+	using namespace boost::lambda;
+
+	Grid<float>(
+		image.width(), image.height(), /*padding=*/0,
+		Grid<float>::ALIGN_CACHE_LINES
+	).swap(out);
+
+	float const downscale = 1.0f / (255.0f * 8.0f);
+	directionalSobel<float>(
+		image.width(), image.height(), image.data(), image.stride(),
+		_1 * downscale, out.data(), out.stride(),
+		direction[0], direction[1]
+	);
+}
+
+} // namespace dewarping
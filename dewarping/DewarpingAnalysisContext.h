@@ -0,0 +1,103 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEWARPING_DEWARPING_ANALYSIS_CONTEXT_H_
+#define DEWARPING_DEWARPING_ANALYSIS_CONTEXT_H_
+
+#include "NonCopyable.h"
+#include "Grid.h"
+#include "VecNT.h"
+#include "Dpi.h"
+#include "imageproc/GrayImage.h"
+#include <QLineF>
+#include <utility>
+
+namespace dewarping
+{
+
+/**
+ * \brief Per-page analysis state shared between text line detection stages.
+ *
+ * TextLineTracer and TextLineRefiner both work off the same downscaled
+ * page and both need its directional derivative along the text column
+ * direction.  This class holds the downscaled image, the vertical
+ * content bounds it was analysed against, and lazily built derived
+ * fields, so each field is computed once per page no matter how many
+ * stages read it.
+ */
+class DewarpingAnalysisContext
+{
+	DECLARE_NON_COPYABLE(DewarpingAnalysisContext)
+public:
+	enum { PYRAMID_SCALE = 4 };
+
+	DewarpingAnalysisContext(
+		imageproc::GrayImage const& image, Dpi const& dpi,
+		std::pair<QLineF, QLineF> const& vert_bounds);
+
+	imageproc::GrayImage const& image() const { return m_image; }
+
+	Dpi const& dpi() const { return m_dpi; }
+
+	std::pair<QLineF, QLineF> const& verticalBounds() const { return m_vertBounds; }
+
+	/**
+	 * The average unit vector of the vertical bounds, pointing down
+	 * the page.
+	 */
+	Vec2f const& unitDownVec() const { return m_unitDownVec; }
+
+	/**
+	 * \brief The 1/PYRAMID_SCALE level of the image pyramid.
+	 *
+	 * Built on first use.
+	 */
+	imageproc::GrayImage const& coarseImage() const;
+
+	/**
+	 * \brief Raw first derivative of image() along unitDownVec().
+	 *
+	 * A directional Sobel with the conventional 1/(255*8) prescale,
+	 * not blurred.  Consumers blur it with whatever sigma they need.
+	 * Built on first use.
+	 */
+	Grid<float> const& directionalDerivative() const;
+
+	/**
+	 * Same as directionalDerivative(), but of coarseImage().
+	 */
+	Grid<float> const& coarseDirectionalDerivative() const;
+private:
+	static Vec2f calcUnitDownVec(std::pair<QLineF, QLineF> const& bounds);
+
+	static void calcDirectionalDerivative(
+		imageproc::GrayImage const& image,
+		Vec2f const& direction, Grid<float>& out);
+
+	imageproc::GrayImage m_image;
+	Dpi m_dpi;
+	std::pair<QLineF, QLineF> m_vertBounds;
+	Vec2f m_unitDownVec;
+	mutable imageproc::GrayImage m_coarseImage;
+	mutable Grid<float> m_directionalDerivative;
+	mutable Grid<float> m_coarseDirectionalDerivative;
+};
+
+} // namespace dewarping
+
+#endif
@@ -125,6 +125,13 @@ DistortionModel::matches(DistortionModel const& other) const
 	return true;
 }
 
+bool
+DistortionModel::operator==(DistortionModel const& other) const
+{
+	return m_topCurve == other.m_topCurve
+		&& m_bottomCurve == other.m_bottomCurve;
+}
+
 QRectF
 DistortionModel::modelDomain(
 	CylindricalSurfaceDewarper const& dewarper,
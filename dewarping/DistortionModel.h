@@ -58,8 +58,17 @@ public:
 
 	Curve const& bottomCurve() const { return m_bottomCurve; }
 
+	/**
+	 * \brief Approximate comparison: invalid models all compare equal
+	 *        and curves are allowed to drift slightly.
+	 */
 	bool matches(DistortionModel const& other) const;
 
+	/**
+	 * \brief Exact field-by-field comparison, unlike matches().
+	 */
+	bool operator==(DistortionModel const& other) const;
+
 	/**
 	 * Model domain is a rectangle in output image coordinates that
 	 * will be mapped to our curved quadrilateral.
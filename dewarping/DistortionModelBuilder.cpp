@@ -501,11 +501,12 @@ try {
 		std::vector<double> B;
 		B.reserve(polyline_size);
 
-		BOOST_FOREACH(QPointF const& warped_pt, curve.trimmedPolyline) {
-			// TODO: add another signature with hint for efficiency.
-			QPointF const dewarped_pt(dewarper.mapToDewarpedSpace(warped_pt));
+		std::vector<QPointF> const dewarped_polyline(
+			dewarper.mapToDewarpedSpace(curve.trimmedPolyline)
+		);
 
-			// ax + b = y  <-> x * a + 1 * b = y 
+		BOOST_FOREACH(QPointF const& dewarped_pt, dewarped_polyline) {
+			// ax + b = y  <-> x * a + 1 * b = y
 			At.push_back(dewarped_pt.x());
 			At.push_back(1);
 			B.push_back(dewarped_pt.y());
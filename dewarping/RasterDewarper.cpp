@@ -17,11 +17,14 @@
 */
 
 #include "RasterDewarper.h"
+#include "TaskStatus.h"
 #include "CylindricalSurfaceDewarper.h"
 #include "HomographicTransform.h"
 #include "VecNT.h"
+#include "VecArrayNT.h"
 #include "imageproc/ColorMixer.h"
 #include "imageproc/GrayImage.h"
+#include "imageproc/ParallelFor.h"
 #include <QtGlobal>
 #include <QColor>
 #include <QImage>
@@ -51,7 +54,8 @@ void dewarpGeneric(
 	int const src_stride, PixelType* const dst_data,
 	QSize const dst_size, int const dst_stride,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, PixelType const bg_color)
+	QRectF const& model_domain, PixelType const bg_color,
+	TaskStatus const* status)
 {
 	int const src_width = src_size.width();
 	int const src_height = src_size.height();
@@ -67,6 +71,10 @@ void dewarpGeneric(
 	float const model_y_scale = 1.0 / (model_domain.bottom() - model_domain.top());
 
 	for (int dst_x = 0; dst_x < dst_width; ++dst_x) {
+		if (status && (dst_x & 15) == 0) {
+			// An atomic flag check - cheap enough for every column.
+			status->throwIfCancelled();
+		}
 		double const model_x = (dst_x - model_domain_left) * model_x_scale;
 		CylindricalSurfaceDewarper::Generatrix const generatrix(
 			distortion_model.mapGeneratrix(model_x, state)
@@ -98,7 +106,8 @@ void dewarpGeneric(
 	int const src_stride, PixelType* const dst_data,
 	QSize const dst_size, int const dst_stride,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, PixelType const bg_color)
+	QRectF const& model_domain, PixelType const bg_color,
+	TaskStatus const* status)
 {
 	int const src_width = src_size.width();
 	int const src_height = src_size.height();
@@ -114,6 +123,10 @@ void dewarpGeneric(
 	float const model_y_scale = 1.0 / (model_domain.bottom() - model_domain.top());
 
 	for (int dst_x = 0; dst_x < dst_width; ++dst_x) {
+		if (status && (dst_x & 15) == 0) {
+			// An atomic flag check - cheap enough for every column.
+			status->throwIfCancelled();
+		}
 		double const model_x = (dst_x - model_domain_left) * model_x_scale;
 		CylindricalSurfaceDewarper::Generatrix const generatrix(
 			distortion_model.mapGeneratrix(model_x, state)
@@ -171,46 +184,54 @@ void areaMapGeneratrix(
 	int const src_stride, PixelType* p_dst,
 	QSize const dst_size, int const dst_stride,
 	PixelType const bg_color,
-	std::vector<Vec2f> const& prev_grid_column,
-	std::vector<Vec2f> const& next_grid_column)
+	Vec2ArrayF const& prev_grid_column,
+	Vec2ArrayF const& next_grid_column)
 {
 	int const sw = src_size.width();
 	int const sh = src_size.height();
 	int const dst_height = dst_size.height();
 
-	Vec2f const* src_left_points = &prev_grid_column[0];
-	Vec2f const* src_right_points = &next_grid_column[0];
+	float const* src_left_x = prev_grid_column.plane(0);
+	float const* src_left_y = prev_grid_column.plane(1);
+	float const* src_right_x = next_grid_column.plane(0);
+	float const* src_right_y = next_grid_column.plane(1);
 
-	Vec2f f_src32_quad[4];
+	float f_src32_quad_x[4];
+	float f_src32_quad_y[4];
 
 	for (int dst_y = 0; dst_y < dst_height; ++dst_y) {
 		// Take a mid-point of each edge, pre-multiply by 32,
-		// write the result to f_src32_quad. 16 comes from 32*0.5
-		f_src32_quad[0] = 16.0f * (src_left_points[0] + src_right_points[0]);
-		f_src32_quad[1] = 16.0f * (src_right_points[0] + src_right_points[1]);
-		f_src32_quad[2] = 16.0f * (src_right_points[1] + src_left_points[1]);
-		f_src32_quad[3] = 16.0f * (src_left_points[0] + src_left_points[1]);
-		++src_left_points;
-		++src_right_points;
+		// write the result to f_src32_quad_*. 16 comes from 32*0.5
+		f_src32_quad_x[0] = 16.0f * (src_left_x[0] + src_right_x[0]);
+		f_src32_quad_x[1] = 16.0f * (src_right_x[0] + src_right_x[1]);
+		f_src32_quad_x[2] = 16.0f * (src_right_x[1] + src_left_x[1]);
+		f_src32_quad_x[3] = 16.0f * (src_left_x[0] + src_left_x[1]);
+		f_src32_quad_y[0] = 16.0f * (src_left_y[0] + src_right_y[0]);
+		f_src32_quad_y[1] = 16.0f * (src_right_y[0] + src_right_y[1]);
+		f_src32_quad_y[2] = 16.0f * (src_right_y[1] + src_left_y[1]);
+		f_src32_quad_y[3] = 16.0f * (src_left_y[0] + src_left_y[1]);
+		++src_left_x;
+		++src_left_y;
+		++src_right_x;
+		++src_right_y;
 
 		// Calculate the bounding box of src_quad.
 
-		float f_src32_left = f_src32_quad[0][0];
-		float f_src32_top = f_src32_quad[0][1];
+		float f_src32_left = f_src32_quad_x[0];
+		float f_src32_top = f_src32_quad_y[0];
 		float f_src32_right = f_src32_left;
 		float f_src32_bottom = f_src32_top;
 
 		for (int i = 1; i < 4; ++i) {
-			Vec2f const pt(f_src32_quad[i]);
-			if (pt[0] < f_src32_left) {
-				f_src32_left = pt[0];
-			} else if (pt[0] > f_src32_right) {
-				f_src32_right = pt[0];
+			if (f_src32_quad_x[i] < f_src32_left) {
+				f_src32_left = f_src32_quad_x[i];
+			} else if (f_src32_quad_x[i] > f_src32_right) {
+				f_src32_right = f_src32_quad_x[i];
 			}
-			if (pt[1] < f_src32_top) {
-				f_src32_top = pt[1];
-			} else if (pt[1] > f_src32_bottom) {
-				f_src32_bottom = pt[1];
+			if (f_src32_quad_y[i] < f_src32_top) {
+				f_src32_top = f_src32_quad_y[i];
+			} else if (f_src32_quad_y[i] > f_src32_bottom) {
+				f_src32_bottom = f_src32_quad_y[i];
 			}
 		}
 
@@ -341,11 +362,7 @@ void areaMapGeneratrix(
 				unsigned const right_area = vert_fraction * right_fraction;
 				
 				mixer.add(src_line[src_left], left_area);
-				
-				for (int sx = src_left + 1; sx < src_right; ++sx) {
-					mixer.add(src_line[sx], middle_area);
-				}
-				
+				mixer.addSpan(src_line + src_left + 1, src_right - src_left - 1, middle_area);
 				mixer.add(src_line[src_right], right_area);
 			}
 		} else if (src_left == src_right) {
@@ -379,38 +396,30 @@ void areaMapGeneratrix(
 			
 			// process the top-left corner
 			mixer.add(src_line[src_left], topleft_area);
-			
+
 			// process the top line (without corners)
-			for (int sx = src_left + 1; sx < src_right; ++sx) {
-				mixer.add(src_line[sx], top_area);
-			}
-			
+			mixer.addSpan(src_line + src_left + 1, src_right - src_left - 1, top_area);
+
 			// process the top-right corner
 			mixer.add(src_line[src_right], topright_area);
-			
+
 			src_line += src_stride;
-			
+
 			// process middle lines
 			for (int sy = src_top + 1; sy < src_bottom; ++sy) {
 				mixer.add(src_line[src_left], left_area);
-				
-				for (int sx = src_left + 1; sx < src_right; ++sx) {
-					mixer.add(src_line[sx], 32*32);
-				}
-				
+				mixer.addSpan(src_line + src_left + 1, src_right - src_left - 1, 32*32);
 				mixer.add(src_line[src_right], right_area);
-				
+
 				src_line += src_stride;
 			}
-			
+
 			// process bottom-left corner
 			mixer.add(src_line[src_left], bottomleft_area);
-			
+
 			// process the bottom line (without corners)
-			for (int sx = src_left + 1; sx < src_right; ++sx) {
-				mixer.add(src_line[sx], bottom_area);
-			}
-			
+			mixer.addSpan(src_line + src_left + 1, src_right - src_left - 1, bottom_area);
+
 			// process the bottom-right corner
 			mixer.add(src_line[src_right], bottomright_area);
 		}
@@ -420,53 +429,110 @@ void areaMapGeneratrix(
 	}
 }
 
+/**
+ * Dewarps a contiguous range of destination columns.  Each worker
+ * carries its own CylindricalSurfaceDewarper::State (it's merely a set
+ * of lookup hints) and its own pair of grid columns, so strips are
+ * completely independent of each other.
+ */
 template<typename ColorMixer, typename PixelType>
-void dewarpGeneric(
-	PixelType const* const src_data, QSize const src_size,
-	int const src_stride, PixelType* const dst_data,
-	QSize const dst_size, int const dst_stride,
-	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, PixelType const bg_color)
+class DewarpStrips
 {
-	int const src_width = src_size.width();
-	int const src_height = src_size.height();
-	int const dst_width = dst_size.width();
-	int const dst_height = dst_size.height();
-
-	CylindricalSurfaceDewarper::State state;
-
-	double const model_domain_left = model_domain.left();
-	double const model_x_scale = 1.0 / (model_domain.right() - model_domain.left());
-
-	float const model_domain_top = model_domain.top();
-	float const model_y_scale = 1.0 / (model_domain.bottom() - model_domain.top());
+public:
+	DewarpStrips(
+		PixelType const* src_data, QSize const& src_size,
+		int src_stride, PixelType* dst_data,
+		QSize const& dst_size, int dst_stride,
+		CylindricalSurfaceDewarper const& distortion_model,
+		QRectF const& model_domain, PixelType bg_color,
+		TaskStatus const* status)
+	:	m_pSrcData(src_data), m_srcSize(src_size), m_srcStride(src_stride),
+		m_pDstData(dst_data), m_dstSize(dst_size), m_dstStride(dst_stride),
+		m_rDistortionModel(distortion_model),
+		m_modelDomainLeft(model_domain.left()),
+		m_modelXScale(1.0 / (model_domain.right() - model_domain.left())),
+		m_modelDomainTop(model_domain.top()),
+		m_modelYScale(1.0 / (model_domain.bottom() - model_domain.top())),
+		m_bgColor(bg_color), m_pStatus(status) {}
+
+	void operator()(int const begin_x, int const end_x) const {
+		int const dst_height = m_dstSize.height();
+
+		CylindricalSurfaceDewarper::State state;
+		Vec2ArrayF prev_grid_column(dst_height + 1);
+		Vec2ArrayF next_grid_column(dst_height + 1);
+
+		for (int dst_x = begin_x; dst_x <= end_x; ++dst_x) {
+			if (m_pStatus && (dst_x & 15) == 0 && m_pStatus->isCancelled()) {
+				// Bail out quietly - the exception is thrown by
+				// the thread that launched us, once all the
+				// workers are done.
+				return;
+			}
+			double const model_x = (dst_x - m_modelDomainLeft) * m_modelXScale;
+			CylindricalSurfaceDewarper::Generatrix const generatrix(
+				m_rDistortionModel.mapGeneratrix(model_x, state)
+			);
 
-	std::vector<Vec2f> prev_grid_column(dst_height + 1);
-	std::vector<Vec2f> next_grid_column(dst_height + 1);
+			HomographicTransform<1, float> const homog(generatrix.pln2img.mat());
+			Vec2f const origin(generatrix.imgLine.p1());
+			Vec2f const vec(generatrix.imgLine.p2() - generatrix.imgLine.p1());
+			float* const grid_x = next_grid_column.plane(0);
+			float* const grid_y = next_grid_column.plane(1);
+			for (int dst_y = 0; dst_y <= dst_height; ++dst_y) {
+				float const model_y = (float(dst_y) - m_modelDomainTop) * m_modelYScale;
+				float const frac = homog(model_y);
+				grid_x[dst_y] = origin[0] + vec[0] * frac;
+				grid_y[dst_y] = origin[1] + vec[1] * frac;
+			}
 
-	for (int dst_x = 0; dst_x <= dst_width; ++dst_x) {
-		double const model_x = (dst_x - model_domain_left) * model_x_scale;
-		CylindricalSurfaceDewarper::Generatrix const generatrix(
-			distortion_model.mapGeneratrix(model_x, state)
-		);
+			if (dst_x != begin_x) {
+				areaMapGeneratrix<ColorMixer, PixelType>(
+					m_pSrcData, m_srcSize, m_srcStride,
+					m_pDstData + dst_x - 1, m_dstSize, m_dstStride,
+					m_bgColor, prev_grid_column, next_grid_column
+				);
+			}
 
-		HomographicTransform<1, float> const homog(generatrix.pln2img.mat());
-		Vec2f const origin(generatrix.imgLine.p1());
-		Vec2f const vec(generatrix.imgLine.p2() - generatrix.imgLine.p1());
-		for (int dst_y = 0; dst_y <= dst_height; ++dst_y) {
-			float const model_y = (float(dst_y) - model_domain_top) * model_y_scale;
-			next_grid_column[dst_y] = origin + vec * homog(model_y);
+			prev_grid_column.swap(next_grid_column);
 		}
+	}
+private:
+	PixelType const* m_pSrcData;
+	QSize m_srcSize;
+	int m_srcStride;
+	PixelType* m_pDstData;
+	QSize m_dstSize;
+	int m_dstStride;
+	CylindricalSurfaceDewarper const& m_rDistortionModel;
+	double m_modelDomainLeft;
+	double m_modelXScale;
+	float m_modelDomainTop;
+	float m_modelYScale;
+	PixelType m_bgColor;
+	TaskStatus const* m_pStatus;
+};
 
-		if (dst_x != 0) {
-			areaMapGeneratrix<ColorMixer, PixelType>(
-				src_data, src_size, src_stride,
-				dst_data + dst_x - 1, dst_size, dst_stride,
-				bg_color, prev_grid_column, next_grid_column
-			);
-		}
+template<typename ColorMixer, typename PixelType>
+void dewarpGeneric(
+	PixelType const* const src_data, QSize const src_size,
+	int const src_stride, PixelType* const dst_data,
+	QSize const dst_size, int const dst_stride,
+	CylindricalSurfaceDewarper const& distortion_model,
+	QRectF const& model_domain, PixelType const bg_color,
+	TaskStatus const* status)
+{
+	// Each strip of columns [begin, end) computes the grid columns
+	// begin .. end and writes the dst columns begin .. end - 1, so the
+	// only duplicated work between adjacent strips is one grid column.
+	DewarpStrips<ColorMixer, PixelType> const strips(
+		src_data, src_size, src_stride, dst_data, dst_size, dst_stride,
+		distortion_model, model_domain, bg_color, status
+	);
+	parallelForRanges(0, dst_size.width(), strips);
 
-		prev_grid_column.swap(next_grid_column);
+	if (status) {
+		status->throwIfCancelled();
 	}
 }
 
@@ -481,7 +547,8 @@ typedef unsigned MixingWeight;
 QImage dewarpGrayscale(
 	QImage const& src, QSize const& dst_size,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, QColor const& bg_color)
+	QRectF const& model_domain, QColor const& bg_color,
+	TaskStatus const* status)
 {
 	GrayImage dst(dst_size);
 	uint8_t const bg_sample = qGray(bg_color.rgb());
@@ -489,7 +556,7 @@ QImage dewarpGrayscale(
 	dewarpGeneric<GrayColorMixer<MixingWeight>, uint8_t>(
 		src.bits(), src.size(), src.bytesPerLine(),
 		dst.data(), dst_size, dst.stride(),
-		distortion_model, model_domain, bg_sample
+		distortion_model, model_domain, bg_sample, status
 	);
 	return dst.toQImage();
 }
@@ -497,14 +564,15 @@ QImage dewarpGrayscale(
 QImage dewarpRgb(
 	QImage const& src, QSize const& dst_size,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, QColor const& bg_color)
+	QRectF const& model_domain, QColor const& bg_color,
+	TaskStatus const* status)
 {
 	QImage dst(dst_size, QImage::Format_RGB32);
 	dst.fill(bg_color.rgb());
 	dewarpGeneric<RgbColorMixer<MixingWeight>, uint32_t>(
 		(uint32_t const*)src.bits(), src.size(), src.bytesPerLine()/4,
 		(uint32_t*)dst.bits(), dst_size, dst.bytesPerLine()/4,
-		distortion_model, model_domain, bg_color.rgb()
+		distortion_model, model_domain, bg_color.rgb(), status
 	);
 	return dst;
 }
@@ -512,14 +580,15 @@ QImage dewarpRgb(
 QImage dewarpArgb(
 	QImage const& src, QSize const& dst_size,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, QColor const& bg_color)
+	QRectF const& model_domain, QColor const& bg_color,
+	TaskStatus const* status)
 {
 	QImage dst(dst_size, QImage::Format_ARGB32);
 	dst.fill(bg_color.rgba());
 	dewarpGeneric<ArgbColorMixer<MixingWeight>, uint32_t>(
 		(uint32_t const*)src.bits(), src.size(), src.bytesPerLine()/4,
 		(uint32_t*)dst.bits(), dst_size, dst.bytesPerLine()/4,
-		distortion_model, model_domain, bg_color.rgba()
+		distortion_model, model_domain, bg_color.rgba(), status
 	);
 	return dst;
 }
@@ -530,7 +599,8 @@ QImage
 RasterDewarper::dewarp(
 	QImage const& src, QSize const& dst_size,
 	CylindricalSurfaceDewarper const& distortion_model,
-	QRectF const& model_domain, QColor const& bg_color)
+	QRectF const& model_domain, QColor const& bg_color,
+	TaskStatus const* status)
 {
 	if (model_domain.isEmpty()) {
 		throw std::invalid_argument("RasterDewarper: model_domain is empty.");
@@ -540,17 +610,17 @@ RasterDewarper::dewarp(
 		case QImage::Format_Invalid:
 			return QImage();
 		case QImage::Format_RGB32:
-			return dewarpRgb(src, dst_size, distortion_model, model_domain, bg_color);
+			return dewarpRgb(src, dst_size, distortion_model, model_domain, bg_color, status);
 		case QImage::Format_ARGB32:
-			return dewarpArgb(src, dst_size, distortion_model, model_domain, bg_color);
+			return dewarpArgb(src, dst_size, distortion_model, model_domain, bg_color, status);
 		case QImage::Format_Indexed8:
 			if (src.isGrayscale()) {
-				return dewarpGrayscale(src, dst_size, distortion_model, model_domain, bg_color);
+				return dewarpGrayscale(src, dst_size, distortion_model, model_domain, bg_color, status);
 			} else if (src.allGray()) {
 				// Only shades of gray but non-standard palette.
 				return dewarpGrayscale(
 					GrayImage(src).toQImage(), dst_size, distortion_model,
-					model_domain, bg_color
+					model_domain, bg_color, status
 				);
 			}
 			break;
@@ -559,7 +629,7 @@ RasterDewarper::dewarp(
 			if (src.allGray()) {
 				return dewarpGrayscale(
 					GrayImage(src).toQImage(),
-					dst_size, distortion_model, model_domain, bg_color
+					dst_size, distortion_model, model_domain, bg_color, status
 				);
 			}
 			break;
@@ -570,12 +640,12 @@ RasterDewarper::dewarp(
 	if (src.hasAlphaChannel()) {
 		return dewarpArgb(
 			src.convertToFormat(QImage::Format_ARGB32),
-			dst_size, distortion_model, model_domain, bg_color
+			dst_size, distortion_model, model_domain, bg_color, status
 		);
 	} else {
 		return dewarpRgb(
 			src.convertToFormat(QImage::Format_RGB32),
-			dst_size, distortion_model, model_domain, bg_color
+			dst_size, distortion_model, model_domain, bg_color, status
 		);
 	}
 }
@@ -23,6 +23,7 @@ class QImage;
 class QSize;
 class QRectF;
 class QColor;
+class TaskStatus;
 
 namespace dewarping
 {
@@ -32,10 +33,15 @@ class CylindricalSurfaceDewarper;
 class RasterDewarper
 {
 public:
+	/**
+	 * If \p status is provided, it's polled periodically from the
+	 * inner loops, keeping cancellation latency low.
+	 */
 	static QImage dewarp(
 		QImage const& src, QSize const& dst_size,
 		CylindricalSurfaceDewarper const& distortion_model,
-		QRectF const& model_domain, QColor const& background_color
+		QRectF const& model_domain, QColor const& background_color,
+		TaskStatus const* status = 0
 	);
 };
 
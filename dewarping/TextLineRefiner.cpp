@@ -17,13 +17,14 @@
 */
 
 #include "TextLineRefiner.h"
+#include "DewarpingAnalysisContext.h"
 #include "Dpi.h"
+#include "TaskStatus.h"
 #include "VecNT.h"
 #include "NumericTraits.h"
 #include "DebugImages.h"
 #include "imageproc/GrayImage.h"
 #include "imageproc/GaussBlur.h"
-#include "imageproc/Sobel.h"
 #ifndef Q_MOC_RUN
 #include <boost/scoped_array.hpp>
 #include <boost/foreach.hpp>
@@ -110,19 +111,19 @@ private:
 };
 
 
-TextLineRefiner::TextLineRefiner(
-	GrayImage const& image, Dpi const& dpi,
-	Vec2f const& unit_down_vector)
-: m_image(image)
-, m_dpi(dpi)
-, m_unitDownVec(unit_down_vector)
+TextLineRefiner::TextLineRefiner(DewarpingAnalysisContext const& context)
+: m_rContext(context)
+, m_image(context.image())
+, m_dpi(context.dpi())
+, m_unitDownVec(context.unitDownVec())
 {
 }
 
 void
 TextLineRefiner::refine(
 	std::list<std::vector<QPointF> >& polylines,
-	int const iterations, DebugImages* dbg) const
+	int const iterations, DebugImages* dbg,
+	TaskStatus const* status) const
 {
 	if (polylines.empty()) {
 		return;
@@ -140,29 +141,85 @@ TextLineRefiner::refine(
 		dbg->add(visualizeSnakes(snakes), "initial_snakes");
 	}
 
-	Grid<float> gradient(m_image.width(), m_image.height(), /*padding=*/0);
-
 	// Start with a rather strong blur.
 	float h_sigma = (4.0f / 200.f) * m_dpi.horizontal();
 	float v_sigma = (4.0f / 200.f) * m_dpi.vertical();
-	calcBlurredGradient(gradient, h_sigma, v_sigma);
-	
-	BOOST_FOREACH(Snake& snake, snakes) {
-		evolveSnake(snake, gradient, ON_CONVERGENCE_STOP);
+
+	// Coarse-to-fine schedule: do the bulk of the work on a
+	// quarter-scale image, where a snake covers the same physical
+	// distance in four times fewer steps and the gradient grid is
+	// 16 times smaller, then polish at full resolution.
+	int const pyramid_scale = DewarpingAnalysisContext::PYRAMID_SCALE;
+	bool const use_pyramid = m_image.width() >= 50 * pyramid_scale
+		&& m_image.height() >= 50 * pyramid_scale;
+
+	if (use_pyramid) {
+		float const scale = 1.0f / pyramid_scale;
+		Grid<float> const& coarse_deriv(m_rContext.coarseDirectionalDerivative());
+		Grid<float> coarse_gradient(
+			coarse_deriv.width(), coarse_deriv.height(), /*padding=*/0,
+			Grid<float>::ALIGN_CACHE_LINES
+		);
+
+		BOOST_FOREACH(Snake& snake, snakes) {
+			scaleSnake(snake, scale);
+		}
+
+		calcBlurredGradient(
+			coarse_deriv, coarse_gradient, h_sigma * scale, v_sigma * scale
+		);
+		BOOST_FOREACH(Snake& snake, snakes) {
+			evolveSnake(snake, coarse_gradient, ON_CONVERGENCE_STOP, status);
+		}
+
+		calcBlurredGradient(
+			coarse_deriv, coarse_gradient,
+			h_sigma * scale * 0.5f, v_sigma * scale * 0.5f
+		);
+		BOOST_FOREACH(Snake& snake, snakes) {
+			evolveSnake(snake, coarse_gradient, ON_CONVERGENCE_GO_FINER, status);
+		}
+
+		BOOST_FOREACH(Snake& snake, snakes) {
+			scaleSnake(snake, (float)pyramid_scale);
+			// Converged at the coarse level - a few polishing
+			// passes are enough at full resolution.
+			snake.iterationsRemaining = iterations / pyramid_scale;
+		}
+		if (dbg) {
+			dbg->add(visualizeSnakes(snakes), "coarse_snakes");
+		}
 	}
-	if (dbg) { 
-		dbg->add(visualizeSnakes(snakes, &gradient), "evolved_snakes1");
+
+	Grid<float> gradient(
+		m_image.width(), m_image.height(), /*padding=*/0,
+		Grid<float>::ALIGN_CACHE_LINES
+	);
+
+	if (!use_pyramid) {
+		calcBlurredGradient(
+			m_rContext.directionalDerivative(), gradient, h_sigma, v_sigma
+		);
+
+		BOOST_FOREACH(Snake& snake, snakes) {
+			evolveSnake(snake, gradient, ON_CONVERGENCE_STOP, status);
+		}
+		if (dbg) {
+			dbg->add(visualizeSnakes(snakes, &gradient), "evolved_snakes1");
+		}
 	}
 
 	// Less blurring this time.
 	h_sigma *= 0.5f;
 	v_sigma *= 0.5f;
-	calcBlurredGradient(gradient, h_sigma, v_sigma);
-	
+	calcBlurredGradient(
+		m_rContext.directionalDerivative(), gradient, h_sigma, v_sigma
+	);
+
 	BOOST_FOREACH(Snake& snake, snakes) {
-		evolveSnake(snake, gradient, ON_CONVERGENCE_GO_FINER);
+		evolveSnake(snake, gradient, ON_CONVERGENCE_GO_FINER, status);
 	}
-	if (dbg) { 
+	if (dbg) {
 		dbg->add(visualizeSnakes(snakes, &gradient), "evolved_snakes2");
 	}
 
@@ -180,28 +237,16 @@ TextLineRefiner::refine(
 
 void
 TextLineRefiner::calcBlurredGradient(
-	Grid<float>& gradient, float h_sigma, float v_sigma) const
+	Grid<float> const& first_deriv, Grid<float>& gradient,
+	float h_sigma, float v_sigma)
 {
 	using namespace boost::lambda;
 
-	float const downscale = 1.0f / (255.0f * 8.0f);
-	Grid<float> vert_grad(m_image.width(), m_image.height(), /*padding=*/0);
-	horizontalSobel<float>(
-		m_image.width(), m_image.height(), m_image.data(), m_image.stride(), _1 * downscale,
-		gradient.data(), gradient.stride(), _1 = _2, _1,
-		gradient.data(), gradient.stride(), _1 = _2
-	);
-	verticalSobel<float>(
-		m_image.width(), m_image.height(), m_image.data(), m_image.stride(), _1 * downscale,
-		vert_grad.data(), vert_grad.stride(), _1 = _2, _1,
-		gradient.data(), gradient.stride(),
-		_1 = _1 * m_unitDownVec[0] + _2 * m_unitDownVec[1]
-	);
-	Grid<float>().swap(vert_grad); // Save memory.
-
+	// The raw directional derivative comes from the shared analysis
+	// context - only the blur is specific to this call.
 	gaussBlurGeneric(
-		m_image.size(), h_sigma, v_sigma,
-		gradient.data(), gradient.stride(), _1,
+		QSize(first_deriv.width(), first_deriv.height()), h_sigma, v_sigma,
+		first_deriv.data(), first_deriv.stride(), _1,
 		gradient.data(), gradient.stride(), _1 = _2
 	);
 }
@@ -268,6 +313,15 @@ TextLineRefiner::makeSnake(std::vector<QPointF> const& polyline, int const itera
 	return snake;
 }
 
+void
+TextLineRefiner::scaleSnake(Snake& snake, float const factor)
+{
+	BOOST_FOREACH(SnakeNode& node, snake.nodes) {
+		node.center *= factor;
+		node.ribHalfLength *= factor;
+	}
+}
+
 void
 TextLineRefiner::calcFrenetFrames(
 	std::vector<FrenetFrame>& frenet_frames, Snake const& snake,
@@ -330,13 +384,19 @@ TextLineRefiner::calcFrenetFrames(
 
 void
 TextLineRefiner::evolveSnake(Snake& snake, Grid<float> const& gradient,
-							 OnConvergence const on_convergence) const
+							 OnConvergence const on_convergence,
+							 TaskStatus const* status) const
 {
 	float factor = 1.0f;
 
 	while (snake.iterationsRemaining > 0) {
 		--snake.iterationsRemaining;
 
+		if (status) {
+			// An atomic flag check - cheap enough for every iteration.
+			status->throwIfCancelled();
+		}
+
 		Optimizer optimizer(snake, m_unitDownVec, factor);
 		bool changed = false;
 		changed |= optimizer.thicknessAdjustment(snake, gradient);
@@ -31,20 +31,30 @@
 
 class Dpi;
 class DebugImages;
+class TaskStatus;
 class QImage;
 
 namespace dewarping
 {
 
+class DewarpingAnalysisContext;
+
 class TextLineRefiner
 {
 public:
-	TextLineRefiner(
-		imageproc::GrayImage const& image,
-		Dpi const& dpi, Vec2f const& unit_down_vector);
-
+	/**
+	 * The context provides the page image, its dpi, the text column
+	 * direction and the shared directional derivative fields.  It
+	 * must outlive the refiner.
+	 */
+	TextLineRefiner(DewarpingAnalysisContext const& context);
+
+	/**
+	 * If \p status is provided, it's polled between optimization
+	 * iterations, keeping cancellation latency low.
+	 */
 	void refine(std::list<std::vector<QPointF> >& polylines,
-		int iterations, DebugImages* dbg) const;
+		int iterations, DebugImages* dbg, TaskStatus const* status = 0) const;
 private:
 	enum OnConvergence { ON_CONVERGENCE_STOP, ON_CONVERGENCE_GO_FINER };
 
@@ -73,23 +83,29 @@ private:
 		float pathCost;
 	};
 
-	void calcBlurredGradient(Grid<float>& gradient, float h_sigma, float v_sigma) const;
+	static void calcBlurredGradient(
+		Grid<float> const& first_deriv, Grid<float>& gradient,
+		float h_sigma, float v_sigma);
 
 	static float externalEnergyAt(
 		Grid<float> const& gradient, Vec2f const& pos, float penalty_if_outside);
 
 	static Snake makeSnake(std::vector<QPointF> const& polyline, int iterations);
 
+	static void scaleSnake(Snake& snake, float factor);
+
 	static void calcFrenetFrames(
 		std::vector<FrenetFrame>& frenet_frames, Snake const& snake,
 		SnakeLength const& snake_length, Vec2f const& unit_down_vec);
 
-	void evolveSnake(Snake& snake, Grid<float> const& gradient, OnConvergence on_convergence) const;
+	void evolveSnake(Snake& snake, Grid<float> const& gradient,
+		OnConvergence on_convergence, TaskStatus const* status) const;
 
 	QImage visualizeGradient(Grid<float> const& gradient) const;
 
 	QImage visualizeSnakes(std::vector<Snake> const& snakes, Grid<float> const* gradient = 0) const;
 	
+	DewarpingAnalysisContext const& m_rContext;
 	imageproc::GrayImage m_image;
 	Dpi m_dpi;
 	Vec2f m_unitDownVec;
@@ -18,6 +18,7 @@
 
 #include "TextLineTracer.h"
 #include "TextLineRefiner.h"
+#include "DewarpingAnalysisContext.h"
 #include "DetectVertContentBounds.h"
 #include "TowardsLineTracer.h"
 #include "GridLineTraverser.h"
@@ -48,6 +49,7 @@
 #include "imageproc/SeedFill.h"
 #include "imageproc/LocalMinMaxGeneric.h"
 #include "imageproc/SEDM.h"
+#include "imageproc/ParallelFor.h"
 #include <QTransform>
 #include <QImage>
 #include <QRect>
@@ -122,9 +124,14 @@ TextLineTracer::trace(
 	if (dbg) {
 		dbg->add(visualizeVerticalBounds(binarized.toQImage(), vert_bounds), "vert_bounds");
 	}
-	
+
+	// Both the tracer and the refiner read the directional derivative
+	// fields of the downscaled page, so they are built once here and
+	// shared through the context.
+	DewarpingAnalysisContext const context(downscaled, downscaled_dpi, vert_bounds);
+
 	std::list<std::vector<QPointF> > polylines;
-	extractTextLines(polylines, stretchGrayRange(downscaled), vert_bounds, dbg);
+	extractTextLines(polylines, context, dbg);
 	if (dbg) {
 		dbg->add(visualizePolylines(downscaled, polylines), "traced");
 	}
@@ -135,13 +142,8 @@ TextLineTracer::trace(
 		dbg->add(visualizePolylines(downscaled, polylines), "filtered1");
 	}
 
-	Vec2f unit_down_vector(calcAvgUnitVector(vert_bounds));
-	unit_down_vector /= sqrt(unit_down_vector.squaredNorm());
-	if (unit_down_vector[1] < 0) {
-		unit_down_vector = -unit_down_vector;
-	}
-	TextLineRefiner refiner(downscaled, Dpi(200, 200), unit_down_vector);
-	refiner.refine(polylines, /*iterations=*/100, dbg);
+	TextLineRefiner refiner(context);
+	refiner.refine(polylines, /*iterations=*/100, dbg, &status);
 
 	filterEdgyCurves(polylines);
 	if (dbg) {
@@ -332,58 +334,97 @@ TextLineTracer::filterEdgyCurves(std::list<std::vector<QPointF> >& polylines)
 	}
 }
 
+namespace
+{
+
+/**
+ * Traces a range of candidate text lines, each from its own seed
+ * towards both vertical bounds.  Only reads the shared distance map
+ * and gradient grid, writing into a per-seed polyline slot.
+ */
+class TraceFromSeeds
+{
+public:
+	TraceFromSeeds(
+		SEDM const& sedm, Grid<float> const& grid,
+		std::pair<QLineF, QLineF> const& bounds,
+		std::vector<QPoint> const& seeds,
+		std::vector<std::vector<QPointF> >& polylines)
+	:	m_rSedm(sedm), m_rGrid(grid), m_rBounds(bounds),
+		m_rSeeds(seeds), m_rPolylines(polylines) {}
+
+	void operator()(int const begin, int const end) const {
+		for (int i = begin; i < end; ++i) {
+			QPoint const seed(m_rSeeds[i]);
+			std::vector<QPointF>& polyline = m_rPolylines[i];
+
+			{
+				TowardsLineTracer tracer(&m_rSedm, &m_rGrid, m_rBounds.first, seed);
+				while (QPoint const* pt = tracer.trace(10.0f)) {
+					polyline.push_back(*pt);
+				}
+				std::reverse(polyline.begin(), polyline.end());
+			}
+
+			polyline.push_back(seed);
+
+			{
+				TowardsLineTracer tracer(&m_rSedm, &m_rGrid, m_rBounds.second, seed);
+				while (QPoint const* pt = tracer.trace(10.0f)) {
+					polyline.push_back(*pt);
+				}
+			}
+		}
+	}
+private:
+	SEDM const& m_rSedm;
+	Grid<float> const& m_rGrid;
+	std::pair<QLineF, QLineF> const& m_rBounds;
+	std::vector<QPoint> const& m_rSeeds;
+	std::vector<std::vector<QPointF> >& m_rPolylines;
+};
+
+} // anonymous namespace
+
 void
 TextLineTracer::extractTextLines(
-	std::list<std::vector<QPointF> >& out, imageproc::GrayImage const& image,
-	std::pair<QLineF, QLineF> const& bounds, DebugImages* dbg)
+	std::list<std::vector<QPointF> >& out,
+	DewarpingAnalysisContext const& context, DebugImages* dbg)
 {
 	using namespace boost::lambda;
 
+	GrayImage const& image = context.image();
+	std::pair<QLineF, QLineF> const& bounds = context.verticalBounds();
 	int const width = image.width();
 	int const height = image.height();
 	QSize const size(image.size());
-	Vec2f const direction(calcAvgUnitVector(bounds));
+	Vec2f const direction(context.unitDownVec());
 	Grid<float> main_grid(image.width(), image.height(), 0);
 	Grid<float> aux_grid(image.width(), image.height(), 0);
 
-	float const downscale = 1.0f / (255.0f * 8.0f);
-	horizontalSobel<float>(
-		width, height, image.data(), image.stride(), _1 * downscale,
-		aux_grid.data(), aux_grid.stride(), _1 = _2, _1,
-		main_grid.data(), main_grid.stride(), _1 = _2
-	);
-	verticalSobel<float>(
-		width, height, image.data(), image.stride(), _1 * downscale,
-		aux_grid.data(), aux_grid.stride(), _1 = _2, _1,
-		main_grid.data(), main_grid.stride(), _1 = _1 * direction[0] + _2 * direction[1]
-	);
+	// The raw derivative comes from the shared analysis context.
+	// Everything below only cares about relative values, so unlike
+	// its predecessor it's computed without a contrast prestretch,
+	// which merely scaled the whole field by a constant.
+	Grid<float> const& first_deriv(context.directionalDerivative());
 	if (dbg) {
-		dbg->add(visualizeGradient(image, main_grid), "first_dir_deriv");
+		dbg->add(visualizeGradient(image, first_deriv), "first_dir_deriv");
 	}
 
 	gaussBlurGeneric(
 		size, 6.0f, 6.0f,
-		main_grid.data(), main_grid.stride(), _1,
+		first_deriv.data(), first_deriv.stride(), _1,
 		main_grid.data(), main_grid.stride(), _1 = _2
 	);
 	if (dbg) {
 		dbg->add(visualizeGradient(image, main_grid), "first_dir_deriv_blurred");
 	}
 
-	horizontalSobel<float>(
+	directionalSobel<float>(
 		width, height, main_grid.data(), main_grid.stride(), _1,
-		aux_grid.data(), aux_grid.stride(), _1 = _2, _1,
-		aux_grid.data(), aux_grid.stride(), _1 = _2
-	);
-	verticalSobel<float>(
-		width, height, main_grid.data(), main_grid.stride(), _1,
-		main_grid.data(), main_grid.stride(), _1 = _2, _1,
-		main_grid.data(), main_grid.stride(), _1 = _2
-	);
-	rasterOpGeneric(
-		aux_grid.data(), aux_grid.stride(), size,
-		main_grid.data(), main_grid.stride(), _2 = _1 * direction[0] + _2 * direction[1]
+		aux_grid.data(), aux_grid.stride(), direction[0], direction[1]
 	);
+	main_grid.swap(aux_grid);
 	if (dbg) {
 		dbg->add(visualizeGradient(image, main_grid), "second_dir_deriv");
 	}
@@ -475,46 +516,20 @@ TextLineTracer::extractTextLines(
 
 	post_binarization.release(); // Save memory.
 
-	BOOST_FOREACH(QPoint const seed, seeds) {
-		std::vector<QPointF> polyline;
-		
-		{
-			TowardsLineTracer tracer(&sedm, &main_grid, bounds.first, seed);
-			while (QPoint const* pt = tracer.trace(10.0f)) {
-				polyline.push_back(*pt);
-			}
-			std::reverse(polyline.begin(), polyline.end());
-		}
-
-		polyline.push_back(seed);
-
-		{
-			TowardsLineTracer tracer(&sedm, &main_grid, bounds.second, seed);
-			while (QPoint const* pt = tracer.trace(10.0f)) {
-				polyline.push_back(*pt);
-			}
-		}
+	// Individual traces only read from the distance map and the
+	// gradient grid, so they can run concurrently.
+	std::vector<std::vector<QPointF> > polylines(seeds.size());
+	parallelForRanges(
+		0, (int)seeds.size(),
+		TraceFromSeeds(sedm, main_grid, bounds, seeds, polylines)
+	);
 
+	BOOST_FOREACH(std::vector<QPointF>& polyline, polylines) {
 		out.push_back(std::vector<QPointF>());
 		out.back().swap(polyline);
 	}
 }
 
-Vec2f
-TextLineTracer::calcAvgUnitVector(std::pair<QLineF, QLineF> const& bounds)
-{
-	Vec2f v1(bounds.first.p2() - bounds.first.p1());
-	v1 /= sqrt(v1.squaredNorm());
-
-	Vec2f v2(bounds.second.p2() - bounds.second.p1());
-	v2 /= sqrt(v2.squaredNorm());
-
-	Vec2f v3(v1 + v2);
-	v3 /= sqrt(v3.squaredNorm());
-	
-	return v3;
-}
-
 BinaryImage
 TextLineTracer::closeWithObstacles(
 	BinaryImage const& image, BinaryImage const& obstacles, QSize const& brick)
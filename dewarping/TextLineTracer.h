@@ -46,6 +46,7 @@ namespace imageproc
 namespace dewarping
 {
 
+class DewarpingAnalysisContext;
 class DistortionModelBuilder;
 
 class TextLineTracer
@@ -61,10 +62,8 @@ private:
 	static void sanitizeBinaryImage(imageproc::BinaryImage& image, QRect const& content_rect);
 
 	static void extractTextLines(
-		std::list<std::vector<QPointF> >& out, imageproc::GrayImage const& image,
-		std::pair<QLineF, QLineF> const& bounds, DebugImages* dbg);
-
-	static Vec2f calcAvgUnitVector(std::pair<QLineF, QLineF> const& bounds);
+		std::list<std::vector<QPointF> >& out,
+		DewarpingAnalysisContext const& context, DebugImages* dbg);
 
 	static imageproc::BinaryImage closeWithObstacles(
 		imageproc::BinaryImage const& image,
@@ -250,7 +250,7 @@ TopBottomEdgeTracer::trace(
 	// Shortest paths from bounds.first towards bounds.second.
 	prepareForShortestPathsFrom(queue, grid, bounds.first);
 	Vec2f const dir_1st_to_2nd(directionFromPointToLine(bounds.first.pointAt(0.5), bounds.second));
-	propagateShortestPaths(dir_1st_to_2nd, queue, grid);
+	propagateShortestPaths(dir_1st_to_2nd, queue, grid, bounds.second);
 	std::vector<QPoint> const endpoints1(locateBestPathEndpoints(grid, bounds.second));
 	if (dbg) {
 		dbg->add(visualizePaths(downscaled, grid, bounds, endpoints1), "best_paths_ltr");
@@ -516,21 +516,54 @@ TopBottomEdgeTracer::prepareForShortestPathsFrom(
 
 void
 TopBottomEdgeTracer::propagateShortestPaths(
-	Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid)
+	Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid, QLineF const& target_line)
 {
 	GridNode* const data = grid.data();
-	
+
 	int next_nbh_offsets[8];
 	int prev_nbh_indexes[8];
 	int const num_neighbours = initNeighbours(next_nbh_offsets, prev_nbh_indexes, grid.stride(), direction);
 
+	// Collect the grid offsets of target_line, so that we can stop
+	// as soon as the last of them gets settled.
+	std::vector<uint32_t> target_offsets;
+	GridLineTraverser traverser(target_line);
+	while (traverser.hasNext()) {
+		QPoint const pt(traverser.next());
+
+		// intersectWithRect() ensures that.
+		assert(pt.x() >= 0 && pt.y() >= 0 && pt.x() < grid.width() && pt.y() < grid.height());
+
+		target_offsets.push_back(pt.y() * grid.stride() + pt.x());
+	}
+	std::sort(target_offsets.begin(), target_offsets.end());
+	target_offsets.erase(
+		std::unique(target_offsets.begin(), target_offsets.end()), target_offsets.end()
+	);
+	size_t unsettled_target_nodes = target_offsets.size();
+
+	// Endpoints with costs of 0.95 or above get discarded by
+	// locateBestPathEndpoints() anyway, and costs along a path
+	// never decrease, so the frontier reaching that cost means
+	// no usable endpoint will ever be settled.
+	float const max_usable_cost = 0.95f;
+
 	while (!queue.empty()) {
 		int const grid_idx = queue.front();
 		GridNode* node = data + grid_idx;
 		assert(node->pathCost >= 0);
+		if (node->pathCost >= max_usable_cost) {
+			break;
+		}
 		queue.pop();
 		node->setHeapIdx(GridNode::INVALID_HEAP_IDX);
 
+		if (std::binary_search(target_offsets.begin(), target_offsets.end(), uint32_t(grid_idx))) {
+			if (--unsettled_target_nodes == 0) {
+				break;
+			}
+		}
+
 		for (int i = 0; i < num_neighbours; ++i) {
 			int const nbh_grid_idx = grid_idx + next_nbh_offsets[i];
 			GridNode* nbh_node = data + nbh_grid_idx;
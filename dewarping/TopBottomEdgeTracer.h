@@ -71,7 +71,8 @@ private:
 
 	static void prepareForShortestPathsFrom(PrioQueue& queue, Grid<GridNode>& grid, QLineF const& from); 
 
-	static void propagateShortestPaths(Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid);
+	static void propagateShortestPaths(
+		Vec2f const& direction, PrioQueue& queue, Grid<GridNode>& grid, QLineF const& target_line);
 
 	static int initNeighbours(int* next_nbh_offsets, int* prev_nbh_indexes, int stride, Vec2f const& direction);
 
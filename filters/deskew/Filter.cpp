@@ -42,11 +42,21 @@ namespace deskew
 {
 
 Filter::Filter(PageSelectionAccessor const& page_selection_accessor)
-:	m_ptrSettings(new Settings)
+:	m_pageSelectionAccessor(page_selection_accessor),
+	m_ptrSettings(new Settings)
 {
-	if (CommandLine::get().isGui()) {
-		m_ptrOptionsWidget.reset(new OptionsWidget(m_ptrSettings, page_selection_accessor));
+}
+
+OptionsWidget*
+Filter::optionsWidget()
+{
+	// Built lazily, on first stage activation.
+	if (!m_ptrOptionsWidget.get() && CommandLine::get().isGui()) {
+		m_ptrOptionsWidget.reset(
+			new OptionsWidget(m_ptrSettings, m_pageSelectionAccessor)
+		);
 	}
+	return m_ptrOptionsWidget.get();
 }
 
 Filter::~Filter()
@@ -74,8 +84,9 @@ Filter::performRelinking(AbstractRelinker const& relinker)
 void
 Filter::preUpdateUI(FilterUiInterface* const ui, PageId const& page_id)
 {
-	m_ptrOptionsWidget->preUpdateUI(page_id);
-	ui->setOptionsWidget(m_ptrOptionsWidget.get(), ui->KEEP_OWNERSHIP);
+	OptionsWidget* const opt_widget = optionsWidget();
+	opt_widget->preUpdateUI(page_id);
+	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 }
 
 QDomElement
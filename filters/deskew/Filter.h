@@ -25,6 +25,7 @@
 #include "IntrusivePtr.h"
 #include "FilterResult.h"
 #include "SafeDeletingQObjectPtr.h"
+#include "PageSelectionAccessor.h"
 
 class PageId;
 class QString;
@@ -74,13 +75,18 @@ public:
 	IntrusivePtr<CacheDrivenTask> createCacheDrivenTask(
 		IntrusivePtr<select_content::CacheDrivenTask> const& next_task);
 	
-	OptionsWidget* optionsWidget() { return m_ptrOptionsWidget.get(); }
+	/**
+	 * In GUI mode, creates the widget on first call.
+	 * Returns null in CLI mode.
+	 */
+	OptionsWidget* optionsWidget();
 	Settings* getSettings() { return m_ptrSettings.get(); };
 private:
 	void writePageSettings(
 		QDomDocument& doc, QDomElement& filter_el,
 		PageId const& page_id, int numeric_id) const;
 	
+	PageSelectionAccessor m_pageSelectionAccessor;
 	IntrusivePtr<Settings> m_ptrSettings;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 };
@@ -92,9 +92,7 @@ OptionsWidget::appliedTo(std::set<PageId> const& pages)
 		m_uiData.dependencies(), m_uiData.mode()
 	);
 	m_ptrSettings->setDegress(pages, params);
-	BOOST_FOREACH(PageId const& page_id, pages) {
-		emit invalidateThumbnail(page_id);
-	}
+	emit invalidateThumbnails(pages);
 }
 
 void
@@ -17,6 +17,7 @@
 */
 
 #include "Settings.h"
+#include "ProjectDirtyTracker.h"
 #include "Utils.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
@@ -62,6 +63,7 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker locker(&m_mutex);
 	Utils::mapSetValue(m_perPageParams, page_id, params);
 }
@@ -89,6 +91,7 @@ Settings::getPageParams(PageId const& page_id) const
 void
 Settings::setDegress(std::set<PageId> const& pages, Params const& params)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
 	BOOST_FOREACH(PageId const& page, pages) {
 		Utils::mapSetValue(m_perPageParams, page, params);
@@ -54,12 +54,27 @@
 #include <stddef.h>
 
 #include "CommandLine.h"
+#include "AnalysisCache.h"
+#include "AlgorithmVersions.h"
+#include <QDomDocument>
 
 namespace deskew
 {
 
 using namespace imageproc;
 
+namespace
+{
+
+QString depsFingerprint(Dependencies const& deps)
+{
+	QDomDocument doc;
+	doc.appendChild(deps.toXml(doc, "dependencies"));
+	return doc.toString();
+}
+
+} // anonymous namespace
+
 class Task::UiUpdater : public FilterResult
 {
 public:
@@ -145,48 +160,88 @@ Task::process(TaskStatus const& status, FilterData const& data)
 		status.throwIfCancelled();
 		
 		if (bounded_image_area.isValid()) {
-			BinaryImage rotated_image(
-				orthogonalRotation(
-					BinaryImage(
-						data.grayImage(), bounded_image_area,
-						data.bwThreshold()
-					),
-					data.xform().preRotation().toDegrees()
-				)
-			);
-			if (m_ptrDbg.get()) {
-				m_ptrDbg->add(rotated_image, "bw_rotated");
-			}
-			
-			QSize const unrotated_dpm(Dpm(data.origImage()).toSize());
-			Dpm const rotated_dpm(
-				data.xform().preRotation().rotate(unrotated_dpm)
-			);
-			cleanup(status, rotated_image, Dpi(rotated_dpm));
-			if (m_ptrDbg.get()) {
-				m_ptrDbg->add(rotated_image, "after_cleanup");
-			}
-			
-			status.throwIfCancelled();
-			
-			SkewFinder skew_finder;
-			skew_finder.setResolutionRatio(
-				(double)rotated_dpm.horizontal() / rotated_dpm.vertical()
-			);
-			Skew const skew(skew_finder.findSkew(rotated_image));
-			
-			if (skew.confidence() >= skew.GOOD_CONFIDENCE) {
-				ui_data.setEffectiveDeskewAngle(-skew.angle());
+			AnalysisCache& analysis_cache = AnalysisCache::instance();
+			QString const analysis_context(depsFingerprint(deps));
+
+			QDomDocument cached_doc;
+			QDomElement cached_el;
+			if (analysis_cache.lookup(
+					m_pageId.imageId(), QLatin1String("deskew"),
+					algo_versions::SKEW_DETECTION, analysis_context,
+					cached_doc, cached_el)) {
+				// Same scan, same inputs, same algorithm - the
+				// previously detected angle is still valid.
+				ui_data.setEffectiveDeskewAngle(
+					cached_el.attribute("angle").toDouble()
+				);
 			} else {
-				ui_data.setEffectiveDeskewAngle(0);
+				// In the common case of no pre-crop the area covers
+				// the whole image, and the binarization can be
+				// shared with the other stages.
+				bool const full_area = (
+					bounded_image_area == data.origImage().rect()
+				);
+				int const rotation_deg =
+					data.xform().preRotation().toDegrees();
+
+				BinaryImage rotated_image(
+					orthogonalRotation(
+						full_area ? data.fullSizeBinary()
+						: BinaryImage(
+							data.grayImage(), bounded_image_area,
+							data.bwThreshold()
+						),
+						rotation_deg
+					)
+				);
+				if (m_ptrDbg.get()) {
+					m_ptrDbg->add(rotated_image, "bw_rotated");
+				}
+
+				QSize const unrotated_dpm(Dpm(data.origImage()).toSize());
+				Dpm const rotated_dpm(
+					data.xform().preRotation().rotate(unrotated_dpm)
+				);
+				cleanup(
+					status, rotated_image, Dpi(rotated_dpm),
+					full_area && rotation_deg == 0 ? &data : 0
+				);
+				if (m_ptrDbg.get()) {
+					m_ptrDbg->add(rotated_image, "after_cleanup");
+				}
+
+				status.throwIfCancelled();
+
+				SkewFinder skew_finder;
+				skew_finder.setResolutionRatio(
+					(double)rotated_dpm.horizontal() / rotated_dpm.vertical()
+				);
+				Skew const skew(skew_finder.findSkew(rotated_image));
+
+				if (skew.confidence() >= skew.GOOD_CONFIDENCE) {
+					ui_data.setEffectiveDeskewAngle(-skew.angle());
+				} else {
+					ui_data.setEffectiveDeskewAngle(0);
+				}
+
+				QDomDocument doc;
+				QDomElement el(doc.createElement("skew"));
+				el.setAttribute(
+					"angle",
+					QString::number(ui_data.effectiveDeskewAngle(), 'g', 16)
+				);
+				analysis_cache.store(
+					m_pageId.imageId(), QLatin1String("deskew"),
+					algo_versions::SKEW_DETECTION, analysis_context, el
+				);
 			}
 			ui_data.setMode(MODE_AUTO);
-			
+
 			Params const new_params(
 				ui_data.effectiveDeskewAngle(), deps, ui_data.mode()
 			);
 			m_ptrSettings->setPageParams(m_pageId, new_params);
-			
+
 			status.throwIfCancelled();
 		}
 	}
@@ -207,7 +262,9 @@ Task::process(TaskStatus const& status, FilterData const& data)
 }
 
 void
-Task::cleanup(TaskStatus const& status, BinaryImage& image, Dpi const& dpi)
+Task::cleanup(
+	TaskStatus const& status, BinaryImage& image, Dpi const& dpi,
+	FilterData const* const shared_data)
 {
 	// We don't have to clean up every piece of garbage.
 	// The only concern are the horizontal shadows, which we remove here.
@@ -216,15 +273,24 @@ Task::cleanup(TaskStatus const& status, BinaryImage& image, Dpi const& dpi)
 	BinaryImage reduced_image;
 	
 	{
-		ReduceThreshold reductor(image);
+		int levels = 0;
 		while (reduced_dpi.horizontal() >= 200 && reduced_dpi.vertical() >= 200) {
-			reductor.reduce(2);
+			++levels;
 			reduced_dpi = Dpi(
 				reduced_dpi.horizontal() / 2,
 				reduced_dpi.vertical() / 2
 			);
 		}
-		reduced_image = reductor.image();
+		if (shared_data) {
+			// \p image is the shared full-size binarization,
+			// so the reductions can be shared as well.
+			reduced_image = shared_data->reducedBinary(levels);
+		} else if (levels == 0) {
+			reduced_image = image;
+		} else {
+			std::vector<int> const thresholds(levels, 2);
+			reduced_image = reducePyramid(image, thresholds).back();
+		}
 	}
 	
 	status.throwIfCancelled();
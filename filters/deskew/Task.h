@@ -66,7 +66,8 @@ private:
 		
 	static void cleanup(
 		TaskStatus const& status,
-		imageproc::BinaryImage& img, Dpi const& dpi);
+		imageproc::BinaryImage& img, Dpi const& dpi,
+		FilterData const* shared_data);
 	
 	static int from150dpi(int size, int target_dpi);
 	
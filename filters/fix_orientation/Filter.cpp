@@ -47,13 +47,23 @@ namespace fix_orientation
 
 Filter::Filter(
 	PageSelectionAccessor const& page_selection_accessor)
-:	m_ptrSettings(new Settings)
+:	m_pageSelectionAccessor(page_selection_accessor),
+	m_ptrSettings(new Settings)
 {
-	if (CommandLine::get().isGui()) {
+}
+
+OptionsWidget*
+Filter::optionsWidget()
+{
+	// Created on first stage activation rather than in the
+	// constructor.  Setting up six option panels was a noticeable
+	// chunk of the time to get a project on screen.
+	if (!m_ptrOptionsWidget.get() && CommandLine::get().isGui()) {
 		m_ptrOptionsWidget.reset(
-			new OptionsWidget(m_ptrSettings, page_selection_accessor)
+			new OptionsWidget(m_ptrSettings, m_pageSelectionAccessor)
 		);
 	}
+	return m_ptrOptionsWidget.get();
 }
 
 Filter::~Filter()
@@ -83,12 +93,12 @@ Filter::performRelinking(AbstractRelinker const& relinker)
 void
 Filter::preUpdateUI(FilterUiInterface* ui, PageId const& page_id)
 {
-	if (m_ptrOptionsWidget.get()) {
+	if (OptionsWidget* const opt_widget = optionsWidget()) {
 		OrthogonalRotation const rotation(
 			m_ptrSettings->getRotationFor(page_id.imageId())
 		);
-		m_ptrOptionsWidget->preUpdateUI(page_id, rotation);
-		ui->setOptionsWidget(m_ptrOptionsWidget.get(), ui->KEEP_OWNERSHIP);
+		opt_widget->preUpdateUI(page_id, rotation);
+		ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 	}
 }
 
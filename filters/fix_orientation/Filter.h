@@ -25,6 +25,7 @@
 #include "FilterResult.h"
 #include "IntrusivePtr.h"
 #include "SafeDeletingQObjectPtr.h"
+#include "PageSelectionAccessor.h"
 
 class PageId;
 class ImageId;
@@ -81,7 +82,11 @@ public:
 	IntrusivePtr<CacheDrivenTask> createCacheDrivenTask(
 		IntrusivePtr<page_split::CacheDrivenTask> const& next_task);
 	
-	OptionsWidget* optionsWidget() { return m_ptrOptionsWidget.get(); };
+	/**
+	 * In GUI mode, creates the widget on first call.
+	 * Returns null in CLI mode.
+	 */
+	OptionsWidget* optionsWidget();
 
 	Settings* getSettings() { return m_ptrSettings.get(); };
 private:
@@ -89,6 +94,7 @@ private:
 		QDomDocument& doc, QDomElement& filter_el,
 		ImageId const& image_id, int numeric_id) const;
 	
+	PageSelectionAccessor m_pageSelectionAccessor;
 	IntrusivePtr<Settings> m_ptrSettings;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 };
@@ -114,9 +114,7 @@ OptionsWidget::appliedTo(std::set<PageId> const& pages)
 	}
 	
 	m_ptrSettings->applyRotation(pages, m_rotation);
-	BOOST_FOREACH(PageId const& page_id, pages) {
-		emit invalidateThumbnail(page_id);
-	}
+	emit invalidateThumbnails(pages);
 }
 
 void
@@ -17,6 +17,7 @@
 */
 
 #include "Settings.h"
+#include "ProjectDirtyTracker.h"
 #include "Utils.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
@@ -62,6 +63,7 @@ void
 Settings::applyRotation(
 	ImageId const& image_id, OrthogonalRotation const rotation)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker locker(&m_mutex);
 	setImageRotationLocked(image_id, rotation);
 }
@@ -70,6 +72,7 @@ void
 Settings::applyRotation(
 	std::set<PageId> const& pages, OrthogonalRotation const rotation)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker locker(&m_mutex);
 	
 	BOOST_FOREACH(PageId const& page, pages) {
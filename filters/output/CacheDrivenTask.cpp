@@ -61,7 +61,10 @@ CacheDrivenTask::process(
 	if (ThumbnailCollector* thumb_col = dynamic_cast<ThumbnailCollector*>(collector)) {
 		
 		QString const out_file_path(m_outFileNameGen.filePathFor(page_info.id()));
-		Params const params(m_ptrSettings->getParams(page_info.id()));
+
+		Settings::PageSnapshot snapshot;
+		m_ptrSettings->snapshotPage(page_info.id(), snapshot);
+		Params const& params = snapshot.params;
 
 		ImageTransformation new_xform(xform);
 		new_xform.postScaleToDpi(params.outputDpi());
@@ -70,9 +73,7 @@ CacheDrivenTask::process(
 
 		do { // Just to be able to break from it.
 
-			std::auto_ptr<OutputParams> stored_output_params(
-				m_ptrSettings->getOutputParams(page_info.id())
-			);
+			std::auto_ptr<OutputParams> stored_output_params(snapshot.outputParams);
 
 			if (!stored_output_params.get()) {
 				need_reprocess = true;
@@ -95,13 +96,13 @@ CacheDrivenTask::process(
 				break;
 			}
 
-			ZoneSet const new_picture_zones(m_ptrSettings->pictureZonesForPage(page_info.id()));
+			ZoneSet const new_picture_zones(snapshot.pictureZones);
 			if (!PictureZoneComparator::equal(stored_output_params->pictureZones(), new_picture_zones)) {
 				need_reprocess = true;
 				break;
 			}
 
-			ZoneSet const new_fill_zones(m_ptrSettings->fillZonesForPage(page_info.id()));
+			ZoneSet const new_fill_zones(snapshot.fillZones);
 			if (!FillZoneComparator::equal(stored_output_params->fillZones(), new_fill_zones)) {
 				need_reprocess = true;
 				break;
@@ -35,17 +35,19 @@ DespeckleState::DespeckleState(
 	imageproc::BinaryImage const& speckles,
 	DespeckleLevel level, Dpi const& dpi)
 :	m_speckles(speckles),
+	m_ptrAnalysis(Despeckle::createAnalysis()),
 	m_dpi(dpi),
 	m_despeckleLevel(level)
 {
-	m_everythingMixed = overlaySpeckles(output, speckles);
-	m_everythingBW = extractBW(m_everythingMixed);
+	QImage const mixed(overlaySpeckles(output, speckles));
+	m_everythingMixed = SpillableImage(mixed);
+	m_everythingBW = extractBW(mixed);
 }
 
 DespeckleVisualization
 DespeckleState::visualize() const
 {
-	return DespeckleVisualization(m_everythingMixed, m_speckles, m_dpi);
+	return DespeckleVisualization(m_everythingMixed.toQImage(), m_speckles, m_dpi);
 }
 
 DespeckleState
@@ -78,8 +80,11 @@ DespeckleState::redespeckle(
 			break;
 	}
 
+	// The analysis is shared with *this, so the first redespeckle()
+	// fills it and subsequent level changes only redo the scoring.
 	new_state.m_speckles = Despeckle::despeckle(
-		m_everythingBW, m_dpi, level2, status, dbg
+		m_everythingBW, m_dpi, level2, status, dbg,
+		new_state.m_ptrAnalysis.get()
 	);
 
 	status.throwIfCancelled();
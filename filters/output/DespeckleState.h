@@ -21,7 +21,10 @@
 #define OUTPUT_DESPECKLE_STATE_H_
 
 #include "DespeckleLevel.h"
+#include "Despeckle.h"
 #include "Dpi.h"
+#include "SpillableImage.h"
+#include "IntrusivePtr.h"
 #include "imageproc/BinaryImage.h"
 #include <QImage>
 
@@ -61,9 +64,11 @@ private:
 	 * This image is the output image produced by OutputGenerator
 	 * with speckles added as black regions.  This image is always in RGB32,
 	 * because it only exists for display purposes, namely for being fed to
-	 * DespeckleVisualization.
+	 * DespeckleVisualization.  Because it's only looked at when the
+	 * despeckle view is opened, it's allowed to spill to disk under
+	 * memory pressure.
 	 */
-	QImage m_everythingMixed;
+	SpillableImage m_everythingMixed;
 
 	/**
 	 * The B/W part of m_everythingMixed.
@@ -76,6 +81,13 @@ private:
 	 */
 	imageproc::BinaryImage m_speckles;
 
+	/**
+	 * Level-independent despeckling intermediates for m_everythingBW,
+	 * filled by the first redespeckle() and shared by copies of this
+	 * object, so that level changes only redo the cheap scoring part.
+	 */
+	IntrusivePtr<Despeckle::Analysis> m_ptrAnalysis;
+
 	/**
 	 * The DPI of all 3 above images.
 	 */
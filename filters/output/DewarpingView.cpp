@@ -19,6 +19,9 @@
 #include "DewarpingView.h"
 #include "DewarpingView.h.moc"
 #include "ImagePresentation.h"
+#include "AbstractCommand.h"
+#include "BackgroundExecutor.h"
+#include "RefCountable.h"
 #include "dewarping/Curve.h"
 #include "VecNT.h"
 #include "MatrixCalc.h"
@@ -42,6 +45,8 @@
 #include <QPen>
 #include <QColor>
 #include <Qt>
+#include <QPointer>
+#include <QAtomicInt>
 #include <QDebug>
 #ifndef Q_MOC_RUN
 #include <boost/array.hpp>
@@ -56,6 +61,59 @@ namespace output
 
 using namespace imageproc;
 
+class DewarpingView::TaskCancelHandle : public RefCountable
+{
+public:
+	void cancel();
+
+	bool isCancelled() const;
+private:
+	mutable QAtomicInt m_cancelFlag;
+};
+
+
+/**
+ * Builds a CylindricalSurfaceDewarper from the latest directrix
+ * geometry on a background thread, so that dragging a spline doesn't
+ * stall the GUI thread on refits.
+ */
+class DewarpingView::DewarperBuildTask :
+	public AbstractCommand0<BackgroundExecutor::TaskResultPtr>
+{
+public:
+	DewarperBuildTask(
+		DewarpingView* owner, IntrusivePtr<TaskCancelHandle> const& cancel_handle,
+		std::vector<QPointF> const& top_polyline,
+		std::vector<QPointF> const& bottom_polyline,
+		double depth_perception);
+
+	virtual BackgroundExecutor::TaskResultPtr operator()();
+private:
+	QPointer<DewarpingView> m_ptrOwner;
+	IntrusivePtr<TaskCancelHandle> m_ptrCancelHandle;
+	std::vector<QPointF> m_topPolyline;
+	std::vector<QPointF> m_bottomPolyline;
+	double m_depthPerception;
+};
+
+
+class DewarpingView::DewarperBuildResult : public AbstractCommand0<void>
+{
+public:
+	DewarperBuildResult(
+		QPointer<DewarpingView> const& owner,
+		IntrusivePtr<TaskCancelHandle> const& cancel_handle,
+		std::auto_ptr<dewarping::CylindricalSurfaceDewarper> dewarper);
+
+	// This method is called from the main thread.
+	virtual void operator()();
+private:
+	QPointer<DewarpingView> m_ptrOwner;
+	IntrusivePtr<TaskCancelHandle> m_ptrCancelHandle;
+	std::auto_ptr<dewarping::CylindricalSurfaceDewarper> m_ptrDewarper;
+};
+
+
 DewarpingView::DewarpingView(
 	QImage const& image, ImagePixmapUnion const& downscaled_image,
 	QTransform const& image_to_virt, QPolygonF const& virt_display_area,
@@ -134,6 +192,7 @@ DewarpingView::DewarpingView(
 
 DewarpingView::~DewarpingView()
 {
+	cancelDewarperRebuild();
 }
 
 void
@@ -192,6 +251,11 @@ void
 DewarpingView::depthPerceptionChanged(double val)
 {
 	m_depthPerception.setValue(val);
+	if (m_ptrDewarper.get()) {
+		// Cheap re-parameterization of the cached dewarper - the
+		// directrix geometry doesn't depend on depth perception.
+		m_ptrDewarper->setDepthPerception(m_depthPerception.value());
+	}
 	update();
 }
 
@@ -225,15 +289,20 @@ DewarpingView::onPaint(QPainter& painter, InteractionState const& interaction)
 		try {
 			std::vector<QVector<QPointF> > curves(num_hor_grid_lines);
 
-			dewarping::CylindricalSurfaceDewarper dewarper(
-				m_distortionModel.topCurve().polyline(),
-				m_distortionModel.bottomCurve().polyline(), m_depthPerception.value()
-			);
+			if (!m_ptrDewarper.get()) {
+				m_ptrDewarper.reset(
+					new dewarping::CylindricalSurfaceDewarper(
+						m_distortionModel.topCurve().polyline(),
+						m_distortionModel.bottomCurve().polyline(),
+						m_depthPerception.value()
+					)
+				);
+			}
 			dewarping::CylindricalSurfaceDewarper::State state;
 
 			for (int j = 0; j < num_vert_grid_lines; ++j) {
 				double const x = j / (num_vert_grid_lines - 1.0);
-				dewarping::CylindricalSurfaceDewarper::Generatrix const gtx(dewarper.mapGeneratrix(x, state));
+				dewarping::CylindricalSurfaceDewarper::Generatrix const gtx(m_ptrDewarper->mapGeneratrix(x, state));
 				QPointF const gtx_p0(gtx.imgLine.pointAt(gtx.pln2img(0)));
 				QPointF const gtx_p1(gtx.imgLine.pointAt(gtx.pln2img(1)));
 				painter.drawLine(gtx_p0, gtx_p1);
@@ -249,6 +318,7 @@ DewarpingView::onPaint(QPainter& painter, InteractionState const& interaction)
 		} catch (std::runtime_error const&) {
 			// Still probably a bad model, even though DistortionModel::isValid() was true.
 			valid_model = false;
+			m_ptrDewarper.reset();
 		}
 	} // valid_model
 
@@ -321,9 +391,58 @@ DewarpingView::curveModified(int curve_idx)
 	} else {
 		m_distortionModel.setBottomCurve(dewarping::Curve(m_bottomSpline.spline()));
 	}
+
+	// The directrix geometry has changed.  Rather than resetting the
+	// dewarper and rebuilding it in onPaint(), we keep painting the
+	// stale grid and replace it when a background rebuild delivers.
+	if (m_ptrDewarper.get() && m_distortionModel.isValid()) {
+		scheduleDewarperRebuild();
+	} else {
+		m_ptrDewarper.reset();
+	}
+
 	update();
 }
 
+void
+DewarpingView::scheduleDewarperRebuild()
+{
+	// Latest wins - whatever the previous task produces is discarded.
+	cancelDewarperRebuild();
+	m_ptrCancelHandle.reset(new TaskCancelHandle);
+
+	BackgroundExecutor::TaskPtr const task(
+		new DewarperBuildTask(
+			this, m_ptrCancelHandle,
+			m_distortionModel.topCurve().polyline(),
+			m_distortionModel.bottomCurve().polyline(),
+			m_depthPerception.value()
+		)
+	);
+	ImageViewBase::backgroundExecutor().enqueueTask(task);
+}
+
+void
+DewarpingView::dewarperBuilt(std::auto_ptr<dewarping::CylindricalSurfaceDewarper> dewarper)
+{
+	m_ptrCancelHandle.reset();
+
+	// The depth perception may have changed while the task was in flight.
+	dewarper->setDepthPerception(m_depthPerception.value());
+
+	m_ptrDewarper = dewarper;
+	update();
+}
+
+void
+DewarpingView::cancelDewarperRebuild()
+{
+	if (m_ptrCancelHandle) {
+		m_ptrCancelHandle->cancel();
+		m_ptrCancelHandle.reset();
+	}
+}
+
 void
 DewarpingView::dragFinished()
 {
@@ -408,4 +527,85 @@ DewarpingView::virtMarginArea(int margin_idx) const
 	return m_virtDisplayArea.intersected(poly);
 }
 
+
+/*========================= DewarperBuildTask ==========================*/
+
+DewarpingView::DewarperBuildTask::DewarperBuildTask(
+	DewarpingView* owner, IntrusivePtr<TaskCancelHandle> const& cancel_handle,
+	std::vector<QPointF> const& top_polyline,
+	std::vector<QPointF> const& bottom_polyline,
+	double const depth_perception)
+:	m_ptrOwner(owner),
+	m_ptrCancelHandle(cancel_handle),
+	m_topPolyline(top_polyline),
+	m_bottomPolyline(bottom_polyline),
+	m_depthPerception(depth_perception)
+{
+}
+
+BackgroundExecutor::TaskResultPtr
+DewarpingView::DewarperBuildTask::operator()()
+{
+	if (m_ptrCancelHandle->isCancelled()) {
+		return BackgroundExecutor::TaskResultPtr();
+	}
+
+	std::auto_ptr<dewarping::CylindricalSurfaceDewarper> dewarper;
+	try {
+		dewarper.reset(
+			new dewarping::CylindricalSurfaceDewarper(
+				m_topPolyline, m_bottomPolyline, m_depthPerception
+			)
+		);
+	} catch (std::runtime_error const&) {
+		// Probably a bad model.  The stale grid stays on screen,
+		// and the next modification will try again.
+		return BackgroundExecutor::TaskResultPtr();
+	}
+
+	return BackgroundExecutor::TaskResultPtr(
+		new DewarperBuildResult(m_ptrOwner, m_ptrCancelHandle, dewarper)
+	);
+}
+
+
+/*======================== DewarperBuildResult =========================*/
+
+DewarpingView::DewarperBuildResult::DewarperBuildResult(
+	QPointer<DewarpingView> const& owner,
+	IntrusivePtr<TaskCancelHandle> const& cancel_handle,
+	std::auto_ptr<dewarping::CylindricalSurfaceDewarper> dewarper)
+:	m_ptrOwner(owner),
+	m_ptrCancelHandle(cancel_handle),
+	m_ptrDewarper(dewarper)
+{
+}
+
+void
+DewarpingView::DewarperBuildResult::operator()()
+{
+	if (m_ptrCancelHandle->isCancelled()) {
+		return;
+	}
+
+	if (DewarpingView* owner = m_ptrOwner) {
+		owner->dewarperBuilt(m_ptrDewarper);
+	}
+}
+
+
+/*========================= TaskCancelHandle ===========================*/
+
+void
+DewarpingView::TaskCancelHandle::cancel()
+{
+	m_cancelFlag.fetchAndStoreRelaxed(1);
+}
+
+bool
+DewarpingView::TaskCancelHandle::isCancelled() const
+{
+	return m_cancelFlag.fetchAndAddRelaxed(0) != 0;
+}
+
 } // namespace output
@@ -30,11 +30,18 @@
 #include "DepthPerception.h"
 #include "Settings.h"
 #include "PageId.h"
+#include "IntrusivePtr.h"
 #include <QTransform>
 #include <QPointF>
 #include <QRectF>
 #include <QPolygonF>
 #include <vector>
+#include <memory>
+
+namespace dewarping
+{
+	class CylindricalSurfaceDewarper;
+}
 
 namespace output
 {
@@ -59,6 +66,10 @@ public slots:
 protected:
 	virtual void onPaint(QPainter& painter, InteractionState const& interaction);
 private:
+	class TaskCancelHandle;
+	class DewarperBuildTask;
+	class DewarperBuildResult;
+
 	static void initNewSpline(XSpline& spline, QPointF const& p1, QPointF const& p2);
 
 	static void fitSpline(XSpline& spline, std::vector<QPointF> const& polyline);
@@ -71,6 +82,12 @@ private:
 
 	void dragFinished();
 
+	void scheduleDewarperRebuild();
+
+	void dewarperBuilt(std::auto_ptr<dewarping::CylindricalSurfaceDewarper> dewarper);
+
+	void cancelDewarperRebuild();
+
 	QPointF sourceToWidget(QPointF const& pt) const;
 
 	QPointF widgetToSource(QPointF const& pt) const;
@@ -82,6 +99,21 @@ private:
 	DewarpingMode m_dewarpingMode;
 	dewarping::DistortionModel m_distortionModel;
 	DepthPerception m_depthPerception;
+
+	/**
+	 * Built lazily in onPaint() and rebuilt on a background thread
+	 * when a curve is modified, so that the stale grid keeps being
+	 * painted while the spline is dragged.  Depth perception changes
+	 * merely re-parameterize it, keeping the depth slider responsive.
+	 */
+	std::auto_ptr<dewarping::CylindricalSurfaceDewarper> m_ptrDewarper;
+
+	/**
+	 * The cancel handle of the latest scheduled rebuild.  Scheduling
+	 * a rebuild cancels the previous one, so that a rapid sequence of
+	 * modifications only results in the latest geometry being built.
+	 */
+	IntrusivePtr<TaskCancelHandle> m_ptrCancelHandle;
 	InteractiveXSpline m_topSpline;
 	InteractiveXSpline m_bottomSpline;
 	DragHandler m_dragHandler;
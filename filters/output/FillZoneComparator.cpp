@@ -23,6 +23,8 @@
 #include "FillColorProperty.h"
 #include "imageproc/PolygonUtils.h"
 #include <QPolygonF>
+#include <vector>
+#include <stddef.h>
 
 using namespace imageproc;
 
@@ -62,4 +64,32 @@ FillZoneComparator::equal(PropertySet const& lhs, PropertySet const& rhs)
 	return lhs.locateOrDefault<FCP>()->color() == rhs.locateOrDefault<FCP>()->color();
 }
 
+bool
+FillZoneComparator::addedZones(
+	ZoneSet const& before, ZoneSet const& after, ZoneSet& added)
+{
+	// Zone counts are small, so the quadratic matching below is fine.
+	std::vector<Zone const*> unmatched;
+	for (ZoneSet::const_iterator it(before.begin()); it != before.end(); ++it) {
+		unmatched.push_back(&*it);
+	}
+
+	for (ZoneSet::const_iterator it(after.begin()); it != after.end(); ++it) {
+		bool matched = false;
+		for (size_t i = 0; i < unmatched.size(); ++i) {
+			if (equal(*unmatched[i], *it)) {
+				unmatched[i] = unmatched.back();
+				unmatched.pop_back();
+				matched = true;
+				break;
+			}
+		}
+		if (!matched) {
+			added.add(*it);
+		}
+	}
+
+	return unmatched.empty();
+}
+
 } // namespace output
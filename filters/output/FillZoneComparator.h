@@ -34,6 +34,18 @@ public:
 	static bool equal(Zone const& lhs, Zone const& rhs);
 
 	static bool equal(PropertySet const& lhs, PropertySet const& rhs);
+
+	/**
+	 * \brief Checks if \p after only adds zones to \p before.
+	 *
+	 * Returns true if every zone of \p before is present in \p after
+	 * unchanged.  In that case, the zones of \p after that have no
+	 * counterpart in \p before are appended to \p added.  Returns
+	 * false if a zone was removed or edited, leaving \p added in an
+	 * unspecified state.
+	 */
+	static bool addedZones(
+		ZoneSet const& before, ZoneSet const& after, ZoneSet& added);
 };
 
 } // namespace output
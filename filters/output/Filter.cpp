@@ -44,13 +44,21 @@ namespace output
 
 Filter::Filter(
 	PageSelectionAccessor const& page_selection_accessor)
-:	m_ptrSettings(new Settings)
+:	m_pageSelectionAccessor(page_selection_accessor),
+	m_ptrSettings(new Settings)
 {
-	if (CommandLine::get().isGui()) {
+}
+
+OptionsWidget*
+Filter::optionsWidget()
+{
+	// Built lazily, on first stage activation.
+	if (!m_ptrOptionsWidget.get() && CommandLine::get().isGui()) {
 		m_ptrOptionsWidget.reset(
-			new OptionsWidget(m_ptrSettings, page_selection_accessor)
+			new OptionsWidget(m_ptrSettings, m_pageSelectionAccessor)
 		);
 	}
+	return m_ptrOptionsWidget.get();
 }
 
 Filter::~Filter()
@@ -78,8 +86,9 @@ Filter::performRelinking(AbstractRelinker const& relinker)
 void
 Filter::preUpdateUI(FilterUiInterface* ui, PageId const& page_id)
 {
-	m_ptrOptionsWidget->preUpdateUI(page_id);
-	ui->setOptionsWidget(m_ptrOptionsWidget.get(), ui->KEEP_OWNERSHIP);
+	OptionsWidget* const opt_widget = optionsWidget();
+	opt_widget->preUpdateUI(page_id);
+	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 }
 
 QDomElement
@@ -152,28 +161,31 @@ Filter::loadSettings(ProjectReader const& reader, QDomElement const& filters_el)
 		if (page_id.isNull()) {
 			continue;
 		}
-		
-		ZoneSet const picture_zones(el.namedItem("zones").toElement(), m_pictureZonePropFactory);
-		if (!picture_zones.empty()) {
-			m_ptrSettings->setPictureZones(page_id, picture_zones);
-		}
 
-		ZoneSet const fill_zones(el.namedItem("fill-zones").toElement(), m_fillZonePropFactory);
-		if (!fill_zones.empty()) {
-			m_ptrSettings->setFillZones(page_id, fill_zones);
-		}
+		// Parsing zones and params for tens of thousands of pages takes
+		// a long time and retains a lot of memory.  Hand the element to
+		// Settings instead - it will be parsed when the page is first
+		// accessed.  This keeps the underlying DOM document alive, but
+		// that one exists at this point anyway.
+		m_ptrSettings->setDeferredPageElement(
+			page_id, el, m_pictureZonePropFactory, m_fillZonePropFactory
+		);
+	}
+}
 
-		QDomElement const params_el(el.namedItem("params").toElement());
-		if (!params_el.isNull()) {
-			Params const params(params_el);
-			m_ptrSettings->setParams(page_id, params);
-		}
-		
-		QDomElement const output_params_el(el.namedItem("output-params").toElement());
-		if (!output_params_el.isNull()) {
-			OutputParams const output_params(output_params_el);
-			m_ptrSettings->setOutputParams(page_id, output_params);
-		}
+void
+Filter::loadJournalledZones(
+	PageId const& page_id, AutosaveJournal::ZoneKind const kind,
+	QDomElement const& zones_el)
+{
+	if (kind == AutosaveJournal::FILL_ZONES) {
+		m_ptrSettings->setFillZones(
+			page_id, ZoneSet(zones_el, m_fillZonePropFactory)
+		);
+	} else {
+		m_ptrSettings->setPictureZones(
+			page_id, ZoneSet(zones_el, m_pictureZonePropFactory)
+		);
 	}
 }
 
@@ -25,8 +25,10 @@
 #include "IntrusivePtr.h"
 #include "FilterResult.h"
 #include "SafeDeletingQObjectPtr.h"
+#include "PageSelectionAccessor.h"
 #include "PictureZonePropFactory.h"
 #include "FillZonePropFactory.h"
+#include "AutosaveJournal.h"
 
 class PageId;
 class PageSelectionAccessor;
@@ -63,7 +65,17 @@ public:
 	
 	virtual void loadSettings(
 		ProjectReader const& reader, QDomElement const& filters_el);
-	
+
+	/**
+	 * \brief Applies a zone edit replayed from the autosave journal.
+	 *
+	 * \p zones_el is the \<zones\> element a journal record carries,
+	 * in the same schema the project file uses.
+	 */
+	void loadJournalledZones(
+		PageId const& page_id, AutosaveJournal::ZoneKind kind,
+		QDomElement const& zones_el);
+
 	IntrusivePtr<Task> createTask(
 		PageId const& page_id,
 		IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
@@ -73,13 +85,18 @@ public:
 	IntrusivePtr<CacheDrivenTask> createCacheDrivenTask(
 		OutputFileNameGenerator const& out_file_name_gen);
 	
-	OptionsWidget* optionsWidget() { return m_ptrOptionsWidget.get(); };
+	/**
+	 * In GUI mode, creates the widget on first call.
+	 * Returns null in CLI mode.
+	 */
+	OptionsWidget* optionsWidget();
 	Settings* getSettings() { return m_ptrSettings.get(); };
 private:
 	void writePageSettings(
 		QDomDocument& doc, QDomElement& filter_el,
 		PageId const& page_id, int numeric_id) const;
 	
+	PageSelectionAccessor m_pageSelectionAccessor;
 	IntrusivePtr<Settings> m_ptrSettings;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 	PictureZonePropFactory m_pictureZonePropFactory;
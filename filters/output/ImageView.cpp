@@ -20,19 +20,73 @@
 #include "ImageView.h.moc"
 #include "ImagePresentation.h"
 #include "OutputMargins.h"
+#include "imageproc/BinaryImage.h"
+#include "imageproc/BinaryThreshold.h"
+#include "imageproc/RasterOp.h"
+#include <QPainter>
+#include <QtGlobal>
+#include <limits>
+#include <stdint.h>
+
+using namespace imageproc;
 
 namespace output
 {
 
-ImageView::ImageView(QImage const& image, QImage const& downscaled_image)
+namespace
+{
+
+/**
+ * Expands a binarization result into an ARGB image that is black or
+ * white where the mask applies and transparent elsewhere, so that it
+ * can be drawn over the existing output.
+ */
+QImage composePreviewOverlay(BinaryImage const& bw, BinaryImage const& mask)
+{
+	int const w = bw.width();
+	int const h = bw.height();
+
+	QImage overlay(w, h, QImage::Format_ARGB32);
+
+	uint32_t const* bw_line = bw.data();
+	int const bw_wpl = bw.wordsPerLine();
+	uint32_t const* mask_line = mask.data();
+	int const mask_wpl = mask.wordsPerLine();
+
+	for (int y = 0; y < h; ++y) {
+		QRgb* const out = (QRgb*)overlay.scanLine(y);
+		for (int x = 0; x < w; ++x) {
+			if ((mask_line[x >> 5] >> (31 - (x & 31))) & 1) {
+				out[x] = (bw_line[x >> 5] >> (31 - (x & 31))) & 1
+					? 0xff000000 : 0xffffffff;
+			} else {
+				out[x] = 0x00000000;
+			}
+		}
+		bw_line += bw_wpl;
+		mask_line += mask_wpl;
+	}
+
+	return overlay;
+}
+
+} // anonymous namespace
+
+
+ImageView::ImageView(
+	QImage const& image, QImage const& downscaled_image,
+	OutputGenerator::BinarizationPreview const& binarization_preview)
 :	ImageViewBase(
 		image, downscaled_image,
 		ImagePresentation(QTransform(), QRectF(image.rect())),
 		OutputMargins()
 	),
 	m_dragHandler(*this),
-	m_zoomHandler(*this)
+	m_zoomHandler(*this),
+	m_binarizationPreview(binarization_preview),
+	m_previewAdjustment(std::numeric_limits<int>::min())
 {
+	rootInteractionHandler().makeLastFollower(*this);
 	rootInteractionHandler().makeLastFollower(m_dragHandler);
 	rootInteractionHandler().makeLastFollower(m_zoomHandler);
 }
@@ -41,4 +95,51 @@ ImageView::~ImageView()
 {
 }
 
+void
+ImageView::bwThresholdPreview(int const threshold_adjustment, bool* handled)
+{
+	if (m_binarizationPreview.isNull()) {
+		return;
+	}
+
+	*handled = true;
+
+	if (threshold_adjustment == m_previewAdjustment) {
+		return;
+	}
+	m_previewAdjustment = threshold_adjustment;
+
+	// The preview operates on a downscaled image, so even being
+	// synchronous it comfortably keeps up with slider movements.
+
+	// The same clamping as in OutputGenerator::adjustThreshold().
+	BinaryThreshold const threshold(
+		qBound(30, m_binarizationPreview.baseThreshold + threshold_adjustment, 225)
+	);
+
+	BinaryImage bw(m_binarizationPreview.grayImage, threshold);
+
+	// Fill masked out areas with white.
+	rasterOp<RopAnd<RopSrc, RopDst> >(bw, m_binarizationPreview.mask);
+
+	m_previewImage = composePreviewOverlay(bw, m_binarizationPreview.mask);
+	update();
+}
+
+void
+ImageView::onPaint(QPainter& painter, InteractionState const& interaction)
+{
+	if (m_previewImage.isNull()) {
+		return;
+	}
+
+	// The painter operates in virtual image coordinates, which for
+	// this view coincide with output image coordinates.
+	painter.setRenderHint(QPainter::SmoothPixmapTransform);
+	painter.drawImage(
+		QRectF(m_binarizationPreview.rect), m_previewImage,
+		QRectF(m_previewImage.rect())
+	);
+}
+
 } // namespace output
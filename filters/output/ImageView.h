@@ -20,25 +20,58 @@
 #define OUTPUT_IMAGEVIEW_H_
 
 #include "ImageViewBase.h"
+#include "InteractionHandler.h"
 #include "DragHandler.h"
 #include "ZoomHandler.h"
+#include "OutputGenerator.h"
 #include <QColor>
+#include <QImage>
 
 class ImageTransformation;
 
 namespace output
 {
 
-class ImageView : public ImageViewBase
+class ImageView : public ImageViewBase, private InteractionHandler
 {
 	Q_OBJECT
 public:
-	ImageView(QImage const& image, QImage const& downscaled_image);
-	
+	/**
+	 * \param binarization_preview Optional downscaled inputs for live
+	 *        re-binarization at a different threshold adjustment.
+	 *        May be null, in which case bwThresholdPreview() requests
+	 *        go unhandled.
+	 */
+	ImageView(QImage const& image, QImage const& downscaled_image,
+		OutputGenerator::BinarizationPreview const& binarization_preview
+			= OutputGenerator::BinarizationPreview());
+
 	virtual ~ImageView();
+public slots:
+	/**
+	 * \brief Displays a low-resolution re-binarization at a new threshold.
+	 *
+	 * Invoked from OptionsWidget while the B/W threshold is being tuned.
+	 * The result is an approximation - it skips edge smoothing and
+	 * despeckling - and is only shown until the full-resolution pass
+	 * that follows the adjustment replaces this view altogether.
+	 */
+	void bwThresholdPreview(int threshold_adjustment, bool* handled);
+protected:
+	virtual void onPaint(QPainter& painter, InteractionState const& interaction);
 private:
 	DragHandler m_dragHandler;
 	ZoomHandler m_zoomHandler;
+
+	OutputGenerator::BinarizationPreview m_binarizationPreview;
+
+	/**
+	 * Black and white where re-binarization applies, transparent
+	 * elsewhere.  Null when no preview is being shown.
+	 */
+	QImage m_previewImage;
+
+	int m_previewAdjustment;
 };
 
 } // namespace output
@@ -158,6 +158,13 @@ OptionsWidget::OptionsWidget(
 	thresholdSlider->setMinimum(-50);
 	thresholdSlider->setMaximum(50);
 	thresholLabel->setText(QString::number(thresholdSlider->value()));
+
+	m_bwThresholdReloadTimer.setSingleShot(true);
+	m_bwThresholdReloadTimer.setInterval(300);
+	connect(
+		&m_bwThresholdReloadTimer, SIGNAL(timeout()),
+		this, SIGNAL(reloadRequested())
+	);
 }
 
 OptionsWidget::~OptionsWidget()
@@ -167,6 +174,10 @@ OptionsWidget::~OptionsWidget()
 void
 OptionsWidget::preUpdateUI(PageId const& page_id)
 {
+	// A reload scheduled for the page we are leaving makes no sense
+	// for the one we are moving to.
+	m_bwThresholdReloadTimer.stop();
+
 	Params const params(m_ptrSettings->getParams(page_id));
 	m_pageId = page_id;
 	m_outputDpi = params.outputDpi();
@@ -282,9 +293,13 @@ OptionsWidget::bwThresholdChanged()
 	QToolTip::showText(tooltip_pos, tooltip_text, thresholdSlider);
 	
 	if (thresholdSlider->isSliderDown()) {
-		// Wait for it to be released.
+		// Wait for it to be released before reloading.
 		// We could have just disabled tracking, but in that case we wouldn't
 		// be able to show tooltips with a precise value.
+		// In the meantime, show a low-resolution preview of the
+		// new threshold, if the Output tab is able to provide one.
+		bool handled = false;
+		emit bwThresholdPreview(value, &handled);
 		return;
 	}
 
@@ -297,8 +312,19 @@ OptionsWidget::bwThresholdChanged()
 	opt.setThresholdAdjustment(value);
 	m_colorParams.setBlackWhiteOptions(opt);
 	m_ptrSettings->setColorParams(m_pageId, m_colorParams);
-	emit reloadRequested();
-	
+
+	// With a preview on screen, the full-resolution reload can wait
+	// a little, coalescing rapid successive adjustments - such as
+	// repeated clicks on the Thinner / Thicker links - into a single
+	// reload.  Without one, reload immediately, like we always did.
+	bool handled = false;
+	emit bwThresholdPreview(value, &handled);
+	if (handled) {
+		m_bwThresholdReloadTimer.start();
+	} else {
+		emit reloadRequested();
+	}
+
 	emit invalidateThumbnail(m_pageId);
 }
 
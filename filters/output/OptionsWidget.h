@@ -30,6 +30,7 @@
 #include "DespeckleLevel.h"
 #include "Dpi.h"
 #include "ImageViewTab.h"
+#include <QTimer>
 #include <set>
 
 namespace dewarping
@@ -63,6 +64,14 @@ public:
 signals:
 	void despeckleLevelChanged(DespeckleLevel level, bool* handled);
 
+	/**
+	 * Requests a low-resolution preview of a different B/W threshold
+	 * adjustment.  Handled by the view on the Output tab, provided it
+	 * has the necessary inputs, in which case the full-resolution
+	 * reload may be delayed until the threshold settles.
+	 */
+	void bwThresholdPreview(int threshold_adjustment, bool* handled);
+
 	void depthPerceptionChanged(double val);
 public slots:
 	void tabChanged(ImageViewTab tab);
@@ -133,6 +142,12 @@ private:
 	DespeckleLevel m_despeckleLevel;
 	ImageViewTab m_lastTab;
 	int m_ignoreThresholdChanges;
+
+	/**
+	 * Delays the full-resolution reload after a threshold change for
+	 * which a preview was shown, coalescing rapid successive changes.
+	 */
+	QTimer m_bwThresholdReloadTimer;
 };
 
 } // namespace output
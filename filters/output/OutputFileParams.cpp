@@ -21,29 +21,82 @@
 #include <QDomElement>
 #include <QFileInfo>
 #include <QDateTime>
+#include <QFile>
+#include <QByteArray>
 
 namespace output
 {
 
+namespace
+{
+
+/**
+ * A fast sampled content hash: FNV-1a over the first and last 64KB
+ * of the file.  Tools like rsync or backup restores may touch
+ * timestamps without changing content, and this lets us recognize
+ * such files as unchanged without reading them in full.
+ */
+quint64 sampledContentHash(QFileInfo const& file_info)
+{
+	int const sample_bytes = 64 * 1024;
+
+	QFile file(file_info.filePath());
+	if (!file.open(QIODevice::ReadOnly)) {
+		return 0;
+	}
+
+	quint64 hash = Q_UINT64_C(0xcbf29ce484222325);
+
+	QByteArray sample(file.read(sample_bytes));
+	for (int pass = 0; pass < 2; ++pass) {
+		char const* p = sample.constData();
+		char const* const end = p + sample.size();
+		for (; p != end; ++p) {
+			hash = (hash ^ (quint64)(unsigned char)*p)
+				* Q_UINT64_C(0x100000001b3);
+		}
+
+		if (file.size() <= sample_bytes) {
+			break;
+		}
+		if (pass == 0) {
+			file.seek(qMax(file.size() - sample_bytes, qint64(sample_bytes)));
+			sample = file.read(sample_bytes);
+		}
+	}
+
+	return hash;
+}
+
+} // anonymous namespace
+
 OutputFileParams::OutputFileParams()
 :	m_size(-1),
-	m_mtime(0)
+	m_mtime(0),
+	m_contentHash(0),
+	m_hasContentHash(false)
 {
 }
 
 OutputFileParams::OutputFileParams(QFileInfo const& file_info)
 :	m_size(-1),
-	m_mtime(0)
+	m_mtime(0),
+	m_contentHash(0),
+	m_hasContentHash(false)
 {
 	if (file_info.exists()) {
 		m_size = file_info.size();
 		m_mtime = file_info.lastModified().toTime_t();
+		m_contentHash = sampledContentHash(file_info);
+		m_hasContentHash = true;
 	}
 }
 
 OutputFileParams::OutputFileParams(QDomElement const& el)
 :	m_size(-1),
-	m_mtime(0)
+	m_mtime(0),
+	m_contentHash(0),
+	m_hasContentHash(false)
 {
 	if (el.hasAttribute("size")) {
 		m_size = (qint64)el.attribute("size").toLongLong();
@@ -51,6 +104,10 @@ OutputFileParams::OutputFileParams(QDomElement const& el)
 	if (el.hasAttribute("mtime")) {
 		m_mtime = (time_t)el.attribute("mtime").toLongLong();
 	}
+	if (el.hasAttribute("chash")) {
+		m_contentHash = el.attribute("chash").toULongLong();
+		m_hasContentHash = true;
+	}
 }
 
 QDomElement
@@ -60,6 +117,9 @@ OutputFileParams::toXml(QDomDocument& doc, QString const& name) const
 		QDomElement el(doc.createElement(name));
 		el.setAttribute("size", QString::number(m_size));
 		el.setAttribute("mtime", QString::number(m_mtime));
+		if (m_hasContentHash) {
+			el.setAttribute("chash", QString::number(m_contentHash));
+		}
 		return el;
 	} else {
 		return QDomElement();
@@ -69,8 +129,20 @@ OutputFileParams::toXml(QDomDocument& doc, QString const& name) const
 bool
 OutputFileParams::matches(OutputFileParams const& other) const
 {
-	return isValid() && other.isValid() &&
-			m_size == other.m_size/* && m_mtime == other.m_mtime*/;
+	if (!isValid() || !other.isValid() || m_size != other.m_size) {
+		return false;
+	}
+
+	// The content hash sees through timestamp churn from file
+	// moves, copies and backup restores, while still catching
+	// files whose content actually changed.  Entries written by
+	// older versions have no hash - fall back to the historical
+	// size-only comparison for them.
+	if (m_hasContentHash && other.m_hasContentHash) {
+		return m_contentHash == other.m_contentHash;
+	}
+
+	return true;
 }
 
 } // namespace output
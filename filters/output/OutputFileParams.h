@@ -47,11 +47,17 @@ public:
 	
 	/**
 	 * \brief Returns true if it's likely we have two identical files.
+	 *
+	 * Compares sizes and, when both sides have one, a sampled
+	 * content hash, so files whose timestamps were touched by
+	 * moves, copies or backup restores still match.
 	 */
 	bool matches(OutputFileParams const& other) const;
 private:
 	qint64 m_size;
 	time_t m_mtime;
+	quint64 m_contentHash;
+	bool m_hasContentHash;
 };
 
 } // namespace output
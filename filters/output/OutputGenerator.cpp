@@ -21,6 +21,8 @@
 #include "FilterData.h"
 #include "TaskStatus.h"
 #include "Utils.h"
+#include "Profiler.h"
+#include "CommandLine.h"
 #include "DebugImages.h"
 #include "EstimateBackground.h"
 #include "Despeckle.h"
@@ -51,6 +53,7 @@
 #include "imageproc/SeedFill.h"
 #include "imageproc/Constants.h"
 #include "imageproc/Grayscale.h"
+#include "imageproc/ImageArena.h"
 #include "imageproc/RasterOp.h"
 #include "imageproc/GrayRasterOp.h"
 #include "imageproc/PolynomialSurface.h"
@@ -74,6 +77,9 @@
 #include <QPointF>
 #include <QPolygonF>
 #include <QPainter>
+#include <QTransform>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QColor>
 #include <QPen>
 #include <QBrush>
@@ -81,6 +87,7 @@
 #include <QDebug>
 #include <Qt>
 #include <vector>
+#include <list>
 #include <memory>
 #include <new>
 #include <algorithm>
@@ -111,6 +118,331 @@ struct RaiseAboveBackground
 	}
 };
 
+/**
+ * Memoizes estimateBackground() results.  The background surface
+ * only depends on the source image and the crop applied to it,
+ * so re-rendering with different output settings (despeckle level,
+ * margins) can reuse it.  Entries are keyed by QImage::cacheKey()
+ * of the source gray image, which FilterDataCache keeps stable
+ * across pipeline re-runs.
+ */
+class BackgroundSurfaceCache
+{
+public:
+	BackgroundSurfaceCache() {}
+
+	/**
+	 * Returns the cached surface for these inputs, or null.
+	 */
+	std::auto_ptr<PolynomialSurface> lookup(
+		qint64 image_key, QTransform const& xform,
+		QRect const& target_rect, QPolygonF const& area);
+
+	void store(
+		qint64 image_key, QTransform const& xform,
+		QRect const& target_rect, QPolygonF const& area,
+		PolynomialSurface const& surface);
+private:
+	struct Entry
+	{
+		qint64 imageKey;
+		QTransform xform;
+		QRect targetRect;
+		QPolygonF area;
+		PolynomialSurface surface;
+
+		Entry(qint64 image_key, QTransform const& xform,
+			QRect const& target_rect, QPolygonF const& area,
+			PolynomialSurface const& surface)
+		:	imageKey(image_key), xform(xform), targetRect(target_rect),
+			area(area), surface(surface) {}
+
+		bool matches(qint64 image_key, QTransform const& other_xform,
+				QRect const& target_rect, QPolygonF const& other_area) const {
+			return imageKey == image_key && xform == other_xform
+				&& targetRect == target_rect && area == other_area;
+		}
+	};
+
+	enum { MAX_ENTRIES = 4 };
+
+	QMutex m_mutex;
+	std::list<Entry> m_entries; /**< Most recently used first. */
+};
+
+
+BackgroundSurfaceCache bg_surface_cache;
+
+
+std::auto_ptr<PolynomialSurface>
+BackgroundSurfaceCache::lookup(
+	qint64 const image_key, QTransform const& xform,
+	QRect const& target_rect, QPolygonF const& area)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	std::list<Entry>::iterator it(m_entries.begin());
+	std::list<Entry>::iterator const end(m_entries.end());
+	for (; it != end; ++it) {
+		if (it->matches(image_key, xform, target_rect, area)) {
+			m_entries.splice(m_entries.begin(), m_entries, it);
+			return std::auto_ptr<PolynomialSurface>(
+				new PolynomialSurface(it->surface)
+			);
+		}
+	}
+
+	return std::auto_ptr<PolynomialSurface>();
+}
+
+void
+BackgroundSurfaceCache::store(
+	qint64 const image_key, QTransform const& xform,
+	QRect const& target_rect, QPolygonF const& area,
+	PolynomialSurface const& surface)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	m_entries.push_front(Entry(image_key, xform, target_rect, area, surface));
+	while (m_entries.size() > size_t(MAX_ENTRIES)) {
+		m_entries.pop_back();
+	}
+}
+
+
+/**
+ * Memoizes distortion models built by automatic dewarping.  Text line
+ * tracing is by far the most expensive part of building a model, yet
+ * its result only depends on the source image and the geometry of the
+ * output, not on depth perception or rendering settings.  Caching the
+ * built model lets depth perception adjustments skip straight to
+ * re-dewarping.  Like BackgroundSurfaceCache, entries are keyed by
+ * QImage::cacheKey() of the source gray image, which FilterDataCache
+ * keeps stable across pipeline re-runs.
+ */
+class AutoDewarpModelCache
+{
+public:
+	AutoDewarpModelCache() {}
+
+	/**
+	 * On a hit, \p model is set to the cached model and true is returned.
+	 */
+	bool lookup(
+		qint64 image_key, QTransform const& xform,
+		QPolygonF const& pre_crop_area, QRect const& content_rect,
+		Dpi const& dpi, bool normalize_illumination,
+		DistortionModel& model);
+
+	void store(
+		qint64 image_key, QTransform const& xform,
+		QPolygonF const& pre_crop_area, QRect const& content_rect,
+		Dpi const& dpi, bool normalize_illumination,
+		DistortionModel const& model);
+private:
+	struct Entry
+	{
+		qint64 imageKey;
+		QTransform xform;
+		QPolygonF preCropArea;
+		QRect contentRect;
+		Dpi dpi;
+		bool normalizeIllumination;
+		DistortionModel model;
+
+		Entry(qint64 image_key, QTransform const& xform,
+			QPolygonF const& pre_crop_area, QRect const& content_rect,
+			Dpi const& dpi, bool normalize_illumination,
+			DistortionModel const& model)
+		:	imageKey(image_key), xform(xform), preCropArea(pre_crop_area),
+			contentRect(content_rect), dpi(dpi),
+			normalizeIllumination(normalize_illumination), model(model) {}
+
+		bool matches(qint64 image_key, QTransform const& other_xform,
+				QPolygonF const& pre_crop_area, QRect const& content_rect,
+				Dpi const& other_dpi, bool normalize_illumination) const {
+			return imageKey == image_key && xform == other_xform
+				&& preCropArea == pre_crop_area && contentRect == content_rect
+				&& dpi == other_dpi
+				&& normalizeIllumination == normalize_illumination;
+		}
+	};
+
+	enum { MAX_ENTRIES = 4 };
+
+	QMutex m_mutex;
+	std::list<Entry> m_entries; /**< Most recently used first. */
+};
+
+
+AutoDewarpModelCache auto_dewarp_model_cache;
+
+
+bool
+AutoDewarpModelCache::lookup(
+	qint64 const image_key, QTransform const& xform,
+	QPolygonF const& pre_crop_area, QRect const& content_rect,
+	Dpi const& dpi, bool const normalize_illumination,
+	DistortionModel& model)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	std::list<Entry>::iterator it(m_entries.begin());
+	std::list<Entry>::iterator const end(m_entries.end());
+	for (; it != end; ++it) {
+		if (it->matches(image_key, xform, pre_crop_area,
+				content_rect, dpi, normalize_illumination)) {
+			m_entries.splice(m_entries.begin(), m_entries, it);
+			model = it->model;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void
+AutoDewarpModelCache::store(
+	qint64 const image_key, QTransform const& xform,
+	QPolygonF const& pre_crop_area, QRect const& content_rect,
+	Dpi const& dpi, bool const normalize_illumination,
+	DistortionModel const& model)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	m_entries.push_front(
+		Entry(
+			image_key, xform, pre_crop_area,
+			content_rect, dpi, normalize_illumination, model
+		)
+	);
+	while (m_entries.size() > size_t(MAX_ENTRIES)) {
+		m_entries.pop_back();
+	}
+}
+
+
+/**
+ * Memoizes the part of processWithoutDewarping() upstream of
+ * binarization: the transformed and possibly illumination-normalized
+ * image, its smoothed version and the mixed-mode picture mask (taken
+ * before manual picture zones are applied, so zone edits don't
+ * invalidate it).  None of these depend on the threshold adjustment
+ * or the despeckle level, which are exactly the parameters that get
+ * tuned interactively - with the checkpoint in place, such changes
+ * re-execute only binarization and the steps after it.
+ *
+ * Unlike the caches above, an entry holds full-page images, so only
+ * a single entry is kept - the page currently being tuned - and
+ * batch processing bypasses the cache entirely.
+ */
+class BinarizationCheckpointCache
+{
+public:
+	BinarizationCheckpointCache() : m_valid(false) {}
+
+	/**
+	 * On a hit, fills the output arguments and returns true.
+	 */
+	bool lookup(
+		qint64 image_key, QTransform const& xform,
+		QRect const& out_rect, QRect const& content_rect,
+		Dpi const& dpi, RenderParams const& render_params,
+		QImage& normalized, QImage& smoothed, BinaryImage& bw_mask);
+
+	void store(
+		qint64 image_key, QTransform const& xform,
+		QRect const& out_rect, QRect const& content_rect,
+		Dpi const& dpi, RenderParams const& render_params,
+		QImage const& normalized, QImage const& smoothed,
+		BinaryImage const& bw_mask);
+private:
+	bool matches(
+		qint64 image_key, QTransform const& xform,
+		QRect const& out_rect, QRect const& content_rect,
+		Dpi const& dpi, RenderParams const& render_params) const;
+
+	QMutex m_mutex;
+	bool m_valid;
+	qint64 m_imageKey;
+	QTransform m_xform;
+	QRect m_outRect;
+	QRect m_contentRect;
+	Dpi m_dpi;
+	bool m_whiteMargins;
+	bool m_normalizeIllumination;
+	bool m_needBinarization;
+	bool m_mixedOutput;
+	QImage m_normalized;
+	QImage m_smoothed;
+	BinaryImage m_bwMask;
+};
+
+
+BinarizationCheckpointCache checkpoint_cache;
+
+
+bool
+BinarizationCheckpointCache::matches(
+	qint64 const image_key, QTransform const& xform,
+	QRect const& out_rect, QRect const& content_rect,
+	Dpi const& dpi, RenderParams const& render_params) const
+{
+	return m_valid && m_imageKey == image_key && m_xform == xform
+		&& m_outRect == out_rect && m_contentRect == content_rect
+		&& m_dpi == dpi
+		&& m_whiteMargins == render_params.whiteMargins()
+		&& m_normalizeIllumination == render_params.normalizeIllumination()
+		&& m_needBinarization == render_params.needBinarization()
+		&& m_mixedOutput == render_params.mixedOutput();
+}
+
+bool
+BinarizationCheckpointCache::lookup(
+	qint64 const image_key, QTransform const& xform,
+	QRect const& out_rect, QRect const& content_rect,
+	Dpi const& dpi, RenderParams const& render_params,
+	QImage& normalized, QImage& smoothed, BinaryImage& bw_mask)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (!matches(image_key, xform, out_rect, content_rect, dpi, render_params)) {
+		return false;
+	}
+
+	normalized = m_normalized;
+	smoothed = m_smoothed;
+	bw_mask = m_bwMask;
+
+	return true;
+}
+
+void
+BinarizationCheckpointCache::store(
+	qint64 const image_key, QTransform const& xform,
+	QRect const& out_rect, QRect const& content_rect,
+	Dpi const& dpi, RenderParams const& render_params,
+	QImage const& normalized, QImage const& smoothed,
+	BinaryImage const& bw_mask)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	m_valid = true;
+	m_imageKey = image_key;
+	m_xform = xform;
+	m_outRect = out_rect;
+	m_contentRect = content_rect;
+	m_dpi = dpi;
+	m_whiteMargins = render_params.whiteMargins();
+	m_normalizeIllumination = render_params.normalizeIllumination();
+	m_needBinarization = render_params.needBinarization();
+	m_mixedOutput = render_params.mixedOutput();
+	m_normalized = normalized;
+	m_smoothed = smoothed;
+	m_bwMask = bw_mask;
+}
+
+
 struct CombineInverted
 {
 	static uint8_t transform(uint8_t src, uint8_t dst) {
@@ -234,6 +566,78 @@ void combineMixed(
 	}
 }
 
+/**
+ * \brief Decides whether a page has a flat background.
+ *
+ * Born-clean scanner output typically has a perfectly uniform
+ * background, and for such pages fitting a polynomial surface
+ * through estimateBackground() is pure overhead.  This classifier
+ * builds a histogram of a downscaled copy of the image and measures
+ * the variance of the light half, where the background lives.
+ * A page counts as flat only when the light pixels form a bright,
+ * dominant and very narrow mode - when in doubt, we take the full
+ * normalization path.
+ *
+ * \param image The grayscale image to classify, in output coordinates.
+ * \param bg_level If the page is flat, receives the background level.
+ * \return Whether the background is provably flat.
+ */
+bool isBackgroundFlat(GrayImage const& image, uint8_t* bg_level)
+{
+	if (image.isNull()) {
+		return false;
+	}
+
+	// The histogram shape survives downscaling just fine, and a
+	// small image makes the classification cost negligible.
+	QSize downscaled_size(image.size());
+	downscaled_size.scale(200, 200, Qt::KeepAspectRatio);
+	GrayscaleHistogram const hist(
+		scaleToGray(image, downscaled_size.expandedTo(QSize(1, 1)))
+	);
+
+	int total = 0;
+	for (int i = 0; i < 256; ++i) {
+		total += hist[i];
+	}
+
+	// The background of a scanned page is light.  Content pixels
+	// live in the dark half and don't interest us here.
+	int64_t light_total = 0;
+	int64_t weighted_sum = 0;
+	for (int i = 128; i < 256; ++i) {
+		light_total += hist[i];
+		weighted_sum += int64_t(i) * hist[i];
+	}
+	if (light_total < int64_t(total) / 2) {
+		// Background doesn't dominate the page - not a clean scan.
+		return false;
+	}
+
+	double const mean = double(weighted_sum) / double(light_total);
+	if (mean < 160.0) {
+		// Too dark to be a clean background.
+		return false;
+	}
+
+	double variance = 0;
+	for (int i = 128; i < 256; ++i) {
+		double const d = double(i) - mean;
+		variance += d * d * hist[i];
+	}
+	variance /= double(light_total);
+
+	// A genuinely flat background stays within a few gray levels.
+	// Anything wider may be an illumination gradient, which is
+	// exactly what the full path exists to correct.
+	if (variance > 9.0) {
+		return false;
+	}
+
+	*bg_level = static_cast<uint8_t>(mean + 0.5);
+	return true;
+}
+
 } // anonymous namespace
 
 
@@ -241,14 +645,16 @@ OutputGenerator::OutputGenerator(
 	Dpi const& dpi, ColorParams const& color_params,
 	DespeckleLevel const despeckle_level,
 	ImageTransformation const& xform,
-	QPolygonF const& content_rect_phys)
+	QPolygonF const& content_rect_phys,
+	bool const enable_checkpoint_cache)
 :	m_dpi(dpi),
 	m_colorParams(color_params),
 	m_xform(xform),
 	m_outRect(xform.resultingRect().toRect()),
 	m_contentRect(xform.transform().map(content_rect_phys).boundingRect().toRect()),
-	m_despeckleLevel(despeckle_level)
-{	
+	m_despeckleLevel(despeckle_level),
+	m_checkpointCacheEnabled(enable_checkpoint_cache)
+{
 	assert(m_outRect.topLeft() == QPoint(0, 0));
 
 	// Note that QRect::contains(<empty rect>) always returns false, so we don't use it here.
@@ -264,13 +670,21 @@ OutputGenerator::process(
 	DepthPerception const& depth_perception,
 	imageproc::BinaryImage* auto_picture_mask,
 	imageproc::BinaryImage* speckles_image,
+	BinarizationPreview* binarization_preview,
 	DebugImages* const dbg) const
 {
+	// Recycle the page-sized temporaries the pipeline below keeps
+	// allocating and freeing, instead of going through the global
+	// allocator every time.
+	ImageArena::Scope const arena_scope;
+
+	ProfileScope const profile_scope("output/process");
+
 	QImage image(
 		processImpl(
 			status, input, picture_zones, fill_zones,
 			dewarping_mode, distortion_model, depth_perception,
-			auto_picture_mask, speckles_image, dbg
+			auto_picture_mask, speckles_image, binarization_preview, dbg
 		)
 	);
 	assert(!image.isNull());
@@ -302,6 +716,8 @@ OutputGenerator::normalizeIlluminationGray(
 	QTransform const& xform, QRect const& target_rect,
 	GrayImage* background, DebugImages* const dbg)
 {
+	ProfileScope const profile_scope("normalize-illumination");
+
 	GrayImage to_be_normalized(
 		transformToGray(
 			input, xform, target_rect, OutsidePixels::assumeWeakNearest()
@@ -315,17 +731,55 @@ OutputGenerator::normalizeIlluminationGray(
 	
 	QPolygonF transformed_consideration_area(xform.map(area_to_consider));
 	transformed_consideration_area.translate(-target_rect.topLeft());
-	
-	PolynomialSurface const bg_ps(
-		estimateBackground(
-			to_be_normalized, transformed_consideration_area,
-			status, dbg
-		)
-	);
-	
+
+	// Pages with a provably flat background don't need a background
+	// surface at all - normalizing against a constant level gives the
+	// same result at a fraction of the cost.  Debug runs always take
+	// the full path, so the debug image set stays complete.
+	uint8_t flat_bg_level = 0xff;
+	if (!dbg && isBackgroundFlat(to_be_normalized, &flat_bg_level)) {
+		GrayImage bg_img(to_be_normalized.size());
+		bg_img.fill(flat_bg_level);
+		if (background) {
+			*background = bg_img;
+		}
+
+		status.throwIfCancelled();
+
+		grayRasterOp<RaiseAboveBackground>(bg_img, to_be_normalized);
+		return bg_img;
+	}
+
+	// The background surface only depends on the inputs we key by,
+	// so tweaking unrelated output settings reuses it.  Debug runs
+	// bypass the cache, as estimateBackground() emits debug images.
+	qint64 const image_key = input.cacheKey();
+	std::auto_ptr<PolynomialSurface> bg_ps;
+	if (!dbg) {
+		bg_ps = bg_surface_cache.lookup(
+			image_key, xform, target_rect, area_to_consider
+		);
+	}
+	if (!bg_ps.get()) {
+		bg_ps.reset(
+			new PolynomialSurface(
+				estimateBackground(
+					to_be_normalized, transformed_consideration_area,
+					status, dbg
+				)
+			)
+		);
+		if (!dbg) {
+			bg_surface_cache.store(
+				image_key, xform, target_rect,
+				area_to_consider, *bg_ps
+			);
+		}
+	}
+
 	status.throwIfCancelled();
-	
-	GrayImage bg_img(bg_ps.render(to_be_normalized.size()));
+
+	GrayImage bg_img(bg_ps->render(to_be_normalized.size()));
 	if (dbg) {
 		dbg->add(bg_img, "background");
 	}
@@ -419,29 +873,36 @@ OutputGenerator::modifyBinarizationMask(
 
 	typedef PictureLayerProperty PLP;
 
-	// Pass 1: ERASER1
+	// Collect the zones of each layer, then fill each layer's zones
+	// in a single sweep over the mask.
+	std::vector<QPolygonF> eraser1_polys;
+	std::vector<QPolygonF> painter2_polys;
+	std::vector<QPolygonF> eraser3_polys;
 	BOOST_FOREACH(Zone const& zone, zones) {
-		if (zone.properties().locateOrDefault<PLP>()->layer() == PLP::ERASER1) {
-			QPolygonF const poly(zone.spline().toPolygon());
-			PolygonRasterizer::fill(bw_mask, BLACK, xform.map(poly), Qt::WindingFill);
+		QPolygonF const poly(zone.spline().toPolygon());
+		switch (zone.properties().locateOrDefault<PLP>()->layer()) {
+			case PLP::ERASER1:
+				eraser1_polys.push_back(xform.map(poly));
+				break;
+			case PLP::PAINTER2:
+				painter2_polys.push_back(xform.map(poly));
+				break;
+			case PLP::ERASER3:
+				eraser3_polys.push_back(xform.map(poly));
+				break;
+			default:
+				break;
 		}
 	}
 
+	// Pass 1: ERASER1
+	PolygonRasterizer::fill(bw_mask, BLACK, eraser1_polys, Qt::WindingFill);
+
 	// Pass 2: PAINTER2
-	BOOST_FOREACH(Zone const& zone, zones) {
-		if (zone.properties().locateOrDefault<PLP>()->layer() == PLP::PAINTER2) {
-			QPolygonF const poly(zone.spline().toPolygon());
-			PolygonRasterizer::fill(bw_mask, WHITE, xform.map(poly), Qt::WindingFill);
-		}
-	}
+	PolygonRasterizer::fill(bw_mask, WHITE, painter2_polys, Qt::WindingFill);
 
-	// Pass 1: ERASER3
-	BOOST_FOREACH(Zone const& zone, zones) {
-		if (zone.properties().locateOrDefault<PLP>()->layer() == PLP::ERASER3) {
-			QPolygonF const poly(zone.spline().toPolygon());
-			PolygonRasterizer::fill(bw_mask, BLACK, xform.map(poly), Qt::WindingFill);
-		}
-	}
+	// Pass 3: ERASER3
+	PolygonRasterizer::fill(bw_mask, BLACK, eraser3_polys, Qt::WindingFill);
 }
 
 QImage
@@ -453,12 +914,16 @@ OutputGenerator::processImpl(
 	DepthPerception const& depth_perception,
 	imageproc::BinaryImage* auto_picture_mask,
 	imageproc::BinaryImage* speckles_image,
+	BinarizationPreview* binarization_preview,
 	DebugImages* const dbg) const
 {
 	RenderParams const render_params(m_colorParams);
 
 	if (dewarping_mode == DewarpingMode::AUTO ||
 		(dewarping_mode == DewarpingMode::MANUAL && distortion_model.isValid())) {
+		// No binarization preview in this case - the binarized content
+		// undergoes dewarping, which a simple re-binarization of the
+		// dewarped grayscale image wouldn't reproduce.
 		return processWithDewarping(
 			status, input, picture_zones, fill_zones,
 			dewarping_mode, distortion_model, depth_perception,
@@ -471,7 +936,7 @@ OutputGenerator::processImpl(
 	} else {
 		return processWithoutDewarping(
 			status, input, picture_zones, fill_zones,
-			auto_picture_mask, speckles_image, dbg
+			auto_picture_mask, speckles_image, binarization_preview, dbg
 		);
 	}
 }
@@ -533,6 +998,7 @@ OutputGenerator::processWithoutDewarping(
 	ZoneSet const& picture_zones, ZoneSet const& fill_zones,
 	imageproc::BinaryImage* auto_picture_mask,
 	imageproc::BinaryImage* speckles_image,
+	BinarizationPreview* binarization_preview,
 	DebugImages* dbg) const
 {
 	RenderParams const render_params(m_colorParams);
@@ -569,51 +1035,130 @@ OutputGenerator::processWithoutDewarping(
 #endif
 	);
 	
-	QImage maybe_normalized;
-	
 	// Crop area in original image coordinates.
 	QPolygonF const orig_image_crop_area(
 		m_xform.transformBack().map(
 			m_xform.resultingPreCropArea()
 		)
 	);
-	
-	// Crop area in maybe_normalized image coordinates.	
+
+	// Crop area in maybe_normalized image coordinates.
 	QPolygonF normalize_illumination_crop_area(m_xform.resultingPreCropArea());
 	normalize_illumination_crop_area.translate(-normalize_illumination_rect.topLeft());
 
-	if (render_params.normalizeIllumination()) {
-		maybe_normalized = normalizeIlluminationGray(
-			status, input.grayImage(), orig_image_crop_area,
-			m_xform.transform(), normalize_illumination_rect, 0, dbg
-		);
-	} else {
-		maybe_normalized = transform(
-			input.origImage(), m_xform.transform(),
-			normalize_illumination_rect, OutsidePixels::assumeColor(Qt::white)
+	QImage maybe_normalized;
+	QImage maybe_smoothed;
+
+	// The mixed-mode picture mask, before manual picture zones
+	// are applied to it.
+	BinaryImage bw_mask_no_zones;
+
+	// Everything from here to binarization is independent of the
+	// threshold adjustment and the despeckle level, so on a checkpoint
+	// cache hit interactive tuning of those skips straight to the
+	// downstream steps.
+	qint64 const image_key = input.grayImage().cacheKey();
+	bool const cache_usable = m_checkpointCacheEnabled && !dbg;
+	bool have_checkpoint = false;
+	if (cache_usable) {
+		have_checkpoint = checkpoint_cache.lookup(
+			image_key, m_xform.transform(), m_outRect, m_contentRect,
+			m_dpi, render_params,
+			maybe_normalized, maybe_smoothed, bw_mask_no_zones
 		);
 	}
 
-	status.throwIfCancelled();
-	
-	QImage maybe_smoothed;
-	
-	// We only do smoothing if we are going to do binarization later.
-	if (!render_params.needBinarization()) {
-		maybe_smoothed = maybe_normalized;
-	} else {
-		maybe_smoothed = smoothToGrayscale(maybe_normalized, m_dpi);
-		if (dbg) {
-			dbg->add(maybe_smoothed, "smoothed");
+	if (!have_checkpoint) {
+		if (render_params.normalizeIllumination()) {
+			maybe_normalized = normalizeIlluminationGray(
+				status, input.grayImage(), orig_image_crop_area,
+				m_xform.transform(), normalize_illumination_rect, 0, dbg
+			);
+		} else {
+			maybe_normalized = transform(
+				input.origImage(), m_xform.transform(),
+				normalize_illumination_rect, OutsidePixels::assumeColor(Qt::white)
+			);
+		}
+
+		status.throwIfCancelled();
+
+		// We only do smoothing if we are going to do binarization later.
+		if (!render_params.needBinarization()) {
+			maybe_smoothed = maybe_normalized;
+		} else {
+			maybe_smoothed = smoothToGrayscale(maybe_normalized, m_dpi);
+			if (dbg) {
+				dbg->add(maybe_smoothed, "smoothed");
+			}
+		}
+
+		status.throwIfCancelled();
+
+		if (render_params.mixedOutput() && !m_outRect.isEmpty()) {
+			// This block should go before the block with
+			// adjustBrightnessGrayscale(), which may convert
+			// maybe_normalized from grayscale to color mode.
+
+			bw_mask_no_zones = estimateBinarizationMask(
+				status, GrayImage(maybe_normalized),
+				normalize_illumination_rect,
+				small_margins_rect, dbg
+			);
+			if (dbg) {
+				dbg->add(bw_mask_no_zones, "bw_mask");
+			}
+
+			status.throwIfCancelled();
+		}
+
+		if (render_params.normalizeIllumination()
+				&& !render_params.binaryOutput()
+				&& !input.origImage().allGray()) {
+			assert(maybe_normalized.format() == QImage::Format_Indexed8);
+			QImage tmp(
+				transform(
+					input.origImage(), m_xform.transform(),
+					normalize_illumination_rect,
+					OutsidePixels::assumeColor(Qt::white)
+				)
+			);
+
+			status.throwIfCancelled();
+
+			adjustBrightnessGrayscale(tmp, maybe_normalized);
+			maybe_normalized = tmp;
+			if (dbg) {
+				dbg->add(maybe_normalized, "norm_illum_color");
+			}
+		}
+
+		if (cache_usable) {
+			// Stored before anything below mutates these images.
+			// They are implicitly shared, so later writes detach
+			// from the cached copies rather than corrupt them.
+			checkpoint_cache.store(
+				image_key, m_xform.transform(), m_outRect, m_contentRect,
+				m_dpi, render_params,
+				maybe_normalized, maybe_smoothed, bw_mask_no_zones
+			);
 		}
 	}
-	
+
 	status.throwIfCancelled();
-	
+
 	if (render_params.binaryOutput() || m_outRect.isEmpty()) {
 		BinaryImage dst(m_outRect.size().expandedTo(QSize(1, 1)), WHITE);
 		
 		if (!m_contentRect.isEmpty()) {
+			if (binarization_preview) {
+				fillBinarizationPreview(
+					*binarization_preview, maybe_smoothed,
+					normalize_illumination_rect,
+					normalize_illumination_crop_area, 0
+				);
+			}
+
 			BinaryImage bw_content(
 				binarize(maybe_smoothed, normalize_illumination_crop_area)
 			);
@@ -651,21 +1196,8 @@ OutputGenerator::processWithoutDewarping(
 	
 	QSize const target_size(m_outRect.size().expandedTo(QSize(1, 1)));
 
-	BinaryImage bw_mask;
+	BinaryImage bw_mask(bw_mask_no_zones);
 	if (render_params.mixedOutput()) {
-		// This block should go before the block with
-		// adjustBrightnessGrayscale(), which may convert
-		// maybe_normalized from grayscale to color mode.
-		
-		bw_mask = estimateBinarizationMask(
-			status, GrayImage(maybe_normalized),
-			normalize_illumination_rect,
-			small_margins_rect, dbg
-		);
-		if (dbg) {
-			dbg->add(bw_mask, "bw_mask");
-		}
-		
 		if (auto_picture_mask) {
 			if (auto_picture_mask->size() != target_size) {
 				BinaryImage(target_size).swap(*auto_picture_mask);
@@ -681,36 +1213,26 @@ OutputGenerator::processWithoutDewarping(
 
 		status.throwIfCancelled();
 
+		// Applied to a copy, so the checkpointed mask stays zone-free
+		// and zone edits don't invalidate it.
 		modifyBinarizationMask(bw_mask, small_margins_rect, picture_zones);
 		if (dbg) {
 			dbg->add(bw_mask, "bw_mask with zones");
 		}
 	}
-	
-	if (render_params.normalizeIllumination()
-			&& !input.origImage().allGray()) {
-		assert(maybe_normalized.format() == QImage::Format_Indexed8);
-		QImage tmp(
-			transform(
-				input.origImage(), m_xform.transform(),
-				normalize_illumination_rect,
-				OutsidePixels::assumeColor(Qt::white)
-			)
-		);
-		
-		status.throwIfCancelled();
-		
-		adjustBrightnessGrayscale(tmp, maybe_normalized);
-		maybe_normalized = tmp;
-		if (dbg) {
-			dbg->add(maybe_normalized, "norm_illum_color");
-		}
-	}
-	
+
 	if (!render_params.mixedOutput()) {
 		// It's "Color / Grayscale" mode, as we handle B/W above.
 		reserveBlackAndWhite(maybe_normalized);
 	} else {
+		if (binarization_preview) {
+			fillBinarizationPreview(
+				*binarization_preview, maybe_smoothed,
+				normalize_illumination_rect,
+				normalize_illumination_crop_area, &bw_mask
+			);
+		}
+
 		BinaryImage bw_content(
 			binarize(maybe_smoothed, normalize_illumination_crop_area, &bw_mask)
 		);
@@ -875,13 +1397,24 @@ OutputGenerator::processWithDewarping(
 		) * m_xform.transformBack()
 	);
 
+	// A cached model makes tracing text lines unnecessary, so that
+	// adjusting depth perception only re-runs the dewarping itself.
+	bool dewarp_model_cached = false;
+	if (dewarping_mode == DewarpingMode::AUTO && !dbg) {
+		dewarp_model_cached = auto_dewarp_model_cache.lookup(
+			input.grayImage().cacheKey(), m_xform.transform(),
+			m_xform.resultingPreCropArea(), m_contentRect, m_dpi,
+			render_params.normalizeIllumination(), distortion_model
+		);
+	}
+
 	if (!render_params.normalizeIllumination()) {
 		if (color_original) {
 			normalized_original = convertToRGBorRGBA(input.origImage());
 		} else {
 			normalized_original = input.grayImage();
 		}
-		if (dewarping_mode == DewarpingMode::AUTO) {
+		if (dewarping_mode == DewarpingMode::AUTO && !dewarp_model_cached) {
 			warped_gray_output = transformToGray(
 				input.grayImage(), m_xform.transform(), normalize_illumination_rect,
 				OutsidePixels::assumeWeakColor(Qt::white)
@@ -979,7 +1512,7 @@ OutputGenerator::processWithDewarping(
 		status.throwIfCancelled();
 	}
 
-	if (dewarping_mode == DewarpingMode::AUTO) {
+	if (dewarping_mode == DewarpingMode::AUTO && !dewarp_model_cached) {
 		DistortionModelBuilder model_builder(Vec2d(0, 1));
 
 		QRect const content_rect(
@@ -994,11 +1527,18 @@ OutputGenerator::processWithDewarping(
 			input.grayImage(), model_builder.verticalBounds(),
 			model_builder, status, dbg
 		);
-		
+
 		distortion_model = model_builder.tryBuildModel(dbg, &input.grayImage().toQImage());
 		if (!distortion_model.isValid()) {
 			setupTrivialDistortionModel(distortion_model);
 		}
+		if (!dbg) {
+			auto_dewarp_model_cache.store(
+				input.grayImage().cacheKey(), m_xform.transform(),
+				m_xform.resultingPreCropArea(), m_contentRect, m_dpi,
+				render_params.normalizeIllumination(), distortion_model
+			);
+		}
 	}
 
 	warped_gray_output = GrayImage(); // Save memory.
@@ -1026,14 +1566,14 @@ OutputGenerator::processWithDewarping(
 	try {
 		dewarped = dewarp(
 			QTransform(), normalized_original, m_xform.transform(),
-			distortion_model, depth_perception, bg_color
+			distortion_model, depth_perception, bg_color, &status
 		);
 	} catch (std::runtime_error const&) {
 		// Probably an impossible distortion model.  Let's fall back to a trivial one.
 		setupTrivialDistortionModel(distortion_model);
 		dewarped = dewarp(
 			QTransform(), normalized_original, m_xform.transform(),
-			distortion_model, depth_perception, bg_color
+			distortion_model, depth_perception, bg_color, &status
 		);
 	}
 	normalized_original = QImage(); // Save memory.
@@ -1115,7 +1655,7 @@ OutputGenerator::processWithDewarping(
 			dewarp(
 				orig_to_small_margins, warped_bw_mask.toQImage(),
 				small_margins_to_output, distortion_model,
-				depth_perception, Qt::black
+				depth_perception, Qt::black, &status
 			)
 		);
 		if (dbg) {
@@ -1242,7 +1782,8 @@ QImage
 OutputGenerator::dewarp(
 	QTransform const& orig_to_src, QImage const& src,
 	QTransform const& src_to_output, DistortionModel const& distortion_model,
-	DepthPerception const& depth_perception, QColor const& bg_color) const
+	DepthPerception const& depth_perception, QColor const& bg_color,
+	TaskStatus const* status) const
 {
 	CylindricalSurfaceDewarper const dewarper(
 		createDewarper(distortion_model, orig_to_src, depth_perception.value())
@@ -1262,7 +1803,7 @@ OutputGenerator::dewarp(
 	}
 
 	return RasterDewarper::dewarp(
-		src, m_outRect.size(), dewarper, model_domain, bg_color
+		src, m_outRect.size(), dewarper, model_domain, bg_color, status
 	);
 }
 
@@ -1407,6 +1948,72 @@ OutputGenerator::detectPictures(
 	return holes_filled;
 }
 
+namespace
+{
+
+/**
+ * Applies savGolFilter() in horizontal bands to cap peak memory usage.
+ *
+ * savGolFilter() keeps a float intermediate of the whole image, which
+ * for a high-dpi page dwarfs the grayscale input and output.  Bands
+ * overlap by half a window, and only rows at least that far from a
+ * band boundary are kept, so every kept row sees its full vertical
+ * window and the output is identical to a whole-image pass.  Rows
+ * near the real image borders get the same border treatment either
+ * way.
+ *
+ * \p budget is the rough number of bytes of temporaries we are
+ * allowed, as configured with --tile-memory.
+ */
+QImage savGolFilterBanded(
+	QImage const& src, QSize const& window_size,
+	int const hor_degree, int const vert_degree, size_t const budget)
+{
+	int const width = src.width();
+	int const height = src.height();
+	int const halo = window_size.height() / 2;
+
+	// Per band row: a float intermediate plus the band's grayscale
+	// source and output copies.
+	int band_rows = int(budget / (size_t(width) * (sizeof(float) + 2)));
+	band_rows -= halo * 2;
+
+	if (band_rows >= height || band_rows < halo * 2 + 16) {
+		// Either the whole image fits in the budget, or the budget
+		// is too small to be meaningfully enforced.
+		return savGolFilter(src, window_size, hor_degree, vert_degree);
+	}
+
+	GrayImage const gray(src);
+	GrayImage dst(gray.size());
+
+	for (int y = 0; y < height; y += band_rows) {
+		int const band_top = std::max(0, y - halo);
+		int const band_bottom = std::min(height, y + band_rows + halo);
+		QImage const band(
+			gray.toQImage().copy(0, band_top, width, band_bottom - band_top)
+		);
+
+		GrayImage const filtered(
+			savGolFilter(band, window_size, hor_degree, vert_degree)
+		);
+
+		int const rows_kept = std::min(height, y + band_rows) - y;
+		uint8_t const* src_line = filtered.data()
+			+ (y - band_top) * filtered.stride();
+		uint8_t* dst_line = dst.data() + y * dst.stride();
+		for (int i = 0; i < rows_kept; ++i) {
+			memcpy(dst_line, src_line, width);
+			src_line += filtered.stride();
+			dst_line += dst.stride();
+		}
+	}
+
+	return dst;
+}
+
+} // anonymous namespace
+
 QImage
 OutputGenerator::smoothToGrayscale(QImage const& src, Dpi const& dpi)
 {
@@ -1426,6 +2033,14 @@ OutputGenerator::smoothToGrayscale(QImage const& src, Dpi const& dpi)
 		window = 11;
 		degree = 2;
 	}
+
+	size_t const budget = CommandLine::get().getTileMemoryLimit();
+	if (budget != 0) {
+		return savGolFilterBanded(
+			src, QSize(window, window), degree, degree, budget
+		);
+	}
+
 	return savGolFilter(src, QSize(window, window), degree, degree);
 }
 
@@ -1487,6 +2102,8 @@ BinaryImage
 OutputGenerator::binarize(QImage const& image,
 	QPolygonF const& crop_area, BinaryImage const* mask) const
 {
+	ProfileScope const profile_scope("binarize");
+
 	QPainterPath path;
 	path.addPolygon(crop_area);
 	
@@ -1501,11 +2118,56 @@ OutputGenerator::binarize(QImage const& image,
 		if (mask) {
 			rasterOp<RopAnd<RopSrc, RopDst> >(modified_mask, *mask);
 		}
-		
+
 		return binarize(image, modified_mask);
 	}
 }
 
+/**
+ * \brief Captures the inputs of the binarization step for later re-runs.
+ *
+ * The area and the threshold are constructed exactly the way
+ * binarize(QImage, QPolygonF, BinaryImage const*) would, except the
+ * area additionally gets restricted to the content rectangle, as that's
+ * the only part of the binarization result that reaches the output.
+ *
+ * \param preview The object to fill.
+ * \param gray_image The smoothed grayscale image binarization reads from.
+ * \param image_rect The rectangle corresponding to \p gray_image
+ *        in output image coordinates.
+ * \param crop_area The area (in \p gray_image coordinates) to binarize.
+ * \param mask An optional mask restricting binarization further,
+ *        in mixed mode.
+ */
+void
+OutputGenerator::fillBinarizationPreview(
+	BinarizationPreview& preview, QImage const& gray_image,
+	QRect const& image_rect, QPolygonF const& crop_area,
+	BinaryImage const* mask) const
+{
+	BinaryImage area(gray_image.size(), BLACK);
+	PolygonRasterizer::fillExcept(area, WHITE, crop_area, Qt::WindingFill);
+	area = erodeBrick(area, QSize(3, 3), WHITE);
+
+	if (mask) {
+		rasterOp<RopAnd<RopSrc, RopDst> >(area, *mask);
+	}
+
+	GrayscaleHistogram const hist(gray_image, area);
+	preview.baseThreshold = BinaryThreshold::otsuThreshold(hist);
+
+	area.fillExcept(
+		m_contentRect.translated(-image_rect.topLeft()).intersected(
+			QRect(QPoint(0, 0), gray_image.size())
+		),
+		WHITE
+	);
+
+	preview.grayImage = gray_image; // Implicitly shared.
+	preview.mask = area;
+	preview.rect = image_rect;
+}
+
 /**
  * \brief Remove small connected components that are considered to be garbage.
  *
@@ -1563,6 +2225,7 @@ OutputGenerator::maybeDespeckleInPlace(
 			default:;
 		}
 
+		ProfileScope const profile_scope("despeckle");
 		Despeckle::despeckleInPlace(image, dpi, lvl, status, dbg);
 
 		if (dbg) {
@@ -1667,49 +2330,36 @@ OutputGenerator::hitMissReplaceAllDirections(
 	imageproc::BinaryImage& img, char const* const pattern,
 	int const pattern_width, int const pattern_height)
 {
-	hitMissReplaceInPlace(img, WHITE, pattern, pattern_width, pattern_height);
-	
-	std::vector<char> pattern_data(pattern_width * pattern_height, ' ');
-	char* const new_pattern = &pattern_data[0];
-	
-	// Rotate 90 degrees clockwise.
+	std::vector<char> cw_data(pattern_width * pattern_height);
+	std::vector<char> upside_down_data(pattern_width * pattern_height);
+	std::vector<char> ccw_data(pattern_width * pattern_height);
+
 	char const* p = pattern;
-	int new_width = pattern_height;
-	int new_height = pattern_width;
-	for (int y = 0; y < pattern_height; ++y) {
-		for (int x = 0; x < pattern_width; ++x, ++p) {
-			int const new_x = pattern_height - 1 - y;
-			int const new_y = x;
-			new_pattern[new_y * new_width + new_x] = *p;
-		}
-	}
-	hitMissReplaceInPlace(img, WHITE, new_pattern, new_width, new_height);
-	
-	// Rotate upside down.
-	p = pattern;
-	new_width = pattern_width;
-	new_height = pattern_height;
-	for (int y = 0; y < pattern_height; ++y) {
-		for (int x = 0; x < pattern_width; ++x, ++p) {
-			int const new_x = pattern_width - 1 - x;
-			int const new_y = pattern_height - 1 - y;
-			new_pattern[new_y * new_width + new_x] = *p;
-		}
-	}
-	hitMissReplaceInPlace(img, WHITE, new_pattern, new_width, new_height);
-	
-	// Rotate 90 degrees counter-clockwise.
-	p = pattern;
-	new_width = pattern_height;
-	new_height = pattern_width;
 	for (int y = 0; y < pattern_height; ++y) {
 		for (int x = 0; x < pattern_width; ++x, ++p) {
-			int const new_x = y;
-			int const new_y = pattern_width - 1 - x;
-			new_pattern[new_y * new_width + new_x] = *p;
+			// Rotate 90 degrees clockwise.
+			cw_data[x * pattern_height + (pattern_height - 1 - y)] = *p;
+			// Rotate upside down.
+			upside_down_data[
+				(pattern_height - 1 - y) * pattern_width
+				+ (pattern_width - 1 - x)
+			] = *p;
+			// Rotate 90 degrees counter-clockwise.
+			ccw_data[(pattern_width - 1 - x) * pattern_height + y] = *p;
 		}
 	}
-	hitMissReplaceInPlace(img, WHITE, new_pattern, new_width, new_height);
+
+	// All four directions are matched against the same input and the
+	// replacements composited afterwards, which makes them independent
+	// of each other and allows matching them in parallel.
+	std::vector<HitMissPattern> patterns;
+	patterns.reserve(4);
+	patterns.push_back(HitMissPattern(pattern, pattern_width, pattern_height));
+	patterns.push_back(HitMissPattern(&cw_data[0], pattern_height, pattern_width));
+	patterns.push_back(HitMissPattern(&upside_down_data[0], pattern_width, pattern_height));
+	patterns.push_back(HitMissPattern(&ccw_data[0], pattern_height, pattern_width));
+
+	hitMissReplaceInPlace(img, WHITE, patterns);
 }
 
 QSize
@@ -1778,6 +2428,57 @@ OutputGenerator::calcDominantBackgroundGrayLevel(QImage const& img)
 	return 0;
 }
 
+namespace
+{
+
+struct FillZonePatch
+{
+	QPolygonF poly;
+	QColor color;
+	QRect boundingRect;
+};
+
+/**
+ * Merges rectangles until no two of them intersect.  The resulting
+ * rectangles cover at least the area covered by the original ones.
+ */
+void mergeIntersectingRects(std::vector<QRect>& rects)
+{
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (size_t i = 0; i < rects.size(); ++i) {
+			for (size_t j = i + 1; j < rects.size();) {
+				if (rects[i].intersects(rects[j])) {
+					rects[i] |= rects[j];
+					rects[j] = rects.back();
+					rects.pop_back();
+					merged = true;
+				} else {
+					++j;
+				}
+			}
+		}
+	}
+}
+
+void renderFillZonePatches(
+	QPainter& painter, std::vector<FillZonePatch> const& patches,
+	QRect const& clip_rect)
+{
+	painter.setRenderHint(QPainter::Antialiasing, true);
+	painter.setPen(Qt::NoPen);
+
+	BOOST_FOREACH(FillZonePatch const& patch, patches) {
+		if (clip_rect.intersects(patch.boundingRect)) {
+			painter.setBrush(patch.color);
+			painter.drawPolygon(patch.poly, Qt::WindingFill);
+		}
+	}
+}
+
+} // anonymous namespace
+
 void
 OutputGenerator::applyFillZonesInPlace(
 	QImage& img, ZoneSet const& zones,
@@ -1787,25 +2488,90 @@ OutputGenerator::applyFillZonesInPlace(
 		return;
 	}
 
-	QImage canvas(img.convertToFormat(QImage::Format_ARGB32_Premultiplied));
-	
-	{
-		QPainter painter(&canvas);
-		painter.setRenderHint(QPainter::Antialiasing, true);
-		painter.setPen(Qt::NoPen);
+	QRect const img_rect(img.rect());
 
-		BOOST_FOREACH(Zone const& zone, zones) {
-			QColor const color(zone.properties().locateOrDefault<FillColorProperty>()->color());
-			QPolygonF const poly(zone.spline().transformed(orig_to_output).toPolygon());
-			painter.setBrush(color);
-			painter.drawPolygon(poly, Qt::WindingFill);
+	std::vector<FillZonePatch> patches;
+	BOOST_FOREACH(Zone const& zone, zones) {
+		FillZonePatch patch;
+		patch.color = zone.properties().locateOrDefault<FillColorProperty>()->color();
+		patch.poly = zone.spline().transformed(orig_to_output).toPolygon();
+		// Antialiased rendering may touch pixels slightly outside
+		// of the polygon.
+		patch.boundingRect = patch.poly.boundingRect().toAlignedRect()
+			.adjusted(-2, -2, 2, 2).intersected(img_rect);
+		if (!patch.boundingRect.isEmpty()) {
+			patches.push_back(patch);
 		}
 	}
+	if (patches.empty()) {
+		return;
+	}
 
-	if (img.format() == QImage::Format_Indexed8 && img.isGrayscale()) {
-		img = toGrayscale(canvas);
-	} else {
-		img = canvas.convertToFormat(img.format());
+	// Group overlapping zones together, so that each group may be
+	// rendered through its own sub-image rather than a full-page one.
+	std::vector<QRect> clusters;
+	clusters.reserve(patches.size());
+	BOOST_FOREACH(FillZonePatch const& patch, patches) {
+		clusters.push_back(patch.boundingRect);
+	}
+	mergeIntersectingRects(clusters);
+
+	long long clustered_area = 0;
+	BOOST_FOREACH(QRect const& rect, clusters) {
+		clustered_area += (long long)rect.width() * rect.height();
+	}
+	long long const img_area = (long long)img_rect.width() * img_rect.height();
+
+	bool const gray_indexed = img.format() == QImage::Format_Indexed8
+		&& img.isGrayscale();
+	bool const byte_addressable = img.depth() >= 8
+		&& (img.format() != QImage::Format_Indexed8
+		|| (gray_indexed && img.colorTable() == createGrayscalePalette()));
+
+	if (!byte_addressable || clustered_area * 2 > img_area) {
+		// Either the zones cover most of the page, in which case the
+		// sub-image approach would only add overhead, or the pixel
+		// format doesn't allow direct scan line patching.
+		QImage canvas(img.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+
+		{
+			QPainter painter(&canvas);
+			renderFillZonePatches(painter, patches, img_rect);
+		}
+
+		if (gray_indexed) {
+			img = toGrayscale(canvas);
+		} else {
+			img = canvas.convertToFormat(img.format());
+		}
+		return;
+	}
+
+	BOOST_FOREACH(QRect const& rect, clusters) {
+		QImage canvas(
+			img.copy(rect).convertToFormat(QImage::Format_ARGB32_Premultiplied)
+		);
+
+		{
+			QPainter painter(&canvas);
+			painter.translate(-rect.topLeft());
+			renderFillZonePatches(painter, patches, rect);
+		}
+
+		QImage const patch_img(
+			gray_indexed ? toGrayscale(canvas)
+			: canvas.convertToFormat(img.format())
+		);
+
+		// Patch the affected scan lines back into the original image.
+		int const bytes_per_pixel = img.depth() >> 3;
+		int const bytes_per_line = rect.width() * bytes_per_pixel;
+		for (int y = 0; y < rect.height(); ++y) {
+			memcpy(
+				img.scanLine(rect.top() + y) + rect.left() * bytes_per_pixel,
+				patch_img.scanLine(y), bytes_per_line
+			);
+		}
 	}
 }
 
@@ -1822,6 +2588,31 @@ OutputGenerator::applyFillZonesInPlace(QImage& img, ZoneSet const& zones) const
 	);
 }
 
+void
+OutputGenerator::applyFillZonesToOutput(
+	QImage& img, ZoneSet const& zones,
+	DewarpingMode const dewarping_mode,
+	DistortionModel const& distortion_model,
+	DepthPerception const& depth_perception) const
+{
+	if (dewarping_mode == DewarpingMode::OFF) {
+		applyFillZonesInPlace(img, zones);
+		return;
+	}
+
+	// This reproduces the mapping processWithDewarping() renders
+	// fill zones with.
+	assert(distortion_model.isValid());
+	DewarpingPointMapper const mapper(
+		distortion_model, depth_perception.value(),
+		m_xform.transform(), m_contentRect
+	);
+	applyFillZonesInPlace(
+		img, zones,
+		boost::bind(&DewarpingPointMapper::mapToDewarpedSpace, &mapper, _1)
+	);
+}
+
 void
 OutputGenerator::applyFillZonesInPlace(
 	imageproc::BinaryImage& img, ZoneSet const& zones,
@@ -20,6 +20,7 @@
 #define OUTPUT_OUTPUTGENERATOR_H_
 
 #include "imageproc/Connectivity.h"
+#include "imageproc/BinaryImage.h"
 #include "Dpi.h"
 #include "ColorParams.h"
 #include "DepthPerception.h"
@@ -31,6 +32,7 @@
 #endif
 #include <QSize>
 #include <QRect>
+#include <QImage>
 #include <QTransform>
 #include <QColor>
 #include <QPointF>
@@ -66,12 +68,53 @@ namespace output
 class OutputGenerator
 {
 public:
+	/**
+	 * \param enable_checkpoint_cache Allows process() to reuse and
+	 *        refresh cached intermediate artifacts (the transformed
+	 *        image, the normalized grayscale version, the binarization
+	 *        mask), so re-renders that only change binarization or
+	 *        despeckling parameters skip the upstream work.  The cache
+	 *        holds full-page images for a single page, so it should
+	 *        only be enabled for interactive processing.
+	 */
 	OutputGenerator(
 		Dpi const& dpi, ColorParams const& color_params,
 		DespeckleLevel despeckle_level,
 		ImageTransformation const& xform,
-		QPolygonF const& content_rect_phys);
-	
+		QPolygonF const& content_rect_phys,
+		bool enable_checkpoint_cache = false);
+
+	/**
+	 * \brief Inputs for re-running binarization alone at a different threshold.
+	 *
+	 * Binarization is a global threshold - the Otsu level of the smoothed
+	 * grayscale image plus the user's adjustment.  Capturing that image,
+	 * the area binarization applies to and the unadjusted level therefore
+	 * gives a live preview everything it needs to re-binarize at any
+	 * adjustment, at whatever resolution it likes.  \see output::ImageView
+	 */
+	struct BinarizationPreview
+	{
+		/** The smoothed grayscale image binarization reads from. */
+		QImage grayImage;
+
+		/**
+		 * Same size as grayImage.  Black where binarization applies;
+		 * everywhere else the real output keeps its non-binary content.
+		 */
+		imageproc::BinaryImage mask;
+
+		/** Position of grayImage in output image coordinates. */
+		QRect rect;
+
+		/** The Otsu threshold level before the user's adjustment. */
+		int baseThreshold;
+
+		BinarizationPreview() : baseThreshold(0) {}
+
+		bool isNull() const { return grayImage.isNull(); }
+	};
+
 	/**
 	 * \brief Produce the output image.
 	 *
@@ -94,6 +137,10 @@ public:
 	 *        restored from the output and speckles images, allowing despeckling
 	 *        to be performed again with different settings, without going
 	 *        through the whole output generation process again.
+	 * \param binarization_preview If provided, the inputs of the
+	 *        binarization step will be written there, but only if
+	 *        binarization actually took place and dewarping was off.
+	 *        Otherwise, nothing will be written into the provided object.
 	 * \param dbg An optional sink for debugging images.
 	 */
 	QImage process(
@@ -104,6 +151,7 @@ public:
 		DepthPerception const& depth_perception,
 		imageproc::BinaryImage* auto_picture_mask = 0,
 		imageproc::BinaryImage* speckles_image = 0,
+		BinarizationPreview* binarization_preview = 0,
 		DebugImages* dbg = 0) const;
 	
 	QSize outputImageSize() const;
@@ -112,6 +160,22 @@ public:
 	 * \brief Returns the content rectangle in output image coordinates.
 	 */
 	QRect outputContentRect() const;
+
+	/**
+	 * \brief Renders fill zones over an already generated output image.
+	 *
+	 * Fill zones are the very last step of process(), so zones that
+	 * were added since an output image was produced may be painted
+	 * directly onto it, with a result identical to re-running the
+	 * whole pipeline.  The dewarping parameters must be the ones the
+	 * image was originally produced with; a dewarping mode other than
+	 * OFF requires a valid distortion model.
+	 */
+	void applyFillZonesToOutput(
+		QImage& img, ZoneSet const& zones,
+		DewarpingMode dewarping_mode,
+		dewarping::DistortionModel const& distortion_model,
+		DepthPerception const& depth_perception) const;
 private:
 	QImage processImpl(
 		TaskStatus const& status, FilterData const& input,
@@ -121,6 +185,7 @@ private:
 		DepthPerception const& depth_perception,
 		imageproc::BinaryImage* auto_picture_mask = 0,
 		imageproc::BinaryImage* speckles_image = 0,
+		BinarizationPreview* binarization_preview = 0,
 		DebugImages* dbg = 0) const;
 
 	QImage processAsIs(
@@ -134,6 +199,7 @@ private:
 		ZoneSet const& picture_zones, ZoneSet const& fill_zones,
 		imageproc::BinaryImage* auto_picture_mask = 0,
 		imageproc::BinaryImage* speckles_image = 0,
+		BinarizationPreview* binarization_preview = 0,
 		DebugImages* dbg = 0) const;
 
 	QImage processWithDewarping(
@@ -155,7 +221,8 @@ private:
 	QImage dewarp(
 		QTransform const& orig_to_src, QImage const& src,
 		QTransform const& src_to_output, dewarping::DistortionModel const& distortion_model,
-		DepthPerception const& depth_perception, QColor const& bg_color) const;
+		DepthPerception const& depth_perception, QColor const& bg_color,
+		TaskStatus const* status = 0) const;
 
 	static QSize from300dpi(QSize const& size, Dpi const& target_dpi);
 	
@@ -201,7 +268,12 @@ private:
 	imageproc::BinaryImage binarize(
 		QImage const& image, QPolygonF const& crop_area,
 		imageproc::BinaryImage const* mask = 0) const;
-	
+
+	void fillBinarizationPreview(
+		BinarizationPreview& preview, QImage const& gray_image,
+		QRect const& image_rect, QPolygonF const& crop_area,
+		imageproc::BinaryImage const* mask) const;
+
 	void maybeDespeckleInPlace(
 		imageproc::BinaryImage& image, QRect const& image_rect,
 		QRect const& mask_rect, DespeckleLevel level,
@@ -221,16 +293,6 @@ private:
 	
 	static unsigned char calcDominantBackgroundGrayLevel(QImage const& img);
 	
-	static QImage normalizeIllumination(QImage const& gray_input, DebugImages* dbg);
-
-	QImage transformAndNormalizeIllumination(
-		QImage const& gray_input, DebugImages* dbg,
-		QImage const* morph_background = 0) const;
-	
-	QImage transformAndNormalizeIllumination2(
-		QImage const& gray_input, DebugImages* dbg,
-		QImage const* morph_background = 0) const;
-
 	void applyFillZonesInPlace(QImage& img, ZoneSet const& zones,
 		boost::function<QPointF(QPointF const&)> const& orig_to_output) const;
 
@@ -261,6 +323,12 @@ private:
 	QRect m_contentRect;
 
 	DespeckleLevel m_despeckleLevel;
+
+	/**
+	 * Whether intermediate artifacts may be cached between runs.
+	 * See the constructor.
+	 */
+	bool m_checkpointCacheEnabled;
 };
 
 } // namespace output
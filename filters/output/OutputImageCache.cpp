@@ -0,0 +1,176 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "OutputImageCache.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <string.h>
+
+namespace output
+{
+
+namespace
+{
+
+/**
+ * Favor speed over ratio - even lightly compressed scans shrink
+ * several times, and this runs on the interactive path.
+ */
+int const COMPRESSION_LEVEL = 1;
+
+} // anonymous namespace
+
+OutputImageCache::OutputImageCache()
+:	m_cachedBytes(0),
+	m_memoryBudget(DEFAULT_MEMORY_BUDGET)
+{
+}
+
+OutputImageCache&
+OutputImageCache::instance()
+{
+	static OutputImageCache cache;
+	return cache;
+}
+
+QImage
+OutputImageCache::lookup(QString const& file_path, QFileInfo const& file_info)
+{
+	qint64 const file_size = file_info.size();
+	uint const file_mtime = file_info.lastModified().toTime_t();
+
+	Entry entry;
+
+	{
+		QMutexLocker const locker(&m_mutex);
+
+		std::list<Entry>::iterator it(m_entries.begin());
+		std::list<Entry>::iterator const end(m_entries.end());
+		for (; it != end; ++it) {
+			if (it->filePath == file_path) {
+				break;
+			}
+		}
+		if (it == end) {
+			return QImage();
+		}
+		if (it->fileSize != file_size || it->fileMTime != file_mtime) {
+			// The file was rewritten behind our back.
+			m_cachedBytes -= it->compressed.size();
+			m_entries.erase(it);
+			return QImage();
+		}
+
+		m_entries.splice(m_entries.begin(), m_entries, it);
+		entry = *it; // QByteArray is implicitly shared, so this is cheap.
+	}
+
+	// Decompression happens outside the mutex.
+	QByteArray const raw(qUncompress(entry.compressed));
+	if (raw.isEmpty() || raw.size() % entry.height != 0) {
+		return QImage();
+	}
+
+	QImage image(entry.width, entry.height, entry.format);
+	if (image.isNull()) {
+		return QImage();
+	}
+	if (!entry.colorTable.isEmpty()) {
+		image.setColorTable(entry.colorTable);
+	}
+
+	int const src_bpl = raw.size() / entry.height;
+	int const dst_bpl = image.bytesPerLine();
+	if (src_bpl > dst_bpl) {
+		return QImage();
+	}
+
+	char const* src_line = raw.data();
+	uchar* dst_line = image.bits();
+	for (int y = 0; y < entry.height; ++y) {
+		memcpy(dst_line, src_line, src_bpl);
+		src_line += src_bpl;
+		dst_line += dst_bpl;
+	}
+
+	return image;
+}
+
+void
+OutputImageCache::store(
+	QString const& file_path, QFileInfo const& file_info,
+	QImage const& image)
+{
+	if (image.isNull()) {
+		return;
+	}
+
+	Entry entry;
+	entry.filePath = file_path;
+	entry.fileSize = file_info.size();
+	entry.fileMTime = file_info.lastModified().toTime_t();
+	entry.width = image.width();
+	entry.height = image.height();
+	entry.format = image.format();
+	entry.colorTable = image.colorTable();
+
+	// Compression happens outside the mutex.
+	entry.compressed = qCompress(
+		image.bits(), image.bytesPerLine() * image.height(),
+		COMPRESSION_LEVEL
+	);
+	if (size_t(entry.compressed.size()) > m_memoryBudget) {
+		return;
+	}
+
+	QMutexLocker const locker(&m_mutex);
+
+	std::list<Entry>::iterator it(m_entries.begin());
+	std::list<Entry>::iterator const end(m_entries.end());
+	for (; it != end; ++it) {
+		if (it->filePath == file_path) {
+			m_cachedBytes -= it->compressed.size();
+			m_entries.erase(it);
+			break;
+		}
+	}
+
+	m_entries.push_front(entry);
+	m_cachedBytes += entry.compressed.size();
+	enforceBudget();
+}
+
+void
+OutputImageCache::setMemoryBudget(size_t const bytes)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_memoryBudget = bytes;
+	enforceBudget();
+}
+
+void
+OutputImageCache::enforceBudget()
+{
+	while (m_cachedBytes > m_memoryBudget && !m_entries.empty()) {
+		m_cachedBytes -= m_entries.back().compressed.size();
+		m_entries.pop_back();
+	}
+}
+
+} // namespace output
@@ -0,0 +1,102 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_OUTPUT_IMAGE_CACHE_H_
+#define OUTPUT_OUTPUT_IMAGE_CACHE_H_
+
+#include "NonCopyable.h"
+#include <QString>
+#include <QImage>
+#include <QMutex>
+#include <QVector>
+#include <QByteArray>
+#include <QRgb>
+#include <QtGlobal>
+#include <list>
+#include <stddef.h>
+
+class QFileInfo;
+
+namespace output
+{
+
+/**
+ * \brief A process-wide cache of recently produced output images.
+ *
+ * Flipping between neighboring pages in the output filter used to
+ * re-read each output file from disk every time.  This cache keeps
+ * the last few output images in memory, zlib-compressed (decompressing
+ * is far cheaper than re-reading and re-decoding a TIFF), within a
+ * fixed memory budget.  Entries are validated against the size and
+ * modification time of the file they were produced from, so anything
+ * that rewrites the file invalidates them naturally.
+ */
+class OutputImageCache
+{
+	DECLARE_NON_COPYABLE(OutputImageCache)
+public:
+	static OutputImageCache& instance();
+
+	/**
+	 * \brief Returns the cached image for this file, or a null image.
+	 *
+	 * \p file_info must refer to \p file_path and reflect the current
+	 * state of the file.
+	 */
+	QImage lookup(QString const& file_path, QFileInfo const& file_info);
+
+	/**
+	 * \brief Caches \p image as the contents of \p file_path.
+	 */
+	void store(
+		QString const& file_path, QFileInfo const& file_info,
+		QImage const& image);
+
+	/**
+	 * \brief Sets the total budget for compressed data, in bytes.
+	 */
+	void setMemoryBudget(size_t bytes);
+private:
+	struct Entry
+	{
+		QString filePath;
+		qint64 fileSize;
+		uint fileMTime;
+		int width;
+		int height;
+		QImage::Format format;
+		QVector<QRgb> colorTable;
+		QByteArray compressed;
+	};
+
+	enum { DEFAULT_MEMORY_BUDGET = 128 * 1024 * 1024 };
+
+	OutputImageCache();
+
+	/** Must be called with the mutex held. */
+	void enforceBudget();
+
+	QMutex m_mutex;
+	std::list<Entry> m_entries; /**< Most recently used first. */
+	size_t m_cachedBytes;
+	size_t m_memoryBudget;
+};
+
+} // namespace output
+
+#endif
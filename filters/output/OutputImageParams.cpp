@@ -17,6 +17,7 @@
 */
 
 #include "OutputImageParams.h"
+#include "AlgorithmVersions.h"
 #include "ImageTransformation.h"
 #include "XmlMarshaller.h"
 #include "XmlUnmarshaller.h"
@@ -29,6 +30,25 @@
 namespace output
 {
 
+namespace
+{
+
+/**
+ * Project files predating the algorithm version registry carry no
+ * version attributes.  Their artifacts were produced by the same code
+ * the registry started out describing, so missing attributes default
+ * to the current version rather than forcing a one-time regeneration
+ * of every page.
+ */
+int algoVersionAttr(QDomElement const& el, char const* name, int dflt)
+{
+	bool ok = false;
+	int const version = el.attribute(QString::fromLatin1(name)).toInt(&ok);
+	return ok ? version : dflt;
+}
+
+} // anonymous namespace
+
 OutputImageParams::OutputImageParams(
 	QSize const& out_image_size, QRect const& content_rect,
 	ImageTransformation xform,
@@ -37,7 +57,10 @@ OutputImageParams::OutputImageParams(
 	dewarping::DistortionModel const& distortion_model,
 	DepthPerception const& depth_perception,
 	DespeckleLevel const despeckle_level)
-:	m_size(out_image_size),
+:	m_renderingVersion(algo_versions::OUTPUT_RENDERING),
+	m_dewarpingVersion(algo_versions::DEWARPING),
+	m_despeckleVersion(algo_versions::DESPECKLE),
+	m_size(out_image_size),
 	m_contentRect(content_rect),
 	m_dpi(dpi),
 	m_colorParams(color_params),
@@ -52,7 +75,10 @@ OutputImageParams::OutputImageParams(
 }
 
 OutputImageParams::OutputImageParams(QDomElement const& el)
-:	m_size(XmlUnmarshaller::size(el.namedItem("size").toElement())),
+:	m_renderingVersion(algoVersionAttr(el, "renderingVersion", algo_versions::OUTPUT_RENDERING)),
+	m_dewarpingVersion(algoVersionAttr(el, "dewarpingVersion", algo_versions::DEWARPING)),
+	m_despeckleVersion(algoVersionAttr(el, "despeckleVersion", algo_versions::DESPECKLE)),
+	m_size(XmlUnmarshaller::size(el.namedItem("size").toElement())),
 	m_contentRect(XmlUnmarshaller::rect(el.namedItem("content-rect").toElement())),
 	m_partialXform(el.namedItem("partial-xform").toElement()),
 	m_dpi(XmlUnmarshaller::dpi(el.namedItem("dpi").toElement())),
@@ -79,13 +105,20 @@ OutputImageParams::toXml(QDomDocument& doc, QString const& name) const
 	el.setAttribute("depthPerception", m_depthPerception.toString());
 	el.setAttribute("dewarpingMode", m_dewarpingMode.toString());
 	el.setAttribute("despeckleLevel", despeckleLevelToString(m_despeckleLevel));
-	
+	el.setAttribute("renderingVersion", m_renderingVersion);
+	el.setAttribute("dewarpingVersion", m_dewarpingVersion);
+	el.setAttribute("despeckleVersion", m_despeckleVersion);
+
 	return el;
 }
 
 bool
 OutputImageParams::matches(OutputImageParams const& other) const
 {
+	if (m_renderingVersion != other.m_renderingVersion) {
+		return false;
+	}
+
 	if (m_size != other.m_size) {
 		return false;
 	}
@@ -110,6 +143,9 @@ OutputImageParams::matches(OutputImageParams const& other) const
 	if (m_dewarpingMode != other.m_dewarpingMode) {
 		return false;
 	} else if (m_dewarpingMode != DewarpingMode::OFF) {
+		if (m_dewarpingVersion != other.m_dewarpingVersion) {
+			return false;
+		}
 		if (!m_distortionModel.matches(other.m_distortionModel)) {
 			return false;
 		}
@@ -117,10 +153,25 @@ OutputImageParams::matches(OutputImageParams const& other) const
 			return false;
 		}
 	}
+
+	if (m_despeckleLevel != DESPECKLE_OFF || other.m_despeckleLevel != DESPECKLE_OFF) {
+		if (m_despeckleVersion != other.m_despeckleVersion) {
+			return false;
+		}
+	}
 	
 	return true;
 }
 
+bool
+OutputImageParams::matchesIgnoringDespeckleLevel(OutputImageParams const& other) const
+{
+	OutputImageParams adjusted(other);
+	adjusted.m_despeckleLevel = m_despeckleLevel;
+	adjusted.m_despeckleVersion = m_despeckleVersion;
+	return matches(adjusted);
+}
+
 bool
 OutputImageParams::colorParamsMatch(
 	ColorParams const& cp1, DespeckleLevel const dl1,
@@ -68,6 +68,24 @@ public:
 	 *        to avoid re-generating the output image.
 	 */
 	bool matches(OutputImageParams const& other) const;
+
+	/**
+	 * \brief Like matches(), but disregarding the despeckle level.
+	 *
+	 * Carving the despeckle level out of the all-or-nothing
+	 * comparison lets the output stage redo just the despeckling
+	 * from the stored output and speckles files rather than
+	 * re-generating the whole page.
+	 */
+	bool matchesIgnoringDespeckleLevel(OutputImageParams const& other) const;
+
+	/**
+	 * \brief Returns true if the two color parameter sets produce
+	 *        the same output, taking the color mode into account.
+	 */
+	static bool colorParamsMatch(
+		ColorParams const& cp1, DespeckleLevel dl1,
+		ColorParams const& cp2, DespeckleLevel dl2);
 private:
 	class PartialXform
 	{
@@ -89,11 +107,18 @@ private:
 		double m_21;
 		double m_22;
 	};
-	
-	static bool colorParamsMatch(
-		ColorParams const& cp1, DespeckleLevel dl1,
-		ColorParams const& cp2, DespeckleLevel dl2);
-	
+
+	/**
+	 * Algorithm versions (see AlgorithmVersions.h) the artifacts were
+	 * produced with.  A component's version only participates in
+	 * matches() when that component actually contributed to the
+	 * artifacts, so bumping the dewarping version doesn't invalidate
+	 * non-dewarped pages.
+	 */
+	int m_renderingVersion;
+	int m_dewarpingVersion;
+	int m_despeckleVersion;
+
 	/** Pixel size of the output image. */
 	QSize m_size;
 	
@@ -0,0 +1,136 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "OutputWriteQueue.h"
+#include <QMutexLocker>
+#include <QString>
+
+namespace output
+{
+
+OutputWriteQueue&
+OutputWriteQueue::instance()
+{
+	// The destructor will flush the queue and join the thread.
+	static OutputWriteQueue queue;
+	return queue;
+}
+
+OutputWriteQueue::OutputWriteQueue()
+:	m_threadStarted(false),
+	m_shuttingDown(false)
+{
+}
+
+OutputWriteQueue::~OutputWriteQueue()
+{
+	{
+		QMutexLocker const locker(&m_mutex);
+		m_shuttingDown = true;
+		m_stateChanged.wakeAll();
+	}
+	if (m_threadStarted) {
+		wait();
+	}
+}
+
+void
+OutputWriteQueue::enqueue(IntrusivePtr<Job> const& job)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	while (m_queue.size() >= MAX_QUEUED_JOBS && !m_shuttingDown) {
+		m_stateChanged.wait(&m_mutex);
+	}
+	if (m_shuttingDown) {
+		// Better to execute the job in the calling thread
+		// than to lose it.
+		m_mutex.unlock();
+		job->execute();
+		m_mutex.lock();
+		return;
+	}
+
+	m_queue.push_back(job);
+	m_stateChanged.wakeAll();
+
+	if (!m_threadStarted) {
+		start();
+		m_threadStarted = true;
+	}
+}
+
+void
+OutputWriteQueue::waitFor(QString const& file_path)
+{
+	QMutexLocker const locker(&m_mutex);
+	while (anyJobTouchesLocked(file_path)) {
+		m_stateChanged.wait(&m_mutex);
+	}
+}
+
+void
+OutputWriteQueue::run()
+{
+	QMutexLocker const locker(&m_mutex);
+
+	for (;;) {
+		if (m_queue.empty()) {
+			if (m_shuttingDown) {
+				break;
+			}
+			m_stateChanged.wait(&m_mutex);
+			continue;
+		}
+
+		m_ptrExecutingJob = m_queue.front();
+		m_queue.pop_front();
+		m_stateChanged.wakeAll();
+
+		m_mutex.unlock();
+		try {
+			m_ptrExecutingJob->execute();
+		} catch (...) {
+			// Keep the writer thread alive.  Failures are recorded
+			// by the job itself, in whatever form suits it.
+		}
+		m_mutex.lock();
+
+		m_ptrExecutingJob.reset(0);
+		m_stateChanged.wakeAll();
+	}
+}
+
+bool
+OutputWriteQueue::anyJobTouchesLocked(QString const& file_path) const
+{
+	if (m_ptrExecutingJob.get() && m_ptrExecutingJob->touches(file_path)) {
+		return true;
+	}
+
+	std::deque<IntrusivePtr<Job> >::const_iterator it(m_queue.begin());
+	std::deque<IntrusivePtr<Job> >::const_iterator const end(m_queue.end());
+	for (; it != end; ++it) {
+		if ((*it)->touches(file_path)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+} // namespace output
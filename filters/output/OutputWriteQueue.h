@@ -0,0 +1,103 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OUTPUT_OUTPUT_WRITE_QUEUE_H_
+#define OUTPUT_OUTPUT_WRITE_QUEUE_H_
+
+#include "NonCopyable.h"
+#include "RefCountable.h"
+#include "IntrusivePtr.h"
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <deque>
+
+class QString;
+
+namespace output
+{
+
+/**
+ * \brief A dedicated thread that writes finished output images to disk.
+ *
+ * Writing the output file and its companions used to happen on the
+ * thread that produced the images, leaving it idle for the duration of
+ * the disk writes.  Jobs enqueued here execute in order on a single
+ * writer thread, so the producer can move on to the next page
+ * immediately.  The queue is bounded, to limit the number of full-size
+ * images kept alive by pending jobs.
+ */
+class OutputWriteQueue : private QThread
+{
+	DECLARE_NON_COPYABLE(OutputWriteQueue)
+public:
+	/**
+	 * \brief A unit of work for the writer thread.
+	 *
+	 * execute() is called from the writer thread, so everything it
+	 * does must be safe to do from there.  Bookkeeping that depends
+	 * on the outcome of the writes belongs to the job as well.
+	 */
+	class Job : public RefCountable
+	{
+	public:
+		virtual void execute() = 0;
+
+		/** Tells if this job may write to \p file_path. */
+		virtual bool touches(QString const& file_path) const = 0;
+	};
+
+	static OutputWriteQueue& instance();
+
+	/**
+	 * \brief Adds a job to the queue.
+	 *
+	 * Blocks while the queue is full.
+	 */
+	void enqueue(IntrusivePtr<Job> const& job);
+
+	/**
+	 * \brief Waits until no queued or executing job touches \p file_path.
+	 *
+	 * To be called before reading or examining a file the queue may
+	 * still be writing to.
+	 */
+	void waitFor(QString const& file_path);
+protected:
+	virtual void run();
+private:
+	enum { MAX_QUEUED_JOBS = 2 };
+
+	OutputWriteQueue();
+
+	virtual ~OutputWriteQueue();
+
+	/** Must be called with the mutex held. */
+	bool anyJobTouchesLocked(QString const& file_path) const;
+
+	QMutex m_mutex;
+	QWaitCondition m_stateChanged;
+	std::deque<IntrusivePtr<Job> > m_queue;
+	IntrusivePtr<Job> m_ptrExecutingJob;
+	bool m_threadStarted;
+	bool m_shuttingDown;
+};
+
+} // namespace output
+
+#endif
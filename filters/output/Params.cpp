@@ -19,6 +19,7 @@
 #include "Params.h"
 #include "ColorGrayscaleOptions.h"
 #include "BlackWhiteOptions.h"
+#include "OutputImageParams.h"
 #include "XmlMarshaller.h"
 #include "XmlUnmarshaller.h"
 #include <QDomDocument>
@@ -54,6 +55,48 @@ Params::Params(QDomElement const& el)
 	);
 }
 
+bool
+Params::matches(Params const& other) const
+{
+	if (m_dpi != other.m_dpi) {
+		return false;
+	}
+
+	if (!OutputImageParams::colorParamsMatch(
+			m_colorParams, m_despeckleLevel,
+			other.m_colorParams, other.m_despeckleLevel)) {
+		return false;
+	}
+
+	if (m_dewarpingMode != other.m_dewarpingMode) {
+		return false;
+	} else if (m_dewarpingMode != DewarpingMode::OFF) {
+		if (!m_distortionModel.matches(other.m_distortionModel)) {
+			return false;
+		}
+		if (m_depthPerception.value() != other.m_depthPerception.value()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+Params::operator==(Params const& other) const
+{
+	return m_dpi == other.m_dpi
+		&& m_colorParams.colorMode() == other.m_colorParams.colorMode()
+		&& m_colorParams.colorGrayscaleOptions()
+			== other.m_colorParams.colorGrayscaleOptions()
+		&& m_colorParams.blackWhiteOptions()
+			== other.m_colorParams.blackWhiteOptions()
+		&& m_distortionModel == other.m_distortionModel
+		&& m_depthPerception.value() == other.m_depthPerception.value()
+		&& m_dewarpingMode == other.m_dewarpingMode
+		&& m_despeckleLevel == other.m_despeckleLevel;
+}
+
 QDomElement
 Params::toXml(QDomDocument& doc, QString const& name) const
 {
@@ -64,7 +64,27 @@ public:
 	DespeckleLevel despeckleLevel() const { return m_despeckleLevel; }
 
 	void setDespeckleLevel(DespeckleLevel level) { m_despeckleLevel = level; }
-	
+
+	/**
+	 * \brief Returns true if the two parameter sets produce the same
+	 *        output image.
+	 *
+	 * Follows the same logic as OutputImageParams::matches(): options
+	 * that are irrelevant in the current color mode are disregarded,
+	 * and so is the distortion model when dewarping is off.
+	 */
+	bool matches(Params const& other) const;
+
+	/**
+	 * \brief Exact field-by-field comparison.
+	 *
+	 * Unlike matches(), this one also considers options that don't
+	 * affect the output image in the current color mode but are
+	 * still serialized by toXml() and would resurface if the user
+	 * switched the mode back.
+	 */
+	bool operator==(Params const& other) const;
+
 	QDomElement toXml(QDomDocument& doc, QString const& name) const;
 private:
 	static ColorParams::ColorMode parseColorMode(QString const& str);
@@ -35,6 +35,7 @@
 #include "imageproc/Transform.h"
 #include "imageproc/Constants.h"
 #include "imageproc/GrayImage.h"
+#include "imageproc/ReduceThreshold.h"
 #include <QPointer>
 #include <QPainter>
 #include <QColor>
@@ -63,7 +64,7 @@ public:
 	MaskTransformTask(
 		PictureZoneEditor* zone_editor,
 		BinaryImage const& orig_mask, QTransform const& xform,
-		QSize const& target_size);
+		QSize const& target_size, bool coarse = false);
 
 	void cancel() { m_ptrResult->cancel(); }
 
@@ -74,7 +75,7 @@ private:
 	class Result : public AbstractCommand0<void>
 	{
 	public:
-		Result(PictureZoneEditor* zone_editor);
+		Result(PictureZoneEditor* zone_editor, bool exact);
 
 		void setData(QPoint const& origin, QImage const& mask);
 
@@ -87,6 +88,7 @@ private:
 		QPointer<PictureZoneEditor> m_ptrZoneEditor;
 		QPoint m_origin;
 		QImage m_mask;
+		bool m_exact;
 		mutable QAtomicInt m_cancelFlag;
 	};
 
@@ -94,6 +96,49 @@ private:
 	BinaryImage m_origMask;
 	QTransform m_xform;
 	QSize m_targetSize;
+	bool m_coarse;
+};
+
+
+class PictureZoneEditor::ZoneRasterTask :
+	public AbstractCommand0<IntrusivePtr<AbstractCommand0<void> > >
+{
+	DECLARE_NON_COPYABLE(ZoneRasterTask)
+public:
+	ZoneRasterTask(
+		PictureZoneEditor* zone_editor, QImage const& mask,
+		QPoint const& origin, QTransform const& xform,
+		ZoneSnapshot const& zones);
+
+	void cancel() { m_ptrResult->cancel(); }
+
+	bool isCancelled() const { return m_ptrResult->isCancelled(); }
+
+	virtual IntrusivePtr<AbstractCommand0<void> > operator()();
+private:
+	class Result : public AbstractCommand0<void>
+	{
+	public:
+		Result(PictureZoneEditor* zone_editor);
+
+		void setData(QImage const& mask);
+
+		void cancel() { m_cancelFlag.fetchAndStoreRelaxed(1); }
+
+		bool isCancelled() const { return m_cancelFlag.fetchAndAddRelaxed(0) != 0; }
+
+		virtual void operator()();
+	private:
+		QPointer<PictureZoneEditor> m_ptrZoneEditor;
+		QImage m_mask;
+		mutable QAtomicInt m_cancelFlag;
+	};
+
+	IntrusivePtr<Result> m_ptrResult;
+	QImage m_origMask;
+	QPoint m_origin;
+	QTransform m_xform;
+	ZoneSnapshot m_zones;
 };
 
 
@@ -143,6 +188,10 @@ PictureZoneEditor::PictureZoneEditor(
 	m_pictureMaskRebuildTimer.setSingleShot(true);
 	m_pictureMaskRebuildTimer.setInterval(150);
 
+	connect(&m_combinedMaskRebuildTimer, SIGNAL(timeout()), SLOT(initiateBuildingCombinedMask()));
+	m_combinedMaskRebuildTimer.setSingleShot(true);
+	m_combinedMaskRebuildTimer.setInterval(100);
+
 	BOOST_FOREACH(Zone const& zone, m_ptrSettings->pictureZonesForPage(page_id)) {
 		EditableSpline::Ptr spline(new EditableSpline(zone.spline()));
 		m_zones.addZone(spline, zone.properties());
@@ -163,20 +212,24 @@ PictureZoneEditor::onPaint(QPainter& painter, InteractionState const& interactio
 	if (!validateScreenPictureMask()) {
 		schedulePictureMaskRebuild();
 	} else {
+		if (!validateCombinedMask()) {
+			scheduleCombinedMaskRebuild();
+		}
+
 		double const sn = sin(constants::DEG2RAD * m_pictureMaskAnimationPhase);
 		double const scale = 0.5 * (sn + 1.0); // 0 .. 1
 		double const opacity = 0.35 * scale + 0.15;
 
-		QPixmap mask(m_screenPictureMask);
-
-		{
-			QPainter mask_painter(&mask);
-			mask_painter.translate(-m_screenPictureMaskOrigin);
-			paintOverPictureMask(mask_painter);
+		// While a zone is being dragged, the stale combined mask is
+		// shown.  The zone outline itself is drawn by the interaction
+		// handlers, so it still tracks the mouse.
+		QPixmap const* mask = &m_screenPictureMask;
+		if (!m_combinedMask.isNull() && m_combinedMaskXform == virtualToWidget()) {
+			mask = &m_combinedMask;
 		}
 
 		painter.setOpacity(opacity);
-		painter.drawPixmap(m_screenPictureMaskOrigin, mask);
+		painter.drawPixmap(m_screenPictureMaskOrigin, *mask);
 		painter.setOpacity(1.0);
 
 		if (!m_pictureMaskAnimateTimer.isActive()) {
@@ -207,6 +260,10 @@ PictureZoneEditor::schedulePictureMaskRebuild()
 			m_ptrMaskTransformTask->cancel();
 			m_ptrMaskTransformTask.reset();
 		}
+		if (m_ptrCoarseMaskTask.get()) {
+			m_ptrCoarseMaskTask->cancel();
+			m_ptrCoarseMaskTask.reset();
+		}
 		m_potentialPictureMaskXform = virtualToWidget();
 	}
 	m_pictureMaskRebuildTimer.start();
@@ -225,8 +282,29 @@ PictureZoneEditor::initiateBuildingScreenPictureMask()
 		m_ptrMaskTransformTask->cancel();
 		m_ptrMaskTransformTask.reset();
 	}
+	if (m_ptrCoarseMaskTask.get()) {
+		m_ptrCoarseMaskTask->cancel();
+		m_ptrCoarseMaskTask.reset();
+	}
 
 	QTransform const xform(virtualToWidget());
+
+	// On masks where the exact transform takes a noticeable time,
+	// an approximate overlay built from a 1/8 scale reduction goes
+	// first.  The executor runs the tasks in order, so the coarse
+	// version is always on screen before the exact one lands.
+	qint64 const mask_pixels = qint64(m_origPictureMask.width())
+		* m_origPictureMask.height();
+	if (mask_pixels >= qint64(2000) * 2000) {
+		IntrusivePtr<MaskTransformTask> const coarse_task(
+			new MaskTransformTask(
+				this, m_origPictureMask, xform, viewport()->size(), true
+			)
+		);
+		backgroundExecutor().enqueueTask(coarse_task);
+		m_ptrCoarseMaskTask = coarse_task;
+	}
+
 	IntrusivePtr<MaskTransformTask> const task(
 		new MaskTransformTask(this, m_origPictureMask, xform, viewport()->size())
 	);
@@ -239,70 +317,116 @@ PictureZoneEditor::initiateBuildingScreenPictureMask()
 }
 
 void
-PictureZoneEditor::screenPictureMaskBuilt(QPoint const& origin, QImage const& mask)
+PictureZoneEditor::screenPictureMaskBuilt(QPoint const& origin, QImage const& mask, bool const exact)
 {
+	if (!exact && !m_ptrMaskTransformTask.get()) {
+		// The exact version is already on screen.
+		m_ptrCoarseMaskTask.reset();
+		return;
+	}
+
 	m_screenPictureMask = QPixmap::fromImage(mask);
+	m_screenPictureMaskImage = mask;
 	m_screenPictureMaskOrigin = origin;
 	m_pictureMaskAnimationPhase = 270;
 
-	m_ptrMaskTransformTask.reset();
+	// The combined mask was built against the old picture mask.
+	m_combinedMask = QPixmap();
+
+	if (exact) {
+		m_ptrMaskTransformTask.reset();
+	} else {
+		m_ptrCoarseMaskTask.reset();
+	}
 	update();
 }
 
-void
-PictureZoneEditor::paintOverPictureMask(QPainter& painter)
+bool
+PictureZoneEditor::validateCombinedMask()
 {
-	painter.setRenderHint(QPainter::Antialiasing);
-	painter.setTransform(imageToVirtual() * virtualToWidget(), true);
-	painter.setPen(Qt::NoPen);
-	painter.setBrush(QColor(mask_color));
-
-#ifndef Q_WS_X11
-	// That's how it's supposed to be.
-	painter.setCompositionMode(QPainter::CompositionMode_Clear);
-#else
-	// QPainter::CompositionMode_Clear doesn't work for arbitrarily shaped
-	// objects on X11, as well as CompositionMode_Source with a transparent
-	// brush.  Fortunately, CompositionMode_DestinationOut with a non-transparent
-	// brush does actually work.
-	painter.setCompositionMode(QPainter::CompositionMode_DestinationOut);
-#endif
-
-	typedef PictureLayerProperty PLP;
+	return !m_combinedMask.isNull()
+		&& m_combinedMaskXform == virtualToWidget()
+		&& m_combinedMaskZones == zoneSnapshot();
+}
 
-	// First pass: ERASER1
-	BOOST_FOREACH(EditableZoneSet::Zone const& zone, m_zones) {
-		if (zone.properties()->locateOrDefault<PLP>()->layer() == PLP::ERASER1) {
-			painter.drawPolygon(zone.spline()->toPolygon(), Qt::WindingFill);
+void
+PictureZoneEditor::scheduleCombinedMaskRebuild()
+{
+	ZoneSnapshot snapshot(zoneSnapshot());
+	if (!m_combinedMaskRebuildTimer.isActive() ||
+			m_potentialCombinedMaskZones != snapshot ||
+			m_potentialCombinedMaskXform != virtualToWidget()) {
+		if (m_ptrZoneRasterTask.get()) {
+			m_ptrZoneRasterTask->cancel();
+			m_ptrZoneRasterTask.reset();
 		}
+		m_potentialCombinedMaskZones.swap(snapshot);
+		m_potentialCombinedMaskXform = virtualToWidget();
+
+		// This delay is what makes the rebuild debounced: every
+		// vertex move restarts it, so the rasterization only runs
+		// when dragging pauses.
+		m_combinedMaskRebuildTimer.start();
 	}
+}
 
-	painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+void
+PictureZoneEditor::initiateBuildingCombinedMask()
+{
+	if (!validateScreenPictureMask()) {
+		// Too early.  Once the screen picture mask is built,
+		// a combined mask rebuild will follow.
+		return;
+	}
+	if (validateCombinedMask()) {
+		return;
+	}
 
-	// Second pass: PAINTER2
-	BOOST_FOREACH (EditableZoneSet::Zone const& zone, m_zones) {
-		if (zone.properties()->locateOrDefault<PLP>()->layer() == PLP::PAINTER2) {
-			painter.drawPolygon(zone.spline()->toPolygon(), Qt::WindingFill);
-		}
+	if (m_ptrZoneRasterTask.get()) {
+		m_ptrZoneRasterTask->cancel();
+		m_ptrZoneRasterTask.reset();
 	}
 
-#ifndef Q_WS_X11
-	// That's how it's supposed to be.
-	painter.setCompositionMode(QPainter::CompositionMode_Clear);
-#else
-	// QPainter::CompositionMode_Clear doesn't work for arbitrarily shaped
-	// objects on X11, as well as CompositionMode_Source with a transparent
-	// brush.  Fortunately, CompositionMode_DestinationOut with a non-transparent
-	// brush does actually work.
-	painter.setCompositionMode(QPainter::CompositionMode_DestinationOut);
-#endif
+	ZoneSnapshot snapshot(zoneSnapshot());
+	IntrusivePtr<ZoneRasterTask> const task(
+		new ZoneRasterTask(
+			this, m_screenPictureMaskImage, m_screenPictureMaskOrigin,
+			imageToVirtual() * virtualToWidget(), snapshot
+		)
+	);
 
-	// Third pass: ERASER1
-	BOOST_FOREACH (EditableZoneSet::Zone const& zone, m_zones) {
-		if (zone.properties()->locateOrDefault<PLP>()->layer() == PLP::ERASER3) {
-			painter.drawPolygon(zone.spline()->toPolygon(), Qt::WindingFill);
-		}
+	backgroundExecutor().enqueueTask(task);
+
+	m_ptrZoneRasterTask = task;
+	m_combinedMaskZones.swap(snapshot);
+	m_combinedMaskXform = virtualToWidget();
+}
+
+void
+PictureZoneEditor::combinedMaskBuilt(QImage const& mask)
+{
+	m_combinedMask = QPixmap::fromImage(mask);
+	m_ptrZoneRasterTask.reset();
+	update();
+}
+
+PictureZoneEditor::ZoneSnapshot
+PictureZoneEditor::zoneSnapshot()
+{
+	typedef PictureLayerProperty PLP;
+
+	ZoneSnapshot snapshot;
+
+	BOOST_FOREACH(EditableZoneSet::Zone const& zone, m_zones) {
+		snapshot.push_back(
+			std::make_pair(
+				zone.spline()->toPolygon(),
+				int(zone.properties()->locateOrDefault<PLP>()->layer())
+			)
+		);
 	}
+
+	return snapshot;
 }
 
 void
@@ -354,11 +478,12 @@ PictureZoneEditor::updateRequested()
 PictureZoneEditor::MaskTransformTask::MaskTransformTask(
 	PictureZoneEditor* zone_editor,
 	BinaryImage const& mask, QTransform const& xform,
-	QSize const& target_size)
-:	m_ptrResult(new Result(zone_editor)),
+	QSize const& target_size, bool const coarse)
+:	m_ptrResult(new Result(zone_editor, !coarse)),
 	m_origMask(mask),
 	m_xform(xform),
-	m_targetSize(target_size)
+	m_targetSize(target_size),
+	m_coarse(coarse)
 {
 }
 
@@ -377,9 +502,20 @@ PictureZoneEditor::MaskTransformTask::operator()()
 		)
 	);
 
+	BinaryImage mask(m_origMask);
+	QTransform xform(m_xform);
+	if (m_coarse) {
+		// transformToGray() averages over the source footprint of
+		// each target pixel, so its cost is driven by the source
+		// size.  Feeding it a word-parallel 1/8 reduction makes the
+		// coarse pass cheap; the exact pass then replaces the result.
+		mask = ReduceThreshold(mask)(2)(2)(2);
+		xform = QTransform().scale(8.0, 8.0) * xform;
+	}
+
 	QImage gray_mask(
 		transformToGray(
-			m_origMask.toQImage(), m_xform, target_rect,
+			mask.toQImage(), xform, target_rect,
 			OutsidePixels::assumeWeakColor(Qt::black), QSizeF(0.0, 0.0)
 		)
 	);
@@ -397,8 +533,9 @@ PictureZoneEditor::MaskTransformTask::operator()()
 /*===================== MaskTransformTask::Result ===================*/
 
 PictureZoneEditor::MaskTransformTask::Result::Result(
-	PictureZoneEditor* zone_editor)
-:	m_ptrZoneEditor(zone_editor)
+	PictureZoneEditor* zone_editor, bool const exact)
+:	m_ptrZoneEditor(zone_editor),
+	m_exact(exact)
 {
 }
 
@@ -414,7 +551,101 @@ void
 PictureZoneEditor::MaskTransformTask::Result::operator()()
 {
 	if (m_ptrZoneEditor && !isCancelled()) {
-		m_ptrZoneEditor->screenPictureMaskBuilt(m_origin, m_mask);
+		m_ptrZoneEditor->screenPictureMaskBuilt(m_origin, m_mask, m_exact);
+	}
+}
+
+
+/*============================= ZoneRasterTask ===============================*/
+
+PictureZoneEditor::ZoneRasterTask::ZoneRasterTask(
+	PictureZoneEditor* zone_editor, QImage const& mask,
+	QPoint const& origin, QTransform const& xform,
+	ZoneSnapshot const& zones)
+:	m_ptrResult(new Result(zone_editor)),
+	m_origMask(mask),
+	m_origin(origin),
+	m_xform(xform),
+	m_zones(zones)
+{
+}
+
+IntrusivePtr<AbstractCommand0<void> >
+PictureZoneEditor::ZoneRasterTask::operator()()
+{
+	if (isCancelled()) {
+		return IntrusivePtr<AbstractCommand0<void> >();
+	}
+
+	typedef PictureLayerProperty PLP;
+	typedef std::pair<QPolygonF, int> ZonePolygon;
+
+	QImage mask(m_origMask);
+
+	{
+		QPainter painter(&mask);
+		painter.setRenderHint(QPainter::Antialiasing);
+		painter.setTransform(
+			m_xform * QTransform().translate(-m_origin.x(), -m_origin.y())
+		);
+		painter.setPen(Qt::NoPen);
+		painter.setBrush(QColor(mask_color));
+
+		// Unlike on X11 pixmaps, CompositionMode_Clear works fine
+		// on a QImage, whatever the platform.
+		painter.setCompositionMode(QPainter::CompositionMode_Clear);
+
+		// First pass: ERASER1
+		BOOST_FOREACH(ZonePolygon const& zone, m_zones) {
+			if (zone.second == PLP::ERASER1) {
+				painter.drawPolygon(zone.first, Qt::WindingFill);
+			}
+		}
+
+		painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+		// Second pass: PAINTER2
+		BOOST_FOREACH(ZonePolygon const& zone, m_zones) {
+			if (zone.second == PLP::PAINTER2) {
+				painter.drawPolygon(zone.first, Qt::WindingFill);
+			}
+		}
+
+		painter.setCompositionMode(QPainter::CompositionMode_Clear);
+
+		// Third pass: ERASER3
+		BOOST_FOREACH(ZonePolygon const& zone, m_zones) {
+			if (zone.second == PLP::ERASER3) {
+				painter.drawPolygon(zone.first, Qt::WindingFill);
+			}
+		}
+	}
+
+	m_ptrResult->setData(mask);
+
+	return m_ptrResult;
+}
+
+
+/*====================== ZoneRasterTask::Result ======================*/
+
+PictureZoneEditor::ZoneRasterTask::Result::Result(
+	PictureZoneEditor* zone_editor)
+:	m_ptrZoneEditor(zone_editor)
+{
+}
+
+void
+PictureZoneEditor::ZoneRasterTask::Result::setData(QImage const& mask)
+{
+	m_mask = mask;
+}
+
+void
+PictureZoneEditor::ZoneRasterTask::Result::operator()()
+{
+	if (m_ptrZoneEditor && !isCancelled()) {
+		m_ptrZoneEditor->combinedMaskBuilt(m_mask);
 	}
 }
 
@@ -36,6 +36,10 @@
 #include <QPoint>
 #include <QTimer>
 #include <QPixmap>
+#include <QImage>
+#include <QPolygonF>
+#include <vector>
+#include <utility>
 
 class ImageTransformation;
 class InteractionState;
@@ -68,19 +72,32 @@ private slots:
 
 	void initiateBuildingScreenPictureMask();
 
+	void initiateBuildingCombinedMask();
+
 	void commitZones();
 
 	void updateRequested();
 private:
 	class MaskTransformTask;
-	
+
+	class ZoneRasterTask;
+
+	/** Zone polygons in image coordinates, paired with their layers. */
+	typedef std::vector<std::pair<QPolygonF, int> > ZoneSnapshot;
+
 	bool validateScreenPictureMask() const;
 
 	void schedulePictureMaskRebuild();
 
-	void screenPictureMaskBuilt(QPoint const& origin, QImage const& mask);
+	void screenPictureMaskBuilt(QPoint const& origin, QImage const& mask, bool exact);
+
+	bool validateCombinedMask();
 
-	void paintOverPictureMask(QPainter& painter);
+	void scheduleCombinedMaskRebuild();
+
+	void combinedMaskBuilt(QImage const& mask);
+
+	ZoneSnapshot zoneSnapshot();
 
 	void showPropertiesDialog(EditableZoneSet::Zone const& zone);
 
@@ -94,6 +111,10 @@ private:
 
 	imageproc::BinaryImage m_origPictureMask;
 	QPixmap m_screenPictureMask;
+
+	/** Same as m_screenPictureMask, kept for compositing in workers. */
+	QImage m_screenPictureMaskImage;
+
 	QPoint m_screenPictureMaskOrigin;
 	QTransform m_screenPictureMaskXform;
 	QTransform m_potentialPictureMaskXform;
@@ -102,6 +123,26 @@ private:
 	int m_pictureMaskAnimationPhase; // degrees
 	IntrusivePtr<MaskTransformTask> m_ptrMaskTransformTask;
 
+	/**
+	 * Transforms a 1/8 scale reduction of the picture mask, giving
+	 * an approximate overlay almost immediately on big pages, while
+	 * m_ptrMaskTransformTask works on the exact one.
+	 */
+	IntrusivePtr<MaskTransformTask> m_ptrCoarseMaskTask;
+
+	/**
+	 * The screen picture mask with zones rasterized over it.
+	 * Rebuilt by a background task whenever a zone changes; until
+	 * the replacement arrives, the stale version keeps being shown.
+	 */
+	QPixmap m_combinedMask;
+	ZoneSnapshot m_combinedMaskZones;
+	QTransform m_combinedMaskXform;
+	ZoneSnapshot m_potentialCombinedMaskZones;
+	QTransform m_potentialCombinedMaskXform;
+	QTimer m_combinedMaskRebuildTimer;
+	IntrusivePtr<ZoneRasterTask> m_ptrZoneRasterTask;
+
 	PageId m_pageId;
 	IntrusivePtr<Settings> m_ptrSettings;
 };
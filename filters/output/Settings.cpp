@@ -17,6 +17,8 @@
 */
 
 #include "Settings.h"
+#include "AutosaveJournal.h"
+#include "ProjectDirtyTracker.h"
 #include "Params.h"
 #include "PictureLayerProperty.h"
 #include "FillColorProperty.h"
@@ -28,13 +30,29 @@
 #endif
 #include <Qt>
 #include <QColor>
+#include <QDomDocument>
 #include <QMutexLocker>
 
 namespace output
 {
 
+namespace
+{
+
+QString
+zonesToXml(ZoneSet const& zones)
+{
+	QDomDocument doc;
+	doc.appendChild(zones.toXml(doc, "zones"));
+	return doc.toString();
+}
+
+} // anonymous namespace
+
 Settings::Settings()
-:	m_defaultPictureZoneProps(initialPictureZoneProps()),
+:	m_pPictureZonePropFactory(0),
+	m_pFillZonePropFactory(0),
+	m_defaultPictureZoneProps(initialPictureZoneProps()),
 	m_defaultFillZoneProps(initialFillZoneProps())
 {
 }
@@ -54,6 +72,8 @@ Settings::clear()
 	m_perPageOutputParams.clear();
 	m_perPagePictureZones.clear();
 	m_perPageFillZones.clear();
+	m_perPageUnparsed.clear();
+	m_paramsInternTable.clear();
 }
 
 void
@@ -65,6 +85,7 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 	PerPageOutputParams new_output_params;
 	PerPageZones new_picture_zones;
 	PerPageZones new_fill_zones;
+	PerPageUnparsed new_unparsed;
 
 	BOOST_FOREACH(PerPageParams::value_type const& kv, m_perPageParams) {
 		RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
@@ -94,20 +115,157 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 		new_fill_zones.insert(PerPageZones::value_type(new_page_id, kv.second));
 	}
 
+	BOOST_FOREACH(PerPageUnparsed::value_type const& kv, m_perPageUnparsed) {
+		RelinkablePath const old_path(kv.first.imageId().filePath(), RelinkablePath::File);
+		PageId new_page_id(kv.first);
+		new_page_id.imageId().setFilePath(relinker.substitutionPathFor(old_path));
+		new_unparsed.insert(PerPageUnparsed::value_type(new_page_id, kv.second));
+	}
+
 	m_perPageParams.swap(new_params);
 	m_perPageOutputParams.swap(new_output_params);
 	m_perPagePictureZones.swap(new_picture_zones);
 	m_perPageFillZones.swap(new_fill_zones);
+	m_perPageUnparsed.swap(new_unparsed);
+}
+
+void
+Settings::setDeferredPageElement(
+	PageId const& page_id, QDomElement const& page_el,
+	PropertyFactory const& picture_zone_prop_factory,
+	PropertyFactory const& fill_zone_prop_factory)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	m_pPictureZonePropFactory = &picture_zone_prop_factory;
+	m_pFillZonePropFactory = &fill_zone_prop_factory;
+	Utils::mapSetValue(m_perPageUnparsed, page_id, page_el);
+
+	// Drop any previously materialized state for this page.
+	m_perPageParams.erase(page_id);
+	m_perPageOutputParams.erase(page_id);
+	m_perPagePictureZones.erase(page_id);
+	m_perPageFillZones.erase(page_id);
+}
+
+void
+Settings::materializeLocked(PageId const& page_id) const
+{
+	PerPageUnparsed::iterator const it(m_perPageUnparsed.find(page_id));
+	if (it == m_perPageUnparsed.end()) {
+		return;
+	}
+
+	QDomElement const el(it->second);
+	m_perPageUnparsed.erase(it);
+
+	// All access to the retained DOM handles happens under our mutex,
+	// which matters because QDom's reference counting isn't thread-safe.
+	ZoneSet const picture_zones(
+		el.namedItem("zones").toElement(), *m_pPictureZonePropFactory
+	);
+	if (!picture_zones.empty()) {
+		Utils::mapSetValue(m_perPagePictureZones, page_id, picture_zones);
+	}
+
+	ZoneSet const fill_zones(
+		el.namedItem("fill-zones").toElement(), *m_pFillZonePropFactory
+	);
+	if (!fill_zones.empty()) {
+		Utils::mapSetValue(m_perPageFillZones, page_id, fill_zones);
+	}
+
+	QDomElement const params_el(el.namedItem("params").toElement());
+	if (!params_el.isNull()) {
+		Utils::mapSetValue(
+			m_perPageParams, page_id, internParamsLocked(Params(params_el))
+		);
+	}
+
+	QDomElement const output_params_el(el.namedItem("output-params").toElement());
+	if (!output_params_el.isNull()) {
+		Utils::mapSetValue(m_perPageOutputParams, page_id, OutputParams(output_params_el));
+	}
+}
+
+IntrusivePtr<Settings::SharedParams>
+Settings::internParamsLocked(Params const& params) const
+{
+	if (params.dewarpingMode() != DewarpingMode::OFF
+			|| params.distortionModel().isValid()) {
+		// Distortion models are genuinely per-page, so searching
+		// the table for an exact duplicate would be a waste of time.
+		return IntrusivePtr<SharedParams>(new SharedParams(params));
+	}
+
+	std::vector<IntrusivePtr<SharedParams> >::iterator it(
+		m_paramsInternTable.begin()
+	);
+	while (it != m_paramsInternTable.end()) {
+		if ((*it)->refCount() == 1) {
+			// Only the table itself references this instance.
+			it = m_paramsInternTable.erase(it);
+			continue;
+		}
+		// Strict equality rather than Params::matches(): the latter
+		// ignores options irrelevant to the current color mode, but
+		// those are still serialized and must survive a save.
+		if ((*it)->params() == params) {
+			return *it;
+		}
+		++it;
+	}
+
+	IntrusivePtr<SharedParams> const shared(new SharedParams(params));
+	m_paramsInternTable.push_back(shared);
+
+	return shared;
+}
+
+void
+Settings::snapshotPage(PageId const& page_id, PageSnapshot& snapshot) const
+{
+	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
+
+	PerPageParams::const_iterator const params_it(m_perPageParams.find(page_id));
+	if (params_it != m_perPageParams.end()) {
+		snapshot.params = params_it->second->params();
+	} else {
+		snapshot.params = Params();
+	}
+
+	PerPageZones::const_iterator const pz_it(m_perPagePictureZones.find(page_id));
+	if (pz_it != m_perPagePictureZones.end()) {
+		snapshot.pictureZones = pz_it->second;
+	} else {
+		snapshot.pictureZones = ZoneSet();
+	}
+
+	PerPageZones::const_iterator const fz_it(m_perPageFillZones.find(page_id));
+	if (fz_it != m_perPageFillZones.end()) {
+		snapshot.fillZones = fz_it->second;
+	} else {
+		snapshot.fillZones = ZoneSet();
+	}
+
+	PerPageOutputParams::const_iterator const op_it(m_perPageOutputParams.find(page_id));
+	if (op_it != m_perPageOutputParams.end()) {
+		snapshot.outputParams.reset(new OutputParams(op_it->second));
+	} else {
+		snapshot.outputParams.reset();
+	}
 }
 
 Params
 Settings::getParams(PageId const& page_id) const
 {
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 	
 	PerPageParams::const_iterator const it(m_perPageParams.find(page_id));
 	if (it != m_perPageParams.end()) {
-		return it->second;
+		return it->second->params();
 	} else {
 		return Params();
 	}
@@ -116,97 +274,135 @@ Settings::getParams(PageId const& page_id) const
 void
 Settings::setParams(PageId const& page_id, Params const& params)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
-	Utils::mapSetValue(m_perPageParams, page_id, params);
+	materializeLocked(page_id);
+	Utils::mapSetValue(m_perPageParams, page_id, internParamsLocked(params));
 }
 
 void
 Settings::setColorParams(PageId const& page_id, ColorParams const& prms)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
 		Params params;
 		params.setColorParams(prms);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+		m_perPageParams.insert(
+			it, PerPageParams::value_type(page_id, internParamsLocked(params))
+		);
 	} else {
-		it->second.setColorParams(prms);
+		Params params(it->second->params());
+		params.setColorParams(prms);
+		it->second = internParamsLocked(params);
 	}
 }
 
 void
 Settings::setDpi(PageId const& page_id, Dpi const& dpi)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
 		Params params;
 		params.setOutputDpi(dpi);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+		m_perPageParams.insert(
+			it, PerPageParams::value_type(page_id, internParamsLocked(params))
+		);
 	} else {
-		it->second.setOutputDpi(dpi);
+		Params params(it->second->params());
+		params.setOutputDpi(dpi);
+		it->second = internParamsLocked(params);
 	}
 }
 
 void
 Settings::setDewarpingMode(PageId const& page_id, DewarpingMode const& mode)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
 		Params params;
 		params.setDewarpingMode(mode);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+		m_perPageParams.insert(
+			it, PerPageParams::value_type(page_id, internParamsLocked(params))
+		);
 	} else {
-		it->second.setDewarpingMode(mode);
+		Params params(it->second->params());
+		params.setDewarpingMode(mode);
+		it->second = internParamsLocked(params);
 	}
 }
 
 void
 Settings::setDistortionModel(PageId const& page_id, dewarping::DistortionModel const& model)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
 		Params params;
 		params.setDistortionModel(model);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+		m_perPageParams.insert(
+			it, PerPageParams::value_type(page_id, internParamsLocked(params))
+		);
 	} else {
-		it->second.setDistortionModel(model);
+		Params params(it->second->params());
+		params.setDistortionModel(model);
+		it->second = internParamsLocked(params);
 	}
 }
 
 void
 Settings::setDepthPerception(PageId const& page_id, DepthPerception const& depth_perception)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
 		Params params;
 		params.setDepthPerception(depth_perception);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+		m_perPageParams.insert(
+			it, PerPageParams::value_type(page_id, internParamsLocked(params))
+		);
 	} else {
-		it->second.setDepthPerception(depth_perception);
+		Params params(it->second->params());
+		params.setDepthPerception(depth_perception);
+		it->second = internParamsLocked(params);
 	}
 }
 
 void
 Settings::setDespeckleLevel(PageId const& page_id, DespeckleLevel level)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 
 	PerPageParams::iterator const it(m_perPageParams.lower_bound(page_id));
 	if (it == m_perPageParams.end() || m_perPageParams.key_comp()(page_id, it->first)) {
 		Params params;
 		params.setDespeckleLevel(level);
-		m_perPageParams.insert(it, PerPageParams::value_type(page_id, params));
+		m_perPageParams.insert(
+			it, PerPageParams::value_type(page_id, internParamsLocked(params))
+		);
 	} else {
-		it->second.setDespeckleLevel(level);
+		Params params(it->second->params());
+		params.setDespeckleLevel(level);
+		it->second = internParamsLocked(params);
 	}
 }
 
@@ -214,6 +410,7 @@ std::auto_ptr<OutputParams>
 Settings::getOutputParams(PageId const& page_id) const
 {
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 	
 	PerPageOutputParams::const_iterator const it(m_perPageOutputParams.find(page_id));
 	if (it != m_perPageOutputParams.end()) {
@@ -226,14 +423,18 @@ Settings::getOutputParams(PageId const& page_id) const
 void
 Settings::removeOutputParams(PageId const& page_id)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 	m_perPageOutputParams.erase(page_id);
 }
 
 void
 Settings::setOutputParams(PageId const& page_id, OutputParams const& params)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 	Utils::mapSetValue(m_perPageOutputParams, page_id, params);
 }
 
@@ -241,6 +442,7 @@ ZoneSet
 Settings::pictureZonesForPage(PageId const& page_id) const
 {
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 
 	PerPageZones::const_iterator const it(m_perPagePictureZones.find(page_id));
 	if (it != m_perPagePictureZones.end()) {
@@ -254,6 +456,7 @@ ZoneSet
 Settings::fillZonesForPage(PageId const& page_id) const
 {
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 
 	PerPageZones::const_iterator const it(m_perPageFillZones.find(page_id));
 	if (it != m_perPageFillZones.end()) {
@@ -266,14 +469,24 @@ Settings::fillZonesForPage(PageId const& page_id) const
 void
 Settings::setPictureZones(PageId const& page_id, ZoneSet const& zones)
 {
+	ProjectDirtyTracker::noteModified();
+	AutosaveJournal::appendZones(
+		page_id, AutosaveJournal::PICTURE_ZONES, zonesToXml(zones)
+	);
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 	Utils::mapSetValue(m_perPagePictureZones, page_id, zones);
 }
 
 void
 Settings::setFillZones(PageId const& page_id, ZoneSet const& zones)
 {
+	ProjectDirtyTracker::noteModified();
+	AutosaveJournal::appendZones(
+		page_id, AutosaveJournal::FILL_ZONES, zonesToXml(zones)
+	);
 	QMutexLocker const locker(&m_mutex);
+	materializeLocked(page_id);
 	Utils::mapSetValue(m_perPageFillZones, page_id, zones);
 }
 
@@ -294,6 +507,7 @@ Settings::defaultFillZoneProperties() const
 void
 Settings::setDefaultPictureZoneProperties(PropertySet const& props)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
 	m_defaultPictureZoneProps = props;
 }
@@ -301,6 +515,7 @@ Settings::setDefaultPictureZoneProperties(PropertySet const& props)
 void
 Settings::setDefaultFillZoneProperties(PropertySet const& props)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker const locker(&m_mutex);
 	m_defaultFillZoneProps = props;
 }
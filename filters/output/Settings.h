@@ -21,6 +21,7 @@
 
 #include "RefCountable.h"
 #include "NonCopyable.h"
+#include "IntrusivePtr.h"
 #include "PageId.h"
 #include "Dpi.h"
 #include "ColorParams.h"
@@ -28,19 +29,21 @@
 #include "DewarpingMode.h"
 #include "dewarping/DistortionModel.h"
 #include "DespeckleLevel.h"
+#include "Params.h"
 #include "ZoneSet.h"
 #include "PropertySet.h"
 #include <QMutex>
+#include <QDomElement>
 #include <map>
 #include <memory>
+#include <vector>
 
 class AbstractRelinker;
+class PropertyFactory;
 
 namespace output
 {
 
-class Params;
-
 class Settings : public RefCountable
 {
 	DECLARE_NON_COPYABLE(Settings)
@@ -52,9 +55,42 @@ public:
 	void clear();
 
 	void performRelinking(AbstractRelinker const& relinker);
-	
+
+	/**
+	 * \brief Stores a not-yet-parsed \<page\> project element.
+	 *
+	 * Its params, output params and zones will be materialized when
+	 * this page is first accessed, so opening a project only pays for
+	 * the pages that actually get touched.  The factories must outlive
+	 * this object.
+	 */
+	void setDeferredPageElement(
+		PageId const& page_id, QDomElement const& page_el,
+		PropertyFactory const& picture_zone_prop_factory,
+		PropertyFactory const& fill_zone_prop_factory);
+
+	/**
+	 * \brief Everything a batch worker reads about one page.
+	 *
+	 * Captured by snapshotPage() under a single lock acquisition,
+	 * after which the worker operates on its private copy without
+	 * ever touching the mutex again.  The GUI keeps mutating the
+	 * shared state; changes made after the snapshot was taken are
+	 * picked up by the next processing round, just like they were
+	 * when workers performed these reads one by one.
+	 */
+	struct PageSnapshot
+	{
+		Params params;
+		ZoneSet pictureZones;
+		ZoneSet fillZones;
+		std::auto_ptr<OutputParams> outputParams; /**< Null if never processed. */
+	};
+
+	void snapshotPage(PageId const& page_id, PageSnapshot& snapshot) const;
+
 	Params getParams(PageId const& page_id) const;
-	
+
 	void setParams(PageId const& page_id, Params const& params);
 
 	void setColorParams(PageId const& page_id, ColorParams const& prms);
@@ -95,19 +131,58 @@ public:
 
 	void setDefaultFillZoneProperties(PropertySet const& props);
 private:
-	typedef std::map<PageId, Params> PerPageParams;
+	/**
+	 * \brief An immutable Params instance shared between pages.
+	 *
+	 * Typical projects configure thousands of pages identically, so
+	 * per-page values are interned: pages with matching settings all
+	 * reference one instance.  Modifying a page points it at another
+	 * instance rather than mutating a shared one.
+	 */
+	class SharedParams : public RefCountable
+	{
+	public:
+		SharedParams(Params const& params) : m_params(params) {}
+
+		Params const& params() const { return m_params; }
+	private:
+		Params m_params;
+	};
+
+	typedef std::map<PageId, IntrusivePtr<SharedParams> > PerPageParams;
 	typedef std::map<PageId, OutputParams> PerPageOutputParams;
 	typedef std::map<PageId, ZoneSet> PerPageZones;
-	
+	typedef std::map<PageId, QDomElement> PerPageUnparsed;
+
 	static PropertySet initialPictureZoneProps();
 
 	static PropertySet initialFillZoneProps();
 
+	/**
+	 * Parses the deferred \<page\> element for \p page_id, if there is
+	 * one.  To be called with the mutex held, before any access to the
+	 * per-page maps.
+	 */
+	void materializeLocked(PageId const& page_id) const;
+
+	/**
+	 * Returns a shared instance matching \p params, adding one to the
+	 * intern table if necessary.  Entries no page references anymore
+	 * are pruned along the way, so the table stays as small as the
+	 * number of distinct configurations in use.  To be called with
+	 * the mutex held.
+	 */
+	IntrusivePtr<SharedParams> internParamsLocked(Params const& params) const;
+
 	mutable QMutex m_mutex;
-	PerPageParams m_perPageParams;
-	PerPageOutputParams m_perPageOutputParams;
-	PerPageZones m_perPagePictureZones;
-	PerPageZones m_perPageFillZones;
+	mutable PerPageParams m_perPageParams;
+	mutable PerPageOutputParams m_perPageOutputParams;
+	mutable PerPageZones m_perPagePictureZones;
+	mutable PerPageZones m_perPageFillZones;
+	mutable PerPageUnparsed m_perPageUnparsed;
+	mutable std::vector<IntrusivePtr<SharedParams> > m_paramsInternTable;
+	PropertyFactory const* m_pPictureZonePropFactory;
+	PropertyFactory const* m_pFillZonePropFactory;
 	PropertySet m_defaultPictureZoneProps;
 	PropertySet m_defaultFillZoneProps;
 };
@@ -23,6 +23,7 @@
 #include "Settings.h"
 #include "ColorParams.h"
 #include "OutputParams.h"
+#include "OutputImageCache.h"
 #include "OutputImageParams.h"
 #include "OutputFileParams.h"
 #include "RenderParams.h"
@@ -37,6 +38,7 @@
 #include "FillZoneComparator.h"
 #include "FillZoneEditor.h"
 #include "DespeckleState.h"
+#include "Despeckle.h"
 #include "DespeckleView.h"
 #include "DespeckleVisualization.h"
 #include "DespeckleLevel.h"
@@ -53,10 +55,18 @@
 #include "ThumbnailPixmapCache.h"
 #include "DebugImages.h"
 #include "OutputGenerator.h"
-#include "TiffWriter.h"
+#include "OutputWriteQueue.h"
+#include "PdfExporter.h"
+#include "SharedMemoryPublisher.h"
+#include "OutputEncoder.h"
+#include "ImageDumpFile.h"
 #include "ImageLoader.h"
 #include "ErrorWidget.h"
 #include "imageproc/BinaryImage.h"
+#include "imageproc/BinaryThreshold.h"
+#include "imageproc/RasterOp.h"
+#include "imageproc/GrayImage.h"
+#include "imageproc/Scale.h"
 #include "imageproc/PolygonUtils.h"
 #ifndef Q_MOC_RUN
 #include <boost/bind.hpp>
@@ -96,10 +106,11 @@ public:
 		BinaryImage const& picture_mask,
 		DespeckleState const& despeckle_state,
 		DespeckleVisualization const& despeckle_visualization,
+		OutputGenerator::BinarizationPreview const& binarization_preview,
 		bool batch, bool debug);
-	
+
 	virtual void updateUI(FilterUiInterface* ui);
-	
+
 	virtual IntrusivePtr<AbstractFilter> filter() { return m_ptrFilter; }
 private:
 	IntrusivePtr<Filter> m_ptrFilter;
@@ -116,12 +127,65 @@ private:
 	BinaryImage m_pictureMask;
 	DespeckleState m_despeckleState;
 	DespeckleVisualization m_despeckleVisualization;
+	OutputGenerator::BinarizationPreview m_binarizationPreview;
 	DespeckleLevel m_despeckleLevel;
 	bool m_batchProcessing;
 	bool m_debug;
 };
 
 
+class Task::WriteJob : public OutputWriteQueue::Job
+{
+public:
+	WriteJob(IntrusivePtr<Settings> const& settings,
+		IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
+		PageId const& page_id,
+		OutputImageParams const& output_image_params,
+		ZoneSet const& picture_zones,
+		ZoneSet const& fill_zones,
+		QString const& out_file_path,
+		QImage const& out_img,
+		QString const& automask_dir,
+		QString const& automask_file_path,
+		QImage const& automask_img,
+		QString const& speckles_dir,
+		QString const& speckles_file_path,
+		QImage const& speckles_img,
+		QStringList const& files_to_delete,
+		bool batch,
+		OutputFileParams const& kept_automask_file_params = OutputFileParams(),
+		OutputFileParams const& kept_speckles_file_params = OutputFileParams());
+
+	virtual void execute();
+
+	virtual bool touches(QString const& file_path) const;
+private:
+	IntrusivePtr<Settings> m_ptrSettings;
+	IntrusivePtr<ThumbnailPixmapCache> m_ptrThumbnailCache;
+	PageId m_pageId;
+	OutputImageParams m_outputImageParams;
+	ZoneSet m_pictureZones;
+	ZoneSet m_fillZones;
+	QString m_outFilePath;
+	QImage m_outImg;
+	QString m_automaskDir;
+	QString m_automaskFilePath;
+	QImage m_automaskImg; /**< Null unless an automask is to be written. */
+	QString m_specklesDir;
+	QString m_specklesFilePath;
+	QImage m_specklesImg; /**< Null unless a speckles file is to be written. */
+	QStringList m_filesToDelete;
+	bool m_batchProcessing;
+
+	/**
+	 * Recorded in place of the written file's params when the
+	 * corresponding image is null but the file on disk stays valid.
+	 */
+	OutputFileParams m_keptAutomaskFileParams;
+	OutputFileParams m_keptSpecklesFileParams;
+};
+
+
 Task::Task(IntrusivePtr<Filter> const& filter,
 	IntrusivePtr<Settings> const& settings,
 	IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
@@ -152,9 +216,20 @@ Task::process(
 {
 	status.throwIfCancelled();
 
-	Params params(m_ptrSettings->getParams(m_pageId));
+	// A single lock acquisition captures everything this task reads
+	// from the settings, so workers don't keep bouncing on the mutex
+	// the GUI thread uses for its edits.
+	Settings::PageSnapshot snapshot;
+	m_ptrSettings->snapshotPage(m_pageId, snapshot);
+
+	Params params(snapshot.params);
 	RenderParams const render_params(params.colorParams());
 	QString const out_file_path(m_outFileNameGen.filePathFor(m_pageId));
+
+	// An earlier version of our output files may still be on its way
+	// to disk.  Wait for it before examining or reading them back.
+	OutputWriteQueue::instance().waitFor(out_file_path);
+
 	QFileInfo const out_file_info(out_file_path);
 
 	ImageTransformation new_xform(data.xform());
@@ -176,9 +251,12 @@ Task::process(
 	bool const need_speckles_image = params.despeckleLevel() != DESPECKLE_OFF
 		&& params.colorParams().colorMode() != ColorParams::COLOR_GRAYSCALE && !m_batchProcessing;
 	
+	// Interactive sessions keep checkpoint artifacts between runs,
+	// so tuning the threshold or the despeckle level only re-executes
+	// the steps downstream of binarization.
 	OutputGenerator const generator(
 		params.outputDpi(), params.colorParams(), params.despeckleLevel(),
-		new_xform, content_rect_phys
+		new_xform, content_rect_phys, !m_batchProcessing
 	);
 	
 	OutputImageParams new_output_image_params(
@@ -188,99 +266,369 @@ Task::process(
 		params.depthPerception(), params.despeckleLevel() 
 	);
 
-	ZoneSet const new_picture_zones(m_ptrSettings->pictureZonesForPage(m_pageId));
-	ZoneSet const new_fill_zones(m_ptrSettings->fillZonesForPage(m_pageId));
+	ZoneSet const new_picture_zones(snapshot.pictureZones);
+	ZoneSet const new_fill_zones(snapshot.fillZones);
 	
 	bool need_reprocess = false;
+
+	// Set when the only thing that changed is the despeckle level
+	// and the stored artifacts allow re-doing just the despeckling.
+	bool redespeckle_only = false;
+	DespeckleLevel stored_despeckle_level = DESPECKLE_OFF;
+
+	// Set when the only thing that changed is fill zones being added,
+	// which makes it possible to paint just the new zones over the
+	// stored output image instead of re-generating the page.
+	bool fill_zones_patch = false;
+	ZoneSet added_fill_zones;
+	OutputFileParams kept_automask_file_params;
+	OutputFileParams kept_speckles_file_params;
+
 	do { // Just to be able to break from it.
-		
-		std::auto_ptr<OutputParams> stored_output_params(
-			m_ptrSettings->getOutputParams(m_pageId)
-		);
-		
+
+		std::auto_ptr<OutputParams> stored_output_params(snapshot.outputParams);
+
 		if (!stored_output_params.get()) {
 			need_reprocess = true;
 			break;
 		}
-		
+
 		if (!stored_output_params->outputImageParams().matches(new_output_image_params)) {
 			need_reprocess = true;
-			break;
+
+			// Don't break out just yet: if only the despeckle level
+			// changed, the checks below decide whether the stored
+			// artifacts are intact enough for the despeckle-only path.
+			redespeckle_only = !render_params.mixedOutput()
+				&& stored_output_params->outputImageParams()
+					.matchesIgnoringDespeckleLevel(new_output_image_params);
+			if (!redespeckle_only) {
+				break;
+			}
+			stored_despeckle_level =
+				stored_output_params->outputImageParams().despeckleLevel();
+
+			// Re-doing the despeckling starts from the stored speckles
+			// file, unless despeckling was off and nothing was removed.
+			if (stored_despeckle_level != DESPECKLE_OFF) {
+				redespeckle_only = speckles_file_info.exists()
+					&& stored_output_params->specklesFileParams().matches(
+						OutputFileParams(speckles_file_info));
+				if (!redespeckle_only) {
+					break;
+				}
+			}
+
+			// Fill zones will have to be re-painted over the
+			// re-despeckled image, which requires reproducing the
+			// mapping they were originally rendered with.
+			if (!new_fill_zones.empty()
+					&& params.dewarpingMode() != DewarpingMode::OFF
+					&& !params.distortionModel().isValid()) {
+				redespeckle_only = false;
+				break;
+			}
 		}
 
 		if (!PictureZoneComparator::equal(stored_output_params->pictureZones(), new_picture_zones)) {
 			need_reprocess = true;
+			redespeckle_only = false;
 			break;
 		}
 
 		if (!FillZoneComparator::equal(stored_output_params->fillZones(), new_fill_zones)) {
 			need_reprocess = true;
-			break;
+
+			// Fill zones are the very last step of output generation,
+			// so zones merely added since the last run can be painted
+			// over the stored output image, provided that image is
+			// intact (checked below).  Zones removed or edited require
+			// re-generating the page, as the original pixels under
+			// them are gone from the output file.
+			fill_zones_patch = !redespeckle_only
+				&& FillZoneComparator::addedZones(
+					stored_output_params->fillZones(), new_fill_zones,
+					added_fill_zones
+				);
+			if (params.dewarpingMode() != DewarpingMode::OFF
+					&& !params.distortionModel().isValid()) {
+				// Can't reproduce the mapping the original zones
+				// were rendered with.
+				fill_zones_patch = false;
+			}
+			redespeckle_only = false;
+			if (!fill_zones_patch) {
+				break;
+			}
+			kept_automask_file_params = stored_output_params->automaskFileParams();
+			kept_speckles_file_params = stored_output_params->specklesFileParams();
 		}
-		
+
 		if (!out_file_info.exists()) {
 			need_reprocess = true;
+			redespeckle_only = false;
+			fill_zones_patch = false;
 			break;
 		}
-		
+
 		if (!stored_output_params->outputFileParams().matches(OutputFileParams(out_file_info))) {
 			need_reprocess = true;
+			redespeckle_only = false;
+			fill_zones_patch = false;
 			break;
 		}
 
 		if (need_picture_editor) {
 			if (!automask_file_info.exists()) {
 				need_reprocess = true;
+				redespeckle_only = false;
+				fill_zones_patch = false;
 				break;
 			}
 
 			if (!stored_output_params->automaskFileParams().matches(OutputFileParams(automask_file_info))) {
 				need_reprocess = true;
+				redespeckle_only = false;
+				fill_zones_patch = false;
 				break;
 			}
 		}
 
-		if (need_speckles_image) {
+		if (need_speckles_image && !redespeckle_only) {
 			if (!speckles_file_info.exists()) {
 				need_reprocess = true;
+				fill_zones_patch = false;
 				break;
 			}
 			if (!stored_output_params->specklesFileParams().matches(OutputFileParams(speckles_file_info))) {
 				need_reprocess = true;
+				fill_zones_patch = false;
 				break;
 			}
 		}
-	
+
 	} while (false);
 	
 	QImage out_img;
 	BinaryImage automask_img;
 	BinaryImage speckles_img;
-	
+	OutputGenerator::BinarizationPreview binarization_preview;
+
 	if (!need_reprocess) {
-		QFile out_file(out_file_path);
-		if (out_file.open(QIODevice::ReadOnly)) {
-			out_img = ImageLoader::load(out_file, 0);
+		if (!m_batchProcessing) {
+			out_img = OutputImageCache::instance().lookup(
+				out_file_path, out_file_info
+			);
+		}
+		if (out_img.isNull()) {
+			QFile out_file(out_file_path);
+			if (out_file.open(QIODevice::ReadOnly)) {
+				out_img = ImageLoader::load(out_file, 0);
+			}
+			if (!out_img.isNull() && !m_batchProcessing) {
+				OutputImageCache::instance().store(
+					out_file_path, out_file_info, out_img
+				);
+			}
 		}
 		need_reprocess = out_img.isNull();
 
 		if (need_picture_editor && !need_reprocess) {
-			QFile automask_file(automask_file_path);
-			if (automask_file.open(QIODevice::ReadOnly)) {
-				automask_img = BinaryImage(ImageLoader::load(automask_file, 0));
+			automask_img = BinaryImage(ImageDumpFile::read(automask_file_path));
+			if (automask_img.isNull()) {
+				// Possibly a TIFF automask left by an older version.
+				automask_img = BinaryImage(ImageLoader::load(automask_file_path, 0));
 			}
 			need_reprocess = automask_img.isNull() || automask_img.size() != out_img.size();
 		}
 
 		if (need_speckles_image && !need_reprocess) {
-			QFile speckles_file(speckles_file_path);
-			if (speckles_file.open(QIODevice::ReadOnly)) {
-				speckles_img = BinaryImage(ImageLoader::load(speckles_file, 0));
+			speckles_img = BinaryImage(ImageDumpFile::read(speckles_file_path));
+			if (speckles_img.isNull()) {
+				// Possibly a TIFF speckles file left by an older version.
+				speckles_img = BinaryImage(ImageLoader::load(speckles_file_path, 0));
 			}
 			need_reprocess = speckles_img.isNull();
 		}
 	}
 
+	if (need_reprocess && fill_zones_patch) {
+		// The only change since the last run is fill zones that were
+		// added.  Fill zones are the very last step of output
+		// generation, so painting just the new zones over the stored
+		// output image produces exactly what a full re-run would,
+		// without the full re-run.
+		status.throwIfCancelled();
+
+		if (!m_batchProcessing) {
+			out_img = OutputImageCache::instance().lookup(
+				out_file_path, out_file_info
+			);
+		}
+		if (out_img.isNull()) {
+			QFile out_file(out_file_path);
+			if (out_file.open(QIODevice::ReadOnly)) {
+				out_img = ImageLoader::load(out_file, 0);
+			}
+		}
+
+		if (need_picture_editor && !out_img.isNull()) {
+			automask_img = BinaryImage(ImageDumpFile::read(automask_file_path));
+			if (automask_img.isNull()) {
+				// Possibly a TIFF automask left by an older version.
+				automask_img = BinaryImage(ImageLoader::load(automask_file_path, 0));
+			}
+			if (automask_img.isNull() || automask_img.size() != out_img.size()) {
+				out_img = QImage();
+			}
+		}
+
+		if (need_speckles_image && !out_img.isNull()) {
+			speckles_img = BinaryImage(ImageDumpFile::read(speckles_file_path));
+			if (speckles_img.isNull()) {
+				// Possibly a TIFF speckles file left by an older version.
+				speckles_img = BinaryImage(ImageLoader::load(speckles_file_path, 0));
+			}
+			if (speckles_img.isNull()) {
+				out_img = QImage();
+			}
+		}
+
+		if (out_img.isNull()) {
+			// Something is wrong with the stored files after all.
+			// Fall back to re-generating the page.
+			fill_zones_patch = false;
+			automask_img = BinaryImage();
+			speckles_img = BinaryImage();
+		} else {
+			status.throwIfCancelled();
+
+			generator.applyFillZonesToOutput(
+				out_img, added_fill_zones, params.dewarpingMode(),
+				params.distortionModel(), params.depthPerception()
+			);
+
+			status.throwIfCancelled();
+
+			// The automask and speckles files aren't affected by fill
+			// zones, so they stay as they are on disk and the new
+			// output params keep their stored file params.
+			OutputWriteQueue::instance().enqueue(
+				IntrusivePtr<OutputWriteQueue::Job>(
+					new WriteJob(
+						m_ptrSettings, m_ptrThumbnailCache, m_pageId,
+						new_output_image_params, new_picture_zones, new_fill_zones,
+						out_file_path, out_img,
+						automask_dir, automask_file_path, QImage(),
+						speckles_dir, speckles_file_path, QImage(),
+						mutuallyExclusiveOutputFiles(), m_batchProcessing,
+						kept_automask_file_params, kept_speckles_file_params
+					)
+				)
+			);
+
+			need_reprocess = false;
+		}
+	}
+
+	if (need_reprocess && redespeckle_only) {
+		// Only the despeckle level changed and the stored files are
+		// intact, so instead of re-generating the page we reconstruct
+		// the pre-despeckle image from the output and speckles files
+		// and redo just the despeckling.  Unlike the in-memory
+		// binarization checkpoint in OutputGenerator, this works
+		// across sessions.
+		status.throwIfCancelled();
+
+		BinaryImage predespeckle;
+		{
+			QFile out_file(out_file_path);
+			if (out_file.open(QIODevice::ReadOnly)) {
+				predespeckle = BinaryImage(ImageLoader::load(out_file, 0));
+			}
+		}
+
+		if (!predespeckle.isNull() && stored_despeckle_level != DESPECKLE_OFF) {
+			BinaryImage old_speckles(ImageDumpFile::read(speckles_file_path));
+			if (old_speckles.isNull()) {
+				// Possibly a TIFF speckles file left by an older version.
+				old_speckles = BinaryImage(ImageLoader::load(speckles_file_path, 0));
+			}
+			if (old_speckles.isNull() || old_speckles.size() != predespeckle.size()) {
+				predespeckle.release();
+			} else {
+				// Put the previously removed speckles back.
+				rasterOp<RopOr<RopSrc, RopDst> >(predespeckle, old_speckles);
+			}
+		}
+
+		if (predespeckle.isNull()) {
+			// Something is wrong with the stored files after all.
+			// Fall back to re-generating the page.
+			redespeckle_only = false;
+		} else {
+			status.throwIfCancelled();
+
+			BinaryImage despeckled(predespeckle);
+			if (params.despeckleLevel() != DESPECKLE_OFF) {
+				Despeckle::Level level = Despeckle::NORMAL;
+				switch (params.despeckleLevel()) {
+					case DESPECKLE_CAUTIOUS:
+						level = Despeckle::CAUTIOUS;
+						break;
+					case DESPECKLE_AGGRESSIVE:
+						level = Despeckle::AGGRESSIVE;
+						break;
+					default:;
+				}
+				despeckled = Despeckle::despeckle(
+					predespeckle, params.outputDpi(), level,
+					status, m_ptrDbg.get()
+				);
+
+				speckles_img = despeckled;
+				rasterOp<RopSubtract<RopSrc, RopDst> >(speckles_img, predespeckle);
+			}
+
+			status.throwIfCancelled();
+
+			out_img = despeckled.toQImage();
+			Dpm const output_dpm(params.outputDpi());
+			out_img.setDotsPerMeterX(output_dpm.horizontal());
+			out_img.setDotsPerMeterY(output_dpm.vertical());
+
+			// A full run paints fill zones after despeckling, so some
+			// of the speckles we've just put back may sit inside zones
+			// that were painted over them.  Re-paint the zones to
+			// restore that ordering.
+			if (!new_fill_zones.empty()) {
+				generator.applyFillZonesToOutput(
+					out_img, new_fill_zones, params.dewarpingMode(),
+					params.distortionModel(), params.depthPerception()
+				);
+			}
+
+			bool const write_speckles_file =
+				params.despeckleLevel() != DESPECKLE_OFF;
+
+			OutputWriteQueue::instance().enqueue(
+				IntrusivePtr<OutputWriteQueue::Job>(
+					new WriteJob(
+						m_ptrSettings, m_ptrThumbnailCache, m_pageId,
+						new_output_image_params, new_picture_zones, new_fill_zones,
+						out_file_path, out_img,
+						automask_dir, automask_file_path, QImage(),
+						speckles_dir, speckles_file_path,
+						write_speckles_file ? speckles_img.toQImage() : QImage(),
+						mutuallyExclusiveOutputFiles(), m_batchProcessing
+					)
+				)
+			);
+
+			need_reprocess = false;
+		}
+	}
+
 	if (need_reprocess) {
 		// Even in batch processing mode we should still write automask, because it
 		// will be needed when we view the results back in interactive mode.
@@ -307,6 +655,7 @@ Task::process(
 			params.depthPerception(),
 			write_automask ? &automask_img : 0,
 			write_speckles_file ? &speckles_img : 0,
+			m_batchProcessing ? 0 : &binarization_preview,
 			m_ptrDbg.get()
 		);
 
@@ -325,56 +674,40 @@ Task::process(
 			BinaryImage(out_img.size(), WHITE).swap(speckles_img);
 		}
 
-		bool invalidate_params = false;
-		
-		if (!TiffWriter::writeImage(out_file_path, out_img)) {
-			invalidate_params = true;
-		} else {
-			deleteMutuallyExclusiveOutputFiles();
-		}
-
-		if (write_automask) {
-			// Note that QDir::mkdir() will fail if the parent directory,
-			// that is $OUT/cache doesn't exist. We want that behaviour,
-			// as otherwise when loading a project from a different machine,
-			// a whole bunch of bogus directories would be created.
-			QDir().mkdir(automask_dir);
-			// Also note that QDir::mkdir() will fail if the directory already exists,
-			// so we ignore its return value here.
-
-			if (!TiffWriter::writeImage(automask_file_path, automask_img.toQImage())) {
-				invalidate_params = true;
-			}
-		}
-		if (write_speckles_file) {
-			if (!QDir().mkpath(speckles_dir)) {
-				invalidate_params = true;
-			} else if (!TiffWriter::writeImage(speckles_file_path, speckles_img.toQImage())) {
-				invalidate_params = true;
-			}
-		}
-
-		if (invalidate_params) {
-			m_ptrSettings->removeOutputParams(m_pageId);
-		} else {
-			// Note that we can't reuse *_file_info objects
-			// as we've just overwritten those files.
-			OutputParams const out_params(
-				new_output_image_params,
-				OutputFileParams(QFileInfo(out_file_path)),
-				write_automask ? OutputFileParams(QFileInfo(automask_file_path))
-				: OutputFileParams(),
-				write_speckles_file ? OutputFileParams(QFileInfo(speckles_file_path))
-				: OutputFileParams(),
-				new_picture_zones, new_fill_zones
-			);
+		// Writing the files is handed off to a dedicated thread, so
+		// that we can start processing the next page without waiting
+		// for the disk.  The bookkeeping that depends on the outcome
+		// of the writes goes with them.
+		OutputWriteQueue::instance().enqueue(
+			IntrusivePtr<OutputWriteQueue::Job>(
+				new WriteJob(
+					m_ptrSettings, m_ptrThumbnailCache, m_pageId,
+					new_output_image_params, new_picture_zones, new_fill_zones,
+					out_file_path, out_img,
+					automask_dir, automask_file_path,
+					write_automask ? automask_img.toQImage() : QImage(),
+					speckles_dir, speckles_file_path,
+					write_speckles_file ? speckles_img.toQImage() : QImage(),
+					mutuallyExclusiveOutputFiles(), m_batchProcessing
+				)
+			)
+		);
+	}
 
-			m_ptrSettings->setOutputParams(m_pageId, out_params);
-		}
-		
-		m_ptrThumbnailCache->recreateThumbnail(ImageId(out_file_path), out_img);
+	if (CommandLine::get().hasExportPdf()) {
+		// The page goes into the PDF exporter while it's still in
+		// memory, saving the assembly step a re-read of the output
+		// file.  Encoding happens right here, on the worker thread.
+		PdfExporter::instance().addPage(m_pageId, out_img);
 	}
 
+	// Same idea for companion tools: the finished page is handed over
+	// as raw pixels while it's still in memory, sparing the consumer
+	// a decode of the file we are writing anyway.
+	SharedMemoryPublisher::instance().publish(
+		out_file_info.fileName(), out_img
+	);
+
 	DespeckleState const despeckle_state(
 		out_img, speckles_img, params.despeckleLevel(), params.outputDpi()
 	);
@@ -394,7 +727,7 @@ Task::process(
 				new_xform, generator.outputContentRect(),
 				m_pageId, data.origImage(), out_img, automask_img,
 				despeckle_state, despeckle_visualization,
-				m_batchProcessing, m_debug
+				binarization_preview, m_batchProcessing, m_debug
 			)
 		);
 	} else {
@@ -403,38 +736,179 @@ Task::process(
 }
 
 /**
- * Delete output files mutually exclusive to m_pageId.
+ * Returns output files mutually exclusive to m_pageId.  They are
+ * deleted once our own output file has been written successfully.
  */
-void
-Task::deleteMutuallyExclusiveOutputFiles()
+QStringList
+Task::mutuallyExclusiveOutputFiles() const
 {
+	QStringList files;
 	switch (m_pageId.subPage()) {
 		case PageId::SINGLE_PAGE:
-			QFile::remove(
-				m_outFileNameGen.filePathFor(
-					PageId(m_pageId.imageId(), PageId::LEFT_PAGE)
-				)
+			files << m_outFileNameGen.filePathFor(
+				PageId(m_pageId.imageId(), PageId::LEFT_PAGE)
 			);
-			QFile::remove(
-				m_outFileNameGen.filePathFor(
-					PageId(m_pageId.imageId(), PageId::RIGHT_PAGE)
-				)
+			files << m_outFileNameGen.filePathFor(
+				PageId(m_pageId.imageId(), PageId::RIGHT_PAGE)
 			);
 			break;
 		case PageId::LEFT_PAGE:
 		case PageId::RIGHT_PAGE:
-			QFile::remove(
-				m_outFileNameGen.filePathFor(
-					PageId(m_pageId.imageId(), PageId::SINGLE_PAGE)
-				)
+			files << m_outFileNameGen.filePathFor(
+				PageId(m_pageId.imageId(), PageId::SINGLE_PAGE)
 			);
 			break;
 	}
+	return files;
+}
+
+
+/*============================= Task::WriteJob ==========================*/
+
+Task::WriteJob::WriteJob(
+	IntrusivePtr<Settings> const& settings,
+	IntrusivePtr<ThumbnailPixmapCache> const& thumbnail_cache,
+	PageId const& page_id,
+	OutputImageParams const& output_image_params,
+	ZoneSet const& picture_zones,
+	ZoneSet const& fill_zones,
+	QString const& out_file_path,
+	QImage const& out_img,
+	QString const& automask_dir,
+	QString const& automask_file_path,
+	QImage const& automask_img,
+	QString const& speckles_dir,
+	QString const& speckles_file_path,
+	QImage const& speckles_img,
+	QStringList const& files_to_delete,
+	bool const batch,
+	OutputFileParams const& kept_automask_file_params,
+	OutputFileParams const& kept_speckles_file_params)
+:	m_ptrSettings(settings),
+	m_ptrThumbnailCache(thumbnail_cache),
+	m_pageId(page_id),
+	m_outputImageParams(output_image_params),
+	m_pictureZones(picture_zones),
+	m_fillZones(fill_zones),
+	m_outFilePath(out_file_path),
+	m_outImg(out_img),
+	m_automaskDir(automask_dir),
+	m_automaskFilePath(automask_file_path),
+	m_automaskImg(automask_img),
+	m_specklesDir(speckles_dir),
+	m_specklesFilePath(speckles_file_path),
+	m_specklesImg(speckles_img),
+	m_filesToDelete(files_to_delete),
+	m_batchProcessing(batch),
+	m_keptAutomaskFileParams(kept_automask_file_params),
+	m_keptSpecklesFileParams(kept_speckles_file_params)
+{
+}
+
+void
+Task::WriteJob::execute()
+{
+	bool invalidate_params = false;
+
+	if (!OutputEncoder::selected().write(m_outFilePath, m_outImg)) {
+		invalidate_params = true;
+	} else {
+		for (int i = 0; i < m_filesToDelete.size(); ++i) {
+			QFile::remove(m_filesToDelete[i]);
+		}
+		if (!m_batchProcessing) {
+			OutputImageCache::instance().store(
+				m_outFilePath, QFileInfo(m_outFilePath), m_outImg
+			);
+		}
+	}
+
+	if (!m_automaskImg.isNull()) {
+		// Note that QDir::mkdir() will fail if the parent directory,
+		// that is $OUT/cache doesn't exist. We want that behaviour,
+		// as otherwise when loading a project from a different machine,
+		// a whole bunch of bogus directories would be created.
+		QDir().mkdir(m_automaskDir);
+		// Also note that QDir::mkdir() will fail if the directory already exists,
+		// so we ignore its return value here.
+
+		// The mask is for our own consumption only, so it goes
+		// into the fast dump format rather than through libtiff.
+		if (!ImageDumpFile::write(m_automaskImg, m_automaskFilePath)) {
+			invalidate_params = true;
+		}
+	}
+	if (!m_specklesImg.isNull()) {
+		if (!QDir().mkpath(m_specklesDir)) {
+			invalidate_params = true;
+		} else if (!ImageDumpFile::write(m_specklesImg, m_specklesFilePath)) {
+			invalidate_params = true;
+		}
+	}
+
+	if (invalidate_params) {
+		m_ptrSettings->removeOutputParams(m_pageId);
+	} else {
+		// Note that we can't reuse any existing QFileInfo objects
+		// as we've just overwritten those files.
+		OutputParams const out_params(
+			m_outputImageParams,
+			OutputFileParams(QFileInfo(m_outFilePath)),
+			m_automaskImg.isNull() ? m_keptAutomaskFileParams
+			: OutputFileParams(QFileInfo(m_automaskFilePath)),
+			m_specklesImg.isNull() ? m_keptSpecklesFileParams
+			: OutputFileParams(QFileInfo(m_specklesFilePath)),
+			m_pictureZones, m_fillZones
+		);
+
+		m_ptrSettings->setOutputParams(m_pageId, out_params);
+	}
+
+	m_ptrThumbnailCache->recreateThumbnail(ImageId(m_outFilePath), m_outImg);
+}
+
+bool
+Task::WriteJob::touches(QString const& file_path) const
+{
+	return file_path == m_outFilePath
+		|| file_path == m_automaskFilePath
+		|| file_path == m_specklesFilePath;
 }
 
 
 /*============================ Task::UiUpdater ==========================*/
 
+namespace
+{
+
+/**
+ * Downscales the binarization preview inputs to the resolution
+ * the Output tab previews at.  Runs on the worker thread, like
+ * the other downscaling done by the UiUpdater constructor.
+ */
+OutputGenerator::BinarizationPreview
+downscaleBinarizationPreview(OutputGenerator::BinarizationPreview const& preview)
+{
+	if (preview.isNull()) {
+		return preview;
+	}
+
+	OutputGenerator::BinarizationPreview downscaled;
+	downscaled.grayImage = ImageView::createDownscaledImage(preview.grayImage);
+	downscaled.mask = BinaryImage(
+		scaleToGray(
+			GrayImage(preview.mask.toQImage()), downscaled.grayImage.size()
+		).toQImage(),
+		BinaryThreshold(128)
+	);
+	downscaled.rect = preview.rect;
+	downscaled.baseThreshold = preview.baseThreshold;
+
+	return downscaled;
+}
+
+} // anonymous namespace
+
 Task::UiUpdater::UiUpdater(
 	IntrusivePtr<Filter> const& filter,
 	IntrusivePtr<Settings> const& settings,
@@ -448,6 +922,7 @@ Task::UiUpdater::UiUpdater(
 	BinaryImage const& picture_mask,
 	DespeckleState const& despeckle_state,
 	DespeckleVisualization const& despeckle_visualization,
+	OutputGenerator::BinarizationPreview const& binarization_preview,
 	bool const batch, bool const debug)
 :	m_ptrFilter(filter),
 	m_ptrSettings(settings),
@@ -463,6 +938,7 @@ Task::UiUpdater::UiUpdater(
 	m_pictureMask(picture_mask),
 	m_despeckleState(despeckle_state),
 	m_despeckleVisualization(despeckle_visualization),
+	m_binarizationPreview(downscaleBinarizationPreview(binarization_preview)),
 	m_batchProcessing(batch),
 	m_debug(debug)
 {
@@ -483,10 +959,14 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 		return;
 	}
 
-	std::auto_ptr<ImageViewBase> image_view(
-		new ImageView(m_outputImage, m_downscaledOutputImage)
+	std::auto_ptr<ImageView> image_view(
+		new ImageView(m_outputImage, m_downscaledOutputImage, m_binarizationPreview)
 	);
 	QPixmap const downscaled_output_pixmap(image_view->downscaledPixmap());
+	QObject::connect(
+		opt_widget, SIGNAL(bwThresholdPreview(int, bool*)),
+		image_view.get(), SLOT(bwThresholdPreview(int, bool*))
+	);
 
 	std::auto_ptr<ImageViewBase> dewarping_view(
 		new DewarpingView(
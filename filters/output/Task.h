@@ -26,6 +26,7 @@
 #include "ImageViewTab.h"
 #include "OutputFileNameGenerator.h"
 #include <QColor>
+#include <QStringList>
 #include <memory>
 
 class DebugImages;
@@ -66,8 +67,9 @@ public:
 		QPolygonF const& content_rect_phys);
 private:
 	class UiUpdater;
-	
-	void deleteMutuallyExclusiveOutputFiles();
+	class WriteJob;
+
+	QStringList mutuallyExclusiveOutputFiles() const;
 
 	IntrusivePtr<Filter> m_ptrFilter;
 	IntrusivePtr<Settings> m_ptrSettings;
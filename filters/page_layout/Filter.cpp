@@ -35,6 +35,7 @@
 #ifndef Q_MOC_RUN
 #include <boost/lambda/lambda.hpp>
 #include <boost/lambda/bind.hpp>
+#include <boost/foreach.hpp>
 #endif
 #include <QRectF>
 #include <QSizeF>
@@ -43,6 +44,8 @@
 #include <QCoreApplication>
 #include <QDomDocument>
 #include <QDomElement>
+#include <vector>
+#include <utility>
 #include <assert.h>
 #include "CommandLine.h"
 
@@ -52,15 +55,10 @@ namespace page_layout
 Filter::Filter(IntrusivePtr<ProjectPages> const& pages,
 	PageSelectionAccessor const& page_selection_accessor)
 :	m_ptrPages(pages),
+	m_pageSelectionAccessor(page_selection_accessor),
 	m_ptrSettings(new Settings),
 	m_selectedPageOrder(0)
 {
-	if (CommandLine::get().isGui()) {
-		m_ptrOptionsWidget.reset(
-			new OptionsWidget(m_ptrSettings, page_selection_accessor)
-		);
-	}
-
 	typedef PageOrderOption::ProviderPtr ProviderPtr;
 
 	ProviderPtr const default_order;
@@ -118,13 +116,26 @@ Filter::performRelinking(AbstractRelinker const& relinker)
 	m_ptrSettings->performRelinking(relinker);
 }
 
+OptionsWidget*
+Filter::optionsWidget()
+{
+	// Built lazily, on first stage activation.
+	if (!m_ptrOptionsWidget.get() && CommandLine::get().isGui()) {
+		m_ptrOptionsWidget.reset(
+			new OptionsWidget(m_ptrSettings, m_pageSelectionAccessor)
+		);
+	}
+	return m_ptrOptionsWidget.get();
+}
+
 void
 Filter::preUpdateUI(FilterUiInterface* ui, PageId const& page_id)
 {
 	Margins const margins_mm(m_ptrSettings->getHardMarginsMM(page_id));
 	Alignment const alignment(m_ptrSettings->getPageAlignment(page_id));
-	m_ptrOptionsWidget->preUpdateUI(page_id, margins_mm, alignment);
-	ui->setOptionsWidget(m_ptrOptionsWidget.get(), ui->KEEP_OWNERSHIP);
+	OptionsWidget* const opt_widget = optionsWidget();
+	opt_widget->preUpdateUI(page_id, margins_mm, alignment);
+	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 }
 
 QDomElement
@@ -218,6 +229,29 @@ Filter::invalidateContentBox(PageId const& page_id)
 	m_ptrSettings->invalidateContentSize(page_id);
 }
 
+void
+Filter::updateContentBoxes(std::vector<ContentBoxUpdate> const& updates)
+{
+	std::vector<std::pair<PageId, QSizeF> > sizes;
+	sizes.reserve(updates.size());
+
+	BOOST_FOREACH(ContentBoxUpdate const& update, updates) {
+		if (update.valid) {
+			sizes.push_back(
+				std::make_pair(
+					update.pageId,
+					Utils::calcRectSizeMM(update.xform, update.contentRect)
+				)
+			);
+		} else {
+			// An invalid size stands for invalidation.
+			sizes.push_back(std::make_pair(update.pageId, QSizeF()));
+		}
+	}
+
+	m_ptrSettings->setContentSizesMM(sizes);
+}
+
 bool
 Filter::checkReadyForOutput(ProjectPages const& pages, PageId const* ignore)
 {
@@ -25,16 +25,18 @@
 #include "IntrusivePtr.h"
 #include "FilterResult.h"
 #include "SafeDeletingQObjectPtr.h"
+#include "PageSelectionAccessor.h"
 #include "PageOrderOption.h"
+#include "PageId.h"
+#include "ImageTransformation.h"
+#include "Dpi.h"
 #include <QCoreApplication>
+#include <QRectF>
 #include <vector>
 
-class PageId;
 class ProjectPages;
 class PageSelectionAccessor;
-class ImageTransformation;
 class QString;
-class QRectF;
 
 namespace output
 {
@@ -72,6 +74,13 @@ public:
 
 	virtual std::vector<PageOrderOption> pageOrderOptions() const;
 
+	/**
+	 * The aggregate hard page size ("match size with other pages") is
+	 * a maximum over all pages, and the final page geometry computed
+	 * on the way to output consumes it.
+	 */
+	virtual bool aggregatesAcrossPages() const { return true; }
+
 	virtual void performRelinking(AbstractRelinker const& relinker);
 
 	virtual void preUpdateUI(FilterUiInterface* ui, PageId const& page_id);
@@ -85,8 +94,37 @@ public:
 	void setContentBox(
 		PageId const& page_id, ImageTransformation const& xform,
 		QRectF const& content_rect);
-	
+
 	void invalidateContentBox(PageId const& page_id);
+
+	/**
+	 * \brief A single entry for updateContentBoxes().
+	 */
+	struct ContentBoxUpdate
+	{
+		PageId pageId;
+		ImageTransformation xform;
+		QRectF contentRect;
+		bool valid; /**< false means the content box is to be invalidated. */
+
+		ContentBoxUpdate(
+			PageId const& page_id, ImageTransformation const& xform_,
+			QRectF const& content_rect)
+		:	pageId(page_id), xform(xform_),
+			contentRect(content_rect), valid(true) {}
+
+		explicit ContentBoxUpdate(PageId const& page_id)
+		:	pageId(page_id), xform(QRectF(0, 0, 1, 1), Dpi(300, 300)),
+			valid(false) {}
+	};
+
+	/**
+	 * \brief A batch version of setContentBox() / invalidateContentBox().
+	 *
+	 * The whole batch is applied to the settings under a single lock,
+	 * with the aggregate page size re-evaluated just once.
+	 */
+	void updateContentBoxes(std::vector<ContentBoxUpdate> const& updates);
 	
 	bool checkReadyForOutput(
 		ProjectPages const& pages, PageId const* ignore = 0);
@@ -99,7 +137,11 @@ public:
 	IntrusivePtr<CacheDrivenTask> createCacheDrivenTask(
 		IntrusivePtr<output::CacheDrivenTask> const& next_task);
 	
-	OptionsWidget* optionsWidget() { return m_ptrOptionsWidget.get(); };
+	/**
+	 * In GUI mode, creates the widget on first call.
+	 * Returns null in CLI mode.
+	 */
+	OptionsWidget* optionsWidget();
 	Settings* getSettings() { return m_ptrSettings.get(); };
 private:
 	void writePageSettings(
@@ -107,6 +149,7 @@ private:
 		PageId const& page_id, int numeric_id) const;
 	
 	IntrusivePtr<ProjectPages> m_ptrPages;
+	PageSelectionAccessor m_pageSelectionAccessor;
 	IntrusivePtr<Settings> m_ptrSettings;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 	std::vector<PageOrderOption> m_pageOrderOptions;
@@ -253,9 +253,9 @@ ImageView::alignmentChanged(Alignment const& alignment)
 		m_ptrSettings->setPageAlignment(m_pageId, alignment);
 	
 	recalcBoxesAndFit(calcHardMarginsMM());
-	
+
 	if (size_changed == Settings::AGGREGATE_SIZE_CHANGED) {
-		emit invalidateAllThumbnails();
+		emit invalidateThumbnails(sizeDependentPages());
 	} else {
 		emit invalidateThumbnail(m_pageId);
 	}
@@ -710,10 +710,19 @@ void
 ImageView::invalidateThumbnails(AggregateSizeChanged const agg_size_changed)
 {
 	if (agg_size_changed == AGGREGATE_SIZE_CHANGED) {
-		emit invalidateAllThumbnails();
+		emit invalidateThumbnails(sizeDependentPages());
 	} else {
 		emit invalidateThumbnail(m_pageId);
 	}
 }
 
+std::set<PageId>
+ImageView::sizeDependentPages() const
+{
+	std::set<PageId> pages;
+	m_ptrSettings->findSizeDependentPages(pages);
+	pages.insert(m_pageId);
+	return pages;
+}
+
 } // namespace page_layout
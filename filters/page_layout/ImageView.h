@@ -35,6 +35,7 @@
 #include <QRectF>
 #include <QPointF>
 #include <QPoint>
+#include <set>
 
 class Margins;
 
@@ -60,9 +61,11 @@ public:
 	virtual ~ImageView();
 signals:
 	void invalidateThumbnail(PageId const& page_id);
-	
+
 	void invalidateAllThumbnails();
-	
+
+	void invalidateThumbnails(std::set<PageId> const& pages);
+
 	void marginsSetLocally(Margins const& margins_mm);
 public slots:
 	void marginsSetExternally(Margins const& margins_mm);
@@ -137,6 +140,8 @@ private:
 	AggregateSizeChanged commitHardMargins(Margins const& margins_mm);
 	
 	void invalidateThumbnails(AggregateSizeChanged agg_size_changed);
+
+	std::set<PageId> sizeDependentPages() const;
 	
 	DraggableObject m_innerCorners[4];
 	ObjectDragHandler m_innerCornerHandlers[4];
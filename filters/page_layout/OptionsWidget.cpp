@@ -349,12 +349,20 @@ OptionsWidget::applyMargins(std::set<PageId> const& pages)
 		return;
 	}
 	
+	QSizeF const agg_size_before(m_ptrSettings->getAggregateHardSizeMM());
+
 	BOOST_FOREACH(PageId const& page_id, pages) {
 		m_ptrSettings->setHardMarginsMM(page_id, m_marginsMM);
 	}
-	
-	emit aggregateHardSizeChanged();
-	emit invalidateAllThumbnails();
+
+	std::set<PageId> affected_pages(pages);
+	if (m_ptrSettings->getAggregateHardSizeMM() != agg_size_before) {
+		// Pages extended to the aggregate size need to be
+		// re-committed as well.
+		m_ptrSettings->findSizeDependentPages(affected_pages);
+		emit aggregateHardSizeChanged();
+	}
+	emit invalidateThumbnails(affected_pages);
 }
 
 void
@@ -364,11 +372,21 @@ OptionsWidget::applyAlignment(std::set<PageId> const& pages)
 		return;
 	}
 	
+	bool agg_size_changed = false;
 	BOOST_FOREACH(PageId const& page_id, pages) {
-		m_ptrSettings->setPageAlignment(page_id, m_alignment);
+		if (m_ptrSettings->setPageAlignment(page_id, m_alignment)
+				== Settings::AGGREGATE_SIZE_CHANGED) {
+			agg_size_changed = true;
+		}
 	}
-	
-	emit invalidateAllThumbnails();
+
+	std::set<PageId> affected_pages(pages);
+	if (agg_size_changed) {
+		// Pages extended to the aggregate size need to be
+		// re-committed as well.
+		m_ptrSettings->findSizeDependentPages(affected_pages);
+	}
+	emit invalidateThumbnails(affected_pages);
 }
 
 void
@@ -22,6 +22,9 @@
 #include "Settings.h"
 #include "IntrusivePtr.h"
 #include "PageOrderProvider.h"
+#include "PageId.h"
+#include <QSizeF>
+#include <map>
 
 namespace page_layout
 {
@@ -34,8 +37,17 @@ public:
 	virtual bool precedes(
 		PageId const& lhs_page, bool lhs_incomplete,
 		PageId const& rhs_page, bool rhs_incomplete) const;
+
+	virtual void precomputeKeys(std::vector<PageId> const& pages) const;
+
+	virtual void releaseKeys() const;
 private:
+	QSizeF pageSize(PageId const& page) const;
+
+	QSizeF loadPageSize(PageId const& page) const;
+
 	IntrusivePtr<Settings> m_ptrSettings;
+	mutable std::map<PageId, QSizeF> m_keyCache;
 };
 
 } // namespace page_layout
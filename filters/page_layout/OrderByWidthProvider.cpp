@@ -19,6 +19,7 @@
 #include "OrderByWidthProvider.h"
 #include "Params.h"
 #include "Margins.h"
+#include <boost/foreach.hpp>
 #include <QSizeF>
 #include <memory>
 
@@ -35,26 +36,9 @@ OrderByWidthProvider::precedes(
 	PageId const& lhs_page, bool const lhs_incomplete,
 	PageId const& rhs_page, bool const rhs_incomplete) const
 {
-	std::auto_ptr<Params> const lhs_params(m_ptrSettings->getPageParams(lhs_page));
-	std::auto_ptr<Params> const rhs_params(m_ptrSettings->getPageParams(rhs_page));
-	
-	QSizeF lhs_size;
-	if (lhs_params.get()) {
-		Margins const margins(lhs_params->hardMarginsMM());
-		lhs_size = lhs_params->contentSizeMM();
-		lhs_size += QSizeF(
-			margins.left() + margins.right(), margins.top() + margins.bottom()
-		);
-	}
-	QSizeF rhs_size;
-	if (rhs_params.get()) {
-		Margins const margins(rhs_params->hardMarginsMM());
-		rhs_size = rhs_params->contentSizeMM();
-		rhs_size += QSizeF(
-			margins.left() + margins.right(), margins.top() + margins.bottom()
-		);
-	}
-	
+	QSizeF const lhs_size(pageSize(lhs_page));
+	QSizeF const rhs_size(pageSize(rhs_page));
+
 	bool const lhs_valid = !lhs_incomplete && lhs_size.isValid();
 	bool const rhs_valid = !rhs_incomplete && rhs_size.isValid();
 
@@ -66,4 +50,45 @@ OrderByWidthProvider::precedes(
 	return lhs_size.width() < rhs_size.width();
 }
 
+void
+OrderByWidthProvider::precomputeKeys(std::vector<PageId> const& pages) const
+{
+	m_keyCache.clear();
+	BOOST_FOREACH(PageId const& page, pages) {
+		m_keyCache[page] = loadPageSize(page);
+	}
+}
+
+void
+OrderByWidthProvider::releaseKeys() const
+{
+	m_keyCache.clear();
+}
+
+QSizeF
+OrderByWidthProvider::pageSize(PageId const& page) const
+{
+	std::map<PageId, QSizeF>::const_iterator const it(m_keyCache.find(page));
+	if (it != m_keyCache.end()) {
+		return it->second;
+	}
+	return loadPageSize(page);
+}
+
+QSizeF
+OrderByWidthProvider::loadPageSize(PageId const& page) const
+{
+	std::auto_ptr<Params> const params(m_ptrSettings->getPageParams(page));
+
+	QSizeF size;
+	if (params.get()) {
+		Margins const margins(params->hardMarginsMM());
+		size = params->contentSizeMM();
+		size += QSizeF(
+			margins.left() + margins.right(), margins.top() + margins.bottom()
+		);
+	}
+	return size;
+}
+
 } // namespace page_layout
@@ -17,6 +17,7 @@
 */
 
 #include "Settings.h"
+#include "ProjectDirtyTracker.h"
 #include "PageId.h"
 #include "PageSequence.h"
 #include "Params.h"
@@ -39,6 +40,7 @@
 #include <algorithm>
 #include <functional> // for std::greater<>
 #include <vector>
+#include <utility>
 #include <stddef.h>
 
 
@@ -146,12 +148,17 @@ public:
 	
 	AggregateSizeChanged setContentSizeMM(
 		PageId const& page_id, QSizeF const& content_size_mm);
-	
+
+	AggregateSizeChanged setContentSizesMM(
+		std::vector<std::pair<PageId, QSizeF> > const& sizes);
+
 	void invalidateContentSize(PageId const& page_id);
-	
+
 	QSizeF getAggregateHardSizeMM() const;
-	
+
 	QSizeF getAggregateHardSizeMMLocked() const;
+
+	void findSizeDependentPages(std::set<PageId>& pages) const;
 	
 	QSizeF getAggregateHardSizeMM(
 		PageId const& page_id, QSizeF const& hard_size_mm,
@@ -236,6 +243,7 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 void
 Settings::removePagesMissingFrom(PageSequence const& pages)
 {
+	ProjectDirtyTracker::noteModified();
 	m_ptrImpl->removePagesMissingFrom(pages);
 }
 
@@ -255,6 +263,7 @@ Settings::getPageParams(PageId const& page_id) const
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
+	ProjectDirtyTracker::noteModified();
 	return m_ptrImpl->setPageParams(page_id, params);
 }
 
@@ -278,6 +287,7 @@ Settings::getHardMarginsMM(PageId const& page_id) const
 void
 Settings::setHardMarginsMM(PageId const& page_id, Margins const& margins_mm)
 {
+	ProjectDirtyTracker::noteModified();
 	m_ptrImpl->setHardMarginsMM(page_id, margins_mm);
 }
 
@@ -300,9 +310,25 @@ Settings::setContentSizeMM(
 	return m_ptrImpl->setContentSizeMM(page_id, content_size_mm);
 }
 
+Settings::AggregateSizeChanged
+Settings::setContentSizesMM(
+	std::vector<std::pair<PageId, QSizeF> > const& sizes)
+{
+	typedef std::pair<PageId, QSizeF> SizeForPage;
+	BOOST_FOREACH(SizeForPage const& size_for_page, sizes) {
+		if (!size_for_page.second.isValid()) {
+			ProjectDirtyTracker::noteModified();
+			break;
+		}
+	}
+
+	return m_ptrImpl->setContentSizesMM(sizes);
+}
+
 void
 Settings::invalidateContentSize(PageId const& page_id)
 {
+	ProjectDirtyTracker::noteModified();
 	return m_ptrImpl->invalidateContentSize(page_id);
 }
 
@@ -312,6 +338,12 @@ Settings::getAggregateHardSizeMM() const
 	return m_ptrImpl->getAggregateHardSizeMM();
 }
 
+void
+Settings::findSizeDependentPages(std::set<PageId>& pages) const
+{
+	m_ptrImpl->findSizeDependentPages(pages);
+}
+
 QSizeF
 Settings::getAggregateHardSizeMM(
 	PageId const& page_id, QSizeF const& hard_size_mm,
@@ -605,6 +637,45 @@ Settings::Impl::setContentSizeMM(
 	}
 }
 
+Settings::AggregateSizeChanged
+Settings::Impl::setContentSizesMM(
+	std::vector<std::pair<PageId, QSizeF> > const& sizes)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	QSizeF const agg_size_before(getAggregateHardSizeMMLocked());
+
+	typedef std::pair<PageId, QSizeF> SizeForPage;
+	BOOST_FOREACH(SizeForPage const& size_for_page, sizes) {
+		PageId const& page_id = size_for_page.first;
+		QSizeF const& content_size_mm = size_for_page.second;
+
+		Container::iterator const it(m_items.lower_bound(page_id));
+		if (it == m_items.end() || page_id < it->pageId) {
+			if (!content_size_mm.isValid()) {
+				// Nothing to invalidate.
+				continue;
+			}
+			Item const item(
+				page_id, m_defaultHardMarginsMM,
+				content_size_mm, m_defaultAlignment
+			);
+			m_items.insert(it, item);
+		} else if (content_size_mm.isValid()) {
+			m_items.modify(it, ModifyContentSize(content_size_mm));
+		} else {
+			m_items.modify(it, ModifyContentSize(m_invalidSize));
+		}
+	}
+
+	QSizeF const agg_size_after(getAggregateHardSizeMMLocked());
+	if (agg_size_before == agg_size_after) {
+		return AGGREGATE_SIZE_UNCHANGED;
+	} else {
+		return AGGREGATE_SIZE_CHANGED;
+	}
+}
+
 void
 Settings::Impl::invalidateContentSize(PageId const& page_id)
 {
@@ -623,6 +694,20 @@ Settings::Impl::getAggregateHardSizeMM() const
 	return getAggregateHardSizeMMLocked();
 }
 
+void
+Settings::Impl::findSizeDependentPages(std::set<PageId>& pages) const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	Container::iterator it(m_items.begin());
+	Container::iterator const end(m_items.end());
+	for (; it != end; ++it) {
+		if (it->alignedWithOthers()) {
+			pages.insert(it->pageId);
+		}
+	}
+}
+
 QSizeF
 Settings::Impl::getAggregateHardSizeMMLocked() const
 {
@@ -23,6 +23,9 @@
 #include "RefCountable.h"
 #include "Margins.h"
 #include <memory>
+#include <set>
+#include <vector>
+#include <utility>
 
 class PageId;
 class Margins;
@@ -137,13 +140,34 @@ public:
 	 */
 	AggregateSizeChanged setContentSizeMM(
 		PageId const& page_id, QSizeF const& content_size_mm);
-	
+
+	/**
+	 * \brief Applies a whole batch of setContentSizeMM() /
+	 *        invalidateContentSize() updates under a single lock.
+	 *
+	 * An invalid size stands for invalidation.  The aggregate page
+	 * size is re-evaluated once for the batch rather than per page.
+	 */
+	AggregateSizeChanged setContentSizesMM(
+		std::vector<std::pair<PageId, QSizeF> > const& sizes);
+
 	void invalidateContentSize(PageId const& page_id);
 	
 	/**
 	 * \brief Returns the aggregate (max width + max height) hard page size.
 	 */
 	QSizeF getAggregateHardSizeMM() const;
+
+	/**
+	 * \brief Collects the pages whose output size depends on the
+	 *        aggregate hard size.
+	 *
+	 * Those are the pages aligned with others - they receive soft
+	 * margins extending them to the aggregate size, so a change of
+	 * that size affects all of them.  Pages this filter hasn't seen
+	 * yet are not reported.
+	 */
+	void findSizeDependentPages(std::set<PageId>& pages) const;
 	
 	/**
 	 * \brief Same as getAggregateHardSizeMM(), but assumes a specified
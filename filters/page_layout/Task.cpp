@@ -172,7 +172,10 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 	
 	if (m_aggSizeChanged) {
-		ui->invalidateAllThumbnails();
+		std::set<PageId> pages;
+		m_ptrSettings->findSizeDependentPages(pages);
+		pages.insert(m_pageId);
+		ui->invalidateThumbnails(pages);
 	} else {
 		ui->invalidateThumbnail(m_pageId);
 	}
@@ -195,6 +198,10 @@ Task::UiUpdater::updateUI(FilterUiInterface* ui)
 		view, SIGNAL(invalidateAllThumbnails()),
 		opt_widget, SIGNAL(invalidateAllThumbnails())
 	);
+	QObject::connect(
+		view, SIGNAL(invalidateThumbnails(std::set<PageId> const&)),
+		opt_widget, SIGNAL(invalidateThumbnails(std::set<PageId> const&))
+	);
 	QObject::connect(
 		view, SIGNAL(marginsSetLocally(Margins const&)),
 		opt_widget, SLOT(marginsSetExternally(Margins const&))
@@ -34,6 +34,7 @@
 #ifndef Q_MOC_RUN
 #include <boost/lambda/lambda.hpp>
 #include <boost/lambda/bind.hpp>
+#include <boost/foreach.hpp>
 #endif
 #include <QString>
 #include <QObject>
@@ -49,17 +50,10 @@ namespace page_split
 Filter::Filter(IntrusivePtr<ProjectPages> const& page_sequence,
 	PageSelectionAccessor const& page_selection_accessor)
 :	m_ptrPages(page_sequence),
+	m_pageSelectionAccessor(page_selection_accessor),
 	m_ptrSettings(new Settings),
 	m_selectedPageOrder(0)
 {
-	if (CommandLine::get().isGui()) {
-		m_ptrOptionsWidget.reset(
-			new OptionsWidget(
-				m_ptrSettings, m_ptrPages, page_selection_accessor
-			)
-		);
-	}
-	
 	typedef PageOrderOption::ProviderPtr ProviderPtr;
 
 	ProviderPtr const default_order;
@@ -90,11 +84,26 @@ Filter::performRelinking(AbstractRelinker const& relinker)
 	m_ptrSettings->performRelinking(relinker);
 }
 
+OptionsWidget*
+Filter::optionsWidget()
+{
+	// Built lazily, on first stage activation.
+	if (!m_ptrOptionsWidget.get() && CommandLine::get().isGui()) {
+		m_ptrOptionsWidget.reset(
+			new OptionsWidget(
+				m_ptrSettings, m_ptrPages, m_pageSelectionAccessor
+			)
+		);
+	}
+	return m_ptrOptionsWidget.get();
+}
+
 void
 Filter::preUpdateUI(FilterUiInterface* ui, PageId const& page_id)
 {
-	m_ptrOptionsWidget->preUpdateUI(page_id);
-	ui->setOptionsWidget(m_ptrOptionsWidget.get(), ui->KEEP_OWNERSHIP);
+	OptionsWidget* const opt_widget = optionsWidget();
+	opt_widget->preUpdateUI(page_id);
+	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 }
 
 QDomElement
@@ -191,6 +200,37 @@ Filter::pageOrientationUpdate(
 	m_ptrPages->autoSetLayoutTypeFor(image_id, orientation);
 }
 
+void
+Filter::updatePageOrientations(
+	std::vector<std::pair<ImageId, OrthogonalRotation> > const& orientations)
+{
+	std::vector<std::pair<ImageId, OrthogonalRotation> > updates;
+	updates.reserve(orientations.size());
+
+	typedef std::pair<ImageId, OrthogonalRotation> OrientationForImage;
+	BOOST_FOREACH(OrientationForImage const& orientation_for_image, orientations) {
+		ImageId const& image_id = orientation_for_image.first;
+		OrthogonalRotation const& orientation = orientation_for_image.second;
+
+		Settings::Record const record(m_ptrSettings->getPageRecord(image_id));
+
+		if (record.layoutType() && *record.layoutType() != AUTO_LAYOUT_TYPE) {
+			// The layout type was set manually, so we don't care about orientation.
+			continue;
+		}
+
+		if (record.params() && record.params()->dependencies().orientation() == orientation) {
+			// We've already estimated the number of pages for this orientation.
+			continue;
+		}
+
+		updates.push_back(orientation_for_image);
+	}
+
+	// Use orientations to update the number of logical pages in images.
+	m_ptrPages->autoSetLayoutTypesFor(updates);
+}
+
 void
 Filter::writeImageSettings(
 	QDomDocument& doc, QDomElement& filter_el,
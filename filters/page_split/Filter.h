@@ -25,7 +25,10 @@
 #include "IntrusivePtr.h"
 #include "FilterResult.h"
 #include "SafeDeletingQObjectPtr.h"
+#include "PageSelectionAccessor.h"
 #include <set>
+#include <vector>
+#include <utility>
 #include "PageOrderOption.h"
 #include <QCoreApplication>
 
@@ -82,11 +85,24 @@ public:
 	IntrusivePtr<CacheDrivenTask> createCacheDrivenTask(
 		IntrusivePtr<deskew::CacheDrivenTask> const& next_task);
 	
-	OptionsWidget* optionsWidget() { return m_ptrOptionsWidget.get(); }
+	/**
+	 * In GUI mode, creates the widget on first call.
+	 * Returns null in CLI mode.
+	 */
+	OptionsWidget* optionsWidget();
 
 	void pageOrientationUpdate(
 		ImageId const& image_id, OrthogonalRotation const& orientation);
 
+	/**
+	 * \brief A batch version of pageOrientationUpdate().
+	 *
+	 * Page layouts are updated in one go, with ProjectPages
+	 * emitting at most one notification for the whole batch.
+	 */
+	void updatePageOrientations(
+		std::vector<std::pair<ImageId, OrthogonalRotation> > const& orientations);
+
 	Settings* getSettings() { return m_ptrSettings.get(); };
 	
 	virtual std::vector<PageOrderOption> pageOrderOptions() const;
@@ -98,6 +114,7 @@ private:
 		ImageId const& image_id, int const numeric_id) const;
 	
 	IntrusivePtr<ProjectPages> m_ptrPages;
+	PageSelectionAccessor m_pageSelectionAccessor;
 	IntrusivePtr<Settings> m_ptrSettings;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 	std::vector<PageOrderOption> m_pageOrderOptions;
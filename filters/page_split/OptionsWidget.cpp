@@ -291,9 +291,7 @@ OptionsWidget::layoutTypeSet(
 	if (all_pages) {
 		emit invalidateAllThumbnails();
 	} else {
-		BOOST_FOREACH(PageId const& page_id, pages) {
-			emit invalidateThumbnail(page_id);
-		}
+		emit invalidateThumbnails(pages);
 	}
 	
 	if (layout_type == AUTO_LAYOUT_TYPE) {
@@ -20,6 +20,7 @@
 #include "OrderBySplitTypeProvider.h"
 #include "Params.h"
 #include "PageLayout.h"
+#include <boost/foreach.hpp>
 #include <QSizeF>
 #include <memory>
 #include <assert.h>
@@ -49,33 +50,55 @@ OrderBySplitTypeProvider::precedes(
 	assert(lhs_incomplete == false);
 	assert(rhs_incomplete == false);
 
-	Settings::Record const lhs_record(m_ptrSettings->getPageRecord(lhs_page.imageId()));
-	Settings::Record const rhs_record(m_ptrSettings->getPageRecord(rhs_page.imageId()));
+	int const lhs_layout_type = layoutType(lhs_page);
+	int const rhs_layout_type = layoutType(rhs_page);
 
-	Params const* lhs_params = lhs_record.params();
-	Params const* rhs_params = rhs_record.params();
-
-	int lhs_layout_type = lhs_record.combinedLayoutType();
-	if (lhs_params) {
-		lhs_layout_type = lhs_params->pageLayout().toLayoutType();
-	}
-	if (lhs_layout_type == AUTO_LAYOUT_TYPE) {
-		lhs_layout_type = 100; // To force it below pages with known layout.
+	if (lhs_layout_type == rhs_layout_type) {
+		return lhs_page < rhs_page;
+	} else {
+		return lhs_layout_type < rhs_layout_type;
 	}
+}
 
-	int rhs_layout_type = rhs_record.combinedLayoutType();
-	if (rhs_params) {
-		rhs_layout_type = rhs_params->pageLayout().toLayoutType();
+void
+OrderBySplitTypeProvider::precomputeKeys(std::vector<PageId> const& pages) const
+{
+	m_keyCache.clear();
+	BOOST_FOREACH(PageId const& page, pages) {
+		m_keyCache[page] = loadLayoutType(page);
 	}
-	if (rhs_layout_type == AUTO_LAYOUT_TYPE) {
-		rhs_layout_type = 100; // To force it below pages with known layout.
+}
+
+void
+OrderBySplitTypeProvider::releaseKeys() const
+{
+	m_keyCache.clear();
+}
+
+int
+OrderBySplitTypeProvider::layoutType(PageId const& page) const
+{
+	std::map<PageId, int>::const_iterator const it(m_keyCache.find(page));
+	if (it != m_keyCache.end()) {
+		return it->second;
 	}
+	return loadLayoutType(page);
+}
 
-	if (lhs_layout_type == rhs_layout_type) {
-		return lhs_page < rhs_page;
-	} else {
-		return lhs_layout_type < rhs_layout_type;
+int
+OrderBySplitTypeProvider::loadLayoutType(PageId const& page) const
+{
+	Settings::Record const record(m_ptrSettings->getPageRecord(page.imageId()));
+	Params const* params = record.params();
+
+	int layout_type = record.combinedLayoutType();
+	if (params) {
+		layout_type = params->pageLayout().toLayoutType();
+	}
+	if (layout_type == AUTO_LAYOUT_TYPE) {
+		layout_type = 100; // To force it below pages with known layout.
 	}
+	return layout_type;
 }
 
 } // namespace page_split
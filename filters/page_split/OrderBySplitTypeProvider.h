@@ -23,6 +23,8 @@
 #include "Settings.h"
 #include "IntrusivePtr.h"
 #include "PageOrderProvider.h"
+#include "PageId.h"
+#include <map>
 
 namespace page_split
 {
@@ -35,8 +37,17 @@ public:
 	virtual bool precedes(
 		PageId const& lhs_page, bool lhs_incomplete,
 		PageId const& rhs_page, bool rhs_incomplete) const;
+
+	virtual void precomputeKeys(std::vector<PageId> const& pages) const;
+
+	virtual void releaseKeys() const;
 private:
+	int layoutType(PageId const& page) const;
+
+	int loadLayoutType(PageId const& page) const;
+
 	IntrusivePtr<Settings> m_ptrSettings;
+	mutable std::map<PageId, int> m_keyCache;
 };
 
 } // namespace page_split
@@ -18,6 +18,7 @@
 
 #include "PageLayoutEstimator.h"
 #include "PageLayout.h"
+#include "FilterData.h"
 #include "OrthogonalRotation.h"
 #include "VertLineFinder.h"
 #include "ContentSpanFinder.h"
@@ -249,20 +250,138 @@ PageLayoutEstimator::estimatePageLayout(
 	LayoutType const layout_type, QImage const& input,
 	ImageTransformation const& pre_xform,
 	BinaryThreshold const bw_threshold,
+	FilterData const* const shared_data,
 	DebugImages* const dbg)
 {
 	if (layout_type == SINGLE_PAGE_UNCUT) {
 		return PageLayout(pre_xform.resultingRect());
 	}
-	
+
 	std::auto_ptr<PageLayout> layout(
-		tryCutAtFoldingLine(layout_type, input, pre_xform, dbg)
+		screenForObviousLayout(layout_type, input, pre_xform, bw_threshold, dbg)
 	);
 	if (layout.get()) {
 		return *layout;
 	}
+
+	layout = tryCutAtFoldingLine(layout_type, input, pre_xform, dbg);
+	if (layout.get()) {
+		return *layout;
+	}
 	
-	return cutAtWhitespace(layout_type, input, pre_xform, bw_threshold, dbg);
+	return cutAtWhitespace(
+		layout_type, input, pre_xform, bw_threshold, shared_data, dbg
+	);
+}
+
+/**
+ * \brief A cheap screen for pages whose layout is not in question.
+ *
+ * Most pages in a typical project are either a clean single page or
+ * two pages separated by a wide empty gutter.  Such pages don't need
+ * the full folding line machinery.  This function classifies a page
+ * from the vertical projection of a heavily downscaled binarized
+ * version of it, and returns a layout only for the unambiguous cases.
+ * Anything less than clear-cut, including visibly skewed pages whose
+ * gutter doesn't project cleanly, results in a null auto_ptr, sending
+ * the page down the usual path.
+ */
+std::auto_ptr<PageLayout>
+PageLayoutEstimator::screenForObviousLayout(
+	LayoutType const layout_type, QImage const& input,
+	ImageTransformation const& pre_xform,
+	BinaryThreshold const bw_threshold, DebugImages* const dbg)
+{
+	int const num_pages = numPages(layout_type, pre_xform);
+
+	QSize downscaled_size(input.size());
+	downscaled_size.scale(500, 500, Qt::KeepAspectRatio);
+	if (downscaled_size.isEmpty()) {
+		return std::auto_ptr<PageLayout>();
+	}
+
+	BinaryImage img(
+		scaleToGray(GrayImage(input), downscaled_size), bw_threshold
+	);
+	img = orthogonalRotation(img, pre_xform.preRotation().toDegrees());
+	if (dbg) {
+		dbg->add(img, "screen_bw");
+	}
+
+	int const width = img.width();
+	int const height = img.height();
+
+	SlicedHistogram hist(img, SlicedHistogram::COLS);
+
+	// Suppress columns that only contain speckles or scanner streaks.
+	int const noise_threshold = height / 100;
+	for (int x = 0; x < width; ++x) {
+		if (hist[x] <= noise_threshold) {
+			hist[x] = 0;
+		}
+	}
+
+	ContentSpanFinder span_finder;
+	span_finder.setMinContentWidth(std::max(2, width / 20));
+	span_finder.setMinWhitespaceWidth(std::max(2, width / 25));
+
+	std::deque<Span> spans;
+	void (std::deque<Span>::*push_back) (const Span&) = &std::deque<Span>::push_back;
+	span_finder.find(
+		hist, boost::lambda::bind(push_back, boost::lambda::var(spans), boost::lambda::_1)
+	);
+	if (dbg) {
+		visualizeSpans(*dbg, spans, img, "screen_spans");
+	}
+
+	QRectF const virtual_image_rect(
+		pre_xform.transform().mapRect(input.rect())
+	);
+
+	if (num_pages == 1) {
+		// An obvious single page: one content block, well clear
+		// of both vertical edges.  PAGE_PLUS_OFFCUT expects an
+		// offcut to be located, which is beyond this screen.
+		if (layout_type != AUTO_LAYOUT_TYPE || spans.size() != 1) {
+			return std::auto_ptr<PageLayout>();
+		}
+
+		int const edge_margin = std::max(2, width / 33);
+		if (spans.front().begin() < edge_margin
+				|| spans.front().end() > width - edge_margin) {
+			return std::auto_ptr<PageLayout>();
+		}
+
+		return std::auto_ptr<PageLayout>(new PageLayout(virtual_image_rect));
+	}
+
+	assert(num_pages == 2);
+
+	// An obvious gutter: two substantial content blocks with a wide
+	// gap between them, reasonably close to the center.
+	if (spans.size() != 2) {
+		return std::auto_ptr<PageLayout>();
+	}
+
+	Span const gap(spans.front(), spans.back());
+	double const gap_center = 0.5 * (gap.begin() + gap.end());
+	if (gap.width() < width / 25
+			|| fabs(gap_center - 0.5 * width) > 0.15 * width
+			|| spans.front().width() < width / 5
+			|| spans.back().width() < width / 5) {
+		return std::auto_ptr<PageLayout>();
+	}
+
+	double const split_x = virtual_image_rect.left()
+		+ virtual_image_rect.width() * gap_center / width;
+	QLineF const split_line(
+		QPointF(split_x, virtual_image_rect.top()),
+		QPointF(split_x, virtual_image_rect.bottom())
+	);
+
+	return std::auto_ptr<PageLayout>(
+		new PageLayout(virtual_image_rect, split_line)
+	);
 }
 
 namespace
@@ -398,12 +517,13 @@ PageLayoutEstimator::cutAtWhitespace(
 	LayoutType const layout_type, QImage const& input,
 	ImageTransformation const& pre_xform,
 	BinaryThreshold const bw_threshold,
+	FilterData const* const shared_data,
 	DebugImages* const dbg)
 {
 	QTransform xform;
 	
 	// Convert to B/W and rotate.
-	BinaryImage img(to300DpiBinary(input, xform, bw_threshold));
+	BinaryImage img(to300DpiBinary(input, xform, bw_threshold, shared_data));
 	
 	// Note: here we assume the only transformation applied
 	// to the input image is orthogonal rotation.
@@ -412,7 +532,13 @@ PageLayoutEstimator::cutAtWhitespace(
 		dbg->add(img, "bw300");
 	}
 	
-	img = removeGarbageAnd2xDownscale(img, dbg);
+	// The shared reductions are only valid if \p img is still the
+	// unscaled, unrotated full-size binarization.
+	bool const img_is_shared_full_size = shared_data && xform.isIdentity()
+		&& pre_xform.preRotation().toDegrees() == 0;
+	img = removeGarbageAnd2xDownscale(
+		img, img_is_shared_full_size ? shared_data : 0, dbg
+	);
 	xform.scale(0.5, 0.5);
 	if (dbg) {
 		dbg->add(img, "no_garbage");
@@ -552,11 +678,15 @@ PageLayoutEstimator::cutAtWhitespaceDeskewed150(
 imageproc::BinaryImage
 PageLayoutEstimator::to300DpiBinary(
 	QImage const& img, QTransform& xform,
-	BinaryThreshold const binary_threshold)
+	BinaryThreshold const binary_threshold,
+	FilterData const* const shared_data)
 {
 	double const xfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterX();
 	double const yfactor = (300.0 * constants::DPI2DPM) / img.dotsPerMeterY();
 	if (fabs(xfactor - 1.0) < 0.1 && fabs(yfactor - 1.0) < 0.1) {
+		if (shared_data) {
+			return shared_data->fullSizeBinary();
+		}
 		return BinaryImage(img, binary_threshold);
 	}
 	
@@ -574,9 +704,16 @@ PageLayoutEstimator::to300DpiBinary(
 
 BinaryImage
 PageLayoutEstimator::removeGarbageAnd2xDownscale(
-	BinaryImage const& image, DebugImages* dbg)
+	BinaryImage const& image,
+	FilterData const* const shared_data, DebugImages* dbg)
 {
-	BinaryImage reduced(ReduceThreshold(image)(2));
+	// When \p image is the shared full-size binarization, build its
+	// first reduction through the shared analysis, so that the stages
+	// that follow (deskew in particular) get it for free.
+	BinaryImage reduced(
+		shared_data ? shared_data->reducedBinary(1)
+		: BinaryImage(ReduceThreshold(image)(2))
+	);
 	if (dbg) {
 		dbg->add(reduced, "reduced");
 	}
@@ -28,6 +28,7 @@
 class QRect;
 class QPoint;
 class QImage;
+class FilterData;
 class QTransform;
 class ImageTransformation;
 class DebugImages;
@@ -59,6 +60,10 @@ public:
 	 *        The resulting page layout will be in transformed coordinates.
 	 * \param bw_threshold The global binarization threshold for the
 	 *        input image.
+	 * \param shared_data If provided, must refer to the same image,
+	 *        transformation and threshold as the other arguments.
+	 *        Lets this function reuse binarizations already built by
+	 *        other stages instead of redoing them.  May be null.
 	 * \param dbg An optional sink for debugging images.
 	 * \return The estimated PageLayout of type consistent with the
 	 *         requested layout type.
@@ -67,8 +72,14 @@ public:
 		LayoutType layout_type, QImage const& input,
 		ImageTransformation const& pre_xform,
 		imageproc::BinaryThreshold bw_threshold,
+		FilterData const* shared_data = 0,
 		DebugImages* dbg = 0);
 private:
+	static std::auto_ptr<PageLayout> screenForObviousLayout(
+		LayoutType layout_type, QImage const& input,
+		ImageTransformation const& pre_xform,
+		imageproc::BinaryThreshold bw_threshold, DebugImages* dbg);
+
 	static std::auto_ptr<PageLayout> tryCutAtFoldingLine(
 		LayoutType layout_type, QImage const& input,
 		ImageTransformation const& pre_xform, DebugImages* dbg);
@@ -77,7 +88,7 @@ private:
 		LayoutType layout_type, QImage const& input,
 		ImageTransformation const& pre_xform,
 		imageproc::BinaryThreshold const bw_threshold,
-		DebugImages* dbg);
+		FilterData const* shared_data, DebugImages* dbg);
 	
 	static PageLayout cutAtWhitespaceDeskewed150(
 		LayoutType layout_type, int num_pages,
@@ -86,10 +97,12 @@ private:
 	
 	static imageproc::BinaryImage to300DpiBinary(
 		QImage const& img, QTransform& xform,
-		imageproc::BinaryThreshold threshold);
+		imageproc::BinaryThreshold threshold,
+		FilterData const* shared_data);
 	
 	static imageproc::BinaryImage removeGarbageAnd2xDownscale(
-		imageproc::BinaryImage const& image, DebugImages* dbg);
+		imageproc::BinaryImage const& image,
+		FilterData const* shared_data, DebugImages* dbg);
 	
 	static bool checkForLeftOffcut(imageproc::BinaryImage const& image);
 	
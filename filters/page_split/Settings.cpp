@@ -17,6 +17,7 @@
 */
 
 #include "Settings.h"
+#include "ProjectDirtyTracker.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
 #include <QMutexLocker>
@@ -72,6 +73,7 @@ Settings::defaultLayoutType() const
 void
 Settings::setLayoutTypeForAllPages(LayoutType const layout_type)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker locker(&m_mutex);
 	
 	PerPageRecords::iterator it(m_perPageRecords.begin());
@@ -91,6 +93,7 @@ Settings::setLayoutTypeForAllPages(LayoutType const layout_type)
 void
 Settings::setLayoutTypeFor(LayoutType const layout_type, std::set<PageId> const& pages)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker locker(&m_mutex);
 	
 	UpdateAction action;
@@ -122,6 +125,7 @@ Settings::getPageRecordLocked(ImageId const& image_id) const
 void
 Settings::updatePage(ImageId const& image_id, UpdateAction const& action)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker locker(&m_mutex);
 	updatePageLocked(image_id, action);
 }
@@ -39,8 +39,11 @@
 #include "ImageView.h"
 #include "FilterUiInterface.h"
 #include "DebugImages.h"
+#include "AnalysisCache.h"
+#include "AlgorithmVersions.h"
 #include <QImage>
 #include <QObject>
+#include <QDomDocument>
 #include <QDebug>
 #include <memory>
 #include <assert.h>
@@ -48,6 +51,18 @@
 namespace page_split
 {
 
+namespace
+{
+
+QString depsFingerprint(Dependencies const& deps)
+{
+	QDomDocument doc;
+	doc.appendChild(deps.toXml(doc, "dependencies"));
+	return doc.toString();
+}
+
+} // anonymous namespace
+
 using imageproc::BinaryThreshold;
 
 class Task::UiUpdater : public FilterResult
@@ -135,11 +150,32 @@ Task::process(TaskStatus const& status, FilterData const& data)
 		PageLayout new_layout;
 		
 		if (!params || !deps.compatibleWith(*params)) {
-			new_layout = PageLayoutEstimator::estimatePageLayout(
-				record.combinedLayoutType(),
-				data.grayImage(), data.xform(),
-				data.bwThreshold(), m_ptrDbg.get()
-			);
+			AnalysisCache& analysis_cache = AnalysisCache::instance();
+			QString const analysis_context(depsFingerprint(deps));
+
+			QDomDocument cached_doc;
+			QDomElement cached_el;
+			if (analysis_cache.lookup(
+					m_pageInfo.imageId(), QLatin1String("page-split"),
+					algo_versions::PAGE_LAYOUT_DETECTION, analysis_context,
+					cached_doc, cached_el)) {
+				// Same scan, same inputs, same algorithm - the
+				// previously estimated layout is still valid.
+				new_layout = PageLayout(cached_el);
+			} else {
+				new_layout = PageLayoutEstimator::estimatePageLayout(
+					record.combinedLayoutType(),
+					data.grayImage(), data.xform(),
+					data.bwThreshold(), &data, m_ptrDbg.get()
+				);
+
+				QDomDocument doc;
+				analysis_cache.store(
+					m_pageInfo.imageId(), QLatin1String("page-split"),
+					algo_versions::PAGE_LAYOUT_DETECTION, analysis_context,
+					new_layout.toXml(doc, "layout")
+				);
+			}
 			status.throwIfCancelled();
 		} else if (params->pageLayout().uncutOutline().isEmpty()) {
 			// Backwards compatibility with versions < 0.9.9
@@ -41,6 +41,7 @@
 #include <Qt>
 #include <QDebug>
 #include <list>
+#include <vector>
 #include <algorithm>
 #include <math.h>
 
@@ -152,14 +153,18 @@ VertLineFinder::findLines(
 	int const height = raster_lines.height();
 	uint8_t const* line = raster_lines.data();
 	int const stride = raster_lines.stride();
+	std::vector<HoughLineDetector::Sample> samples;
 	for (int y = 0; y < height; ++y, line += stride) {
 		for (int x = margin; x < x_limit; ++x) {
 			unsigned const val = line[x];
 			if (val > 1) {
-				line_detector.process(x, y, weight_table[val]);
+				samples.push_back(
+					HoughLineDetector::Sample(x, y, weight_table[val])
+				);
 			}
 		}
 	}
+	line_detector.processBatch(samples);
 	
 	unsigned const min_quality = (unsigned)(height * line_thickness * 1.8) + 1;
 	
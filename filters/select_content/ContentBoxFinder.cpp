@@ -110,6 +110,88 @@ struct PreferVertical
 	}
 };
 
+/**
+ * \brief Snap the borders of a detected content box to actual content
+ *        at the original resolution.
+ *
+ * Detection happens at a reduced working resolution, so each border
+ * is only accurate to the downscaling factor.  For every border, this
+ * function binarizes a band of \p margin pixels around it at full
+ * resolution and moves the border to the outermost content pixel
+ * within that band.  Borders with no content in their band are left
+ * where they are.
+ *
+ * \param virt_rect The detected box in virtual coordinates, i.e. in
+ *        the coordinate system of data.xform().
+ */
+QRect refineEdgesAtFullRes(
+	TaskStatus const& status, FilterData const& data,
+	QRect const& virt_rect, int const margin)
+{
+	QRect const virt_bounds(data.xform().resultingRect().toRect());
+	QRect refined(virt_rect);
+
+	enum Edge { LEFT_EDGE, RIGHT_EDGE, TOP_EDGE, BOTTOM_EDGE };
+
+	for (int edge = LEFT_EDGE; edge <= BOTTOM_EDGE; ++edge) {
+		QRect band(refined);
+		switch (edge) {
+			case LEFT_EDGE:
+				band.setRight(refined.left() + margin);
+				band.setLeft(refined.left() - margin);
+				break;
+			case RIGHT_EDGE:
+				band.setLeft(refined.right() - margin);
+				band.setRight(refined.right() + margin);
+				break;
+			case TOP_EDGE:
+				band.setBottom(refined.top() + margin);
+				band.setTop(refined.top() - margin);
+				break;
+			case BOTTOM_EDGE:
+				band.setTop(refined.bottom() - margin);
+				band.setBottom(refined.bottom() + margin);
+				break;
+		}
+		band &= virt_bounds;
+		if (band.isEmpty()) {
+			continue;
+		}
+
+		BinaryImage const bw_band(
+			transformToGray(
+				data.grayImage(), data.xform().transform(), band,
+				OutsidePixels::assumeColor(Qt::white)
+			),
+			data.bwThreshold()
+		);
+
+		status.throwIfCancelled();
+
+		QRect const content(bw_band.contentBoundingBox());
+		if (content.isNull()) {
+			continue;
+		}
+
+		switch (edge) {
+			case LEFT_EDGE:
+				refined.setLeft(band.left() + content.left());
+				break;
+			case RIGHT_EDGE:
+				refined.setRight(band.left() + content.right());
+				break;
+			case TOP_EDGE:
+				refined.setTop(band.top() + content.top());
+				break;
+			case BOTTOM_EDGE:
+				refined.setBottom(band.top() + content.bottom());
+				break;
+		}
+	}
+
+	return refined;
+}
+
 } // anonymous namespace
 
 QRectF
@@ -441,7 +523,24 @@ ContentBoxFinder::findContentBox(
 	// Transform back from 150dpi.
 	QTransform combined_xform(xform_150dpi.transform().inverted());
 	combined_xform *= data.xform().transform();
-	return combined_xform.map(QRectF(content_rect)).boundingRect();
+	QRectF const virt_rect(combined_xform.map(QRectF(content_rect)).boundingRect());
+	if (content_rect.isEmpty()) {
+		return virt_rect;
+	}
+
+	// The borders we've detected are only accurate to one pixel at the
+	// working resolution.  Snap them to actual content at full resolution.
+	QPointF const origin(combined_xform.map(QPointF(0, 0)));
+	QPointF const unit_x(combined_xform.map(QPointF(1, 0)) - origin);
+	QPointF const unit_y(combined_xform.map(QPointF(0, 1)) - origin);
+	int const margin = (int)ceil(
+		std::max(
+			sqrt(unit_x.x() * unit_x.x() + unit_x.y() * unit_x.y()),
+			sqrt(unit_y.x() * unit_y.x() + unit_y.y() * unit_y.y())
+		)
+	);
+
+	return QRectF(refineEdgesAtFullRes(status, data, virt_rect.toRect(), margin));
 }
 
 namespace
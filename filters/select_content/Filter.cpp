@@ -44,15 +44,10 @@ namespace select_content
 
 Filter::Filter(
 	PageSelectionAccessor const& page_selection_accessor)
-:	m_ptrSettings(new Settings),
+:	m_pageSelectionAccessor(page_selection_accessor),
+	m_ptrSettings(new Settings),
 	m_selectedPageOrder(0)
 {
-	if (CommandLine::get().isGui()) {
-		m_ptrOptionsWidget.reset(
-			new OptionsWidget(m_ptrSettings, page_selection_accessor)
-		);
-	}
-
 	typedef PageOrderOption::ProviderPtr ProviderPtr;
 
 	ProviderPtr const default_order;
@@ -104,11 +99,24 @@ Filter::performRelinking(AbstractRelinker const& relinker)
 	m_ptrSettings->performRelinking(relinker);
 }
 
+OptionsWidget*
+Filter::optionsWidget()
+{
+	// Built lazily, on first stage activation.
+	if (!m_ptrOptionsWidget.get() && CommandLine::get().isGui()) {
+		m_ptrOptionsWidget.reset(
+			new OptionsWidget(m_ptrSettings, m_pageSelectionAccessor)
+		);
+	}
+	return m_ptrOptionsWidget.get();
+}
+
 void
 Filter::preUpdateUI(FilterUiInterface* ui, PageId const& page_id)
 {
-	m_ptrOptionsWidget->preUpdateUI(page_id);
-	ui->setOptionsWidget(m_ptrOptionsWidget.get(), ui->KEEP_OWNERSHIP);
+	OptionsWidget* const opt_widget = optionsWidget();
+	opt_widget->preUpdateUI(page_id);
+	ui->setOptionsWidget(opt_widget, ui->KEEP_OWNERSHIP);
 }
 
 QDomElement
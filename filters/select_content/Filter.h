@@ -25,6 +25,7 @@
 #include "IntrusivePtr.h"
 #include "FilterResult.h"
 #include "SafeDeletingQObjectPtr.h"
+#include "PageSelectionAccessor.h"
 #include "PageOrderOption.h"
 #include <QCoreApplication>
 #include <vector>
@@ -84,7 +85,11 @@ public:
 	IntrusivePtr<CacheDrivenTask> createCacheDrivenTask(
 		IntrusivePtr<page_layout::CacheDrivenTask> const& next_task);
 	
-	OptionsWidget* optionsWidget() { return m_ptrOptionsWidget.get(); };
+	/**
+	 * In GUI mode, creates the widget on first call.
+	 * Returns null in CLI mode.
+	 */
+	OptionsWidget* optionsWidget();
 	Settings* getSettings() { return m_ptrSettings.get(); };
 private:
 	void writePageSettings(
@@ -92,6 +97,7 @@ private:
 		PageId const& page_id, int numeric_id) const;
 	
 	
+	PageSelectionAccessor m_pageSelectionAccessor;
 	IntrusivePtr<Settings> m_ptrSettings;
 	SafeDeletingQObjectPtr<OptionsWidget> m_ptrOptionsWidget;
 	std::vector<PageOrderOption> m_pageOrderOptions;
@@ -18,6 +18,7 @@
 
 #include "OrderByWidthProvider.h"
 #include "Params.h"
+#include <boost/foreach.hpp>
 #include <QSizeF>
 #include <memory>
 
@@ -34,18 +35,9 @@ OrderByWidthProvider::precedes(
 	PageId const& lhs_page, bool const lhs_incomplete,
 	PageId const& rhs_page, bool const rhs_incomplete) const
 {
-	std::auto_ptr<Params> const lhs_params(m_ptrSettings->getPageParams(lhs_page));
-	std::auto_ptr<Params> const rhs_params(m_ptrSettings->getPageParams(rhs_page));
-	
-	QSizeF lhs_size;
-	if (lhs_params.get()) {
-		lhs_size = lhs_params->contentSizeMM();
-	}
-	QSizeF rhs_size;
-	if (rhs_params.get()) {
-		rhs_size = rhs_params->contentSizeMM();
-	}
-	
+	QSizeF const lhs_size(contentSize(lhs_page));
+	QSizeF const rhs_size(contentSize(rhs_page));
+
 	bool const lhs_valid = !lhs_incomplete && lhs_size.isValid();
 	bool const rhs_valid = !rhs_incomplete && rhs_size.isValid();
 
@@ -57,4 +49,41 @@ OrderByWidthProvider::precedes(
 	return lhs_size.width() < rhs_size.width();
 }
 
+void
+OrderByWidthProvider::precomputeKeys(std::vector<PageId> const& pages) const
+{
+	m_keyCache.clear();
+	BOOST_FOREACH(PageId const& page, pages) {
+		m_keyCache[page] = loadContentSize(page);
+	}
+}
+
+void
+OrderByWidthProvider::releaseKeys() const
+{
+	m_keyCache.clear();
+}
+
+QSizeF
+OrderByWidthProvider::contentSize(PageId const& page) const
+{
+	std::map<PageId, QSizeF>::const_iterator const it(m_keyCache.find(page));
+	if (it != m_keyCache.end()) {
+		return it->second;
+	}
+	return loadContentSize(page);
+}
+
+QSizeF
+OrderByWidthProvider::loadContentSize(PageId const& page) const
+{
+	std::auto_ptr<Params> const params(m_ptrSettings->getPageParams(page));
+
+	QSizeF size;
+	if (params.get()) {
+		size = params->contentSizeMM();
+	}
+	return size;
+}
+
 } // namespace select_content
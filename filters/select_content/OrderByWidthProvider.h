@@ -22,6 +22,9 @@
 #include "Settings.h"
 #include "IntrusivePtr.h"
 #include "PageOrderProvider.h"
+#include "PageId.h"
+#include <QSizeF>
+#include <map>
 
 namespace select_content
 {
@@ -34,8 +37,17 @@ public:
 	virtual bool precedes(
 		PageId const& lhs_page, bool lhs_incomplete,
 		PageId const& rhs_page, bool rhs_incomplete) const;
+
+	virtual void precomputeKeys(std::vector<PageId> const& pages) const;
+
+	virtual void releaseKeys() const;
 private:
+	QSizeF contentSize(PageId const& page) const;
+
+	QSizeF loadContentSize(PageId const& page) const;
+
 	IntrusivePtr<Settings> m_ptrSettings;
+	mutable std::map<PageId, QSizeF> m_keyCache;
 };
 
 } // namespace select_content
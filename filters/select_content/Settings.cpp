@@ -17,6 +17,7 @@
 */
 
 #include "Settings.h"
+#include "ProjectDirtyTracker.h"
 #include "Utils.h"
 #include "RelinkablePath.h"
 #include "AbstractRelinker.h"
@@ -62,6 +63,7 @@ Settings::performRelinking(AbstractRelinker const& relinker)
 void
 Settings::setPageParams(PageId const& page_id, Params const& params)
 {
+	ProjectDirtyTracker::noteModified();
 	QMutexLocker locker(&m_mutex);
 	Utils::mapSetValue(m_pageParams, page_id, params);
 }
@@ -33,13 +33,28 @@
 #include "ImageTransformation.h"
 #include "PhysSizeCalc.h"
 #include "filters/page_layout/Task.h"
+#include "AnalysisCache.h"
+#include "AlgorithmVersions.h"
 #include <QObject>
 #include <QTransform>
+#include <QDomDocument>
 #include <QDebug>
 
 namespace select_content
 {
 
+namespace
+{
+
+QString depsFingerprint(Dependencies const& deps)
+{
+	QDomDocument doc;
+	doc.appendChild(deps.toXml(doc, "dependencies"));
+	return doc.toString();
+}
+
+} // anonymous namespace
+
 class Task::UiUpdater : public FilterResult
 {
 public:
@@ -122,11 +137,40 @@ Task::process(TaskStatus const& status, FilterData const& data)
 			m_ptrSettings->setPageParams(m_pageId, new_params);
 		}
 	} else {
-		QRectF const content_rect(
-			ContentBoxFinder::findContentBox(
+		AnalysisCache& analysis_cache = AnalysisCache::instance();
+		QString const analysis_context(depsFingerprint(deps));
+
+		QRectF content_rect;
+		QDomDocument cached_doc;
+		QDomElement cached_el;
+		if (analysis_cache.lookup(
+				m_pageId.imageId(), QLatin1String("select-content"),
+				algo_versions::CONTENT_BOX_DETECTION, analysis_context,
+				cached_doc, cached_el)) {
+			// Same scan, same inputs, same algorithm - the
+			// previously detected box is still valid.
+			content_rect = QRectF(
+				cached_el.attribute("x").toDouble(),
+				cached_el.attribute("y").toDouble(),
+				cached_el.attribute("width").toDouble(),
+				cached_el.attribute("height").toDouble()
+			);
+		} else {
+			content_rect = ContentBoxFinder::findContentBox(
 				status, data, m_ptrDbg.get()
-			)
-		);
+			);
+
+			QDomDocument doc;
+			QDomElement el(doc.createElement("content-box"));
+			el.setAttribute("x", QString::number(content_rect.x(), 'g', 16));
+			el.setAttribute("y", QString::number(content_rect.y(), 'g', 16));
+			el.setAttribute("width", QString::number(content_rect.width(), 'g', 16));
+			el.setAttribute("height", QString::number(content_rect.height(), 'g', 16));
+			analysis_cache.store(
+				m_pageId.imageId(), QLatin1String("select-content"),
+				algo_versions::CONTENT_BOX_DETECTION, analysis_context, el
+			);
+		}
 		ui_data.setContentRect(content_rect);
 		ui_data.setDependencies(deps);
 		ui_data.setMode(MODE_AUTO);
@@ -0,0 +1,147 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChunkCache.h"
+#include <QThreadStorage>
+#include <map>
+
+namespace
+{
+
+/** Don't cache buffers above this size - they aren't chunk churn. */
+size_t const MAX_CACHEABLE_BYTES = 64 * 1024;
+
+/** Don't let a thread's freelist grow beyond this many bytes. */
+size_t const CACHE_LIMIT = 4 * 1024 * 1024;
+
+class ThreadCache
+{
+public:
+	ThreadCache() : m_cachedBytes(0) {}
+
+	~ThreadCache();
+
+	/**
+	 * Takes a cached buffer of exactly the given size, or returns null.
+	 */
+	void* take(size_t num_bytes);
+
+	/**
+	 * Caches a buffer, or returns false if the cache is full.
+	 */
+	bool put(void* buf, size_t num_bytes);
+private:
+	/**
+	 * Released buffers of the same size form a singly linked list
+	 * threaded through their first bytes.  Only buffers of at
+	 * least sizeof(void*) bytes are cached.
+	 */
+	typedef std::map<size_t, void*> FreeMap;
+
+	FreeMap m_freeLists;
+	size_t m_cachedBytes;
+};
+
+
+QThreadStorage<ThreadCache*> thread_cache;
+
+
+ThreadCache::~ThreadCache()
+{
+	FreeMap::const_iterator it(m_freeLists.begin());
+	FreeMap::const_iterator const end(m_freeLists.end());
+	for (; it != end; ++it) {
+		void* buf = it->second;
+		while (buf) {
+			void* const next = *(void**)buf;
+			delete[] (char*)buf;
+			buf = next;
+		}
+	}
+}
+
+void*
+ThreadCache::take(size_t const num_bytes)
+{
+	FreeMap::iterator const it(m_freeLists.find(num_bytes));
+	if (it == m_freeLists.end()) {
+		return 0;
+	}
+
+	void* const buf = it->second;
+	it->second = *(void**)buf;
+	if (!it->second) {
+		m_freeLists.erase(it);
+	}
+	m_cachedBytes -= num_bytes;
+
+	return buf;
+}
+
+bool
+ThreadCache::put(void* const buf, size_t const num_bytes)
+{
+	if (num_bytes < sizeof(void*) || num_bytes > MAX_CACHEABLE_BYTES) {
+		return false;
+	}
+	if (m_cachedBytes + num_bytes > CACHE_LIMIT) {
+		return false;
+	}
+
+	void*& head = m_freeLists[num_bytes];
+	*(void**)buf = head;
+	head = buf;
+	m_cachedBytes += num_bytes;
+
+	return true;
+}
+
+} // anonymous namespace
+
+
+void*
+ChunkCache::acquire(size_t const num_bytes)
+{
+	ThreadCache* cache = thread_cache.localData();
+	if (!cache) {
+		cache = new ThreadCache;
+		thread_cache.setLocalData(cache);
+	}
+
+	if (void* const buf = cache->take(num_bytes)) {
+		return buf;
+	}
+
+	return new char[num_bytes];
+}
+
+void
+ChunkCache::release(void* const buf, size_t const num_bytes)
+{
+	if (!buf) {
+		return;
+	}
+
+	if (ThreadCache* const cache = thread_cache.localData()) {
+		if (cache->put(buf, num_bytes)) {
+			return;
+		}
+	}
+
+	delete[] (char*)buf;
+}
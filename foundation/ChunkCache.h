@@ -0,0 +1,61 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNK_CACHE_H_
+#define CHUNK_CACHE_H_
+
+#include "NonCopyable.h"
+#include <stddef.h>
+
+/**
+ * \brief A per-thread freelist of small raw buffers.
+ *
+ * Queue-like containers, such as FastQueue, keep allocating and
+ * freeing chunks of the same few sizes as their contents flow
+ * through.  This cache keeps a bounded number of released buffers
+ * per thread, so the next chunk of the same size is a freelist pop
+ * rather than a heap allocation.  The freelist persists for the
+ * lifetime of the thread, so repeated work items, like pages in a
+ * batch run, don't pay allocation warm-up again and again.
+ */
+class ChunkCache
+{
+	DECLARE_NON_COPYABLE(ChunkCache)
+public:
+	/**
+	 * \brief Returns a buffer of exactly the requested size.
+	 *
+	 * Recycles a cached buffer if one of that size is available
+	 * on the current thread, otherwise allocates a fresh one.
+	 * Never returns null - allocation failures throw std::bad_alloc.
+	 */
+	static void* acquire(size_t num_bytes);
+
+	/**
+	 * \brief Releases a buffer obtained from acquire().
+	 *
+	 * The buffer goes to the current thread's freelist if there
+	 * is room, otherwise it's freed.  \p num_bytes must be the
+	 * same value that was passed to acquire().
+	 */
+	static void release(void* buf, size_t num_bytes);
+private:
+	ChunkCache();
+};
+
+#endif
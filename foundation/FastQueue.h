@@ -20,6 +20,7 @@
 #define FAST_QUEUE_H_
 
 #include "NonCopyable.h"
+#include "ChunkCache.h"
 #include <boost/intrusive/list.hpp>
 #include <boost/type_traits/alignment_of.hpp>
 #include <boost/foreach.hpp>
@@ -55,13 +56,13 @@ private:
 	{
 		DECLARE_NON_COPYABLE(Chunk)
 	public:
-		Chunk(size_t capacity) {
+		Chunk(size_t capacity) : storageBytes(storageRequirement(capacity)) {
 			uintptr_t const p = (uintptr_t)(this + 1);
 			size_t const alignment = boost::alignment_of<T>::value;
 			pBegin = (T*)(((p + alignment - 1) / alignment) * alignment);
 			pEnd = pBegin;
 			pBufferEnd = pBegin + capacity;
-			assert(size_t((char*)pBufferEnd - (char*)this) <= storageRequirement(capacity));
+			assert(size_t((char*)pBufferEnd - (char*)this) <= storageBytes);
 		}
 
 		~Chunk() {
@@ -77,14 +78,16 @@ private:
 		T* pBegin;
 		T* pEnd;
 		T* pBufferEnd;
+		size_t storageBytes;
 		// An implicit array of T follows.
 	};
 
 	struct ChunkDisposer
 	{
 		void operator()(Chunk* chunk) {
+			size_t const storage_bytes = chunk->storageBytes;
 			chunk->~Chunk();
-			delete[] (char*)chunk;
+			ChunkCache::release(chunk, storage_bytes);
 		}
 	};
 
@@ -134,8 +137,8 @@ FastQueue<T>::push(T const& t)
 	}
 
 	if (!chunk) {
-		// Create a new chunk.
-		char* buf = new char[Chunk::storageRequirement(m_chunkCapacity)];
+		// Create a new chunk, recycling a recently freed one if possible.
+		void* buf = ChunkCache::acquire(Chunk::storageRequirement(m_chunkCapacity));
 		chunk = new(buf) Chunk(m_chunkCapacity);
 		m_chunkList.push_back(*chunk);
 	}
@@ -20,11 +20,27 @@
 #define GRID_H_
 
 #include <boost/scoped_array.hpp>
+#include <stddef.h>
+#include <stdint.h>
 
 template<typename Node>
 class Grid
 {
 public:
+	enum Alignment {
+		/** Rows are stored back to back, with the exact stride. */
+		ALIGN_DEFAULT,
+
+		/**
+		 * The stride is padded to a whole number of cache lines
+		 * and rows of unpadded data start on cache line boundaries,
+		 * so vector kernels may assume aligned access and process
+		 * whole rows without scalar tails.  Best effort if
+		 * sizeof(Node) doesn't divide the cache line size.
+		 */
+		ALIGN_CACHE_LINES
+	};
+
 	/**
 	 * Creates a null grid.
 	 */
@@ -33,7 +49,7 @@ public:
 	/**
 	 * \brief Creates a width x height grid with specified padding on each side.
 	 */
-	Grid(int width, int height, int padding);
+	Grid(int width, int height, int padding, Alignment alignment = ALIGN_DEFAULT);
 
 	/**
 	 * \brief Creates a deep copy of another grid including padding.
@@ -42,6 +58,14 @@ public:
 	 */
 	Grid(Grid const& other);
 
+	/**
+	 * \brief Performs a deep copy of another grid.
+	 *
+	 * When the source grid is no longer needed, prefer swap()
+	 * to transfer ownership without copying.
+	 */
+	Grid& operator=(Grid const& other);
+
 	bool isNull() const { return m_width <= 0 || m_height <= 0; }
 
 	void initPadding(Node const& padding_node);
@@ -61,12 +85,25 @@ public:
 	/**
 	 * \brief Returns a pointer to the beginning of padded data.
 	 */
-	Node* paddedData() { return m_storage.get(); }
+	Node* paddedData() { return m_pPaddedData; }
 
 	/**
 	 * \brief Returns a pointer to the beginning of padded data.
 	 */
-	Node const* paddedData() const { return m_storage.get(); }
+	Node const* paddedData() const { return m_pPaddedData; }
+
+	/**
+	 * \brief Returns a pointer to the beginning of an unpadded row.
+	 *
+	 * For ALIGN_CACHE_LINES grids, the returned pointer is cache
+	 * line aligned.
+	 */
+	Node* row(int y) { return m_pData + y * m_stride; }
+
+	/**
+	 * \brief Returns a pointer to the beginning of an unpadded row.
+	 */
+	Node const* row(int y) const { return m_pData + y * m_stride; }
 
 	/**
 	 * Returns the number of nodes in a row, including padding nodes.
@@ -90,13 +127,24 @@ public:
 
 	void swap(Grid& other);
 private:
+	enum { CACHE_LINE_BYTES = 64 };
+
 	template<typename T>
 	static void basicSwap(T& o1, T& o2) {
 		// Just to avoid incoduing the heavy <algorithm> header.
 		T tmp(o1); o1 = o2; o2 = tmp;
 	}
 
+	/**
+	 * Allocates storage for the current width / height / stride /
+	 * padding, setting up m_pPaddedData and m_pData.  With
+	 * ALIGN_CACHE_LINES, also rounds m_stride up and shifts the
+	 * base so that unpadded rows start on cache line boundaries.
+	 */
+	void allocate(Alignment alignment);
+
 	boost::scoped_array<Node> m_storage;
+	Node* m_pPaddedData;
 	Node* m_pData;
 	int m_width;
 	int m_height;
@@ -107,7 +155,8 @@ private:
 
 template<typename Node>
 Grid<Node>::Grid()
-:	m_pData(0),
+:	m_pPaddedData(0),
+	m_pData(0),
 	m_width(0),
 	m_height(0),
 	m_stride(0),
@@ -116,31 +165,83 @@ Grid<Node>::Grid()
 }
 
 template<typename Node>
-Grid<Node>::Grid(int width, int height, int padding)
-:	m_storage(new Node[(width + padding*2) * (height + padding*2)]),
-	m_pData(m_storage.get() + (width + padding*2)*padding + padding),
+Grid<Node>::Grid(int width, int height, int padding, Alignment const alignment)
+:	m_pPaddedData(0),
+	m_pData(0),
 	m_width(width),
 	m_height(height),
 	m_stride(width + padding*2),
 	m_padding(padding)
 {
+	allocate(alignment);
 }
 
 template<typename Node>
 Grid<Node>::Grid(Grid const& other)
-:	m_storage(new Node[(other.stride() * (other.height() + other.padding() * 2))]),
-	m_pData(m_storage.get() + other.stride()*other.padding() + other.padding()),
+:	m_pPaddedData(0),
+	m_pData(0),
 	m_width(other.width()),
 	m_height(other.height()),
 	m_stride(other.stride()),
 	m_padding(other.padding())
 {
+	// Preserve the alignment mode of the original.
+	bool const was_aligned =
+		(other.m_stride * sizeof(Node)) % CACHE_LINE_BYTES == 0 &&
+		(uintptr_t(other.m_pData) & (CACHE_LINE_BYTES - 1)) == 0;
+	allocate(was_aligned ? ALIGN_CACHE_LINES : ALIGN_DEFAULT);
+
 	int const len = m_stride * (m_height + m_padding * 2);
+	Node* dst = m_pPaddedData;
+	Node const* src = other.m_pPaddedData;
 	for (int i = 0; i < len; ++i) {
-		m_storage[i] = other.m_storage[i];
+		dst[i] = src[i];
 	}
 }
 
+template<typename Node>
+void
+Grid<Node>::allocate(Alignment const alignment)
+{
+	if (alignment == ALIGN_CACHE_LINES) {
+		// Bounded, as the stride in bytes gains CACHE_LINE_BYTES
+		// worth of divisors at the latest.
+		while ((m_stride * sizeof(Node)) % CACHE_LINE_BYTES != 0) {
+			++m_stride;
+		}
+	}
+
+	size_t const num_nodes = size_t(m_stride) * (m_height + m_padding * 2);
+	size_t const slack = alignment == ALIGN_CACHE_LINES ? CACHE_LINE_BYTES : 0;
+	m_storage.reset(new Node[num_nodes + slack]);
+
+	Node* base = m_storage.get();
+	size_t const data_offset = size_t(m_stride) * m_padding + m_padding;
+	if (alignment == ALIGN_CACHE_LINES) {
+		Node* const limit = base + slack;
+		while (base != limit
+				&& (uintptr_t(base + data_offset) & (CACHE_LINE_BYTES - 1)) != 0) {
+			++base;
+		}
+		if (base == limit) {
+			// sizeof(Node) doesn't permit cache line alignment
+			// from this allocation.  Fall back gracefully.
+			base = m_storage.get();
+		}
+	}
+
+	m_pPaddedData = base;
+	m_pData = base + data_offset;
+}
+
+template<typename Node>
+Grid<Node>&
+Grid<Node>::operator=(Grid const& other)
+{
+	Grid(other).swap(*this);
+	return *this;
+}
+
 template<typename Node>
 void
 Grid<Node>::initPadding(Node const& padding_node)
@@ -150,7 +251,7 @@ Grid<Node>::initPadding(Node const& padding_node)
 		return;
 	}
 
-	Node* line = m_storage.get();
+	Node* line = m_pPaddedData;
 	for (int row = 0; row < m_padding; ++row) {
 		for (int x = 0; x < m_stride; ++x) {
 			line[x] = padding_node;
@@ -194,6 +295,7 @@ void
 Grid<Node>::swap(Grid& other)
 {
 	m_storage.swap(other.m_storage);
+	basicSwap(m_pPaddedData, other.m_pPaddedData);
 	basicSwap(m_pData, other.m_pData);
 	basicSwap(m_width, other.m_width);
 	basicSwap(m_height, other.m_height);
@@ -33,10 +33,26 @@ private:
 	};
 	typedef int BooleanTestHelper::*BooleanTest;
 public:
+	/**
+	 * Tag for the reference-adopting constructor.
+	 */
+	enum AdoptTag { ADOPT };
+
 	IntrusivePtr() : m_pObj(0) {}
-	
+
 	explicit
 	IntrusivePtr(T* obj);
+
+	/**
+	 * \brief Takes over a reference the caller already holds.
+	 *
+	 * The counter is not touched: the caller's reference becomes
+	 * ours.  This is the closest thing we have to a move, and the
+	 * way to take objects out of containers that track references
+	 * manually without a needless increment-decrement pair on a
+	 * contended counter.
+	 */
+	IntrusivePtr(T* obj, AdoptTag) : m_pObj(obj) {}
 	
 	IntrusivePtr(IntrusivePtr const& other);
 	
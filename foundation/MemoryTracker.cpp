@@ -0,0 +1,244 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MemoryTracker.h"
+#include <QMutexLocker>
+#include <QTextStream>
+#if defined(__linux__)
+#include <QFile>
+#include <QStringList>
+#endif
+
+namespace
+{
+
+/**
+ * Resets the kernel's peak RSS watermark for this process, so the
+ * next reading reflects only what happened since.  Requires Linux 4.0
+ * or later; silently does nothing elsewhere.
+ */
+void resetRssPeak()
+{
+#if defined(__linux__)
+	QFile file("/proc/self/clear_refs");
+	if (file.open(QIODevice::WriteOnly)) {
+		file.write("5");
+	}
+#endif
+}
+
+/**
+ * The process peak RSS in bytes (VmHWM), or -1 where unavailable.
+ */
+qint64 rssPeakBytes()
+{
+#if defined(__linux__)
+	QFile file("/proc/self/status");
+	if (file.open(QIODevice::ReadOnly)) {
+		for (;;) {
+			QString const line(QString::fromAscii(file.readLine()));
+			if (line.isEmpty()) {
+				break;
+			}
+			if (line.startsWith("VmHWM:")) {
+				QStringList const parts(
+					line.mid(6).simplified().split(' ')
+				);
+				if (!parts.isEmpty()) {
+					return parts.front().toLongLong() * 1024;
+				}
+			}
+		}
+	}
+#endif
+	return -1;
+}
+
+QString formatMB(qint64 const bytes)
+{
+	if (bytes < 0) {
+		return "n/a";
+	}
+	return QString("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
+} // anonymous namespace
+
+
+MemoryTracker::MemoryTracker()
+:	m_liveBytes(0),
+	m_peakBytes(0),
+	m_stageTrackedPeak(0),
+	m_maxRssBytes(-1),
+	m_stageOpen(false)
+{
+}
+
+MemoryTracker&
+MemoryTracker::instance()
+{
+	// Depending on the compiler, this may not be thread-safe.
+	// However, the first call happens early on, from the GUI thread,
+	// before any worker threads get a chance to report allocations.
+	static MemoryTracker object;
+	return object;
+}
+
+void
+MemoryTracker::add(size_t const bytes)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	m_liveBytes += qint64(bytes);
+	if (m_liveBytes > m_peakBytes) {
+		m_peakBytes = m_liveBytes;
+	}
+	if (m_liveBytes > m_stageTrackedPeak) {
+		m_stageTrackedPeak = m_liveBytes;
+	}
+}
+
+void
+MemoryTracker::remove(size_t const bytes)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_liveBytes -= qint64(bytes);
+}
+
+qint64
+MemoryTracker::liveBytes() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_liveBytes;
+}
+
+qint64
+MemoryTracker::peakBytes() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_peakBytes;
+}
+
+qint64
+MemoryTracker::maxRssBytes() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_maxRssBytes;
+}
+
+void
+MemoryTracker::beginStage(QString const& name)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (m_stageOpen) {
+		endStageLocked();
+	}
+
+	m_currentStage = name;
+	m_stageTrackedPeak = m_liveBytes;
+	m_stageOpen = true;
+
+	resetRssPeak();
+}
+
+void
+MemoryTracker::endStage()
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (m_stageOpen) {
+		endStageLocked();
+	}
+}
+
+void
+MemoryTracker::endStageLocked()
+{
+	StageStats stats;
+	stats.trackedPeakBytes = m_stageTrackedPeak;
+	stats.rssPeakBytes = rssPeakBytes();
+
+	if (stats.rssPeakBytes > m_maxRssBytes) {
+		m_maxRssBytes = stats.rssPeakBytes;
+	}
+
+	// Merge repeated stages (benchmark runs, reprocessing)
+	// by keeping the worse of the two watermarks.
+	StageList::iterator it(m_stages.begin());
+	StageList::iterator const end(m_stages.end());
+	for (; it != end; ++it) {
+		if (it->first == m_currentStage) {
+			break;
+		}
+	}
+	if (it != end) {
+		StageStats& existing = it->second;
+		if (stats.trackedPeakBytes > existing.trackedPeakBytes) {
+			existing.trackedPeakBytes = stats.trackedPeakBytes;
+		}
+		if (stats.rssPeakBytes > existing.rssPeakBytes) {
+			existing.rssPeakBytes = stats.rssPeakBytes;
+		}
+	} else {
+		m_stages.push_back(
+			std::make_pair(m_currentStage, stats)
+		);
+	}
+
+	m_stageOpen = false;
+}
+
+QString
+MemoryTracker::report() const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (m_stages.empty() && m_peakBytes == 0) {
+		return QString();
+	}
+
+	QString text;
+	QTextStream strm(&text, QIODevice::WriteOnly);
+
+	StageList::const_iterator it(m_stages.begin());
+	StageList::const_iterator const end(m_stages.end());
+	for (; it != end; ++it) {
+		strm << it->first
+			<< ": image buffers peak=" << formatMB(it->second.trackedPeakBytes);
+		if (it->second.rssPeakBytes >= 0) {
+			strm << " rss peak=" << formatMB(it->second.rssPeakBytes);
+		}
+		strm << "\n";
+	}
+
+	strm << "overall: image buffers peak=" << formatMB(m_peakBytes)
+		<< " live=" << formatMB(m_liveBytes) << "\n";
+
+	return text;
+}
+
+void
+MemoryTracker::reset()
+{
+	QMutexLocker const locker(&m_mutex);
+	m_stages.clear();
+	m_peakBytes = m_liveBytes;
+	m_stageTrackedPeak = m_liveBytes;
+	m_stageOpen = false;
+}
@@ -0,0 +1,133 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MEMORY_TRACKER_H_
+#define MEMORY_TRACKER_H_
+
+#include "NonCopyable.h"
+#include <QMutex>
+#include <QString>
+#include <stddef.h>
+#include <vector>
+#include <utility>
+
+/**
+ * \brief Tracks live image buffer bytes and per-stage high-water marks.
+ *
+ * Two complementary numbers are maintained:
+ *
+ * - "tracked" bytes: buffers explicitly reported with add() / remove().
+ *   Image buffers routed through ImageArena report themselves, so this
+ *   covers BinaryImage exactly.  Buffers owned by QImage can't be
+ *   intercepted and are absent here.
+ *
+ * - the process peak RSS, sampled from the OS per stage (the kernel's
+ *   watermark is reset at beginStage() where the platform allows it,
+ *   currently Linux only).  This sees everything, QImage included,
+ *   but can't be attributed more finely than per stage.
+ *
+ * Together they tell which processing stage drives peak memory and
+ * how much of it scales with --jobs, making it possible to size the
+ * number of parallel jobs against available RAM instead of guessing.
+ */
+class MemoryTracker
+{
+	DECLARE_NON_COPYABLE(MemoryTracker)
+public:
+	static MemoryTracker& instance();
+
+	/**
+	 * \brief Reports \p bytes as allocated.  May be called from any thread.
+	 */
+	void add(size_t bytes);
+
+	/**
+	 * \brief Reports \p bytes as freed.
+	 */
+	void remove(size_t bytes);
+
+	/**
+	 * \brief Currently live tracked bytes.
+	 */
+	qint64 liveBytes() const;
+
+	/**
+	 * \brief The highest liveBytes() seen since the last reset().
+	 */
+	qint64 peakBytes() const;
+
+	/**
+	 * \brief The highest per-stage RSS watermark seen so far.
+	 *
+	 * Unlike the kernel's own watermark, this survives the per-stage
+	 * resets, so it approximates the process-lifetime peak.  -1 where
+	 * RSS sampling is unavailable.  Not affected by reset().
+	 */
+	qint64 maxRssBytes() const;
+
+	/**
+	 * \brief Starts attributing high-water marks to \p name.
+	 *
+	 * Stages don't nest; a beginStage() while another stage is
+	 * open implicitly ends the open one.
+	 */
+	void beginStage(QString const& name);
+
+	/**
+	 * \brief Closes the current stage, recording its watermarks.
+	 */
+	void endStage();
+
+	/**
+	 * \brief A human readable summary: one line per stage plus totals.
+	 *
+	 * Returns an empty string if nothing was recorded.
+	 */
+	QString report() const;
+
+	/**
+	 * \brief Discards the stage records and the peak.  Live bytes persist.
+	 */
+	void reset();
+private:
+	struct StageStats
+	{
+		qint64 trackedPeakBytes;
+		qint64 rssPeakBytes; /**< -1 when unavailable. */
+
+		StageStats() : trackedPeakBytes(0), rssPeakBytes(-1) {}
+	};
+
+	/** Stages in the order they were recorded. */
+	typedef std::vector<std::pair<QString, StageStats> > StageList;
+
+	MemoryTracker();
+
+	void endStageLocked();
+
+	mutable QMutex m_mutex;
+	StageList m_stages;
+	QString m_currentStage;
+	qint64 m_liveBytes;
+	qint64 m_peakBytes;
+	qint64 m_stageTrackedPeak;
+	qint64 m_maxRssBytes;
+	bool m_stageOpen;
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PackBits.h"
+#include <string.h>
+
+void
+packBitsEncode(uint8_t const* const src, int const size, QByteArray& dst)
+{
+	int i = 0;
+	while (i < size) {
+		int run = 1;
+		while (run < 128 && i + run < size && src[i + run] == src[i]) {
+			++run;
+		}
+		if (run >= 2) {
+			dst.append(char(1 - run));
+			dst.append(char(src[i]));
+			i += run;
+			continue;
+		}
+
+		// A literal sequence, cut off where a run of 3 starts.
+		int const literal_start = i;
+		++i;
+		while (i < size && i - literal_start < 128) {
+			if (i + 2 < size && src[i] == src[i + 1]
+					&& src[i] == src[i + 2]) {
+				break;
+			}
+			++i;
+		}
+		dst.append(char(i - literal_start - 1));
+		dst.append((char const*)src + literal_start, i - literal_start);
+	}
+}
+
+bool
+packBitsDecode(
+	uint8_t const* const src, int const src_size,
+	uint8_t* const dst, int const dst_size)
+{
+	int si = 0;
+	int di = 0;
+	while (si < src_size) {
+		int const ctrl = (signed char)src[si++];
+		if (ctrl >= 0) {
+			int const count = ctrl + 1;
+			if (si + count > src_size || di + count > dst_size) {
+				return false;
+			}
+			memcpy(dst + di, src + si, count);
+			si += count;
+			di += count;
+		} else if (ctrl != -128) { // -128 is a no-op by convention.
+			int const count = 1 - ctrl;
+			if (si >= src_size || di + count > dst_size) {
+				return false;
+			}
+			memset(dst + di, src[si++], count);
+			di += count;
+		}
+	}
+	return di == dst_size;
+}
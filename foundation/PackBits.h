@@ -0,0 +1,46 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PACKBITS_H_
+#define PACKBITS_H_
+
+#include <QByteArray>
+#include <stdint.h>
+
+/**
+ * \brief Appends the PackBits coding of a byte sequence to \p dst.
+ *
+ * The PackBits byte-oriented run-length coding: a control byte n in
+ * [0, 127] is followed by n + 1 literal bytes, while n in [-127, -1]
+ * is followed by one byte to be repeated 1 - n times.  Runs of
+ * identical bytes collapse to 2 bytes per 128, incompressible data
+ * expands by at most 1 byte per 128, and both coding and decoding
+ * run at close to memcpy() speed.
+ */
+void packBitsEncode(uint8_t const* src, int size, QByteArray& dst);
+
+/**
+ * \brief Decodes a PackBits stream into a buffer of known size.
+ *
+ * Returns false if the coded stream is malformed or doesn't decode
+ * to exactly \p dst_size bytes.
+ */
+bool packBitsDecode(
+	uint8_t const* src, int src_size, uint8_t* dst, int dst_size);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ProcessStats.h"
+#if defined(__linux__)
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#endif
+
+namespace
+{
+
+#if defined(__linux__)
+/**
+ * Reads a "Key: value" style field from a /proc/self file.
+ * Returns -1 when the file or field is missing.
+ */
+qint64 procSelfField(char const* file_name, char const* key)
+{
+	QFile file(QString("/proc/self/%1").arg(file_name));
+	if (!file.open(QIODevice::ReadOnly)) {
+		return -1;
+	}
+
+	QString const prefix(QString("%1:").arg(key));
+	for (;;) {
+		QString const line(QString::fromAscii(file.readLine()));
+		if (line.isEmpty()) {
+			break;
+		}
+		if (line.startsWith(prefix)) {
+			// The value is the first numeric token; some fields
+			// carry a unit suffix ("kB") after it.
+			QStringList const parts(
+				line.mid(prefix.length()).simplified().split(' ')
+			);
+			if (!parts.isEmpty()) {
+				return parts.front().toLongLong();
+			}
+		}
+	}
+
+	return -1;
+}
+#endif
+
+} // anonymous namespace
+
+
+qint64
+processPeakRssBytes()
+{
+#if defined(__linux__)
+	qint64 const kb = procSelfField("status", "VmHWM");
+	return kb < 0 ? -1 : kb * 1024;
+#else
+	return -1;
+#endif
+}
+
+qint64
+processDiskReadBytes()
+{
+#if defined(__linux__)
+	return procSelfField("io", "read_bytes");
+#else
+	return -1;
+#endif
+}
+
+qint64
+processDiskWriteBytes()
+{
+#if defined(__linux__)
+	return procSelfField("io", "write_bytes");
+#else
+	return -1;
+#endif
+}
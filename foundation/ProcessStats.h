@@ -0,0 +1,50 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROCESS_STATS_H_
+#define PROCESS_STATS_H_
+
+#include <QtGlobal>
+
+/**
+ * \file
+ * \brief Process-level resource counters, as reported by the OS.
+ *
+ * All of these return -1 where the information is unavailable,
+ * which currently means any platform without procfs.
+ */
+
+/**
+ * \brief Peak resident set size of this process, in bytes (VmHWM).
+ */
+qint64 processPeakRssBytes();
+
+/**
+ * \brief Bytes this process actually read from storage.
+ *
+ * Unlike bytes passed to read(), this excludes data served from the
+ * page cache, so it reflects real disk traffic.
+ */
+qint64 processDiskReadBytes();
+
+/**
+ * \brief Bytes this process caused to be written to storage.
+ */
+qint64 processDiskWriteBytes();
+
+#endif
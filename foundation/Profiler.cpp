@@ -0,0 +1,359 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Profiler.h"
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadStorage>
+#include <QTextStream>
+#include <QFile>
+#include <vector>
+#include <algorithm>
+#include <assert.h>
+
+namespace
+{
+
+typedef std::vector<char const*> ScopeStack;
+
+/**
+ * The stack of active scope names on the current thread.
+ * QThreadStorage deletes the per-thread objects on thread exit.
+ */
+QThreadStorage<ScopeStack*>& threadScopeStack()
+{
+	static QThreadStorage<ScopeStack*> storage;
+	return storage;
+}
+
+std::string joinedPath(ScopeStack const& stack)
+{
+	std::string path;
+	for (ScopeStack::const_iterator it(stack.begin()); it != stack.end(); ++it) {
+		if (!path.empty()) {
+			path += '/';
+		}
+		path += *it;
+	}
+	return path;
+}
+
+/**
+ * JSON string escaping.  Span names are made of scope names and file
+ * names, so in practice only backslashes (Windows paths) and quotes
+ * need attention, but we handle control characters for good measure.
+ */
+QString jsonEscaped(std::string const& str)
+{
+	QString escaped;
+	escaped.reserve(str.size());
+	for (std::string::const_iterator it(str.begin()); it != str.end(); ++it) {
+		char const ch = *it;
+		if (ch == '"' || ch == '\\') {
+			escaped += QChar('\\');
+			escaped += QChar(ch);
+		} else if ((unsigned char)ch < 0x20) {
+			escaped += QString("\\u%1").arg(int(ch), 4, 16, QChar('0'));
+		} else {
+			escaped += QChar(ch);
+		}
+	}
+	return escaped;
+}
+
+} // anonymous namespace
+
+
+Profiler::Profiler()
+:	m_enabled(true),
+	m_tracing(false)
+{
+}
+
+Profiler&
+Profiler::instance()
+{
+	// Depending on the compiler, this may not be thread-safe.
+	// However, the first call happens early on, from the GUI thread,
+	// before any worker threads get a chance to report timings.
+	static Profiler object;
+	return object;
+}
+
+bool
+Profiler::isEnabled() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_enabled;
+}
+
+void
+Profiler::setEnabled(bool const enabled)
+{
+	QMutexLocker const locker(&m_mutex);
+	m_enabled = enabled;
+}
+
+void
+Profiler::startTrace()
+{
+	QMutexLocker const locker(&m_mutex);
+	m_tracing = true;
+	m_traceSpans.clear();
+	m_traceEpoch.start();
+}
+
+bool
+Profiler::isTracing() const
+{
+	QMutexLocker const locker(&m_mutex);
+	return m_tracing;
+}
+
+bool
+Profiler::writeTrace(QString const& file_path) const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	QFile file(file_path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		return false;
+	}
+
+	QTextStream strm(&file);
+
+	// The trace_event format: https://docs.google.com/document/d/
+	// 1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+	// One complete ("X") event per span, timestamps in microseconds.
+	strm << "{\"traceEvents\":[\n";
+
+	std::vector<TraceSpan>::const_iterator it(m_traceSpans.begin());
+	std::vector<TraceSpan>::const_iterator const end(m_traceSpans.end());
+	for (; it != end; ++it) {
+		if (it != m_traceSpans.begin()) {
+			strm << ",\n";
+		}
+		strm << "{\"name\":\"" << jsonEscaped(it->name)
+			<< "\",\"cat\":\"batch\",\"ph\":\"X\""
+			<< ",\"ts\":" << qint64(it->startSeconds * 1e6)
+			<< ",\"dur\":" << qint64(it->durationSeconds * 1e6)
+			<< ",\"pid\":1,\"tid\":" << it->threadId << "}";
+	}
+
+	strm << "\n]}\n";
+	strm.flush();
+
+	return file.error() == QFile::NoError;
+}
+
+QString
+Profiler::latencyReport() const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (m_traceSpans.empty()) {
+		return QString();
+	}
+
+	// Group durations by span name, with the " [detail]" part
+	// page spans carry stripped off.
+	typedef std::map<std::string, std::vector<double> > SampleMap;
+	SampleMap samples;
+
+	std::vector<TraceSpan>::const_iterator it(m_traceSpans.begin());
+	std::vector<TraceSpan>::const_iterator const end(m_traceSpans.end());
+	for (; it != end; ++it) {
+		std::string name(it->name);
+		std::string::size_type const detail_pos = name.find(" [");
+		if (detail_pos != std::string::npos) {
+			name.resize(detail_pos);
+		}
+		samples[name].push_back(it->durationSeconds);
+	}
+
+	QString text;
+	QTextStream strm(&text, QIODevice::WriteOnly);
+	strm.setRealNumberNotation(QTextStream::FixedNotation);
+	strm.setRealNumberPrecision(3);
+
+	SampleMap::iterator s_it(samples.begin());
+	SampleMap::iterator const s_end(samples.end());
+	for (; s_it != s_end; ++s_it) {
+		std::vector<double>& durations = s_it->second;
+		std::sort(durations.begin(), durations.end());
+
+		double total = 0;
+		for (size_t i = 0; i < durations.size(); ++i) {
+			total += durations[i];
+		}
+
+		// The nearest-rank method: the smallest value such that
+		// at least 95% of the samples don't exceed it.
+		size_t const p95_idx = (durations.size() * 95 + 99) / 100 - 1;
+
+		strm << QString::fromStdString(s_it->first)
+			<< ": count=" << (unsigned long)durations.size()
+			<< " mean=" << total / durations.size() << "s"
+			<< " p95=" << durations[p95_idx] << "s"
+			<< " max=" << durations.back() << "s"
+			<< "\n";
+	}
+
+	return text;
+}
+
+void
+Profiler::addSample(std::string const& path, double const seconds,
+	std::string const& trace_detail)
+{
+	QMutexLocker const locker(&m_mutex);
+
+	Bucket& bucket = m_buckets[path];
+	++bucket.count;
+	bucket.totalSeconds += seconds;
+	if (seconds > bucket.maxSeconds) {
+		bucket.maxSeconds = seconds;
+	}
+
+	if (m_tracing) {
+		TraceSpan span;
+		span.name = path;
+		if (!trace_detail.empty()) {
+			span.name += " [";
+			span.name += trace_detail;
+			span.name += ']';
+		}
+		span.threadId = quint64(
+			reinterpret_cast<quintptr>(QThread::currentThreadId())
+		);
+		span.durationSeconds = seconds;
+		// The scope itself only measures its duration.  Its end is
+		// "now", give or take the wait for our mutex.
+		span.startSeconds = m_traceEpoch.elapsed() / 1000.0 - seconds;
+		m_traceSpans.push_back(span);
+	}
+}
+
+QString
+Profiler::report() const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	if (m_buckets.empty()) {
+		return QString();
+	}
+
+	QString text;
+	QTextStream strm(&text, QIODevice::WriteOnly);
+	strm.setRealNumberNotation(QTextStream::FixedNotation);
+	strm.setRealNumberPrecision(3);
+
+	BucketMap::const_iterator it(m_buckets.begin());
+	BucketMap::const_iterator const end(m_buckets.end());
+	for (; it != end; ++it) {
+		Bucket const& bucket = it->second;
+		strm << QString::fromStdString(it->first)
+			<< ": count=" << bucket.count
+			<< " total=" << bucket.totalSeconds << "s"
+			<< " avg=" << bucket.totalSeconds / bucket.count << "s"
+			<< " max=" << bucket.maxSeconds << "s"
+			<< "\n";
+	}
+
+	return text;
+}
+
+std::map<std::string, double>
+Profiler::totalSecondsByPath() const
+{
+	QMutexLocker const locker(&m_mutex);
+
+	std::map<std::string, double> totals;
+	BucketMap::const_iterator it(m_buckets.begin());
+	BucketMap::const_iterator const end(m_buckets.end());
+	for (; it != end; ++it) {
+		totals[it->first] = it->second.totalSeconds;
+	}
+
+	return totals;
+}
+
+void
+Profiler::reset()
+{
+	QMutexLocker const locker(&m_mutex);
+	m_buckets.clear();
+	m_traceSpans.clear();
+	if (m_tracing) {
+		m_traceEpoch.start();
+	}
+}
+
+
+/*============================= ProfileScope ============================*/
+
+ProfileScope::ProfileScope(char const* name)
+:	m_wasEnabled(Profiler::instance().isEnabled())
+{
+	enterScope(name);
+}
+
+ProfileScope::ProfileScope(char const* name, QString const& detail)
+:	m_wasEnabled(Profiler::instance().isEnabled())
+{
+	if (m_wasEnabled && Profiler::instance().isTracing()) {
+		m_traceDetail = detail.toStdString();
+	}
+	enterScope(name);
+}
+
+void
+ProfileScope::enterScope(char const* name)
+{
+	if (!m_wasEnabled) {
+		return;
+	}
+
+	ScopeStack* stack = threadScopeStack().localData();
+	if (!stack) {
+		stack = new ScopeStack;
+		threadScopeStack().setLocalData(stack);
+	}
+	stack->push_back(name);
+
+	m_timer.start();
+}
+
+ProfileScope::~ProfileScope()
+{
+	if (!m_wasEnabled) {
+		// Skipping the pop here keeps the stack balanced even if
+		// the profiler was toggled while this scope was alive.
+		return;
+	}
+
+	// QTime::elapsed() handles midnight wrap-arounds by assuming
+	// less then 24 hours have passed, which suits us fine.
+	double const seconds = m_timer.elapsed() / 1000.0;
+
+	ScopeStack* const stack = threadScopeStack().localData();
+	assert(stack && !stack->empty());
+
+	Profiler::instance().addSample(joinedPath(*stack), seconds, m_traceDetail);
+	stack->pop_back();
+}
@@ -0,0 +1,187 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "NonCopyable.h"
+#include <QMutex>
+#include <QString>
+#include <QTime>
+#include <QtGlobal>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Aggregates timings reported by ProfileScope objects.
+ *
+ * Timings are bucketed by a hierarchical path such as
+ * "output/binarize", formed by the nesting of ProfileScope objects
+ * on the reporting thread.  Aggregation is thread-safe - scopes on
+ * different threads report into the same set of buckets, though each
+ * thread maintains its own nesting.
+ *
+ * Collection is cheap (wall-clock timestamps at scope boundaries plus
+ * a mutex-protected map update per scope exit), so it stays enabled
+ * by default.  Scopes are expected to be placed around coarse
+ * operations - processing stages, imageproc primitives invoked once
+ * or twice per page, file I/O - not around per-pixel work.
+ */
+class Profiler
+{
+	DECLARE_NON_COPYABLE(Profiler)
+public:
+	static Profiler& instance();
+
+	bool isEnabled() const;
+
+	void setEnabled(bool enabled);
+
+	/**
+	 * \brief Starts recording individual spans in addition to buckets.
+	 *
+	 * Once tracing is on, every completed ProfileScope is kept as a
+	 * separate span with its thread and wall-clock position relative
+	 * to this call, ready to be dumped with writeTrace().  Unlike
+	 * plain aggregation, this costs memory proportional to the number
+	 * of scopes, so it's only turned on by explicit request
+	 * (the --trace command line option).
+	 */
+	void startTrace();
+
+	bool isTracing() const;
+
+	/**
+	 * \brief Writes the recorded spans in Chrome trace format.
+	 *
+	 * The resulting JSON file can be loaded into chrome://tracing
+	 * or any other viewer understanding the trace_event format.
+	 * Spans appear on one lane per thread.  Returns false if the
+	 * file could not be written.
+	 */
+	bool writeTrace(QString const& file_path) const;
+
+	/**
+	 * \brief Latency distributions per span name.
+	 *
+	 * One line per name (dynamic annotations stripped), giving the
+	 * sample count, mean, 95th percentile and maximum.  Requires
+	 * tracing, as buckets alone don't keep enough for percentiles.
+	 * Returns an empty string if no spans were recorded.
+	 */
+	QString latencyReport() const;
+
+	/**
+	 * \brief Adds a completed timing to the bucket identified by \p path.
+	 *
+	 * Normally invoked by ProfileScope rather than directly.
+	 * May be called from any thread.  When tracing, \p trace_detail
+	 * (if non-empty) is appended to the span name, allowing dynamic
+	 * annotations such as a page name without multiplying buckets.
+	 */
+	void addSample(std::string const& path, double seconds,
+		std::string const& trace_detail = std::string());
+
+	/**
+	 * \brief A human readable summary of the accumulated timings.
+	 *
+	 * One line per bucket, sorted by path, giving the number of
+	 * samples, the total and the maximum time.  Returns an empty
+	 * string if nothing was recorded.
+	 */
+	QString report() const;
+
+	/**
+	 * \brief The total accumulated seconds for each bucket path.
+	 *
+	 * The structured counterpart of report(), for callers that
+	 * compare timings rather than display them.
+	 */
+	std::map<std::string, double> totalSecondsByPath() const;
+
+	/**
+	 * \brief Discards the accumulated timings.
+	 */
+	void reset();
+private:
+	struct Bucket
+	{
+		long count;
+		double totalSeconds;
+		double maxSeconds;
+
+		Bucket() : count(0), totalSeconds(0), maxSeconds(0) {}
+	};
+
+	typedef std::map<std::string, Bucket> BucketMap;
+
+	struct TraceSpan
+	{
+		std::string name;
+		quint64 threadId;
+		double startSeconds; /**< Relative to startTrace(). */
+		double durationSeconds;
+	};
+
+	Profiler();
+
+	mutable QMutex m_mutex;
+	BucketMap m_buckets;
+	std::vector<TraceSpan> m_traceSpans;
+	QTime m_traceEpoch;
+	bool m_enabled;
+	bool m_tracing;
+};
+
+
+/**
+ * \brief Times the enclosing scope and reports it to Profiler.
+ *
+ * Scopes nest: a scope constructed while another one is alive on the
+ * same thread reports under a path prefixed with the enclosing
+ * scope's path.  \p name must outlive the scope - a string literal
+ * is the intended usage:
+ * \code
+ * ProfileScope const scope("output/binarize");
+ * \endcode
+ */
+class ProfileScope
+{
+	DECLARE_NON_COPYABLE(ProfileScope)
+public:
+	ProfileScope(char const* name);
+
+	/**
+	 * Like the above, but attaches \p detail to the trace span.
+	 * The aggregation bucket is still identified by \p name alone,
+	 * so per-page details don't blow up the summary report.
+	 * \p detail is ignored unless tracing is active.
+	 */
+	ProfileScope(char const* name, QString const& detail);
+
+	~ProfileScope();
+private:
+	void enterScope(char const* name);
+
+	QTime m_timer;
+	std::string m_traceDetail;
+	bool m_wasEnabled;
+};
+
+#endif
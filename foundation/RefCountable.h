@@ -25,6 +25,16 @@
 
 #include <QAtomicInt>
 
+/**
+ * \brief The intrusive reference counter behind IntrusivePtr.
+ *
+ * The counter is atomic, so references may be created and dropped
+ * from any thread.  Increments are relaxed - creating a reference
+ * requires an existing one, so there is nothing to synchronize with.
+ * The decrement releases, and the zero-detecting decrement acquires
+ * before destruction, so everything any thread did to the object
+ * before dropping its reference is visible to the destructor.
+ */
 class RefCountable
 {
 public:
@@ -44,9 +54,22 @@ public:
 	
 	void unref() const {
 		if (m_refCounter.fetchAndAddRelease(-1) == 1) {
+			// Pairs with the release decrements of the other
+			// threads: their final writes to the object must
+			// be visible to the destructor.
+			m_refCounter.fetchAndAddAcquire(0);
 			delete this;
 		}
 	}
+
+	/**
+	 * \brief The current number of references.
+	 *
+	 * Only a snapshot, of course - but a value of 1 is authoritative
+	 * for a caller that holds one of the references itself and knows
+	 * the others can't be created concurrently.
+	 */
+	int refCount() const { return (int)m_refCounter; }
 private:
 	mutable QAtomicInt m_refCounter;
 };
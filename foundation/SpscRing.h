@@ -0,0 +1,110 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include "NonCopyable.h"
+#include <QAtomicInt>
+#include <vector>
+#include <assert.h>
+
+/**
+ * \brief A bounded lock-free single-producer single-consumer ring.
+ *
+ * The classic Lamport queue: one thread may call push(), one other
+ * thread may call pop(), and neither ever blocks or takes a lock.
+ * Element type T must be cheap to copy by value - this is meant for
+ * pointers and similar plain values, not for objects with interesting
+ * copy constructors, as slots are overwritten without destruction.
+ *
+ * Indices run modulo twice the capacity, which distinguishes a full
+ * ring from an empty one without a separate counter and without
+ * letting the indices grow without bound.
+ */
+template<typename T>
+class SpscRing
+{
+	DECLARE_NON_COPYABLE(SpscRing)
+public:
+	/**
+	 * \param capacity Maximum number of queued elements.
+	 *        Must be a power of two.
+	 */
+	explicit SpscRing(unsigned capacity)
+	:	m_slots(capacity),
+		m_slotMask(capacity - 1),
+		m_indexMask(2 * capacity - 1)
+	{
+		assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+	}
+
+	/**
+	 * \brief Appends an element.  Producer thread only.
+	 *
+	 * \return False if the ring was full, in which case nothing
+	 *         was appended.
+	 */
+	bool push(T const& t) {
+		int const tail = m_tail;
+		// The acquire pairs with the release in pop(), making sure
+		// the consumer is really done with the slot we may reuse.
+		int const head = m_head.fetchAndAddAcquire(0);
+		if (((tail - head) & m_indexMask) == (int)m_slotMask + 1) {
+			return false; // Full.
+		}
+		m_slots[tail & m_slotMask] = t;
+		// The release makes the slot write visible before the index one.
+		m_tail.fetchAndStoreRelease((tail + 1) & m_indexMask);
+		return true;
+	}
+
+	/**
+	 * \brief Retrieves the oldest element.  Consumer thread only.
+	 *
+	 * \return False if the ring was empty.
+	 */
+	bool pop(T& t) {
+		int const head = m_head;
+		int const tail = m_tail.fetchAndAddAcquire(0);
+		if (head == tail) {
+			return false; // Empty.
+		}
+		t = m_slots[head & m_slotMask];
+		m_head.fetchAndStoreRelease((head + 1) & m_indexMask);
+		return true;
+	}
+
+	/**
+	 * \brief Whether the ring looked empty at some recent moment.
+	 *
+	 * Callable from either thread, with the usual caveat that the
+	 * other thread may have moved on by the time you act on it.
+	 */
+	bool empty() const {
+		return (int)m_head == (int)m_tail;
+	}
+private:
+	std::vector<T> m_slots;
+	unsigned const m_slotMask;
+	int const m_indexMask;
+	QAtomicInt m_head; /**< Next slot to pop, modulo 2 * capacity. */
+	QAtomicInt m_tail; /**< Next slot to fill, modulo 2 * capacity. */
+};
+
+#endif
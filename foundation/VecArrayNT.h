@@ -0,0 +1,202 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VEC_ARRAY_NT_H_
+#define VEC_ARRAY_NT_H_
+
+#include "VecNT.h"
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+
+template<size_t N, typename T> class VecArrayNT;
+typedef VecArrayNT<2, float> Vec2ArrayF;
+typedef VecArrayNT<2, double> Vec2ArrayD;
+typedef VecArrayNT<3, float> Vec3ArrayF;
+typedef VecArrayNT<3, double> Vec3ArrayD;
+typedef VecArrayNT<4, float> Vec4ArrayF;
+typedef VecArrayNT<4, double> Vec4ArrayD;
+
+/**
+ * \brief A structure-of-arrays counterpart of an array of VecNT.
+ *
+ * Each component is stored in its own contiguous plane, so that
+ * loops processing a single component sweep sequential memory.
+ * Such loops vectorize on whatever vector width the compiler
+ * targets, which interleaved VecNT storage prevents.
+ */
+template<size_t N, typename T>
+class VecArrayNT
+{
+	// Member-wise copying is OK.
+public:
+	typedef T type;
+	enum { PLANES = N };
+
+	VecArrayNT() : m_size(0) {}
+
+	/**
+	 * \brief Constructs an array of \p size vectors, initialized to T().
+	 */
+	explicit VecArrayNT(size_t size) : m_data(N * size), m_size(size) {}
+
+	size_t size() const { return m_size; }
+
+	/**
+	 * \brief Resizes the array, discarding its contents.
+	 *
+	 * Elements are initialized to T().  No reallocation happens
+	 * when the new size is not bigger than the current one.
+	 */
+	void resize(size_t size);
+
+	T* plane(size_t p) { return &m_data[0] + p * m_size; }
+
+	T const* plane(size_t p) const { return &m_data[0] + p * m_size; }
+
+	/**
+	 * \brief Gathers the vector at a given index from the planes.
+	 */
+	VecNT<N, T> at(size_t idx) const;
+
+	/**
+	 * \brief Scatters a vector to a given index across the planes.
+	 */
+	void setAt(size_t idx, VecNT<N, T> const& vec);
+
+	VecArrayNT& operator+=(VecArrayNT const& other);
+
+	VecArrayNT& operator-=(VecArrayNT const& other);
+
+	/**
+	 * \brief Adds the same vector to every element.
+	 */
+	VecArrayNT& operator+=(VecNT<N, T> const& vec);
+
+	/**
+	 * \brief Subtracts the same vector from every element.
+	 */
+	VecArrayNT& operator-=(VecNT<N, T> const& vec);
+
+	VecArrayNT& operator*=(T scalar);
+
+	void swap(VecArrayNT& other) {
+		m_data.swap(other.m_data);
+		std::swap(m_size, other.m_size);
+	}
+private:
+	std::vector<T> m_data; /**< N planes of m_size elements each. */
+	size_t m_size;
+};
+
+template<size_t N, typename T>
+inline void swap(VecArrayNT<N, T>& o1, VecArrayNT<N, T>& o2)
+{
+	o1.swap(o2);
+}
+
+template<size_t N, typename T>
+void
+VecArrayNT<N, T>::resize(size_t size)
+{
+	m_data.assign(N * size, T());
+	m_size = size;
+}
+
+template<size_t N, typename T>
+VecNT<N, T>
+VecArrayNT<N, T>::at(size_t idx) const
+{
+	VecNT<N, T> vec;
+	for (size_t p = 0; p < N; ++p) {
+		vec[p] = m_data[p * m_size + idx];
+	}
+	return vec;
+}
+
+template<size_t N, typename T>
+void
+VecArrayNT<N, T>::setAt(size_t idx, VecNT<N, T> const& vec)
+{
+	for (size_t p = 0; p < N; ++p) {
+		m_data[p * m_size + idx] = vec[p];
+	}
+}
+
+template<size_t N, typename T>
+VecArrayNT<N, T>&
+VecArrayNT<N, T>::operator+=(VecArrayNT const& other)
+{
+	size_t const len = N * m_size;
+	for (size_t i = 0; i < len; ++i) {
+		m_data[i] += other.m_data[i];
+	}
+	return *this;
+}
+
+template<size_t N, typename T>
+VecArrayNT<N, T>&
+VecArrayNT<N, T>::operator-=(VecArrayNT const& other)
+{
+	size_t const len = N * m_size;
+	for (size_t i = 0; i < len; ++i) {
+		m_data[i] -= other.m_data[i];
+	}
+	return *this;
+}
+
+template<size_t N, typename T>
+VecArrayNT<N, T>&
+VecArrayNT<N, T>::operator+=(VecNT<N, T> const& vec)
+{
+	for (size_t p = 0; p < N; ++p) {
+		T* const plane = this->plane(p);
+		T const val = vec[p];
+		for (size_t i = 0; i < m_size; ++i) {
+			plane[i] += val;
+		}
+	}
+	return *this;
+}
+
+template<size_t N, typename T>
+VecArrayNT<N, T>&
+VecArrayNT<N, T>::operator-=(VecNT<N, T> const& vec)
+{
+	for (size_t p = 0; p < N; ++p) {
+		T* const plane = this->plane(p);
+		T const val = vec[p];
+		for (size_t i = 0; i < m_size; ++i) {
+			plane[i] -= val;
+		}
+	}
+	return *this;
+}
+
+template<size_t N, typename T>
+VecArrayNT<N, T>&
+VecArrayNT<N, T>::operator*=(T scalar)
+{
+	size_t const len = N * m_size;
+	for (size_t i = 0; i < len; ++i) {
+		m_data[i] *= scalar;
+	}
+	return *this;
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_ACCELERATED_OPS_H_
+#define IMAGEPROC_ACCELERATED_OPS_H_
+
+#include "Transform.h"
+#include <QSize>
+#include <QSizeF>
+#include <QRect>
+#include <QString>
+
+class QImage;
+class QTransform;
+
+namespace imageproc
+{
+
+class GrayImage;
+class BinaryImage;
+
+/**
+ * \brief An optional accelerator for the heaviest raster kernels.
+ *
+ * The kernels that dominate batch time - affine transforms, gaussian
+ * blur, Wolf binarization, Savitzky-Golay filtering - are all
+ * data-parallel raster ops that a compute device (an idle iGPU, say)
+ * could absorb.  This interface is the dispatch seam for that: each
+ * hook corresponds to one public imageproc entry point, which tries
+ * the registered backend first and runs its own CPU path when the
+ * hook returns false.  The CPU path is always present and always
+ * correct, so a backend is free to decline anything it doesn't
+ * handle - unsupported formats, oversized images, a lost device.
+ *
+ * A backend must produce the exact bits of the CPU path or decline;
+ * the determinism guarantees (see ParallelFor.h) extend to
+ * accelerated runs.
+ *
+ * The default build registers no backend and every entry point runs
+ * on the CPU, which is also the state the Settings dialog shows.
+ */
+class AcceleratedOps
+{
+public:
+	virtual ~AcceleratedOps() {}
+
+	/** A human readable device/backend name for the Settings dialog. */
+	virtual QString name() const = 0;
+
+	virtual bool gaussBlur(
+		GrayImage const& src, float h_sigma, float v_sigma,
+		GrayImage& dst) { return false; }
+
+	virtual bool binarizeWolf(
+		QImage const& src, QSize window_size,
+		unsigned char lower_bound, unsigned char upper_bound,
+		BinaryImage& dst) { return false; }
+
+	virtual bool savGolFilter(
+		QImage const& src, QSize const& window_size,
+		int hor_degree, int vert_degree, QImage& dst) { return false; }
+
+	virtual bool transform(
+		QImage const& src, QTransform const& xform,
+		QRect const& dst_rect, OutsidePixels outside_pixels,
+		QSizeF const& min_mapping_area, QImage& dst) { return false; }
+};
+
+/**
+ * \brief The registered backend, or null when everything runs on the CPU.
+ */
+AcceleratedOps* acceleratedOps();
+
+/**
+ * \brief Registers (or, with null, removes) the backend.
+ *
+ * To be called during startup, before any processing threads exist.
+ * The caller retains ownership.
+ */
+void setAcceleratedOps(AcceleratedOps* ops);
+
+} // namespace imageproc
+
+#endif
@@ -17,13 +17,81 @@
 */
 
 #include "AdjustBrightness.h"
+#include "ParallelFor.h"
 #include <QImage>
+#include <QtGlobal>
 #include <stdexcept>
 #include <stdint.h>
 
 namespace imageproc
 {
 
+namespace
+{
+
+/**
+ * Replacing the luminance Y of a pixel with a new value while preserving
+ * its U and V chromas shifts every channel by the same amount:
+ * \code
+ * new_R = new_Y + V * wv = new_Y + (R - Y) = R + (new_Y - Y)
+ * \endcode
+ * and likewise for G and B (substituting new_R and new_B into the
+ * formula for new_G cancels everything but G + (new_Y - Y)).  So rather
+ * than doing the full YUV round trip in floating point per pixel, we
+ * compute the luminance delta in 16.16 fixed point and add it to each
+ * channel.  The weights only matter for computing Y itself.
+ */
+class AdjustRowsRange
+{
+public:
+	AdjustRowsRange(
+		uint32_t* rgb_data, int rgb_wpl, uint8_t const* br_data,
+		int br_bpl, int width, int wr16, int wb16)
+	:	m_pRgbData(rgb_data), m_rgbWpl(rgb_wpl),
+		m_pBrData(br_data), m_brBpl(br_bpl), m_width(width),
+		m_wr16(wr16), m_wg16(65536 - wr16 - wb16), m_wb16(wb16) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		uint32_t* rgb_line = m_pRgbData + begin_y * m_rgbWpl;
+		uint8_t const* br_line = m_pBrData + begin_y * m_brBpl;
+
+		for (int y = begin_y; y < end_y; ++y) {
+			for (int x = 0; x < m_width; ++x) {
+				uint32_t const rgb = rgb_line[x];
+				int const r = (rgb >> 16) & 0xFF;
+				int const g = (rgb >> 8) & 0xFF;
+				int const b = rgb & 0xFF;
+
+				int const y16 = m_wr16 * r + m_wg16 * g + m_wb16 * b;
+
+				// Rounds to the nearest integer, as the shift
+				// rounds towards negative infinity.
+				int const delta =
+					((int(br_line[x]) << 16) - y16 + 32768) >> 16;
+
+				uint32_t out = rgb & 0xFF000000; // preserve alpha
+				out |= uint32_t(qBound(0, r + delta, 255)) << 16;
+				out |= uint32_t(qBound(0, g + delta, 255)) << 8;
+				out |= uint32_t(qBound(0, b + delta, 255));
+				rgb_line[x] = out;
+			}
+			rgb_line += m_rgbWpl;
+			br_line += m_brBpl;
+		}
+	}
+private:
+	uint32_t* m_pRgbData;
+	int m_rgbWpl;
+	uint8_t const* m_pBrData;
+	int m_brBpl;
+	int m_width;
+	int m_wr16;
+	int m_wg16;
+	int m_wb16;
+};
+
+} // anonymous namespace
+
 void adjustBrightness(
 	QImage& rgb_image, QImage const& brightness,
 	double const wr, double const wb)
@@ -35,57 +103,24 @@ void adjustBrightness(
 		default:
 			throw std::invalid_argument("adjustBrightness: not (A)RGB32");
 	}
-	
+
 	if (brightness.format() != QImage::Format_Indexed8
 			|| !brightness.allGray()) {
 		throw std::invalid_argument("adjustBrightness: brightness not grayscale");
 	}
-	
+
 	if (rgb_image.size() != brightness.size()) {
 		throw std::invalid_argument("adjustBrightness: image and brightness have different sizes");
 	}
-	
-	uint32_t* rgb_line = reinterpret_cast<uint32_t*>(rgb_image.bits());
-	int const rgb_wpl = rgb_image.bytesPerLine() / 4;
-	
-	uint8_t const* br_line = brightness.bits();
-	int const br_bpl = brightness.bytesPerLine();
-	
-	int const width = rgb_image.width();
-	int const height = rgb_image.height();
-	
-	double const wg = 1.0 - wr - wb;
-	double const wu = (1.0 - wb);
-	double const wv = (1.0 - wr);
-	double const r_wg = 1.0 / wg;
-	double const r_wu = 1.0 / wu;
-	double const r_wv = 1.0 / wv;
-	
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			uint32_t RGB = rgb_line[x];
-			double const R = (RGB >> 16) & 0xFF;
-			double const G = (RGB >> 8) & 0xFF;
-			double const B = RGB & 0xFF;
-			
-			double const Y = wr * R + wg * G + wb * B;
-			double const U = (B - Y) * r_wu;
-			double const V = (R - Y) * r_wv;
-			
-			double new_Y = br_line[x];
-			double new_R = new_Y + V * wv;
-			double new_B = new_Y + U * wu;
-			double new_G = (new_Y - new_R * wr - new_B * wb) * r_wg;
-			
-			RGB &= 0xFF000000; // preserve alpha
-			RGB |= uint32_t(qBound(0, int(new_R + 0.5), 255)) << 16;
-			RGB |= uint32_t(qBound(0, int(new_G + 0.5), 255)) << 8;
-			RGB |= uint32_t(qBound(0, int(new_B + 0.5), 255));
-			rgb_line[x] = RGB;
-		}
-		rgb_line += rgb_wpl;
-		br_line += br_bpl;
-	}
+
+	AdjustRowsRange const rows(
+		reinterpret_cast<uint32_t*>(rgb_image.bits()),
+		rgb_image.bytesPerLine() / 4,
+		brightness.bits(), brightness.bytesPerLine(),
+		rgb_image.width(),
+		qRound(wr * 65536.0), qRound(wb * 65536.0)
+	);
+	parallelForRanges(0, rgb_image.height(), rows);
 }
 
 void adjustBrightnessYUV(QImage& rgb_image, QImage const& brightness)
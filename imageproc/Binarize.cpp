@@ -21,6 +21,8 @@
 #include "BinaryThreshold.h"
 #include "Grayscale.h"
 #include "IntegralImage.h"
+#include "AcceleratedOps.h"
+#include "ParallelFor.h"
 #include <QImage>
 #include <QRect>
 #include <QDebug>
@@ -35,6 +37,207 @@
 namespace imageproc
 {
 
+namespace
+{
+
+class SauvolaThresholdRows
+{
+public:
+	SauvolaThresholdRows(
+		uint8_t const* gray_data, int gray_bpl, int width, int height,
+		QSize const& window_size,
+		IntegralImage<uint32_t> const& integral_image,
+		IntegralImage<uint64_t> const& integral_sqimage,
+		uint32_t* bw_data, int bw_wpl)
+	:	m_pGrayData(gray_data), m_grayBpl(gray_bpl),
+		m_width(width), m_height(height),
+		m_windowLowerHalf(window_size.height() >> 1),
+		m_windowUpperHalf(window_size.height() - (window_size.height() >> 1)),
+		m_windowLeftHalf(window_size.width() >> 1),
+		m_windowRightHalf(window_size.width() - (window_size.width() >> 1)),
+		m_rIntegralImage(integral_image),
+		m_rIntegralSqimage(integral_sqimage),
+		m_pBwData(bw_data), m_bwWpl(bw_wpl) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		uint8_t const* gray_line = m_pGrayData + m_grayBpl * begin_y;
+		uint32_t* bw_line = m_pBwData + m_bwWpl * begin_y;
+
+		for (int y = begin_y; y < end_y; ++y) {
+			int const top = std::max(0, y - m_windowLowerHalf);
+			int const bottom = std::min(m_height, y + m_windowUpperHalf); // exclusive
+
+			for (int x = 0; x < m_width; ++x) {
+				int const left = std::max(0, x - m_windowLeftHalf);
+				int const right = std::min(m_width, x + m_windowRightHalf); // exclusive
+				int const area = (bottom - top) * (right - left);
+				assert(area > 0); // because window_size > 0 and w > 0 and h > 0
+
+				QRect const rect(left, top, right - left, bottom - top);
+				double const window_sum = m_rIntegralImage.sum(rect);
+				double const window_sqsum = m_rIntegralSqimage.sum(rect);
+
+				double const r_area = 1.0 / area;
+				double const mean = window_sum * r_area;
+				double const sqmean = window_sqsum * r_area;
+
+				double const variance = sqmean - mean * mean;
+				double const deviation = sqrt(fabs(variance));
+
+				double const k = 0.34;
+				double const threshold = mean * (1.0 + k * (deviation / 128.0 - 1.0));
+
+				uint32_t const msb = uint32_t(1) << 31;
+				uint32_t const mask = msb >> (x & 31);
+				if (int(gray_line[x]) < threshold) {
+					// black
+					bw_line[x >> 5] |= mask;
+				} else {
+					// white
+					bw_line[x >> 5] &= ~mask;
+				}
+			}
+
+			gray_line += m_grayBpl;
+			bw_line += m_bwWpl;
+		}
+	}
+private:
+	uint8_t const* m_pGrayData;
+	int m_grayBpl;
+	int m_width;
+	int m_height;
+	int m_windowLowerHalf;
+	int m_windowUpperHalf;
+	int m_windowLeftHalf;
+	int m_windowRightHalf;
+	IntegralImage<uint32_t> const& m_rIntegralImage;
+	IntegralImage<uint64_t> const& m_rIntegralSqimage;
+	uint32_t* m_pBwData;
+	int m_bwWpl;
+};
+
+class WolfMeanDeviationRows
+{
+public:
+	WolfMeanDeviationRows(
+		int width, int height, QSize const& window_size,
+		IntegralImage<uint32_t> const& integral_image,
+		IntegralImage<uint64_t> const& integral_sqimage,
+		float* means, float* deviations, double* row_max_deviations)
+	:	m_width(width), m_height(height),
+		m_windowLowerHalf(window_size.height() >> 1),
+		m_windowUpperHalf(window_size.height() - (window_size.height() >> 1)),
+		m_windowLeftHalf(window_size.width() >> 1),
+		m_windowRightHalf(window_size.width() - (window_size.width() >> 1)),
+		m_rIntegralImage(integral_image),
+		m_rIntegralSqimage(integral_sqimage),
+		m_pMeans(means), m_pDeviations(deviations),
+		m_pRowMaxDeviations(row_max_deviations) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		for (int y = begin_y; y < end_y; ++y) {
+			int const top = std::max(0, y - m_windowLowerHalf);
+			int const bottom = std::min(m_height, y + m_windowUpperHalf); // exclusive
+
+			double row_max_deviation = 0;
+
+			for (int x = 0; x < m_width; ++x) {
+				int const left = std::max(0, x - m_windowLeftHalf);
+				int const right = std::min(m_width, x + m_windowRightHalf); // exclusive
+				int const area = (bottom - top) * (right - left);
+				assert(area > 0); // because window_size > 0 and w > 0 and h > 0
+
+				QRect const rect(left, top, right - left, bottom - top);
+				double const window_sum = m_rIntegralImage.sum(rect);
+				double const window_sqsum = m_rIntegralSqimage.sum(rect);
+
+				double const r_area = 1.0 / area;
+				double const mean = window_sum * r_area;
+				double const sqmean = window_sqsum * r_area;
+
+				double const variance = sqmean - mean * mean;
+				double const deviation = sqrt(fabs(variance));
+				row_max_deviation = std::max(row_max_deviation, deviation);
+				m_pMeans[m_width * y + x] = mean;
+				m_pDeviations[m_width * y + x] = deviation;
+			}
+
+			m_pRowMaxDeviations[y] = row_max_deviation;
+		}
+	}
+private:
+	int m_width;
+	int m_height;
+	int m_windowLowerHalf;
+	int m_windowUpperHalf;
+	int m_windowLeftHalf;
+	int m_windowRightHalf;
+	IntegralImage<uint32_t> const& m_rIntegralImage;
+	IntegralImage<uint64_t> const& m_rIntegralSqimage;
+	float* m_pMeans;
+	float* m_pDeviations;
+	double* m_pRowMaxDeviations;
+};
+
+class WolfThresholdRows
+{
+public:
+	WolfThresholdRows(
+		uint8_t const* gray_data, int gray_bpl, int width,
+		float const* means, float const* deviations,
+		double max_deviation, uint32_t min_gray_level,
+		unsigned char lower_bound, unsigned char upper_bound,
+		uint32_t* bw_data, int bw_wpl)
+	:	m_pGrayData(gray_data), m_grayBpl(gray_bpl), m_width(width),
+		m_pMeans(means), m_pDeviations(deviations),
+		m_maxDeviation(max_deviation), m_minGrayLevel(min_gray_level),
+		m_lowerBound(lower_bound), m_upperBound(upper_bound),
+		m_pBwData(bw_data), m_bwWpl(bw_wpl) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		uint8_t const* gray_line = m_pGrayData + m_grayBpl * begin_y;
+		uint32_t* bw_line = m_pBwData + m_bwWpl * begin_y;
+
+		for (int y = begin_y; y < end_y; ++y,
+		     gray_line += m_grayBpl, bw_line += m_bwWpl) {
+			for (int x = 0; x < m_width; ++x) {
+				float const mean = m_pMeans[y * m_width + x];
+				float const deviation = m_pDeviations[y * m_width + x];
+				double const k = 0.3;
+				double const a = 1.0 - deviation / m_maxDeviation;
+				double const threshold = mean - k * a * (mean - m_minGrayLevel);
+
+				uint32_t const msb = uint32_t(1) << 31;
+				uint32_t const mask = msb >> (x & 31);
+				if (gray_line[x] < m_lowerBound ||
+						(gray_line[x] <= m_upperBound &&
+						int(gray_line[x]) < threshold)) {
+					// black
+					bw_line[x >> 5] |= mask;
+				} else {
+					// white
+					bw_line[x >> 5] &= ~mask;
+				}
+			}
+		}
+	}
+private:
+	uint8_t const* m_pGrayData;
+	int m_grayBpl;
+	int m_width;
+	float const* m_pMeans;
+	float const* m_pDeviations;
+	double m_maxDeviation;
+	uint32_t m_minGrayLevel;
+	unsigned char m_lowerBound;
+	unsigned char m_upperBound;
+	uint32_t* m_pBwData;
+	int m_bwWpl;
+};
+
+} // anonymous namespace
+
 BinaryImage binarizeOtsu(QImage const& src)
 {
 	return BinaryImage(src, BinaryThreshold::otsuThreshold(src));
@@ -73,64 +276,22 @@ BinaryImage binarizeSauvola(QImage const& src, QSize const window_size)
 	int const gray_bpl = gray.bytesPerLine();
 	
 	for (int y = 0; y < h; ++y, gray_line += gray_bpl) {
-		integral_image.beginRow();
-		integral_sqimage.beginRow();
-		for (int x = 0; x < w; ++x) {
-			uint32_t const pixel = gray_line[x];
-			integral_image.push(pixel);
-			integral_sqimage.push(pixel * pixel);
-		}
+		integral_image.pushRow(gray_line, w);
+		integral_sqimage.pushRowSquared(gray_line, w);
 	}
-	
-	int const window_lower_half = window_size.height() >> 1;
-	int const window_upper_half = window_size.height() - window_lower_half;
-	int const window_left_half = window_size.width() >> 1;
-	int const window_right_half = window_size.width() - window_left_half;
-	
+	integral_image.finish();
+	integral_sqimage.finish();
+
 	BinaryImage bw_img(w, h);
-	uint32_t* bw_line = bw_img.data();
-	int const bw_wpl = bw_img.wordsPerLine();
-	
-	gray_line = gray.bits();
-	for (int y = 0; y < h; ++y) {
-		int const top = std::max(0, y - window_lower_half);
-		int const bottom = std::min(h, y + window_upper_half); // exclusive
-		
-		for (int x = 0; x < w; ++x) {
-			int const left = std::max(0, x - window_left_half);
-			int const right = std::min(w, x + window_right_half); // exclusive
-			int const area = (bottom - top) * (right - left);
-			assert(area > 0); // because window_size > 0 and w > 0 and h > 0
-			
-			QRect const rect(left, top, right - left, bottom - top);
-			double const window_sum = integral_image.sum(rect);
-			double const window_sqsum = integral_sqimage.sum(rect);
-			
-			double const r_area = 1.0 / area;
-			double const mean = window_sum * r_area;
-			double const sqmean = window_sqsum * r_area;
-			
-			double const variance = sqmean - mean * mean;
-			double const deviation = sqrt(fabs(variance));
-			
-			double const k = 0.34;
-			double const threshold = mean * (1.0 + k * (deviation / 128.0 - 1.0));
-			
-			uint32_t const msb = uint32_t(1) << 31;
-			uint32_t const mask = msb >> (x & 31);
-			if (int(gray_line[x]) < threshold) {
-				// black
-				bw_line[x >> 5] |= mask;
-			} else {
-				// white
-				bw_line[x >> 5] &= ~mask;
-			}
-		}
-		
-		gray_line += gray_bpl;
-		bw_line += bw_wpl;
-	}
-	
+
+	parallelForRanges(
+		0, h, SauvolaThresholdRows(
+			gray.bits(), gray_bpl, w, h, window_size,
+			integral_image, integral_sqimage,
+			bw_img.data(), bw_img.wordsPerLine()
+		)
+	);
+
 	return bw_img;
 }
 
@@ -141,10 +302,17 @@ BinaryImage binarizeWolf(
 	if (window_size.isEmpty()) {
 		throw std::invalid_argument("binarizeWolf: invalid window_size");
 	}
-	
+
 	if (src.isNull()) {
 		return BinaryImage();
 	}
+
+	if (AcceleratedOps* const accel = acceleratedOps()) {
+		BinaryImage accel_dst;
+		if (accel->binarizeWolf(src, window_size, lower_bound, upper_bound, accel_dst)) {
+			return accel_dst;
+		}
+	}
 	
 	QImage const gray(toGrayscale(src));
 	int const w = gray.width();
@@ -159,81 +327,40 @@ BinaryImage binarizeWolf(
 	uint32_t min_gray_level = 255;
 	
 	for (int y = 0; y < h; ++y, gray_line += gray_bpl) {
-		integral_image.beginRow();
-		integral_sqimage.beginRow();
-		for (int x = 0; x < w; ++x) {
-			uint32_t const pixel = gray_line[x];
-			integral_image.push(pixel);
-			integral_sqimage.push(pixel * pixel);
-			min_gray_level = std::min(min_gray_level, pixel);
-		}
+		integral_image.pushRow(gray_line, w);
+		integral_sqimage.pushRowSquared(gray_line, w);
+		min_gray_level = std::min<uint32_t>(
+			min_gray_level, *std::min_element(gray_line, gray_line + w)
+		);
 	}
-	
-	int const window_lower_half = window_size.height() >> 1;
-	int const window_upper_half = window_size.height() - window_lower_half;
-	int const window_left_half = window_size.width() >> 1;
-	int const window_right_half = window_size.width() - window_left_half;
-	
+
 	std::vector<float> means(w * h, 0);
 	std::vector<float> deviations(w * h, 0);
-	
-	double max_deviation = 0;
-	
-	for (int y = 0; y < h; ++y) {
-		int const top = std::max(0, y - window_lower_half);
-		int const bottom = std::min(h, y + window_upper_half); // exclusive
-		
-		for (int x = 0; x < w; ++x) {
-			int const left = std::max(0, x - window_left_half);
-			int const right = std::min(w, x + window_right_half); // exclusive
-			int const area = (bottom - top) * (right - left);
-			assert(area > 0); // because window_size > 0 and w > 0 and h > 0
-			
-			QRect const rect(left, top, right - left, bottom - top);
-			double const window_sum = integral_image.sum(rect);
-			double const window_sqsum = integral_sqimage.sum(rect);
-			
-			double const r_area = 1.0 / area;
-			double const mean = window_sum * r_area;
-			double const sqmean = window_sqsum * r_area;
-			
-			double const variance = sqmean - mean * mean;
-			double const deviation = sqrt(fabs(variance));
-			max_deviation = std::max(max_deviation, deviation);
-			means[w * y + x] = mean;
-			deviations[w * y + x] = deviation;
-		}
-	}
-	
+	std::vector<double> row_max_deviations(h, 0);
+
+	parallelForRanges(
+		0, h, WolfMeanDeviationRows(
+			w, h, window_size, integral_image, integral_sqimage,
+			&means[0], &deviations[0], &row_max_deviations[0]
+		)
+	);
+
+	double const max_deviation = *std::max_element(
+		row_max_deviations.begin(), row_max_deviations.end()
+	);
+
 	// TODO: integral images can be disposed at this point.
-	
+
 	BinaryImage bw_img(w, h);
-	uint32_t* bw_line = bw_img.data();
-	int const bw_wpl = bw_img.wordsPerLine();
-	
-	gray_line = gray.bits();
-	for (int y = 0; y < h; ++y, gray_line += gray_bpl, bw_line += bw_wpl) {
-		for (int x = 0; x < w; ++x) {
-			float const mean = means[y * w + x];
-			float const deviation = deviations[y * w + x];
-			double const k = 0.3;
-			double const a = 1.0 - deviation / max_deviation;
-			double const threshold = mean - k * a * (mean - min_gray_level);
-			
-			uint32_t const msb = uint32_t(1) << 31;
-			uint32_t const mask = msb >> (x & 31);
-			if (gray_line[x] < lower_bound ||
-					(gray_line[x] <= upper_bound &&
-					int(gray_line[x]) < threshold)) {
-				// black
-				bw_line[x >> 5] |= mask;
-			} else {
-				// white
-				bw_line[x >> 5] &= ~mask;
-			}
-		}
-	}
-	
+
+	parallelForRanges(
+		0, h, WolfThresholdRows(
+			gray.bits(), gray_bpl, w, &means[0], &deviations[0],
+			max_deviation, min_gray_level, lower_bound, upper_bound,
+			bw_img.data(), bw_img.wordsPerLine()
+		)
+	);
+
 	return bw_img;
 }
 
@@ -19,6 +19,7 @@
 #include "BinaryImage.h"
 #include "ByteOrder.h"
 #include "BitOps.h"
+#include "ImageArena.h"
 #include <QAtomicInt>
 #include <QImage>
 #include <QRect>
@@ -533,6 +534,10 @@ BinaryImage::contentBoundingBox(BWColor const content_color) const
 	
 	// All lines above top and below bottom are empty.
 	for (int y = top; y <= bottom; ++y, line += wpl) {
+		if (left == 0 && right == 0) {
+			// Neither side can shrink any further.
+			break;
+		}
 		if (left != 0) {
 			left = leftmostBitOffset(line, left, modifier);
 		}
@@ -597,7 +602,7 @@ BinaryImage::toQImage() const
 	
 	for (int i = m_height; i > 0; --i) {
 		for (int j = 0; j < src_wpl; ++j) {
-			dst_line[j] = htonl(src_line[j]);
+			dst_line[j] = bigEndianWord(src_line[j]);
 		}
 		src_line += src_wpl;
 		dst_line += dst_wpl;
@@ -725,12 +730,12 @@ BinaryImage::fromMono(QImage const& image)
 	
 	for (int i = height; i > 0; --i) {
 		for (int j = 0; j < dst_wpl; ++j) {
-			dst_line[j] = ntohl(src_line[j]) ^ modifier;
+			dst_line[j] = bigEndianWord(src_line[j]) ^ modifier;
 		}
 		src_line += src_wpl;
 		dst_line += dst_wpl;
 	}
-	
+
 	return dst;
 }
 
@@ -767,7 +772,7 @@ BinaryImage::fromMono(QImage const& image, QRect const& rect)
 		// does not actually clear the word.
 		for (int i = height; i > 0; --i) {
 			for (int j = 0; j < dst_wpl; ++j) {
-				dst_line[j] = ntohl(src_line[j]) ^ modifier;
+				dst_line[j] = bigEndianWord(src_line[j]) ^ modifier;
 			}
 			src_line += src_wpl;
 			dst_line += dst_wpl;
@@ -776,10 +781,10 @@ BinaryImage::fromMono(QImage const& image, QRect const& rect)
 		int const last_word_idx = (width - 1) >> 5;
 		for (int i = height; i > 0; --i) {
 			int j = 0;
-			uint32_t next_word = ntohl(src_line[j]);
+			uint32_t next_word = bigEndianWord(src_line[j]);
 			for (; j < last_word_idx; ++j) {
 				uint32_t const this_word = next_word;
-				next_word = ntohl(src_line[j + 1]);
+				next_word = bigEndianWord(src_line[j + 1]);
 				uint32_t const dst_word = (this_word << word1_unused_bits)
 					| (next_word >> word2_unused_bits);
 				dst_line[j] = dst_word ^ modifier;
@@ -789,7 +794,7 @@ BinaryImage::fromMono(QImage const& image, QRect const& rect)
 			// might be outside of the image buffer.
 			uint32_t last_word = next_word << word1_unused_bits;
 			if (dst_last_word_unused_bits < word1_unused_bits) {
-				last_word |= ntohl(src_line[j + 1]) >> word2_unused_bits;
+				last_word |= bigEndianWord(src_line[j + 1]) >> word2_unused_bits;
 			}
 			dst_line[j] = last_word ^ modifier;
 			
@@ -801,16 +806,100 @@ BinaryImage::fromMono(QImage const& image, QRect const& rect)
 	return dst;
 }
 
+namespace
+{
+
+/**
+ * Loads a 32bit word from a Format_MonoLSB line, converting it to
+ * our own representation, where the leftmost pixel occupies the most
+ * significant bit.
+ */
+inline uint32_t loadMonoLsbWord(uint8_t const* const src)
+{
+	uint32_t word;
+	memcpy(&word, src, 4);
+	// Reversing the bits within each byte makes every byte match our
+	// representation, and the byte order conversion then puts the
+	// leftmost byte into the most significant position.
+	return bigEndianWord(reverseBitsWithinBytes(word));
+}
+
+} // anonymous namespace
+
 BinaryImage
 BinaryImage::fromMonoLSB(QImage const& image)
 {
-	return fromMono(image.convertToFormat(QImage::Format_Mono));
+	return fromMonoLSB(image, image.rect());
 }
 
 BinaryImage
 BinaryImage::fromMonoLSB(QImage const& image, QRect const& rect)
 {
-	return fromMono(image.convertToFormat(QImage::Format_Mono), rect);
+	// This is a mirror of fromMono(QImage, QRect), except that words
+	// are loaded through loadMonoLsbWord().  Converting in place saves
+	// us a whole-image convertToFormat() intermediate.
+	int const width = rect.width();
+	int const height = rect.height();
+
+	int const src_bpl = image.bytesPerLine();
+	uint8_t const* src_line = image.bits();
+	src_line += rect.top() * src_bpl;
+	src_line += (rect.left() >> 5) * 4;
+	int const word1_unused_bits = rect.left() & 31;
+	int const word2_unused_bits = 32 - word1_unused_bits;
+
+	BinaryImage dst(width, height);
+	int const dst_wpl = dst.wordsPerLine();
+	uint32_t* dst_line = dst.data();
+	int const dst_last_word_unused_bits = (dst_wpl << 5) - width;
+
+	uint32_t modifier = ~uint32_t(0);
+	if (image.numColors() >= 2) {
+		if (qGray(image.color(0)) > qGray(image.color(1))) {
+			// if color 0 is lighter than color 1
+			modifier = ~modifier;
+		}
+	}
+
+	if (word1_unused_bits == 0) {
+		// It's not just an optimization.  The code in the other branch
+		// is not going to work for this case because uint32_t << 32
+		// does not actually clear the word.
+		for (int i = height; i > 0; --i) {
+			for (int j = 0; j < dst_wpl; ++j) {
+				dst_line[j] = loadMonoLsbWord(src_line + (j << 2)) ^ modifier;
+			}
+			src_line += src_bpl;
+			dst_line += dst_wpl;
+		}
+	} else {
+		int const last_word_idx = (width - 1) >> 5;
+		for (int i = height; i > 0; --i) {
+			int j = 0;
+			uint32_t next_word = loadMonoLsbWord(src_line);
+			for (; j < last_word_idx; ++j) {
+				uint32_t const this_word = next_word;
+				next_word = loadMonoLsbWord(src_line + ((j + 1) << 2));
+				uint32_t const dst_word = (this_word << word1_unused_bits)
+					| (next_word >> word2_unused_bits);
+				dst_line[j] = dst_word ^ modifier;
+			}
+
+			// The last word needs special attention, because the word
+			// at j + 1 might be outside of the image buffer.
+			uint32_t last_word = next_word << word1_unused_bits;
+			if (dst_last_word_unused_bits < word1_unused_bits) {
+				last_word |= loadMonoLsbWord(src_line + ((j + 1) << 2))
+					>> word2_unused_bits;
+			}
+			dst_line[j] = last_word ^ modifier;
+
+			src_line += src_bpl;
+			dst_line += dst_wpl;
+		}
+	}
+
+	return dst;
 }
 
 BinaryImage
@@ -1180,7 +1269,7 @@ BinaryImage::SharedData::unref() const
 {
 	if (!m_refCounter.deref()) {
 		this->~SharedData();
-		free((void*)this);
+		ImageArena::release((void*)this);
 	}
 }
 
@@ -1188,7 +1277,7 @@ void*
 BinaryImage::SharedData::operator new(size_t, NumWords const num_words)
 {
 	SharedData* sd = 0;
-	void* addr = malloc(((char*)&sd->m_data[0] - (char*)sd) + num_words.numWords * 4);
+	void* addr = ImageArena::alloc(((char*)&sd->m_data[0] - (char*)sd) + num_words.numWords * 4);
 	if (!addr) {
 		throw std::bad_alloc();
 	}
@@ -1198,7 +1287,7 @@ BinaryImage::SharedData::operator new(size_t, NumWords const num_words)
 void
 BinaryImage::SharedData::operator delete(void* addr, NumWords)
 {
-	free(addr);
+	ImageArena::release(addr);
 }
 
 } // namespace imageproc
@@ -173,7 +173,19 @@ struct LeastSignificantZeroes<T, 0>
 template<typename T>
 int countNonZeroBits(T const val)
 {
+#if defined(__GNUC__)
+	// Compiles to a single popcnt instruction where the target
+	// supports it, and to a fast bit-parallel sequence otherwise.
+	// The masking is there to stop sign extension from introducing
+	// extra bits; it's a compile-time constant.
+	unsigned long long widened = static_cast<unsigned long long>(val);
+	if (sizeof(T) < sizeof(widened)) {
+		widened &= (1ull << (sizeof(T) * 8)) - 1;
+	}
+	return __builtin_popcountll(widened);
+#else
 	return detail::NonZeroBits<T, sizeof(T)>::count(val);
+#endif
 }
 
 template<typename T>
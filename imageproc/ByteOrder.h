@@ -25,4 +25,53 @@
 #include <netinet/in.h>
 #endif
 
+#ifdef _MSC_VER
+#include <stdlib.h>
+#endif
+
+#include <QtGlobal>
+#include <stdint.h>
+
+namespace imageproc
+{
+
+/**
+ * \brief Converts a 32bit word between the host and the big endian
+ *        byte order.  The conversion is its own inverse.
+ *
+ * Unlike htonl() and ntohl(), which on some platforms are actual
+ * function calls, this always expands inline, so the compiler is
+ * able to vectorize loops doing bulk conversions.  On big endian
+ * hosts it compiles away completely.
+ */
+inline uint32_t bigEndianWord(uint32_t const word)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+	return word;
+#elif defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 3))
+	return __builtin_bswap32(word);
+#elif defined(_MSC_VER)
+	return _byteswap_ulong(word);
+#else
+	return (word << 24) | ((word & 0xff00) << 8)
+		| ((word >> 8) & 0xff00) | (word >> 24);
+#endif
+}
+
+/**
+ * \brief Reverses the order of bits within every byte of a word.
+ *
+ * Equivalent to looking up each byte in a 256-entry reversal table,
+ * but expressed as arithmetic the compiler can vectorize.
+ */
+inline uint32_t reverseBitsWithinBytes(uint32_t word)
+{
+	word = ((word & 0x55555555) << 1) | ((word >> 1) & 0x55555555);
+	word = ((word & 0x33333333) << 2) | ((word >> 2) & 0x33333333);
+	word = ((word & 0x0f0f0f0f) << 4) | ((word >> 4) & 0x0f0f0f0f);
+	return word;
+}
+
+} // namespace imageproc
+
 #endif
@@ -21,6 +21,9 @@
 
 #include <limits>
 #include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace imageproc
 {
@@ -28,6 +31,37 @@ namespace imageproc
 namespace color_mixer_impl
 {
 
+#if defined(__SSE2__)
+
+/**
+ * \brief Computes per-channel sums over a span of 32-bit pixels.
+ *
+ * chan[0] ... chan[3] receive the totals of bytes 0 ... 3 of each
+ * pixel, which on x86 means blue, green, red and alpha respectively.
+ * Processes 4 pixels per iteration and returns the number of pixels
+ * consumed, which is num_pixels rounded down to a multiple of 4.
+ */
+inline int sumChannelsSse2(uint32_t const* pixels, int num_pixels, uint32_t* chan)
+{
+	__m128i const zero = _mm_setzero_si128();
+	__m128i sum32 = zero;
+
+	int i = 0;
+	for (; i + 4 <= num_pixels; i += 4) {
+		__m128i const bytes = _mm_loadu_si128((__m128i const*)(pixels + i));
+		__m128i const sum16 = _mm_add_epi16(
+			_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)
+		);
+		sum32 = _mm_add_epi32(sum32, _mm_unpacklo_epi16(sum16, zero));
+		sum32 = _mm_add_epi32(sum32, _mm_unpackhi_epi16(sum16, zero));
+	}
+
+	_mm_storeu_si128((__m128i*)chan, sum32);
+	return i;
+}
+
+#endif
+
 template<typename Mixer, bool IntegerAccum>
 struct Switcher
 {
@@ -67,6 +101,32 @@ public:
 		m_accum += AccumType(gray_level) * weight;
 	}
 
+	/**
+	 * \brief Adds a span of pixels sharing the same weight.
+	 *
+	 * Summing the pixels first and weighting the total is cheaper
+	 * than weighting them individually, and lets the summation
+	 * itself be done 16 pixels at a time.
+	 */
+	void addSpan(uint8_t const* pixels, int num_pixels, AccumType weight) {
+		uint32_t sum = 0;
+		int i = 0;
+#if defined(__SSE2__)
+		__m128i const zero = _mm_setzero_si128();
+		__m128i vec_sum = zero;
+		for (; i + 16 <= num_pixels; i += 16) {
+			__m128i const bytes = _mm_loadu_si128((__m128i const*)(pixels + i));
+			vec_sum = _mm_add_epi32(vec_sum, _mm_sad_epu8(bytes, zero));
+		}
+		sum = uint32_t(_mm_cvtsi128_si32(vec_sum))
+			+ uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(vec_sum, 8)));
+#endif
+		for (; i < num_pixels; ++i) {
+			sum += pixels[i];
+		}
+		m_accum += AccumType(sum) * weight;
+	}
+
 	result_type mix(AccumType total_weight) const {
 		using namespace color_mixer_impl;
 		typedef std::numeric_limits<AccumType> traits;
@@ -104,7 +164,33 @@ public:
 		m_greenAccum += AccumType((rgb >> 8) & 0xFF) * weight;
 		m_blueAccum += AccumType(rgb & 0xFF) * weight;
 	}
-	
+
+	/**
+	 * \see GrayColorMixer::addSpan()
+	 */
+	void addSpan(uint32_t const* pixels, int num_pixels, AccumType weight) {
+		AccumType red_sum = AccumType();
+		AccumType green_sum = AccumType();
+		AccumType blue_sum = AccumType();
+		int i = 0;
+#if defined(__SSE2__)
+		uint32_t chan[4];
+		i = color_mixer_impl::sumChannelsSse2(pixels, num_pixels, chan);
+		blue_sum = AccumType(chan[0]);
+		green_sum = AccumType(chan[1]);
+		red_sum = AccumType(chan[2]);
+#endif
+		for (; i < num_pixels; ++i) {
+			uint32_t const rgb = pixels[i];
+			red_sum += AccumType((rgb >> 16) & 0xFF);
+			green_sum += AccumType((rgb >> 8) & 0xFF);
+			blue_sum += AccumType(rgb & 0xFF);
+		}
+		m_redAccum += red_sum * weight;
+		m_greenAccum += green_sum * weight;
+		m_blueAccum += blue_sum * weight;
+	}
+
 	result_type mix(AccumType total_weight) const {
 		using namespace color_mixer_impl;
 		typedef std::numeric_limits<AccumType> traits;
@@ -151,7 +237,37 @@ public:
 		m_greenAccum += AccumType((argb >> 8) & 0xFF) * weight;
 		m_blueAccum += AccumType(argb & 0xFF) * weight;
 	}
-	
+
+	/**
+	 * \see GrayColorMixer::addSpan()
+	 */
+	void addSpan(uint32_t const* pixels, int num_pixels, AccumType weight) {
+		AccumType alpha_sum = AccumType();
+		AccumType red_sum = AccumType();
+		AccumType green_sum = AccumType();
+		AccumType blue_sum = AccumType();
+		int i = 0;
+#if defined(__SSE2__)
+		uint32_t chan[4];
+		i = color_mixer_impl::sumChannelsSse2(pixels, num_pixels, chan);
+		blue_sum = AccumType(chan[0]);
+		green_sum = AccumType(chan[1]);
+		red_sum = AccumType(chan[2]);
+		alpha_sum = AccumType(chan[3]);
+#endif
+		for (; i < num_pixels; ++i) {
+			uint32_t const argb = pixels[i];
+			alpha_sum += AccumType((argb >> 24) & 0xFF);
+			red_sum += AccumType((argb >> 16) & 0xFF);
+			green_sum += AccumType((argb >> 8) & 0xFF);
+			blue_sum += AccumType(argb & 0xFF);
+		}
+		m_alphaAccum += alpha_sum * weight;
+		m_redAccum += red_sum * weight;
+		m_greenAccum += green_sum * weight;
+		m_blueAccum += blue_sum * weight;
+	}
+
 	result_type mix(AccumType total_weight) const {
 		using namespace color_mixer_impl;
 		typedef std::numeric_limits<AccumType> traits;
@@ -24,6 +24,8 @@
 #include "ConnComp.h"
 #include "BitOps.h"
 #include <QRect>
+#include <QPoint>
+#include <vector>
 #include <algorithm>
 #include <stdexcept>
 #include <assert.h>
@@ -32,6 +34,53 @@
 namespace imageproc
 {
 
+namespace
+{
+
+/**
+ * A maximal sequence of black pixels [begin, end) on a particular line.
+ */
+struct Run
+{
+	int begin;
+	int end;
+	int y;
+
+	Run(int begin_, int end_, int y_) : begin(begin_), end(end_), y(y_) {}
+};
+
+/**
+ * Finds the root of a run in a union-find forest, using path halving.
+ */
+uint32_t
+findRunRoot(std::vector<uint32_t>& parent, uint32_t idx)
+{
+	while (parent[idx] != idx) {
+		parent[idx] = parent[parent[idx]];
+		idx = parent[idx];
+	}
+	return idx;
+}
+
+/**
+ * Merges the components two runs belong to.  The root is always
+ * the run with the lowest index, which guarantees that a root
+ * precedes the other members of its component.
+ */
+void
+uniteRuns(std::vector<uint32_t>& parent, uint32_t idx1, uint32_t idx2)
+{
+	uint32_t const root1 = findRunRoot(parent, idx1);
+	uint32_t const root2 = findRunRoot(parent, idx2);
+	if (root1 < root2) {
+		parent[root2] = root1;
+	} else {
+		parent[root1] = root2;
+	}
+}
+
+} // anonymous namespace
+
 struct ConnCompEraser::BBox
 {
 	int xmin;
@@ -356,4 +405,141 @@ ConnCompEraser::eraseConnComp8()
 	return ConnComp(QPoint(m_x, m_y), rect, pix_count);
 }
 
+void
+ConnCompEraser::eraseIfImpl(
+	BinaryImage& image, Connectivity const conn,
+	VirtualFunction1<bool, ConnComp const&>& pred)
+{
+	if (image.isNull()) {
+		return;
+	}
+
+	int const width = image.width();
+	int const height = image.height();
+	int const wpl = image.wordsPerLine();
+
+	// Reading through a const pointer avoids a copy-on-write,
+	// which would be wasted if nothing gets erased.
+	BinaryImage const& const_image = image;
+	uint32_t const* line = const_image.data();
+
+	std::vector<Run> runs;
+	std::vector<uint32_t> row_offsets(height + 1);
+
+	for (int y = 0; y < height; ++y, line += wpl) {
+		row_offsets[y] = runs.size();
+
+		int x = 0;
+		while (x < width) {
+			if ((x & 31) == 0) {
+				// Word-aligned: skip completely white words.
+				while (x < width && line[x >> 5] == 0) {
+					x += 32;
+				}
+				if (x >= width) {
+					break;
+				}
+			}
+			if (!getBit(line, x)) {
+				++x;
+				continue;
+			}
+			int const begin = x;
+			do {
+				++x;
+			} while (x < width && getBit(line, x));
+			runs.push_back(Run(begin, x, y));
+		}
+	}
+	row_offsets[height] = runs.size();
+
+	if (runs.empty()) {
+		return;
+	}
+
+	uint32_t const num_runs = runs.size();
+	std::vector<uint32_t> parent(num_runs);
+	for (uint32_t i = 0; i < num_runs; ++i) {
+		parent[i] = i;
+	}
+
+	// Runs on adjacent lines belong to the same component if they
+	// overlap.  For 8-connectivity, diagonal contact counts as well,
+	// which is equivalent to extending a run by one pixel to each side.
+	int const overlap_slack = (conn == CONN8) ? 1 : 0;
+
+	for (int y = 1; y < height; ++y) {
+		uint32_t j = row_offsets[y - 1];
+		uint32_t const j_end = row_offsets[y];
+		uint32_t const i_end = row_offsets[y + 1];
+		for (uint32_t i = row_offsets[y]; i < i_end; ++i) {
+			int const begin = runs[i].begin - overlap_slack;
+			int const end = runs[i].end + overlap_slack;
+			while (j < j_end && runs[j].end <= begin) {
+				++j;
+			}
+			for (uint32_t k = j; k < j_end && runs[k].begin < end; ++k) {
+				uniteRuns(parent, i, k);
+			}
+		}
+	}
+
+	// Per-component aggregates, valid at root indices only.
+	std::vector<BBox> bboxes(num_runs, BBox(0, 0));
+	std::vector<int> pix_counts(num_runs, 0);
+
+	for (uint32_t i = 0; i < num_runs; ++i) {
+		Run const& run = runs[i];
+		uint32_t const root = findRunRoot(parent, i);
+		BBox& bbox = bboxes[root];
+		if (pix_counts[root] == 0) {
+			bbox = BBox(run.begin, run.y);
+			bbox.xmax = run.end - 1;
+		} else {
+			bbox.xmin = std::min(bbox.xmin, run.begin);
+			bbox.xmax = std::max(bbox.xmax, run.end - 1);
+			bbox.ymin = std::min(bbox.ymin, run.y);
+			bbox.ymax = std::max(bbox.ymax, run.y);
+		}
+		pix_counts[root] += run.end - run.begin;
+	}
+
+	std::vector<char> erase(num_runs, char(0));
+	bool any_erased = false;
+
+	for (uint32_t i = 0; i < num_runs; ++i) {
+		if (parent[i] != i) {
+			continue;
+		}
+		// The root is the component's topmost-leftmost run,
+		// so its first pixel makes a natural seed.
+		BBox const& bbox = bboxes[i];
+		QRect const rect(bbox.xmin, bbox.ymin, bbox.width(), bbox.height());
+		ConnComp const cc(
+			QPoint(runs[i].begin, runs[i].y), rect, pix_counts[i]
+		);
+		if (pred(cc)) {
+			erase[i] = 1;
+			any_erased = true;
+		}
+	}
+
+	if (!any_erased) {
+		return;
+	}
+
+	uint32_t* const data = image.data(); // Possibly detaches.
+
+	for (uint32_t i = 0; i < num_runs; ++i) {
+		if (!erase[findRunRoot(parent, i)]) {
+			continue;
+		}
+		Run const& run = runs[i];
+		uint32_t* const run_line = data + run.y * wpl;
+		for (int x = run.begin; x < run.end; ++x) {
+			clearBit(run_line, x);
+		}
+	}
+}
+
 } // namespace imageproc
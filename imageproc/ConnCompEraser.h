@@ -23,6 +23,7 @@
 #include "Connectivity.h"
 #include "ConnComp.h"
 #include "BinaryImage.h"
+#include "VirtualFunction.h"
 #include <stack>
 #include <stdint.h>
 
@@ -62,6 +63,21 @@ public:
 	 * is erased from the image, assuming there was one.
 	 */
 	BinaryImage const& image() const { return m_image; }
+
+	/**
+	 * \brief Erases every connected component for which \p pred
+	 *        returns true, in a single pass over the image.
+	 *
+	 * Components are gathered as horizontal runs and merged with
+	 * a union-find, so no per-component images get materialized.
+	 * This is considerably cheaper than iterating with
+	 * nextConnComp() when the image has many small components.
+	 *
+	 * The predicate is called once per component and receives a
+	 * ConnComp describing it (seed, bounding box, pixel count).
+	 */
+	template<typename Pred>
+	static void eraseIf(BinaryImage& image, Connectivity conn, Pred pred);
 private:
 	struct Segment
 	{
@@ -88,9 +104,13 @@ private:
 	ConnComp eraseConnComp8();
 	
 	static uint32_t getBit(uint32_t const* line, int x);
-	
+
 	static void clearBit(uint32_t* line, int x);
-	
+
+	static void eraseIfImpl(
+		BinaryImage& image, Connectivity conn,
+		VirtualFunction1<bool, ConnComp const&>& pred);
+
 	BinaryImage m_image;
 	uint32_t* m_pLine;
 	int const m_width;
@@ -102,6 +122,15 @@ private:
 	int m_y;
 };
 
+
+template<typename Pred>
+void
+ConnCompEraser::eraseIf(BinaryImage& image, Connectivity const conn, Pred pred)
+{
+	ProxyFunction1<Pred, bool, ConnComp const&> proxy(pred);
+	eraseIfImpl(image, conn, proxy);
+}
+
 } // namespace imageproc
 
 #endif
@@ -20,6 +20,7 @@
 #include "BinaryImage.h"
 #include "InfluenceMap.h"
 #include "BitOps.h"
+#include "ParallelFor.h"
 #ifndef Q_MOC_RUN
 #include <boost/foreach.hpp>
 #endif
@@ -258,318 +259,210 @@ ConnectivityMap::copyFromInfluenceMap(InfluenceMap const& imap)
 	}
 }
 
-void
-ConnectivityMap::assignIds(Connectivity const conn)
+namespace
 {
-	uint32_t const num_initial_tags = initialTagging();
-	std::vector<uint32_t> table(num_initial_tags, 0);
-	
-	switch (conn) {
-		case CONN4:
-			spreadMin4();
-			break;
-		case CONN8:
-			spreadMin8();
-			break;
+
+/**
+ * \brief A horizontal run of foreground pixels: [begin, end).
+ */
+struct Run
+{
+	int begin;
+	int end;
+
+	Run(int begin, int end) : begin(begin), end(end) {}
+};
+
+/**
+ * Returns the representative run of the set \p idx belongs to,
+ * compressing the path along the way.  Sets are always rooted
+ * at their lowest run index.
+ */
+uint32_t findRoot(std::vector<uint32_t>& parent, uint32_t idx)
+{
+	while (parent[idx] != idx) {
+		parent[idx] = parent[parent[idx]];
+		idx = parent[idx];
 	}
-	
-	markUsedIds(table);
-	
-	uint32_t next_label = 1;
-	for (uint32_t i = 0; i < num_initial_tags; ++i) {
-		if (table[i]) {
-			table[i] = next_label;
-			++next_label;
-		}
+	return idx;
+}
+
+void uniteRuns(std::vector<uint32_t>& parent, uint32_t run1, uint32_t run2)
+{
+	uint32_t const root1 = findRoot(parent, run1);
+	uint32_t const root2 = findRoot(parent, run2);
+	if (root1 < root2) {
+		parent[root2] = root1;
+	} else {
+		parent[root1] = root2;
 	}
-	
-	remapIds(table);
-	
-	m_maxLabel = next_label - 1;
 }
 
 /**
- * Tags every object pixel that has a non-object pixel to the left.
+ * \brief Collects foreground runs for a band of rows.
+ *
+ * Designed for parallelForRanges().  Rows are read-only at this
+ * point and every worker writes its own row slots.
  */
-uint32_t
-ConnectivityMap::initialTagging()
+class RunExtractor
 {
-	int const width = m_size.width();
-	int const height = m_size.height();
-	
-	uint32_t next_label = 1;
-	
-	uint32_t* line = m_pData;
-	int const stride = m_stride;
-	
-	for (int y = 0; y < height; ++y, line += stride) {
-		for (int x = 0; x < width; ++x) {
-			if (line[x - 1] == BACKGROUND
-					&& line[x] == UNTAGGED_FG) {
-				line[x] = next_label;
-				++next_label;
+public:
+	RunExtractor(
+		uint32_t const* data, int const stride, int const width,
+		uint32_t const fg_value, std::vector<std::vector<Run> >& rows)
+	:	m_pData(data),
+		m_stride(stride),
+		m_width(width),
+		m_fgValue(fg_value),
+		m_rRows(rows)
+	{
+	}
+
+	void operator()(int const begin_y, int const end_y) const {
+		uint32_t const* line = m_pData + begin_y * m_stride;
+		for (int y = begin_y; y < end_y; ++y, line += m_stride) {
+			std::vector<Run>& runs = m_rRows[y];
+			for (int x = 0; x < m_width;) {
+				if (line[x] != m_fgValue) {
+					++x;
+					continue;
+				}
+				int const run_begin = x;
+				do {
+					++x;
+				} while (x < m_width && line[x] == m_fgValue);
+				runs.push_back(Run(run_begin, x));
 			}
 		}
 	}
-	
-	return next_label - 1;
-}
+private:
+	uint32_t const* m_pData;
+	int m_stride;
+	int m_width;
+	uint32_t m_fgValue;
+	std::vector<std::vector<Run> >& m_rRows;
+};
 
-void
-ConnectivityMap::spreadMin4()
+/**
+ * \brief Writes final labels back for a band of rows.
+ *
+ * Also zeroes the background and the left / right padding cells.
+ */
+class RunFiller
 {
-	int const width = m_size.width();
-	int const height = m_size.height();
-	int const stride = m_stride;
-	
-	uint32_t* line = m_pData;
-	uint32_t* prev_line = m_pData - stride;
-	
-	// Top to bottom.
-	for (int y = 0; y < height; ++y) {
-		// Left to right.
-		for (int x = 0; x < width; ++x) {
-			if (line[x] == BACKGROUND) {
-				continue;
-			}
-			line[x] = std::min(
-				prev_line[x],
-				std::min(line[x - 1], line[x])
-			);
-		}
-		
-		prev_line = line;
-		line += stride;
+public:
+	RunFiller(
+		uint32_t* data, int const stride, int const width,
+		std::vector<std::vector<Run> > const& rows,
+		std::vector<uint32_t> const& row_offsets,
+		std::vector<uint32_t> const& labels)
+	:	m_pData(data),
+		m_stride(stride),
+		m_width(width),
+		m_rRows(rows),
+		m_rRowOffsets(row_offsets),
+		m_rLabels(labels)
+	{
 	}
-	
-	prev_line = line;
-	line -= stride;
-	
-	FastQueue<uint32_t*> queue;
-	
-	// Bottom to top.
-	for (int y = height - 1; y >= 0; --y) {
-		// Right to left.
-		for (int x = width - 1; x >= 0; --x) {
-			if (line[x] == BACKGROUND) {
-				continue;
-			}
-			
-			uint32_t const new_val = std::min(
-				line[x + 1], prev_line[x]
-			);
-			
-			if (new_val >= line[x]) {
-				continue;
-			}
-			
-			line[x] = new_val;
-			
-			// We compare new_val + 1 < neighbor + 1 to
-			// make BACKGROUND neighbors overflow and become
-			// zero.
-			uint32_t const nvp1 = new_val + 1;
-			if (nvp1 < line[x + 1] + 1 || nvp1 < prev_line[x] + 1) {
-				queue.push(&line[x]);
+
+	void operator()(int const begin_y, int const end_y) const {
+		uint32_t* line = m_pData + begin_y * m_stride;
+		for (int y = begin_y; y < end_y; ++y, line += m_stride) {
+			std::fill(line - 1, line + m_width + 1, uint32_t(0));
+
+			std::vector<Run> const& runs = m_rRows[y];
+			uint32_t run_idx = m_rRowOffsets[y];
+			BOOST_FOREACH(Run const& run, runs) {
+				uint32_t const label = m_rLabels[run_idx];
+				++run_idx;
+				std::fill(line + run.begin, line + run.end, label);
 			}
 		}
-		prev_line = line;
-		line -= stride;
 	}
-	
-	processQueue4(queue);
-}
+private:
+	uint32_t* m_pData;
+	int m_stride;
+	int m_width;
+	std::vector<std::vector<Run> > const& m_rRows;
+	std::vector<uint32_t> const& m_rRowOffsets;
+	std::vector<uint32_t> const& m_rLabels;
+};
+
+} // anonymous namespace
 
 void
-ConnectivityMap::spreadMin8()
+ConnectivityMap::assignIds(Connectivity const conn)
 {
 	int const width = m_size.width();
 	int const height = m_size.height();
-	int const stride = m_stride;
-	
-	uint32_t* line = m_pData;
-	uint32_t* prev_line = m_pData - stride;
-	
-	// Top to bottom.
+
+	// Pass 1: collect foreground runs, one list per row.
+	// This and the label writing below are the only phases that
+	// touch every pixel, and both are parallelized over row bands.
+	std::vector<std::vector<Run> > rows(height);
+	parallelForRanges(
+		0, height, RunExtractor(m_pData, m_stride, width, UNTAGGED_FG, rows)
+	);
+
+	std::vector<uint32_t> row_offsets(height, 0);
+	uint32_t num_runs = 0;
 	for (int y = 0; y < height; ++y) {
-		// Left to right.
-		for (int x = 0; x < width; ++x) {
-			if (line[x] == BACKGROUND) {
-				continue;
-			}
-			line[x] = std::min(
-				std::min(
-					std::min(prev_line[x - 1], prev_line[x]),
-					std::min(prev_line[x + 1], line[x - 1])
-				),
-				line[x]
-			);
-		}
-		
-		prev_line = line;
-		line += stride;
-	}
-	
-	prev_line = line;
-	line -= stride;
-	
-	FastQueue<uint32_t*> queue;
-	
-	// Bottom to top.
-	for (int y = height - 1; y >= 0; --y) {
-		for (int x = width - 1; x >= 0; --x) {
-			if (line[x] == BACKGROUND) {
-				continue;
-			}
-			
-			uint32_t const new_val = std::min(
-				std::min(prev_line[x - 1], prev_line[x]),
-				std::min(prev_line[x + 1], line[x + 1])
-			);
-			
-			if (new_val >= line[x]) {
-				continue;
-			}
-			
-			line[x] = new_val;
-			
-			// We compare new_val + 1 < neighbor + 1 to
-			// make BACKGROUND neighbors overflow and become
-			// zero.
-			uint32_t const nvp1 = new_val + 1;
-			if (nvp1 < prev_line[x - 1] + 1
-					|| nvp1 < prev_line[x] + 1
-					|| nvp1 < prev_line[x + 1] + 1
-					|| nvp1 < line[x + 1] + 1) {
-				queue.push(&line[x]);
-			}
-		}
-		
-		prev_line = line;
-		line -= stride;
+		row_offsets[y] = num_runs;
+		num_runs += rows[y].size();
 	}
-	
-	processQueue8(queue);
-}
 
-void
-ConnectivityMap::processNeighbor(
-	FastQueue<uint32_t*>& queue,
-	uint32_t const this_val, uint32_t* neighbor)
-{
-	// *neighbor + 1 will overflow if *neighbor == BACKGROUND,
-	// which is what we want.
-	if (this_val + 1 < *neighbor + 1) {
-		*neighbor = this_val;
-		queue.push(neighbor);
+	// Merge runs touching across adjacent rows with a flat union-find
+	// over global run indexes.  Runs within a row are sorted by x,
+	// so each row pair takes a single sweep.
+	std::vector<uint32_t> parent(num_runs);
+	for (uint32_t i = 0; i < num_runs; ++i) {
+		parent[i] = i;
 	}
-}
 
-void
-ConnectivityMap::processQueue4(FastQueue<uint32_t*>& queue)
-{
-	int const stride = m_stride;
-	
-	while (!queue.empty()) {
-		uint32_t* p = queue.front();
-		queue.pop();
-		
-		uint32_t const this_val = *p;
-		
-		// Northern neighbor.
-		p -= stride;
-		processNeighbor(queue, this_val, p);
-		
-		// Eastern neighbor.
-		p += stride + 1;
-		processNeighbor(queue, this_val, p);
-		
-		// Southern neighbor.
-		p += stride - 1;
-		processNeighbor(queue, this_val, p);
-		
-		// Western neighbor.
-		p -= stride + 1;
-		processNeighbor(queue, this_val, p);
-	}
-}
+	int const overlap_slack = (conn == CONN8) ? 1 : 0;
+	for (int y = 1; y < height; ++y) {
+		std::vector<Run> const& prev_runs = rows[y - 1];
+		std::vector<Run> const& cur_runs = rows[y];
+		size_t const num_prev = prev_runs.size();
 
-void
-ConnectivityMap::processQueue8(FastQueue<uint32_t*>& queue)
-{
-	int const stride = m_stride;
-	
-	while (!queue.empty()) {
-		uint32_t* p = queue.front();
-		queue.pop();
-		
-		uint32_t const this_val = *p;
-		
-		// Northern neighbor.
-		p -= stride;
-		processNeighbor(queue, this_val, p);
-		
-		// North-eastern neighbor.
-		++p;
-		processNeighbor(queue, this_val, p);
-		
-		// Eastern neighbor.
-		p += stride;
-		processNeighbor(queue, this_val, p);
-		
-		// South-eastern neighbor.
-		p += stride;
-		processNeighbor(queue, this_val, p);
-		
-		// Southern neighbor.
-		--p;
-		processNeighbor(queue, this_val, p);
-		
-		// South-western neighbor.
-		--p;
-		processNeighbor(queue, this_val, p);
-		
-		// Western neighbor.
-		p -= stride;
-		processNeighbor(queue, this_val, p);
-		
-		// North-western neighbor.
-		p -= stride;
-		processNeighbor(queue, this_val, p);
-	}
-}
+		size_t j = 0;
+		for (size_t i = 0; i < cur_runs.size(); ++i) {
+			int const begin = cur_runs[i].begin - overlap_slack;
+			int const end = cur_runs[i].end + overlap_slack;
 
-void
-ConnectivityMap::markUsedIds(std::vector<uint32_t>& used_map) const
-{
-	int const width = m_size.width();
-	int const height = m_size.height();
-	int const stride = m_stride;
-	
-	uint32_t const* line = m_pData;
-	
-	// Top to bottom.
-	for (int y = 0; y < height; ++y, line += stride) {
-		// Left to right.
-		for (int x = 0; x < width; ++x) {
-			if (line[x] == BACKGROUND) {
-				continue;
+			while (j < num_prev && prev_runs[j].end <= begin) {
+				++j;
+			}
+			for (size_t k = j; k < num_prev && prev_runs[k].begin < end; ++k) {
+				uniteRuns(parent, row_offsets[y - 1] + k, row_offsets[y] + i);
 			}
-			used_map[line[x] - 1] = 1;
 		}
 	}
-}
 
-void
-ConnectivityMap::remapIds(std::vector<uint32_t> const& map)
-{
-	BOOST_FOREACH(uint32_t& label, m_data) {
-		if (label == BACKGROUND) {
-			label = 0;
-		} else {
-			label = map[label - 1];
+	// Pass 2: number the components in the order their first runs
+	// appear, then resolve every run to its component's label.
+	// Roots always precede their members, so a single scan suffices.
+	std::vector<uint32_t> labels(num_runs, 0);
+	uint32_t next_label = 1;
+	for (uint32_t i = 0; i < num_runs; ++i) {
+		uint32_t const root = findRoot(parent, i);
+		if (labels[root] == 0) {
+			labels[root] = next_label;
+			++next_label;
 		}
+		labels[i] = labels[root];
 	}
+
+	parallelForRanges(
+		0, height,
+		RunFiller(m_pData, m_stride, width, rows, row_offsets, labels)
+	);
+
+	// The top and bottom padding rows must be background as well.
+	std::fill(m_data.begin(), m_data.begin() + m_stride, uint32_t(0));
+	std::fill(m_data.end() - m_stride, m_data.end(), uint32_t(0));
+
+	m_maxLabel = next_label - 1;
 }
 
 } // namespace imageproc
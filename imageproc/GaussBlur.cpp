@@ -21,6 +21,7 @@
 
 #include "GaussBlur.h"
 #include "GrayImage.h"
+#include "AcceleratedOps.h"
 #include "Constants.h"
 #include <boost/lambda/lambda.hpp>
 #include <boost/lambda/bind.hpp>
@@ -107,6 +108,13 @@ GrayImage gaussBlur(GrayImage const& src, float h_sigma, float v_sigma)
 		return src;
 	}
 
+	if (AcceleratedOps* const accel = acceleratedOps()) {
+		GrayImage accel_dst;
+		if (accel->gaussBlur(src, h_sigma, v_sigma, accel_dst)) {
+			return accel_dst;
+		}
+	}
+
 	GrayImage dst(src.size());
 	gaussBlurGeneric(
 		src.size(), h_sigma, v_sigma,
@@ -23,10 +23,12 @@
 #define IMAGEPROC_GAUSSBLUR_H_
 
 #include "ValueConv.h"
+#include "ParallelFor.h"
 #include <QSize>
 #ifndef Q_MOC_RUN
 #include <boost/scoped_array.hpp>
 #endif
+#include <algorithm>
 #include <iterator>
 #include <string.h>
 
@@ -117,6 +119,173 @@ public:
 	void operator()(float& dst, float src) const { dst = src; }
 };
 
+/**
+ * The vertical IIR pass over a range of columns.  The recurrence runs
+ * along y, so adjacent columns are independent and get processed in
+ * strips, with the innermost loop going across the strip.  That gives
+ * sequential memory access and lets the compiler vectorize the
+ * arithmetic, neither of which is possible column-by-column.
+ */
+template<typename SrcIt, typename FloatReader>
+class VertIirRange
+{
+public:
+	VertIirRange(
+		int height, SrcIt input, int input_stride, FloatReader reader,
+		float* intermediate, int intermediate_stride,
+		float const* n_p, float const* n_m, float const* d_p,
+		float const* d_m, float const* bd_p, float const* bd_m)
+	:	m_height(height), m_input(input), m_inputStride(input_stride),
+		m_reader(reader), m_pIntermediate(intermediate),
+		m_intermediateStride(intermediate_stride),
+		m_pNP(n_p), m_pNM(n_m), m_pDP(d_p),
+		m_pDM(d_m), m_pBdP(bd_p), m_pBdM(bd_m) {}
+
+	void operator()(int const begin_x, int const end_x) const {
+		int const max_strip = 16;
+		boost::scoped_array<float> val_p(new float[m_height * max_strip]);
+		boost::scoped_array<float> val_m(new float[m_height * max_strip]);
+
+		for (int x0 = begin_x; x0 < end_x; x0 += max_strip) {
+			int const strip = std::min(max_strip, end_x - x0);
+			memset(&val_p[0], 0, m_height * strip * sizeof(val_p[0]));
+			memset(&val_m[0], 0, m_height * strip * sizeof(val_m[0]));
+
+			SrcIt const sp_base(m_input + x0);
+			int const last_row_off = (m_height - 1) * m_inputStride;
+
+			for (int y = 0; y < m_height; ++y) {
+				int const my = m_height - 1 - y; // Mirrored for the anticasual sequence.
+				int const terms = y < 4 ? y : 4;
+				float* const vp = &val_p[0] + y * strip;
+				float* const vm = &val_m[0] + my * strip;
+				SrcIt const sp_p(sp_base + y * m_inputStride);
+				SrcIt const sp_m(sp_base + my * m_inputStride);
+
+				for (int s = 0; s < strip; ++s) {
+					float accum_p = 0.0f;
+					float accum_m = 0.0f;
+					int i = 0;
+					int sp_off = 0;
+					for (; i <= terms; ++i, sp_off += m_inputStride) {
+						accum_p += m_pNP[i] * m_reader(sp_p[s - sp_off])
+							- m_pDP[i] * vp[s - i * strip];
+						accum_m += m_pNM[i] * m_reader(sp_m[s + sp_off])
+							- m_pDM[i] * vm[s + i * strip];
+					}
+					if (i <= 4) {
+						float const initial_p = m_reader(sp_base[s]);
+						float const initial_m = m_reader(sp_base[s + last_row_off]);
+						for (; i <= 4; ++i) {
+							accum_p += (m_pNP[i] - m_pBdP[i]) * initial_p;
+							accum_m += (m_pNM[i] - m_pBdM[i]) * initial_m;
+						}
+					}
+					vp[s] = accum_p;
+					vm[s] = accum_m;
+				}
+			}
+
+			for (int y = 0; y < m_height; ++y) {
+				float const* const vp = &val_p[0] + y * strip;
+				float const* const vm = &val_m[0] + y * strip;
+				float* const out = m_pIntermediate + y * m_intermediateStride + x0;
+				for (int s = 0; s < strip; ++s) {
+					out[s] = vp[s] + vm[s];
+				}
+			}
+		}
+	}
+private:
+	int m_height;
+	SrcIt m_input;
+	int m_inputStride;
+	FloatReader m_reader;
+	float* m_pIntermediate;
+	int m_intermediateStride;
+	float const* m_pNP;
+	float const* m_pNM;
+	float const* m_pDP;
+	float const* m_pDM;
+	float const* m_pBdP;
+	float const* m_pBdM;
+};
+
+/**
+ * The horizontal IIR pass over a range of rows.  Rows are independent,
+ * so the original per-row code runs unchanged, just on a sub-range.
+ */
+template<typename DstIt, typename FloatWriter>
+class HorIirRange
+{
+public:
+	HorIirRange(
+		int width, float const* intermediate, int intermediate_stride,
+		DstIt output, int output_stride, FloatWriter writer,
+		float const* n_p, float const* n_m, float const* d_p,
+		float const* d_m, float const* bd_p, float const* bd_m)
+	:	m_width(width), m_pIntermediate(intermediate),
+		m_intermediateStride(intermediate_stride),
+		m_output(output), m_outputStride(output_stride), m_writer(writer),
+		m_pNP(n_p), m_pNM(n_m), m_pDP(d_p),
+		m_pDM(d_m), m_pBdP(bd_p), m_pBdM(bd_m) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		boost::scoped_array<float> val_p(new float[m_width]);
+		boost::scoped_array<float> val_m(new float[m_width]);
+
+		float const* intermediate_line = m_pIntermediate + begin_y * m_intermediateStride;
+		DstIt output_line(m_output + begin_y * m_outputStride);
+
+		for (int y = begin_y; y < end_y; ++y) {
+			memset(&val_p[0], 0, m_width * sizeof(val_p[0]));
+			memset(&val_m[0], 0, m_width * sizeof(val_m[0]));
+
+			float const* sp_p = intermediate_line;
+			float const* sp_m = intermediate_line + m_width - 1;
+			float* vp = &val_p[0];
+			float* vm = &val_m[0] + m_width - 1;
+			float const initial_p = sp_p[0];
+			float const initial_m = sp_m[0];
+
+			for (int x = 0; x < m_width; ++x) {
+				int const terms = x < 4 ? x : 4;
+				int i = 0;
+				for (; i <= terms; ++i) {
+					*vp += m_pNP[i] * sp_p[-i] - m_pDP[i] * vp[-i];
+					*vm += m_pNM[i] * sp_m[i] - m_pDM[i] * vm[i];
+				}
+				for (; i <= 4; ++i) {
+					*vp += (m_pNP[i] - m_pBdP[i]) * initial_p;
+					*vm += (m_pNM[i] - m_pBdM[i]) * initial_m;
+				}
+				++sp_p;
+				--sp_m;
+				++vp;
+				--vm;
+			}
+
+			save(m_width, &val_p[0], &val_m[0], output_line, 1, m_writer);
+
+			intermediate_line += m_intermediateStride;
+			output_line += m_outputStride;
+		}
+	}
+private:
+	int m_width;
+	float const* m_pIntermediate;
+	int m_intermediateStride;
+	DstIt m_output;
+	int m_outputStride;
+	FloatWriter m_writer;
+	float const* m_pNP;
+	float const* m_pNM;
+	float const* m_pDP;
+	float const* m_pDM;
+	float const* m_pBdP;
+	float const* m_pBdM;
+};
+
 } // namespace gauss_blur_impl
 
 template<typename SrcIt, typename DstIt, typename FloatReader, typename FloatWriter>
@@ -130,90 +299,32 @@ void gaussBlurGeneric(QSize const size, float const h_sigma, float const v_sigma
 
 	int const width = size.width();
 	int const height = size.height();
-	int const width_height_max = width > height ? width : height;
 
-	boost::scoped_array<float> val_p(new float[width_height_max]);
-	boost::scoped_array<float> val_m(new float[width_height_max]);
 	boost::scoped_array<float> intermediate_image(new float[width * height]);
 	int const intermediate_stride = width;
 
 	// IIR parameters.
 	float n_p[5], n_m[5], d_p[5], d_m[5], bd_p[5], bd_m[5];
-	
+
 	// Vertical pass.
 	gauss_blur_impl::find_iir_constants(n_p, n_m, d_p, d_m, bd_p, bd_m, v_sigma);
-	for (int x = 0; x < width; ++x) {
-		memset(&val_p[0], 0, height * sizeof(val_p[0]));
-		memset(&val_m[0], 0, height * sizeof(val_m[0]));
-		
-		SrcIt sp_p(input + x);
-		SrcIt sp_m(sp_p + (height - 1) * input_stride);
-		float* vp = &val_p[0];
-		float* vm = &val_m[0] + height - 1;
-		float const initial_p = float_reader(sp_p[0]);
-		float const initial_m = float_reader(sp_m[0]);
-		
-		for (int y = 0; y < height; ++y) {
-			int const terms = y < 4 ? y : 4;
-			int i = 0;
-			int sp_off = 0;
-			for (; i <= terms; ++i, sp_off += input_stride) {
-				*vp += n_p[i] * float_reader(sp_p[-sp_off]) - d_p[i] * vp[-i];
-				*vm += n_m[i] * float_reader(sp_m[sp_off]) - d_m[i] * vm[i];
-			}
-			for (; i <= 4; ++i) {
-				*vp += (n_p[i] - bd_p[i]) * initial_p;
-				*vm += (n_m[i] - bd_m[i]) * initial_m;
-			}
-			sp_p += input_stride;
-			sp_m -= input_stride;
-			++vp;
-			--vm;
-		}
-		
-		gauss_blur_impl::save(
-			height, &val_p[0], &val_m[0], &intermediate_image[0] + x,
-			intermediate_stride, gauss_blur_impl::FloatToFloatWriter()
-		);
-	}
-	
+	parallelForRanges(
+		0, width, gauss_blur_impl::VertIirRange<SrcIt, FloatReader>(
+			height, input, input_stride, float_reader,
+			&intermediate_image[0], intermediate_stride,
+			n_p, n_m, d_p, d_m, bd_p, bd_m
+		)
+	);
+
 	// Horizontal pass.
 	gauss_blur_impl::find_iir_constants(n_p, n_m, d_p, d_m, bd_p, bd_m, h_sigma);
-	float const* intermediate_line = &intermediate_image[0];
-	DstIt output_line(output);
-	for (int y = 0; y < height; ++y) {
-		memset(&val_p[0], 0, width * sizeof(val_p[0]));
-		memset(&val_m[0], 0, width * sizeof(val_m[0]));
-		
-		float const* sp_p = intermediate_line;
-		float const* sp_m = intermediate_line + width - 1;
-		float* vp = &val_p[0];
-		float* vm = &val_m[0] + width - 1;
-		float const initial_p = sp_p[0];
-		float const initial_m = sp_m[0];
-		
-		for (int x = 0; x < width; ++x) {
-			int const terms = x < 4 ? x : 4;
-			int i = 0;
-			for (; i <= terms; ++i) {
-				*vp += n_p[i] * sp_p[-i] - d_p[i] * vp[-i];
-				*vm += n_m[i] * sp_m[i] - d_m[i] * vm[i];
-			}
-			for (; i <= 4; ++i) {
-				*vp += (n_p[i] - bd_p[i]) * initial_p;
-				*vm += (n_m[i] - bd_m[i]) * initial_m;
-			}
-			++sp_p;
-			--sp_m;
-			++vp;
-			--vm;
-		}
-		
-		gauss_blur_impl::save(width, &val_p[0], &val_m[0], output_line, 1, float_writer);
-
-		intermediate_line += intermediate_stride;
-		output_line += output_stride;
-	}
+	parallelForRanges(
+		0, height, gauss_blur_impl::HorIirRange<DstIt, FloatWriter>(
+			width, &intermediate_image[0], intermediate_stride,
+			output, output_stride, float_writer,
+			n_p, n_m, d_p, d_m, bd_p, bd_m
+		)
+	);
 }
 
 } // namespace imageproc
@@ -18,6 +18,7 @@
 
 #include "GrayImage.h"
 #include "Grayscale.h"
+#include "ImageArena.h"
 #include <new>
 
 namespace imageproc
@@ -34,6 +35,11 @@ GrayImage::GrayImage(QSize size)
 	if (m_image.isNull()) {
 		throw std::bad_alloc();
 	}
+
+	// QImage owns the buffer, so huge page backing is advisory.
+	ImageArena::adviseHugePages(
+		m_image.bits(), size_t(m_image.bytesPerLine()) * m_image.height()
+	);
 }
 
 GrayImage::GrayImage(QImage const& image)
@@ -41,4 +47,10 @@ GrayImage::GrayImage(QImage const& image)
 {
 }
 
+void
+GrayImage::swap(GrayImage& other)
+{
+	qSwap(m_image, other.m_image);
+}
+
 } // namespace imageproc
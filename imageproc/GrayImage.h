@@ -49,9 +49,22 @@ public:
 	 * \brief Constructs a 8-bit grayscale image by converting an arbitrary QImage.
 	 *
 	 * The QImage may be in any format and may be null.
+	 *
+	 * If the image is already Format_Indexed8 with a full 256-entry
+	 * grayscale palette, no conversion takes place and the pixel data
+	 * is shared rather than copied.  Together with toQImage()
+	 * returning a reference, this makes QImage round-trips free for
+	 * images that are already in our representation.
 	 */
 	explicit GrayImage(QImage const& image);
 
+	/**
+	 * \brief Exchanges the contents of two images.
+	 *
+	 * This operation doesn't copy data, it just swaps pointers to it.
+	 */
+	void swap(GrayImage& other);
+
 	/**
 	 * \brief Returns a const reference to the underlying QImage.
 	 *
@@ -90,6 +103,11 @@ private:
 	QImage m_image;
 };
 
+inline void swap(GrayImage& o1, GrayImage& o2)
+{
+	o1.swap(o2);
+}
+
 inline bool operator==(GrayImage const& lhs, GrayImage const& rhs) {
 	return lhs.toQImage() == rhs.toQImage();
 }
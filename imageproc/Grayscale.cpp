@@ -20,8 +20,10 @@
 #include "GrayImage.h"
 #include "BinaryImage.h"
 #include "BitOps.h"
+#include "ParallelFor.h"
 #include <QImage>
 #include <QColor>
+#include <QMutex>
 #include <QtGlobal>
 #include <stdexcept>
 #include <algorithm>
@@ -32,6 +34,122 @@
 namespace imageproc
 {
 
+namespace
+{
+
+/**
+ * RGB to luma conversion for a band of rows of a 32bpp image.
+ * The per-row loop is plain integer arithmetic over sequential
+ * memory, which the compiler can vectorize.
+ */
+class Rgb32ToGrayRows
+{
+public:
+	Rgb32ToGrayRows(
+		uint8_t const* src_data, int src_bpl,
+		uint8_t* dst_data, int dst_bpl, int width)
+	:	m_pSrcData(src_data), m_srcBpl(src_bpl),
+		m_pDstData(dst_data), m_dstBpl(dst_bpl), m_width(width) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		uint8_t const* src_data = m_pSrcData + begin_y * m_srcBpl;
+		uint8_t* dst_line = m_pDstData + begin_y * m_dstBpl;
+
+		for (int y = begin_y; y < end_y; ++y) {
+			uint32_t const* src_line = (uint32_t const*)src_data;
+			for (int x = 0; x < m_width; ++x) {
+				dst_line[x] = static_cast<uint8_t>(qGray(src_line[x]));
+			}
+			src_data += m_srcBpl;
+			dst_line += m_dstBpl;
+		}
+	}
+private:
+	uint8_t const* m_pSrcData;
+	int m_srcBpl;
+	uint8_t* m_pDstData;
+	int m_dstBpl;
+	int m_width;
+};
+
+/**
+ * Histogram accumulation for a band of rows of a grayscale image.
+ * Each range fills a local histogram and merges it into the shared
+ * one under a mutex, so the hot loop stays contention-free.
+ */
+class GrayHistogramRows
+{
+public:
+	GrayHistogramRows(
+		uint8_t const* data, int bpl, int width,
+		int* shared_hist, QMutex* mutex)
+	:	m_pData(data), m_bpl(bpl), m_width(width),
+		m_pSharedHist(shared_hist), m_pMutex(mutex) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		int local_hist[256];
+		memset(local_hist, 0, sizeof(local_hist));
+
+		uint8_t const* line = m_pData + begin_y * m_bpl;
+		for (int y = begin_y; y < end_y; ++y, line += m_bpl) {
+			for (int x = 0; x < m_width; ++x) {
+				++local_hist[line[x]];
+			}
+		}
+
+		QMutexLocker const locker(m_pMutex);
+		for (int i = 0; i < 256; ++i) {
+			m_pSharedHist[i] += local_hist[i];
+		}
+	}
+private:
+	uint8_t const* m_pData;
+	int m_bpl;
+	int m_width;
+	int* m_pSharedHist;
+	QMutex* m_pMutex;
+};
+
+/**
+ * Same as GrayHistogramRows, but for a 32bpp image, with luma
+ * conversion on the fly.
+ */
+class Rgb32HistogramRows
+{
+public:
+	Rgb32HistogramRows(
+		uint8_t const* data, int bpl, int width,
+		int* shared_hist, QMutex* mutex)
+	:	m_pData(data), m_bpl(bpl), m_width(width),
+		m_pSharedHist(shared_hist), m_pMutex(mutex) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		int local_hist[256];
+		memset(local_hist, 0, sizeof(local_hist));
+
+		uint8_t const* data = m_pData + begin_y * m_bpl;
+		for (int y = begin_y; y < end_y; ++y, data += m_bpl) {
+			uint32_t const* line = (uint32_t const*)data;
+			for (int x = 0; x < m_width; ++x) {
+				++local_hist[qGray(line[x])];
+			}
+		}
+
+		QMutexLocker const locker(m_pMutex);
+		for (int i = 0; i < 256; ++i) {
+			m_pSharedHist[i] += local_hist[i];
+		}
+	}
+private:
+	uint8_t const* m_pData;
+	int m_bpl;
+	int m_width;
+	int* m_pSharedHist;
+	QMutex* m_pMutex;
+};
+
+} // anonymous namespace
+
 static QImage monoMsbToGrayscale(QImage const& src)
 {
 	int const width = src.width();
@@ -57,21 +175,29 @@ static QImage monoMsbToGrayscale(QImage const& src)
 		}
 	}
 	
+	// Expanding complete bytes needs no per-bit bounds checks;
+	// the (at most 7) leftover bits are handled separately.
+	int const full_bytes = width / 8;
+
 	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width;) {
-			uint8_t const b = src_line[x / 8];
-			for (int i = 7; i >= 0 && x < width; --i, ++x) {
-				dst_line[x] = bin2gray[(b >> i) & 1];
+		for (int xb = 0; xb < full_bytes; ++xb) {
+			uint8_t const b = src_line[xb];
+			uint8_t* const out = dst_line + xb * 8;
+			for (int i = 0; i < 8; ++i) {
+				out[i] = bin2gray[(b >> (7 - i)) & 1];
 			}
 		}
-		
+		for (int x = full_bytes * 8; x < width; ++x) {
+			dst_line[x] = bin2gray[(src_line[x / 8] >> (7 - x % 8)) & 1];
+		}
+
 		src_line += src_bpl;
 		dst_line += dst_bpl;
 	}
-	
+
 	dst.setDotsPerMeterX(src.dotsPerMeterX());
 	dst.setDotsPerMeterY(src.dotsPerMeterY());
-	
+
 	return dst;
 }
 
@@ -100,14 +226,22 @@ static QImage monoLsbToGrayscale(QImage const& src)
 		}
 	}
 	
+	// Expanding complete bytes needs no per-bit bounds checks;
+	// the (at most 7) leftover bits are handled separately.
+	int const full_bytes = width / 8;
+
 	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width;) {
-			uint8_t const b = src_line[x / 8];
-			for (int i = 0; i < 8 && x < width; ++i, ++x) {
-				dst_line[x] = bin2gray[(b >> i) & 1];
+		for (int xb = 0; xb < full_bytes; ++xb) {
+			uint8_t const b = src_line[xb];
+			uint8_t* const out = dst_line + xb * 8;
+			for (int i = 0; i < 8; ++i) {
+				out[i] = bin2gray[(b >> i) & 1];
 			}
 		}
-		
+		for (int x = full_bytes * 8; x < width; ++x) {
+			dst_line[x] = bin2gray[(src_line[x / 8] >> (x % 8)) & 1];
+		}
+
 		src_line += src_bpl;
 		dst_line += dst_bpl;
 	}
@@ -131,14 +265,31 @@ static QImage anyToGrayscale(QImage const& src)
 	
 	uint8_t* dst_line = dst.bits();
 	int const dst_bpl = dst.bytesPerLine();
-	
-	for (int y = 0; y < height; ++y) {
-		for (int x = 0; x < width; ++x) {
-			dst_line[x] = static_cast<uint8_t>(qGray(src.pixel(x, y)));
+
+	if (src.format() == QImage::Format_RGB32
+			|| src.format() == QImage::Format_ARGB32) {
+		// Direct scanline access instead of QImage::pixel(),
+		// with rows split between threads.
+		parallelForRanges(
+			0, height, Rgb32ToGrayRows(
+				src.bits(), src.bytesPerLine(), dst_line, dst_bpl, width
+			)
+		);
+	} else {
+		// QImage::pixel() re-checks the format and bounds on every
+		// call.  Converting the whole image once moves that work out
+		// of the per-pixel loop and lets the fast path take over.
+		QImage const rgb32(src.convertToFormat(QImage::Format_RGB32));
+		if (rgb32.isNull()) {
+			throw std::bad_alloc();
 		}
-		dst_line += dst_bpl;
+		parallelForRanges(
+			0, height, Rgb32ToGrayRows(
+				rgb32.bits(), rgb32.bytesPerLine(), dst_line, dst_bpl, width
+			)
+		);
 	}
-	
+
 	dst.setDotsPerMeterX(src.dotsPerMeterX());
 	dst.setDotsPerMeterY(src.dotsPerMeterY());
 	
@@ -436,16 +587,12 @@ GrayscaleHistogram::fromMonoMSBImage(QImage const& img, BinaryImage const& mask)
 void
 GrayscaleHistogram::fromGrayscaleImage(QImage const& img)
 {
-	int const w = img.width();
-	int const h = img.height();
-	int const bpl = img.bytesPerLine();
-	uint8_t const* line = img.bits();
-	
-	for (int y = 0; y < h; ++y, line += bpl) {
-		for (int x = 0; x < w; ++x) {
-			++m_pixels[line[x]];
-		}
-	}
+	QMutex mutex;
+	parallelForRanges(
+		0, img.height(), GrayHistogramRows(
+			img.bits(), img.bytesPerLine(), img.width(), m_pixels, &mutex
+		)
+	);
 }
 
 void
@@ -471,9 +618,20 @@ GrayscaleHistogram::fromGrayscaleImage(QImage const& img, BinaryImage const& mas
 void
 GrayscaleHistogram::fromAnyImage(QImage const& img)
 {
+	if (img.format() == QImage::Format_RGB32
+			|| img.format() == QImage::Format_ARGB32) {
+		QMutex mutex;
+		parallelForRanges(
+			0, img.height(), Rgb32HistogramRows(
+				img.bits(), img.bytesPerLine(), img.width(), m_pixels, &mutex
+			)
+		);
+		return;
+	}
+
 	int const w = img.width();
 	int const h = img.height();
-	
+
 	for (int y = 0; y < h; ++y) {
 		for (int x = 0; x < w; ++x) {
 			++m_pixels[qGray(img.pixel(x, y))];
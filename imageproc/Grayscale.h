@@ -68,6 +68,10 @@ QVector<QRgb> createGrayscalePalette();
  * \param src The source image in any format.
  * \return A grayscale image with proper palette.  Null will be returned
  *         if \p src was null.
+ *
+ * \note If \p src is already Format_Indexed8 with a full grayscale
+ *       palette, it's returned as is, sharing its pixel data with
+ *       the source.
  */
 QImage toGrayscale(QImage const& src);
 
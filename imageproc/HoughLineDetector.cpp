@@ -27,6 +27,9 @@
 #include "RasterOp.h"
 #include "SeedFill.h"
 #include "Grayscale.h"
+#include "ParallelFor.h"
+#include <QMutex>
+#include <QMutexLocker>
 #include <QSize>
 #include <QRect>
 #include <QPoint>
@@ -57,6 +60,71 @@ public:
 };
 
 
+/**
+ * \brief Casts votes for a range of samples into a per-thread histogram.
+ *
+ * Designed for parallelForRanges().  Each worker accumulates into
+ * a private histogram, which is then merged into the shared one
+ * under a mutex.
+ */
+class HoughLineDetector::VoteAccumulator
+{
+public:
+	/**
+	 * \brief A per-angle voting term: bin = xTerm * x + yTerm * y + offset.
+	 */
+	struct AngleTerms
+	{
+		double xTerm;
+		double yTerm;
+		double offset;
+	};
+
+	VoteAccumulator(
+		HoughLineDetector& owner, std::vector<Sample> const& samples,
+		std::vector<AngleTerms> const& terms, QMutex& merge_mutex)
+	:	m_rOwner(owner),
+		m_rSamples(samples),
+		m_rTerms(terms),
+		m_rMergeMutex(merge_mutex)
+	{
+	}
+
+	void operator()(int const begin, int const end) const {
+		std::vector<unsigned> local_hist(m_rOwner.m_histogram.size(), 0);
+		int const num_angles = m_rTerms.size();
+		int const hist_width = m_rOwner.m_histWidth;
+
+		for (int i = begin; i < end; ++i) {
+			Sample const& sample = m_rSamples[i];
+			unsigned* hist_line = &local_hist[0];
+
+			for (int angle = 0; angle < num_angles; ++angle) {
+				AngleTerms const& terms = m_rTerms[angle];
+				int const bin = (int)(
+					terms.xTerm * sample.x + terms.yTerm * sample.y + terms.offset
+				);
+				assert(bin >= 0 && bin < hist_width);
+				hist_line[bin] += sample.weight;
+
+				hist_line += hist_width;
+			}
+		}
+
+		QMutexLocker const locker(&m_rMergeMutex);
+		size_t const size = local_hist.size();
+		for (size_t i = 0; i < size; ++i) {
+			m_rOwner.m_histogram[i] += local_hist[i];
+		}
+	}
+private:
+	HoughLineDetector& m_rOwner;
+	std::vector<Sample> const& m_rSamples;
+	std::vector<AngleTerms> const& m_rTerms;
+	QMutex& m_rMergeMutex;
+};
+
+
 HoughLineDetector::HoughLineDetector(
 	QSize const& input_dimensions, double const distance_resolution,
 	double const start_angle, double const angle_delta, int const num_angles)
@@ -119,6 +187,30 @@ HoughLineDetector::process(int x, int y, unsigned weight)
 	}
 }
 
+void
+HoughLineDetector::processBatch(std::vector<Sample> const& samples)
+{
+	if (samples.empty()) {
+		return;
+	}
+
+	// Fold the distance bias and scaling into per-angle terms,
+	// leaving two multiplications and two additions per vote.
+	std::vector<VoteAccumulator::AngleTerms> terms(m_angleUnitVectors.size());
+	for (size_t i = 0; i < m_angleUnitVectors.size(); ++i) {
+		QPointF const& uv = m_angleUnitVectors[i];
+		terms[i].xTerm = uv.x() * m_recipDistanceResolution;
+		terms[i].yTerm = uv.y() * m_recipDistanceResolution;
+		terms[i].offset = m_distanceBias * m_recipDistanceResolution + 0.5;
+	}
+
+	QMutex merge_mutex;
+	parallelForRanges(
+		0, (int)samples.size(),
+		VoteAccumulator(*this, samples, terms, merge_mutex)
+	);
+}
+
 QImage
 HoughLineDetector::visualizeHoughSpace(unsigned const lower_bound) const
 {
@@ -97,10 +97,33 @@ public:
 	HoughLineDetector(QSize const& input_dimensions, double distance_resolution,
 		double start_angle, double angle_delta, int num_angles);
 	
+	/**
+	 * \brief A weighted input point for processBatch().
+	 */
+	struct Sample
+	{
+		int x;
+		int y;
+		unsigned weight;
+
+		Sample() : x(0), y(0), weight(0) {}
+
+		Sample(int x, int y, unsigned weight) : x(x), y(y), weight(weight) {}
+	};
+
 	/**
 	 * \brief Processes a point with a specified weight.
 	 */
 	void process(int x, int y, unsigned weight = 1);
+
+	/**
+	 * \brief Processes a batch of weighted points.
+	 *
+	 * Equivalent to calling process() for every sample, but votes
+	 * are cast by multiple threads into per-thread accumulators
+	 * that get merged into the histogram at the end.
+	 */
+	void processBatch(std::vector<Sample> const& samples);
 	
 	QImage visualizeHoughSpace(unsigned lower_bound) const;
 	
@@ -115,6 +138,8 @@ public:
 	std::vector<HoughLine> findLines(unsigned quality_lower_bound) const;
 private:
 	class GreaterQualityFirst;
+
+	class VoteAccumulator;
 	
 	static BinaryImage findHistogramPeaks(
 		std::vector<unsigned> const& hist, int width, int height,
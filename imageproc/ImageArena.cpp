@@ -0,0 +1,250 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ImageArena.h"
+#include "MemoryTracker.h"
+#include <QThreadStorage>
+#include <map>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace imageproc
+{
+
+namespace
+{
+
+/** The usual huge page size on x86-64 and many other platforms. */
+size_t const HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/** Allocations smaller than this aren't worth a huge page. */
+size_t const HUGE_PAGE_THRESHOLD = 8 * 1024 * 1024;
+
+bool huge_pages_enabled = false;
+
+/**
+ * A header preceding the data area of every allocation.
+ * Its size keeps the data area aligned to 16 bytes.
+ */
+struct Block
+{
+	size_t capacity; /**< Capacity of the data area, in bytes. */
+
+	size_t padding[16 / sizeof(size_t) - 1];
+};
+
+/**
+ * The per-thread block cache behind ImageArena.
+ */
+class ThreadArena
+{
+public:
+	ThreadArena() : m_cachedBytes(0), m_scopeLevel(0) {}
+
+	~ThreadArena();
+
+	/**
+	 * Takes a suitable cached block, or returns null.
+	 */
+	Block* takeBlock(size_t num_bytes);
+
+	/**
+	 * Caches a block, or returns false if the cache is full.
+	 */
+	bool cacheBlock(Block* block);
+
+	int& scopeLevel() { return m_scopeLevel; }
+private:
+	/** Don't let a thread's cache grow beyond this many bytes. */
+	enum { CACHE_LIMIT = 256 * 1024 * 1024 };
+
+	typedef std::multimap<size_t, Block*> FreeMap;
+
+	FreeMap m_freeBlocks;
+	size_t m_cachedBytes;
+	int m_scopeLevel;
+};
+
+
+QThreadStorage<ThreadArena*> thread_arena;
+
+
+ThreadArena::~ThreadArena()
+{
+	FreeMap::const_iterator it(m_freeBlocks.begin());
+	FreeMap::const_iterator const end(m_freeBlocks.end());
+	for (; it != end; ++it) {
+		free(it->second);
+	}
+}
+
+Block*
+ThreadArena::takeBlock(size_t const num_bytes)
+{
+	FreeMap::iterator const it(m_freeBlocks.lower_bound(num_bytes));
+	if (it == m_freeBlocks.end()) {
+		return 0;
+	}
+
+	// Don't waste a block more than twice the requested size
+	// on this allocation.
+	if (it->first > num_bytes * 2) {
+		return 0;
+	}
+
+	Block* const block = it->second;
+	m_cachedBytes -= block->capacity;
+	m_freeBlocks.erase(it);
+
+	return block;
+}
+
+bool
+ThreadArena::cacheBlock(Block* const block)
+{
+	if (m_cachedBytes + block->capacity > (size_t)CACHE_LIMIT) {
+		return false;
+	}
+
+	m_freeBlocks.insert(FreeMap::value_type(block->capacity, block));
+	m_cachedBytes += block->capacity;
+
+	return true;
+}
+
+} // anonymous namespace
+
+
+/*========================= ImageArena::Scope ==========================*/
+
+ImageArena::Scope::Scope()
+{
+	ThreadArena* arena = thread_arena.localData();
+	if (!arena) {
+		arena = new ThreadArena;
+		thread_arena.setLocalData(arena);
+	}
+	++arena->scopeLevel();
+}
+
+ImageArena::Scope::~Scope()
+{
+	ThreadArena* const arena = thread_arena.localData();
+	assert(arena);
+	if (--arena->scopeLevel() == 0) {
+		// This deletes the ThreadArena, releasing the cache.
+		thread_arena.setLocalData(0);
+	}
+}
+
+
+/*============================ ImageArena =============================*/
+
+void*
+ImageArena::alloc(size_t const num_bytes)
+{
+	Block* block = 0;
+
+	if (ThreadArena* const arena = thread_arena.localData()) {
+		block = arena->takeBlock(num_bytes);
+	}
+
+	if (!block) {
+		size_t total_bytes = sizeof(Block) + num_bytes;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+		if (huge_pages_enabled && total_bytes >= HUGE_PAGE_THRESHOLD) {
+			// Round up to whole huge pages and align the block
+			// on a huge page boundary, so the kernel can back
+			// the entire allocation with 2MB pages.
+			total_bytes = (total_bytes + HUGE_PAGE_SIZE - 1)
+				& ~(HUGE_PAGE_SIZE - 1);
+			void* addr = 0;
+			if (posix_memalign(&addr, HUGE_PAGE_SIZE, total_bytes) == 0) {
+				madvise(addr, total_bytes, MADV_HUGEPAGE);
+				block = (Block*)addr;
+			}
+		}
+#endif
+		if (!block) {
+			block = (Block*)malloc(total_bytes);
+			if (!block) {
+				return 0;
+			}
+		}
+		block->capacity = total_bytes - sizeof(Block);
+	}
+
+	// Cached blocks count as live only while handed out.
+	MemoryTracker::instance().add(block->capacity);
+
+	return block + 1;
+}
+
+void
+ImageArena::release(void* const addr)
+{
+	if (!addr) {
+		return;
+	}
+
+	Block* const block = (Block*)addr - 1;
+
+	MemoryTracker::instance().remove(block->capacity);
+
+	if (ThreadArena* const arena = thread_arena.localData()) {
+		if (arena->cacheBlock(block)) {
+			return;
+		}
+	}
+
+	free(block);
+}
+
+void
+ImageArena::setHugePagesEnabled(bool const enabled)
+{
+	huge_pages_enabled = enabled;
+}
+
+void
+ImageArena::adviseHugePages(void* const addr, size_t const num_bytes)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	if (!huge_pages_enabled || num_bytes < HUGE_PAGE_THRESHOLD) {
+		return;
+	}
+
+	// madvise() wants page-aligned addresses, and we don't own
+	// the allocation, so only advise the whole pages inside it.
+	size_t const page_size = 4096;
+	uintptr_t const begin = (uintptr_t(addr) + page_size - 1) & ~(page_size - 1);
+	uintptr_t const end = (uintptr_t(addr) + num_bytes) & ~(page_size - 1);
+	if (end > begin) {
+		madvise((void*)begin, end - begin, MADV_HUGEPAGE);
+	}
+#else
+	(void)addr;
+	(void)num_bytes;
+#endif
+}
+
+} // namespace imageproc
@@ -0,0 +1,112 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_IMAGE_ARENA_H_
+#define IMAGEPROC_IMAGE_ARENA_H_
+
+#include "NonCopyable.h"
+#include <stddef.h>
+
+namespace imageproc
+{
+
+/**
+ * \brief A per-thread recycling arena for image buffers.
+ *
+ * While an ImageArena::Scope is alive on a thread, image buffers
+ * released on that thread are kept in a per-thread cache rather than
+ * returned to the global allocator, and subsequent allocations of a
+ * similar size are satisfied from that cache.  When the outermost
+ * scope ends, the cache is released wholesale.
+ *
+ * A processing pipeline, such as the one in OutputGenerator, keeps
+ * allocating and freeing full-page temporaries of just a few distinct
+ * sizes.  Under parallel batch processing, routing those through the
+ * global allocator causes lock contention and fragmentation.  With an
+ * arena scope active, each of those allocations after the first few
+ * is a cache lookup instead.
+ *
+ * Blocks are self-describing, so an image that outlives the scope it
+ * was allocated in (an implicitly shared copy handed to another
+ * thread, for example) remains valid and is freed normally when its
+ * last reference goes away.
+ */
+class ImageArena
+{
+	DECLARE_NON_COPYABLE(ImageArena)
+public:
+	/**
+	 * \brief Activates the arena for the current thread.
+	 *
+	 * Scopes may nest.  The cache is released when the
+	 * outermost scope is destroyed.
+	 */
+	class Scope
+	{
+		DECLARE_NON_COPYABLE(Scope)
+	public:
+		Scope();
+
+		~Scope();
+	};
+
+	/**
+	 * \brief Allocates a buffer of at least the requested size.
+	 *
+	 * Reuses a cached block if the current thread has an active
+	 * arena scope and a suitable block is available, otherwise
+	 * allocates from the heap.  Returns null on allocation failure.
+	 */
+	static void* alloc(size_t num_bytes);
+
+	/**
+	 * \brief Releases a buffer obtained from alloc().
+	 *
+	 * The buffer goes to the current thread's cache if an arena
+	 * scope is active, otherwise back to the heap.  May be called
+	 * from a different thread than the one that did the allocation.
+	 */
+	static void release(void* addr);
+
+	/**
+	 * \brief Enables backing large buffers with 2MB huge pages.
+	 *
+	 * When enabled, alloc() places buffers above a size threshold
+	 * on huge page boundaries and asks the kernel to back them
+	 * with transparent huge pages, reducing TLB pressure when
+	 * walking large images.  Only effective on Linux; a no-op
+	 * elsewhere.  Disabled by default.
+	 */
+	static void setHugePagesEnabled(bool enabled);
+
+	/**
+	 * \brief Requests huge page backing for an existing buffer.
+	 *
+	 * Best effort: only the whole pages within [addr, addr +
+	 * num_bytes) are advised, and only if huge pages are enabled
+	 * and the buffer is large enough.  For buffers whose
+	 * allocation we don't control, such as those owned by QImage.
+	 */
+	static void adviseHugePages(void* addr, size_t num_bytes);
+private:
+	ImageArena();
+};
+
+} // namespace imageproc
+
+#endif
@@ -19,12 +19,13 @@
 #include "InfluenceMap.h"
 #include "BinaryImage.h"
 #include "ConnectivityMap.h"
-#include "FastQueue.h"
 #include "BitOps.h"
 #include <QImage>
 #include <QColor>
+#include <vector>
 #include <algorithm>
 #include <stdexcept>
+#include <math.h>
 #include <assert.h>
 
 class QImage;
@@ -32,6 +33,62 @@ class QImage;
 namespace imageproc
 {
 
+namespace
+{
+
+/**
+ * \brief A Dial-style bucket queue, ordered by the euclidean distance.
+ *
+ * Cells are binned by the integer part of their distance from the
+ * nearest seed.  Draining the buckets in order approximates processing
+ * by increasing distance, so by the time a cell is expanded its final
+ * label and distance have almost always settled, and the re-expansions
+ * a plain FIFO suffers from mostly disappear.  The propagation remains
+ * label-correcting (improvements are accepted whenever found), so the
+ * occasional out-of-order entry only costs a wasted expansion.
+ */
+class DistBucketQueue
+{
+public:
+	DistBucketQueue(int width, int height)
+	:	m_buckets(
+			1 + 2 + (size_t)sqrt(double(width) * width + double(height) * height)
+		),
+		m_curBucket(0) {}
+
+	void push(uint32_t const dist_sq, InfluenceMap::Cell* const cell) {
+		size_t idx = (size_t)sqrt((double)dist_sq);
+		if (idx < m_curBucket) {
+			// A late improvement crossing the current wavefront.
+			idx = m_curBucket;
+		} else if (idx >= m_buckets.size()) {
+			idx = m_buckets.size() - 1;
+		}
+		m_buckets[idx].push_back(cell);
+	}
+
+	/**
+	 * \brief Returns the next cell to expand, or null when drained.
+	 */
+	InfluenceMap::Cell* next() {
+		for (;; ++m_curBucket) {
+			if (m_curBucket == m_buckets.size()) {
+				return 0;
+			}
+			if (!m_buckets[m_curBucket].empty()) {
+				InfluenceMap::Cell* const cell = m_buckets[m_curBucket].back();
+				m_buckets[m_curBucket].pop_back();
+				return cell;
+			}
+		}
+	}
+private:
+	std::vector<std::vector<InfluenceMap::Cell*> > m_buckets;
+	size_t m_curBucket;
+};
+
+} // anonymous namespace
+
 InfluenceMap::InfluenceMap()
 :	m_pData(0),
 	m_size(),
@@ -112,8 +169,8 @@ InfluenceMap::init(
 	m_pData = &m_data[0] + width + 1;
 	m_maxLabel = cmap.maxLabel();
 	
-	FastQueue<Cell*> queue;
-	
+	DistBucketQueue queue(width, height);
+
 	Cell* cell = &m_data[0];
 	uint32_t const* label = cmap.paddedData();
 	for (int i = width * height; i > 0; --i) {
@@ -123,7 +180,7 @@ InfluenceMap::init(
 		cell->vec.x = 0;
 		cell->vec.y = 0;
 		if (*label != 0) {
-			queue.push(cell);
+			queue.push(0, cell);
 		}
 		++cell;
 		++label;
@@ -157,10 +214,8 @@ InfluenceMap::init(
 		}
 	}
 	
-	while (!queue.empty()) {
-		cell = queue.front();
-		queue.pop();
-		
+	while ((cell = queue.next())) {
+
 		assert((cell - &m_data[0]) / width > 0);
 		assert((cell - &m_data[0]) / width < height - 1);
 		assert((cell - &m_data[0]) % width > 0);
@@ -180,7 +235,7 @@ InfluenceMap::init(
 			nbh->distSq = new_dist_sq;
 			nbh->vec.x = cell->vec.x + 1;
 			nbh->vec.y = cell->vec.y + 1;
-			queue.push(nbh);
+			queue.push(new_dist_sq, nbh);
 		}
 		
 		// Northern neighbor.
@@ -191,7 +246,7 @@ InfluenceMap::init(
 			nbh->distSq = new_dist_sq;
 			nbh->vec.x = cell->vec.x;
 			nbh->vec.y = cell->vec.y + 1;
-			queue.push(nbh);
+			queue.push(new_dist_sq, nbh);
 		}
 		
 		// North-eastern neighbor.
@@ -202,7 +257,7 @@ InfluenceMap::init(
 			nbh->distSq = new_dist_sq;
 			nbh->vec.x = cell->vec.x - 1;
 			nbh->vec.y = cell->vec.y + 1;
-			queue.push(nbh);
+			queue.push(new_dist_sq, nbh);
 		}
 		
 		// Eastern neighbor.
@@ -213,7 +268,7 @@ InfluenceMap::init(
 			nbh->distSq = new_dist_sq;
 			nbh->vec.x = cell->vec.x - 1;
 			nbh->vec.y = cell->vec.y;
-			queue.push(nbh);
+			queue.push(new_dist_sq, nbh);
 		}
 		
 		// South-eastern neighbor.
@@ -224,7 +279,7 @@ InfluenceMap::init(
 			nbh->distSq = new_dist_sq;
 			nbh->vec.x = cell->vec.x - 1;
 			nbh->vec.y = cell->vec.y - 1;
-			queue.push(nbh);
+			queue.push(new_dist_sq, nbh);
 		}
 		
 		// Southern neighbor.
@@ -235,7 +290,7 @@ InfluenceMap::init(
 			nbh->distSq = new_dist_sq;
 			nbh->vec.x = cell->vec.x;
 			nbh->vec.y = cell->vec.y - 1;
-			queue.push(nbh);
+			queue.push(new_dist_sq, nbh);
 		}
 		
 		// South-western neighbor.
@@ -246,7 +301,7 @@ InfluenceMap::init(
 			nbh->distSq = new_dist_sq;
 			nbh->vec.x = cell->vec.x + 1;
 			nbh->vec.y = cell->vec.y - 1;
-			queue.push(nbh);
+			queue.push(new_dist_sq, nbh);
 		}
 		
 		// Western neighbor.
@@ -257,7 +312,7 @@ InfluenceMap::init(
 			nbh->distSq = new_dist_sq;
 			nbh->vec.x = cell->vec.x + 1;
 			nbh->vec.y = cell->vec.y;
-			queue.push(nbh);
+			queue.push(new_dist_sq, nbh);
 		}
 	}
 }
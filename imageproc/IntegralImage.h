@@ -67,6 +67,40 @@ public:
 	 */
 	void push(T val);
 	
+	/**
+	 * \brief Push a whole row of values at once.
+	 *
+	 * An alternative to beginRow() plus a sequence of push() calls.
+	 * Only the row-wise prefix sums are computed right away - the
+	 * column-wise accumulation is deferred until finish(), which
+	 * must be called after the last row.  Deferring it breaks the
+	 * dependency on the row above out of the prefix sum chain and
+	 * turns it into a sequence of independent row additions.
+	 *
+	 * Don't mix this with beginRow() / push() within one image.
+	 */
+	template<typename V>
+	void pushRow(V const* vals, int len);
+
+	/**
+	 * \brief Same as pushRow(), but accumulates squared values.
+	 *
+	 * Saves the caller a temporary buffer of squared values.
+	 * T must be large enough to hold the sum of squares - for 8-bit
+	 * pixels that means uint64_t rather than uint32_t on anything
+	 * bigger than a thumbnail.
+	 */
+	template<typename V>
+	void pushRowSquared(V const* vals, int len);
+
+	/**
+	 * \brief Performs the column-wise pass deferred by pushRow().
+	 *
+	 * To be called exactly once, after the last row was pushed.
+	 * Until then, sum() returns garbage.
+	 */
+	void finish();
+
 	/**
 	 * \brief Calculate the sum of values in the given rectangle.
 	 *
@@ -76,7 +110,7 @@ public:
 	T sum(QRect const& rect) const;
 private:
 	void init(int width, int height);
-	
+
 	T* m_pData;
 	T* m_pCur;
 	T* m_pAbove;
@@ -150,6 +184,64 @@ IntegralImage<T>::beginRow()
 	++m_pAbove;
 }
 
+template<typename T>
+template<typename V>
+void
+IntegralImage<T>::pushRow(V const* const vals, int const len)
+{
+	T* const cur = m_pCur;
+	cur[0] = T(); // The fake column.
+
+	// Note the absence of the row above in this loop.  The prefix
+	// sum is a dependent chain as it is - the independent part is
+	// done in bulk by finish().
+	T line_sum = T();
+	for (int i = 0; i < len; ++i) {
+		line_sum += T(vals[i]);
+		cur[i + 1] = line_sum;
+	}
+
+	m_pCur += m_width;
+	m_pAbove += m_width;
+}
+
+template<typename T>
+template<typename V>
+void
+IntegralImage<T>::pushRowSquared(V const* const vals, int const len)
+{
+	T* const cur = m_pCur;
+	cur[0] = T(); // The fake column.
+
+	T line_sum = T();
+	for (int i = 0; i < len; ++i) {
+		T const val(vals[i]);
+		line_sum += val * val;
+		cur[i + 1] = line_sum;
+	}
+
+	m_pCur += m_width;
+	m_pAbove += m_width;
+}
+
+template<typename T>
+void
+IntegralImage<T>::finish()
+{
+	// Accumulate each row into the one below it.  Unlike the prefix
+	// sums, the elements of a row are independent here, so this pass
+	// vectorizes and runs at memory speed.
+	T* above = m_pData; // The fake row is all zeros - adding it is harmless.
+	T* cur = m_pData + m_width;
+	for (int y = 1; y < m_height; ++y) {
+		for (int x = 0; x < m_width; ++x) {
+			cur[x] += above[x];
+		}
+		above = cur;
+		cur += m_width;
+	}
+}
+
 template<typename T>
 inline T
 IntegralImage<T>::sum(QRect const& rect) const
@@ -21,6 +21,7 @@
 #include "GrayImage.h"
 #include "RasterOp.h"
 #include "Grayscale.h"
+#include "ParallelFor.h"
 #include <QPoint>
 #include <QSize>
 #include <QRect>
@@ -33,6 +34,7 @@
 #include <algorithm>
 #include <math.h>
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
 namespace imageproc
@@ -797,6 +799,285 @@ GrayImage dilateOrErodeGray(
 	return dst;
 }
 
+/*====================== Run-length morphology ========================*/
+
+/**
+ * A half-open horizontal span of black pixels.
+ */
+struct Run
+{
+	int begin; // First black pixel.
+	int end; // One past the last black pixel.
+
+	Run(int begin_, int end_) : begin(begin_), end(end_) {}
+};
+
+typedef std::vector<Run> RunRow;
+
+/**
+ * Images at least this big (in pixels) get the run-length engine,
+ * whose cost scales with the number of black runs rather than with
+ * image area.  Below the threshold the fixed overhead of converting
+ * to runs and back isn't worth it.
+ */
+int const RLE_AREA_THRESHOLD = 1 << 20;
+
+void extractRuns(BinaryImage const& img, std::vector<RunRow>& rows)
+{
+	int const w = img.width();
+	int const h = img.height();
+	int const wpl = img.wordsPerLine();
+	int const num_words = (w + 31) >> 5;
+	uint32_t const msb = uint32_t(1) << 31;
+	uint32_t const* line = img.data();
+
+	rows.clear();
+	rows.resize(h);
+
+	for (int y = 0; y < h; ++y, line += wpl) {
+		RunRow& row = rows[y];
+		int run_begin = -1;
+
+		for (int widx = 0; widx < num_words; ++widx) {
+			uint32_t word = line[widx];
+			if (widx == num_words - 1 && (w & 31) != 0) {
+				// Mask off padding bits.
+				word &= ~uint32_t(0) << (32 - (w & 31));
+			}
+			int const base = widx << 5;
+
+			if (word == 0) {
+				if (run_begin >= 0) {
+					row.push_back(Run(run_begin, base));
+					run_begin = -1;
+				}
+			} else if (word == ~uint32_t(0)) {
+				if (run_begin < 0) {
+					run_begin = base;
+				}
+			} else {
+				for (int bit = 0; bit < 32; ++bit) {
+					if (word & (msb >> bit)) {
+						if (run_begin < 0) {
+							run_begin = base + bit;
+						}
+					} else if (run_begin >= 0) {
+						row.push_back(Run(run_begin, base + bit));
+						run_begin = -1;
+					}
+				}
+			}
+		}
+
+		if (run_begin >= 0) {
+			row.push_back(Run(run_begin, w));
+		}
+	}
+}
+
+BinaryImage buildImageFromRuns(
+	std::vector<RunRow> const& rows, int const w, int const h)
+{
+	BinaryImage dst(w, h, WHITE);
+	uint32_t* line = dst.data();
+	int const wpl = dst.wordsPerLine();
+
+	for (int y = 0; y < h; ++y, line += wpl) {
+		RunRow const& row = rows[y];
+		for (RunRow::const_iterator it(row.begin()); it != row.end(); ++it) {
+			int const first_word = it->begin >> 5;
+			int const last_word = (it->end - 1) >> 5;
+			uint32_t const first_mask = ~uint32_t(0) >> (it->begin & 31);
+			uint32_t const last_mask = ~uint32_t(0) << (31 - ((it->end - 1) & 31));
+			if (first_word == last_word) {
+				line[first_word] |= first_mask & last_mask;
+			} else {
+				line[first_word] |= first_mask;
+				for (int widx = first_word + 1; widx < last_word; ++widx) {
+					line[widx] = ~uint32_t(0);
+				}
+				line[last_word] |= last_mask;
+			}
+		}
+	}
+
+	return dst;
+}
+
+/**
+ * Horizontal dilation: a run [b, e) spreads to [b + min_x, e + max_x),
+ * following the translation convention of dilateOrErodeBrick().
+ */
+void dilateRowsHorizontally(
+	std::vector<RunRow>& rows, int const min_x, int const max_x, int const width)
+{
+	RunRow merged;
+
+	for (size_t y = 0; y < rows.size(); ++y) {
+		RunRow& row = rows[y];
+		merged.clear();
+
+		for (RunRow::const_iterator it(row.begin()); it != row.end(); ++it) {
+			int const b = std::max(0, it->begin + min_x);
+			int const e = std::min(width, it->end + max_x);
+			if (e <= b) {
+				continue;
+			}
+			if (!merged.empty() && b <= merged.back().end) {
+				merged.back().end = std::max(merged.back().end, e);
+			} else {
+				merged.push_back(Run(b, e));
+			}
+		}
+
+		row.swap(merged);
+	}
+}
+
+/**
+ * Horizontal erosion: a run [b, e) shrinks to [b + max_x, e + min_x).
+ */
+void erodeRowsHorizontally(
+	std::vector<RunRow>& rows, int const min_x, int const max_x, int const width)
+{
+	RunRow shrunk;
+
+	for (size_t y = 0; y < rows.size(); ++y) {
+		RunRow& row = rows[y];
+		shrunk.clear();
+
+		for (RunRow::const_iterator it(row.begin()); it != row.end(); ++it) {
+			int const b = std::max(0, it->begin + max_x);
+			int const e = std::min(width, it->end + min_x);
+			if (e > b) {
+				shrunk.push_back(Run(b, e));
+			}
+		}
+
+		row.swap(shrunk);
+	}
+}
+
+void unionRows(RunRow const& a, RunRow const& b, RunRow& out)
+{
+	out.clear();
+	RunRow::const_iterator ia(a.begin());
+	RunRow::const_iterator ib(b.begin());
+
+	while (ia != a.end() || ib != b.end()) {
+		Run next(0, 0);
+		if (ib == b.end() || (ia != a.end() && ia->begin <= ib->begin)) {
+			next = *ia;
+			++ia;
+		} else {
+			next = *ib;
+			++ib;
+		}
+		if (!out.empty() && next.begin <= out.back().end) {
+			out.back().end = std::max(out.back().end, next.end);
+		} else {
+			out.push_back(next);
+		}
+	}
+}
+
+void intersectRows(RunRow const& a, RunRow const& b, RunRow& out)
+{
+	out.clear();
+	RunRow::const_iterator ia(a.begin());
+	RunRow::const_iterator ib(b.begin());
+
+	while (ia != a.end() && ib != b.end()) {
+		int const b_ = std::max(ia->begin, ib->begin);
+		int const e_ = std::min(ia->end, ib->end);
+		if (e_ > b_) {
+			out.push_back(Run(b_, e_));
+		}
+		if (ia->end < ib->end) {
+			++ia;
+		} else {
+			++ib;
+		}
+	}
+}
+
+/**
+ * Vertical dilation or erosion: destination row y combines source rows
+ * [y - max_y, y - min_y], by union for dilation and intersection for
+ * erosion.  Like spreadInDirectionLow(), the window is built up by
+ * combining already-combined sub-windows, so the number of merge passes
+ * is logarithmic in the brick height.
+ */
+void combineRowsVertically(
+	std::vector<RunRow>& rows, int const min_y, int const max_y,
+	int const height, bool const dilate)
+{
+	int const len = max_y - min_y + 1;
+	if (len == 1 && max_y == 0) {
+		return;
+	}
+
+	// cur[i] combines source rows [i - max_y, i - max_y + s).
+	// Entries beyond the image are empty, which matches white
+	// surroundings for both union and intersection.
+	int const ext_size = height + len;
+	std::vector<RunRow> cur(ext_size);
+	for (int i = 0; i < ext_size; ++i) {
+		int const src_row = i - max_y;
+		if (src_row >= 0 && src_row < height) {
+			cur[i].swap(rows[src_row]);
+		}
+	}
+
+	std::vector<RunRow> next(ext_size);
+	int s = 1;
+	while (s < len) {
+		int const t = std::min(s, len - s);
+		for (int i = 0; i < ext_size; ++i) {
+			if (i + t < ext_size) {
+				if (dilate) {
+					unionRows(cur[i], cur[i + t], next[i]);
+				} else {
+					intersectRows(cur[i], cur[i + t], next[i]);
+				}
+			} else {
+				// Only rows whose window fits in the array are ever
+				// read downstream, so this value doesn't matter.
+				next[i].clear();
+			}
+		}
+		cur.swap(next);
+		s += t;
+	}
+
+	for (int y = 0; y < height; ++y) {
+		rows[y].swap(cur[y]);
+	}
+}
+
+BinaryImage dilateOrErodeBrickRle(
+	BinaryImage const& src, Brick const& brick, bool const dilate)
+{
+	int const w = src.width();
+	int const h = src.height();
+
+	std::vector<RunRow> rows;
+	extractRuns(src, rows);
+
+	if (brick.minX() != 0 || brick.maxX() != 0) {
+		if (dilate) {
+			dilateRowsHorizontally(rows, brick.minX(), brick.maxX(), w);
+		} else {
+			erodeRowsHorizontally(rows, brick.minX(), brick.maxX(), w);
+		}
+	}
+	if (brick.minY() != 0 || brick.maxY() != 0) {
+		combineRowsVertically(rows, brick.minY(), brick.maxY(), h, dilate);
+	}
+
+	return buildImageFromRuns(rows, w, h);
+}
+
 } // anonymous namespace
 
 
@@ -814,10 +1095,17 @@ BinaryImage dilateBrick(
 		throw std::invalid_argument("dilateBrick: dst_area is empty");
 	}
 	
+	if (dst_area == src.rect() && src_surroundings == WHITE
+			&& (uint64_t)src.width() * src.height() >= RLE_AREA_THRESHOLD) {
+		// For large, mostly white images the run-length engine
+		// beats repeated shifted rasterOps by a wide margin.
+		return dilateOrErodeBrickRle(src, brick, true);
+	}
+
 	TemplateRasterOp<RopOr<RopSrc, RopDst> > rop;
 	BinaryImage dst(dst_area.size());
 	dilateOrErodeBrick(dst, src, brick, dst_area, src_surroundings, rop, BLACK);
-	
+
 	return dst;
 }
 
@@ -864,12 +1152,17 @@ BinaryImage erodeBrick(
 		throw std::invalid_argument("erodeBrick: dst_area is empty");
 	}
 	
+	if (dst_area == src.rect() && src_surroundings == WHITE
+			&& (uint64_t)src.width() * src.height() >= RLE_AREA_THRESHOLD) {
+		return dilateOrErodeBrickRle(src, brick, false);
+	}
+
 	typedef RopAnd<RopSrc, RopDst> Rop;
-	
+
 	TemplateRasterOp<RopAnd<RopSrc, RopDst> > rop;
 	BinaryImage dst(dst_area.size());
 	dilateOrErodeBrick(dst, src, brick, dst_area, src_surroundings, rop, WHITE);
-	
+
 	return dst;
 }
 
@@ -1186,10 +1479,26 @@ BinaryImage hitMissReplace(
 }
 
 
-void hitMissReplaceInPlace(
-	BinaryImage& img, BWColor const src_surroundings,
+namespace
+{
+
+struct HitMissDecoded
+{
+	std::vector<QPoint> hits;
+	std::vector<QPoint> misses;
+	std::vector<QPoint> whiteToBlack;
+	std::vector<QPoint> blackToWhite;
+};
+
+/**
+ * Parses a hit-miss replacement pattern into offsets relative to the
+ * pattern origin.  Returns false if the pattern requests no replacements,
+ * in which case applying it would be a no-op.
+ */
+bool decodeHitMissPattern(
 	char const* const pattern,
-	int const pattern_width, int const pattern_height)
+	int const pattern_width, int const pattern_height,
+	HitMissDecoded& decoded)
 {
 	// It's better to have the origin at one of the replacement positions.
 	// Otherwise we may miss a partially outside-of-image match because
@@ -1206,34 +1515,29 @@ void hitMissReplaceInPlace(
 		origin_pos = plus_pos;
 	} else {
 		// No replacements requested - nothing to do.
-		return;
+		return false;
 	}
-	
+
 	QPoint const origin(
 		(origin_pos - pattern) % pattern_width,
 		(origin_pos - pattern) / pattern_width
 	);
-	
-	std::vector<QPoint> hits;
-	std::vector<QPoint> misses;
-	std::vector<QPoint> white_to_black;
-	std::vector<QPoint> black_to_white;
-	
+
 	char const* p = pattern;
 	for (int y = 0; y < pattern_height; ++y) {
 		for (int x = 0; x < pattern_width; ++x, ++p) {
 			switch (*p) {
 				case '-':
-					black_to_white.push_back(QPoint(x, y) - origin);
+					decoded.blackToWhite.push_back(QPoint(x, y) - origin);
 					// fall through
 				case 'X':
-					hits.push_back(QPoint(x, y) - origin);
+					decoded.hits.push_back(QPoint(x, y) - origin);
 					break;
 				case '+':
-					white_to_black.push_back(QPoint(x, y) - origin);
+					decoded.whiteToBlack.push_back(QPoint(x, y) - origin);
 					// fall through
 				case ' ':
-					misses.push_back(QPoint(x, y) - origin);
+					decoded.misses.push_back(QPoint(x, y) - origin);
 					break;
 				case '?':
 					break;
@@ -1244,29 +1548,265 @@ void hitMissReplaceInPlace(
 			}
 		}
 	}
-	
-	BinaryImage const matches(hitMissMatch(img, src_surroundings, hits, misses));
+
+	return true;
+}
+
+void applyHitMissReplacements(
+	BinaryImage& img, BinaryImage const& matches, HitMissDecoded const& decoded)
+{
 	QRect const rect(img.rect());
-		
-	BOOST_FOREACH (QPoint const& offset, white_to_black) {
+
+	BOOST_FOREACH (QPoint const& offset, decoded.whiteToBlack) {
 		QRect src_rect(rect);
 		QRect dst_rect(rect.translated(offset));
 		adjustToFit(rect, dst_rect, src_rect);
-		
+
 		rasterOp<RopOr<RopSrc, RopDst> >(
 			img, dst_rect, matches, src_rect.topLeft()
 		);
 	}
-	
-	BOOST_FOREACH (QPoint const& offset, black_to_white) {
+
+	BOOST_FOREACH (QPoint const& offset, decoded.blackToWhite) {
 		QRect src_rect(rect);
 		QRect dst_rect(rect.translated(offset));
 		adjustToFit(rect, dst_rect, src_rect);
-		
+
 		rasterOp<RopSubtract<RopDst, RopSrc> >(
 			img, dst_rect, matches, src_rect.topLeft()
 		);
 	}
 }
 
+/**
+ * A pattern cell prepared for word-at-a-time sampling:
+ * (dx, dy) is decomposed into a line delta, a word delta and
+ * a residual bit shift in the range of [0, 31].
+ */
+struct ShiftedOffset
+{
+	int lineDelta;
+	int wordDelta;
+	int bitShift;
+	bool invert; // A miss rather than a hit.
+
+	ShiftedOffset(QPoint const& offset, bool invert)
+	:	lineDelta(offset.y()),
+		wordDelta(offset.x() >> 5),
+		bitShift(offset.x() & 31),
+		invert(invert) {}
+};
+
+inline bool sampleBit(
+	uint32_t const* const data, int const wpl,
+	int const width, int const height,
+	int const x, int const y, bool const oob_black)
+{
+	if (x < 0 || x >= width || y < 0 || y >= height) {
+		return oob_black;
+	}
+	return (data[wpl * y + (x >> 5)] >> (31 - (x & 31))) & 1;
+}
+
+/**
+ * Equivalent to hitMissMatch(), but evaluates all pattern cells in a
+ * single pass over the image instead of one full-image raster
+ * operation per cell.
+ */
+BinaryImage fusedHitMissMatch(
+	BinaryImage const& src, BWColor const src_surroundings,
+	std::vector<QPoint> const& hits, std::vector<QPoint> const& misses)
+{
+	if (src.isNull()) {
+		return BinaryImage();
+	}
+
+	BinaryImage dst(src.size(), WHITE);
+	if (hits.empty() && misses.empty()) {
+		return dst; // No matches, same as hitMissMatch().
+	}
+
+	int const width = src.width();
+	int const height = src.height();
+	bool const oob_black = (src_surroundings == BLACK);
+
+	std::vector<ShiftedOffset> offsets;
+	offsets.reserve(hits.size() + misses.size());
+	int dx_min = 0, dx_max = 0, dy_min = 0, dy_max = 0;
+
+	BOOST_FOREACH (QPoint const& hit, hits) {
+		offsets.push_back(ShiftedOffset(hit, false));
+		dx_min = std::min(dx_min, hit.x());
+		dx_max = std::max(dx_max, hit.x());
+		dy_min = std::min(dy_min, hit.y());
+		dy_max = std::max(dy_max, hit.y());
+	}
+	BOOST_FOREACH (QPoint const& miss, misses) {
+		offsets.push_back(ShiftedOffset(miss, true));
+		dx_min = std::min(dx_min, miss.x());
+		dx_max = std::max(dx_max, miss.x());
+		dy_min = std::min(dy_min, miss.y());
+		dy_max = std::max(dy_max, miss.y());
+	}
+
+	uint32_t const* const src_data = src.data();
+	int const src_wpl = src.wordsPerLine();
+	uint32_t* const dst_data = dst.data();
+	int const dst_wpl = dst.wordsPerLine();
+
+	// Rows and words where every sampled pixel is guaranteed to be
+	// within the image get the word-at-a-time treatment.  The narrow
+	// band around them is handled by the per-pixel loop below.
+	int const fast_begin_y = std::min(height, std::max(0, -dy_min));
+	int const fast_end_y = std::max(fast_begin_y, std::min(height, height - dy_max));
+	int const fast_begin_w = dx_min >= 0 ? 0 : (31 - dx_min) >> 5;
+	int fast_end_w = fast_begin_w;
+	if (width - 32 - dx_max >= 0) {
+		fast_end_w = std::max(fast_begin_w, ((width - 32 - dx_max) >> 5) + 1);
+	}
+
+	size_t const num_offsets = offsets.size();
+	ShiftedOffset const* const offs = &offsets[0];
+
+	for (int y = fast_begin_y; y < fast_end_y; ++y) {
+		uint32_t const* const src_line = src_data + src_wpl * y;
+		uint32_t* const dst_line = dst_data + dst_wpl * y;
+		for (int w = fast_begin_w; w < fast_end_w; ++w) {
+			uint32_t acc = ~uint32_t(0);
+			for (size_t i = 0; i < num_offsets && acc; ++i) {
+				ShiftedOffset const& off = offs[i];
+				uint32_t const* const p =
+					src_line + src_wpl * off.lineDelta + w + off.wordDelta;
+				uint32_t word;
+				if (off.bitShift) {
+					word = (p[0] << off.bitShift) | (p[1] >> (32 - off.bitShift));
+				} else {
+					word = p[0];
+				}
+				acc &= off.invert ? ~word : word;
+			}
+			dst_line[w] = acc;
+		}
+	}
+
+	// The loop above writes whole words, possibly touching the unused
+	// bits of the last word in a line.  Keep the padding white.
+	if ((width & 31) && fast_end_w * 32 > width) {
+		uint32_t const padding_mask = ~uint32_t(0) << (32 - (width & 31));
+		for (int y = fast_begin_y; y < fast_end_y; ++y) {
+			dst_data[dst_wpl * y + fast_end_w - 1] &= padding_mask;
+		}
+	}
+
+	// Per-pixel processing for the pixels the fast path didn't cover.
+	uint32_t const msb = uint32_t(1) << 31;
+	for (int y = 0; y < height; ++y) {
+		bool const fast_row = y >= fast_begin_y && y < fast_end_y
+			&& fast_end_w > fast_begin_w;
+		uint32_t* const dst_line = dst_data + dst_wpl * y;
+		for (int x = 0; x < width; ++x) {
+			if (fast_row && x == fast_begin_w * 32) {
+				x = fast_end_w * 32;
+				if (x >= width) {
+					break;
+				}
+			}
+			bool match = true;
+			for (size_t i = 0; i < num_offsets; ++i) {
+				ShiftedOffset const& off = offs[i];
+				int const sx = x + off.wordDelta * 32 + off.bitShift;
+				bool const black = sampleBit(
+					src_data, src_wpl, width, height,
+					sx, y + off.lineDelta, oob_black
+				);
+				if (black == off.invert) {
+					match = false;
+					break;
+				}
+			}
+			if (match) {
+				dst_line[x >> 5] |= msb >> (x & 31);
+			}
+		}
+	}
+
+	return dst;
+}
+
+class MatchHitMissPatterns
+{
+public:
+	MatchHitMissPatterns(
+		BinaryImage const& img, BWColor src_surroundings,
+		std::vector<HitMissDecoded> const& decoded,
+		std::vector<BinaryImage>& matches)
+	:	m_rImg(img), m_srcSurroundings(src_surroundings),
+		m_rDecoded(decoded), m_rMatches(matches) {}
+
+	void operator()(int const begin, int const end) const {
+		for (int i = begin; i < end; ++i) {
+			m_rMatches[i] = fusedHitMissMatch(
+				m_rImg, m_srcSurroundings,
+				m_rDecoded[i].hits, m_rDecoded[i].misses
+			);
+		}
+	}
+private:
+	BinaryImage const& m_rImg;
+	BWColor m_srcSurroundings;
+	std::vector<HitMissDecoded> const& m_rDecoded;
+	std::vector<BinaryImage>& m_rMatches;
+};
+
+} // anonymous namespace
+
+void hitMissReplaceInPlace(
+	BinaryImage& img, BWColor const src_surroundings,
+	char const* const pattern,
+	int const pattern_width, int const pattern_height)
+{
+	HitMissDecoded decoded;
+	if (!decodeHitMissPattern(pattern, pattern_width, pattern_height, decoded)) {
+		return;
+	}
+
+	BinaryImage const matches(
+		hitMissMatch(img, src_surroundings, decoded.hits, decoded.misses)
+	);
+	applyHitMissReplacements(img, matches, decoded);
+}
+
+void hitMissReplaceInPlace(
+	BinaryImage& img, BWColor const src_surroundings,
+	std::vector<HitMissPattern> const& patterns)
+{
+	if (img.isNull()) {
+		return;
+	}
+
+	std::vector<HitMissDecoded> decoded;
+	decoded.reserve(patterns.size());
+	BOOST_FOREACH (HitMissPattern const& pat, patterns) {
+		HitMissDecoded dec;
+		if (decodeHitMissPattern(pat.pattern, pat.patternWidth, pat.patternHeight, dec)) {
+			decoded.push_back(dec);
+		}
+	}
+	if (decoded.empty()) {
+		return;
+	}
+
+	// Match every pattern against the original image concurrently,
+	// then composite the replacements.
+	std::vector<BinaryImage> matches(decoded.size());
+	parallelForRanges(
+		0, (int)decoded.size(),
+		MatchHitMissPatterns(img, src_surroundings, decoded, matches)
+	);
+
+	for (size_t i = 0; i < decoded.size(); ++i) {
+		applyHitMissReplacements(img, matches[i], decoded[i]);
+	}
+}
+
 } // namespace imageproc
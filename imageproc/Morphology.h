@@ -378,6 +378,35 @@ void hitMissReplaceInPlace(
 	BinaryImage& img, BWColor src_surroundings,
 	char const* pattern, int pattern_width, int pattern_height);
 
+/**
+ * \brief A pattern reference for the batch version of hitMissReplaceInPlace().
+ *
+ * The pattern string uses the same characters as hitMissReplace()
+ * and must outlive this object.
+ */
+struct HitMissPattern
+{
+	char const* pattern;
+	int patternWidth;
+	int patternHeight;
+
+	HitMissPattern(char const* pattern, int pattern_width, int pattern_height)
+	:	pattern(pattern), patternWidth(pattern_width), patternHeight(pattern_height) {}
+};
+
+/**
+ * \brief Does hit-miss match-and-replace for a batch of patterns.
+ *
+ * Unlike a sequence of hitMissReplaceInPlace() calls, all patterns are
+ * matched against the original image, so no pattern sees the replacements
+ * made by another one and the result doesn't depend on the order of
+ * patterns.  Matching is done concurrently, with each pattern evaluated
+ * in a single pass over the image rather than one pass per pattern cell.
+ */
+void hitMissReplaceInPlace(
+	BinaryImage& img, BWColor src_surroundings,
+	std::vector<HitMissPattern> const& patterns);
+
 } // namespace imageproc
 
 #endif
@@ -33,6 +33,50 @@ static inline uint32_t mask(int x)
 	return (uint32_t(1) << 31) >> (x % 32);
 }
 
+/**
+ * Returns the 32 bits of a line starting at bit position \p bit_pos,
+ * with the bit at \p bit_pos ending up the most significant one.
+ * The caller must make sure the word containing the last requested
+ * bit exists within the line.
+ */
+static inline uint32_t window32(uint32_t const* line, int bit_pos)
+{
+	int const word_idx = bit_pos >> 5;
+	int const shift = bit_pos & 31;
+	uint32_t word = line[word_idx] << shift;
+	if (shift) {
+		word |= line[word_idx + 1] >> (32 - shift);
+	}
+	return word;
+}
+
+static inline uint32_t reverseBits(uint32_t v)
+{
+	v = ((v >> 1) & 0x55555555) | ((v & 0x55555555) << 1);
+	v = ((v >> 2) & 0x33333333) | ((v & 0x33333333) << 2);
+	v = ((v >> 4) & 0x0f0f0f0f) | ((v & 0x0f0f0f0f) << 4);
+	v = ((v >> 8) & 0x00ff00ff) | ((v & 0x00ff00ff) << 8);
+	return (v >> 16) | (v << 16);
+}
+
+/**
+ * Transposes a 32x32 bit matrix in place.  The textbook scheme:
+ * swap the two off-diagonal 16x16 blocks, then the 8x8 blocks
+ * within each 16x16 one, and so on down to single bits.  Bits
+ * are numbered from the most significant one, matching mask().
+ */
+static void transpose32(uint32_t w[32])
+{
+	uint32_t m = 0x0000ffff;
+	for (int j = 16; j != 0; j >>= 1, m ^= m << j) {
+		for (int k = 0; k < 32; k = (k + j + 1) & ~j) {
+			uint32_t const t = (w[k] ^ (w[k + j] >> j)) & m;
+			w[k] ^= t;
+			w[k + j] ^= t << j;
+		}
+	}
+}
+
 static BinaryImage rotate0(BinaryImage const& src, QRect const& src_rect)
 {
 	if (src_rect == src.rect()) {
@@ -54,8 +98,8 @@ static BinaryImage rotate90(BinaryImage const& src, QRect const& src_rect)
 	int const src_wpl = src.wordsPerLine();
 	int const dst_wpl = dst.wordsPerLine();
 	uint32_t const* const src_data = src.data() + src_rect.bottom() * src_wpl;
-	uint32_t* dst_line = dst.data();
-	
+	uint32_t* const dst_data = dst.data();
+
 	/*
 	 *   dst
 	 *  ----->
@@ -63,22 +107,47 @@ static BinaryImage rotate90(BinaryImage const& src, QRect const& src_rect)
 	 * | src
 	 * |
 	 */
-	
+
+	// The bulk of the image is rotated 32x32 pixels at a time:
+	// 32 unaligned words are gathered along a strip of source
+	// rows, transposed as a bit matrix and stored as 32 aligned
+	// destination words.
+	int const full_w = dst_w & ~31;
+	int const full_h = dst_h & ~31;
+	uint32_t t[32];
+
+	for (int dst_y0 = 0; dst_y0 < full_h; dst_y0 += 32) {
+		int const src_x = src_rect.left() + dst_y0;
+		for (int dst_x0 = 0; dst_x0 < full_w; dst_x0 += 32) {
+			uint32_t const* src_line = src_data - dst_x0 * src_wpl;
+			for (int j = 0; j < 32; ++j, src_line -= src_wpl) {
+				t[j] = window32(src_line, src_x);
+			}
+			transpose32(t);
+			uint32_t* dst_pword = dst_data + dst_y0 * dst_wpl + (dst_x0 >> 5);
+			for (int i = 0; i < 32; ++i, dst_pword += dst_wpl) {
+				*dst_pword = t[i];
+			}
+		}
+	}
+
+	// The fringes to the right of and below the full blocks go
+	// bit by bit.
 	for (int dst_y = 0; dst_y < dst_h; ++dst_y) {
+		int const dst_x_start = dst_y < full_h ? full_w : 0;
 		int const src_x = src_rect.left() + dst_y;
-		uint32_t const* src_pword = src_data + src_x / 32;
+		uint32_t const* src_pword = src_data - dst_x_start * src_wpl + src_x / 32;
 		uint32_t const src_mask = mask(src_x);
-		
-		for (int dst_x = 0; dst_x < dst_w; ++dst_x) {
+		uint32_t* const dst_line = dst_data + dst_y * dst_wpl;
+
+		for (int dst_x = dst_x_start; dst_x < dst_w; ++dst_x) {
 			if (*src_pword & src_mask) {
 				dst_line[dst_x / 32] |= mask(dst_x);
 			}
 			src_pword -= src_wpl;
 		}
-		
-		dst_line += dst_wpl;
 	}
-	
+
 	return dst;
 }
 
@@ -92,26 +161,37 @@ static BinaryImage rotate180(BinaryImage const& src, QRect const& src_rect)
 	int const dst_wpl = dst.wordsPerLine();
 	uint32_t const* src_line = src.data() + src_rect.bottom() * src_wpl;
 	uint32_t* dst_line = dst.data();
-	
+
 	/*
 	 *  dst
 	 * ----->
 	 * <-----
 	 *  src
 	 */
-	
+
+	// Full destination words are produced by gathering the matching
+	// 32 bit window of the source line and reversing its bit order;
+	// only the partial word at the end of a line goes bit by bit.
+	int const full_w = dst_w & ~31;
+
 	for (int dst_y = 0; dst_y < dst_h; ++dst_y) {
-		int src_x = src_rect.right();
-		for (int dst_x = 0; dst_x < dst_w; --src_x, ++dst_x) {
+		for (int dst_x = 0; dst_x < full_w; dst_x += 32) {
+			dst_line[dst_x >> 5] = reverseBits(
+				window32(src_line, src_rect.right() - dst_x - 31)
+			);
+		}
+
+		int src_x = src_rect.right() - full_w;
+		for (int dst_x = full_w; dst_x < dst_w; --src_x, ++dst_x) {
 			if (src_line[src_x / 32] & mask(src_x)) {
 				dst_line[dst_x / 32] |= mask(dst_x);
 			}
 		}
-		
+
 		src_line -= src_wpl;
 		dst_line += dst_wpl;
 	}
-	
+
 	return dst;
 }
 
@@ -124,8 +204,8 @@ static BinaryImage rotate270(BinaryImage const& src, QRect const& src_rect)
 	int const src_wpl = src.wordsPerLine();
 	int const dst_wpl = dst.wordsPerLine();
 	uint32_t const* const src_data = src.data() + src_rect.top() * src_wpl;
-	uint32_t* dst_line = dst.data();
-	
+	uint32_t* const dst_data = dst.data();
+
 	/*
 	 *  dst
 	 * ----->
@@ -133,22 +213,45 @@ static BinaryImage rotate270(BinaryImage const& src, QRect const& src_rect)
 	 *   src |
 	 *       v
 	 */
-	
+
+	// Same 32x32 bit matrix transpose as in rotate90(), except the
+	// transposed words come out in bottom-to-top destination order.
+	int const full_w = dst_w & ~31;
+	int const full_h = dst_h & ~31;
+	uint32_t t[32];
+
+	for (int dst_y0 = 0; dst_y0 < full_h; dst_y0 += 32) {
+		int const src_x = src_rect.right() - dst_y0 - 31;
+		for (int dst_x0 = 0; dst_x0 < full_w; dst_x0 += 32) {
+			uint32_t const* src_line = src_data + dst_x0 * src_wpl;
+			for (int j = 0; j < 32; ++j, src_line += src_wpl) {
+				t[j] = window32(src_line, src_x);
+			}
+			transpose32(t);
+			uint32_t* dst_pword = dst_data + (dst_y0 + 31) * dst_wpl + (dst_x0 >> 5);
+			for (int i = 0; i < 32; ++i, dst_pword -= dst_wpl) {
+				*dst_pword = t[i];
+			}
+		}
+	}
+
+	// The fringes to the right of and below the full blocks go
+	// bit by bit.
 	for (int dst_y = 0; dst_y < dst_h; ++dst_y) {
+		int const dst_x_start = dst_y < full_h ? full_w : 0;
 		int const src_x = src_rect.right() - dst_y;
-		uint32_t const* src_pword = src_data + src_x / 32;
+		uint32_t const* src_pword = src_data + dst_x_start * src_wpl + src_x / 32;
 		uint32_t const src_mask = mask(src_x);
-		
-		for (int dst_x = 0; dst_x < dst_w; ++dst_x) {
+		uint32_t* const dst_line = dst_data + dst_y * dst_wpl;
+
+		for (int dst_x = dst_x_start; dst_x < dst_w; ++dst_x) {
 			if (*src_pword & src_mask) {
 				dst_line[dst_x / 32] |= mask(dst_x);
 			}
 			src_pword += src_wpl;
 		}
-		
-		dst_line += dst_wpl;
 	}
-	
+
 	return dst;
 }
 
@@ -0,0 +1,44 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ParallelFor.h"
+
+namespace imageproc
+{
+
+// Zero means "one thread per CPU core".
+static int s_maxParallelWorkers = 0;
+
+int
+maxParallelWorkers()
+{
+	if (s_maxParallelWorkers > 0) {
+		return s_maxParallelWorkers;
+	}
+
+	int const num_cores = QThread::idealThreadCount();
+	return (num_cores < 1) ? 1 : num_cores;
+}
+
+void
+setMaxParallelWorkers(int const num_workers)
+{
+	s_maxParallelWorkers = (num_workers < 0) ? 0 : num_workers;
+}
+
+} // namespace imageproc
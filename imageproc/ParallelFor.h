@@ -0,0 +1,126 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IMAGEPROC_PARALLELFOR_H_
+#define IMAGEPROC_PARALLELFOR_H_
+
+#include <QThread>
+#include <vector>
+
+namespace imageproc
+{
+
+/**
+ * \brief The number of threads parallelForRanges() will use at most.
+ *
+ * Defaults to one thread per CPU core.
+ */
+int maxParallelWorkers();
+
+/**
+ * \brief Override the number of threads used by parallelForRanges().
+ *
+ * Pass zero to restore the default of one thread per CPU core.
+ * Setting it to one makes all parallel loops run on the calling
+ * thread, which is useful for debugging and deterministic runs.
+ */
+void setMaxParallelWorkers(int num_workers);
+
+namespace detail
+{
+
+template<typename F>
+class RangeWorker : public QThread
+{
+public:
+	RangeWorker(F const& func, int begin, int end)
+	:	m_rFunc(func), m_begin(begin), m_end(end) {}
+protected:
+	virtual void run() { m_rFunc(m_begin, m_end); }
+private:
+	F const& m_rFunc;
+	int m_begin;
+	int m_end;
+};
+
+} // namespace detail
+
+/**
+ * \brief Invoke \p func on consecutive sub-ranges of [begin, end)
+ *        from multiple threads.
+ *
+ * The functor is called as func(range_begin, range_end) and must be
+ * safe to invoke concurrently.  Sub-ranges are contiguous and cover
+ * [begin, end) exactly once, which suits row or tile loops over
+ * independent image regions.  The calling thread processes the last
+ * sub-range itself, so for short ranges or a single-core machine no
+ * threads are spawned at all.
+ *
+ * Determinism contract: results must not depend on the number of
+ * workers or on which worker ran which sub-range.  In practice the
+ * functor must only write outputs addressed by loop index (rows,
+ * columns, per-index slots), with any cross-range reduction either
+ * done serially by the caller over those slots or commutative over
+ * integers.  In particular, never merge floating point partial sums
+ * across ranges in completion order - summation order changes the
+ * bits.  Every current caller follows this, which is what makes
+ * parallel runs produce outputs bit-identical to serial ones (see
+ * --deterministic in the command line help).
+ */
+template<typename F>
+void parallelForRanges(int const begin, int const end, F const& func)
+{
+	int const length = end - begin;
+	if (length <= 0) {
+		return;
+	}
+
+	int num_workers = maxParallelWorkers();
+	if (num_workers > length) {
+		num_workers = length;
+	}
+	if (num_workers <= 1) {
+		func(begin, end);
+		return;
+	}
+
+	int const chunk = length / num_workers;
+	int const remainder = length % num_workers;
+
+	std::vector<detail::RangeWorker<F>*> threads;
+	threads.reserve(num_workers - 1);
+
+	int pos = begin;
+	for (int i = 0; i < num_workers - 1; ++i) {
+		int const next = pos + chunk + (i < remainder ? 1 : 0);
+		threads.push_back(new detail::RangeWorker<F>(func, pos, next));
+		threads.back()->start();
+		pos = next;
+	}
+
+	func(pos, end);
+
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i]->wait();
+		delete threads[i];
+	}
+}
+
+} // namespace imageproc
+
+#endif
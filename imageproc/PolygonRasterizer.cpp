@@ -30,9 +30,9 @@
 #include <boost/foreach.hpp>
 #endif
 #include <vector>
-#include <iterator>
 #include <algorithm>
 #include <stdexcept>
+#include <stddef.h>
 #include <math.h>
 #include <string.h>
 #include <stdint.h>
@@ -48,19 +48,21 @@ class PolygonRasterizer::Edge
 {
 public:
 	Edge(QPointF const& top, QPointF const& bottom, int vert_direction);
-	
+
 	Edge(QPointF const& from, QPointF const& to);
-	
+
 	QPointF const& top() const { return m_top; }
-	
+
 	QPointF const& bottom() const { return m_bottom; }
-	
+
 	double topY() const { return m_top.y(); }
-	
+
 	double bottomY() const { return m_bottom.y(); }
-	
+
 	double xForY(double y) const;
-	
+
+	double dxdy() const { return m_deltaX * m_reDeltaY; }
+
 	int vertDirection() const { return m_vertDirection; }
 private:
 	QPointF m_top;
@@ -72,27 +74,31 @@ private:
 
 
 /**
- * \brief A non-overlaping edge component.
+ * \brief An edge as seen by the sweep: its y extents plus the current
+ *        intersection with the sweep line, updated incrementally.
  */
 class PolygonRasterizer::EdgeComponent
 {
 public:
 	EdgeComponent(Edge const* edge, double top, double bottom)
-	: m_top(top), m_bottom(bottom), m_x(), m_pEdge(edge) {}
-	
+	: m_top(top), m_bottom(bottom), m_x(), m_dxdy(edge->dxdy()), m_pEdge(edge) {}
+
 	double top() const { return m_top; }
-	
+
 	double bottom() const { return m_bottom; }
-	
+
 	Edge const& edge() const { return *m_pEdge; }
-	
+
 	double x() const { return m_x; }
-	
+
 	void setX(double x) { m_x = x; }
+
+	void advanceX() { m_x += m_dxdy; }
 private:
 	double m_top;
 	double m_bottom;
 	double m_x;
+	double m_dxdy;
 	Edge const* m_pEdge;
 };
 
@@ -103,14 +109,6 @@ public:
 	bool operator()(EdgeComponent const& lhs, EdgeComponent const& rhs) const {
 		return lhs.top() < rhs.top();
 	}
-	
-	bool operator()(EdgeComponent const& lhs, double rhs) const {
-		return lhs.bottom() <= rhs; // bottom is not a part of the interval.
-	}
-	
-	bool operator()(double lhs, EdgeComponent const& rhs) const {
-		return lhs < rhs.top();
-	}
 };
 
 
@@ -128,36 +126,45 @@ class PolygonRasterizer::Rasterizer
 public:
 	Rasterizer(QRect const& image_rect, QPolygonF const& poly,
 		Qt::FillRule const fill_rule, bool invert);
-	
+
+	Rasterizer(QRect const& image_rect, std::vector<QPolygonF> const& polys,
+		Qt::FillRule const fill_rule);
+
 	void fillBinary(BinaryImage& image, BWColor color) const;
-	
+
 	void fillGrayscale(QImage& image, uint8_t color) const;
 private:
+	void clipAndAddPolygon(QPolygonF const& poly);
+
 	void prepareEdges();
-	
+
+	void advanceToLine(
+		double y, std::vector<EdgeComponent>& active,
+		size_t& next_edge) const;
+
 	static void oddEvenLineBinary(
 		EdgeComponent const* edges, int num_edges,
 		uint32_t* line, uint32_t pattern);
-	
+
 	static void oddEvenLineGrayscale(
 		EdgeComponent const* edges, int num_edges,
 		uint8_t* line, uint8_t color);
-	
+
 	static void windingLineBinary(
 		EdgeComponent const* edges, int num_edges,
 		uint32_t* line, uint32_t pattern, bool invert);
-	
+
 	static void windingLineGrayscale(
 		EdgeComponent const* edges, int num_edges,
 		uint8_t* line, uint8_t pattern, bool invert);
-	
+
 	static void fillBinarySegment(
 		int x_from, int x_to, uint32_t* line, uint32_t pattern);
-	
+
 	std::vector<Edge> m_edges; // m_edgeComponents references m_edges.
 	std::vector<EdgeComponent> m_edgeComponents;
 	QRect m_imageRect;
-	QPolygonF m_fillPoly;
+	std::vector<QPolygonF> m_fillPolys;
 	QRectF m_boundingBox;
 	Qt::FillRule m_fillRule;
 	bool m_invert;
@@ -174,11 +181,24 @@ PolygonRasterizer::fill(
 	if (image.isNull()) {
 		throw std::invalid_argument("PolygonRasterizer: target image is null");
 	}
-	
+
 	Rasterizer rasterizer(image.rect(), poly, fill_rule, false);
 	rasterizer.fillBinary(image, color);
 }
 
+void
+PolygonRasterizer::fill(
+	BinaryImage& image, BWColor const color,
+	std::vector<QPolygonF> const& polys, Qt::FillRule const fill_rule)
+{
+	if (image.isNull()) {
+		throw std::invalid_argument("PolygonRasterizer: target image is null");
+	}
+
+	Rasterizer rasterizer(image.rect(), polys, fill_rule);
+	rasterizer.fillBinary(image, color);
+}
+
 void
 PolygonRasterizer::fillExcept(
 	BinaryImage& image, BWColor const color,
@@ -187,7 +207,7 @@ PolygonRasterizer::fillExcept(
 	if (image.isNull()) {
 		throw std::invalid_argument("PolygonRasterizer: target image is null");
 	}
-	
+
 	Rasterizer rasterizer(image.rect(), poly, fill_rule, true);
 	rasterizer.fillBinary(image, color);
 }
@@ -203,11 +223,27 @@ PolygonRasterizer::grayFill(
 	if (image.format() != QImage::Format_Indexed8 || !image.isGrayscale()) {
 		throw std::invalid_argument("PolygonRasterizer: target image is not grayscale");
 	}
-	
+
 	Rasterizer rasterizer(image.rect(), poly, fill_rule, false);
 	rasterizer.fillGrayscale(image, color);
 }
 
+void
+PolygonRasterizer::grayFill(
+	QImage& image, unsigned char const color,
+	std::vector<QPolygonF> const& polys, Qt::FillRule const fill_rule)
+{
+	if (image.isNull()) {
+		throw std::invalid_argument("PolygonRasterizer: target image is null");
+	}
+	if (image.format() != QImage::Format_Indexed8 || !image.isGrayscale()) {
+		throw std::invalid_argument("PolygonRasterizer: target image is not grayscale");
+	}
+
+	Rasterizer rasterizer(image.rect(), polys, fill_rule);
+	rasterizer.fillGrayscale(image, color);
+}
+
 void
 PolygonRasterizer::grayFillExcept(
 	QImage& image, unsigned char const color,
@@ -219,7 +255,7 @@ PolygonRasterizer::grayFillExcept(
 	if (image.format() != QImage::Format_Indexed8 || !image.isGrayscale()) {
 		throw std::invalid_argument("PolygonRasterizer: target image is not grayscale");
 	}
-	
+
 	Rasterizer rasterizer(image.rect(), poly, fill_rule, true);
 	rasterizer.fillGrayscale(image, color);
 }
@@ -269,46 +305,110 @@ PolygonRasterizer::Rasterizer::Rasterizer(
 	m_fillRule(fill_rule),
 	m_invert(invert)
 {
-	QPainterPath path1;
-	path1.setFillRule(fill_rule);
-	path1.addRect(image_rect);
-	
-	QPainterPath path2;
-	path2.setFillRule(fill_rule);
-	path2.addPolygon(PolygonUtils::round(poly));
-	path2.closeSubpath();
-	
-	m_fillPoly = path1.intersected(path2).toFillPolygon();
-	
 	if (invert) {
+		QPolygonF rounded_poly(PolygonUtils::round(poly));
+		if (!rounded_poly.isEmpty() && !rounded_poly.isClosed()) {
+			rounded_poly.push_back(rounded_poly.front());
+		}
+
+		QPainterPath path1;
+		path1.setFillRule(fill_rule);
+		path1.addRect(image_rect);
+
+		QPainterPath path2;
+		path2.setFillRule(fill_rule);
+		path2.addPolygon(rounded_poly);
+		path2.closeSubpath();
+
+		m_fillPolys.push_back(path1.intersected(path2).toFillPolygon());
 		m_boundingBox = path1.subtracted(path2).boundingRect();
 	} else {
-		m_boundingBox = m_fillPoly.boundingRect();
+		clipAndAddPolygon(poly);
+	}
+
+	prepareEdges();
+}
+
+PolygonRasterizer::Rasterizer::Rasterizer(
+	QRect const& image_rect, std::vector<QPolygonF> const& polys,
+	Qt::FillRule const fill_rule)
+:	m_imageRect(image_rect),
+	m_fillRule(fill_rule),
+	m_invert(false)
+{
+	BOOST_FOREACH(QPolygonF const& poly, polys) {
+		clipAndAddPolygon(poly);
 	}
-	
+
 	prepareEdges();
 }
 
+void
+PolygonRasterizer::Rasterizer::clipAndAddPolygon(QPolygonF const& poly)
+{
+	QPolygonF rounded_poly(PolygonUtils::round(poly));
+	if (!rounded_poly.isEmpty() && !rounded_poly.isClosed()) {
+		rounded_poly.push_back(rounded_poly.front());
+	}
+
+	// QPainterPath boolean operations below are expensive
+	// regardless of the polygon size, so avoid them when
+	// clipping to the image area wouldn't change anything.
+	QRectF const poly_bbox(rounded_poly.boundingRect());
+	if (!poly_bbox.intersects(QRectF(m_imageRect))) {
+		// Completely off the image - nothing to fill.
+		return;
+	}
+	if (QRectF(m_imageRect).contains(poly_bbox)) {
+		m_fillPolys.push_back(rounded_poly);
+		m_boundingBox |= poly_bbox;
+		return;
+	}
+
+	QPainterPath path1;
+	path1.setFillRule(m_fillRule);
+	path1.addRect(m_imageRect);
+
+	QPainterPath path2;
+	path2.setFillRule(m_fillRule);
+	path2.addPolygon(rounded_poly);
+	path2.closeSubpath();
+
+	QPolygonF const clipped_poly(path1.intersected(path2).toFillPolygon());
+	if (clipped_poly.isEmpty()) {
+		// Overlapping bounding boxes don't guarantee overlapping
+		// areas.  Also, an empty polygon isn't closed, which
+		// prepareEdges() asserts.
+		return;
+	}
+	m_boundingBox |= clipped_poly.boundingRect();
+	m_fillPolys.push_back(clipped_poly);
+}
+
 void
 PolygonRasterizer::Rasterizer::prepareEdges()
 {
-	int const num_verts = m_fillPoly.size();
+	int num_verts = 0;
+	BOOST_FOREACH(QPolygonF const& fill_poly, m_fillPolys) {
+		num_verts += fill_poly.size();
+	}
 	if (num_verts == 0) {
 		return;
 	}
-	
+
 	// Collect the edges, excluding horizontal and null ones.
 	m_edges.reserve(num_verts + 2);
-	for (int i = 0; i < num_verts - 1; ++i) {
-		QPointF const from(m_fillPoly[i]);
-		QPointF const to(m_fillPoly[i + 1]);
-		if (from.y() != to.y()) {
-			m_edges.push_back(Edge(from, to));
+	BOOST_FOREACH(QPolygonF const& fill_poly, m_fillPolys) {
+		assert(fill_poly.isClosed());
+		for (int i = 0; i < fill_poly.size() - 1; ++i) {
+			QPointF const from(fill_poly[i]);
+			QPointF const to(fill_poly[i + 1]);
+			if (from.y() != to.y()) {
+				m_edges.push_back(Edge(from, to));
+			}
 		}
 	}
-	
-	assert(m_fillPoly.isClosed());
-	
+
 	if (m_invert) {
 		// Add left and right edges with neutral direction (0),
 		// to avoid confusing a winding fill.
@@ -316,103 +416,98 @@ PolygonRasterizer::Rasterizer::prepareEdges()
 		m_edges.push_back(Edge(rect.topLeft(), rect.bottomLeft(), 0));
 		m_edges.push_back(Edge(rect.topRight(), rect.bottomRight(), 0));
 	}
-	
-	// Create an ordered list of y coordinates of polygon vertexes.
-	std::vector<double> y_values;
-	y_values.reserve(num_verts + 2);
-	BOOST_FOREACH(QPointF const& pt, m_fillPoly) {
-		y_values.push_back(pt.y());
-	}
-	
-	if (m_invert) {
-		y_values.push_back(0.0);
-		y_values.push_back(m_imageRect.height());
-	}
-	
-	// Sort and remove duplicates.
-	std::sort(y_values.begin(), y_values.end());
-	y_values.erase(std::unique(y_values.begin(), y_values.end()), y_values.end());
-	
-	// Break edges into non-overlaping components, then sort them.
+
+	// Each edge becomes a single component, entering the active set
+	// when the sweep line reaches its top and leaving it once the
+	// sweep line passes its bottom.  Sorting by top makes admissions
+	// a matter of advancing a cursor over this vector.
 	m_edgeComponents.reserve(m_edges.size());
 	BOOST_FOREACH(Edge const& edge, m_edges) {
-		std::vector<double>::iterator it(
-			std::lower_bound(y_values.begin(), y_values.end(), edge.topY())
+		m_edgeComponents.push_back(
+			EdgeComponent(&edge, edge.topY(), edge.bottomY())
 		);
-		
-		assert(*it == edge.topY());
-		
-		do {
-			std::vector<double>::iterator next(it);
-			++next;
-			assert(next != y_values.end());
-			m_edgeComponents.push_back(
-				EdgeComponent(&edge, *it, *next)
-			);
-			it = next;
-		} while (*it != edge.bottomY());
 	}
-	
+
 	std::sort(m_edgeComponents.begin(), m_edgeComponents.end(), EdgeOrderY());
 }
 
+void
+PolygonRasterizer::Rasterizer::advanceToLine(
+	double const y, std::vector<EdgeComponent>& active,
+	size_t& next_edge) const
+{
+	// Retire the edges the sweep line has passed.
+	size_t kept = 0;
+	for (size_t i = 0; i < active.size(); ++i) {
+		if (active[i].bottom() > y) { // bottom is not a part of the interval.
+			active[kept++] = active[i];
+		}
+	}
+	active.erase(active.begin() + kept, active.end());
+
+	// Admit the edges the sweep line has reached, anchoring the
+	// incremental x updates with an exact intersection point.
+	size_t const num_edges = m_edgeComponents.size();
+	for (; next_edge < num_edges && m_edgeComponents[next_edge].top() <= y; ++next_edge) {
+		EdgeComponent ecomp(m_edgeComponents[next_edge]);
+		if (ecomp.bottom() <= y) {
+			// Shorter than a scanline step - stepped over entirely.
+			continue;
+		}
+		ecomp.setX(ecomp.edge().xForY(y));
+		active.push_back(ecomp);
+	}
+
+	// Keep the active edges ordered by x.  Scanline coherence means
+	// they are already sorted or nearly so, which makes insertion
+	// sort effectively linear here, unlike a from-scratch sort.
+	for (size_t i = 1; i < active.size(); ++i) {
+		EdgeComponent const ecomp(active[i]);
+		size_t j = i;
+		for (; j > 0 && ecomp.x() < active[j - 1].x(); --j) {
+			active[j] = active[j - 1];
+		}
+		active[j] = ecomp;
+	}
+}
+
 void
 PolygonRasterizer::Rasterizer::fillBinary(
 	BinaryImage& image, BWColor const color) const
 {
-	std::vector<EdgeComponent> edges_for_line;
-	typedef std::vector<EdgeComponent>::const_iterator EdgeIter;
-	
+	std::vector<EdgeComponent> active;
+	active.reserve(m_edgeComponents.size());
+	size_t next_edge = 0;
+
 	uint32_t* line = image.data();
 	int const wpl = image.wordsPerLine();
 	uint32_t const pattern = (color == WHITE) ? 0 : ~uint32_t(0);
-	
+
 	int i = qRound(m_boundingBox.top());
 	line += i * wpl;
 	int const limit = qRound(m_boundingBox.bottom());
-	for (; i < limit; ++i, line += wpl, edges_for_line.clear()) {
+	for (; i < limit; ++i, line += wpl) {
 		double const y = i + 0.5;
-		
-		// Get edges intersecting this horizontal line.
-		std::pair<EdgeIter, EdgeIter> const range(
-			std::equal_range(
-				m_edgeComponents.begin(), m_edgeComponents.end(),
-				y, EdgeOrderY()
-			)
-		);
-		
-		if (range.first == range.second) {
+
+		advanceToLine(y, active, next_edge);
+		if (active.empty()) {
 			continue;
 		}
-		
-		std::copy(
-			range.first, range.second,
-			std::back_inserter(edges_for_line)
-		);
-		
-		// Calculate the intersection point of each edge with
-		// the current horizontal line.
-		BOOST_FOREACH(EdgeComponent& ecomp, edges_for_line) {
-			ecomp.setX(ecomp.edge().xForY(y));
-		}
-		
-		// Sort edge components by the x value of the intersection point.
-		std::sort(
-			edges_for_line.begin(), edges_for_line.end(),
-			EdgeOrderX()
-		);
-		
+
 		if (m_fillRule == Qt::OddEvenFill) {
 			oddEvenLineBinary(
-				&edges_for_line.front(), edges_for_line.size(),
-				line, pattern
+				&active.front(), active.size(), line, pattern
 			);
 		} else {
 			windingLineBinary(
-				&edges_for_line.front(), edges_for_line.size(),
-				line, pattern, m_invert
+				&active.front(), active.size(), line, pattern, m_invert
 			);
 		}
+
+		// Step each intersection point to the next scanline.
+		BOOST_FOREACH(EdgeComponent& ecomp, active) {
+			ecomp.advanceX();
+		}
 	}
 }
 
@@ -420,58 +515,38 @@ void
 PolygonRasterizer::Rasterizer::fillGrayscale(
 	QImage& image, uint8_t const color) const
 {
-	std::vector<EdgeComponent> edges_for_line;
-	typedef std::vector<EdgeComponent>::const_iterator EdgeIter;
-	
+	std::vector<EdgeComponent> active;
+	active.reserve(m_edgeComponents.size());
+	size_t next_edge = 0;
+
 	uint8_t* line = image.bits();
 	int const bpl = image.bytesPerLine();
-	
+
 	int i = qRound(m_boundingBox.top());
 	line += i * bpl;
 	int const limit = qRound(m_boundingBox.bottom());
-	for (; i < limit; ++i, line += bpl, edges_for_line.clear()) {
+	for (; i < limit; ++i, line += bpl) {
 		double const y = i + 0.5;
-		
-		// Get edges intersecting this horizontal line.
-		std::pair<EdgeIter, EdgeIter> const range(
-			std::equal_range(
-				m_edgeComponents.begin(), m_edgeComponents.end(),
-				y, EdgeOrderY()
-			)
-		);
-		
-		if (range.first == range.second) {
+
+		advanceToLine(y, active, next_edge);
+		if (active.empty()) {
 			continue;
 		}
-		
-		std::copy(
-			range.first, range.second,
-			std::back_inserter(edges_for_line)
-		);
-		
-		// Calculate the intersection point of each edge with
-		// the current horizontal line.
-		BOOST_FOREACH(EdgeComponent& ecomp, edges_for_line) {
-			ecomp.setX(ecomp.edge().xForY(y));
-		}
-		
-		// Sort edge components by the x value of the intersection point.
-		std::sort(
-			edges_for_line.begin(), edges_for_line.end(),
-			EdgeOrderX()
-		);
-		
+
 		if (m_fillRule == Qt::OddEvenFill) {
 			oddEvenLineGrayscale(
-				&edges_for_line.front(), edges_for_line.size(),
-				line, color
+				&active.front(), active.size(), line, color
 			);
 		} else {
 			windingLineGrayscale(
-				&edges_for_line.front(), edges_for_line.size(),
-				line, color, m_invert
+				&active.front(), active.size(), line, color, m_invert
 			);
 		}
+
+		// Step each intersection point to the next scanline.
+		BOOST_FOREACH(EdgeComponent& ecomp, active) {
+			ecomp.advanceX();
+		}
 	}
 }
 
@@ -543,35 +618,34 @@ PolygonRasterizer::Rasterizer::fillBinarySegment(
 	if (x_from == x_to) {
 		return;
 	}
-	
+
 	uint32_t const full_mask = ~uint32_t(0);
 	uint32_t const first_word_mask = full_mask >> (x_from & 31);
 	uint32_t const last_word_mask = full_mask << (31 - ((x_to - 1) & 31));
 	int const first_word_idx = x_from >> 5;
 	int const last_word_idx = (x_to - 1) >> 5; // x_to is exclusive
-	
+
 	if (first_word_idx == last_word_idx) {
 		uint32_t const mask = first_word_mask & last_word_mask;
 		uint32_t& word = line[first_word_idx];
 		word = (word & ~mask) | (pattern & mask);
 		return;
 	}
-	
+
 	int i = first_word_idx;
-	
+
 	// First word.
 	uint32_t& first_word = line[i];
 	first_word = (first_word & ~first_word_mask) | (pattern & first_word_mask);
-	
+
 	// Middle words.
 	for (++i; i < last_word_idx; ++i) {
 		line[i] = pattern;
 	}
-	
+
 	// Last word.
 	uint32_t& last_word = line[i];
 	last_word = (last_word & ~last_word_mask) | (pattern & last_word_mask);
 }
 
 } // namespace imageproc
-
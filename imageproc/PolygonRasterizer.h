@@ -21,6 +21,7 @@
 
 #include "BWColor.h"
 #include <Qt>
+#include <vector>
 
 class QPolygonF;
 class QRectF;
@@ -37,15 +38,36 @@ public:
 	static void fill(
 		BinaryImage& image, BWColor color,
 		QPolygonF const& poly, Qt::FillRule fill_rule);
-	
+
+	/**
+	 * \brief Fills multiple polygons in a single sweep over the image.
+	 *
+	 * Equivalent to calling fill() for each polygon in turn, except
+	 * the image is traversed only once.  Note that with Qt::OddEvenFill,
+	 * areas covered by an even number of polygons end up unfilled,
+	 * so for potentially overlapping polygons use Qt::WindingFill.
+	 */
+	static void fill(
+		BinaryImage& image, BWColor color,
+		std::vector<QPolygonF> const& polys, Qt::FillRule fill_rule);
+
 	static void fillExcept(
 		BinaryImage& image, BWColor color,
 		QPolygonF const& poly, Qt::FillRule fill_rule);
-	
+
 	static void grayFill(
 		QImage& image, unsigned char color,
 		QPolygonF const& poly, Qt::FillRule fill_rule);
-	
+
+	/**
+	 * \brief Fills multiple polygons in a single sweep over the image.
+	 *
+	 * \see fill(BinaryImage&, BWColor, std::vector<QPolygonF> const&, Qt::FillRule)
+	 */
+	static void grayFill(
+		QImage& image, unsigned char color,
+		std::vector<QPolygonF> const& polys, Qt::FillRule fill_rule);
+
 	static void grayFillExcept(
 		QImage& image, unsigned char color,
 		QPolygonF const& poly, Qt::FillRule fill_rule);
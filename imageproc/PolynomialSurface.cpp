@@ -17,13 +17,16 @@
 */
 
 #include "PolynomialSurface.h"
-#include "LeastSquaresFit.h"
+#include "LinearSolver.h"
+#include "ParallelFor.h"
 #include "AlignedArray.h"
 #include "BinaryImage.h"
 #include "GrayImage.h"
 #include "Grayscale.h"
 #include "BitOps.h"
 #include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
 #ifndef Q_MOC_RUN
 #include <boost/foreach.hpp>
 #endif
@@ -57,22 +60,9 @@ PolynomialSurface::PolynomialSurface(
 		m_coeffs.push_back(0.0);
 		return;
 	}
-	
+
 	maybeReduceDegrees(num_data_points);
-	
-	int const num_terms = calcNumTerms();
-	QSize const dimensions(num_terms, num_data_points);
-	std::vector<double> equations;
-	std::vector<double> data_points;
-	equations.reserve(dimensions.width() * dimensions.height());
-	data_points.reserve(dimensions.height());
-	m_coeffs.resize(dimensions.width());
-	
-	prepareEquationsAndDataPoints(src, equations, data_points);
-	assert(int(equations.size()) == dimensions.width() * dimensions.height());
-	assert(int(data_points.size()) == num_data_points);
-	
-	leastSquaresFit(dimensions, &equations[0], &m_coeffs[0], &data_points[0]);
+	fitToData(src, 0);
 }
 
 PolynomialSurface::PolynomialSurface(
@@ -102,23 +92,47 @@ PolynomialSurface::PolynomialSurface(
 	}
 	
 	maybeReduceDegrees(num_data_points);
-	
-	int const num_terms = calcNumTerms();
-	QSize const dimensions(num_terms, num_data_points);
-	
-	std::vector<double> equations;
-	std::vector<double> data_points;
-	equations.reserve(dimensions.width() * dimensions.height());
-	data_points.reserve(dimensions.height());
-	m_coeffs.resize(dimensions.width());
-	
-	prepareEquationsAndDataPoints(src, mask, equations, data_points);
-	assert(int(equations.size()) == dimensions.width() * dimensions.height());
-	assert(int(data_points.size()) == num_data_points);
-	
-	leastSquaresFit(dimensions, &equations[0], &m_coeffs[0], &data_points[0]);
+	fitToData(src, &mask);
 }
 
+namespace
+{
+
+class RenderRows
+{
+public:
+	RenderRows(unsigned char* data, int bpl, int width,
+		float const* vert_matrix, float const* hor_matrix, int num_coeffs)
+	:	m_pData(data), m_bpl(bpl), m_width(width),
+		m_pVertMatrix(vert_matrix), m_pHorMatrix(hor_matrix),
+		m_numCoeffs(num_coeffs) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		unsigned char* line = m_pData + m_bpl * begin_y;
+		float const* vert_line = m_pVertMatrix + m_numCoeffs * begin_y;
+		for (int y = begin_y; y < end_y; ++y, line += m_bpl, vert_line += m_numCoeffs) {
+			float const* hor_line = m_pHorMatrix;
+			for (int x = 0; x < m_width; ++x, hor_line += m_numCoeffs) {
+				float sum = 0.5f / 255.0f; // for rounding purposes.
+				for (int i = 0; i < m_numCoeffs; ++i) {
+					sum += hor_line[i] * vert_line[i];
+				}
+				int const isum = (int)(sum * 255.0);
+				line[x] = static_cast<unsigned char>(qBound(0, isum, 255));
+			}
+		}
+	}
+private:
+	unsigned char* m_pData;
+	int m_bpl;
+	int m_width;
+	float const* m_pVertMatrix;
+	float const* m_pHorMatrix;
+	int m_numCoeffs;
+};
+
+} // anonymous namespace
+
 GrayImage
 PolynomialSurface::render(QSize const& size) const
 {
@@ -165,19 +179,13 @@ PolynomialSurface::render(QSize const& size) const
 		}
 	}
 	
-	float const* vert_line = &vert_matrix[0];
-	for (int y = 0; y < height; ++y, line += bpl, vert_line += num_coeffs) {
-		float const* hor_line = &hor_matrix[0];
-		for (int x = 0; x < width; ++x, hor_line += num_coeffs) {
-			float sum = 0.5f / 255.0f; // for rounding purposes.
-			for (int i = 0; i < num_coeffs; ++i) {
-				sum += hor_line[i] * vert_line[i];
-			}
-			int const isum = (int)(sum * 255.0);
-			line[x] = static_cast<unsigned char>(qBound(0, isum, 255));
-		}
-	}
-	
+	// Rows are independent of each other, so evaluate them in parallel.
+	parallelForRanges(
+		0, height, RenderRows(
+			line, bpl, width, &vert_matrix[0], &hor_matrix[0], num_coeffs
+		)
+	);
+
 	return image;
 }
 
@@ -211,123 +219,289 @@ PolynomialSurface::calcScale(int const dimension)
 	}
 }
 
+namespace
+{
+
+/**
+ * Accumulates the least-squares normal equations over a band of rows.
+ *
+ * Because our basis functions are products of x and y monomials, the
+ * whole A^T*A matrix and A^T*b vector reduce to geometry moments
+ * sum(x^a * y^b) and value moments sum(v * x^j * y^i).  That's what
+ * gets accumulated here: each invocation works on private buffers
+ * and merges them into the shared ones at the end, so bands may be
+ * processed concurrently.
+ */
+class AccumulateMoments
+{
+public:
+	AccumulateMoments(
+		uint8_t const* image_data, int image_bpl,
+		uint32_t const* mask_data, int mask_wpl,
+		int width, double const* xpow_table,
+		double const* full_row_x_moments,
+		int hor_degree, int vert_degree, double yscale,
+		QMutex& mutex, std::vector<double>& xy_moments,
+		std::vector<double>& value_moments)
+	:	m_pImageData(image_data), m_imageBpl(image_bpl),
+		m_pMaskData(mask_data), m_maskWpl(mask_wpl),
+		m_width(width), m_pXpowTable(xpow_table),
+		m_pFullRowXMoments(full_row_x_moments),
+		m_horDegree(hor_degree), m_vertDegree(vert_degree),
+		m_yscale(yscale), m_rMutex(mutex),
+		m_rXyMoments(xy_moments), m_rValueMoments(value_moments) {}
+
+	void operator()(int begin_y, int end_y) const;
+private:
+	void processRowMasked(
+		uint8_t const* image_line, uint32_t const* mask_line,
+		double* x_moments, double* v_moments) const;
+
+	uint8_t const* m_pImageData;
+	int m_imageBpl;
+	uint32_t const* m_pMaskData; /**< Null when every pixel is considered. */
+	int m_maskWpl;
+	int m_width;
+	double const* m_pXpowTable; /**< Per-pixel x powers, 2 * m_horDegree + 1 of them. */
+	double const* m_pFullRowXMoments; /**< Column sums of the above, for the maskless case. */
+	int m_horDegree;
+	int m_vertDegree;
+	double m_yscale;
+	QMutex& m_rMutex;
+	std::vector<double>& m_rXyMoments;
+	std::vector<double>& m_rValueMoments;
+};
+
 void
-PolynomialSurface::prepareEquationsAndDataPoints(
-	GrayImage const& image,
-	std::vector<double>& equations,
-	std::vector<double>& data_points) const
+AccumulateMoments::operator()(int const begin_y, int const end_y) const
 {
-	int const width = image.width();
-	int const height = image.height();
-	
-	uint8_t const* line = image.data();
-	int const bpl = image.stride();
-	
-	// Pretend that both x and y positions of pixels
-	// lie in range of [0, 1].
-	double const xscale = calcScale(width);
-	double const yscale = calcScale(height);
-	
-	for (int y = 0; y < height; ++y, line += bpl) {
-		double const y_adjusted = yscale * y;
-		
-		for (int x = 0; x < width; ++x) {
-			double const x_adjusted = xscale * x;
-			
-			data_points.push_back((1.0 / 255.0) * line[x]);
-			
-			double pow1 = 1.0;
-			for (int i = 0; i <= m_vertDegree; ++i) {
-				double pow2 = pow1;
+	int const nx = 2 * m_horDegree + 1;
+	int const ny = 2 * m_vertDegree + 1;
+
+	std::vector<double> local_xy(ny * nx, 0.0);
+	std::vector<double> local_value(
+		(m_vertDegree + 1) * (m_horDegree + 1), 0.0
+	);
+	std::vector<double> x_moments(nx);
+	std::vector<double> v_moments(m_horDegree + 1);
+	std::vector<double> ypow(ny);
+
+	uint8_t const* image_line = m_pImageData + m_imageBpl * begin_y;
+	uint32_t const* mask_line = m_pMaskData ?
+		m_pMaskData + m_maskWpl * begin_y : 0;
+
+	for (int y = begin_y; y < end_y; ++y, image_line += m_imageBpl) {
+		double const* row_x_moments;
+		if (!mask_line) {
+			// Without a mask the geometry of a row doesn't depend
+			// on the row, so its x moments were computed upfront.
+			std::fill(v_moments.begin(), v_moments.end(), 0.0);
+			for (int x = 0; x < m_width; ++x) {
+				double const* const xp = m_pXpowTable + x * nx;
+				double const v = (1.0 / 255.0) * image_line[x];
+				// The powers for a pixel are contiguous, making this
+				// a straight multiply-accumulate loop that compilers
+				// turn into vector instructions.
 				for (int j = 0; j <= m_horDegree; ++j) {
-					equations.push_back(pow2);
-					pow2 *= x_adjusted;
+					v_moments[j] += v * xp[j];
 				}
-				pow1 *= y_adjusted;
+			}
+			row_x_moments = m_pFullRowXMoments;
+		} else {
+			std::fill(x_moments.begin(), x_moments.end(), 0.0);
+			std::fill(v_moments.begin(), v_moments.end(), 0.0);
+			processRowMasked(image_line, mask_line, &x_moments[0], &v_moments[0]);
+			row_x_moments = &x_moments[0];
+			mask_line += m_maskWpl;
+		}
+
+		double const y_adjusted = y * m_yscale - 1.0;
+		double pow = 1.0;
+		for (int b = 0; b < ny; ++b) {
+			ypow[b] = pow;
+			pow *= y_adjusted;
+		}
+
+		for (int b = 0; b < ny; ++b) {
+			double* const out = &local_xy[b * nx];
+			for (int a = 0; a < nx; ++a) {
+				out[a] += ypow[b] * row_x_moments[a];
+			}
+		}
+		for (int i = 0; i <= m_vertDegree; ++i) {
+			double* const out = &local_value[i * (m_horDegree + 1)];
+			for (int j = 0; j <= m_horDegree; ++j) {
+				out[j] += ypow[i] * v_moments[j];
 			}
 		}
 	}
+
+	QMutexLocker const locker(&m_rMutex);
+	for (size_t i = 0; i < local_xy.size(); ++i) {
+		m_rXyMoments[i] += local_xy[i];
+	}
+	for (size_t i = 0; i < local_value.size(); ++i) {
+		m_rValueMoments[i] += local_value[i];
+	}
 }
 
 void
-PolynomialSurface::prepareEquationsAndDataPoints(
-	GrayImage const& image, BinaryImage const& mask,
-	std::vector<double>& equations,
-	std::vector<double>& data_points) const
+AccumulateMoments::processRowMasked(
+	uint8_t const* const image_line, uint32_t const* const mask_line,
+	double* const x_moments, double* const v_moments) const
 {
-	int const width = image.width();
-	int const height = image.height();
-	
-	double const xscale = calcScale(width);
-	double const yscale = calcScale(height);
-	
-	uint8_t const* image_line = image.data();
-	int const image_bpl = image.stride();
-	
-	uint32_t const* mask_line = mask.data();
-	int const mask_wpl = mask.wordsPerLine();
-	int const last_word_idx = (width - 1) >> 5;
-	int const last_word_mask = ~uint32_t(0) << (31 - ((width - 1) & 31));
-	
-	for (int y = 0; y < height; ++y) {
-		double const y_adjusted = y * yscale;
-		int idx = 0;
-		
-		// Full words.
-		for (; idx < last_word_idx; ++idx) {
-			processMaskWord(
-				image_line, mask_line[idx], idx, y,
-				y_adjusted, xscale, equations, data_points
-			);
+	int const nx = 2 * m_horDegree + 1;
+	int const last_word_idx = (m_width - 1) >> 5;
+	uint32_t const last_word_mask = ~uint32_t(0) << (31 - ((m_width - 1) & 31));
+	uint32_t const msb = uint32_t(1) << 31;
+
+	for (int idx = 0; idx <= last_word_idx; ++idx) {
+		uint32_t word = mask_line[idx];
+		if (idx == last_word_idx) {
+			word &= last_word_mask;
+		}
+
+		int const xbase = idx << 5;
+		int x = xbase;
+		uint32_t mask = msb;
+
+		for (; word; word &= ~mask, mask >>= 1, ++x) {
+			if (!(word & mask)) {
+				// Skip a group of zero bits.
+				int const offset = countMostSignificantZeroes(word);
+				x = xbase + offset;
+				mask = msb >> offset;
+				assert(word & mask);
+			}
+
+			double const* const xp = m_pXpowTable + x * nx;
+			for (int a = 0; a < nx; ++a) {
+				x_moments[a] += xp[a];
+			}
+
+			double const v = (1.0 / 255.0) * image_line[x];
+			for (int j = 0; j <= m_horDegree; ++j) {
+				v_moments[j] += v * xp[j];
+			}
 		}
-		
-		// Last word.
-		processMaskWord(
-			image_line, mask_line[idx] & last_word_mask,
-			idx, y, y_adjusted, xscale, equations, data_points
-		);
-		
-		image_line += image_bpl;
-		mask_line += mask_wpl;
 	}
 }
 
+} // anonymous namespace
+
 void
-PolynomialSurface::processMaskWord(
-	uint8_t const* const image_line,
-	uint32_t word, int const word_idx, int const y,
-	double const y_adjusted, double const xscale,
-	std::vector<double>& equations,
-	std::vector<double>& data_points) const
+PolynomialSurface::fitToData(GrayImage const& image, BinaryImage const* mask)
 {
-	uint32_t const msb = uint32_t(1) << 31;
-	int const xbase = word_idx << 5;
-	
-	int x = xbase;
-	uint32_t mask = msb;
-	
-	for (; word; word &= ~mask, mask >>= 1, ++x) {
-		if (!(word & mask)) {
-			// Skip a group of zero bits.
-			int const offset = countMostSignificantZeroes(word);
-			x = xbase + offset;
-			mask = msb >> offset;
-			assert(word & mask);
+	int const width = image.width();
+	int const height = image.height();
+
+	// A degree the respective dimension can't support would make
+	// the system rank-deficient.
+	m_horDegree = std::min(m_horDegree, width - 1);
+	m_vertDegree = std::min(m_vertDegree, height - 1);
+
+	int const hd = m_horDegree;
+	int const vd = m_vertDegree;
+	int const num_terms = calcNumTerms();
+	int const nx = 2 * hd + 1;
+	int const ny = 2 * vd + 1;
+
+	// The fit is done with x and y mapped to [-1, 1] rather than the
+	// [0, 1] range render() uses.  Monomials on [-1, 1] keep the
+	// normal equations well-conditioned at the degrees we use, while
+	// on [0, 1] they wouldn't be; the coefficients are converted to
+	// the [0, 1] basis afterwards.
+	double const xscale = 2.0 * calcScale(width);
+	double const yscale = 2.0 * calcScale(height);
+
+	// Per-pixel powers of x don't depend on y, so they are computed
+	// exactly once for the whole image.
+	std::vector<double> xpow_table(width * nx);
+	for (int x = 0; x < width; ++x) {
+		double const x_adjusted = x * xscale - 1.0;
+		double pow = 1.0;
+		for (int a = 0; a < nx; ++a) {
+			xpow_table[x * nx + a] = pow;
+			pow *= x_adjusted;
 		}
-		
-		data_points.push_back((1.0 / 255.0) * image_line[x]);
-		
-		double const x_adjusted = xscale * x;
-		double pow1 = 1.0;
-		for (int i = 0; i <= m_vertDegree; ++i) {
-			double pow2 = pow1;
-			
-			for (int j = 0; j <= m_horDegree; ++j) {
-				equations.push_back(pow2);
-				pow2 *= x_adjusted;
+	}
+
+	// Without a mask the x moments of every row are identical.
+	std::vector<double> full_row_x_moments(nx, 0.0);
+	if (!mask) {
+		for (int x = 0; x < width; ++x) {
+			for (int a = 0; a < nx; ++a) {
+				full_row_x_moments[a] += xpow_table[x * nx + a];
+			}
+		}
+	}
+
+	QMutex mutex;
+	std::vector<double> xy_moments(ny * nx, 0.0);
+	std::vector<double> value_moments(num_terms, 0.0);
+
+	// Rows are accumulated into per-thread partial sums that get
+	// merged at the end, so bands of rows can run in parallel.
+	parallelForRanges(
+		0, height, AccumulateMoments(
+			image.data(), image.stride(),
+			mask ? mask->data() : 0, mask ? mask->wordsPerLine() : 0,
+			width, &xpow_table[0], &full_row_x_moments[0],
+			hd, vd, yscale, mutex, xy_moments, value_moments
+		)
+	);
+
+	// Assemble A^T*A from the moments.  Rows and columns follow the
+	// coefficient layout: index i * (hd + 1) + j stands for y^i * x^j.
+	std::vector<double> AtA(num_terms * num_terms);
+	for (int r = 0; r < num_terms; ++r) {
+		int const i1 = r / (hd + 1);
+		int const j1 = r % (hd + 1);
+		for (int c = 0; c < num_terms; ++c) {
+			int const i2 = c / (hd + 1);
+			int const j2 = c % (hd + 1);
+			AtA[c * num_terms + r] = xy_moments[(i1 + i2) * nx + (j1 + j2)];
+		}
+	}
+
+	std::vector<double> coeffs(num_terms, 0.0);
+	try {
+		LinearSolver const solver(num_terms, num_terms, 1);
+		solver.solve(&AtA[0], &coeffs[0], &value_moments[0]);
+	} catch (std::runtime_error const&) {
+		// Degenerate data, such as a mask covering a single column.
+		// Fall back to a flat surface at the mean level.
+		std::fill(coeffs.begin(), coeffs.end(), 0.0);
+		coeffs[0] = value_moments[0] / xy_moments[0];
+	}
+
+	// Convert from the [-1, 1] basis to the [0, 1] basis expected
+	// by render():  t = 2u - 1, so t^j expands over u^0 .. u^j with
+	// binomial coefficients.
+	int const max_degree = std::max(hd, vd);
+	std::vector<double> binomial((max_degree + 1) * (max_degree + 1), 0.0);
+	for (int n = 0; n <= max_degree; ++n) {
+		binomial[n * (max_degree + 1)] = 1.0;
+		for (int k = 1; k <= n; ++k) {
+			binomial[n * (max_degree + 1) + k] =
+				binomial[(n - 1) * (max_degree + 1) + k - 1]
+				+ binomial[(n - 1) * (max_degree + 1) + k];
+		}
+	}
+
+	m_coeffs.assign(num_terms, 0.0);
+	for (int i = 0; i <= vd; ++i) {
+		for (int j = 0; j <= hd; ++j) {
+			double const coeff = coeffs[i * (hd + 1) + j];
+			for (int k2 = 0; k2 <= i; ++k2) {
+				double const vert_factor = binomial[i * (max_degree + 1) + k2]
+					* ldexp((i - k2) & 1 ? -1.0 : 1.0, k2);
+				for (int k1 = 0; k1 <= j; ++k1) {
+					double const hor_factor = binomial[j * (max_degree + 1) + k1]
+						* ldexp((j - k1) & 1 ? -1.0 : 1.0, k1);
+					m_coeffs[k2 * (hd + 1) + k1] += coeff * vert_factor * hor_factor;
+				}
 			}
-			
-			pow1 *= y_adjusted;
 		}
 	}
 }
@@ -86,28 +86,18 @@ public:
 	GrayImage render(QSize const& size) const;
 private:
 	void maybeReduceDegrees(int num_data_points);
-	
+
 	int calcNumTerms() const;
-	
+
 	static double calcScale(int dimension);
-	
-	void prepareEquationsAndDataPoints(
-		GrayImage const& image,
-		std::vector<double>& equations,
-		std::vector<double>& data_points) const;
-	
-	void prepareEquationsAndDataPoints(
-		GrayImage const& image, BinaryImage const& mask,
-		std::vector<double>& equations,
-		std::vector<double>& data_points) const;
-	
-	void processMaskWord(
-		uint8_t const* image_line, uint32_t word,
-		int mask_word_idx, int y,
-		double y_adjusted, double xscale,
-		std::vector<double>& equations,
-		std::vector<double>& data_points) const;
-	
+
+	/**
+	 * Builds the least-squares system over all considered pixels and
+	 * solves it, leaving the result in m_coeffs.  Pass a null \p mask
+	 * to consider every pixel.
+	 */
+	void fitToData(GrayImage const& image, BinaryImage const* mask);
+
 	std::vector<double> m_coeffs;
 	int m_horDegree;
 	int m_vertDegree;
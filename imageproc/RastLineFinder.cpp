@@ -20,6 +20,7 @@
 #include "NumericTraits.h"
 #include "VecNT.h"
 #include "Constants.h"
+#include "ParallelFor.h"
 #include <boost/foreach.hpp>
 #include <limits>
 #include <algorithm>
@@ -132,44 +133,51 @@ RastLineFinder::findNext(std::vector<unsigned>* point_idxs)
 		pruneUnavailablePoints();
 	}
 
-	SearchSpace dist_ssp1, dist_ssp2;
-	SearchSpace angle_ssp1, angle_ssp2;
+	// The best-first search expands the most promising search spaces
+	// in batches.  The expansions within a batch are independent, so
+	// they are done in parallel, and since batch members are committed
+	// in priority order, the branch-and-bound guarantee is unaffected:
+	// a candidate line is only accepted when it's at the front of the
+	// queue, where its point count bounds every remaining search space.
+	int const max_batch = maxParallelWorkers();
+	std::vector<SearchSpace> batch;
+	std::vector<Expansion> expansions;
 
 	while (!m_orderedSearchSpaces.empty()) {
-		SearchSpace ssp;
-		m_orderedSearchSpaces.retrieveFront(ssp);
+		batch.clear();
+		while ((int)batch.size() < max_batch && !m_orderedSearchSpaces.empty()) {
+			batch.push_back(SearchSpace());
+			m_orderedSearchSpaces.retrieveFront(batch.back());
+		}
 
-		if (!ssp.subdivideDist(*this, dist_ssp1, dist_ssp2)) {
-			if (!ssp.subdivideAngle(*this, angle_ssp1, angle_ssp2)) {
-				// Can't subdivide at all - return what we've got then.
-				markPointsUnavailable(ssp.pointIdxs());
-				if (point_idxs) {
-					point_idxs->swap(ssp.pointIdxs());
-				}
-				return ssp.representativeLine(*this);
-			} else {
-				// Can only subdivide by angle.
-				pushIfGoodEnough(angle_ssp1);
-				pushIfGoodEnough(angle_ssp2);
+		expansions.clear();
+		expansions.resize(batch.size());
+		parallelForRanges(
+			0, (int)batch.size(), ExpandBatch(*this, &batch[0], &expansions[0])
+		);
+
+		if (expansions[0].leaf) {
+			// The best candidate can't be subdivided any further -
+			// return what we've got then.  The other batch members
+			// were expanded speculatively - back to the queue they go.
+			for (size_t i = 1; i < batch.size(); ++i) {
+				m_orderedSearchSpaces.pushDestructive(batch[i]);
 			}
-		} else {
-			if (!ssp.subdivideAngle(*this, angle_ssp1, angle_ssp2)) {
-				// Can only subdivide by distance.
-				pushIfGoodEnough(dist_ssp1);
-				pushIfGoodEnough(dist_ssp2);
+			markPointsUnavailable(batch[0].pointIdxs());
+			if (point_idxs) {
+				point_idxs->swap(batch[0].pointIdxs());
+			}
+			return batch[0].representativeLine(*this);
+		}
+
+		for (size_t i = 0; i < batch.size(); ++i) {
+			if (expansions[i].leaf) {
+				// Not at the front of the queue yet, so it keeps
+				// competing with the other candidates.
+				m_orderedSearchSpaces.pushDestructive(batch[i]);
 			} else {
-				// Can subdivide both by angle and distance.
-				// Choose the option that results in less combined
-				// number of points in two resulting sub-spaces.
-				if (dist_ssp1.pointIdxs().size() + dist_ssp2.pointIdxs().size() <
-					angle_ssp1.pointIdxs().size() + angle_ssp2.pointIdxs().size()) {
-					
-					pushIfGoodEnough(dist_ssp1);
-					pushIfGoodEnough(dist_ssp2);
-				} else {
-					pushIfGoodEnough(angle_ssp1);
-					pushIfGoodEnough(angle_ssp2);
-				}
+				pushIfGoodEnough(expansions[i].children[0]);
+				pushIfGoodEnough(expansions[i].children[1]);
 			}
 		}
 	}
@@ -177,6 +185,43 @@ RastLineFinder::findNext(std::vector<unsigned>* point_idxs)
 	return QLineF();
 }
 
+void
+RastLineFinder::ExpandBatch::operator()(int const begin, int const end) const
+{
+	SearchSpace dist_ssp1, dist_ssp2;
+	SearchSpace angle_ssp1, angle_ssp2;
+
+	for (int i = begin; i < end; ++i) {
+		SearchSpace const& ssp = m_pBatch[i];
+		Expansion& expansion = m_pExpansions[i];
+
+		if (!ssp.subdivideDist(m_rOwner, dist_ssp1, dist_ssp2)) {
+			if (!ssp.subdivideAngle(m_rOwner, angle_ssp1, angle_ssp2)) {
+				// Can't subdivide at all.
+				expansion.leaf = true;
+				continue;
+			}
+			// Can only subdivide by angle.
+			angle_ssp1.swap(expansion.children[0]);
+			angle_ssp2.swap(expansion.children[1]);
+		} else if (!ssp.subdivideAngle(m_rOwner, angle_ssp1, angle_ssp2)) {
+			// Can only subdivide by distance.
+			dist_ssp1.swap(expansion.children[0]);
+			dist_ssp2.swap(expansion.children[1]);
+		} else if (dist_ssp1.pointIdxs().size() + dist_ssp2.pointIdxs().size() <
+				angle_ssp1.pointIdxs().size() + angle_ssp2.pointIdxs().size()) {
+			// Can subdivide both by angle and distance.
+			// Choose the option that results in less combined
+			// number of points in two resulting sub-spaces.
+			dist_ssp1.swap(expansion.children[0]);
+			dist_ssp2.swap(expansion.children[1]);
+		} else {
+			angle_ssp1.swap(expansion.children[0]);
+			angle_ssp2.swap(expansion.children[1]);
+		}
+	}
+}
+
 void
 RastLineFinder::pushIfGoodEnough(SearchSpace& ssp)
 {
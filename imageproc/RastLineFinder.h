@@ -223,12 +223,46 @@ private:
 		friend class PriorityQueue<SearchSpace, OrderedSearchSpaces>;
 	private:
 		void setIndex(SearchSpace& obj, size_t heap_idx) {}
-		
+
 		bool higherThan(SearchSpace const& lhs, SearchSpace const& rhs) const {
 			return lhs.pointIdxs().size() > rhs.pointIdxs().size();
 		}
 	};
 
+	/**
+	 * \brief The outcome of subdividing a single search space.
+	 *
+	 * Filled by ExpandBatch when findNext() expands a batch of
+	 * search spaces in parallel.
+	 */
+	struct Expansion
+	{
+		SearchSpace children[2];
+		bool leaf;
+
+		Expansion() : leaf(false) {}
+	};
+
+	/**
+	 * \brief Subdivides a range of batched search spaces.
+	 *
+	 * Expansions are independent of each other, which is what allows
+	 * findNext() to run them through parallelForRanges().
+	 */
+	class ExpandBatch
+	{
+	public:
+		ExpandBatch(RastLineFinder const& owner,
+			SearchSpace* batch, Expansion* expansions)
+		:	m_rOwner(owner), m_pBatch(batch), m_pExpansions(expansions) {}
+
+		void operator()(int begin, int end) const;
+	private:
+		RastLineFinder const& m_rOwner;
+		SearchSpace* m_pBatch;
+		Expansion* m_pExpansions;
+	};
+
 	void pushIfGoodEnough(SearchSpace& ssp);
 
 	void markPointsUnavailable(std::vector<unsigned> const& point_idxs);
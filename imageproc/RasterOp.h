@@ -28,6 +28,9 @@
 #endif
 #include <stdexcept>
 #include <assert.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace imageproc
 {
@@ -210,6 +213,51 @@ public:
 namespace detail
 {
 
+/**
+ * Any Rop is a pure bitwise function, so its action is fully determined
+ * by the four single-bit (src, dst) input combinations.  Evaluating the
+ * functor composition once per combination gives four all-zeros /
+ * all-ones masks, reducing an arbitrary Rop to a fixed mux expression
+ * that processes any word width - including SIMD registers - without
+ * per-functor specializations.
+ */
+template<typename Rop>
+class RopTruthTable
+{
+public:
+	RopTruthTable()
+	:	m_t00(Rop::transform(uint32_t(0), uint32_t(0))),
+		m_t10(Rop::transform(~uint32_t(0), uint32_t(0))),
+		m_t01(Rop::transform(uint32_t(0), ~uint32_t(0))),
+		m_t11(Rop::transform(~uint32_t(0), ~uint32_t(0))) {}
+
+	uint32_t transform(uint32_t const src, uint32_t const dst) const {
+		return (src & dst & m_t11) | (src & ~dst & m_t10)
+			| (~src & dst & m_t01) | (~src & ~dst & m_t00);
+	}
+
+#if defined(__SSE2__)
+	/**
+	 * Process 4 dst words at a time.  The pointers don't have to be
+	 * 16-byte aligned.
+	 */
+	void transformSse2(uint32_t const* src, uint32_t* dst) const {
+		__m128i const s = _mm_loadu_si128((__m128i const*)src);
+		__m128i const d = _mm_loadu_si128((__m128i const*)dst);
+		__m128i res = _mm_and_si128(_mm_and_si128(s, d), _mm_set1_epi32(m_t11));
+		res = _mm_or_si128(res, _mm_and_si128(_mm_andnot_si128(d, s), _mm_set1_epi32(m_t10)));
+		res = _mm_or_si128(res, _mm_and_si128(_mm_andnot_si128(s, d), _mm_set1_epi32(m_t01)));
+		res = _mm_or_si128(res, _mm_andnot_si128(_mm_or_si128(s, d), _mm_set1_epi32(m_t00)));
+		_mm_storeu_si128((__m128i*)dst, res);
+	}
+#endif
+private:
+	uint32_t m_t00;
+	uint32_t m_t10;
+	uint32_t m_t01;
+	uint32_t m_t11;
+};
+
 template<typename Rop>
 void rasterOpInDirection(
 	BinaryImage& dst, QRect const& dr,
@@ -282,24 +330,58 @@ void rasterOpInDirection(
 				uint32_t const new_dst_word = Rop::transform(src_word, dst_word);
 				dst_span[0] = (dst_word & ~mask) | (new_dst_word & mask);
 			}
+		} else if (dx == 1) {
+			// The common forward case: complete words between the
+			// first and the last one form a contiguous run that can
+			// be processed several words at a time.
+#if defined(__SSE2__)
+			RopTruthTable<Rop> const wide_rop;
+#endif
+			for (int i = dr.height(); i > 0; --i,
+			     src_span += src_span_delta, dst_span += dst_span_delta) {
+
+				// Handle the first (possibly incomplete) dst word in the line.
+				uint32_t src_word = src_span[first_dst_word];
+				uint32_t dst_word = dst_span[first_dst_word];
+				uint32_t new_dst_word = Rop::transform(src_word, dst_word);
+				dst_span[first_dst_word] = (dst_word & ~first_dst_mask) | (new_dst_word & first_dst_mask);
+
+				int widx = first_dst_word + 1;
+#if defined(__SSE2__)
+				for (; widx + 4 <= last_dst_word; widx += 4) {
+					wide_rop.transformSse2(src_span + widx, dst_span + widx);
+				}
+#endif
+				for (; widx != last_dst_word; ++widx) {
+					src_word = src_span[widx];
+					dst_word = dst_span[widx];
+					dst_span[widx] = Rop::transform(src_word, dst_word);
+				}
+
+				// Handle the last (possibly incomplete) dst word in the line.
+				src_word = src_span[widx];
+				dst_word = dst_span[widx];
+				new_dst_word = Rop::transform(src_word, dst_word);
+				dst_span[widx] = (dst_word & ~last_dst_mask) | (new_dst_word & last_dst_mask);
+			}
 		} else {
 			for (int i = dr.height(); i > 0; --i,
 			     src_span += src_span_delta, dst_span += dst_span_delta) {
-				
+
 				int widx = first_dst_word;
-				
+
 				// Handle the first (possibly incomplete) dst word in the line.
 				uint32_t src_word = src_span[widx];
 				uint32_t dst_word = dst_span[widx];
 				uint32_t new_dst_word = Rop::transform(src_word, dst_word);
 				dst_span[widx] = (dst_word & ~first_dst_mask) | (new_dst_word & first_dst_mask);
-				
+
 				while ((widx += dx) != last_dst_word) {
 					src_word = src_span[widx];
 					dst_word = dst_span[widx];
 					dst_span[widx] = Rop::transform(src_word, dst_word);
 				}
-				
+
 				// Handle the last (possibly incomplete) dst word in the line.
 				src_word = src_span[widx];
 				dst_word = dst_span[widx];
@@ -120,6 +120,101 @@ inline uint32_t threshold4(uint32_t const top, uint32_t const bottom)
 	return word;
 }
 
+struct Threshold1
+{
+	static uint32_t result(uint32_t top, uint32_t bottom) {
+		return threshold1(top, bottom);
+	}
+};
+
+struct Threshold2
+{
+	static uint32_t result(uint32_t top, uint32_t bottom) {
+		return threshold2(top, bottom);
+	}
+};
+
+struct Threshold3
+{
+	static uint32_t result(uint32_t top, uint32_t bottom) {
+		return threshold3(top, bottom);
+	}
+};
+
+struct Threshold4
+{
+	static uint32_t result(uint32_t top, uint32_t bottom) {
+		return threshold4(top, bottom);
+	}
+};
+
+/**
+ * Produces destination rows [dst_begin_row, dst_end_row) of a 2x
+ * reduction.  The threshold is a template parameter to keep it out
+ * of the inner loops, the same way reduce() keeps it out by cloning
+ * them.
+ */
+template<typename ThresholdOp>
+void reduceBand(
+	uint32_t const* const src_data, int const src_wpl,
+	uint32_t* const dst_data, int const dst_wpl,
+	int const dst_begin_row, int const dst_end_row,
+	int const steps_per_line)
+{
+	uint32_t const* src_line = src_data + src_wpl * dst_begin_row * 2;
+	uint32_t* dst_line = dst_data + dst_wpl * dst_begin_row;
+
+	uint32_t word;
+
+	for (int i = dst_begin_row; i < dst_end_row; ++i) {
+		for (int j = 0; j < steps_per_line; j += 2) {
+			word = ThresholdOp::result(src_line[j], src_line[j + src_wpl]);
+			dst_line[j / 2] = compressBitsUpperHalf(word);
+		}
+		for (int j = 1; j < steps_per_line; j += 2) {
+			word = ThresholdOp::result(src_line[j], src_line[j + src_wpl]);
+			dst_line[j / 2] |= compressBitsLowerHalf(word);
+		}
+		src_line += src_wpl * 2;
+		dst_line += dst_wpl;
+	}
+}
+
+void reduceBand(
+	BinaryImage const& src, BinaryImage& dst,
+	int const dst_begin_row, int const dst_end_row, int const threshold)
+{
+	int const steps_per_line = (dst.width() * 2 + 31) / 32;
+	assert(steps_per_line <= src.wordsPerLine());
+
+	switch (threshold) {
+		case 1:
+			reduceBand<Threshold1>(
+				src.data(), src.wordsPerLine(), dst.data(), dst.wordsPerLine(),
+				dst_begin_row, dst_end_row, steps_per_line
+			);
+			break;
+		case 2:
+			reduceBand<Threshold2>(
+				src.data(), src.wordsPerLine(), dst.data(), dst.wordsPerLine(),
+				dst_begin_row, dst_end_row, steps_per_line
+			);
+			break;
+		case 3:
+			reduceBand<Threshold3>(
+				src.data(), src.wordsPerLine(), dst.data(), dst.wordsPerLine(),
+				dst_begin_row, dst_end_row, steps_per_line
+			);
+			break;
+		case 4:
+			reduceBand<Threshold4>(
+				src.data(), src.wordsPerLine(), dst.data(), dst.wordsPerLine(),
+				dst_begin_row, dst_end_row, steps_per_line
+			);
+			break;
+	}
+}
+
 } // anonymous namespace
 
 
@@ -321,4 +416,73 @@ ReduceThreshold::reduceVertLine(int const threshold)
 	m_image = dst;
 }
 
+
+std::vector<BinaryImage>
+reducePyramid(BinaryImage const& src, std::vector<int> const& thresholds)
+{
+	int const num_levels = thresholds.size();
+	for (int i = 0; i < num_levels; ++i) {
+		if (thresholds[i] < 1 || thresholds[i] > 4) {
+			throw std::invalid_argument("reducePyramid: invalid threshold");
+		}
+	}
+
+	std::vector<BinaryImage> levels(num_levels);
+	if (src.isNull() || num_levels == 0) {
+		return levels;
+	}
+
+	// Levels that degenerate to a single line take special code
+	// paths, so leave pyramids containing them to ReduceThreshold.
+	if ((src.width() >> num_levels) == 0 || (src.height() >> num_levels) == 0) {
+		ReduceThreshold reductor(src);
+		for (int i = 0; i < num_levels; ++i) {
+			reductor.reduce(thresholds[i]);
+			levels[i] = reductor.image();
+		}
+		return levels;
+	}
+
+	int prev_w = src.width();
+	int prev_h = src.height();
+	for (int i = 0; i < num_levels; ++i) {
+		prev_w /= 2;
+		prev_h /= 2;
+		levels[i] = BinaryImage(prev_w, prev_h);
+	}
+
+	// The number of bottom-level rows produced per band.  Sized so
+	// that a band spans a few hundred source rows regardless of the
+	// pyramid depth, to keep each level's input in the cache.
+	int band_rows = 256 >> (num_levels - 1);
+	if (band_rows < 1) {
+		band_rows = 1;
+	}
+
+	int const bottom_h = levels[num_levels - 1].height();
+	for (int band_y = 0; band_y < bottom_h; band_y += band_rows) {
+		bool const last_band = (band_y + band_rows >= bottom_h);
+		int const band_end = last_band ? bottom_h : band_y + band_rows;
+
+		for (int i = 0; i < num_levels; ++i) {
+			BinaryImage const& level_src = (i == 0) ? src : levels[i - 1];
+			BinaryImage& level_dst = levels[i];
+
+			// Rounding makes the deeper levels slightly shorter than
+			// half of the previous one, so the last band additionally
+			// picks up the left-over rows of every level.
+			int const shift = num_levels - 1 - i;
+			int const begin_row = band_y << shift;
+			int const end_row = last_band
+				? level_dst.height() : band_end << shift;
+
+			reduceBand(
+				level_src, level_dst, begin_row, end_row, thresholds[i]
+			);
+		}
+	}
+
+	return levels;
+}
+
 } // namespace imageproc
@@ -20,6 +20,7 @@
 #define IMAGEPROC_REDUCETHRESHOLD_H_
 
 #include "BinaryImage.h"
+#include <vector>
 
 namespace imageproc
 {
@@ -90,6 +91,22 @@ private:
 };
 
 
+/**
+ * \brief Builds a cascade of 2x reductions in a single banded pass.
+ *
+ * Returns one image per threshold, each level built from the previous
+ * one (the first level from \p src) with the corresponding threshold.
+ * The result is pixel-for-pixel identical to chaining ReduceThreshold
+ * calls, but the levels are produced in bands of rows, so each level's
+ * input is consumed while it is still in the cache rather than being
+ * re-read from memory in a separate full-image pass.
+ *
+ * Processing a null image results in null images on every level.
+ */
+std::vector<BinaryImage> reducePyramid(
+	BinaryImage const& src, std::vector<int> const& thresholds);
+
+
 } // namespace imageproc
 
 #endif
@@ -25,6 +25,7 @@
 #include "Morphology.h"
 #include "SeedFill.h"
 #include "RasterOp.h"
+#include "ParallelFor.h"
 #include <algorithm>
 #include <string.h>
 #include <math.h>
@@ -37,6 +38,242 @@ namespace imageproc
 // It exists to make sure INF_DIST + 1 doesn't overflow.
 uint32_t const SEDM::INF_DIST = ~uint32_t(0) - 1;
 
+namespace
+{
+
+inline uint32_t distSq(
+	int const x1, int const x2, uint32_t const dy_sq)
+{
+	if (dy_sq == SEDM::INF_DIST) {
+		return SEDM::INF_DIST;
+	}
+	int const dx = x1 - x2;
+	uint32_t const dx_sq = dx * dx;
+	return dx_sq + dy_sq;
+}
+
+/**
+ * The vertical pass of the distance transform over a range of columns.
+ * Columns are independent of each other, which allows processing them
+ * from multiple threads.
+ */
+class ColumnPassRange
+{
+public:
+	ColumnPassRange(uint32_t* data, int width, int height)
+	:	m_pData(data), m_width(width), m_height(height) {}
+
+	void operator()(int const begin_x, int const end_x) const {
+		for (int x = begin_x; x < end_x; ++x) {
+			uint32_t* p_sqd = m_pData + x;
+
+			// (d + 1)^2 = d^2 + 2d + 1
+			uint32_t b = 1; // 2d + 1 in the above formula.
+			for (int todo = m_height - 1; todo > 0; --todo) {
+				uint32_t const sqd = *p_sqd + b;
+				p_sqd += m_width;
+				if (*p_sqd > sqd) {
+					*p_sqd = sqd;
+					b += 2;
+				} else {
+					b = 1;
+				}
+			}
+
+			b = 1;
+			for (int todo = m_height - 1; todo > 0; --todo) {
+				uint32_t const sqd = *p_sqd + b;
+				p_sqd -= m_width;
+				if (*p_sqd > sqd) {
+					*p_sqd = sqd;
+					b += 2;
+				} else {
+					b = 1;
+				}
+			}
+		}
+	}
+private:
+	uint32_t* m_pData;
+	int m_width;
+	int m_height;
+};
+
+class ColumnPassCmapRange
+{
+public:
+	ColumnPassCmapRange(uint32_t* data, uint32_t* labels, int width, int height)
+	:	m_pData(data), m_pLabels(labels), m_width(width), m_height(height) {}
+
+	void operator()(int const begin_x, int const end_x) const {
+		for (int x = begin_x; x < end_x; ++x) {
+			uint32_t* p_sqd = m_pData + x;
+			uint32_t* p_label = m_pLabels + x;
+
+			// (d + 1)^2 = d^2 + 2d + 1
+			uint32_t b = 1; // 2d + 1 in the above formula.
+			for (int todo = m_height - 1; todo > 0; --todo) {
+				uint32_t const sqd = *p_sqd + b;
+				p_sqd += m_width;
+				p_label += m_width;
+				if (sqd < *p_sqd) {
+					*p_sqd = sqd;
+					*p_label = p_label[-m_width];
+					b += 2;
+				} else {
+					b = 1;
+				}
+			}
+
+			b = 1;
+			for (int todo = m_height - 1; todo > 0; --todo) {
+				uint32_t const sqd = *p_sqd + b;
+				p_sqd -= m_width;
+				p_label -= m_width;
+				if (sqd < *p_sqd) {
+					*p_sqd = sqd;
+					*p_label = p_label[m_width];
+					b += 2;
+				} else {
+					b = 1;
+				}
+			}
+		}
+	}
+private:
+	uint32_t* m_pData;
+	uint32_t* m_pLabels;
+	int m_width;
+	int m_height;
+};
+
+/**
+ * The horizontal pass of the distance transform over a range of rows,
+ * with per-range scratch buffers.
+ */
+class RowPassRange
+{
+public:
+	RowPassRange(uint32_t* data, int width)
+	:	m_pData(data), m_width(width) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		int const width = m_width;
+
+		std::vector<int> s(width, 0);
+		std::vector<int> t(width, 0);
+		std::vector<uint32_t> row_copy(width, 0);
+
+		uint32_t* line = m_pData + begin_y * width;
+		for (int y = begin_y; y < end_y; ++y, line += width) {
+			int q = 0;
+			s[0] = 0;
+			t[0] = 0;
+			for (int x = 1; x < width; ++x) {
+				while (q >= 0 && distSq(t[q], s[q], line[s[q]])
+						> distSq(t[q], x, line[x])) {
+					--q;
+				}
+
+				if (q < 0) {
+					q = 0;
+					s[0] = x;
+				} else {
+					int const x2 = s[q];
+					if (line[x] != SEDM::INF_DIST && line[x2] != SEDM::INF_DIST) {
+						int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
+						w /= (x - x2) << 1;
+						++w;
+						if ((unsigned)w < (unsigned)width) {
+							++q;
+							s[q] = x;
+							t[q] = w;
+						}
+					}
+				}
+			}
+
+			memcpy(&row_copy[0], line, width * sizeof(*line));
+
+			for (int x = width - 1; x >= 0; --x) {
+				int const x2 = s[q];
+				line[x] = distSq(x, x2, row_copy[x2]);
+				if (x == t[q]) {
+					--q;
+				}
+			}
+		}
+	}
+private:
+	uint32_t* m_pData;
+	int m_width;
+};
+
+class RowPassCmapRange
+{
+public:
+	RowPassCmapRange(uint32_t* data, uint32_t* labels, int width)
+	:	m_pData(data), m_pLabels(labels), m_width(width) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		int const width = m_width;
+
+		std::vector<int> s(width, 0);
+		std::vector<int> t(width, 0);
+		std::vector<uint32_t> row_copy(width, 0);
+		std::vector<uint32_t> cmap_row_copy(width, 0);
+
+		uint32_t* line = m_pData + begin_y * width;
+		uint32_t* cmap_line = m_pLabels + begin_y * width;
+		for (int y = begin_y; y < end_y; ++y, line += width, cmap_line += width) {
+			int q = 0;
+			s[0] = 0;
+			t[0] = 0;
+			for (int x = 1; x < width; ++x) {
+				while (q >= 0 && distSq(t[q], s[q], line[s[q]])
+						> distSq(t[q], x, line[x])) {
+					--q;
+				}
+
+				if (q < 0) {
+					q = 0;
+					s[0] = x;
+				} else {
+					int const x2 = s[q];
+					if (line[x] != SEDM::INF_DIST && line[x2] != SEDM::INF_DIST) {
+						int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
+						w /= (x - x2) << 1;
+						++w;
+						if ((unsigned)w < (unsigned)width) {
+							++q;
+							s[q] = x;
+							t[q] = w;
+						}
+					}
+				}
+			}
+
+			memcpy(&row_copy[0], line, width * sizeof(*line));
+			memcpy(&cmap_row_copy[0], cmap_line, width * sizeof(*cmap_line));
+
+			for (int x = width - 1; x >= 0; --x) {
+				int const x2 = s[q];
+				line[x] = distSq(x, x2, row_copy[x2]);
+				cmap_line[x] = cmap_row_copy[x2];
+				if (x == t[q]) {
+					--q;
+				}
+			}
+		}
+	}
+private:
+	uint32_t* m_pData;
+	uint32_t* m_pLabels;
+	int m_width;
+};
+
+} // anonymous namespace
+
 SEDM::SEDM()
 :	m_pData(0),
 	m_size(),
@@ -219,51 +456,13 @@ SEDM::findPeaksDestructive()
 	return peak_candidates;
 }
 
-inline uint32_t
-SEDM::distSq(
-	int const x1, int const x2, uint32_t const dy_sq)
-{
-	if (dy_sq == INF_DIST) {
-		return INF_DIST;
-	}
-	int const dx = x1 - x2;
-	uint32_t const dx_sq = dx * dx;
-	return dx_sq + dy_sq;
-}
-
 void
 SEDM::processColumns()
 {
 	int const width = m_size.width() + 2;
 	int const height = m_size.height() + 2;
-	
-	uint32_t* p_sqd = &m_data[0];
-	for (int x = 0; x < width; ++x, ++p_sqd) {
-		// (d + 1)^2 = d^2 + 2d + 1
-		uint32_t b = 1; // 2d + 1 in the above formula.
-		for (int todo = height - 1; todo > 0; --todo) {
-			uint32_t const sqd = *p_sqd + b;
-			p_sqd += width;
-			if (*p_sqd > sqd) {
-				*p_sqd = sqd;
-				b += 2;
-			} else {
-				b = 1;
-			}
-		}
-		
-		b = 1;
-		for (int todo = height - 1; todo > 0; --todo) {
-			uint32_t const sqd = *p_sqd + b;
-			p_sqd -= width;
-			if (*p_sqd > sqd) {
-				*p_sqd = sqd;
-				b += 2;
-			} else {
-				b = 1;
-			}
-		}
-	}
+
+	parallelForRanges(0, width, ColumnPassRange(&m_data[0], width, height));
 }
 
 void
@@ -271,39 +470,11 @@ SEDM::processColumns(ConnectivityMap& cmap)
 {
 	int const width = m_size.width() + 2;
 	int const height = m_size.height() + 2;
-	
-	uint32_t* p_sqd = &m_data[0];
-	uint32_t* p_label = cmap.paddedData();
-	for (int x = 0; x < width; ++x, ++p_sqd, ++p_label) {
-		// (d + 1)^2 = d^2 + 2d + 1
-		uint32_t b = 1; // 2d + 1 in the above formula.
-		for (int todo = height - 1; todo > 0; --todo) {
-			uint32_t const sqd = *p_sqd + b;
-			p_sqd += width;
-			p_label += width;
-			if (sqd < *p_sqd) {
-				*p_sqd = sqd;
-				*p_label = p_label[-width];
-				b += 2;
-			} else {
-				b = 1;
-			}
-		}
-		
-		b = 1;
-		for (int todo = height - 1; todo > 0; --todo) {
-			uint32_t const sqd = *p_sqd + b;
-			p_sqd -= width;
-			p_label -= width;
-			if (sqd < *p_sqd) {
-				*p_sqd = sqd;
-				*p_label = p_label[width];
-				b += 2;
-			} else {
-				b = 1;
-			}
-		}
-	}
+
+	parallelForRanges(
+		0, width,
+		ColumnPassCmapRange(&m_data[0], cmap.paddedData(), width, height)
+	);
 }
 
 void
@@ -311,50 +482,8 @@ SEDM::processRows()
 {
 	int const width = m_size.width() + 2;
 	int const height = m_size.height() + 2;
-	
-	std::vector<int> s(width, 0);
-	std::vector<int> t(width, 0);
-	std::vector<uint32_t> row_copy(width, 0);
-	
-	uint32_t* line = &m_data[0];
-	for (int y = 0; y < height; ++y, line += width) {
-		int q = 0;
-		s[0] = 0;
-		t[0] = 0;
-		for (int x = 1; x < width; ++x) {
-			while (q >= 0 && distSq(t[q], s[q], line[s[q]])
-					> distSq(t[q], x, line[x])) {
-				--q;
-			}
-			
-			if (q < 0) {
-				q = 0;
-				s[0] = x;
-			} else {
-				int const x2 = s[q];
-				if (line[x] != INF_DIST && line[x2] != INF_DIST) {
-					int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-					w /= (x - x2) << 1;
-					++w;
-					if ((unsigned)w < (unsigned)width) {
-						++q;
-						s[q] = x;
-						t[q] = w;
-					}
-				}
-			}
-		}
-		
-		memcpy(&row_copy[0], line, width * sizeof(*line));
-		
-		for (int x = width - 1; x >= 0; --x) {
-			int const x2 = s[q];
-			line[x] = distSq(x, x2, row_copy[x2]);
-			if (x == t[q]) {
-				--q;
-			}
-		}
-	}
+
+	parallelForRanges(0, height, RowPassRange(&m_data[0], width));
 }
 
 void
@@ -362,54 +491,11 @@ SEDM::processRows(ConnectivityMap& cmap)
 {
 	int const width = m_size.width() + 2;
 	int const height = m_size.height() + 2;
-	
-	std::vector<int> s(width, 0);
-	std::vector<int> t(width, 0);
-	std::vector<uint32_t> row_copy(width, 0);
-	std::vector<uint32_t> cmap_row_copy(width, 0);
-	
-	uint32_t* line = &m_data[0];
-	uint32_t* cmap_line = cmap.paddedData();
-	for (int y = 0; y < height; ++y, line += width, cmap_line += width) {
-		int q = 0;
-		s[0] = 0;
-		t[0] = 0;
-		for (int x = 1; x < width; ++x) {
-			while (q >= 0 && distSq(t[q], s[q], line[s[q]])
-					> distSq(t[q], x, line[x])) {
-				--q;
-			}
-			
-			if (q < 0) {
-				q = 0;
-				s[0] = x;
-			} else {
-				int const x2 = s[q];
-				if (line[x] != INF_DIST && line[x2] != INF_DIST) {
-					int w = (x * x + line[x]) - (x2 * x2 + line[x2]);
-					w /= (x - x2) << 1;
-					++w;
-					if ((unsigned)w < (unsigned)width) {
-						++q;
-						s[q] = x;
-						t[q] = w;
-					}
-				}
-			}
-		}
-		
-		memcpy(&row_copy[0], line, width * sizeof(*line));
-		memcpy(&cmap_row_copy[0], cmap_line, width * sizeof(*cmap_line));
-		
-		for (int x = width - 1; x >= 0; --x) {
-			int const x2 = s[q];
-			line[x] = distSq(x, x2, row_copy[x2]);
-			cmap_line[x] = cmap_row_copy[x2];
-			if (x == t[q]) {
-				--q;
-			}
-		}
-	}
+
+	parallelForRanges(
+		0, height,
+		RowPassCmapRange(&m_data[0], cmap.paddedData(), width)
+	);
 }
 
 
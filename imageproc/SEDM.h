@@ -172,8 +172,6 @@ public:
 	 */
 	BinaryImage findPeaksDestructive();
 private:
-	static uint32_t distSq(int x1, int x2, uint32_t dy_sq);
-	
 	void processColumns();
 	
 	void processColumns(ConnectivityMap& cmap);
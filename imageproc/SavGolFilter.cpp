@@ -20,11 +20,15 @@
 #include "SavGolKernel.h"
 #include "Grayscale.h"
 #include "AlignedArray.h"
+#include "AcceleratedOps.h"
+#include "ParallelFor.h"
 #include <QImage>
 #include <QSize>
 #include <QPoint>
 #include <QtGlobal>
 #include <stdexcept>
+#include <algorithm>
+#include <vector>
 #include <new>
 #include <stdint.h>
 #include <assert.h>
@@ -73,6 +77,104 @@ Kernel::convolve(uint8_t* dst, uint8_t const* src_top_left, int src_bpl) const
 	*dst = static_cast<uint8_t>(qBound(0, val, 255));
 }
 
+/**
+ * The horizontal pass of the separable filter over a band of rows.
+ */
+class HorPassRows
+{
+public:
+	HorPassRows(
+		uint8_t const* src_data, int src_bpl,
+		float* temp, int temp_stride,
+		float const* kernel, int kw, int width, int shift)
+	:	m_pSrcData(src_data), m_srcBpl(src_bpl),
+		m_pTemp(temp), m_tempStride(temp_stride),
+		m_pKernel(kernel), m_kw(kw), m_width(width), m_shift(shift) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		uint8_t const* src_line = m_pSrcData + begin_y * m_srcBpl - m_shift;
+		float* temp_line = m_pTemp + begin_y * m_tempStride - m_shift;
+
+		for (int y = begin_y; y < end_y; ++y) {
+			for (int i = m_shift; i < m_width; ++i) {
+				float sum = 0.0f;
+
+				uint8_t const* src = src_line + i;
+				for (int j = 0; j < m_kw; ++j) {
+					sum += src[j] * m_pKernel[j];
+				}
+				temp_line[i] = sum;
+			}
+			temp_line += m_tempStride;
+			src_line += m_srcBpl;
+		}
+	}
+private:
+	uint8_t const* m_pSrcData;
+	int m_srcBpl;
+	float* m_pTemp;
+	int m_tempStride;
+	float const* m_pKernel;
+	int m_kw;
+	int m_width;
+	int m_shift;
+};
+
+/**
+ * The vertical pass of the separable filter over a band of output rows.
+ * Rather than dotting down a column per output pixel, whole temp rows
+ * are scaled and accumulated, which keeps memory access sequential
+ * and lets the inner loop vectorize.
+ */
+class VertPassRows
+{
+public:
+	VertPassRows(
+		float const* temp, int temp_stride,
+		uint8_t* dst_data, int dst_bpl,
+		float const* kernel, int kh,
+		int width, int shift, int k_top, int k_left)
+	:	m_pTemp(temp), m_tempStride(temp_stride),
+		m_pDstData(dst_data), m_dstBpl(dst_bpl),
+		m_pKernel(kernel), m_kh(kh),
+		m_width(width), m_shift(shift), m_kTop(k_top), m_kLeft(k_left) {}
+
+	void operator()(int const begin_y, int const end_y) const {
+		int const len = m_width - m_shift;
+		std::vector<float> accum(len);
+
+		uint8_t* dst_line = m_pDstData + begin_y * m_dstBpl + m_kLeft;
+
+		for (int y = begin_y; y < end_y; ++y, dst_line += m_dstBpl) {
+			float const* temp_line = m_pTemp + (y - m_kTop) * m_tempStride;
+
+			std::fill(accum.begin(), accum.end(), 0.0f);
+			for (int j = 0; j < m_kh; ++j, temp_line += m_tempStride) {
+				float const coeff = m_pKernel[j];
+				for (int i = 0; i < len; ++i) {
+					accum[i] += temp_line[i] * coeff;
+				}
+			}
+
+			for (int i = 0; i < len; ++i) {
+				int const val = static_cast<int>(accum[i]);
+				dst_line[i] = static_cast<uint8_t>(qBound(0, val, 255));
+			}
+		}
+	}
+private:
+	float const* m_pTemp;
+	int m_tempStride;
+	uint8_t* m_pDstData;
+	int m_dstBpl;
+	float const* m_pKernel;
+	int m_kh;
+	int m_width;
+	int m_shift;
+	int m_kTop;
+	int m_kLeft;
+};
+
 QImage savGolFilterGrayToGray(
 	QImage const& src, QSize const& window_size,
 	int const hor_degree, int const vert_degree)
@@ -201,40 +303,20 @@ QImage savGolFilterGrayToGray(
 	AlignedArray<float, 4> temp_array(temp_stride * height);
 	
 	// Horizontal pass.
-	src_line = src_data - shift;
-	float* temp_line = temp_array.data() - shift;
-	for (int y = 0; y < height; ++y) {
-		for (int i = shift; i < width; ++i) {
-			float sum = 0.0f;
-			
-			uint8_t const* src = src_line + i;
-			for (int j = 0; j < kw; ++j) {
-				sum += src[j] * hor_kernel[j];
-			}
-			temp_line[i] = sum;
-		}
-		temp_line += temp_stride;
-		src_line += src_bpl;
-	}
-	
+	parallelForRanges(
+		0, height, HorPassRows(
+			src_data, src_bpl, temp_array.data(), temp_stride,
+			hor_kernel.data(), kw, width, shift
+		)
+	);
+
 	// Vertical pass.
-	dst_line = dst_data + k_top * dst_bpl + k_left - shift;
-	temp_line = temp_array.data() - shift;
-	for (int y = k_top; y < height - k_bottom; ++y) {
-		for (int i = shift; i < width; ++i) {
-			float sum = 0.0f;
-			
-			float* tmp = temp_line + i;
-			for (int j = 0; j < kh; ++j, tmp += temp_stride) {
-				sum += *tmp * vert_kernel[j];
-			}
-			int const val = static_cast<int>(sum);
-			dst_line[i] = static_cast<uint8_t>(qBound(0, val, 255));
-		}
-		
-		temp_line += temp_stride;
-		dst_line += dst_bpl;
-	}
+	parallelForRanges(
+		k_top, height - k_bottom, VertPassRows(
+			temp_array.data(), temp_stride, dst_data, dst_bpl,
+			vert_kernel.data(), kh, width, shift, k_top, k_left
+		)
+	);
 #endif
 
 	// Left area between two corners.
@@ -331,7 +413,14 @@ QImage savGolFilter(
 		throw std::invalid_argument(
 			"savGolFilter: order is too big for that window");
 	}
-	
+
+	if (AcceleratedOps* const accel = acceleratedOps()) {
+		QImage accel_dst;
+		if (accel->savGolFilter(src, window_size, hor_degree, vert_degree, accel_dst)) {
+			return accel_dst;
+		}
+	}
+
 	return savGolFilterGrayToGray(
 		toGrayscale(src), window_size, hor_degree, vert_degree
 	);
@@ -21,15 +21,53 @@
 #include <QImage>
 #include <QSize>
 #include <stdexcept>
+#include <algorithm>
+#include <vector>
 #include <stdint.h>
 #include <assert.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace imageproc
 {
 
+/**
+ * Adds a line of 8-bit pixels to a line of 32-bit column accumulators.
+ */
+static void accumulateLine(uint8_t const* src, uint32_t* accum, int const len)
+{
+	int x = 0;
+#if defined(__SSE2__)
+	__m128i const zero = _mm_setzero_si128();
+	for (; x + 16 <= len; x += 16) {
+		__m128i const bytes = _mm_loadu_si128((__m128i const*)(src + x));
+		__m128i const lo16 = _mm_unpacklo_epi8(bytes, zero);
+		__m128i const hi16 = _mm_unpackhi_epi8(bytes, zero);
+		__m128i* const pa = (__m128i*)(accum + x);
+		_mm_storeu_si128(pa, _mm_add_epi32(
+			_mm_loadu_si128(pa), _mm_unpacklo_epi16(lo16, zero)));
+		_mm_storeu_si128(pa + 1, _mm_add_epi32(
+			_mm_loadu_si128(pa + 1), _mm_unpackhi_epi16(lo16, zero)));
+		_mm_storeu_si128(pa + 2, _mm_add_epi32(
+			_mm_loadu_si128(pa + 2), _mm_unpacklo_epi16(hi16, zero)));
+		_mm_storeu_si128(pa + 3, _mm_add_epi32(
+			_mm_loadu_si128(pa + 3), _mm_unpackhi_epi16(hi16, zero)));
+	}
+#endif
+	for (; x < len; ++x) {
+		accum[x] += src[x];
+	}
+}
+
 /**
  * This is an optimized implementation for the case when every destination
  * pixel maps exactly to a M x N block of source pixels.
+ *
+ * Rather than gathering each M x N block separately, a band of N source
+ * rows is swept once into per-column accumulators, which is then reduced
+ * horizontally into destination pixels.  Both passes access memory
+ * sequentially, and the first one vectorizes.
  */
 static GrayImage scaleDownIntGrayToGray(GrayImage const& src, QSize const& dst_size)
 {
@@ -37,45 +75,41 @@ static GrayImage scaleDownIntGrayToGray(GrayImage const& src, QSize const& dst_s
 	int const sh = src.height();
 	int const dw = dst_size.width();
 	int const dh = dst_size.height();
-	
+
 	int const xscale = sw / dw;
 	int const yscale = sh / dh;
 	int const total_area = xscale * yscale;
-	
+
 	GrayImage dst(dst_size);
-	
+
 	uint8_t const* src_line = src.data();
 	uint8_t* dst_line = dst.data();
 	int const src_stride = src.stride();
-	int const src_stride_scaled = src_stride * yscale;
 	int const dst_stride = dst.stride();
-	
-	int sy = 0;
-	int dy = 0;
-	for (; dy < dh; ++dy, sy += yscale) {
-		
-		int sx = 0;
-		int dx = 0;
-		for (; dx < dw; ++dx, sx += xscale) {
-			
+
+	std::vector<uint32_t> col_sums(sw);
+	int const used_width = dw * xscale;
+
+	for (int dy = 0; dy < dh; ++dy, dst_line += dst_stride) {
+		std::fill(col_sums.begin(), col_sums.end(), 0);
+
+		for (int i = 0; i < yscale; ++i, src_line += src_stride) {
+			accumulateLine(src_line, &col_sums[0], used_width);
+		}
+
+		uint32_t const* pcol = &col_sums[0];
+		for (int dx = 0; dx < dw; ++dx, pcol += xscale) {
 			unsigned gray_level = 0;
-			uint8_t const* psrc = src_line + sx;
-			
-			for (int i = 0; i < yscale; ++i, psrc += src_stride) {
-				for (int j = 0; j < xscale; ++j) {
-					gray_level += psrc[j];
-				}
+			for (int j = 0; j < xscale; ++j) {
+				gray_level += pcol[j];
 			}
-			
+
 			unsigned const pix_value = (gray_level + (total_area >> 1)) / total_area;
 			assert(pix_value < 256);
 			dst_line[dx] = static_cast<uint8_t>(pix_value);
 		}
-		
-		src_line += src_stride_scaled;
-		dst_line += dst_stride;
 	}
-	
+
 	return dst;
 }
 
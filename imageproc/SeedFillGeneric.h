@@ -23,6 +23,7 @@
 #include "FastQueue.h"
 #include <QSize>
 #include <vector>
+#include <stdint.h>
 #include <assert.h>
 
 namespace imageproc
@@ -92,10 +93,43 @@ void seedFillSingleLine(
 	}
 }
 
+/**
+ * \brief One bit per pixel, set while the pixel sits in the queue.
+ *
+ * Queuing a pixel that's already queued is pointless: the queued
+ * entry re-reads the seed value when popped, so it will propagate
+ * the latest value anyway.  The duplicates aren't incorrect, just
+ * pure waste - each one costs a full scan of its neighbors.
+ */
+class InQueueFlags
+{
+public:
+	InQueueFlags(int width, int height)
+	: m_wpl((width + 31) >> 5), m_bits(m_wpl * height, 0) {}
+
+	/**
+	 * \brief Sets the bit and returns whether it was already set.
+	 */
+	bool testAndSet(int x, int y) {
+		uint32_t& word = m_bits[y * m_wpl + (x >> 5)];
+		uint32_t const bit = (uint32_t(1) << 31) >> (x & 31);
+		bool const was_set = (word & bit) != 0;
+		word |= bit;
+		return was_set;
+	}
+
+	void clear(int x, int y) {
+		m_bits[y * m_wpl + (x >> 5)] &= ~((uint32_t(1) << 31) >> (x & 31));
+	}
+private:
+	int m_wpl;
+	std::vector<uint32_t> m_bits;
+};
+
 template<typename T, typename SpreadOp, typename MaskOp>
 inline void processNeighbor(
 	SpreadOp spread_op, MaskOp mask_op,
-	FastQueue<Position<T> >& queue, T const this_val,
+	FastQueue<Position<T> >& queue, InQueueFlags& in_queue, T const this_val,
 	T* const neighbor, T const* const neighbor_mask,
 	Position<T> const& base_pos, int const x_delta, int const y_delta)
 {
@@ -104,14 +138,16 @@ inline void processNeighbor(
 		*neighbor = new_val;
 		int const x = base_pos.x + x_delta;
 		int const y = base_pos.y + y_delta;
-		queue.push(Position<T>(neighbor, neighbor_mask, x, y));
+		if (!in_queue.testAndSet(x, y)) {
+			queue.push(Position<T>(neighbor, neighbor_mask, x, y));
+		}
 	}
 }
 
 template<typename T, typename SpreadOp, typename MaskOp>
 void spread4(
 	SpreadOp spread_op, MaskOp mask_op,
-	FastQueue<Position<T> >& queue,
+	FastQueue<Position<T> >& queue, InQueueFlags& in_queue,
 	HTransition const* h_transitions,
 	VTransition const* v_transitions,
 	int const seed_stride, int const mask_stride)
@@ -119,6 +155,7 @@ void spread4(
 	while (!queue.empty()) {
 		Position<T> const pos(queue.front());
 		queue.pop();
+		in_queue.clear(pos.x, pos.y);
 
 		T const this_val(*pos.seed);
 		HTransition const ht(h_transitions[pos.x]);
@@ -130,28 +167,28 @@ void spread4(
 		seed = pos.seed + ht.west_delta;
 		mask = pos.mask + ht.west_delta;
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask, pos, ht.west_delta, 0
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask, pos, ht.west_delta, 0
 		);
 
 		// Eastern neighbor.
 		seed = pos.seed + ht.east_delta;
 		mask = pos.mask + ht.east_delta;
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask, pos, ht.east_delta, 0
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask, pos, ht.east_delta, 0
 		);
 
 		// Northern neighbor.
 		seed = pos.seed - (seed_stride & vt.north_mask);
 		mask = pos.mask - (mask_stride & vt.north_mask);
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask, pos, 0, -1 & vt.north_mask
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask, pos, 0, -1 & vt.north_mask
 		);
 
 		// Southern neighbor.
 		seed = pos.seed + (seed_stride & vt.south_mask);
 		mask = pos.mask + (mask_stride & vt.south_mask);
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask, pos, 0, 1 & vt.south_mask
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask, pos, 0, 1 & vt.south_mask
 		);
 	}
 }
@@ -159,7 +196,7 @@ void spread4(
 template<typename T, typename SpreadOp, typename MaskOp>
 void spread8(
 	SpreadOp spread_op, MaskOp mask_op,
-	FastQueue<Position<T> >& queue,
+	FastQueue<Position<T> >& queue, InQueueFlags& in_queue,
 	HTransition const* h_transitions,
 	VTransition const* v_transitions,
 	int const seed_stride, int const mask_stride)
@@ -167,6 +204,7 @@ void spread8(
 	while (!queue.empty()) {
 		Position<T> const pos(queue.front());
 		queue.pop();
+		in_queue.clear(pos.x, pos.y);
 
 		T const this_val(*pos.seed);
 		HTransition const ht(h_transitions[pos.x]);
@@ -178,7 +216,7 @@ void spread8(
 		seed = pos.seed - (seed_stride & vt.north_mask);
 		mask = pos.mask - (mask_stride & vt.north_mask);
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask,
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask,
 			pos, 0, -1 & vt.north_mask
 		);
 
@@ -186,7 +224,7 @@ void spread8(
 		seed = pos.seed - (seed_stride & vt.north_mask) + ht.west_delta;
 		mask = pos.mask - (mask_stride & vt.north_mask) + ht.west_delta;
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask,
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask,
 			pos, ht.west_delta, -1 & vt.north_mask
 		);
 
@@ -194,7 +232,7 @@ void spread8(
 		seed = pos.seed - (seed_stride & vt.north_mask) + ht.east_delta;
 		mask = pos.mask - (mask_stride & vt.north_mask) + ht.east_delta;
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask,
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask,
 			pos, ht.east_delta, -1 & vt.north_mask
 		);
 
@@ -202,28 +240,28 @@ void spread8(
 		seed = pos.seed + ht.east_delta;
 		mask = pos.mask + ht.east_delta;
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask, pos, ht.east_delta, 0
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask, pos, ht.east_delta, 0
 		);
 
 		// Western neighbor.
 		seed = pos.seed + ht.west_delta;
 		mask = pos.mask + ht.west_delta;
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask, pos, ht.west_delta, 0
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask, pos, ht.west_delta, 0
 		);
 
 		// Southern neighbor.
 		seed = pos.seed + (seed_stride & vt.south_mask);
 		mask = pos.mask + (mask_stride & vt.south_mask);
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask, pos, 0, 1 & vt.south_mask
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask, pos, 0, 1 & vt.south_mask
 		);
 
 		// South-Eastern neighbor.
 		seed = pos.seed + (seed_stride & vt.south_mask) + ht.east_delta;
 		mask = pos.mask + (mask_stride & vt.south_mask) + ht.east_delta;
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask,
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask,
 			pos, ht.east_delta, 1 & vt.south_mask
 		);
 
@@ -231,7 +269,7 @@ void spread8(
 		seed = pos.seed + (seed_stride & vt.south_mask) + ht.west_delta;
 		mask = pos.mask + (seed_stride & vt.south_mask) + ht.west_delta;
 		processNeighbor(
-			spread_op, mask_op, queue, this_val, seed, mask,
+			spread_op, mask_op, queue, in_queue, this_val, seed, mask,
 			pos, ht.west_delta, 1 & vt.south_mask
 		);
 	}
@@ -273,6 +311,7 @@ void seedFill4(
 	mask_line -= mask_stride;
 
 	FastQueue<Position<T> > queue;
+	InQueueFlags in_queue(w, h);
 	std::vector<HTransition> h_transitions;
 	std::vector<VTransition> v_transitions;
 	initHorTransitions(h_transitions, w);
@@ -310,13 +349,13 @@ void seedFill4(
 
 			// Eastern neighbor.
 			processNeighbor(
-				spread_op, mask_op, queue, new_val,
+				spread_op, mask_op, queue, in_queue, new_val,
 				p_east_seed, p_east_mask, pos, ht.east_delta, 0
 			);
 
 			// Southern neighbor.
 			processNeighbor(
-				spread_op, mask_op, queue, new_val,
+				spread_op, mask_op, queue, in_queue, new_val,
 				p_south_seed, p_south_mask, pos, 0, 1 & vt.south_mask
 			);
 		}
@@ -326,7 +365,7 @@ void seedFill4(
 	}
 
 	spread4(
-		spread_op, mask_op, queue, &h_transitions[0],
+		spread_op, mask_op, queue, in_queue, &h_transitions[0],
 		&v_transitions[0], seed_stride, mask_stride
 	);
 }
@@ -411,6 +450,7 @@ void seedFill8(
 	}
 
 	FastQueue<Position<T> > queue;
+	InQueueFlags in_queue(w, h);
 	std::vector<HTransition> h_transitions;
 	std::vector<VTransition> v_transitions;
 	initHorTransitions(h_transitions, w);
@@ -455,26 +495,26 @@ void seedFill8(
 
 			// Eastern neighbor.
 			processNeighbor(
-				spread_op, mask_op, queue, new_val,
+				spread_op, mask_op, queue, in_queue, new_val,
 				p_east_seed, p_east_mask, pos, ht.east_delta, 0
 			);
 
 			// South-eastern neighbor.
 			processNeighbor(
-				spread_op, mask_op, queue, new_val,
+				spread_op, mask_op, queue, in_queue, new_val,
 				p_south_east_seed, p_south_east_mask, pos,
 				ht.east_delta, 1 & vt.south_mask
 			);
 
 			// Southern neighbor.
 			processNeighbor(
-				spread_op, mask_op, queue, new_val,
+				spread_op, mask_op, queue, in_queue, new_val,
 				p_south_seed, p_south_mask, pos, 0, 1 & vt.south_mask
 			);
 
 			// South-western neighbor.
 			processNeighbor(
-				spread_op, mask_op, queue, new_val,
+				spread_op, mask_op, queue, in_queue, new_val,
 				p_south_west_seed, p_south_west_mask, pos,
 				ht.west_delta, 1 & vt.south_mask
 			);
@@ -485,7 +525,7 @@ void seedFill8(
 	}
 
 	spread8(
-		spread_op, mask_op, queue, &h_transitions[0],
+		spread_op, mask_op, queue, in_queue, &h_transitions[0],
 		&v_transitions[0], seed_stride, mask_stride
 	);
 }
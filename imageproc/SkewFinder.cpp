@@ -23,7 +23,10 @@
 #include "Shear.h"
 #include "ReduceThreshold.h"
 #include "Constants.h"
+#include "ParallelFor.h"
 #include <QDebug>
+#include <vector>
+#include <algorithm>
 #include <stdexcept>
 #include <stdint.h>
 #include <math.h>
@@ -31,6 +34,38 @@
 namespace imageproc
 {
 
+/**
+ * \brief Evaluates projection quality for a set of angles.
+ *
+ * Designed for parallelForRanges().  Each worker gets its own
+ * scratch image, as shear targets can't be shared between threads.
+ */
+class SkewFinder::AngleEvaluator
+{
+public:
+	AngleEvaluator(
+		SkewFinder const& skew_finder, BinaryImage const& src,
+		std::vector<double> const& angles, std::vector<double>& scores)
+	:	m_rSkewFinder(skew_finder),
+		m_rSrc(src),
+		m_rAngles(angles),
+		m_rScores(scores)
+	{
+	}
+
+	void operator()(int const begin, int const end) const {
+		BinaryImage scratch(m_rSrc.size());
+		for (int i = begin; i < end; ++i) {
+			m_rScores[i] = m_rSkewFinder.process(m_rSrc, scratch, m_rAngles[i]);
+		}
+	}
+private:
+	SkewFinder const& m_rSkewFinder;
+	BinaryImage const& m_rSrc;
+	std::vector<double> const& m_rAngles;
+	std::vector<double>& m_rScores;
+};
+
 double const Skew::GOOD_CONFIDENCE = 2.0;
 
 double const SkewFinder::DEFAULT_MAX_ANGLE = 7.0;
@@ -113,21 +148,28 @@ SkewFinder::findSkew(BinaryImage const& image) const
 		coarse_reduced.reduce(i == 0 ? 1 : 2);
 	}
 	
-	BinaryImage skewed(coarse_reduced.image().size());
 	double const coarse_step = 1.0; // degrees
-	
-	// Coarse linear search.
-	int num_coarse_scores = 0;
+
+	// Coarse linear search over the full angle range.
+	std::vector<double> coarse_angles;
+	for (double angle = -m_maxAngle; angle <= m_maxAngle; angle += coarse_step) {
+		coarse_angles.push_back(angle);
+	}
+	std::vector<double> coarse_scores(coarse_angles.size(), 0.0);
+	parallelForRanges(
+		0, (int)coarse_angles.size(),
+		AngleEvaluator(*this, coarse_reduced.image(), coarse_angles, coarse_scores)
+	);
+
+	int const num_coarse_scores = coarse_scores.size();
 	double sum_coarse_scores = 0.0;
 	double best_coarse_score = 0.0;
 	double best_coarse_angle = -m_maxAngle;
-	for (double angle = -m_maxAngle; angle <= m_maxAngle; angle += coarse_step) {
-		double const score = process(coarse_reduced, skewed, angle);
-		sum_coarse_scores += score;
-		++num_coarse_scores;
-		if (score > best_coarse_score) {
-			best_coarse_angle = angle;
-			best_coarse_score = score;
+	for (int i = 0; i < num_coarse_scores; ++i) {
+		sum_coarse_scores += coarse_scores[i];
+		if (coarse_scores[i] > best_coarse_score) {
+			best_coarse_angle = coarse_angles[i];
+			best_coarse_score = coarse_scores[i];
 		}
 	}
 	
@@ -143,54 +185,51 @@ SkewFinder::findSkew(BinaryImage const& image) const
 	for (int i = min_reduction; i < m_fineReduction; ++i) {
 		fine_reduced.reduce(i == 0 ? 1 : 2);
 	}
-	
-	if (m_coarseReduction != m_fineReduction) {
-		skewed = BinaryImage(fine_reduced.image().size());
+
+	// Fine linear search over a narrow bracket around the coarse winner.
+	// Unlike a binary search, it doesn't assume the score is unimodal
+	// within the bracket, and all evaluations can run concurrently.
+	double const bracket = 0.5 * coarse_step;
+	int const num_fine_angles = std::max<int>(
+		2, (int)ceil(2.0 * bracket / m_accuracy) + 1
+	);
+	std::vector<double> fine_angles;
+	fine_angles.reserve(num_fine_angles);
+	for (int i = 0; i < num_fine_angles; ++i) {
+		fine_angles.push_back(
+			best_coarse_angle - bracket
+			+ 2.0 * bracket * i / (num_fine_angles - 1)
+		);
 	}
-	
-	// Fine binary search.
-	double angle_plus = best_coarse_angle + 0.5 * coarse_step;
-	double angle_minus = best_coarse_angle - 0.5 * coarse_step;
-	double score_plus = process(fine_reduced, skewed, angle_plus);
-	double score_minus = process(fine_reduced, skewed, angle_minus);
-	double const fine_score1 = score_plus;
-	double const fine_score2 = score_minus;
-	while (angle_plus - angle_minus > m_accuracy) {
-		if (score_plus > score_minus) {
-			angle_minus = 0.5 * (angle_plus + angle_minus);
-			score_minus = process(fine_reduced, skewed, angle_minus);
-		} else if (score_plus < score_minus) {
-			angle_plus = 0.5 * (angle_plus + angle_minus);
-			score_plus = process(fine_reduced, skewed, angle_plus);
-		} else {
-			// This protects us from unreasonably low m_accuracy.
-			break;
+	std::vector<double> fine_scores(fine_angles.size(), 0.0);
+	parallelForRanges(
+		0, (int)fine_angles.size(),
+		AngleEvaluator(*this, fine_reduced.image(), fine_angles, fine_scores)
+	);
+
+	double best_angle = fine_angles[0];
+	double best_score = fine_scores[0];
+	for (int i = 1; i < num_fine_angles; ++i) {
+		if (fine_scores[i] > best_score) {
+			best_angle = fine_angles[i];
+			best_score = fine_scores[i];
 		}
 	}
-	
-	double best_angle;
-	double best_score;
-	if (score_plus > score_minus) {
-		best_angle = angle_plus;
-		best_score = score_plus;
-	} else {
-		best_angle = angle_minus;
-		best_score = score_minus;
-	}
-	
+
 	if (best_score <= LOW_SCORE) {
 		return Skew(-best_angle, 0.0); // Zero confidence.
 	}
-	
+
 	double confidence = 0.0;
 	if (num_coarse_scores > 1) {
 		confidence = best_score / sum_coarse_scores * num_coarse_scores;
 	} else {
 		int num_scores = num_coarse_scores;
 		double sum_scores = sum_coarse_scores;
-		num_scores += 2;
-		sum_scores += fine_score1;
-		sum_scores += fine_score2;
+		for (int i = 0; i < num_fine_angles; ++i) {
+			++num_scores;
+			sum_scores += fine_scores[i];
+		}
 		confidence = best_score / sum_scores * num_scores;
 	}
 	return Skew(-best_angle, confidence - 1.0);
@@ -139,8 +139,10 @@ public:
 	 */
 	Skew findSkew(BinaryImage const& image) const;
 private:
+	class AngleEvaluator;
+
 	static double const LOW_SCORE;
-	
+
 	double process(BinaryImage const& src, BinaryImage& dst, double angle) const;
 	
 	static double calcScore(BinaryImage const& image);
@@ -20,7 +20,9 @@
 #include "BinaryImage.h"
 #include "BitOps.h"
 #include <QRect>
+#include <vector>
 #include <stdexcept>
+#include <stdint.h>
 
 namespace imageproc
 {
@@ -83,8 +85,15 @@ SlicedHistogram::processHorizontalLines(BinaryImage const& image, QRect const& a
 		for (int y = top; y <= bottom; ++y, line += wpl) {
 			int idx = first_word_idx;
 			int count = countNonZeroBits(line[idx] & first_word_mask);
-			for (++idx; idx != last_word_idx; ++idx) {
+			for (++idx; idx + 1 < last_word_idx; idx += 2) {
+				// Feed two words at once into a single 64-bit popcount.
+				uint64_t const two_words =
+					(uint64_t(line[idx]) << 32) | line[idx + 1];
+				count += countNonZeroBits(two_words);
+			}
+			if (idx != last_word_idx) {
 				count += countNonZeroBits(line[idx]);
+				++idx;
 			}
 			count += countNonZeroBits(line[idx] & last_word_mask);
 			m_data.push_back(count);
@@ -95,21 +104,69 @@ SlicedHistogram::processHorizontalLines(BinaryImage const& image, QRect const& a
 void
 SlicedHistogram::processVerticalLines(BinaryImage const& image, QRect const& area)
 {
-	m_data.reserve(area.width());
-	
-	int const right = area.right();
-	int const height = area.height();
+	m_data.assign(area.width(), 0);
+	if (area.isEmpty()) {
+		return;
+	}
+
+	int const top = area.top();
+	int const bottom = area.bottom();
+	int const left = area.left();
 	int const wpl = image.wordsPerLine();
-	uint32_t const* const top_line = image.data() + area.top() * wpl;
-	
-	for (int x = area.left(); x <= right; ++x) {
-		uint32_t const* pword = top_line + (x >> 5);
-		int const least_significant_zeroes = 31 - (x & 31);
-		int count = 0;
-		for (int i = 0; i < height; ++i, pword += wpl) {
-			count += (*pword >> least_significant_zeroes) & 1;
+	int const first_word_idx = left >> 5;
+	int const last_word_idx = area.right() >> 5; // area.right() is within area
+	uint32_t const first_word_mask = ~uint32_t(0) >> (left & 31);
+	int const last_word_unused_bits = (last_word_idx << 5) + 31 - area.right();
+	uint32_t const last_word_mask = ~uint32_t(0) << last_word_unused_bits;
+	int const num_words = last_word_idx - first_word_idx + 1;
+
+	std::vector<uint32_t> word_masks(num_words, ~uint32_t(0));
+	word_masks.front() &= first_word_mask;
+	word_masks.back() &= last_word_mask;
+
+	// Rather than walking each column separately, which touches
+	// memory with a stride of wpl words, we make a single row-major
+	// pass.  Each word gets NUM_PLANES bit-planes that act as 32
+	// column counters NUM_PLANES bits deep, maintained with
+	// carry-save addition.  The counters are flushed into m_data
+	// before they can overflow.
+	static int const NUM_PLANES = 8;
+	static int const MAX_ROWS_PER_FLUSH = (1 << NUM_PLANES) - 1;
+	std::vector<uint32_t> planes(num_words * NUM_PLANES, 0);
+
+	uint32_t const msb = uint32_t(1) << 31;
+	uint32_t const* line = image.data() + top * wpl + first_word_idx;
+
+	int rows_until_flush = MAX_ROWS_PER_FLUSH;
+	for (int y = top; y <= bottom; ++y, line += wpl) {
+		uint32_t* plane = &planes[0];
+		for (int widx = 0; widx < num_words; ++widx, plane += NUM_PLANES) {
+			uint32_t carry = line[widx] & word_masks[widx];
+			for (int p = 0; p < NUM_PLANES && carry; ++p) {
+				uint32_t const tmp = plane[p] & carry;
+				plane[p] ^= carry;
+				carry = tmp;
+			}
+		}
+
+		if (--rows_until_flush == 0 || y == bottom) {
+			uint32_t* flush_plane = &planes[0];
+			for (int widx = 0; widx < num_words;
+					++widx, flush_plane += NUM_PLANES) {
+				int const base = ((first_word_idx + widx) << 5) - left;
+				for (int p = 0; p < NUM_PLANES; ++p) {
+					uint32_t word = flush_plane[p];
+					flush_plane[p] = 0;
+					int const weight = 1 << p;
+					while (word) {
+						int const bit = countMostSignificantZeroes(word);
+						m_data[base + bit] += weight;
+						word &= ~(msb >> bit);
+					}
+				}
+			}
+			rows_until_flush = MAX_ROWS_PER_FLUSH;
 		}
-		m_data.push_back(count);
 	}
 }
 
@@ -19,6 +19,11 @@
 #ifndef IMAGEPROC_SOBEL_H_
 #define IMAGEPROC_SOBEL_H_
 
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /**
  * \file
  *
@@ -30,6 +35,55 @@
 namespace imageproc
 {
 
+namespace sobel_impl
+{
+
+/**
+ * Writes the interior columns [1, width - 1) of a directional derivative
+ * row, given the vertical smoothing sums (top + mid*2 + bottom) and the
+ * vertical differences (bottom - top) of the row.
+ */
+template<typename T>
+void combineDirectionalRow(
+	T const* vsum, T const* vdiff, T* dst, int width, T dir_x, T dir_y)
+{
+	for (int x = 1; x < width - 1; ++x) {
+		dst[x] = (vsum[x + 1] - vsum[x - 1]) * dir_x
+			+ (vdiff[x - 1] + vdiff[x] + vdiff[x] + vdiff[x + 1]) * dir_y;
+	}
+}
+
+#if defined(__SSE2__)
+
+inline void combineDirectionalRow(
+	float const* vsum, float const* vdiff, float* dst, int width,
+	float dir_x, float dir_y)
+{
+	__m128 const dx = _mm_set1_ps(dir_x);
+	__m128 const dy = _mm_set1_ps(dir_y);
+
+	int x = 1;
+	for (; x + 4 <= width - 1; x += 4) {
+		__m128 const h = _mm_sub_ps(
+			_mm_loadu_ps(vsum + x + 1), _mm_loadu_ps(vsum + x - 1)
+		);
+		__m128 const mid = _mm_loadu_ps(vdiff + x);
+		__m128 const v = _mm_add_ps(
+			_mm_add_ps(_mm_loadu_ps(vdiff + x - 1), _mm_loadu_ps(vdiff + x + 1)),
+			_mm_add_ps(mid, mid)
+		);
+		_mm_storeu_ps(dst + x, _mm_add_ps(_mm_mul_ps(h, dx), _mm_mul_ps(v, dy)));
+	}
+	for (; x < width - 1; ++x) {
+		dst[x] = (vsum[x + 1] - vsum[x - 1]) * dir_x
+			+ (vdiff[x - 1] + vdiff[x] + vdiff[x] + vdiff[x + 1]) * dir_y;
+	}
+}
+
+#endif
+
+} // namespace sobel_impl
+
 /**
  * Computes approximation of the horizontal gradient component, that is
  * the partial derivative with respect to x (multiplied by 8).
@@ -101,6 +155,66 @@ void verticalSobel(
 	DstIt dst, int dst_stride, DstWriter dst_writer);
 
 
+/**
+ * \brief Computes hgrad * dir_x + vgrad * dir_y in a single pass.
+ *
+ * Produces exactly what running horizontalSobel() and verticalSobel()
+ * over the same grid and combining the two results would, but works
+ * row by row from two scanline buffers, so it doesn't need a temporary
+ * grid and touches the source and destination memory only once.  The
+ * interior of each row is processed with an SSE2 kernel when \p T is
+ * float.
+ *
+ * \p dst must not overlap the source grid, as source rows are still
+ * read after the corresponding destination row has been written.
+ * Parameters match those of horizontalSobel(), except the destination
+ * is a plain pointer (or anything convertible to one) to rows of T.
+ */
+template<typename T, typename SrcIt, typename SrcReader>
+void directionalSobel(
+	int const width, int const height,
+	SrcIt src, int const src_stride, SrcReader src_reader,
+	T* dst, int const dst_stride, T const dir_x, T const dir_y)
+{
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+
+	std::vector<T> vsum(width);  // top + mid*2 + bottom
+	std::vector<T> vdiff(width); // bottom - top
+
+	SrcIt mid_row(src);
+	for (int y = 0; y < height; ++y, mid_row += src_stride, dst += dst_stride) {
+		SrcIt const top_row(y == 0 ? mid_row : mid_row - src_stride);
+		SrcIt const bottom_row(y == height - 1 ? mid_row : mid_row + src_stride);
+
+		for (int x = 0; x < width; ++x) {
+			T const top(src_reader(top_row[x]));
+			T const mid(src_reader(mid_row[x]));
+			T const bottom(src_reader(bottom_row[x]));
+			vsum[x] = top + mid + mid + bottom;
+			vdiff[x] = bottom - top;
+		}
+
+		if (width == 1) {
+			dst[0] = (vdiff[0] + vdiff[0] + vdiff[0] + vdiff[0]) * dir_y;
+			continue;
+		}
+
+		dst[0] = (vsum[1] - vsum[0]) * dir_x
+			+ (vdiff[0] + vdiff[0] + vdiff[0] + vdiff[1]) * dir_y;
+
+		sobel_impl::combineDirectionalRow(
+			&vsum[0], &vdiff[0], dst, width, dir_x, dir_y
+		);
+
+		dst[width - 1] = (vsum[width - 1] - vsum[width - 2]) * dir_x
+			+ (vdiff[width - 2] + vdiff[width - 1]
+				+ vdiff[width - 1] + vdiff[width - 1]) * dir_y;
+	}
+}
+
+
 template<
 	typename T, typename SrcIt, typename TmpIt, typename DstIt,
 	typename SrcReader, typename TmpWriter, typename TmpReader, typename DstWriter
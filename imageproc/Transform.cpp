@@ -19,6 +19,8 @@
 #include "Transform.h"
 #include "Grayscale.h"
 #include "GrayImage.h"
+#include "AcceleratedOps.h"
+#include "ParallelFor.h"
 #include <QImage>
 #include <QRect>
 #include <QSizeF>
@@ -62,7 +64,19 @@ public:
 	void add(uint8_t const gray_level, unsigned const area) {
 		m_grayLevel += gray_level * area;
 	}
-	
+
+	/**
+	 * Adds a span of pixels sharing the same weight.  Deferring the
+	 * multiplication until after summation lets the sum vectorize.
+	 */
+	void addSpan(uint8_t const* pixels, int num_pixels, unsigned const area) {
+		unsigned sum = 0;
+		for (int i = 0; i < num_pixels; ++i) {
+			sum += pixels[i];
+		}
+		m_grayLevel += sum * area;
+	}
+
 	uint8_t result(unsigned const total_area) const {
 		unsigned const half_area = total_area >> 1;
 		unsigned const res = (m_grayLevel + half_area) / total_area;
@@ -84,7 +98,13 @@ public:
 		rgb >>= 8;
 		m_red += (rgb & 0xFF) * area;
 	}
-	
+
+	void addSpan(uint32_t const* pixels, int num_pixels, unsigned const area) {
+		for (int i = 0; i < num_pixels; ++i) {
+			add(pixels[i], area);
+		}
+	}
+
 	uint32_t result(unsigned const total_area) const {
 		unsigned const half_area = total_area >> 1;
 		uint32_t rgb = 0x0000FF00;
@@ -115,7 +135,13 @@ public:
 		argb >>= 8;
 		m_alpha += argb * area;
 	}
-	
+
+	void addSpan(uint32_t const* pixels, int num_pixels, unsigned const area) {
+		for (int i = 0; i < num_pixels; ++i) {
+			add(pixels[i], area);
+		}
+	}
+
 	uint32_t result(unsigned const total_area) const {
 		unsigned const half_area = total_area >> 1;
 		uint32_t argb = (m_alpha + half_area) / total_area;
@@ -157,33 +183,62 @@ static QSizeF calcSrcUnitSize(QTransform const& xform, QSizeF const& min)
 	);
 }
 
+/**
+ * Applies the inverse mapping to a band of destination rows.
+ * Bands are independent, which is what lets transformGeneric()
+ * process them from multiple threads.
+ */
 template<typename StorageUnit, typename Mixer>
-static void transformGeneric(
-	StorageUnit const* const src_data, int const src_stride, QSize const src_size,
-	StorageUnit* const dst_data, int const dst_stride, QTransform const& xform,
-	QRect const& dst_rect, StorageUnit const outside_color, int const outside_flags,
-	QSizeF const& min_mapping_area)
+class TransformRowsRange
 {
-	int const sw = src_size.width();
-	int const sh = src_size.height();
-	int const dw = dst_rect.width();
-	int const dh = dst_rect.height();
+public:
+	TransformRowsRange(
+		StorageUnit const* src_data, int src_stride, QSize const& src_size,
+		StorageUnit* dst_data, int dst_stride, int dst_width,
+		QTransform const& inv_xform, int src32_unit_w, int src32_unit_h,
+		StorageUnit outside_color, int outside_flags)
+	:	m_pSrcData(src_data), m_srcStride(src_stride),
+		m_srcWidth(src_size.width()), m_srcHeight(src_size.height()),
+		m_pDstData(dst_data), m_dstStride(dst_stride), m_dstWidth(dst_width),
+		m_invXform(inv_xform),
+		m_src32UnitW(src32_unit_w), m_src32UnitH(src32_unit_h),
+		m_outsideColor(outside_color), m_outsideFlags(outside_flags) {}
 
-	StorageUnit* dst_line = dst_data;
-	
-	QTransform inv_xform;
-	inv_xform.translate(dst_rect.x(), dst_rect.y());
-	inv_xform *= xform.inverted();
-	inv_xform *= QTransform().scale(32.0, 32.0);
-	
-	// sx32 = dx*inv_xform.m11() + dy*inv_xform.m21() + inv_xform.dx();
-	// sy32 = dy*inv_xform.m22() + dx*inv_xform.m12() + inv_xform.dy();
-	
-	QSizeF const src32_unit_size(calcSrcUnitSize(inv_xform, min_mapping_area));
-	int const src32_unit_w = std::max<int>(1, qRound(src32_unit_size.width()));
-	int const src32_unit_h = std::max<int>(1, qRound(src32_unit_size.height()));
-	
-	for (int dy = 0; dy < dh; ++dy, dst_line += dst_stride) {
+	void operator()(int begin_dy, int end_dy) const;
+private:
+	StorageUnit const* m_pSrcData;
+	int m_srcStride;
+	int m_srcWidth;
+	int m_srcHeight;
+	StorageUnit* m_pDstData;
+	int m_dstStride;
+	int m_dstWidth;
+	QTransform m_invXform;
+	int m_src32UnitW;
+	int m_src32UnitH;
+	StorageUnit m_outsideColor;
+	int m_outsideFlags;
+};
+
+template<typename StorageUnit, typename Mixer>
+void TransformRowsRange<StorageUnit, Mixer>::operator()(
+	int const begin_dy, int const end_dy) const
+{
+	StorageUnit const* const src_data = m_pSrcData;
+	int const src_stride = m_srcStride;
+	int const sw = m_srcWidth;
+	int const sh = m_srcHeight;
+	int const dw = m_dstWidth;
+	int const dst_stride = m_dstStride;
+	QTransform const& inv_xform = m_invXform;
+	int const src32_unit_w = m_src32UnitW;
+	int const src32_unit_h = m_src32UnitH;
+	StorageUnit const outside_color = m_outsideColor;
+	int const outside_flags = m_outsideFlags;
+
+	StorageUnit* dst_line = m_pDstData + begin_dy * dst_stride;
+
+	for (int dy = begin_dy; dy < end_dy; ++dy, dst_line += dst_stride) {
 		double const f_dy_center = dy + 0.5;
 		double const f_sx32_base = f_dy_center * inv_xform.m21() + inv_xform.dx();
 		double const f_sy32_base = f_dy_center * inv_xform.m22() + inv_xform.dy();
@@ -313,11 +368,7 @@ static void transformGeneric(
 					unsigned const right_area = vert_fraction * right_fraction;
 					
 					mixer.add(src_line[src_left], left_area);
-					
-					for (int sx = src_left + 1; sx < src_right; ++sx) {
-						mixer.add(src_line[sx], middle_area);
-					}
-					
+					mixer.addSpan(src_line + src_left + 1, src_right - src_left - 1, middle_area);
 					mixer.add(src_line[src_right], right_area);
 				}
 			} else if (src_left == src_right) {
@@ -351,38 +402,30 @@ static void transformGeneric(
 				
 				// process the top-left corner
 				mixer.add(src_line[src_left], topleft_area);
-				
+
 				// process the top line (without corners)
-				for (int sx = src_left + 1; sx < src_right; ++sx) {
-					mixer.add(src_line[sx], top_area);
-				}
-				
+				mixer.addSpan(src_line + src_left + 1, src_right - src_left - 1, top_area);
+
 				// process the top-right corner
 				mixer.add(src_line[src_right], topright_area);
-				
+
 				src_line += src_stride;
-				
+
 				// process middle lines
 				for (int sy = src_top + 1; sy < src_bottom; ++sy) {
 					mixer.add(src_line[src_left], left_area);
-					
-					for (int sx = src_left + 1; sx < src_right; ++sx) {
-						mixer.add(src_line[sx], 32*32);
-					}
-					
+					mixer.addSpan(src_line + src_left + 1, src_right - src_left - 1, 32*32);
 					mixer.add(src_line[src_right], right_area);
-					
+
 					src_line += src_stride;
 				}
-				
+
 				// process bottom-left corner
 				mixer.add(src_line[src_left], bottomleft_area);
-				
+
 				// process the bottom line (without corners)
-				for (int sx = src_left + 1; sx < src_right; ++sx) {
-					mixer.add(src_line[sx], bottom_area);
-				}
-				
+				mixer.addSpan(src_line + src_left + 1, src_right - src_left - 1, bottom_area);
+
 				// process the bottom-right corner
 				mixer.add(src_line[src_right], bottomright_area);
 			}
@@ -392,6 +435,34 @@ static void transformGeneric(
 	}
 }
 
+template<typename StorageUnit, typename Mixer>
+static void transformGeneric(
+	StorageUnit const* const src_data, int const src_stride, QSize const src_size,
+	StorageUnit* const dst_data, int const dst_stride, QTransform const& xform,
+	QRect const& dst_rect, StorageUnit const outside_color, int const outside_flags,
+	QSizeF const& min_mapping_area)
+{
+	QTransform inv_xform;
+	inv_xform.translate(dst_rect.x(), dst_rect.y());
+	inv_xform *= xform.inverted();
+	inv_xform *= QTransform().scale(32.0, 32.0);
+
+	// sx32 = dx*inv_xform.m11() + dy*inv_xform.m21() + inv_xform.dx();
+	// sy32 = dy*inv_xform.m22() + dx*inv_xform.m12() + inv_xform.dy();
+
+	QSizeF const src32_unit_size(calcSrcUnitSize(inv_xform, min_mapping_area));
+	int const src32_unit_w = std::max<int>(1, qRound(src32_unit_size.width()));
+	int const src32_unit_h = std::max<int>(1, qRound(src32_unit_size.height()));
+
+	parallelForRanges(
+		0, dst_rect.height(), TransformRowsRange<StorageUnit, Mixer>(
+			src_data, src_stride, src_size, dst_data, dst_stride,
+			dst_rect.width(), inv_xform, src32_unit_w, src32_unit_h,
+			outside_color, outside_flags
+		)
+	);
+}
+
 } // anonymous namespace
 
 QImage transform(
@@ -410,7 +481,15 @@ QImage transform(
 	if (!dst_rect.isValid()) {
 		throw std::invalid_argument("transform: dst_rect is invalid");
 	}
-	
+
+	if (AcceleratedOps* const accel = acceleratedOps()) {
+		QImage accel_dst;
+		if (accel->transform(src, xform, dst_rect, outside_pixels,
+				min_mapping_area, accel_dst)) {
+			return accel_dst;
+		}
+	}
+
 	if (src.format() == QImage::Format_Indexed8 && src.allGray()) {
 		// The palette of src may be non-standard, so we create a GrayImage,
 		// which is guaranteed to have a standard palette.
@@ -0,0 +1,291 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * \file
+ * \brief Timing harness for the imageproc kernels on the hot path.
+ *
+ * Usage:
+ * \code
+ * imageproc_bench [filter ...]
+ * \endcode
+ * Without arguments, every kernel is timed at every page size.
+ * Arguments are substrings matched against "kernel size" labels,
+ * e.g. "sauvola", "a4-300" or "gauss-blur a3-600".
+ *
+ * Each kernel runs repeatedly on the same input until a fixed time
+ * budget is spent; the fastest iteration is reported, in ns per
+ * source pixel and in megapixels per second.  Results are meant to
+ * be compared between two builds on the same machine - they are not
+ * stable across machines.
+ */
+
+#include "BinaryImage.h"
+#include "BinaryThreshold.h"
+#include "GrayImage.h"
+#include "RasterOp.h"
+#include "Binarize.h"
+#include "GaussBlur.h"
+#include "Scale.h"
+#include "Transform.h"
+#include "SEDM.h"
+#include "SeedFill.h"
+#include "Connectivity.h"
+#include <QImage>
+#include <QSize>
+#include <QRect>
+#include <QTime>
+#include <QTransform>
+#include <QString>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace imageproc;
+
+namespace
+{
+
+/** Milliseconds to spend per kernel x size combination. */
+int const TIME_BUDGET_MS = 1000;
+
+int const MAX_ITERATIONS = 50;
+
+struct PageSize
+{
+	char const* label;
+	int width;
+	int height;
+};
+
+/**
+ * A4 and A3 at the scanning resolutions we care about.
+ */
+PageSize const PAGE_SIZES[] = {
+	{ "a4-300", 2480, 3508 },
+	{ "a3-300", 3508, 4960 },
+	{ "a4-600", 4960, 7016 },
+	{ "a3-600", 7016, 9920 }
+};
+
+int const NUM_PAGE_SIZES = sizeof(PAGE_SIZES) / sizeof(PAGE_SIZES[0]);
+
+/**
+ * \brief A deterministic stand-in for a scanned text page.
+ *
+ * Lines of text with ragged dark runs over a noisy light background,
+ * at roughly 10% ink coverage.  Real pages matter here: kernels like
+ * seedFill and the RLE paths in morphology are data dependent, and
+ * uniform noise would give them wildly unrepresentative run lengths.
+ */
+GrayImage syntheticPage(QSize const& size)
+{
+	GrayImage img(size);
+
+	int const w = size.width();
+	int const h = size.height();
+	int const line_pitch = size.height() / 80; // ~80 lines of text.
+	int const glyph_height = line_pitch * 2 / 3;
+
+	uint32_t rng = 0x12345678;
+
+	unsigned char* line = img.data();
+	for (int y = 0; y < h; ++y, line += img.stride()) {
+		bool const text_row = (y % line_pitch) < glyph_height;
+		int const shift = 13 * (y / line_pitch);
+		for (int x = 0; x < w; ++x) {
+			// Cheap LCG noise, advanced per pixel.
+			rng = rng * 1664525 + 1013904223;
+			int const noise = (rng >> 24) & 31;
+
+			bool ink = false;
+			if (text_row) {
+				// Dark runs a few pixels long with
+				// gaps, drifting from line to line.
+				ink = ((x + shift) % 41) < 14 && x % 9 != 0;
+			}
+			line[x] = ink ? 40 + noise : 200 + noise;
+		}
+	}
+
+	return img;
+}
+
+typedef void (*BenchFunc)(GrayImage const& page);
+
+struct Benchmark
+{
+	char const* name;
+	BenchFunc func;
+};
+
+
+void benchRasterOpXor(GrayImage const& page)
+{
+	BinaryImage const src(page.toQImage(), BinaryThreshold(128));
+	BinaryImage dst(page.size(), WHITE);
+	rasterOp<RopXor<RopSrc, RopDst> >(dst, src);
+}
+
+void benchBinarizeSauvola(GrayImage const& page)
+{
+	// The window size the output stage uses.
+	binarizeSauvola(page.toQImage(), QSize(200, 200));
+}
+
+void benchBinarizeWolf(GrayImage const& page)
+{
+	binarizeWolf(page.toQImage(), QSize(200, 200));
+}
+
+void benchGaussBlur(GrayImage const& page)
+{
+	gaussBlur(page, 5.0f, 5.0f);
+}
+
+void benchScaleToGray(GrayImage const& page)
+{
+	// Downscaling dominates in practice (thumbnails, previews,
+	// estimating backgrounds on downscaled images).
+	scaleToGray(page, page.size() / 4);
+}
+
+void benchTransformToGray(GrayImage const& page)
+{
+	// A small rotation, as deskewing would apply.
+	QTransform xform;
+	xform.translate(page.width() / 2, page.height() / 2);
+	xform.rotate(2.0);
+	xform.translate(-page.width() / 2, -page.height() / 2);
+	transformToGray(
+		page.toQImage(), xform, page.rect(),
+		OutsidePixels::assumeColor(Qt::white)
+	);
+}
+
+void benchSEDM(GrayImage const& page)
+{
+	BinaryImage const img(page.toQImage(), BinaryThreshold(128));
+	SEDM const sedm(img);
+}
+
+void benchSeedFill(GrayImage const& page)
+{
+	BinaryImage const mask(page.toQImage(), BinaryThreshold(128));
+
+	// A seed touching roughly every other line of text, as a
+	// despeckle-like "keep what's connected to this" pass would use.
+	BinaryImage seed(page.size(), WHITE);
+	int const stripe_pitch = page.height() / 40;
+	for (int y = 0; y < page.height(); y += stripe_pitch) {
+		seed.fill(QRect(0, y, page.width(), 1), BLACK);
+	}
+	rasterOp<RopAnd<RopSrc, RopDst> >(seed, mask);
+
+	seedFill(seed, mask, CONN8);
+}
+
+Benchmark const BENCHMARKS[] = {
+	{ "raster-op-xor", &benchRasterOpXor },
+	{ "binarize-sauvola", &benchBinarizeSauvola },
+	{ "binarize-wolf", &benchBinarizeWolf },
+	{ "gauss-blur", &benchGaussBlur },
+	{ "scale-to-gray", &benchScaleToGray },
+	{ "transform-to-gray", &benchTransformToGray },
+	{ "sedm", &benchSEDM },
+	{ "seed-fill", &benchSeedFill }
+};
+
+int const NUM_BENCHMARKS = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+bool matchesFilters(char const* label, int argc, char** argv)
+{
+	if (argc <= 1) {
+		return true;
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		if (strstr(label, argv[i])) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void runBenchmark(Benchmark const& bench, PageSize const& page_size)
+{
+	GrayImage const page(
+		syntheticPage(QSize(page_size.width, page_size.height))
+	);
+	double const megapixels = double(page_size.width)
+		* double(page_size.height) / 1e6;
+
+	// One untimed run to page in the code and let the allocator
+	// warm up its free lists.
+	bench.func(page);
+
+	int best_ms = -1;
+	int total_ms = 0;
+	int iterations = 0;
+	do {
+		QTime timer;
+		timer.start();
+		bench.func(page);
+		int const elapsed_ms = timer.elapsed();
+
+		if (best_ms < 0 || elapsed_ms < best_ms) {
+			best_ms = elapsed_ms;
+		}
+		total_ms += elapsed_ms;
+		++iterations;
+	} while (total_ms < TIME_BUDGET_MS && iterations < MAX_ITERATIONS);
+
+	double const ns_per_pixel = double(best_ms) * 1e6
+		/ (megapixels * 1e6);
+	double const mpix_per_sec = (best_ms > 0)
+		? megapixels * 1000.0 / best_ms : 0.0;
+
+	printf(
+		"%-18s %-7s %6.1f MPix %4d iter %8.2f ns/pix %9.1f MPix/s\n",
+		bench.name, page_size.label, megapixels, iterations,
+		ns_per_pixel, mpix_per_sec
+	);
+	fflush(stdout);
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char** argv)
+{
+	for (int b = 0; b < NUM_BENCHMARKS; ++b) {
+		for (int s = 0; s < NUM_PAGE_SIZES; ++s) {
+			QString const label(
+				QString("%1 %2").arg(BENCHMARKS[b].name)
+				.arg(PAGE_SIZES[s].label)
+			);
+			if (!matchesFilters(label.toAscii().constData(), argc, argv)) {
+				continue;
+			}
+			runBenchmark(BENCHMARKS[b], PAGE_SIZES[s]);
+		}
+	}
+
+	return 0;
+}
@@ -35,6 +35,23 @@ namespace tests
 
 using namespace utils;
 
+namespace
+{
+
+class SmallCompPredicate
+{
+public:
+	SmallCompPredicate(int max_pixels) : m_maxPixels(max_pixels) {}
+
+	bool operator()(ConnComp const& cc) const {
+		return cc.pixCount() <= m_maxPixels;
+	}
+private:
+	int m_maxPixels;
+};
+
+} // anonymous namespace
+
 BOOST_AUTO_TEST_SUITE(ConnCompEraserTestSuite);
 
 BOOST_AUTO_TEST_CASE(test_null_image)
@@ -98,6 +115,45 @@ BOOST_AUTO_TEST_CASE(test_small_image)
 	BOOST_CHECK_MESSAGE(c8r.empty(), "Not all 8-connected blocks were found.");
 }
 
+BOOST_AUTO_TEST_CASE(test_erase_if)
+{
+	static int const inp[] = {
+		0, 0, 1, 1, 0, 0, 0, 0, 0,
+		0, 0, 0, 1, 0, 0, 0, 0, 0,
+		0, 0, 0, 1, 0, 1, 1, 1, 1,
+		1, 1, 0, 1, 1, 0, 1, 0, 0,
+		0, 0, 1, 1, 0, 0, 1, 1, 0,
+		0, 1, 0, 1, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 1, 0, 1, 0,
+		1, 1, 1, 1, 1, 1, 1, 0, 0
+	};
+
+	// What's expected to remain after erasing 4-connected
+	// components of up to 2 pixels.
+	static int const out[] = {
+		0, 0, 1, 1, 0, 0, 0, 0, 0,
+		0, 0, 0, 1, 0, 0, 0, 0, 0,
+		0, 0, 0, 1, 0, 1, 1, 1, 1,
+		0, 0, 0, 1, 1, 0, 1, 0, 0,
+		0, 0, 1, 1, 0, 0, 1, 1, 0,
+		0, 0, 0, 1, 0, 0, 0, 0, 0,
+		0, 0, 0, 0, 0, 1, 0, 0, 0,
+		1, 1, 1, 1, 1, 1, 1, 0, 0
+	};
+
+	BinaryImage null_img;
+	ConnCompEraser::eraseIf(null_img, CONN4, SmallCompPredicate(1));
+	BOOST_CHECK(null_img.isNull());
+
+	BinaryImage img(makeBinaryImage(inp, 9, 8));
+	ConnCompEraser::eraseIf(img, CONN4, SmallCompPredicate(2));
+	BOOST_CHECK(img == makeBinaryImage(out, 9, 8));
+
+	BinaryImage img2(makeBinaryImage(inp, 9, 8));
+	ConnCompEraser::eraseIf(img2, CONN8, SmallCompPredicate(9 * 8));
+	BOOST_CHECK(img2 == BinaryImage(img2.size(), WHITE));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
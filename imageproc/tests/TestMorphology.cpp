@@ -27,6 +27,8 @@
 #ifndef Q_MOC_RUN
 #include <boost/test/auto_unit_test.hpp>
 #endif
+#include <vector>
+#include <stdlib.h>
 
 namespace imageproc
 {
@@ -1329,6 +1331,49 @@ BOOST_AUTO_TEST_CASE(test_hmr_1)
 	BOOST_CHECK(hitMissReplace(img, BLACK, pattern, 3, 3) == control);
 }
 
+BOOST_AUTO_TEST_CASE(test_hmr_batch_random)
+{
+	// The batch hitMissReplaceInPlace() matches patterns with a fused
+	// word-at-a-time kernel instead of the rasterOp sequence behind
+	// hitMissMatch().  With a single pattern the two overloads must
+	// produce identical results, so random images and patterns compare
+	// the fused kernel against the reference implementation.  Pattern
+	// widths beyond 32 exercise the multi-word sampling windows.
+	static char const chars[] = "X ?-+";
+
+	for (int iter = 0; iter < 30; ++iter) {
+		int const width = 50 + rand() % 30;
+		int const height = 40 + rand() % 20;
+		std::vector<int> inp(width * height);
+		for (size_t i = 0; i < inp.size(); ++i) {
+			inp[i] = rand() & 1;
+		}
+		BinaryImage const img(makeBinaryImage(&inp[0], width, height));
+
+		int const pat_w = 1 + rand() % 40;
+		int const pat_h = 1 + rand() % 5;
+		std::vector<char> pattern(pat_w * pat_h);
+		for (size_t i = 0; i < pattern.size(); ++i) {
+			pattern[i] = chars[rand() % 5];
+		}
+		// Make sure the pattern requests at least one replacement,
+		// otherwise both overloads are no-ops.
+		pattern[rand() % pattern.size()] = (rand() & 1) ? '-' : '+';
+
+		BWColor const surroundings = (rand() & 1) ? BLACK : WHITE;
+
+		BinaryImage control(img);
+		hitMissReplaceInPlace(control, surroundings, &pattern[0], pat_w, pat_h);
+
+		BinaryImage batch(img);
+		std::vector<HitMissPattern> patterns;
+		patterns.push_back(HitMissPattern(&pattern[0], pat_w, pat_h));
+		hitMissReplaceInPlace(batch, surroundings, patterns);
+
+		BOOST_REQUIRE(batch == control);
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
@@ -24,6 +24,8 @@
 #ifndef Q_MOC_RUN
 #include <boost/test/auto_unit_test.hpp>
 #endif
+#include <vector>
+#include <stdlib.h>
 
 namespace imageproc
 {
@@ -177,6 +179,51 @@ BOOST_AUTO_TEST_CASE(test_sub_image)
 	BOOST_REQUIRE(orthogonalRotation(img, rect, -90) == out4_img);
 }
 
+BOOST_AUTO_TEST_CASE(test_large_image)
+{
+	// Large enough to exercise the word-level block kernels, with
+	// dimensions and a sub-rectangle that aren't multiples of 32,
+	// so the per-pixel fringes and unaligned windows get hit too.
+	int const width = 205;
+	int const height = 157;
+	std::vector<int> inp(width * height);
+	for (size_t i = 0; i < inp.size(); ++i) {
+		inp[i] = rand() & 1;
+	}
+	BinaryImage const img(makeBinaryImage(&inp[0], width, height));
+
+	QRect const rect(37, 11, 131, 101);
+	int const left = rect.left();
+	int const top = rect.top();
+	int const right = rect.right();
+	int const bottom = rect.bottom();
+
+	std::vector<int> out1(rect.height() * rect.width()); // 90 degrees
+	std::vector<int> out2(rect.width() * rect.height()); // 180 degrees
+	std::vector<int> out3(rect.height() * rect.width()); // 270 degrees
+	for (int y = 0; y < rect.height(); ++y) {
+		for (int x = 0; x < rect.width(); ++x) {
+			int const pixel = inp[y * width + x + top * width + left];
+			// (x, y) in src_rect coordinates lands at:
+			out1[x * rect.height() + (rect.height() - 1 - y)] = pixel;
+			out2[(rect.height() - 1 - y) * rect.width() + (rect.width() - 1 - x)] = pixel;
+			out3[(rect.width() - 1 - x) * rect.height() + y] = pixel;
+		}
+	}
+
+	BinaryImage const out1_img(makeBinaryImage(&out1[0], rect.height(), rect.width()));
+	BinaryImage const out2_img(makeBinaryImage(&out2[0], rect.width(), rect.height()));
+	BinaryImage const out3_img(makeBinaryImage(&out3[0], rect.height(), rect.width()));
+
+	BOOST_REQUIRE(orthogonalRotation(img, rect, 90) == out1_img);
+	BOOST_REQUIRE(orthogonalRotation(img, rect, 180) == out2_img);
+	BOOST_REQUIRE(orthogonalRotation(img, rect, 270) == out3_img);
+
+	BOOST_REQUIRE(
+		orthogonalRotation(orthogonalRotation(img, 90), 270) == img
+	);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
@@ -31,6 +31,7 @@
 #include <QBrush>
 #include <QColor>
 #include <Qt>
+#include <vector>
 #include <math.h>
 #ifndef Q_MOC_RUN
 #include <boost/test/auto_unit_test.hpp>
@@ -168,6 +169,31 @@ BOOST_AUTO_TEST_CASE(test_corner_cases)
 	BOOST_CHECK(testFillExceptShape(image_size, shape3, Qt::WindingFill));
 }
 
+BOOST_AUTO_TEST_CASE(test_multi_polygon_fill)
+{
+	QSize const image_size(500, 500);
+
+	// Overlapping shapes of the same orientation.
+	std::vector<QPolygonF> shapes;
+	shapes.push_back(createShape(image_size, 150));
+	shapes.push_back(createShape(image_size, 150));
+	shapes.push_back(createShape(image_size, 100));
+	shapes[0].translate(-100.0, -100.0);
+	shapes[1].translate(100.0, 100.0);
+
+	// A single-sweep fill must produce exactly what filling
+	// the polygons one by one produces.
+	BinaryImage seq_image(image_size, WHITE);
+	for (size_t i = 0; i < shapes.size(); ++i) {
+		PolygonRasterizer::fill(seq_image, BLACK, shapes[i], Qt::WindingFill);
+	}
+
+	BinaryImage batch_image(image_size, WHITE);
+	PolygonRasterizer::fill(batch_image, BLACK, shapes, Qt::WindingFill);
+
+	BOOST_CHECK(batch_image == seq_image);
+}
+
 BOOST_AUTO_TEST_CASE(regression_test_1)
 {
 	QPolygonF shape;
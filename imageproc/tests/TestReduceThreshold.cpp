@@ -120,6 +120,26 @@ BOOST_AUTO_TEST_CASE(test_lines)
 	BOOST_CHECK(makeBinaryImage(out4, 1, 4) == ReduceThreshold(img)(4));
 }
 
+BOOST_AUTO_TEST_CASE(test_pyramid)
+{
+	// Odd dimensions, to exercise the left-over rows and columns.
+	BinaryImage const img(randomBinaryImage(101, 437));
+
+	std::vector<int> thresholds;
+	thresholds.push_back(1);
+	thresholds.push_back(2);
+	thresholds.push_back(3);
+
+	std::vector<BinaryImage> const levels(reducePyramid(img, thresholds));
+
+	ReduceThreshold reductor(img);
+	BOOST_REQUIRE(levels.size() == thresholds.size());
+	for (size_t i = 0; i < thresholds.size(); ++i) {
+		reductor.reduce(thresholds[i]);
+		BOOST_CHECK(levels[i] == reductor.image());
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
@@ -20,6 +20,8 @@
 #include "BinaryImage.h"
 #include "Utils.h"
 #include <QImage>
+#include <QRect>
+#include <vector>
 #include <stdexcept>
 #include <stddef.h>
 #ifndef Q_MOC_RUN
@@ -114,6 +116,45 @@ BOOST_AUTO_TEST_CASE(test_small_image)
 	BOOST_CHECK(checkHistogram(ver_hist, ver_counts + 1, ver_counts + 9));
 }
 
+BOOST_AUTO_TEST_CASE(test_multi_word_image)
+{
+	// Wide enough to span several words and tall enough to cross
+	// the internal counter flush boundary of the COLS code path.
+	int const width = 75;
+	int const height = 300;
+
+	std::vector<int> inp(width * height);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			inp[y * width + x] = (x * 7 + y * 13) % 11 < 3 ? 1 : 0;
+		}
+	}
+
+	BinaryImage const img(makeBinaryImage(&inp[0], width, height));
+
+	QRect const area(17, 3, 49, 290); // Unaligned on both sides.
+
+	std::vector<int> hor_counts(area.height(), 0);
+	std::vector<int> ver_counts(area.width(), 0);
+	for (int y = 0; y < area.height(); ++y) {
+		for (int x = 0; x < area.width(); ++x) {
+			int const pixel = inp[(area.top() + y) * width + area.left() + x];
+			hor_counts[y] += pixel;
+			ver_counts[x] += pixel;
+		}
+	}
+
+	SlicedHistogram const hor_hist(img, area, SlicedHistogram::ROWS);
+	BOOST_CHECK(
+		checkHistogram(hor_hist, &hor_counts[0], &hor_counts[0] + hor_counts.size())
+	);
+
+	SlicedHistogram const ver_hist(img, area, SlicedHistogram::COLS);
+	BOOST_CHECK(
+		checkHistogram(ver_hist, &ver_counts[0], &ver_counts[0] + ver_counts.size())
+	);
+}
+
 BOOST_AUTO_TEST_SUITE_END();
 
 } // namespace tests
@@ -20,10 +20,148 @@
 #include <QCoreApplication>
 #include <QString>
 #include <QStringList>
+#include <QFile>
+#include <QTime>
 #include <iostream>
 
 #include "CommandLine.h"
 #include "ConsoleBatch.h"
+#include "WatchFolderDaemon.h"
+#include "WorkerTopology.h"
+#include "imageproc/ParallelFor.h"
+#include "GoldenManifest.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "ProcessStats.h"
+#include <map>
+#include <string>
+
+namespace
+{
+
+std::auto_ptr<ConsoleBatch> createBatch(CommandLine const& cli)
+{
+	std::auto_ptr<ConsoleBatch> cbatch;
+	if (!cli.projectFile().isEmpty()) {
+		cbatch.reset(new ConsoleBatch(cli.projectFile()));
+	} else {
+		cbatch.reset(
+			new ConsoleBatch(
+				cli.images(), cli.outputDirectory(),
+				cli.getLayoutDirection()
+			)
+		);
+	}
+	return cbatch;
+}
+
+QString formatMB(qint64 const bytes)
+{
+	if (bytes < 0) {
+		return "n/a";
+	}
+	return QString("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
+
+/**
+ * Captures the just-finished run - output hashes plus the profiler's
+ * per-bucket timings - into a manifest, for --golden-record / -check.
+ */
+GoldenManifest captureRun(ConsoleBatch const& cbatch)
+{
+	GoldenManifest manifest;
+
+	typedef std::map<std::string, double> PathTotals;
+	PathTotals const totals(Profiler::instance().totalSecondsByPath());
+	for (PathTotals::const_iterator it(totals.begin()); it != totals.end(); ++it) {
+		manifest.addStage(QString::fromStdString(it->first), it->second);
+	}
+
+	std::vector<QString> const files(cbatch.outputFilePaths());
+	for (size_t i = 0; i < files.size(); ++i) {
+		manifest.addFile(files[i]);
+	}
+
+	return manifest;
+}
+
+/**
+ * Processes the project \p num_runs times, reporting throughput,
+ * per-stage latency distributions and resource usage for each run.
+ *
+ * The OS page cache is deliberately left alone: run 1 is as cold as
+ * the caller made it (see --help), later runs measure the warm case.
+ * Peak RSS is cumulative over the whole process, so it's only
+ * reported once at the end.
+ */
+int runBenchmark(CommandLine const& cli, int const num_runs)
+{
+	Profiler::instance().startTrace();
+
+	for (int run = 1; run <= num_runs; ++run) {
+		qint64 const read_before = processDiskReadBytes();
+		qint64 const written_before = processDiskWriteBytes();
+
+		int pages = 0;
+		QTime timer;
+		timer.start();
+		try {
+			std::auto_ptr<ConsoleBatch> cbatch(createBatch(cli));
+			pages = cbatch->numPages();
+			cbatch->process();
+		} catch (std::exception const& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+		double const seconds = timer.elapsed() / 1000.0;
+
+		qint64 const read_after = processDiskReadBytes();
+		qint64 const written_after = processDiskWriteBytes();
+
+		std::cout << "benchmark run " << run << "/" << num_runs
+			<< (run == 1 ? " (cold)" : " (warm)")
+			<< ": " << pages << " page(s) in "
+			<< QString::number(seconds, 'f', 1).toAscii().constData()
+			<< "s = "
+			<< QString::number(
+				seconds > 0 ? pages * 60.0 / seconds : 0.0, 'f', 1
+			).toAscii().constData()
+			<< " pages/min, disk read "
+			<< formatMB(read_after < 0 ? -1 : read_after - read_before)
+				.toAscii().constData()
+			<< ", disk written "
+			<< formatMB(written_after < 0 ? -1 : written_after - written_before)
+				.toAscii().constData()
+			<< "\n";
+
+		QString const latencies(Profiler::instance().latencyReport());
+		if (!latencies.isEmpty()) {
+			std::cout << latencies.toAscii().constData();
+		}
+		QString const memory(MemoryTracker::instance().report());
+		if (!memory.isEmpty()) {
+			std::cout << memory.toAscii().constData();
+		}
+		std::cout.flush();
+
+		// Start the next run with a clean slate.
+		Profiler::instance().reset();
+		MemoryTracker::instance().reset();
+	}
+
+	// The kernel's watermark is reset per stage, so combine it with
+	// the per-stage maxima the tracker retained.
+	qint64 peak_rss = processPeakRssBytes();
+	if (MemoryTracker::instance().maxRssBytes() > peak_rss) {
+		peak_rss = MemoryTracker::instance().maxRssBytes();
+	}
+	std::cout << "peak RSS "
+		<< formatMB(peak_rss).toAscii().constData() << "\n";
+
+	return 0;
+}
+
+} // anonymous namespace
 
 
 int main(int argc, char **argv)
@@ -39,25 +177,107 @@ int main(int argc, char **argv)
 	CommandLine cli(app.arguments(), false);
 	CommandLine::set(cli);
 
+	WorkerTopology::instance().configure(cli.getWorkerAffinity());
+
+	if (cli.hasDeterministic()) {
+		// Per-page outputs only depend on that page's pixels and
+		// settings, so page-level parallelism is reproducible by
+		// construction.  Intra-image parallel loops honor the
+		// determinism contract in ParallelFor.h as well, but running
+		// them serially makes bit-identity to a serial reference run
+		// structural rather than a per-algorithm promise.
+		imageproc::setMaxParallelWorkers(1);
+	}
+
+	if (cli.hasVerify()) {
+		// Verification works on an existing project and reads the
+		// output directory stored in it, so neither images nor an
+		// output directory are expected on the command line.
+		if (cli.projectFile().isEmpty()) {
+			cli.printHelp();
+			return 1;
+		}
+		try {
+			ConsoleBatch cbatch(cli.projectFile());
+			return cbatch.verify() == 0 ? 0 : 1;
+		} catch(std::exception const& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	if (cli.hasWatchFolder()) {
+		// Watch mode takes the folder to watch from the option and
+		// the output directory from the command line; input images
+		// are discovered at runtime, so none are expected here.
+		if (cli.hasHelp() || cli.outputDirectory().isEmpty()) {
+			cli.printHelp();
+			return 1;
+		}
+		WatchFolderDaemon daemon(
+			cli.getWatchFolder(), cli.outputDirectory(),
+			cli.getWatchPollInterval()
+		);
+		daemon.start();
+		return app.exec();
+	}
+
 	if (cli.hasHelp() || cli.outputDirectory().isEmpty() || (cli.images().size()==0 && cli.projectFile().isEmpty())) {
 		cli.printHelp();
 		return 0;
 	}
 
+	if (cli.hasBenchmark()) {
+		return runBenchmark(cli, cli.getBenchmarkRuns());
+	}
+
+	if (cli.hasTraceFile()) {
+		Profiler::instance().startTrace();
+	}
+
 	std::auto_ptr<ConsoleBatch> cbatch;
 
 	try {
-		if (!cli.projectFile().isEmpty()) {
-			cbatch.reset(new ConsoleBatch(cli.projectFile()));
-		} else {
-			cbatch.reset(new ConsoleBatch(cli.images(), cli.outputDirectory(), cli.getLayoutDirection()));
-		}
+		cbatch = createBatch(cli);
 		cbatch->process();
 	} catch(std::exception const& e) {
 		std::cerr << e.what() << std::endl;
 		exit(1);
 	}
 
+	if (cli.hasTraceFile()) {
+		if (!Profiler::instance().writeTrace(cli.getTraceFile())) {
+			std::cerr << "Failed to write "
+				<< cli.getTraceFile().toAscii().constData() << std::endl;
+		}
+	}
+
+	if (cli.hasGoldenRecord()) {
+		GoldenManifest const manifest(captureRun(*cbatch));
+		if (!manifest.save(cli.getGoldenRecordFile())) {
+			std::cerr << "Failed to write "
+				<< cli.getGoldenRecordFile().toAscii().constData()
+				<< std::endl;
+			return 1;
+		}
+	} else if (cli.hasGoldenCheck()) {
+		GoldenManifest golden;
+		if (!golden.load(cli.getGoldenCheckFile())) {
+			std::cerr << "Failed to read "
+				<< cli.getGoldenCheckFile().toAscii().constData()
+				<< std::endl;
+			return 1;
+		}
+
+		int const problems = golden.check(
+			captureRun(*cbatch), cli.getGoldenTolerance()
+		);
+		std::cout << "golden check: " << problems << " problem(s) found\n";
+		if (problems > 0) {
+			return 1;
+		}
+	}
+
 	if (cli.hasOutputProject())
 		cbatch->saveProject(cli.outputProjectFile());
 }
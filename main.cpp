@@ -34,6 +34,10 @@
 #include <string.h>
 
 #include "CommandLine.h"
+#include "CrashContext.h"
+#include "SharedMemoryPublisher.h"
+#include "WorkerTopology.h"
+#include "imageproc/ImageArena.h"
 
 
 //#ifdef Q_WS_WIN
@@ -73,6 +77,16 @@ static bool getCrashReporterPath(wchar_t* buf, DWORD buflen)
 	return true;
 }
 
+static bool crashFilter(void* context, EXCEPTION_POINTERS* exinfo,
+						MDRawAssertionInfo* assertion)
+{
+	// Dump writing allocates, and our typical crash is OOM-adjacent.
+	// Handing back the block set aside at startup gives the dump
+	// writer heap to work with.
+	CrashContext::releaseEmergencyReserve();
+	return true;
+}
+
 static bool crashCallback(wchar_t const* dump_path,
 						  wchar_t const* id,
 						  void* context, EXCEPTION_POINTERS* exinfo,
@@ -82,7 +96,12 @@ static bool crashCallback(wchar_t const* dump_path,
 	if (!succeeded) {
 		return false;
 	}
-	
+
+	// The batch journal position goes into a sidecar next to the
+	// dump, through a descriptor opened at startup, so we know which
+	// page killed the run even if the crash left no heap to allocate.
+	CrashContext::writeMetadataFile(id);
+
 	static wchar_t command_line[1024] = L"CrashReporter.exe ";
 	wchar_t* p = command_line;
 	p = lstrcatW(p, L"\"");
@@ -133,9 +152,11 @@ int main(int argc, char** argv)
 		sizeof(crash_reporter_path)/sizeof(crash_reporter_path[0])
 	);
 
+	CrashContext::reserve();
+
 	google_breakpad::ExceptionHandler eh(
-		QDir::tempPath().toStdWString().c_str(), 0, &crashCallback,
-		0, google_breakpad::ExceptionHandler::HANDLER_ALL
+		QDir::tempPath().toStdWString().c_str(), &crashFilter,
+		&crashCallback, 0, google_breakpad::ExceptionHandler::HANDLER_ALL
 	);
 #endif
 
@@ -150,36 +171,57 @@ int main(int argc, char** argv)
 	CommandLine cli(app.arguments());
 	CommandLine::set(cli);
 
+	if (cli.hasHugePages()) {
+		imageproc::ImageArena::setHugePagesEnabled(true);
+	}
+
+	if (cli.hasShmExport()) {
+		SharedMemoryPublisher::instance().setKey(cli.getShmExportKey());
+	}
+
 	if (cli.hasHelp()) {
 		cli.printHelp();
 		return 0;
 	}
 	
-	QString const translation("scantailor_"+QLocale::system().name());
+	// English is the source language and has no catalog, so for
+	// English locales the lookup below would just probe the
+	// filesystem three times and fail.  Skip it entirely; it all
+	// happens before the first window can show.
 	QTranslator translator;
-	
-	// Try loading from the current directory.
-	if (!translator.load(translation)) {
-		// Now try loading from where it's supposed to be.
-		QString path(QString::fromUtf8(TRANSLATIONS_DIR_ABS));
-		path += QChar('/');
-		path += translation;
-		if (!translator.load(path)) {
-			path = QString::fromUtf8(TRANSLATIONS_DIR_REL);
+	QString const locale(QLocale::system().name());
+	if (!locale.startsWith(QLatin1String("en"))) {
+		QString const translation("scantailor_" + locale);
+
+		// Try loading from the current directory.
+		if (!translator.load(translation)) {
+			// Now try loading from where it's supposed to be.
+			QString path(QString::fromUtf8(TRANSLATIONS_DIR_ABS));
 			path += QChar('/');
 			path += translation;
-			translator.load(path);
+			if (!translator.load(path)) {
+				path = QString::fromUtf8(TRANSLATIONS_DIR_REL);
+				path += QChar('/');
+				path += translation;
+				translator.load(path);
+			}
 		}
+
+		app.installTranslator(&translator);
 	}
 	
-	app.installTranslator(&translator);
-	
 	// This information is used by QSettings.
 	app.setApplicationName("Scan Tailor");
 	app.setOrganizationName("Scan Tailor");
 	app.setOrganizationDomain("scantailor.sourceforge.net");
 	QSettings settings;
-	
+
+	WorkerTopology::instance().configure(
+		cli.hasWorkerAffinity()
+		? cli.getWorkerAffinity()
+		: settings.value("settings/worker_affinity").toString()
+	);
+
 	PngMetadataLoader::registerMyself();
 	TiffMetadataLoader::registerMyself();
 	JpegMetadataLoader::registerMyself();
@@ -35,7 +35,11 @@ ArcLengthMapper::Hint::update(int new_segment)
 }
 	
 ArcLengthMapper::ArcLengthMapper()
-:	m_prevFX()
+:	m_prevFX(),
+	m_lutArcLen0(),
+	m_lutArcLenStep(),
+	m_lutX0(),
+	m_lutXStep()
 {
 }
 
@@ -53,6 +57,10 @@ ArcLengthMapper::addSample(double x, double fx)
 
 	m_samples.push_back(Sample(x, arc_len));
 	m_prevFX = fx;
+
+	// The tables no longer cover the full range of samples.
+	m_arcLenToSegmentLut.clear();
+	m_xToSegmentLut.clear();
 }
 
 double
@@ -75,6 +83,55 @@ ArcLengthMapper::normalizeRange(double total_arc_len)
 	BOOST_FOREACH(Sample& sample, m_samples) {
 		sample.arcLen *= scale;
 	}
+
+	// Uniform scaling doesn't move arc lengths across segment
+	// boundaries, so rescaling the grid keeps the table valid.
+	m_lutArcLen0 *= scale;
+	m_lutArcLenStep *= scale;
+}
+
+void
+ArcLengthMapper::buildInverseLut()
+{
+	m_arcLenToSegmentLut.clear();
+	m_xToSegmentLut.clear();
+
+	if (m_samples.size() < 2) {
+		return;
+	}
+
+	// A few cells per segment keeps the forward walk in the
+	// lookup functions short even for unevenly sized segments.
+	int const num_segments = m_samples.size() - 1;
+	int const lut_size = num_segments * 4;
+
+	m_lutArcLen0 = m_samples.front().arcLen;
+	m_lutArcLenStep = (m_samples.back().arcLen - m_lutArcLen0) / lut_size;
+	m_lutX0 = m_samples.front().x;
+	m_lutXStep = (m_samples.back().x - m_lutX0) / lut_size;
+
+	// lut[cell] is the segment containing the left edge of the cell.
+	// Both x and arcLen increase monotonously with the sample index,
+	// so a single forward pass assigns every cell.
+	m_arcLenToSegmentLut.resize(lut_size, num_segments - 1);
+	int segment = 0;
+	for (int cell = 0; cell < lut_size; ++cell) {
+		double const arc_len = m_lutArcLen0 + cell * m_lutArcLenStep;
+		while (segment < num_segments - 1 && m_samples[segment + 1].arcLen < arc_len) {
+			++segment;
+		}
+		m_arcLenToSegmentLut[cell] = segment;
+	}
+
+	m_xToSegmentLut.resize(lut_size, num_segments - 1);
+	segment = 0;
+	for (int cell = 0; cell < lut_size; ++cell) {
+		double const x = m_lutX0 + cell * m_lutXStep;
+		while (segment < num_segments - 1 && m_samples[segment + 1].x < x) {
+			++segment;
+		}
+		m_xToSegmentLut[cell] = segment;
+	}
 }
 
 double
@@ -183,6 +240,74 @@ ArcLengthMapper::xToArcLen(double x, Hint& hint) const
 	return interpolateXInSegment(x, left_idx);
 }
 
+double
+ArcLengthMapper::arcLenToX(double arc_len) const
+{
+	if (m_arcLenToSegmentLut.empty()) {
+		// Tables not built or fewer than 2 samples.
+		Hint hint;
+		return arcLenToX(arc_len, hint);
+	}
+
+	int const num_segments = m_samples.size() - 1;
+
+	if (arc_len < m_samples.front().arcLen) {
+		// Beyond the first sample.
+		return interpolateArcLenInSegment(arc_len, 0);
+	} else if (arc_len > m_samples.back().arcLen) {
+		// Beyond the last sample.
+		return interpolateArcLenInSegment(arc_len, num_segments - 1);
+	}
+
+	int cell = int((arc_len - m_lutArcLen0) / m_lutArcLenStep);
+	if (cell < 0) {
+		cell = 0;
+	} else if (cell >= int(m_arcLenToSegmentLut.size())) {
+		cell = m_arcLenToSegmentLut.size() - 1;
+	}
+
+	int segment = m_arcLenToSegmentLut[cell];
+	while (segment < num_segments - 1 && m_samples[segment + 1].arcLen < arc_len) {
+		++segment;
+	}
+
+	return interpolateArcLenInSegment(arc_len, segment);
+}
+
+double
+ArcLengthMapper::xToArcLen(double x) const
+{
+	if (m_xToSegmentLut.empty()) {
+		// Tables not built or fewer than 2 samples.
+		Hint hint;
+		return xToArcLen(x, hint);
+	}
+
+	int const num_segments = m_samples.size() - 1;
+
+	if (x < m_samples.front().x) {
+		// Beyond the first sample.
+		return interpolateXInSegment(x, 0);
+	} else if (x > m_samples.back().x) {
+		// Beyond the last sample.
+		return interpolateXInSegment(x, num_segments - 1);
+	}
+
+	int cell = int((x - m_lutX0) / m_lutXStep);
+	if (cell < 0) {
+		cell = 0;
+	} else if (cell >= int(m_xToSegmentLut.size())) {
+		cell = m_xToSegmentLut.size() - 1;
+	}
+
+	int segment = m_xToSegmentLut[cell];
+	while (segment < num_segments - 1 && m_samples[segment + 1].x < x) {
+		++segment;
+	}
+
+	return interpolateXInSegment(x, segment);
+}
+
 bool
 ArcLengthMapper::checkSegmentForArcLen(double arc_len, int segment) const
 {
@@ -73,17 +73,39 @@ public:
 	 */
 	void normalizeRange(double total_arc_len);
 
+	/**
+	 * \brief Builds uniform-grid lookup tables for the hint-free
+	 *        mapping functions below.
+	 *
+	 * To be called once all samples have been added.  A subsequent
+	 * normalizeRange() keeps the tables valid; a subsequent
+	 * addSample() invalidates them.
+	 */
+	void buildInverseLut();
+
 	/**
 	 * \brief Maps from arc length to the corresponding function argument.
 	 *
 	 * This works even for arc length beyond the first or last samples.
 	 * When interpolation is impossible, the closest sample is returned.
 	 * If no samples are present, zero is returned.  Providing the same
-	 * hint on consecutive calls to this function improves performance. 
+	 * hint on consecutive calls to this function improves performance.
 	 */
 	double arcLenToX(double arc_len, Hint& hint) const;
 
 	double xToArcLen(double x, Hint& hint) const;
+
+	/**
+	 * \brief Same as above, but O(1) through the tables built by
+	 *        buildInverseLut(), with no hint state.
+	 *
+	 * Being stateless, these are safe to call from multiple threads
+	 * concurrently, which the hint mechanism is not.  Without the
+	 * tables they fall back to a fresh-hint lookup.
+	 */
+	double arcLenToX(double arc_len) const;
+
+	double xToArcLen(double x) const;
 private:
 	struct Sample
 	{
@@ -103,6 +125,18 @@ private:
 
 	std::vector<Sample> m_samples;
 	double m_prevFX;
+
+	/**
+	 * Map a uniform grid cell to the first segment whose range may
+	 * intersect it.  A query lands in its cell directly and then
+	 * walks forward at most a couple of segments.
+	 */
+	std::vector<int> m_arcLenToSegmentLut;
+	std::vector<int> m_xToSegmentLut;
+	double m_lutArcLen0;
+	double m_lutArcLenStep;
+	double m_lutX0;
+	double m_lutXStep;
 };
 
 #endif
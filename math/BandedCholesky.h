@@ -0,0 +1,157 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BANDED_CHOLESKY_H_
+#define BANDED_CHOLESKY_H_
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
+#include <stddef.h>
+
+/**
+ * \brief Solves Ax = b for symmetric positive definite banded A
+ *        using Cholesky (L * L^T) decomposition.
+ *
+ * The matrix is supplied and factorized in packed band storage:
+ * for a half-bandwidth of w, element (i, j) of the lower triangle
+ * (j <= i <= j + w) lives at index j * (w + 1) + (i - j).  Only
+ * the lower band is stored, as the matrix is symmetric.
+ *
+ * Factorization costs O(n * w^2) and each solve O(n * w), compared
+ * to O(n^3) and O(n^2) for the dense LU machinery, so for matrices
+ * with a narrow band this is the way to go.  Factorization and
+ * solving are separate steps, so one factorization can serve
+ * multiple right hand sides.
+ *
+ * \see LinearSolver
+ */
+class BandedCholesky
+{
+	// Member-wise copying is OK.
+public:
+	BandedCholesky(size_t num_rows, size_t half_bandwidth);
+
+	size_t numRows() const { return m_numRows; }
+
+	size_t halfBandwidth() const { return m_halfBandwidth; }
+
+	/** The number of T elements of packed band storage. */
+	size_t packedSize() const { return m_numRows * (m_halfBandwidth + 1); }
+
+	/**
+	 * \brief Factorizes A in place.
+	 *
+	 * \param packed The lower band of A in packed band storage.
+	 *        On return it holds the lower band of L.
+	 *
+	 * \throw std::runtime_error If the matrix is not positive definite.
+	 */
+	template<typename T>
+	void factorizeInPlace(T* packed) const;
+
+	/**
+	 * \brief Solves L * L^T * x = b using a previously computed factor.
+	 *
+	 * \param packed_L The factor computed by factorizeInPlace().
+	 * \param X The solution is written here.  May be the same pointer as B.
+	 * \param B The right hand side.
+	 */
+	template<typename T>
+	void solve(T const* packed_L, T* X, T const* B) const;
+private:
+	size_t m_numRows;
+	size_t m_halfBandwidth;
+};
+
+
+template<typename T>
+void
+BandedCholesky::factorizeInPlace(T* packed) const
+{
+	using namespace std; // To catch different overloads of sqrt()
+
+	T const epsilon(numeric_limits<T>::epsilon());
+
+	size_t const n = m_numRows;
+	size_t const bw = m_halfBandwidth;
+	size_t const stride = bw + 1;
+
+	for (size_t j = 0; j < n; ++j) {
+		T* const p_col_j = packed + j * stride;
+
+		// Diagonal element.
+		T d(p_col_j[0]);
+		size_t const k_begin = j > bw ? j - bw : 0;
+		for (size_t k = k_begin; k < j; ++k) {
+			T const l_jk(packed[k * stride + (j - k)]);
+			d -= l_jk * l_jk;
+		}
+		if (d <= epsilon) {
+			throw std::runtime_error("BandedCholesky: matrix not positive definite");
+		}
+
+		T const l_jj(sqrt(d));
+		p_col_j[0] = l_jj;
+		T const r_l_jj(T(1) / l_jj);
+
+		// The rest of the column.
+		size_t const i_end = std::min(j + bw, n - 1);
+		for (size_t i = j + 1; i <= i_end; ++i) {
+			T s(p_col_j[i - j]);
+			size_t const kk_begin = i > bw ? i - bw : 0;
+			for (size_t k = std::max(kk_begin, k_begin); k < j; ++k) {
+				s -= packed[k * stride + (i - k)] * packed[k * stride + (j - k)];
+			}
+			p_col_j[i - j] = s * r_l_jj;
+		}
+	}
+}
+
+template<typename T>
+void
+BandedCholesky::solve(T const* packed_L, T* X, T const* B) const
+{
+	size_t const n = m_numRows;
+	size_t const bw = m_halfBandwidth;
+	size_t const stride = bw + 1;
+
+	// Forward substitution: L * y = b.  y goes into X.
+	for (size_t i = 0; i < n; ++i) {
+		T right(B[i]);
+		size_t const k_begin = i > bw ? i - bw : 0;
+		for (size_t k = k_begin; k < i; ++k) {
+			right -= packed_L[k * stride + (i - k)] * X[k];
+		}
+		X[i] = right / packed_L[i * stride];
+	}
+
+	// Back substitution: L^T * x = y.
+	for (size_t ii = n; ii > 0; --ii) {
+		size_t const i = ii - 1;
+		T right(X[i]);
+		size_t const k_end = std::min(i + bw, n - 1);
+		for (size_t k = i + 1; k <= k_end; ++k) {
+			right -= packed_L[i * stride + (k - i)] * X[k];
+		}
+		X[i] = right / packed_L[i * stride];
+	}
+}
+
+#endif
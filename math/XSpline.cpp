@@ -23,6 +23,7 @@
 #include "ToLineProjector.h"
 #include "adiff/SparseMap.h"
 #include "adiff/Function.h"
+#include "adiff/FunctionBatch.h"
 #include <QLineF>
 #include <QDebug>
 #ifndef Q_MOC_RUN
@@ -132,6 +133,7 @@ void
 XSpline::appendControlPoint(QPointF const& pos, double tension)
 {
 	m_controlPoints.push_back(ControlPoint(pos, tension));
+	invalidateLinearizationCache();
 }
 
 void
@@ -139,6 +141,7 @@ XSpline::insertControlPoint(int idx, QPointF const& pos, double tension)
 {
 	assert(idx >= 0 || idx <= (int)m_controlPoints.size());
 	m_controlPoints.insert(m_controlPoints.begin() + idx, ControlPoint(pos, tension));
+	invalidateLinearizationCache();
 }
 
 void
@@ -146,6 +149,7 @@ XSpline::eraseControlPoint(int idx)
 {
 	assert(idx >= 0 || idx < (int)m_controlPoints.size());
 	m_controlPoints.erase(m_controlPoints.begin() + idx);
+	invalidateLinearizationCache();
 }
 
 QPointF
@@ -159,6 +163,7 @@ XSpline::moveControlPoint(int idx, QPointF const& pos)
 {
 	assert(idx >= 0 || idx < (int)m_controlPoints.size());
 	m_controlPoints[idx].pos = pos;
+	invalidateLinearizationCacheSpan(idx);
 }
 
 double
@@ -173,6 +178,30 @@ XSpline::setControlPointTension(int idx, double tension)
 {
 	assert(idx >= 0 && idx < (int)m_controlPoints.size());
 	m_controlPoints[idx].tension = tension;
+	invalidateLinearizationCacheSpan(idx);
+}
+
+void
+XSpline::invalidateLinearizationCache()
+{
+	m_segmentPolylines.clear();
+}
+
+void
+XSpline::invalidateLinearizationCacheSpan(int const cp_idx)
+{
+	if (m_segmentPolylines.empty()) {
+		return;
+	}
+
+	// Segment s is a blend of control points [s - 1, s + 2],
+	// so control point cp_idx participates in segments
+	// [cp_idx - 2, cp_idx + 1].
+	int const seg_begin = std::max<int>(0, cp_idx - 2);
+	int const seg_end = std::min<int>(m_segmentPolylines.size(), cp_idx + 2);
+	for (int seg = seg_begin; seg < seg_end; ++seg) {
+		m_segmentPolylines[seg].valid = false;
+	}
 }
 
 QPointF
@@ -602,20 +631,25 @@ XSpline::controlPointsAttractionForce(int seg_begin, int seg_end) const
 
 	Function<2> force(sparse_map);
 	if (seg_begin != seg_end) {
-		Function<2> prev_x(seg_begin * 2, m_controlPoints[seg_begin].pos.x(), sparse_map);
-		Function<2> prev_y(seg_begin * 2 + 1, m_controlPoints[seg_begin].pos.y(), sparse_map);
-
-		for (int i = seg_begin + 1; i <= seg_end; ++i) {
-			Function<2> next_x(i * 2, m_controlPoints[i].pos.x(), sparse_map);
-			Function<2> next_y(i * 2 + 1, m_controlPoints[i].pos.y(), sparse_map);
-
-			Function<2> const dx(next_x - prev_x);
-			Function<2> const dy(next_y - prev_y);
-			force += dx * dx + dy * dy;
-
-			next_x.swap(prev_x);
-			next_y.swap(prev_y);
+		// One sample per segment, evaluated in batch rather than
+		// through scalar Function arithmetic segment by segment.
+		size_t const num_samples = seg_end - seg_begin;
+		FunctionBatch<2> dx(num_samples, sparse_map);
+		FunctionBatch<2> dy(num_samples, sparse_map);
+
+		for (int i = seg_begin; i < seg_end; ++i) {
+			size_t const sample = i - seg_begin;
+			QPointF const prev(m_controlPoints[i].pos);
+			QPointF const next(m_controlPoints[i + 1].pos);
+			dx.addArg(sample, (i + 1) * 2, next.x(), 1.0, sparse_map);
+			dx.addArg(sample, i * 2, prev.x(), -1.0, sparse_map);
+			dy.addArg(sample, (i + 1) * 2 + 1, next.y(), 1.0, sparse_map);
+			dy.addArg(sample, i * 2 + 1, prev.y(), -1.0, sparse_map);
 		}
+
+		FunctionBatch<2> sq(dx * dx);
+		sq += dy * dy;
+		force += sq.sum();
 	}
 
 	QuadraticFunction f(num_control_points * 2);
@@ -765,24 +799,108 @@ XSpline::pointClosestTo(QPointF const to, double accuracy) const
 	return pointClosestTo(to, 0, accuracy);
 }
 
+namespace
+{
+
+struct PolylineSink : public VirtualFunction3<void, QPointF, double, XSpline::SampleFlags>
+{
+	std::vector<QPointF> polyline;
+
+	virtual void operator()(QPointF pt, double, XSpline::SampleFlags) {
+		polyline.push_back(pt);
+	}
+};
+
+} // anonymous namespace
+
 std::vector<QPointF>
 XSpline::toPolyline(SamplingParams const& params, double from_t, double to_t) const
 {
-	struct Sink : public VirtualFunction3<void, QPointF, double, SampleFlags>
-	{
-		std::vector<QPointF> polyline;
-
-		virtual void operator()(QPointF pt, double, SampleFlags) {
-			polyline.push_back(pt);
-		}
-	};
+	if (from_t == 0.0 && to_t == 1.0 && numSegments() > 0) {
+		return assembleCachedPolyline(params);
+	}
 
-	Sink sink;
+	PolylineSink sink;
 	sample(sink, params, from_t, to_t);
 
 	return sink.polyline;
 }
 
+bool
+XSpline::segmentIsFlat(int segment, SamplingParams const& params) const
+{
+	if (params.maxDistBetweenSamples != NumericTraits<double>::max()) {
+		// The caller wants a minimum sample density even on straight spans.
+		return false;
+	}
+
+	// The points contributing to this segment.  See linearCombinationFor().
+	int idxs[4];
+	idxs[0] = std::max<int>(0, segment - 1);
+	idxs[1] = segment;
+	idxs[2] = segment + 1;
+	idxs[3] = std::min<int>(segment + 2, m_controlPoints.size() - 1);
+
+	// Points on a segment are normalized linear combinations of its
+	// control points, so a flat control polygon means a flat segment.
+	// Blend weights may go slightly negative for negative tensions,
+	// hence the extra safety margin in the tolerance.
+	double sq_tolerance = 0.25 * params.maxDistFromSpline;
+	sq_tolerance *= sq_tolerance;
+
+	QLineF const chord(m_controlPoints[idxs[0]].pos, m_controlPoints[idxs[3]].pos);
+	for (int i = 1; i < 3; ++i) {
+		if (sqDistToLine(m_controlPoints[idxs[i]].pos, chord) > sq_tolerance) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::vector<QPointF>
+XSpline::assembleCachedPolyline(SamplingParams const& params) const
+{
+	size_t const num_segments = numSegments();
+
+	if (m_segmentPolylines.size() != num_segments
+			|| m_cacheParams.maxDistFromSpline != params.maxDistFromSpline
+			|| m_cacheParams.maxDistBetweenSamples != params.maxDistBetweenSamples) {
+		m_segmentPolylines.assign(num_segments, SegmentPolyline());
+		m_cacheParams = params;
+	}
+
+	std::vector<QPointF> polyline;
+
+	for (size_t seg = 0; seg < num_segments; ++seg) {
+		SegmentPolyline& cached = m_segmentPolylines[seg];
+		if (!cached.valid) {
+			if (segmentIsFlat(seg, params)) {
+				// Just the junction points, without any probing.
+				cached.points.clear();
+				cached.points.push_back(pointAtImpl(seg, 0.0));
+				cached.points.push_back(pointAtImpl(seg, 1.0));
+			} else {
+				PolylineSink sink;
+				sample(
+					sink, params,
+					controlPointIndexToT(seg), controlPointIndexToT(seg + 1)
+				);
+				cached.points.swap(sink.polyline);
+			}
+			cached.valid = true;
+		}
+
+		// A segment's first point is the previous segment's last point.
+		polyline.insert(
+			polyline.end(),
+			cached.points.begin() + (seg == 0 ? 0 : 1), cached.points.end()
+		);
+	}
+
+	return polyline;
+}
+
 double
 XSpline::sqDistToLine(QPointF const& pt, QLineF const& line)
 {
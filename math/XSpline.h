@@ -25,6 +25,7 @@
 #include "NumericTraits.h"
 #include <QPointF>
 #include <QLineF>
+#include <algorithm>
 #include <vector>
 
 /**
@@ -165,11 +166,23 @@ public:
 		SamplingParams const& params = SamplingParams(),
 		double from_t = 0.0, double to_t = 1.0) const;
 
+	/**
+	 * \brief Linearizes the spline into a polyline.
+	 *
+	 * Full-range linearizations are built from a per-segment cache,
+	 * so that moving a control point only causes the few segments
+	 * it affects to be resampled on the next call.  Partial-range
+	 * linearizations bypass the cache.
+	 */
 	std::vector<QPointF> toPolyline(
 		SamplingParams const& params = SamplingParams(),
 		double from_t = 0.0, double to_t = 1.0) const;
 
-	void swap(XSpline& other) { m_controlPoints.swap(other.m_controlPoints); }
+	void swap(XSpline& other) {
+		m_controlPoints.swap(other.m_controlPoints);
+		m_segmentPolylines.swap(other.m_segmentPolylines);
+		std::swap(m_cacheParams, other.m_cacheParams);
+	}
 private:
 	struct ControlPoint
 	{
@@ -190,7 +203,15 @@ private:
 	class GBlendFunc;
 	class HBlendFunc;
 	struct DecomposedDerivs;
-	
+
+	struct SegmentPolyline
+	{
+		std::vector<QPointF> points; /**< Includes both junction points. */
+		bool valid;
+
+		SegmentPolyline() : valid(false) {}
+	};
+
 	QPointF pointAtImpl(int segment, double t) const;
 
 	int linearCombinationFor(LinearCoefficient* coeffs, int segment, double t) const;
@@ -208,7 +229,30 @@ private:
 
 	static double sqDistToLine(QPointF const& pt, QLineF const& line);
 
+	void invalidateLinearizationCache();
+
+	void invalidateLinearizationCacheSpan(int cp_idx);
+
+	/**
+	 * Returns true if the segment is guaranteed to deviate from the
+	 * straight line between its junction points by no more than
+	 * params.maxDistFromSpline, judged by its control polygon.
+	 */
+	bool segmentIsFlat(int segment, SamplingParams const& params) const;
+
+	std::vector<QPointF> assembleCachedPolyline(SamplingParams const& params) const;
+
 	std::vector<ControlPoint> m_controlPoints;
+
+	/**
+	 * Per-segment linearizations, indexed by segment.  Mutable, as it's
+	 * updated from the const toPolyline().  A position-only change to
+	 * a control point invalidates just the segments it participates in.
+	 */
+	mutable std::vector<SegmentPolyline> m_segmentPolylines;
+
+	/** The sampling parameters m_segmentPolylines was built with. */
+	mutable SamplingParams m_cacheParams;
 };
 
 inline void swap(XSpline& o1, XSpline& o2)
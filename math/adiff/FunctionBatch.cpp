@@ -0,0 +1,223 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FunctionBatch.h"
+#include <algorithm>
+#include <assert.h>
+
+namespace adiff
+{
+
+// The loops below run over the flat storage of firstDerivs and
+// secondDerivs.  MatT is column-major and every column covers all
+// samples, so these are single contiguous sweeps.
+
+FunctionBatch<2>::FunctionBatch(size_t num_samples, size_t num_non_zero_vars)
+: values(num_samples)
+, firstDerivs(num_samples, num_non_zero_vars)
+, secondDerivs(num_samples, num_non_zero_vars)
+{
+}
+
+FunctionBatch<2>::FunctionBatch(size_t num_samples, SparseMap<2> const& sparse_map)
+: values(num_samples)
+, firstDerivs(num_samples, sparse_map.numNonZeroElements())
+, secondDerivs(num_samples, sparse_map.numNonZeroElements())
+{
+}
+
+void
+FunctionBatch<2>::addArg(
+	size_t const sample, size_t const arg_idx, double const val,
+	double const coeff, SparseMap<2> const& sparse_map)
+{
+	// See Function's argument constructor for the derivative layout.
+	values[sample] += coeff * val;
+
+	size_t const num_vars = sparse_map.numVars();
+
+	// arg_idx row
+	for (size_t i = 0; i < num_vars; ++i) {
+		size_t const u = sparse_map.nonZeroElementIdx(arg_idx, i);
+		if (u != sparse_map.ZERO_ELEMENT) {
+			firstDerivs(sample, u) += coeff;
+		}
+	}
+
+	// arg_idx column.  The diagonal element was already taken
+	// care of by the row pass above.
+	for (size_t i = 0; i < num_vars; ++i) {
+		if (i == arg_idx) {
+			continue;
+		}
+		size_t const u = sparse_map.nonZeroElementIdx(i, arg_idx);
+		if (u != sparse_map.ZERO_ELEMENT) {
+			firstDerivs(sample, u) += coeff;
+		}
+	}
+}
+
+Function<2>
+FunctionBatch<2>::sum() const
+{
+	size_t const n = values.size();
+	size_t const p = firstDerivs.cols();
+
+	Function<2> res(p);
+	for (size_t i = 0; i < n; ++i) {
+		res.value += values[i];
+	}
+
+	double const* fd = firstDerivs.data();
+	double const* sd = secondDerivs.data();
+	for (size_t u = 0; u < p; ++u, fd += n, sd += n) {
+		double fd_sum = 0;
+		double sd_sum = 0;
+		for (size_t i = 0; i < n; ++i) {
+			fd_sum += fd[i];
+			sd_sum += sd[i];
+		}
+		res.firstDerivs[u] = fd_sum;
+		res.secondDerivs[u] = sd_sum;
+	}
+
+	return res;
+}
+
+void
+FunctionBatch<2>::swap(FunctionBatch<2>& other)
+{
+	values.swap(other.values);
+	firstDerivs.swap(other.firstDerivs);
+	secondDerivs.swap(other.secondDerivs);
+}
+
+FunctionBatch<2>&
+FunctionBatch<2>::operator+=(FunctionBatch<2> const& other)
+{
+	size_t const n = values.size();
+	size_t const flat = firstDerivs.rows() * firstDerivs.cols();
+	assert(other.values.size() == n);
+	assert(other.firstDerivs.rows() * other.firstDerivs.cols() == flat);
+
+	for (size_t i = 0; i < n; ++i) {
+		values[i] += other.values[i];
+	}
+
+	double* fd = firstDerivs.data();
+	double* sd = secondDerivs.data();
+	double const* other_fd = other.firstDerivs.data();
+	double const* other_sd = other.secondDerivs.data();
+	for (size_t i = 0; i < flat; ++i) {
+		fd[i] += other_fd[i];
+		sd[i] += other_sd[i];
+	}
+
+	return *this;
+}
+
+FunctionBatch<2>&
+FunctionBatch<2>::operator-=(FunctionBatch<2> const& other)
+{
+	size_t const n = values.size();
+	size_t const flat = firstDerivs.rows() * firstDerivs.cols();
+	assert(other.values.size() == n);
+	assert(other.firstDerivs.rows() * other.firstDerivs.cols() == flat);
+
+	for (size_t i = 0; i < n; ++i) {
+		values[i] -= other.values[i];
+	}
+
+	double* fd = firstDerivs.data();
+	double* sd = secondDerivs.data();
+	double const* other_fd = other.firstDerivs.data();
+	double const* other_sd = other.secondDerivs.data();
+	for (size_t i = 0; i < flat; ++i) {
+		fd[i] -= other_fd[i];
+		sd[i] -= other_sd[i];
+	}
+
+	return *this;
+}
+
+FunctionBatch<2>&
+FunctionBatch<2>::operator*=(double const scalar)
+{
+	size_t const n = values.size();
+	size_t const flat = firstDerivs.rows() * firstDerivs.cols();
+
+	for (size_t i = 0; i < n; ++i) {
+		values[i] *= scalar;
+	}
+
+	double* fd = firstDerivs.data();
+	for (size_t i = 0; i < flat; ++i) {
+		fd[i] *= scalar;
+	}
+
+	return *this;
+}
+
+FunctionBatch<2> operator+(FunctionBatch<2> const& f1, FunctionBatch<2> const& f2)
+{
+	FunctionBatch<2> res(f1);
+	res += f2;
+	return res;
+}
+
+FunctionBatch<2> operator-(FunctionBatch<2> const& f1, FunctionBatch<2> const& f2)
+{
+	FunctionBatch<2> res(f1);
+	res -= f2;
+	return res;
+}
+
+FunctionBatch<2> operator*(FunctionBatch<2> const& f1, FunctionBatch<2> const& f2)
+{
+	size_t const n = f1.values.size();
+	size_t const p = f1.firstDerivs.cols();
+	assert(f2.values.size() == n);
+	assert(f2.firstDerivs.cols() == p);
+
+	FunctionBatch<2> res(n, p);
+
+	double const* const v1 = f1.values.data();
+	double const* const v2 = f2.values.data();
+	for (size_t i = 0; i < n; ++i) {
+		res.values[i] = v1[i] * v2[i];
+	}
+
+	double const* fd1 = f1.firstDerivs.data();
+	double const* fd2 = f2.firstDerivs.data();
+	double const* sd1 = f1.secondDerivs.data();
+	double const* sd2 = f2.secondDerivs.data();
+	double* fd = res.firstDerivs.data();
+	double* sd = res.secondDerivs.data();
+	for (size_t u = 0; u < p; ++u) {
+		for (size_t i = 0; i < n; ++i) {
+			fd[i] = fd1[i] * v2[i] + v1[i] * fd2[i];
+			sd[i] = sd1[i] * v2[i] + 2.0 * fd1[i] * fd2[i] + v1[i] * sd2[i];
+		}
+		fd1 += n; fd2 += n; sd1 += n; sd2 += n;
+		fd += n; sd += n;
+	}
+
+	return res;
+}
+
+} // namespace adiff
@@ -0,0 +1,120 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ADIFF_FUNCTION_BATCH_H_
+#define ADIFF_FUNCTION_BATCH_H_
+
+#include "SparseMap.h"
+#include "Function.h"
+#include "MatT.h"
+#include "VecT.h"
+#include <stddef.h>
+
+namespace adiff
+{
+
+/**
+ * \brief A batch of Function objects sharing a sparse map,
+ *        stored structure-of-arrays.
+ *
+ * Building a cost function usually means evaluating many nearly
+ * identical sample terms.  Going through scalar Function arithmetic
+ * evaluates them one by one, each operation touching short,
+ * scattered vectors.  This class holds one sample per row and
+ * performs the same operations on all samples at once over
+ * contiguous arrays, which compilers can vectorize.
+ *
+ * It would be nice to have a generic version,
+ * but for now it's only specialized for ORD == 2.
+ */
+template<int ORD> class FunctionBatch;
+
+template<> class FunctionBatch<2>
+{
+	// Member-wise copying is OK.
+public:
+	/** The values of the function, one per sample. */
+	VecT<double> values;
+
+	/**
+	 * First directional derivatives, as in Function.  Dimensions:
+	 * (num_samples, total_nonzero_derivs), so that the derivatives
+	 * in a fixed direction are contiguous across samples.
+	 */
+	MatT<double> firstDerivs;
+
+	/** Second directional derivatives.  Same layout as firstDerivs. */
+	MatT<double> secondDerivs;
+
+	/**
+	 * Constructs a batch of "f(x1, x2, ...) = 0" functions.
+	 */
+	FunctionBatch(size_t num_samples, size_t num_non_zero_vars);
+
+	/**
+	 * Constructs a batch of "f(x1, x2, ...) = 0" functions.
+	 */
+	FunctionBatch(size_t num_samples, SparseMap<2> const& sparse_map);
+
+	size_t numSamples() const { return values.size(); }
+
+	/**
+	 * \brief Adds (coeff * Xi) to the given sample.
+	 *
+	 * The batch counterpart of Function's argument constructor,
+	 * generalized with a coefficient so that linear combinations
+	 * of arguments can be built without temporaries.
+	 *
+	 * \param sample The sample to add to.
+	 * \param arg_idx Argument number.
+	 * \param val Argument value.
+	 * \param coeff The coefficient to scale the argument by.
+	 * \param sparse_map Tells which derivatives to compute.
+	 */
+	void addArg(
+		size_t sample, size_t arg_idx, double val,
+		double coeff, SparseMap<2> const& sparse_map);
+
+	/**
+	 * \brief Sums all samples into a single function.
+	 */
+	Function<2> sum() const;
+
+	void swap(FunctionBatch& other);
+
+	FunctionBatch& operator+=(FunctionBatch const& other);
+
+	FunctionBatch& operator-=(FunctionBatch const& other);
+
+	FunctionBatch& operator*=(double scalar);
+};
+
+inline void swap(FunctionBatch<2>& f1, FunctionBatch<2>& f2)
+{
+	f1.swap(f2);
+}
+
+FunctionBatch<2> operator+(FunctionBatch<2> const& f1, FunctionBatch<2> const& f2);
+
+FunctionBatch<2> operator-(FunctionBatch<2> const& f1, FunctionBatch<2> const& f2);
+
+FunctionBatch<2> operator*(FunctionBatch<2> const& f1, FunctionBatch<2> const& f2);
+
+} // namespace adiff
+
+#endif
@@ -0,0 +1,76 @@
+/*
+    Scan Tailor - Interactive post-processing tool for scanned pages.
+    Copyright (C)  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Function.h"
+#include "FunctionBatch.h"
+#include "SparseMap.h"
+#include "VecT.h"
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/test/floating_point_comparison.hpp>
+#include <stddef.h>
+
+namespace adiff
+{
+
+namespace tests
+{
+
+BOOST_AUTO_TEST_SUITE(FunctionBatchTestSuite);
+
+BOOST_AUTO_TEST_CASE(matches_scalar_evaluation)
+{
+	// F(x1, x2, x3) = (x2 - x1)^2 + (x3 - x2)^2  | x = (1, 4, 2)
+	// computed once through scalar Functions and once as a
+	// two-sample batch.  Results must agree exactly.
+
+	double const vals[3] = { 1, 4, 2 };
+
+	SparseMap<2> sparse_map(3);
+	sparse_map.markAllNonZero();
+
+	Function<2> scalar_force(sparse_map);
+	for (size_t i = 0; i < 2; ++i) {
+		Function<2> const prev(i, vals[i], sparse_map);
+		Function<2> const next(i + 1, vals[i + 1], sparse_map);
+		Function<2> const d(next - prev);
+		scalar_force += d * d;
+	}
+
+	FunctionBatch<2> d(2, sparse_map);
+	for (size_t i = 0; i < 2; ++i) {
+		d.addArg(i, i + 1, vals[i + 1], 1.0, sparse_map);
+		d.addArg(i, i, vals[i], -1.0, sparse_map);
+	}
+	Function<2> const batch_force((d * d).sum());
+
+	BOOST_REQUIRE_CLOSE(batch_force.value, scalar_force.value, 1e-09);
+
+	size_t const p = sparse_map.numNonZeroElements();
+	BOOST_REQUIRE_EQUAL(batch_force.firstDerivs.size(), p);
+	BOOST_REQUIRE_EQUAL(batch_force.secondDerivs.size(), p);
+	for (size_t u = 0; u < p; ++u) {
+		BOOST_REQUIRE_CLOSE(batch_force.firstDerivs[u], scalar_force.firstDerivs[u], 1e-09);
+		BOOST_REQUIRE_CLOSE(batch_force.secondDerivs[u], scalar_force.secondDerivs[u], 1e-09);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END();
+
+} // namespace tests
+
+} // namespace adiff
@@ -18,6 +18,7 @@
 
 #include "Optimizer.h"
 #include "MatrixCalc.h"
+#include "BandedCholesky.h"
 #include <boost/foreach.hpp>
 #include <stdexcept>
 #include <algorithm>
@@ -131,15 +132,18 @@ Optimizer::optimize(double internal_force_weight)
 	}
 
 	double const total_force_before = m_internalForce.c;
-	DynamicMatrixCalc<double> mc;
 
-	try {
-		mc(m_A).solve(mc(m_b)).write(m_x.data());
-	} catch (std::runtime_error const&) {
-		m_externalForce.reset();
-		m_internalForce.reset();
-		m_x.fill(0); // To make undoLastStep() work as expected.
-		return OptimizationResult(total_force_before, total_force_before);
+	if (!trySolveBanded()) {
+		DynamicMatrixCalc<double> mc;
+
+		try {
+			mc(m_A).solve(mc(m_b)).write(m_x.data());
+		} catch (std::runtime_error const&) {
+			m_externalForce.reset();
+			m_internalForce.reset();
+			m_x.fill(0); // To make undoLastStep() work as expected.
+			return OptimizationResult(total_force_before, total_force_before);
+		}
 	}
 
 	double const total_force_after = m_internalForce.evaluate(m_x.data());
@@ -153,6 +157,129 @@ Optimizer::optimize(double internal_force_weight)
 	return OptimizationResult(total_force_before, total_force_after);
 }
 
+/**
+ * \brief Attempts to solve the normal equations through banded Cholesky.
+ *
+ * Spline-fitting forces only couple neighboring control points, so the
+ * Hessian block of m_A is banded.  When the band is narrow enough, we
+ * factorize it with BandedCholesky and handle the (few) Lagrange
+ * multipliers through a Schur complement, turning the cubic dense
+ * solve into O(num_vars * bandwidth^2).  One factorization serves the
+ * right hand side and every constraint column.
+ *
+ * \return Whether the solution was written to m_x.  Returns false
+ *         when the matrix is too dense for this path to pay off, or
+ *         when the Hessian turns out not to be positive definite;
+ *         the caller then falls back to the dense solver.
+ */
+bool
+Optimizer::trySolveBanded()
+{
+	size_t const n = m_numVars;
+	size_t const num_dimensions = m_b.size();
+	size_t const num_constraints = num_dimensions - n;
+	if (n == 0) {
+		return false;
+	}
+
+	// Detect the half-bandwidth.  Structural zeros in m_A are exact,
+	// as force accumulation only ever touches coupled variable pairs.
+	size_t bw = 0;
+	for (size_t j = 0; j < n; ++j) {
+		for (size_t i = j + bw + 1; i < n; ++i) {
+			if (m_A(i, j) != 0.0) {
+				bw = i - j;
+			}
+		}
+	}
+
+	if ((bw + 1) * 4 >= n) {
+		// Not banded enough for the savings to matter.
+		return false;
+	}
+
+	BandedCholesky const solver(n, bw);
+
+	// The band structure comes from the spline topology, which
+	// doesn't change between iterations, so this buffer keeps its
+	// size across them; only the numbers need refactorizing.
+	if (m_bandedFactor.size() != solver.packedSize()) {
+		VecT<double>(solver.packedSize()).swap(m_bandedFactor);
+	}
+	for (size_t j = 0; j < n; ++j) {
+		size_t const i_end = std::min(j + bw, n - 1);
+		for (size_t i = j; i <= i_end; ++i) {
+			m_bandedFactor[j * (bw + 1) + (i - j)] = m_A(i, j);
+		}
+	}
+
+	try {
+		solver.factorizeInPlace(m_bandedFactor.data());
+	} catch (std::runtime_error const&) {
+		return false;
+	}
+
+	// x = H^-1 * (b1 - C^T * lambda), with lambda coming from the
+	// Schur complement: (C * H^-1 * C^T) * lambda = C * H^-1 * b1 - b2.
+	// For the layout of m_A and m_b, see setConstraints().
+	VecT<double> w(n);
+	solver.solve(m_bandedFactor.data(), w.data(), m_b.data());
+
+	if (num_constraints == 0) {
+		for (size_t i = 0; i < n; ++i) {
+			m_x[i] = w[i];
+		}
+		return true;
+	}
+
+	MatT<double> Y(n, num_constraints); // Column r: H^-1 * C^T's column r.
+	VecT<double> c(n);
+	for (size_t r = 0; r < num_constraints; ++r) {
+		for (size_t j = 0; j < n; ++j) {
+			c[j] = m_A(n + r, j);
+		}
+		solver.solve(m_bandedFactor.data(), Y.data() + r * n, c.data());
+	}
+
+	MatT<double> S(num_constraints, num_constraints);
+	VecT<double> rhs(num_constraints);
+	for (size_t r = 0; r < num_constraints; ++r) {
+		for (size_t s = 0; s < num_constraints; ++s) {
+			double acc = 0;
+			for (size_t j = 0; j < n; ++j) {
+				acc += m_A(n + r, j) * Y(j, s);
+			}
+			S(r, s) = acc;
+		}
+		double acc = 0;
+		for (size_t j = 0; j < n; ++j) {
+			acc += m_A(n + r, j) * w[j];
+		}
+		rhs[r] = acc - m_b[n + r];
+	}
+
+	VecT<double> lambda(num_constraints);
+	DynamicMatrixCalc<double> mc;
+	try {
+		mc(S).solve(mc(rhs)).write(lambda.data());
+	} catch (std::runtime_error const&) {
+		return false;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		double x = w[i];
+		for (size_t r = 0; r < num_constraints; ++r) {
+			x -= Y(i, r) * lambda[r];
+		}
+		m_x[i] = x;
+	}
+	for (size_t r = 0; r < num_constraints; ++r) {
+		m_x[n + r] = lambda[r];
+	}
+
+	return true;
+}
+
 void
 Optimizer::undoLastStep()
 {
@@ -185,6 +312,7 @@ Optimizer::swap(Optimizer& other)
 	m_A.swap(other.m_A);
 	m_b.swap(other.m_b);
 	m_x.swap(other.m_x);
+	m_bandedFactor.swap(other.m_bandedFactor);
 	m_externalForce.swap(other.m_externalForce);
 	m_internalForce.swap(other.m_internalForce);
 	std::swap(m_numVars, other.m_numVars);
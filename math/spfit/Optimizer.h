@@ -86,10 +86,13 @@ public:
 private:
 	void adjustConstraints(double direction);
 
+	bool trySolveBanded();
+
 	size_t m_numVars;
 	MatT<double> m_A;
 	VecT<double> m_b;
 	VecT<double> m_x;
+	VecT<double> m_bandedFactor;
 	QuadraticFunction m_externalForce;
 	QuadraticFunction m_internalForce;
 };
@@ -19,6 +19,7 @@
 #include "SerializableSpline.h"
 #include "EditableSpline.h"
 #include "SplineVertex.h"
+#include "ZoneGeometrySidecar.h"
 #include "XmlMarshaller.h"
 #include "XmlUnmarshaller.h"
 #include <QDomDocument>
@@ -40,6 +41,16 @@ SerializableSpline::SerializableSpline(EditableSpline const& spline)
 
 SerializableSpline::SerializableSpline(QDomElement const& el)
 {
+	if (el.hasAttribute("binref")) {
+		quint32 const record = el.attribute("binref").toUInt();
+		if (ZoneGeometrySidecarReader::lookup(record, m_points)) {
+			return;
+		}
+		// The sidecar is missing or damaged.  Projects written by
+		// older versions carry inline points instead of a binref,
+		// so falling through salvages whatever is there.
+	}
+
 	QString const point_str("point");
 
 	QDomNode node(el.firstChild());
@@ -60,6 +71,11 @@ SerializableSpline::toXml(QDomDocument& doc, QString const& name) const
 {
 	QDomElement el(doc.createElement(name));
 
+	if (ZoneGeometrySidecarWriter* writer = ZoneGeometrySidecarWriter::activeForThread()) {
+		el.setAttribute("binref", (uint)writer->append(m_points));
+		return el;
+	}
+
 	QString const point_str("point");
 	XmlMarshaller marshaller(doc);
 	BOOST_FOREACH(QPointF const& pt, m_points) {
@@ -25,7 +25,6 @@
 #include <QPointF>
 #include <QPen>
 #include <QPainter>
-#include <QPainterPath>
 #include <QColor>
 #include <QLinearGradient>
 #include <Qt>
@@ -34,10 +33,12 @@
 #include <boost/foreach.hpp>
 #endif
 #include <vector>
+#include <math.h>
 #include <assert.h>
 
 ZoneDefaultInteraction::ZoneDefaultInteraction(ZoneInteractionContext& context)
 :	m_rContext(context),
+	m_spatialIndex(context.zones()),
 	m_dragHandler(context.imageView()),
 	m_dragWatcher(m_dragHandler)
 {
@@ -143,49 +144,51 @@ ZoneDefaultInteraction::onProximityUpdate(QPointF const& mouse_pos, InteractionS
 	Proximity best_vertex_proximity;
 	Proximity best_segment_proximity;
 
-	bool has_zone_under_mouse = false;
-
-	BOOST_FOREACH(EditableZoneSet::Zone const& zone, m_rContext.zones()) {
-		EditableSpline::Ptr const& spline = zone.spline();
+	// Proximity is measured in screen pixels, while the index holds image
+	// coordinates.  The Frobenius norm of the 2x2 part of widgetToImage()
+	// bounds the factor by which it can stretch a distance, which gives
+	// us a safe image-space search radius.  Anything beyond the threshold
+	// can't become a proximity leader, so leaving it out is harmless.
+	double const stretch = sqrt(
+		from_screen.m11() * from_screen.m11() + from_screen.m12() * from_screen.m12()
+		+ from_screen.m21() * from_screen.m21() + from_screen.m22() * from_screen.m22()
+	);
+	double const radius = interaction.proximityThreshold().dist() * stretch;
 
-		if (!has_zone_under_mouse) {
-			QPainterPath path;
-			path.setFillRule(Qt::WindingFill);
-			path.addPolygon(spline->toPolygon());
-			has_zone_under_mouse = path.contains(image_mouse_pos);
-		}
+	m_segmentCandidates.clear();
+	m_spatialIndex.segmentCandidates(image_mouse_pos, radius, m_segmentCandidates);
 
-		// Process vertices.
-		for (SplineVertex::Ptr vert(spline->firstVertex());
-				vert; vert = vert->next(SplineVertex::NO_LOOP)) {
+	BOOST_FOREACH(ZoneSpatialIndex::Segment const* seg, m_segmentCandidates) {
+		SplineSegment const& segment = seg->segment;
 
-			Proximity const proximity(mouse_pos, to_screen.map(vert->point()));
+		// Every real vertex terminates some segment, so going over
+		// segment endpoints visits every vertex near the mouse.
+		// Visiting a shared endpoint twice is harmless.
+		SplineVertex::Ptr const endpoints[] = { segment.prev, segment.next };
+		for (int i = 0; i < 2; ++i) {
+			Proximity const proximity(mouse_pos, to_screen.map(endpoints[i]->point()));
 			if (proximity < best_vertex_proximity) {
-				m_ptrNearestVertex = vert;
-				m_ptrNearestVertexSpline = spline;
+				m_ptrNearestVertex = endpoints[i];
+				m_ptrNearestVertexSpline = seg->spline;
 				best_vertex_proximity = proximity;
 			}
 		}
 
-		// Process segments.
-		for (EditableSpline::SegmentIterator it(*spline); it.hasNext(); ) {
-			SplineSegment const segment(it.next());
-			QLineF const line(to_screen.map(segment.toLine()));
-			QPointF point_on_segment;
-			Proximity const proximity(Proximity::pointAndLineSegment(mouse_pos, line, &point_on_segment));
-			if (proximity < best_segment_proximity) {
-				m_nearestSegment = segment;
-				m_ptrNearestSegmentSpline = spline;
-				best_segment_proximity = proximity;
-				m_screenPointOnSegment = point_on_segment;
-			}
+		QLineF const line(to_screen.map(segment.toLine()));
+		QPointF point_on_segment;
+		Proximity const proximity(Proximity::pointAndLineSegment(mouse_pos, line, &point_on_segment));
+		if (proximity < best_segment_proximity) {
+			m_nearestSegment = segment;
+			m_ptrNearestSegmentSpline = seg->spline;
+			best_segment_proximity = proximity;
+			m_screenPointOnSegment = point_on_segment;
 		}
 	}
 
 	interaction.updateProximity(m_vertexProximity, best_vertex_proximity, 1);
 	interaction.updateProximity(m_segmentProximity, best_segment_proximity, 0);
 
-	if (has_zone_under_mouse) {
+	if (m_spatialIndex.zoneUnderPoint(image_mouse_pos)) {
 		Proximity const zone_area_proximity(std::min(best_vertex_proximity, best_segment_proximity));
 		interaction.updateProximity(m_zoneAreaProximity, zone_area_proximity, -1, zone_area_proximity);
 	}
@@ -27,8 +27,10 @@
 #include "EditableSpline.h"
 #include "SplineVertex.h"
 #include "SplineSegment.h"
+#include "ZoneSpatialIndex.h"
 #include <QPointF>
 #include <QCoreApplication>
+#include <vector>
 
 class ZoneInteractionContext;
 
@@ -53,6 +55,17 @@ protected:
 	virtual void onContextMenuEvent(QContextMenuEvent* event, InteractionState& interaction);
 private:
 	ZoneInteractionContext& m_rContext;
+
+	/**
+	 * Accelerates hit-testing in onProximityUpdate().  Building it here
+	 * is enough to keep it accurate, as interactions that modify zones
+	 * destroy this object and create a new one when they are done.
+	 */
+	ZoneSpatialIndex m_spatialIndex;
+
+	/** Reused between mouse moves to avoid reallocations. */
+	std::vector<ZoneSpatialIndex::Segment const*> m_segmentCandidates;
+
 	BasicSplineVisualizer m_visualizer;
 	InteractionState::Captor m_vertexProximity;
 	InteractionState::Captor m_segmentProximity;
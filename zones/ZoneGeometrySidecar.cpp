@@ -0,0 +1,194 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ZoneGeometrySidecar.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadStorage>
+#include <vector>
+
+static quint32 const SIDECAR_MAGIC = 0x53545A47; // "STZG"
+static quint16 const SIDECAR_VERSION = 1;
+
+/**
+ * QThreadStorage deletes whatever it holds at thread exit and on
+ * replacement, so it gets a heap-allocated cell pointing to the
+ * stack-allocated writer rather than the writer itself.
+ */
+static QThreadStorage<ZoneGeometrySidecarWriter**>&
+threadWriterSlot()
+{
+	static QThreadStorage<ZoneGeometrySidecarWriter**> slot;
+	return slot;
+}
+
+static void
+setThreadWriter(ZoneGeometrySidecarWriter* writer)
+{
+	threadWriterSlot().setLocalData(
+		writer ? new ZoneGeometrySidecarWriter*(writer) : 0
+	);
+}
+
+static ZoneGeometrySidecarWriter*
+threadWriter()
+{
+	ZoneGeometrySidecarWriter** const slot = threadWriterSlot().localData();
+	return slot ? *slot : 0;
+}
+
+
+/*========================= ZoneGeometrySidecarWriter =====================*/
+
+ZoneGeometrySidecarWriter::ZoneGeometrySidecarWriter(QString const& sidecar_path)
+:	m_file(sidecar_path),
+	m_pPrevWriter(threadWriter()),
+	m_numRecords(0),
+	m_open(false)
+{
+	if (m_file.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+		m_open = true;
+		m_stream.setDevice(&m_file);
+		m_stream << SIDECAR_MAGIC << SIDECAR_VERSION;
+	}
+	setThreadWriter(this);
+}
+
+ZoneGeometrySidecarWriter::~ZoneGeometrySidecarWriter()
+{
+	setThreadWriter(m_pPrevWriter);
+
+	if (!m_open) {
+		return;
+	}
+
+	bool const failed = error();
+	m_file.close();
+	if (failed || m_numRecords == 0) {
+		// An empty or partially written sidecar is worse than none:
+		// the XML still carries the full geometry of old records,
+		// while a truncated file would silently drop the rest.
+		m_file.remove();
+	}
+}
+
+QString
+ZoneGeometrySidecarWriter::sidecarPathFor(QString const& project_file)
+{
+	return project_file + ".zones";
+}
+
+ZoneGeometrySidecarWriter*
+ZoneGeometrySidecarWriter::activeForThread()
+{
+	ZoneGeometrySidecarWriter* const writer = threadWriter();
+	if (writer && writer->m_open && !writer->error()) {
+		return writer;
+	}
+	return 0;
+}
+
+quint32
+ZoneGeometrySidecarWriter::append(QVector<QPointF> const& points)
+{
+	quint32 const record = m_numRecords++;
+
+	m_stream << (quint32)points.size();
+	for (int i = 0; i < points.size(); ++i) {
+		// Explicit casts: qreal is float on some platforms, and the
+		// file format is 64 bit coordinates everywhere.
+		m_stream << (double)points[i].x() << (double)points[i].y();
+	}
+
+	return record;
+}
+
+bool
+ZoneGeometrySidecarWriter::error() const
+{
+	// Failing to open the file is not an error in this sense: no
+	// spline ever got a record number, they all serialized inline.
+	return m_open && (m_stream.status() != QDataStream::Ok
+		|| m_file.error() != QFile::NoError);
+}
+
+
+/*========================= ZoneGeometrySidecarReader =====================*/
+
+static QMutex g_recordsMutex;
+static std::vector<QVector<QPointF> > g_records; // Guarded by g_recordsMutex.
+
+void
+ZoneGeometrySidecarReader::loadFor(QString const& project_file)
+{
+	std::vector<QVector<QPointF> > records;
+
+	QFile file(ZoneGeometrySidecarWriter::sidecarPathFor(project_file));
+	if (file.open(QIODevice::ReadOnly)) {
+		QDataStream stream(&file);
+
+		quint32 magic = 0;
+		quint16 version = 0;
+		stream >> magic >> version;
+		if (magic == SIDECAR_MAGIC && version == SIDECAR_VERSION) {
+			while (!stream.atEnd()) {
+				quint32 num_points = 0;
+				stream >> num_points;
+
+				// The length field is untrusted: cap it against the
+				// bytes actually left in the file (16 per point), so
+				// a corrupt value can't trigger a giant allocation.
+				qint64 const bytes_left = file.size() - file.pos();
+				if (stream.status() != QDataStream::Ok
+						|| qint64(num_points) > bytes_left / 16) {
+					records.clear();
+					break;
+				}
+
+				QVector<QPointF> points;
+				points.reserve(num_points);
+				for (quint32 i = 0; i < num_points; ++i) {
+					double x = 0, y = 0;
+					stream >> x >> y;
+					points.push_back(QPointF(x, y));
+				}
+
+				if (stream.status() != QDataStream::Ok) {
+					// A truncated file can't be trusted at all.
+					records.clear();
+					break;
+				}
+				records.push_back(points);
+			}
+		}
+	}
+
+	QMutexLocker const locker(&g_recordsMutex);
+	g_records.swap(records);
+}
+
+bool
+ZoneGeometrySidecarReader::lookup(quint32 record, QVector<QPointF>& points)
+{
+	QMutexLocker const locker(&g_recordsMutex);
+	if (record >= g_records.size()) {
+		return false;
+	}
+	points = g_records[record];
+	return true;
+}
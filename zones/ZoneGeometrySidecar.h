@@ -0,0 +1,111 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ZONE_GEOMETRY_SIDECAR_H_
+#define ZONE_GEOMETRY_SIDECAR_H_
+
+#include "NonCopyable.h"
+#include <QDataStream>
+#include <QFile>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+
+/**
+ * \brief Writes spline vertices to a binary sidecar next to the project file.
+ *
+ * Zone vertices dominate both the size and the parsing time of heavily
+ * zoned projects, as every coordinate goes through decimal text.  While
+ * a writer is installed for the current thread, SerializableSpline::toXml()
+ * appends its vertices here and only stores the record number in the XML.
+ * When no writer is installed, or this one has failed, splines keep
+ * serializing inline \<point\> elements as before, so the XML remains a
+ * complete fallback.
+ *
+ * The file starts with a magic number and a format version, followed by
+ * a plain sequence of records: a vertex count and that many coordinate
+ * pairs.  An unrecognized version makes the reader ignore the file.
+ */
+class ZoneGeometrySidecarWriter
+{
+	DECLARE_NON_COPYABLE(ZoneGeometrySidecarWriter)
+public:
+	/**
+	 * Creates the sidecar file and installs this writer for the
+	 * calling thread.  The destructor uninstalls it and removes
+	 * the file again if nothing was written or an error occured.
+	 */
+	explicit ZoneGeometrySidecarWriter(QString const& sidecar_path);
+
+	~ZoneGeometrySidecarWriter();
+
+	static QString sidecarPathFor(QString const& project_file);
+
+	/**
+	 * Returns the writer installed for the calling thread, if any.
+	 * A writer that has hit an error is not returned, which makes
+	 * splines fall back to inline serialization.
+	 */
+	static ZoneGeometrySidecarWriter* activeForThread();
+
+	/**
+	 * \brief Appends a vertex record and returns its number.
+	 */
+	quint32 append(QVector<QPointF> const& points);
+
+	/**
+	 * Returns true if writing failed after records were already
+	 * handed out, meaning the XML references geometry that was
+	 * lost.  A file that never opened doesn't count: in that case
+	 * every spline serialized inline and the XML is complete.
+	 */
+	bool error() const;
+private:
+	QFile m_file;
+	QDataStream m_stream;
+	ZoneGeometrySidecarWriter* m_pPrevWriter;
+	quint32 m_numRecords;
+	bool m_open;
+};
+
+
+/**
+ * \brief Provides vertex records from the sidecar of the current project.
+ *
+ * Zone elements are materialized lazily and on arbitrary worker
+ * threads, so the records are kept for the whole lifetime of the
+ * project, behind a lock.
+ */
+class ZoneGeometrySidecarReader
+{
+public:
+	/**
+	 * Loads the sidecar accompanying the given project file,
+	 * replacing any previously loaded records.  A missing, damaged
+	 * or unrecognized sidecar simply results in no records, in
+	 * which case splines parse their inline \<point\> elements.
+	 */
+	static void loadFor(QString const& project_file);
+
+	/**
+	 * \brief Fetches a vertex record, returning false if there is none.
+	 */
+	static bool lookup(quint32 record, QVector<QPointF>& points);
+};
+
+#endif
@@ -0,0 +1,139 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ZoneSpatialIndex.h"
+#include "EditableZoneSet.h"
+#include <QLineF>
+#include <Qt>
+#ifndef Q_MOC_RUN
+#include <boost/foreach.hpp>
+#endif
+#include <algorithm>
+#include <math.h>
+
+ZoneSpatialIndex::ZoneSpatialIndex(EditableZoneSet const& zones)
+:	m_cellWidth(1.0),
+	m_cellHeight(1.0),
+	m_gridWidth(1),
+	m_gridHeight(1)
+{
+	QRectF total_rect;
+
+	BOOST_FOREACH(EditableZoneSet::Zone const& zone, zones) {
+		EditableSpline::Ptr const& spline = zone.spline();
+
+		ZoneArea area;
+		area.path.setFillRule(Qt::WindingFill);
+		area.path.addPolygon(spline->toPolygon());
+		area.boundingBox = area.path.controlPointRect();
+		m_zoneAreas.push_back(area);
+
+		total_rect |= area.boundingBox;
+
+		for (EditableSpline::SegmentIterator it(*spline); it.hasNext(); ) {
+			Segment seg;
+			seg.spline = spline;
+			seg.segment = it.next();
+			m_segments.push_back(seg);
+		}
+	}
+
+	if (m_segments.empty() || total_rect.isEmpty()) {
+		m_gridOrigin = total_rect.topLeft();
+		m_cells.resize(1);
+		return;
+	}
+
+	// Aim for about one segment per cell.  Queries then visit a handful
+	// of segments regardless of how many zones there are, while the
+	// memory spent on cells stays proportional to the segment count.
+	int const dim = std::max(
+		1, std::min(256, int(sqrt(double(m_segments.size())) + 0.5))
+	);
+	m_gridWidth = dim;
+	m_gridHeight = dim;
+	m_cellWidth = total_rect.width() / dim;
+	m_cellHeight = total_rect.height() / dim;
+	m_gridOrigin = total_rect.topLeft();
+	m_cells.resize(size_t(m_gridWidth) * size_t(m_gridHeight));
+
+	size_t const num_segments = m_segments.size();
+	for (size_t i = 0; i < num_segments; ++i) {
+		QLineF const line(m_segments[i].segment.toLine());
+		QRectF bbox(line.p1(), line.p2());
+
+		int x_begin, x_end, y_begin, y_end;
+		cellRange(bbox.normalized(), x_begin, x_end, y_begin, y_end);
+
+		for (int y = y_begin; y < y_end; ++y) {
+			for (int x = x_begin; x < x_end; ++x) {
+				m_cells[size_t(y) * m_gridWidth + x].push_back(unsigned(i));
+			}
+		}
+	}
+}
+
+void
+ZoneSpatialIndex::segmentCandidates(
+	QPointF const& pt, double const radius,
+	std::vector<Segment const*>& candidates) const
+{
+	QRectF const query_rect(
+		pt.x() - radius, pt.y() - radius, radius * 2.0, radius * 2.0
+	);
+
+	int x_begin, x_end, y_begin, y_end;
+	cellRange(query_rect, x_begin, x_end, y_begin, y_end);
+
+	for (int y = y_begin; y < y_end; ++y) {
+		for (int x = x_begin; x < x_end; ++x) {
+			std::vector<unsigned> const& cell = m_cells[size_t(y) * m_gridWidth + x];
+			BOOST_FOREACH(unsigned const idx, cell) {
+				candidates.push_back(&m_segments[idx]);
+			}
+		}
+	}
+}
+
+bool
+ZoneSpatialIndex::zoneUnderPoint(QPointF const& pt) const
+{
+	BOOST_FOREACH(ZoneArea const& area, m_zoneAreas) {
+		if (area.boundingBox.contains(pt) && area.path.contains(pt)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Maps a rectangle to the half-open range of grid cells it overlaps,
+ * clamped to the grid.  An empty range is possible for rectangles
+ * entirely outside the grid.
+ */
+void
+ZoneSpatialIndex::cellRange(
+	QRectF const& rect, int& x_begin, int& x_end,
+	int& y_begin, int& y_end) const
+{
+	x_begin = std::max(0, int(floor((rect.left() - m_gridOrigin.x()) / m_cellWidth)));
+	x_end = std::min(m_gridWidth, int(floor((rect.right() - m_gridOrigin.x()) / m_cellWidth)) + 1);
+	y_begin = std::max(0, int(floor((rect.top() - m_gridOrigin.y()) / m_cellHeight)));
+	y_end = std::min(m_gridHeight, int(floor((rect.bottom() - m_gridOrigin.y()) / m_cellHeight)) + 1);
+}
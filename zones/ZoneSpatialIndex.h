@@ -0,0 +1,97 @@
+/*
+	Scan Tailor - Interactive post-processing tool for scanned pages.
+	Copyright (C) 2015  Joseph Artsimovich <joseph.artsimovich@gmail.com>
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ZONE_SPATIAL_INDEX_H_
+#define ZONE_SPATIAL_INDEX_H_
+
+#include "NonCopyable.h"
+#include "EditableSpline.h"
+#include "SplineSegment.h"
+#include <QPainterPath>
+#include <QPointF>
+#include <QRectF>
+#include <vector>
+
+class EditableZoneSet;
+
+/**
+ * \brief A uniform grid over the zone geometry, in image coordinates.
+ *
+ * Hit-testing in ZoneDefaultInteraction used to walk every segment of
+ * every spline on each mouse move, which gets sluggish with hundreds
+ * of zones.  This index buckets spline segments into a grid by their
+ * bounding boxes, so a proximity query only touches the segments near
+ * the mouse.
+ *
+ * The index is a snapshot: it doesn't follow later modifications of
+ * the zone set.  That suits ZoneDefaultInteraction, which is destroyed
+ * and re-created around every interaction that modifies zones.
+ */
+class ZoneSpatialIndex
+{
+	DECLARE_NON_COPYABLE(ZoneSpatialIndex)
+public:
+	struct Segment
+	{
+		EditableSpline::Ptr spline;
+		SplineSegment segment;
+	};
+
+	explicit ZoneSpatialIndex(EditableZoneSet const& zones);
+
+	/**
+	 * \brief Appends the segments that may lie within \p radius of \p pt.
+	 *
+	 * Both \p pt and \p radius are in image coordinates.  A segment may
+	 * be appended more than once, as segments span several grid cells.
+	 * The pre-filtering is by cell, not by distance, so the caller
+	 * still has to measure the actual distance to each candidate.
+	 */
+	void segmentCandidates(
+		QPointF const& pt, double radius,
+		std::vector<Segment const*>& candidates) const;
+
+	/**
+	 * \brief Returns true if \p pt (in image coordinates) is inside some zone.
+	 */
+	bool zoneUnderPoint(QPointF const& pt) const;
+private:
+	struct ZoneArea
+	{
+		QPainterPath path;
+		QRectF boundingBox;
+	};
+
+	void cellRange(
+		QRectF const& rect, int& x_begin, int& x_end,
+		int& y_begin, int& y_end) const;
+
+	std::vector<Segment> m_segments;
+	std::vector<ZoneArea> m_zoneAreas;
+
+	/** Grid cells in row-major order, each holding indexes into m_segments. */
+	std::vector<std::vector<unsigned> > m_cells;
+
+	QPointF m_gridOrigin;
+	double m_cellWidth;
+	double m_cellHeight;
+	int m_gridWidth;
+	int m_gridHeight;
+};
+
+#endif